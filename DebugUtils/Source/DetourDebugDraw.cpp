@@ -83,21 +83,23 @@ static void drawPolyBoundaries(duDebugDraw* dd, const dtMeshTile* tile,
 				if (p->neis[j] != 0) continue;
 			}
 			
-			const float* v0 = &tile->verts[p->verts[j]*3];
-			const float* v1 = &tile->verts[p->verts[(j+1) % nj]*3];
+			float t0[3], t1[3];
+			const float* v0 = tile->getVert(p->verts[j], t0);
+			const float* v1 = tile->getVert(p->verts[(j+1) % nj], t1);
 			
 			// Draw detail mesh edges which align with the actual poly edge.
 			// This is really slow.
 			for (int k = 0; k < pd->triCount; ++k)
 			{
 				const unsigned char* t = &tile->detailTris[(pd->triBase+k)*4];
+				float tmp[3*3];
 				const float* tv[3];
 				for (int m = 0; m < 3; ++m)
 				{
 					if (t[m] < p->vertCount)
-						tv[m] = &tile->verts[p->verts[t[m]]*3];
+						tv[m] = tile->getVert(p->verts[t[m]], &tmp[m*3]);
 					else
-						tv[m] = &tile->detailVerts[(pd->vertBase+(t[m]-p->vertCount))*3];
+						tv[m] = tile->getDetailVert(pd->vertBase+(t[m]-p->vertCount), &tmp[m*3]);
 				}
 				for (int m = 0, n = 2; m < 3; n=m++)
 				{
@@ -152,10 +154,11 @@ static void drawMeshTile(duDebugDraw* dd, const dtNavMesh& mesh, const dtNavMesh
 			const unsigned char* t = &tile->detailTris[(pd->triBase+j)*4];
 			for (int k = 0; k < 3; ++k)
 			{
+				float tmp[3];
 				if (t[k] < p->vertCount)
-					dd->vertex(&tile->verts[p->verts[t[k]]*3], col);
+					dd->vertex(tile->getVert(p->verts[t[k]], tmp), col);
 				else
-					dd->vertex(&tile->detailVerts[(pd->vertBase+t[k]-p->vertCount)*3], col);
+					dd->vertex(tile->getDetailVert(pd->vertBase+t[k]-p->vertCount, tmp), col);
 			}
 		}
 	}
@@ -183,8 +186,9 @@ static void drawMeshTile(duDebugDraw* dd, const dtNavMesh& mesh, const dtNavMesh
 				col = duDarkenCol(duTransCol(dd->areaToCol(p->getArea()), 220));
 
 			const dtOffMeshConnection* con = &tile->offMeshCons[i - tile->header->offMeshBase];
-			const float* va = &tile->verts[p->verts[0]*3];
-			const float* vb = &tile->verts[p->verts[1]*3];
+			float ta[3], tb[3];
+			const float* va = tile->getVert(p->verts[0], ta);
+			const float* vb = tile->getVert(p->verts[1], tb);
 
 			// Check to see if start and end end-points have links.
 			bool startSet = false;
@@ -226,7 +230,8 @@ static void drawMeshTile(duDebugDraw* dd, const dtNavMesh& mesh, const dtNavMesh
 	dd->begin(DU_DRAW_POINTS, 3.0f);
 	for (int i = 0; i < tile->header->vertCount; ++i)
 	{
-		const float* v = &tile->verts[i*3];
+		float tmp[3];
+		const float* v = tile->getVert(i, tmp);
 		dd->vertex(v[0], v[1], v[2], vcol);
 	}
 	dd->end();
@@ -304,7 +309,26 @@ static void drawMeshTileBVTree(duDebugDraw* dd, const dtMeshTile* tile)
 	// Draw BV nodes.
 	const float cs = 1.0f / tile->header->bvQuantFactor;
 	dd->begin(DU_DRAW_LINES, 1.0f);
-	for (int i = 0; i < tile->header->bvNodeCount; ++i)
+	if (tile->bvWideTree)
+	{
+		for (int i = 0; i < tile->header->bvNodeCount; ++i)
+		{
+			const dtBVWideNode* n = &tile->bvWideTree[i];
+			for (int j = 0; j < DT_BVWIDE_WIDTH; ++j)
+			{
+				if (n->child[j] >= 0) // Leaf indices are negative.
+					continue;
+				duAppendBoxWire(dd, tile->header->bmin[0] + n->bmin[0][j]*cs,
+								tile->header->bmin[1] + n->bmin[1][j]*cs,
+								tile->header->bmin[2] + n->bmin[2][j]*cs,
+								tile->header->bmin[0] + n->bmax[0][j]*cs,
+								tile->header->bmin[1] + n->bmax[1][j]*cs,
+								tile->header->bmin[2] + n->bmax[2][j]*cs,
+								duRGBA(255,255,255,128));
+			}
+		}
+	}
+	for (int i = 0; tile->bvTree && i < tile->header->bvNodeCount; ++i)
 	{
 		const dtBVNode* n = &tile->bvTree[i];
 		if (n->i < 0) // Leaf indices are positive.
@@ -357,8 +381,9 @@ static void drawMeshTilePortal(duDebugDraw* dd, const dtMeshTile* tile)
 					continue;
 				
 				// Create new links
-				const float* va = &tile->verts[poly->verts[j]*3];
-				const float* vb = &tile->verts[poly->verts[(j+1) % nv]*3];
+				float ta[3], tb[3];
+				const float* va = tile->getVert(poly->verts[j], ta);
+				const float* vb = tile->getVert(poly->verts[(j+1) % nv], tb);
 				
 				if (side == 0 || side == 4)
 				{
@@ -472,10 +497,11 @@ void duDebugDrawNavMeshPoly(duDebugDraw* dd, const dtNavMesh& mesh, dtPolyRef re
 			const unsigned char* t = &tile->detailTris[(pd->triBase+i)*4];
 			for (int j = 0; j < 3; ++j)
 			{
+				float tmp[3];
 				if (t[j] < poly->vertCount)
-					dd->vertex(&tile->verts[poly->verts[t[j]]*3], c);
+					dd->vertex(tile->getVert(poly->verts[t[j]], tmp), c);
 				else
-					dd->vertex(&tile->detailVerts[(pd->vertBase+t[j]-poly->vertCount)*3], c);
+					dd->vertex(tile->getDetailVert(pd->vertBase+t[j]-poly->vertCount, tmp), c);
 			}
 		}
 		dd->end();
@@ -22,6 +22,12 @@
 #include "DetourMath.h"
 #include <stddef.h>
 
+// SSE2 is used for testing several bounding boxes or triangles at once. Define DT_NO_SIMD to use plain C++.
+#if !defined(DT_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define DT_SSE2 1
+#include <emmintrin.h>
+#endif
+
 /**
 @defgroup detour Detour
 
@@ -362,6 +368,44 @@ inline bool dtOverlapQuantBounds(const unsigned short amin[3], const unsigned sh
 	return overlap;
 }
 
+/// Determines which of four axis-aligned bounding boxes overlap a box.
+///  @param[in]		amin	Minimum bounds of box A. [(x, y, z)]
+///  @param[in]		amax	Maximum bounds of box A. [(x, y, z)]
+///  @param[in]		bmin	Minimum bounds of the four boxes, stored per axis. [(x * 4, y * 4, z * 4)]
+///  @param[in]		bmax	Maximum bounds of the four boxes, stored per axis. [(x * 4, y * 4, z * 4)]
+/// @return A mask with bit i set if box i overlaps box A.
+/// @see dtOverlapQuantBounds, dtBVWideNode
+inline int dtOverlapQuantBounds4(const unsigned short amin[3], const unsigned short amax[3],
+								 const unsigned short bmin[12], const unsigned short bmax[12])
+{
+#ifdef DT_SSE2
+	// For unsigned shorts a <= b when the saturated a - b is zero.
+	const __m128i aminXY = _mm_unpacklo_epi64(_mm_set1_epi16((short)amin[0]), _mm_set1_epi16((short)amin[1]));
+	const __m128i amaxXY = _mm_unpacklo_epi64(_mm_set1_epi16((short)amax[0]), _mm_set1_epi16((short)amax[1]));
+	const __m128i aminZ = _mm_set1_epi16((short)amin[2]);
+	const __m128i amaxZ = _mm_set1_epi16((short)amax[2]);
+	const __m128i bminXY = _mm_loadu_si128((const __m128i*)bmin);
+	const __m128i bmaxXY = _mm_loadu_si128((const __m128i*)bmax);
+	const __m128i bminZ = _mm_loadl_epi64((const __m128i*)(bmin + 8));
+	const __m128i bmaxZ = _mm_loadl_epi64((const __m128i*)(bmax + 8));
+	__m128i sep = _mm_or_si128(_mm_subs_epu16(bminXY, amaxXY), _mm_subs_epu16(aminXY, bmaxXY));
+	sep = _mm_or_si128(sep, _mm_unpackhi_epi64(sep, sep));
+	sep = _mm_or_si128(sep, _mm_or_si128(_mm_subs_epu16(bminZ, amaxZ), _mm_subs_epu16(aminZ, bmaxZ)));
+	const __m128i overlap = _mm_cmpeq_epi16(sep, _mm_setzero_si128());
+	return _mm_movemask_epi8(_mm_packs_epi16(overlap, overlap)) & 0xf;
+#else
+	int mask = 0;
+	for (int i = 0; i < 4; ++i)
+	{
+		if (amin[0] <= bmax[i] && amax[0] >= bmin[i] &&
+			amin[1] <= bmax[4+i] && amax[1] >= bmin[4+i] &&
+			amin[2] <= bmax[8+i] && amax[2] >= bmin[8+i])
+			mask |= 1 << i;
+	}
+	return mask;
+#endif
+}
+
 /// Determines if two axis-aligned bounding boxes overlap.
 ///  @param[in]		amin	Minimum bounds of box A. [(x, y, z)]
 ///  @param[in]		amax	Maximum bounds of box A. [(x, y, z)]
@@ -396,6 +440,15 @@ void dtClosestPtPointTriangle(float* closest, const float* p,
 ///  @param[out]	h		The resulting height.
 bool dtClosestHeightPointTriangle(const float* p, const float* a, const float* b, const float* c, float& h);
 
+/// Derives the y-axis height of the point on the first of four triangles the point is over.
+/// Gives the same result as calling #dtClosestHeightPointTriangle on each triangle in turn.
+///  @param[in]		p		The reference point from which to test. [(x, y, z)]
+///  @param[in]		tris	The vertices of the four triangles, stored per vertex and axis. Unused
+///  						triangles can be left zeroed. [(ax * 4, ay * 4, az * 4, bx * 4, ... cz * 4)]
+///  @param[out]	h		The resulting height.
+/// @return The index of the triangle, or -1 if the point is not over any of them.
+int dtClosestHeightPointTriangle4(const float* p, const float* tris, float& h);
+
 bool dtIntersectSegmentPoly2D(const float* p0, const float* p1,
 							  const float* verts, int nverts,
 							  float& tmin, float& tmax,
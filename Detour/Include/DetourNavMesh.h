@@ -70,7 +70,7 @@ static const int DT_VERTS_PER_POLYGON = 6;
 static const int DT_NAVMESH_MAGIC = 'D'<<24 | 'N'<<16 | 'A'<<8 | 'V';
 
 /// A version number used to detect compatibility of navigation tile data.
-static const int DT_NAVMESH_VERSION = 7;
+static const int DT_NAVMESH_VERSION = 10;
 
 /// A magic number used to detect the compatibility of navigation tile states.
 static const int DT_NAVMESH_STATE_MAGIC = 'D'<<24 | 'N'<<16 | 'M'<<8 | 'S';
@@ -94,12 +94,56 @@ static const unsigned int DT_OFFMESH_CON_BIDIR = 1;
 /// @ingroup detour
 static const int DT_MAX_AREAS = 64;
 
+/// The storage formats of the vertices in the tile data.
+/// @see dtMeshHeader::vertFormat
+enum dtVertFormat
+{
+	/// The vertices are stored as floats.
+	DT_VERTFORMAT_FLOAT = 0,
+	
+	/// The polygon and detail mesh vertices are stored as 16-bit offsets from the tile's bmin.
+	/// (The off-mesh connection vertices are still floats.)
+	DT_VERTFORMAT_QUANTIZED = 1,
+};
+
+/// The layouts of the bounding volume tree in the tile data.
+/// @see dtMeshHeader::bvFormat
+enum dtBVFormat
+{
+	/// A binary tree of dtBVNode, stored depth first with escape indices.
+	DT_BVFORMAT_BINARY = 0,
+	
+	/// A 4-ary tree of dtBVWideNode, which tests the bounds of all the children of a node together.
+	DT_BVFORMAT_WIDE = 1,
+};
+
+/// The number of children of a dtBVWideNode.
+/// @ingroup detour
+static const int DT_BVWIDE_WIDTH = 4;
+
+/// The traversal stack size needed by the deepest wide bounding volume tree dtCreateNavMeshData() builds.
+/// @ingroup detour
+static const int DT_BVWIDE_STACK_SIZE = 256;
+
+/// The maximum number of cells along each axis of a dtPolyDetailGrid.
+/// @ingroup detour
+static const int DT_DETAIL_GRID_MAX_SIZE = 16;
+
+/// The maximum number of cells along each axis of a tile's polygon lookup grid. The tiles
+/// that would need more cells get no grid. (See: dtNavMeshParams::polyGridCellSize)
+/// @ingroup detour
+static const int DT_POLY_GRID_MAX_SIZE = 256;
+
 /// Tile flags used for various functions and fields.
 /// For an example, see dtNavMesh::addTile().
 enum dtTileFlags
 {
 	/// The navigation mesh owns the tile memory and is responsible for freeing it.
 	DT_TILE_FREE_DATA = 0x01,
+
+	/// The tile memory belongs to the base mesh of a shared navigation mesh. (See: dtNavMesh::initShared)
+	/// Set by the navigation mesh, not accepted by dtNavMesh::addTile.
+	DT_TILE_SHARED_DATA = 0x02,
 };
 
 /// Vertex flags returned by dtNavMeshQuery::findStraightPath.
@@ -201,6 +245,20 @@ struct dtPolyDetail
 	unsigned int triBase;			///< The offset of the triangles in the dtMeshTile::detailTris array.
 	unsigned char vertCount;		///< The number of vertices in the sub-mesh.
 	unsigned char triCount;			///< The number of triangles in the sub-mesh.
+	unsigned short grid;			///< One plus the index of the sub-mesh's grid in dtMeshTile::detailGrids, or zero if it has none.
+};
+
+/// A grid over a detail sub-mesh, listing the triangles that overlap each cell on the xz-plane.
+/// @note This structure is rarely if ever used by the end user.
+/// @see dtMeshTile::detailGrids
+struct dtPolyDetailGrid
+{
+	float bmin[2];					///< The minimum bounds of the grid. [(x, z)]
+	float invCellSize[2];			///< The inverse of the cell size. [(x, z)]
+	unsigned int cellBase;			///< The offset of the cells in the dtMeshTile::detailGridCells array.
+	unsigned int triBase;			///< The offset of the triangle lists in the dtMeshTile::detailGridTris array.
+	unsigned char width;			///< The number of cells along the x-axis.
+	unsigned char height;			///< The number of cells along the z-axis.
 };
 
 /// Defines a link between polygons.
@@ -227,6 +285,30 @@ struct dtBVNode
 	int i;							///< The node's index. (Negative for escape sequence.)
 };
 
+/// Wide bounding volume node.
+/// The bounds are stored per axis, so that the children of the node can be tested together.
+/// Unused children have empty bounds (bmin > bmax) and a zero index.
+/// @note This structure is rarely if ever used by the end user.
+/// @see dtMeshTile
+struct dtBVWideNode
+{
+	unsigned short bmin[3][DT_BVWIDE_WIDTH];	///< Minimum bounds of the children's AABBs. [(x, y, z) * DT_BVWIDE_WIDTH]
+	unsigned short bmax[3][DT_BVWIDE_WIDTH];	///< Maximum bounds of the children's AABBs. [(x, y, z) * DT_BVWIDE_WIDTH]
+	int child[DT_BVWIDE_WIDTH];					///< The index of a child node, or the bitwise not of a polygon index for a leaf.
+};
+
+/// A portal edge on the border of a tile, projected on the border plane.
+/// @note This structure is rarely if ever used by the end user.
+/// @see dtMeshTile::borderEdges
+struct dtBorderEdge
+{
+	float pos;						///< The coordinate of the edge along the axis the side faces.
+	float bmin[2];					///< The end point with the smaller coordinate along the border. [(u, y)]
+	float bmax[2];					///< The end point with the larger coordinate along the border. [(u, y)]
+	unsigned short poly;			///< The index of the polygon in the tile.
+	unsigned short edge;			///< The index of the polygon edge.
+};
+
 /// Defines an navigation mesh off-mesh connection within a dtMeshTile object.
 /// An off-mesh connection is a user defined traversable connection made up to two vertices.
 struct dtOffMeshConnection
@@ -282,6 +364,14 @@ struct dtMeshHeader
 	
 	/// The bounding volume quantization factor. 
 	float bvQuantFactor;
+	
+	int vertFormat;				///< The storage format of the vertices. (See: #dtVertFormat)
+	float vertStep[3];			///< The quantization step of the polygon vertices. [(x, y, z)]
+	float detailVertStep[3];	///< The quantization step of the detail mesh vertices. [(x, y, z)]
+	int bvFormat;				///< The layout of the bounding volume tree. (See: #dtBVFormat)
+	int detailGridCount;		///< The number of detail sub-mesh grids.
+	int detailGridCellCount;	///< The number of cell offsets of the detail sub-mesh grids.
+	int detailGridTriCount;		///< The number of triangle indices in the detail sub-mesh grids.
 };
 
 /// Defines a navigation mesh tile.
@@ -293,7 +383,7 @@ struct dtMeshTile
 	unsigned int linksFreeList;			///< Index to the next free link.
 	dtMeshHeader* header;				///< The tile header.
 	dtPoly* polys;						///< The tile polygons. [Size: dtMeshHeader::polyCount]
-	float* verts;						///< The tile vertices. [Size: dtMeshHeader::vertCount]
+	float* verts;						///< The tile vertices. [Size: dtMeshHeader::vertCount] (See: #getVert)
 	dtLink* links;						///< The tile links. [Size: dtMeshHeader::maxLinkCount]
 	dtPolyDetail* detailMeshes;			///< The tile's detail sub-meshes. [Size: dtMeshHeader::detailMeshCount]
 	
@@ -308,12 +398,93 @@ struct dtMeshTile
 	/// (Will be null if bounding volumes are disabled.)
 	dtBVNode* bvTree;
 
+	/// The tile wide bounding volume nodes, if the tree is stored as #DT_BVFORMAT_WIDE.
+	/// (#bvTree is null then.) [Size: dtMeshHeader::bvNodeCount]
+	dtBVWideNode* bvWideTree;
+
 	dtOffMeshConnection* offMeshCons;		///< The tile off-mesh connections. [Size: dtMeshHeader::offMeshConCount]
+
+	/// The grids over the detail sub-meshes with many triangles. [Size: dtMeshHeader::detailGridCount]
+	dtPolyDetailGrid* detailGrids;
+
+	/// The start of the triangle list of each grid cell, relative to dtPolyDetailGrid::triBase,
+	/// followed by the end of the last cell of the grid. [Size: dtMeshHeader::detailGridCellCount]
+	unsigned short* detailGridCells;
+
+	/// The triangles overlapping the grid cells, as indices within their sub-mesh. [Size: dtMeshHeader::detailGridTriCount]
+	unsigned char* detailGridTris;
+
+	/// The quantized polygon vertices, or null if the vertices are floats. If set, #verts holds
+	/// only the off-mesh connection vertices. [(x, y, z) * (vertCount - 2*offMeshConCount)]
+	unsigned short* quantVerts;
+
+	/// The quantized detail mesh vertices, or null if #detailVerts is used. [(x, y, z) * dtMeshHeader::detailVertCount]
+	unsigned short* quantDetailVerts;
+
+	/// The portal edges of the tile, grouped by side and sorted by dtBorderEdge::bmin
+	/// within each side. Built when the tile is added. [Size: borderEdgeBase[8]]
+	dtBorderEdge* borderEdges;
+	int borderEdgeBase[9];					///< The index of the first border edge of each side.
+	float borderEdgeMaxLen[8];				///< The longest border edge of each side, along the border.
+
+	/// The polygons overlapping each cell of the tile's polygon lookup grid, as the index of the first
+	/// polygon of each cell in #polyGridPolys, followed by the end of the last cell. Built when the
+	/// tile is added, null if the mesh has no polygon grids or the tile needs more than
+	/// #DT_POLY_GRID_MAX_SIZE cells along an axis. (See: dtNavMeshParams::polyGridCellSize)
+	/// [Size: polyGridWidth * polyGridHeight + 1]
+	unsigned int* polyGridCells;
+	unsigned short* polyGridPolys;			///< The polygon indices of the grid cells. (Stored after #polyGridCells.)
+	int polyGridWidth;						///< The number of polygon grid cells along the x-axis.
+	int polyGridHeight;						///< The number of polygon grid cells along the z-axis.
 		
 	unsigned char* data;					///< The tile data. (Not directly accessed under normal situations.)
 	int dataSize;							///< Size of the tile data.
 	int flags;								///< Tile flags. (See: #dtTileFlags)
 	dtMeshTile* next;						///< The next free tile, or the next tile in the spatial grid.
+
+	/// The header followed by the compressed tile data, or null if the tile is not compressed.
+	/// While the tile is compressed, only #header is valid. (See: dtNavMesh::setTileCompression)
+	unsigned char* compressedData;
+	int compressedSize;						///< Size of the compressed tile data.
+	unsigned int lastUsed;					///< The use count of the navigation mesh when the tile was last used.
+
+	/// The copy of the polygons, links and off-mesh connection vertices of a tile with #DT_TILE_SHARED_DATA,
+	/// made when they are first changed. Null while the tile uses the shared data.
+	unsigned char* overlay;
+
+	/// Gets a polygon vertex of the tile.
+	///  @param[in]		i		The index of the vertex.
+	///  @param[out]	tmp		Receives the vertex if it has to be decoded. [(x, y, z)]
+	/// @return The vertex, either in the tile or in @p tmp. [(x, y, z)]
+	inline const float* getVert(const int i, float* tmp) const
+	{
+		if (!quantVerts)
+			return &verts[i*3];
+		const int nq = header->vertCount - header->offMeshConCount*2;
+		if (i >= nq)
+			return &verts[(i-nq)*3];
+		const unsigned short* q = &quantVerts[i*3];
+		tmp[0] = header->bmin[0] + q[0]*header->vertStep[0];
+		tmp[1] = header->bmin[1] + q[1]*header->vertStep[1];
+		tmp[2] = header->bmin[2] + q[2]*header->vertStep[2];
+		return tmp;
+	}
+
+	/// Gets a unique detail mesh vertex of the tile.
+	///  @param[in]		i		The index of the vertex.
+	///  @param[out]	tmp		Receives the vertex if it has to be decoded. [(x, y, z)]
+	/// @return The vertex, either in the tile or in @p tmp. [(x, y, z)]
+	inline const float* getDetailVert(const int i, float* tmp) const
+	{
+		if (!quantDetailVerts)
+			return &detailVerts[i*3];
+		const unsigned short* q = &quantDetailVerts[i*3];
+		tmp[0] = header->bmin[0] + q[0]*header->detailVertStep[0];
+		tmp[1] = header->bmin[1] + q[1]*header->detailVertStep[1];
+		tmp[2] = header->bmin[2] + q[2]*header->detailVertStep[2];
+		return tmp;
+	}
+
 private:
 	dtMeshTile(const dtMeshTile&);
 	dtMeshTile& operator=(const dtMeshTile&);
@@ -339,6 +510,49 @@ struct dtNavMeshParams
 	float tileHeight;				///< The height of each tile. (Along the z-axis.)
 	int maxTiles;					///< The maximum number of tiles the navigation mesh can contain. This and maxPolys are used to calculate how many bits are needed to identify tiles and polygons uniquely.
 	int maxPolys;					///< The maximum number of polygons each tile can contain. This and maxTiles are used to calculate how many bits are needed to identify tiles and polygons uniquely.
+	int gridWidth;					///< The number of tiles along the x-axis of the dense tile lookup grid, or zero to look up all tiles by hash. [Limit: >= 0]
+	int gridHeight;					///< The number of tiles along the z-axis of the dense tile lookup grid, or zero to look up all tiles by hash. [Limit: >= 0]
+	int gridLayers;					///< The number of layers per cell of the dense tile lookup grid. (Zero is the same as one.) [Limit: >= 0]
+	float polyGridCellSize;			///< The cell size of the per tile polygon lookup grids, or zero for no grids. [Limit: >= 0] [Unit: wu]
+};
+
+/// Tile compression statistics. The counters add up until dtNavMesh::resetTileCompressionStats().
+/// @ingroup detour
+struct dtTileCompressionStats
+{
+	unsigned int hits;			///< Tile uses that found the tile uncompressed.
+	unsigned int misses;		///< Tile uses that decompressed the tile.
+	unsigned int compressions;	///< Tiles compressed.
+	unsigned int failures;		///< Compressions and decompressions that failed.
+	int residentTiles;			///< The number of tiles that could be compressed, but are not.
+	int compressedTiles;		///< The number of compressed tiles.
+	size_t compressedBytes;		///< The size of the compressed tiles.
+	size_t uncompressedBytes;	///< The size of the compressed tiles when decompressed.
+};
+
+class dtTileCompressor;
+
+/// A function that processes the items [@p begin, @p end) of a parallel loop.
+typedef void (*dtParallelForFunc)(void* userData, const int begin, const int end);
+
+/// Runs the independent work items of batched navigation mesh operations, such as dtNavMesh::addTiles.
+/// The default implementation runs all items on the calling thread. Override #parallelFor to
+/// spread the items over a job system.
+/// @ingroup detour
+class dtTaskRunner
+{
+public:
+	virtual ~dtTaskRunner() {}
+
+	/// Calls @p func for the items [0, @p count), split into ranges in any way and in any order,
+	/// and returns once all the items are done. The items do not allocate memory.
+	///  @param[in]		count		The number of items.
+	///  @param[in]		func		The function processing a range of items.
+	///  @param[in]		userData	The data passed to @p func.
+	virtual void parallelFor(const int count, dtParallelForFunc func, void* userData)
+	{
+		func(userData, 0, count);
+	}
 };
 
 /// A navigation mesh based on tiles of convex polygons.
@@ -364,6 +578,12 @@ public:
 	/// @return The status flags for the operation.
 	///  @see dtCreateNavMeshData
 	dtStatus init(unsigned char* data, const int dataSize, const int flags);
+
+	/// Initializes the navigation mesh to share the tiles of another navigation mesh.
+	///  @param[in]	base		The navigation mesh whose tiles are shared. It must outlive this mesh,
+	///							and must not change while this mesh exists.
+	/// @return The status flags for the operation.
+	dtStatus initShared(const dtNavMesh* base);
 	
 	/// The navigation mesh initialization params.
 	const dtNavMeshParams* getParams() const;
@@ -376,6 +596,17 @@ public:
 	///  @param[out]	result		The tile reference. (If the tile was succesfully added.) [opt]
 	/// @return The status flags for the operation.
 	dtStatus addTile(unsigned char* data, int dataSize, int flags, dtTileRef lastRef, dtTileRef* result);
+
+	/// Adds several tiles to the navigation mesh, connecting them once all of them are in place.
+	///  @param[in]		data		Data for each new tile mesh. (See: #dtCreateNavMeshData) [Size: @p count]
+	///  @param[in]		dataSizes	Data size of each new tile mesh. [Size: @p count]
+	///  @param[in]		count		The number of tiles to add.
+	///  @param[in]		flags		Tile flags for all the tiles. (See: #dtTileFlags)
+	///  @param[out]	results		The tile references. (If the tiles were succesfully added.) [opt] [Size: @p count]
+	///  @param[in]		runner		Runs the link building work in parallel. [opt]
+	/// @return The status flags for the operation.
+	dtStatus addTiles(unsigned char** data, const int* dataSizes, const int count, int flags,
+					  dtTileRef* results, dtTaskRunner* runner = 0);
 	
 	/// Removes the specified tile from the navigation mesh.
 	///  @param[in]		ref			The reference of the tile to remove.
@@ -438,6 +669,22 @@ public:
 	/// @return The tile at the specified index.
 	const dtMeshTile* getTile(int i) const;
 
+	/// Gets the header of the tile at the specified index, without decompressing the tile
+	/// or marking it used. (See: #setTileCompression)
+	///  @param[in]	i		The tile index. [Limit: 0 >= index < #getMaxTiles()]
+	/// @return The header of the tile, or null if there is no tile at the index.
+	const dtMeshHeader* getTileHeader(int i) const { return m_tiles[i].header; }
+
+	/// Gets the salt of the tile at the specified index, without decompressing the tile
+	/// or marking it used. The salt changes each time the tile is removed.
+	///  @param[in]	i		The tile index. [Limit: 0 >= index < #getMaxTiles()]
+	/// @return The salt of the tile.
+	unsigned int getTileSalt(int i) const { return m_tiles[i].salt; }
+
+	/// Gets a counter that changes each time a tile is added or removed.
+	/// @return The tile generation of the navigation mesh.
+	unsigned int getTileGeneration() const { return m_tileGeneration; }
+
 	/// Gets the tile and polygon for the specified polygon reference.
 	///  @param[in]		ref		The reference for the a polygon.
 	///  @param[out]	tile	The tile containing the polygon.
@@ -449,7 +696,8 @@ public:
 	///  @param[in]		ref		A known valid reference for a polygon.
 	///  @param[out]	tile	The tile containing the polygon.
 	///  @param[out]	poly	The polygon.
-	void getTileAndPolyByRefUnsafe(const dtPolyRef ref, const dtMeshTile** tile, const dtPoly** poly) const;
+	/// @return The status flags for the operation.
+	dtStatus getTileAndPolyByRefUnsafe(const dtPolyRef ref, const dtMeshTile** tile, const dtPoly** poly) const;
 
 	/// Checks the validity of a polygon reference.
 	///  @param[in]	ref		The polygon reference to check.
@@ -525,6 +773,32 @@ public:
 	
 	/// @}
 
+	/// @{
+	/// @name Tile Compression
+
+	/// Enables the compression of the tiles that have not been used recently.
+	///  @param[in]	compressor			Compresses the tile data, or null to decompress all the tiles
+	///									and disable the compression.
+	///  @param[in]	maxResidentTiles	The number of tiles #compressColdTiles leaves uncompressed. [Limit: >= 0]
+	/// @return The status flags for the operation.
+	dtStatus setTileCompression(dtTileCompressor* compressor, const int maxResidentTiles);
+
+	/// Returns true if tile compression is enabled.
+	bool isTileCompressionEnabled() const { return m_compressor != 0; }
+
+	/// Compresses the least recently used tiles, until at most the resident tile budget is uncompressed.
+	/// @return The status flags for the operation.
+	dtStatus compressColdTiles();
+
+	/// Gets the tile compression statistics.
+	///  @param[out]	stats		The statistics.
+	void getTileCompressionStats(dtTileCompressionStats* stats) const;
+
+	/// Resets the counters of the tile compression statistics.
+	void resetTileCompressionStats();
+
+	/// @}
+
 	/// @{
 	/// @name Encoding and Decoding
 	/// These functions are generally meant for internal use only.
@@ -624,10 +898,33 @@ private:
 	/// Returns pointer to tile in the tile array.
 	dtMeshTile* getTile(int i);
 
+	/// Returns the dense lookup cell of the tile location, or null if it is outside the grid.
+	dtMeshTile** getGridCell(const int x, const int y) const;
+
+	/// Returns the tile at the index, without decompressing it or marking it used.
+	inline const dtMeshTile* peekTile(int i) const { return &m_tiles[i]; }
+
+	/// Returns the tile at the location, without marking it used.
+	dtMeshTile* findTileAt(const int x, const int y, const int layer) const;
+
 	/// Returns neighbour tile based on side.
 	int getTilesAt(const int x, const int y,
 				   dtMeshTile** tiles, const int maxTiles) const;
 
+	/// Decompresses the tile if needed and marks it used, when tile compression is enabled.
+	/// Returns false if the tile could not be decompressed.
+	inline bool useTile(const dtMeshTile* tile) const { return !m_compressor || touchTile(tile); }
+	bool touchTile(const dtMeshTile* tile) const;
+	bool compressTile(dtMeshTile* tile);
+	bool decompressTile(dtMeshTile* tile) const;
+
+	/// Copies the shared polygons, links and off-mesh connection vertices of the tile, before they are changed.
+	bool unshareTile(dtMeshTile* tile);
+	/// Decompresses and unshares the tiles that a tile at the location links to, before the links are changed.
+	bool prepareTilesAround(const int x, const int y, const dtMeshTile* skip = 0);
+	/// Adds the tile to the dense grid or to the hash lookup.
+	void addTileToLookup(dtMeshTile* tile);
+
 	/// Returns neighbour tile based on side.
 	int getNeighbourTilesAt(const int x, const int y, const int side,
 							dtMeshTile** tiles, const int maxTiles) const;
@@ -636,6 +933,19 @@ private:
 	int findConnectingPolys(const float* va, const float* vb,
 							const dtMeshTile* tile, int side,
 							dtPolyRef* con, float* conarea, int maxcon) const;
+
+	/// Builds the sorted index of the portal edges of a tile.
+	bool buildBorderEdges(dtMeshTile* tile);
+
+	/// Builds the polygon lookup grid of the tile.
+	bool buildPolyGrid(dtMeshTile* tile);
+
+	/// Claims a tile for the data and adds it to the tile lookup, without connecting it.
+	dtStatus insertTile(unsigned char* data, int dataSize, int flags, dtTileRef lastRef, dtMeshTile** result);
+
+	/// Work items of #addTiles, connecting the links inside new tiles, and the links across tile borders.
+	static void connectTilesTask(void* userData, const int begin, const int end);
+	static void connectBordersTask(void* userData, const int begin, const int end);
 	
 	/// Builds internal polygons links for a tile.
 	void connectIntLinks(dtMeshTile* tile);
@@ -672,8 +982,18 @@ private:
 	int m_tileLutMask;					///< Tile hash lookup mask.
 
 	dtMeshTile** m_posLookup;			///< Tile hash lookup.
+	dtMeshTile** m_tileGrid;			///< Dense tile lookup, by (x + y*width)*layers + layer. [Size: width * height * layers] [opt]
+	int m_gridWidth, m_gridHeight;		///< Dimensions of the dense tile lookup, in tiles.
+	int m_gridLayers;					///< Number of layers per cell in the dense tile lookup.
+	int m_gridOverflow;					///< Number of tiles within the dense grid that are in the hash lookup, because of their layer.
 	dtMeshTile* m_nextFree;				///< Freelist of tiles.
 	dtMeshTile* m_tiles;				///< List of tiles.
+
+	dtTileCompressor* m_compressor;		///< Compresses the cold tiles, or null if tile compression is disabled.
+	int m_maxResidentTiles;				///< The number of tiles left uncompressed by #compressColdTiles.
+	mutable unsigned int m_tileUseCount;	///< Counts the tile uses, for finding the least recently used tiles.
+	unsigned int m_tileGeneration;		///< Counts the tiles added and removed.
+	mutable dtTileCompressionStats m_compressionStats;
 		
 #ifndef DT_POLYREF64
 	unsigned int m_saltBits;			///< Number of salt bits in the tile ID.
@@ -682,6 +1002,7 @@ private:
 #endif
 
 	friend class dtNavMeshQuery;
+	friend class dtNavMeshIslands;
 };
 
 /// Allocates a navigation mesh object using the Detour allocator.
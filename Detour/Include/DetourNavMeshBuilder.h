@@ -101,6 +101,19 @@ struct dtNavMeshCreateParams
 	/// @note The BVTree is not normally needed for layered navigation meshes.
 	bool buildBvTree;
 
+	/// True if the bounding volume tree should be built as a 4-ary tree of dtBVWideNode.
+	/// The wide tree is smaller and faster to query. (Used only if #buildBvTree is true.)
+	bool wideBvTree;
+
+	/// True if the polygon and detail mesh vertices should be stored as 16-bit offsets from #bmin.
+	/// The polygon vertices keep the #cs and #ch precision of #verts, the detail mesh vertices
+	/// are rounded to 1/65535 of the tile bounds.
+	bool quantizeVerts;
+
+	/// True if the detail meshes with many triangles should get a grid of the triangles over each cell,
+	/// so that finding the height on a polygon tests only a few triangles. (Used only if #detailMeshes is set.)
+	bool buildDetailGrids;
+
 	/// @}
 };
 
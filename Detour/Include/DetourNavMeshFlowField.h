@@ -0,0 +1,138 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURNAVMESHFLOWFIELD_H
+#define DETOURNAVMESHFLOWFIELD_H
+
+#include <float.h>
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+
+class dtQueryFilter;
+
+/// The cost from every polygon of a navigation mesh to a goal, and the next polygon toward
+/// the goal. Many agents heading to the same goal can follow it without searching.
+///
+/// The field is found by a search from the goal against the links.
+/// (See: dtNavMeshQuery::findFlowField)
+/// @ingroup detour
+class dtNavMeshFlowField
+{
+public:
+	dtNavMeshFlowField();
+	~dtNavMeshFlowField();
+
+	/// Initializes the flow field. The field is found by dtNavMeshQuery::findFlowField.
+	///  @param[in]		nav		The navigation mesh.
+	/// @return The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav);
+
+	/// Marks the polygons of the tile of the polygon out of date, e.g. after the flags of
+	/// the polygon have changed. Adding and removing tiles is found by
+	/// dtNavMeshQuery::updateFlowField.
+	///  @param[in]		ref		The polygon reference.
+	void invalidatePoly(dtPolyRef ref);
+
+	const dtNavMesh* getNavMesh() const { return m_nav; }
+	dtPolyRef getGoalRef() const { return m_goalRef; }
+	const float* getGoalPos() const { return m_goalPos; }
+
+	/// Gets the cost from a polygon to the goal.
+	///  @param[in]		ref		The polygon reference.
+	/// @return The cost, or FLT_MAX if the goal cannot be reached or it is not known.
+	inline float getCost(dtPolyRef ref) const
+	{
+		int ip;
+		const TileField* tf = getTileField(ref, ip);
+		return tf ? tf->costs[ip] : FLT_MAX;
+	}
+
+	/// Gets the next polygon from a polygon toward the goal.
+	///  @param[in]		ref		The polygon reference.
+	/// @return The next polygon, or zero at the goal, or if the goal cannot be reached
+	///  or it is not known.
+	inline dtPolyRef getNextRef(dtPolyRef ref) const
+	{
+		int ip;
+		const TileField* tf = getTileField(ref, ip);
+		return tf ? tf->next[ip] : 0;
+	}
+
+	/// Gets the path from a polygon to the goal, following the next polygons.
+	///  @param[in]		startRef	The reference id of the start polygon.
+	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to goal.)
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	/// @returns The status flags for the query.
+	dtStatus getPath(dtPolyRef startRef, dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtNavMeshFlowField(const dtNavMeshFlowField&);
+	dtNavMeshFlowField& operator=(const dtNavMeshFlowField&);
+
+	friend class dtNavMeshQuery;
+
+	struct TileField
+	{
+		unsigned int salt;		///< The salt of the tile the field was allocated for.
+		int polyCount;			///< The number of polygons of the tile, zero if there is no tile.
+		bool dirty;				///< True if the polygons of the tile are searched at the next update.
+		float* costs;			///< The cost of each polygon to the goal. [Size: polyCount]
+		dtPolyRef* next;		///< The next polygon of each polygon toward the goal. [Size: polyCount]
+	};
+
+	inline const TileField* getTileField(dtPolyRef ref, int& ip) const
+	{
+		unsigned int salt, it, uip;
+		m_nav->decodePolyId(ref, salt, it, uip);
+		if (it >= (unsigned int)m_maxTiles)
+			return 0;
+		const TileField* tf = &m_tiles[it];
+		if (tf->dirty || tf->salt != salt || uip >= (unsigned int)tf->polyCount)
+			return 0;
+		ip = (int)uip;
+		return tf;
+	}
+
+	void destroy();
+
+	/// Reallocates the field of the tiles that have been added or removed, and resets the
+	/// field of the changed tiles. Returns false if it runs out of memory.
+	bool syncTiles();
+
+	const dtNavMesh* m_nav;
+	const dtQueryFilter* m_filter;
+	dtPolyRef m_goalRef;
+	float m_goalPos[3];
+	TileField* m_tiles;
+	int m_maxTiles;
+};
+
+/// Allocates a flow field object using the Detour allocator.
+/// @return A flow field object that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtNavMeshFlowField* dtAllocNavMeshFlowField();
+
+/// Frees the specified flow field object using the Detour allocator.
+///  @param[in]	field		A flow field object allocated using #dtAllocNavMeshFlowField
+///  @ingroup detour
+void dtFreeNavMeshFlowField(dtNavMeshFlowField* field);
+
+#endif // DETOURNAVMESHFLOWFIELD_H
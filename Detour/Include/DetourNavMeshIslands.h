@@ -0,0 +1,179 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURNAVMESHISLANDS_H
+#define DETOURNAVMESHISLANDS_H
+
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+
+/// The maximum number of flag sets of the islands.
+/// @ingroup detour
+static const int DT_MAX_ISLAND_FLAG_SETS = 8;
+
+/// The connected parts of a navigation mesh, the islands, for a few sets of include
+/// and exclude flags.
+///
+/// Two polygons passing the flags of a set are on the same island if the polygons between
+/// them pass the flags too. Polygons on different islands cannot reach each other, so
+/// dtNavMeshQuery::findPath can return without searching.
+///
+/// Any link joins two islands, including a one way off-mesh connection, so polygons on the
+/// same island may still not reach each other.
+///
+/// The islands are out of date from the time tiles are added, removed or invalidated until
+/// the next #update, and no polygons are known to be on different islands meanwhile. The
+/// flags of polygons changed without #invalidatePoly are not noticed.
+/// @see dtNavMeshQuery::setIslands
+/// @ingroup detour
+class dtNavMeshIslands
+{
+public:
+	dtNavMeshIslands();
+	~dtNavMeshIslands();
+
+	/// Initializes the islands. The islands are found by #update.
+	///  @param[in]		nav		The navigation mesh.
+	/// @return The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav);
+
+	/// Adds a set of flags to find the islands for. The flags match dtQueryFilter::passFilter.
+	///  @param[in]		includeFlags	The flags of the polygons to include.
+	///  @param[in]		excludeFlags	The flags of the polygons to exclude.
+	/// @return The index of the flag set, or -1 if there are #DT_MAX_ISLAND_FLAG_SETS sets already.
+	int addFlagSet(const unsigned short includeFlags, const unsigned short excludeFlags);
+
+	/// Finds a flag set.
+	///  @param[in]		includeFlags	The flags of the polygons to include.
+	///  @param[in]		excludeFlags	The flags of the polygons to exclude.
+	/// @return The index of the flag set, or -1 if there is none.
+	int findFlagSet(const unsigned short includeFlags, const unsigned short excludeFlags) const;
+
+	int getFlagSetCount() const { return m_flagSetCount; }
+
+	/// Marks the islands of the tile of the polygon out of date, e.g. after the flags of
+	/// the polygon have changed. Adding and removing tiles is found by #update.
+	///  @param[in]		ref		The polygon reference.
+	void invalidatePoly(dtPolyRef ref);
+
+	/// Marks every island out of date.
+	void invalidate();
+
+	/// Finds the islands of the tiles that have been added, removed or invalidated.
+	/// Only the islands that touch these tiles are searched again.
+	/// @return The status flags for the operation.
+	dtStatus update();
+
+	/// Returns true if no tile has been added, removed or invalidated since the last #update.
+	/// (See: dtNavMesh::getTileGeneration)
+	bool isUpToDate() const;
+
+	const dtNavMesh* getNavMesh() const { return m_nav; }
+
+	/// Gets the island of a polygon.
+	///  @param[in]		ref			The polygon reference.
+	///  @param[in]		flagSet		The index of the flag set.
+	/// @return The island, or zero if the polygon does not pass the flags, or the island is not known.
+	inline unsigned int getIsland(dtPolyRef ref, const int flagSet) const
+	{
+		if (flagSet < 0 || flagSet >= m_flagSetCount)
+			return 0;
+		unsigned int salt, it, ip;
+		m_nav->decodePolyId(ref, salt, it, ip);
+		if (it >= (unsigned int)m_maxTiles)
+			return 0;
+		const TileIslands& ti = m_tiles[it];
+		if (ti.dirty || ti.salt != salt || ip >= (unsigned int)ti.polyCount)
+			return 0;
+		const unsigned int label = ti.labels[ip*m_flagSetCount + flagSet];
+		if (label == 0 || label == UNSET_LABEL)
+			return 0;
+		return m_parents[label];
+	}
+
+	/// Returns false if the polygons are known to be on different islands, true if they are
+	/// on the same island or if it is not known, e.g. while the islands are out of date.
+	///  @param[in]		startRef	The first polygon reference.
+	///  @param[in]		endRef		The second polygon reference.
+	///  @param[in]		flagSet		The index of the flag set.
+	inline bool isConnected(dtPolyRef startRef, dtPolyRef endRef, const int flagSet) const
+	{
+		if (startRef == endRef)
+			return true;
+		const unsigned int a = getIsland(startRef, flagSet);
+		const unsigned int b = getIsland(endRef, flagSet);
+		if (!a || !b || a == b)
+			return true;
+		// The tiles changed since the last update may join the islands.
+		return !isUpToDate();
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtNavMeshIslands(const dtNavMeshIslands&);
+	dtNavMeshIslands& operator=(const dtNavMeshIslands&);
+
+	/// The label of a polygon that is searched at the next update.
+	static const unsigned int UNSET_LABEL = 0xffffffff;
+
+	struct TileIslands
+	{
+		unsigned int salt;		///< The salt of the tile the labels were allocated for.
+		int polyCount;			///< The number of polygons of the tile, zero if there is no tile.
+		bool dirty;				///< True if the tile has labels to search at the next update.
+		unsigned int* labels;	///< The island label of each polygon and flag set. [Size: polyCount * flagSetCount]
+	};
+
+	struct FlagSet
+	{
+		unsigned short includeFlags;
+		unsigned short excludeFlags;
+	};
+
+	void destroy();
+	void freeLabels();
+
+	/// Returns the root label of the label, halving the path to it.
+	unsigned int findRoot(unsigned int label);
+
+	/// Makes sure there is room for the number of new labels.
+	bool reserveLabels(const int count);
+
+	const dtNavMesh* m_nav;
+	FlagSet m_flagSets[DT_MAX_ISLAND_FLAG_SETS];
+	int m_flagSetCount;
+	TileIslands* m_tiles;
+	int m_maxTiles;
+	unsigned int* m_parents;		///< The parent label of each label. Roots are their own parents. [Size: m_maxLabels]
+	int m_labelCount;				///< The number of labels in use, label zero is not used.
+	int m_maxLabels;
+	unsigned int m_tileGeneration;	///< The tile generation of the navigation mesh at the last update.
+	bool m_invalidated;				///< True if labels were invalidated since the last update.
+};
+
+/// Allocates an islands object using the Detour allocator.
+/// @return An islands object that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtNavMeshIslands* dtAllocNavMeshIslands();
+
+/// Frees the specified islands object using the Detour allocator.
+///  @param[in]	islands		An islands object allocated using #dtAllocNavMeshIslands
+///  @ingroup detour
+void dtFreeNavMeshIslands(dtNavMeshIslands* islands);
+
+#endif // DETOURNAVMESHISLANDS_H
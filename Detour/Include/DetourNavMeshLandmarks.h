@@ -0,0 +1,143 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURNAVMESHLANDMARKS_H
+#define DETOURNAVMESHLANDMARKS_H
+
+#include <float.h>
+#include "DetourNavMesh.h"
+#include "DetourCommon.h"
+#include "DetourStatus.h"
+
+/// The maximum number of landmarks.
+/// @ingroup detour
+static const int DT_MAX_LANDMARKS = 16;
+
+/// The search costs between a few landmark polygons and every polygon of a navigation mesh,
+/// used as the heuristic of dtNavMeshQuery::findPath. (The ALT heuristic.)
+///
+/// The cost between two polygons is at least the difference of their costs to any landmark,
+/// which follows the walls and floors of the mesh where the straight line distance does not.
+/// @see dtNavMeshQuery::updateLandmarks, dtNavMeshQuery::setLandmarks
+/// @ingroup detour
+class dtNavMeshLandmarks
+{
+public:
+	dtNavMeshLandmarks();
+	~dtNavMeshLandmarks();
+
+	/// Initializes the landmarks. The landmarks are placed by dtNavMeshQuery::updateLandmarks.
+	///  @param[in]		nav				The navigation mesh.
+	///  @param[in]		maxLandmarks	The number of landmarks. [Limits: 0 < value <= #DT_MAX_LANDMARKS]
+	/// @return The status flags for the operation.
+	dtStatus init(const dtNavMesh* nav, const int maxLandmarks);
+
+	/// Marks the costs of every landmark out of date, e.g. after polygon flags or areas
+	/// have changed. Adding and removing tiles is found by dtNavMeshQuery::updateLandmarks.
+	void invalidate();
+
+	/// Returns true if the costs of every landmark are up to date.
+	bool isUpToDate() const { return m_upToDateMask == (1u << m_maxLandmarks) - 1; }
+
+	const dtNavMesh* getNavMesh() const { return m_nav; }
+	int getMaxLandmarks() const { return m_maxLandmarks; }
+
+	/// Returns the fingerprint of the filter the costs were found with. (See: #dtGetQueryFilterKey)
+	unsigned int getFilterKey() const { return m_filterKey; }
+
+	/// Gets the polygon of a landmark, or zero if the landmark is not placed.
+	///  @param[in]		i		The index of the landmark. [Limit: 0 <= value < #getMaxLandmarks]
+	dtPolyRef getLandmarkRef(const int i) const { return m_landmarks[i].ref; }
+
+	/// Gets the costs between a polygon and the landmarks, FLT_MAX where it is not known.
+	///  @param[in]		ref		The polygon reference.
+	/// @return The costs, or null if the tile of the polygon has changed. [Size: #getMaxLandmarks]
+	inline const float* getCosts(dtPolyRef ref) const
+	{
+		unsigned int salt, it, ip;
+		m_nav->decodePolyId(ref, salt, it, ip);
+		const TileCosts& tc = m_tiles[it];
+		if (tc.salt != salt || ip >= (unsigned int)tc.polyCount)
+			return 0;
+		return &tc.costs[ip*m_maxLandmarks];
+	}
+
+	/// Gets the lower bound of the cost between two polygons given by the up to date landmarks.
+	///  @param[in]		a		The landmark costs of the first polygon. [opt]
+	///  @param[in]		b		The landmark costs of the second polygon. [opt]
+	/// @return The lower bound of the cost, zero if it is not known.
+	inline float getCostBound(const float* a, const float* b) const
+	{
+		if (!a || !b)
+			return 0;
+		float bound = 0;
+		for (int i = 0; i < m_maxLandmarks; ++i)
+		{
+			if (!(m_upToDateMask & (1u << i)) || a[i] == FLT_MAX || b[i] == FLT_MAX)
+				continue;
+			bound = dtMax(bound, dtAbs(a[i] - b[i]));
+		}
+		return bound;
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtNavMeshLandmarks(const dtNavMeshLandmarks&);
+	dtNavMeshLandmarks& operator=(const dtNavMeshLandmarks&);
+
+	friend class dtNavMeshQuery;
+
+	struct TileCosts
+	{
+		unsigned int salt;		///< The salt of the tile the costs were allocated for.
+		int polyCount;			///< The number of polygons of the tile, zero if there is no tile.
+		float* costs;			///< The landmark costs of each polygon. [Size: polyCount * maxLandmarks]
+	};
+
+	struct Landmark
+	{
+		dtPolyRef ref;
+		float pos[3];
+	};
+
+	void destroy();
+
+	/// Reallocates the costs of the tiles that have been added or removed.
+	/// Returns true if any tile has changed.
+	bool syncTiles(bool& outOfMemory);
+
+	const dtNavMesh* m_nav;
+	int m_maxLandmarks;
+	unsigned int m_upToDateMask;		///< A bit for each landmark whose costs are up to date.
+	unsigned int m_filterKey;			///< The fingerprint of the filter the costs were found with.
+	Landmark m_landmarks[DT_MAX_LANDMARKS];
+	TileCosts* m_tiles;
+	int m_maxTiles;
+};
+
+/// Allocates a landmarks object using the Detour allocator.
+/// @return A landmarks object that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtNavMeshLandmarks* dtAllocNavMeshLandmarks();
+
+/// Frees the specified landmarks object using the Detour allocator.
+///  @param[in]	landmarks		A landmarks object allocated using #dtAllocNavMeshLandmarks
+///  @ingroup detour
+void dtFreeNavMeshLandmarks(dtNavMeshLandmarks* landmarks);
+
+#endif // DETOURNAVMESHLANDMARKS_H
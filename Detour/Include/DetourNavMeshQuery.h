@@ -19,7 +19,16 @@
 #ifndef DETOURNAVMESHQUERY_H
 #define DETOURNAVMESHQUERY_H
 
+#include <float.h>
 #include "DetourNavMesh.h"
+#include "DetourNavMeshLandmarks.h"
+#include "DetourNavMeshIslands.h"
+#include "DetourNavMeshFlowField.h"
+#include "DetourQueryStats.h"
+#include "DetourNode.h"
+#include "DetourCommon.h"
+#include "DetourMath.h"
+#include "DetourAssert.h"
 #include "DetourStatus.h"
 
 
@@ -27,6 +36,11 @@
 // On certain platforms indirect or virtual function call is expensive. The default
 // setting is to use non-virtual functions, the actual implementations of the functions
 // are declared as inline for maximum speed. 
+//
+// Custom filters do not need to derive from dtQueryFilter: findPath, raycast and
+// findPolysAround* are also templates on the filter type, so any class with passFilter
+// and getCost functions of the same signatures can be passed, and its functions inline
+// into the search loops.
 
 //#define DT_VIRTUAL_QUERYFILTER 1
 
@@ -119,6 +133,34 @@ public:
 
 };
 
+#ifndef DT_VIRTUAL_QUERYFILTER
+inline bool dtQueryFilter::passFilter(const dtPolyRef /*ref*/,
+									  const dtMeshTile* /*tile*/,
+									  const dtPoly* poly) const
+{
+	return (poly->flags & m_includeFlags) != 0 && (poly->flags & m_excludeFlags) == 0;
+}
+
+inline float dtQueryFilter::getCost(const float* pa, const float* pb,
+									const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
+									const dtPolyRef /*curRef*/, const dtMeshTile* /*curTile*/, const dtPoly* curPoly,
+									const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
+{
+	return dtVdist(pa, pb) * m_areaCost[curPoly->getArea()];
+}
+#endif
+
+/// Returns the fingerprint of the include and exclude flags and the area costs of a filter.
+/// Filters with other state, e.g. subclasses when DT_VIRTUAL_QUERYFILTER is defined, can
+/// share a fingerprint while passing other polygons or with other costs.
+///  @param[in]		filter		The polygon filter.
+/// @ingroup detour
+unsigned int dtGetQueryFilterKey(const dtQueryFilter* filter);
+
+/// The scale of the distance heuristic of the A* searches.
+/// @ingroup detour
+static const float DT_HEURISTIC_SCALE = 0.999f;
+
 /// Provides information about raycast hit
 /// filled by dtNavMeshQuery::raycast
 /// @ingroup detour
@@ -159,6 +201,74 @@ public:
 	virtual void process(const dtMeshTile* tile, dtPoly** polys, dtPolyRef* refs, int count) = 0;
 };
 
+/// The state of a sliced path query, with its own node pool and open list.
+///
+/// A search context is much smaller than a query object, so many agents can each
+/// keep an in-progress search, and advance them in turn on one shared query.
+/// @see dtNavMeshQuery::initSlicedFindPath, dtAllocSlicedSearch
+/// @ingroup detour
+class dtSlicedSearch
+{
+public:
+	dtSlicedSearch();
+	~dtSlicedSearch();
+
+	/// Initializes the search context. Can be called again to resize it.
+	///  @param[in]		maxNodes	Maximum number of search nodes. [Limits: 0 < value <= 65535]
+	/// @returns The status flags for the operation.
+	dtStatus init(const int maxNodes);
+
+	/// Gets the status of the search, zero if no search has been initialized
+	/// or the last search has been finalized.
+	dtStatus getStatus() const { return m_query.status; }
+
+	/// Gets the node pool of the search.
+	/// @returns The node pool.
+	class dtNodePool* getNodePool() const { return m_nodePool; }
+
+	/// Sets the statistics filled by the searches of the context. A search adds its
+	/// steps to the statistics from the call to dtNavMeshQuery::initSlicedFindPath.
+	///  @param[in]		stats		The statistics to fill, or null.
+	void setStats(dtQueryStats* stats) { m_stats = stats; }
+
+	/// Gets the statistics filled by the searches of the context.
+	dtQueryStats* getStats() const { return m_stats; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtSlicedSearch(const dtSlicedSearch&);
+	dtSlicedSearch& operator=(const dtSlicedSearch&);
+
+	friend class dtNavMeshQuery;
+
+	struct dtQueryData
+	{
+		dtStatus status;
+		struct dtNode* lastBestNode;
+		float lastBestNodeCost;
+		dtPolyRef startRef, endRef;
+		float startPos[3], endPos[3];
+		const dtQueryFilter* filter;
+		unsigned int options;
+		float raycastLimitSqr;
+	};
+	dtQueryData m_query;				///< Sliced query state.
+
+	class dtNodePool* m_nodePool;		///< Pointer to node pool.
+	class dtNodeQueue* m_openList;		///< Pointer to open list queue.
+	dtQueryStats* m_stats;				///< The statistics of the searches, or null.
+};
+
+/// Allocates a sliced search context using the Detour allocator.
+/// @return A search context that is ready for initialization, or null on failure.
+/// @ingroup detour
+dtSlicedSearch* dtAllocSlicedSearch();
+
+/// Frees the specified sliced search context using the Detour allocator.
+///  @param[in]		search		A search context allocated using #dtAllocSlicedSearch
+/// @ingroup detour
+void dtFreeSlicedSearch(dtSlicedSearch* search);
+
 /// Provides the ability to perform pathfinding related queries against
 /// a navigation mesh.
 /// @ingroup detour
@@ -171,13 +281,17 @@ public:
 	/// Initializes the query object.
 	///  @param[in]		nav			Pointer to the dtNavMesh object to use for all queries.
 	///  @param[in]		maxNodes	Maximum number of search nodes. [Limits: 0 < value <= 65535]
+	///  @param[in]		statsConfig	The query statistics setting of the caller, leave to the default.
 	/// @returns The status flags for the query.
-	dtStatus init(const dtNavMesh* nav, const int maxNodes);
+	dtStatus init(const dtNavMesh* nav, const int maxNodes, const int statsConfig = DT_QUERY_STATS_CONFIG);
 	
 	/// @name Standard Pathfinding Functions
 	// /@{
 
 	/// Finds a path from the start polygon to the end polygon.
+	/// When the islands show that the end polygon cannot be reached, the path is the start polygon
+	/// only, with #DT_PARTIAL_RESULT, instead of the path toward the polygon nearest the end.
+	/// (See: #setIslands)
 	///  @param[in]		startRef	The refrence id of the start polygon.
 	///  @param[in]		endRef		The reference id of the end polygon.
 	///  @param[in]		startPos	A position within the start polygon. [(x, y, z)]
@@ -192,6 +306,14 @@ public:
 					  const dtQueryFilter* filter,
 					  dtPolyRef* path, int* pathCount, const int maxPath) const;
 
+	/// Finds a path from the start polygon to the end polygon, with a custom filter type.
+	/// The calls to the filter are resolved at compile time. @see findPath
+	template<class TFilter>
+	dtStatus findPath(dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  const TFilter* filter,
+					  dtPolyRef* path, int* pathCount, const int maxPath) const;
+
 	/// Finds the straight path from the start to the end position within the polygon corridor.
 	///  @param[in]		startPos			Path start position. [(x, y, z)]
 	///  @param[in]		endPos				Path end position. [(x, y, z)]
@@ -255,6 +377,55 @@ public:
 	dtStatus finalizeSlicedFindPathPartial(const dtPolyRef* existing, const int existingSize,
 										   dtPolyRef* path, int* pathCount, const int maxPath);
 
+	///@}
+	/// @name Sliced Pathfinding Functions With a Search Context
+	/// The same as the sliced pathfinding functions, but the state of the search is kept in
+	/// @p search instead of the query object. These do not change the query object, so one
+	/// query can advance any number of searches, each in its own context.
+	///@{
+
+	/// Intializes a sliced path query in a search context.
+	///  @param[in]		search		The search context. [Initialized]
+	///  @param[in]		startRef	The refrence id of the start polygon.
+	///  @param[in]		endRef		The reference id of the end polygon.
+	///  @param[in]		startPos	A position within the start polygon. [(x, y, z)]
+	///  @param[in]		endPos		A position within the end polygon. [(x, y, z)]
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[in]		options		query options (see: #dtFindPathOptions)
+	/// @returns The status flags for the query.
+	dtStatus initSlicedFindPath(dtSlicedSearch* search, dtPolyRef startRef, dtPolyRef endRef,
+								const float* startPos, const float* endPos,
+								const dtQueryFilter* filter, const unsigned int options = 0) const;
+
+	/// Updates an in-progress sliced path query of a search context.
+	///  @param[in]		search		The search context.
+	///  @param[in]		maxIter		The maximum number of iterations to perform.
+	///  @param[out]	doneIters	The actual number of iterations completed. [opt]
+	/// @returns The status flags for the query.
+	dtStatus updateSlicedFindPath(dtSlicedSearch* search, const int maxIter, int* doneIters) const;
+
+	/// Finalizes and returns the results of the sliced path query of a search context.
+	///  @param[in]		search		The search context.
+	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.) 
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The max number of polygons the path array can hold. [Limit: >= 1]
+	/// @returns The status flags for the query.
+	dtStatus finalizeSlicedFindPath(dtSlicedSearch* search, dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// Finalizes and returns the results of the incomplete sliced path query of a search context,
+	/// returning the path to the furthest polygon on the existing path that was visited during the search.
+	///  @param[in]		search			The search context.
+	///  @param[in]		existing		An array of polygon references for the existing path.
+	///  @param[in]		existingSize	The number of polygon in the @p existing array.
+	///  @param[out]	path			An ordered list of polygon references representing the path. (Start to end.) 
+	///  								[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount		The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath			The max number of polygons the @p path array can hold. [Limit: >= 1]
+	/// @returns The status flags for the query.
+	dtStatus finalizeSlicedFindPathPartial(dtSlicedSearch* search, const dtPolyRef* existing, const int existingSize,
+										   dtPolyRef* path, int* pathCount, const int maxPath) const;
+
 	///@}
 	/// @name Dijkstra Search Functions
 	/// @{ 
@@ -275,6 +446,14 @@ public:
 								   const dtQueryFilter* filter,
 								   dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
 								   int* resultCount, const int maxResult) const;
+
+	/// Finds the polygons that touch the specified circle, with a custom filter type.
+	/// The calls to the filter are resolved at compile time. @see findPolysAroundCircle
+	template<class TFilter>
+	dtStatus findPolysAroundCircle(dtPolyRef startRef, const float* centerPos, const float radius,
+								   const TFilter* filter,
+								   dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
+								   int* resultCount, const int maxResult) const;
 	
 	/// Finds the polygons along the naviation graph that touch the specified convex polygon.
 	///  @param[in]		startRef		The reference id of the polygon where the search starts.
@@ -293,6 +472,14 @@ public:
 								  const dtQueryFilter* filter,
 								  dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
 								  int* resultCount, const int maxResult) const;
+
+	/// Finds the polygons that touch the specified convex polygon, with a custom filter type.
+	/// The calls to the filter are resolved at compile time. @see findPolysAroundShape
+	template<class TFilter>
+	dtStatus findPolysAroundShape(dtPolyRef startRef, const float* verts, const int nverts,
+								  const TFilter* filter,
+								  dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
+								  int* resultCount, const int maxResult) const;
 	
 	/// Gets a path from the explored nodes in the previous search.
 	///  @param[in]		endRef		The reference id of the end polygon.
@@ -422,6 +609,13 @@ public:
 					 const dtQueryFilter* filter, const unsigned int options,
 					 dtRaycastHit* hit, dtPolyRef prevRef = 0) const;
 
+	/// Casts a 'walkability' ray along the surface of the navigation mesh, with a custom filter type.
+	/// The calls to the filter are resolved at compile time. @see raycast
+	template<class TFilter>
+	dtStatus raycast(dtPolyRef startRef, const float* startPos, const float* endPos,
+					 const TFilter* filter, const unsigned int options,
+					 dtRaycastHit* hit, dtPolyRef prevRef = 0) const;
+
 
 	/// Finds the distance from the specified position to the nearest polygon wall.
 	///  @param[in]		startRef		The reference id of the polygon containing @p centerPos.
@@ -497,6 +691,66 @@ public:
 	/// @returns The status flags for the query.
 	dtStatus getPolyHeight(dtPolyRef ref, const float* pos, float* height) const;
 
+	/// @}
+	/// @name Landmark Functions
+	/// @{
+
+	/// Places the landmarks and finds their costs to every polygon, up to a number of
+	/// landmarks per call.
+	///  @param[in]		landmarks	The landmarks to update.
+	///  @param[in]		filter		The polygon filter to apply to the search.
+	///  @param[in]		maxUpdates	The maximum number of landmarks to update. [Limit: >= 0]
+	///  @param[out]	upToDate	Whether every landmark is up to date. [opt]
+	/// @returns The status flags for the query.
+	dtStatus updateLandmarks(dtNavMeshLandmarks* landmarks, const dtQueryFilter* filter,
+							 const int maxUpdates, bool* upToDate = 0);
+
+	/// Sets the landmarks used by the heuristic of findPath.
+	///  @param[in]		landmarks	The landmarks, or null to use the straight line distance only.
+	/// @returns The status flags for the query.
+	dtStatus setLandmarks(const dtNavMeshLandmarks* landmarks);
+
+	/// Gets the landmarks used by the heuristic of findPath.
+	const dtNavMeshLandmarks* getLandmarks() const { return m_landmarks; }
+
+	/// @}
+	/// @name Island Functions
+	/// @{
+
+	/// Sets the islands used to skip the path searches that cannot reach their end.
+	/// The skipped searches return the start polygon only. (See: #findPath)
+	///  @param[in]		islands		The islands, or null to always search.
+	/// @returns The status flags for the query.
+	dtStatus setIslands(const dtNavMeshIslands* islands);
+
+	/// Gets the islands used to skip the path searches that cannot reach their end.
+	const dtNavMeshIslands* getIslands() const { return m_islands; }
+
+	/// Returns false if the islands show that the end polygon cannot be reached from the
+	/// start polygon, true otherwise.
+	///  @param[in]		startRef	The reference id of the start polygon.
+	///  @param[in]		endRef		The reference id of the end polygon.
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	bool isReachable(dtPolyRef startRef, dtPolyRef endRef, const dtQueryFilter* filter) const;
+
+	/// @}
+	/// @name Flow Field Functions
+	/// @{
+
+	/// Finds the cost from every polygon to the goal, and the next polygon toward it.
+	///  @param[in]		field		The flow field. [Initialized]
+	///  @param[in]		goalRef		The reference id of the goal polygon.
+	///  @param[in]		goalPos		A position within the goal polygon. [(x, y, z)]
+	///  @param[in]		filter		The polygon filter to apply to the search.
+	/// @returns The status flags for the query.
+	dtStatus findFlowField(dtNavMeshFlowField* field, dtPolyRef goalRef, const float* goalPos,
+						   const dtQueryFilter* filter);
+
+	/// Updates a flow field after tiles have been added or removed, or polygons invalidated.
+	///  @param[in]		field		The flow field, found by #findFlowField.
+	/// @returns The status flags for the query.
+	dtStatus updateFlowField(dtNavMeshFlowField* field);
+
 	/// @}
 	/// @name Miscellaneous Functions
 	/// @{
@@ -519,13 +773,33 @@ public:
 	/// @return The navigation mesh the query object is using.
 	const dtNavMesh* getAttachedNavMesh() const { return m_nav; }
 
+	/// Sets the statistics filled by the queries. #findPath, the sliced path functions, #raycast,
+	/// #moveAlongSurface, #findPolysAroundCircle, #findPolysAroundShape and #findNearestPoly
+	/// reset the statistics and fill them. The sliced path functions add their steps up from
+	/// #initSlicedFindPath, and the searches of a dtSlicedSearch use its own statistics.
+	/// (See: dtQueryStats)
+	///  @param[in]		stats		The statistics to fill, or null.
+	void setStats(dtQueryStats* stats) { m_stats = stats; }
+
+	/// Gets the statistics filled by the queries.
+	dtQueryStats* getStats() const { return m_stats; }
+
 	/// @}
 	
 private:
 	// Explicitly disabled copy constructor and copy assignment operator
 	dtNavMeshQuery(const dtNavMeshQuery&);
 	dtNavMeshQuery& operator=(const dtNavMeshQuery&);
+
+	typedef dtSlicedSearch::dtQueryData dtQueryData;
 	
+	/// Finds the polygon the point is over, within the height, with the polygon lookup grids.
+	/// Returns zero if there is none, if the point is over more than one polygon within the
+	/// height, e.g. on an edge or between stacked polygons, or if a tile has no grid. The
+	/// search with the BV trees then picks the polygon, so that both find the same one.
+	dtPolyRef findPolyOverPoint(const float* pos, const float maxHeight, const dtQueryFilter* filter,
+								float* height, dtScopedQueryStats& queryStats) const;
+
 	/// Queries polygons within a tile.
 	void queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, const float* qmax,
 							 const dtQueryFilter* filter, dtPolyQuery* query) const;
@@ -555,25 +829,72 @@ private:
 
 	// Gets the path leading to the specified end node.
 	dtStatus getPathToNode(struct dtNode* endNode, dtPolyRef* path, int* pathCount, int maxPath) const;
+
+	/// Returns true if the polygon has a link to the reference.
+	static bool isLinkedTo(const dtMeshTile* tile, const dtPoly* poly, dtPolyRef ref)
+	{
+		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			if (tile->links[i].ref == ref)
+				return true;
+		}
+		return false;
+	}
+
+	/// Casts a ray, counting its work in the statistics of the calling query.
+	template<class TFilter>
+	dtStatus raycast(dtPolyRef startRef, const float* startPos, const float* endPos,
+					 const TFilter* filter, const unsigned int options,
+					 dtRaycastHit* hit, dtPolyRef prevRef, dtScopedQueryStats& queryStats) const;
+
+	/// The sliced pathfinding functions, on the given query state, node pool, open list and statistics.
+	dtStatus initSlicedFindPath(dtQueryData& query, class dtNodePool* nodePool, class dtNodeQueue* openList,
+								dtQueryStats* stats, dtPolyRef startRef, dtPolyRef endRef,
+								const float* startPos, const float* endPos,
+								const dtQueryFilter* filter, const unsigned int options) const;
+	dtStatus updateSlicedFindPath(dtQueryData& query, class dtNodePool* nodePool, class dtNodeQueue* openList,
+								  dtQueryStats* stats, const int maxIter, int* doneIters) const;
+	dtStatus finalizeSlicedFindPath(dtQueryData& query, class dtNodePool* nodePool, dtQueryStats* stats,
+									dtPolyRef* path, int* pathCount, const int maxPath) const;
+	dtStatus finalizeSlicedFindPathPartial(dtQueryData& query, class dtNodePool* nodePool, dtQueryStats* stats,
+										   const dtPolyRef* existing, const int existingSize,
+										   dtPolyRef* path, int* pathCount, const int maxPath) const;
+
+	/// Returns true if the landmarks were found with the same flags and area costs as the filter.
+	bool hasLandmarkCosts(const dtQueryFilter* filter) const;
+	/// The landmarks do not know the costs of a custom filter type.
+	template<class TFilter>
+	bool hasLandmarkCosts(const TFilter* /*filter*/) const { return false; }
+
+	/// Returns the island flag set matching the filter, or -1 if there is none.
+	int findIslandFlagSet(const dtQueryFilter* filter) const;
+	/// The islands do not know the polygons a custom filter type passes.
+	template<class TFilter>
+	int findIslandFlagSet(const TFilter* /*filter*/) const { return -1; }
+
+	/// Finds the tiles that can have off-mesh connections linked to the polygons of the tile.
+	int findOffMeshTilesAround(const dtMeshTile* tile, const dtMeshTile** tiles, const int maxTiles) const;
+
+	/// Places a landmark as far as possible from the up to date landmarks.
+	dtStatus placeLandmark(dtNavMeshLandmarks* landmarks, const int index, const dtQueryFilter* filter);
+
+	/// Searches the changed polygons of a flow field from the polygons around them.
+	dtStatus repairFlowField(dtNavMeshFlowField* field);
+
+	/// Finds the costs between a landmark and every polygon it can reach.
+	dtStatus findLandmarkCosts(dtNavMeshLandmarks* landmarks, const int index, const dtQueryFilter* filter);
 	
 	const dtNavMesh* m_nav;				///< Pointer to navmesh data.
 
-	struct dtQueryData
-	{
-		dtStatus status;
-		struct dtNode* lastBestNode;
-		float lastBestNodeCost;
-		dtPolyRef startRef, endRef;
-		float startPos[3], endPos[3];
-		const dtQueryFilter* filter;
-		unsigned int options;
-		float raycastLimitSqr;
-	};
 	dtQueryData m_query;				///< Sliced query state.
 
 	class dtNodePool* m_tinyNodePool;	///< Pointer to small node pool.
 	class dtNodePool* m_nodePool;		///< Pointer to node pool.
 	class dtNodeQueue* m_openList;		///< Pointer to open list queue.
+
+	const dtNavMeshLandmarks* m_landmarks;	///< The landmarks of the findPath heuristic, or null.
+	const dtNavMeshIslands* m_islands;		///< The islands of the path searches, or null.
+	dtQueryStats* m_stats;					///< The statistics of the queries, or null.
 };
 
 /// Allocates a query object using the Detour allocator.
@@ -586,4 +907,804 @@ dtNavMeshQuery* dtAllocNavMeshQuery();
 /// @ingroup detour
 void dtFreeNavMeshQuery(dtNavMeshQuery* query);
 
+//////////////////////////////////////////////////////////////////////////////////////////
+
+// The searches taking a filter type. The dtQueryFilter versions call these, so the
+// filter calls of a custom type are resolved at compile time and can be inlined.
+
+template<class TFilter>
+dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
+								  const float* startPos, const float* endPos,
+								  const TFilter* filter,
+								  dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	dtAssert(m_nav);
+	dtAssert(m_nodePool);
+	dtAssert(m_openList);
+
+	dtScopedQueryStats queryStats(m_stats);
+
+	if (!pathCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*pathCount = 0;
+	
+	// Validate input
+	if (!m_nav->isValidPolyRef(startRef) || !m_nav->isValidPolyRef(endRef) ||
+		!startPos || !dtVisfinite(startPos) ||
+		!endPos || !dtVisfinite(endPos) ||
+		!filter || !path || maxPath <= 0)
+	{
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	if (startRef == endRef)
+	{
+		path[0] = startRef;
+		*pathCount = 1;
+		return DT_SUCCESS;
+	}
+
+	// The end is on another island, there is nothing to search.
+	if (m_islands && !m_islands->isConnected(startRef, endRef, findIslandFlagSet(filter)))
+	{
+		path[0] = startRef;
+		*pathCount = 1;
+		return DT_SUCCESS | DT_PARTIAL_RESULT;
+	}
+	
+	m_nodePool->clear();
+	m_openList->clear();
+
+	// The landmark costs of the end polygon, the heuristic also uses the landmarks if they
+	// were found with the costs of the filter.
+	const float* endCosts = m_landmarks && hasLandmarkCosts(filter) ? m_landmarks->getCosts(endRef) : 0;
+	
+	dtNode* startNode = m_nodePool->getNode(startRef);
+	dtVcopy(startNode->pos, startPos);
+	startNode->pidx = 0;
+	startNode->cost = 0;
+	startNode->total = dtVdist(startPos, endPos) * DT_HEURISTIC_SCALE;
+	if (endCosts)
+		startNode->total = dtMax(startNode->total, m_landmarks->getCostBound(m_landmarks->getCosts(startRef), endCosts) * DT_HEURISTIC_SCALE);
+	startNode->id = startRef;
+	startNode->flags = DT_NODE_OPEN;
+	m_openList->push(startNode);
+	queryStats.updateOpenList(m_openList->size());
+	
+	dtNode* lastBestNode = startNode;
+	float lastBestNodeCost = startNode->total;
+	
+	bool outOfNodes = false;
+	
+	while (!m_openList->empty())
+	{
+		// Remove node from open list and put it in closed list.
+		dtNode* bestNode = m_openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+		
+		// Reached the goal, stop searching.
+		if (bestNode->id == endRef)
+		{
+			lastBestNode = bestNode;
+			break;
+		}
+		
+		// Get current poly and tile.
+		// The API input has been cheked already, skip checking internal data.
+		const dtPolyRef bestRef = bestNode->id;
+		const dtMeshTile* bestTile = 0;
+		const dtPoly* bestPoly = 0;
+		if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		queryStats.expandNode(bestTile);
+		
+		// Get parent poly and tile.
+		dtPolyRef parentRef = 0;
+		const dtMeshTile* parentTile = 0;
+		const dtPoly* parentPoly = 0;
+		if (bestNode->pidx)
+			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+		if (parentRef && dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		
+		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+		{
+			dtPolyRef neighbourRef = bestTile->links[i].ref;
+			queryStats.traverseLink();
+			
+			// Skip invalid ids and do not expand back to where we came from.
+			if (!neighbourRef || neighbourRef == parentRef)
+				continue;
+			
+			// Get neighbour poly and tile.
+			// The API input has been cheked already, skip checking internal data.
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly)))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+			
+			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+
+			// deal explicitly with crossing tile boundaries
+			unsigned char crossSide = 0;
+			if (bestTile->links[i].side != 0xff)
+				crossSide = bestTile->links[i].side >> 1;
+
+			// get the node
+			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, crossSide);
+			if (!neighbourNode)
+			{
+				outOfNodes = true;
+				continue;
+			}
+			queryStats.touchNode();
+			
+			// If the node is visited the first time, calculate node position.
+			if (neighbourNode->flags == 0)
+			{
+				getEdgeMidPoint(bestRef, bestPoly, bestTile,
+								neighbourRef, neighbourPoly, neighbourTile,
+								neighbourNode->pos);
+			}
+
+			// Calculate cost and heuristic.
+			float cost = 0;
+			float heuristic = 0;
+			
+			// Special case for last node.
+			if (neighbourRef == endRef)
+			{
+				// Cost
+				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
+													  parentRef, parentTile, parentPoly,
+													  bestRef, bestTile, bestPoly,
+													  neighbourRef, neighbourTile, neighbourPoly);
+				const float endCost = filter->getCost(neighbourNode->pos, endPos,
+													  bestRef, bestTile, bestPoly,
+													  neighbourRef, neighbourTile, neighbourPoly,
+													  0, 0, 0);
+				
+				cost = bestNode->cost + curCost + endCost;
+				heuristic = 0;
+			}
+			else
+			{
+				// Cost
+				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
+													  parentRef, parentTile, parentPoly,
+													  bestRef, bestTile, bestPoly,
+													  neighbourRef, neighbourTile, neighbourPoly);
+				cost = bestNode->cost + curCost;
+				heuristic = dtVdist(neighbourNode->pos, endPos);
+				if (endCosts)
+					heuristic = dtMax(heuristic, m_landmarks->getCostBound(m_landmarks->getCosts(neighbourRef), endCosts));
+				heuristic *= DT_HEURISTIC_SCALE;
+			}
+
+			const float total = cost + heuristic;
+			
+			// The node is already in open list and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+				continue;
+			// The node is already visited and process, and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_CLOSED) && total >= neighbourNode->total)
+				continue;
+			
+			// Add or update the node.
+			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
+			neighbourNode->id = neighbourRef;
+			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
+			neighbourNode->cost = cost;
+			neighbourNode->total = total;
+			
+			if (neighbourNode->flags & DT_NODE_OPEN)
+			{
+				// Already in open, update node location.
+				m_openList->modify(neighbourNode);
+			}
+			else
+			{
+				// Put the node in open list.
+				neighbourNode->flags |= DT_NODE_OPEN;
+				m_openList->push(neighbourNode);
+				queryStats.updateOpenList(m_openList->size());
+			}
+			
+			// Update nearest node to target so far.
+			if (heuristic < lastBestNodeCost)
+			{
+				lastBestNodeCost = heuristic;
+				lastBestNode = neighbourNode;
+			}
+		}
+	}
+
+	dtStatus status = getPathToNode(lastBestNode, path, pathCount, maxPath);
+
+	if (lastBestNode->id != endRef)
+		status |= DT_PARTIAL_RESULT;
+
+	if (outOfNodes)
+		status |= DT_OUT_OF_NODES;
+	
+	return status;
+}
+
+template<class TFilter>
+dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, const float* endPos,
+								 const TFilter* filter, const unsigned int options,
+								 dtRaycastHit* hit, dtPolyRef prevRef) const
+{
+	dtScopedQueryStats queryStats(m_stats);
+	return raycast(startRef, startPos, endPos, filter, options, hit, prevRef, queryStats);
+}
+
+template<class TFilter>
+dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, const float* endPos,
+								 const TFilter* filter, const unsigned int options,
+								 dtRaycastHit* hit, dtPolyRef prevRef, dtScopedQueryStats& queryStats) const
+{
+	dtAssert(m_nav);
+
+	if (!hit)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	hit->t = 0;
+	hit->pathCount = 0;
+	hit->pathCost = 0;
+
+	// Validate input
+	if (!m_nav->isValidPolyRef(startRef) ||
+		!startPos || !dtVisfinite(startPos) ||
+		!endPos || !dtVisfinite(endPos) ||
+		!filter ||
+		(prevRef && !m_nav->isValidPolyRef(prevRef)))
+	{
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+	
+	float dir[3], curPos[3], lastPos[3];
+	float verts[DT_VERTS_PER_POLYGON*3+3];	
+	int n = 0;
+
+	dtVcopy(curPos, startPos);
+	dtVsub(dir, endPos, startPos);
+	dtVset(hit->hitNormal, 0, 0, 0);
+
+	dtStatus status = DT_SUCCESS;
+
+	const dtMeshTile* prevTile, *tile, *nextTile;
+	const dtPoly* prevPoly, *poly, *nextPoly;
+	dtPolyRef curRef;
+
+	// The API input has been checked already, skip checking internal data.
+	curRef = startRef;
+	tile = 0;
+	poly = 0;
+	if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(curRef, &tile, &poly)))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	nextTile = prevTile = tile;
+	nextPoly = prevPoly = poly;
+	if (prevRef && dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(prevRef, &prevTile, &prevPoly)))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	while (curRef)
+	{
+		queryStats.expandNode(tile);
+
+		// Cast ray against current polygon.
+		
+		// Collect vertices.
+		int nv = 0;
+		for (int i = 0; i < (int)poly->vertCount; ++i)
+		{
+			dtVcopy(&verts[nv*3], tile->getVert(poly->verts[i], &verts[nv*3]));
+			nv++;
+		}
+		
+		float tmin, tmax;
+		int segMin, segMax;
+		if (!dtIntersectSegmentPoly2D(startPos, endPos, verts, nv, tmin, tmax, segMin, segMax))
+		{
+			// Could not hit the polygon, keep the old t and report hit.
+			hit->pathCount = n;
+			return status;
+		}
+
+		hit->hitEdgeIndex = segMax;
+
+		// Keep track of furthest t so far.
+		if (tmax > hit->t)
+			hit->t = tmax;
+		
+		// Store visited polygons.
+		if (n < hit->maxPath)
+			hit->path[n++] = curRef;
+		else
+			status |= DT_BUFFER_TOO_SMALL;
+
+		// Ray end is completely inside the polygon.
+		if (segMax == -1)
+		{
+			hit->t = FLT_MAX;
+			hit->pathCount = n;
+			
+			// add the cost
+			if (options & DT_RAYCAST_USE_COSTS)
+				hit->pathCost += filter->getCost(curPos, endPos, prevRef, prevTile, prevPoly, curRef, tile, poly, curRef, tile, poly);
+			return status;
+		}
+
+		// Follow neighbours.
+		dtPolyRef nextRef = 0;
+		
+		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
+		{
+			const dtLink* link = &tile->links[i];
+			queryStats.traverseLink();
+			
+			// Find link which contains this edge.
+			if ((int)link->edge != segMax)
+				continue;
+			
+			// Get pointer to the next polygon.
+			nextTile = 0;
+			nextPoly = 0;
+			if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(link->ref, &nextTile, &nextPoly)))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+			
+			// Skip off-mesh connections.
+			if (nextPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+				continue;
+			
+			// Skip links based on filter.
+			if (!filter->passFilter(link->ref, nextTile, nextPoly))
+				continue;
+			
+			// If the link is internal, just return the ref.
+			if (link->side == 0xff)
+			{
+				nextRef = link->ref;
+				break;
+			}
+			
+			// If the link is at tile boundary,
+			
+			// Check if the link spans the whole edge, and accept.
+			if (link->bmin == 0 && link->bmax == 255)
+			{
+				nextRef = link->ref;
+				break;
+			}
+			
+			// Check for partial edge links.
+			const int v0 = poly->verts[link->edge];
+			const int v1 = poly->verts[(link->edge+1) % poly->vertCount];
+			float tl[3], tr[3];
+			const float* left = tile->getVert(v0, tl);
+			const float* right = tile->getVert(v1, tr);
+			
+			// Check that the intersection lies inside the link portal.
+			if (link->side == 0 || link->side == 4)
+			{
+				// Calculate link size.
+				const float s = 1.0f/255.0f;
+				float lmin = left[2] + (right[2] - left[2])*(link->bmin*s);
+				float lmax = left[2] + (right[2] - left[2])*(link->bmax*s);
+				if (lmin > lmax) dtSwap(lmin, lmax);
+				
+				// Find Z intersection.
+				float z = startPos[2] + (endPos[2]-startPos[2])*tmax;
+				if (z >= lmin && z <= lmax)
+				{
+					nextRef = link->ref;
+					break;
+				}
+			}
+			else if (link->side == 2 || link->side == 6)
+			{
+				// Calculate link size.
+				const float s = 1.0f/255.0f;
+				float lmin = left[0] + (right[0] - left[0])*(link->bmin*s);
+				float lmax = left[0] + (right[0] - left[0])*(link->bmax*s);
+				if (lmin > lmax) dtSwap(lmin, lmax);
+				
+				// Find X intersection.
+				float x = startPos[0] + (endPos[0]-startPos[0])*tmax;
+				if (x >= lmin && x <= lmax)
+				{
+					nextRef = link->ref;
+					break;
+				}
+			}
+		}
+		
+		// add the cost
+		if (options & DT_RAYCAST_USE_COSTS)
+		{
+			// compute the intersection point at the furthest end of the polygon
+			// and correct the height (since the raycast moves in 2d)
+			dtVcopy(lastPos, curPos);
+			dtVmad(curPos, startPos, dir, hit->t);
+			float* e1 = &verts[segMax*3];
+			float* e2 = &verts[((segMax+1)%nv)*3];
+			float eDir[3], diff[3];
+			dtVsub(eDir, e2, e1);
+			dtVsub(diff, curPos, e1);
+			float s = dtSqr(eDir[0]) > dtSqr(eDir[2]) ? diff[0] / eDir[0] : diff[2] / eDir[2];
+			curPos[1] = e1[1] + eDir[1] * s;
+
+			hit->pathCost += filter->getCost(lastPos, curPos, prevRef, prevTile, prevPoly, curRef, tile, poly, nextRef, nextTile, nextPoly);
+		}
+
+		if (!nextRef)
+		{
+			// No neighbour, we hit a wall.
+			
+			// Calculate hit normal.
+			const int a = segMax;
+			const int b = segMax+1 < nv ? segMax+1 : 0;
+			const float* va = &verts[a*3];
+			const float* vb = &verts[b*3];
+			const float dx = vb[0] - va[0];
+			const float dz = vb[2] - va[2];
+			hit->hitNormal[0] = dz;
+			hit->hitNormal[1] = 0;
+			hit->hitNormal[2] = -dx;
+			dtVnormalize(hit->hitNormal);
+			
+			hit->pathCount = n;
+			return status;
+		}
+
+		// No hit, advance to neighbour polygon.
+		prevRef = curRef;
+		curRef = nextRef;
+		prevTile = tile;
+		tile = nextTile;
+		prevPoly = poly;
+		poly = nextPoly;
+	}
+	
+	hit->pathCount = n;
+	
+	return status;
+}
+
+template<class TFilter>
+dtStatus dtNavMeshQuery::findPolysAroundCircle(dtPolyRef startRef, const float* centerPos, const float radius,
+											   const TFilter* filter,
+											   dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
+											   int* resultCount, const int maxResult) const
+{
+	dtAssert(m_nav);
+	dtAssert(m_nodePool);
+	dtAssert(m_openList);
+
+	dtScopedQueryStats queryStats(m_stats);
+
+	if (!resultCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*resultCount = 0;
+
+	if (!m_nav->isValidPolyRef(startRef) ||
+		!centerPos || !dtVisfinite(centerPos) ||
+		radius < 0 || !dtMathIsfinite(radius) ||
+		!filter || maxResult < 0)
+	{
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+	
+	m_nodePool->clear();
+	m_openList->clear();
+	
+	dtNode* startNode = m_nodePool->getNode(startRef);
+	dtVcopy(startNode->pos, centerPos);
+	startNode->pidx = 0;
+	startNode->cost = 0;
+	startNode->total = 0;
+	startNode->id = startRef;
+	startNode->flags = DT_NODE_OPEN;
+	m_openList->push(startNode);
+	queryStats.updateOpenList(m_openList->size());
+	
+	dtStatus status = DT_SUCCESS;
+	
+	int n = 0;
+	
+	const float radiusSqr = dtSqr(radius);
+	
+	while (!m_openList->empty())
+	{
+		dtNode* bestNode = m_openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+		
+		// Get poly and tile.
+		// The API input has been cheked already, skip checking internal data.
+		const dtPolyRef bestRef = bestNode->id;
+		const dtMeshTile* bestTile = 0;
+		const dtPoly* bestPoly = 0;
+		if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		queryStats.expandNode(bestTile);
+		
+		// Get parent poly and tile.
+		dtPolyRef parentRef = 0;
+		const dtMeshTile* parentTile = 0;
+		const dtPoly* parentPoly = 0;
+		if (bestNode->pidx)
+			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+		if (parentRef && dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+		if (n < maxResult)
+		{
+			if (resultRef)
+				resultRef[n] = bestRef;
+			if (resultParent)
+				resultParent[n] = parentRef;
+			if (resultCost)
+				resultCost[n] = bestNode->total;
+			++n;
+		}
+		else
+		{
+			status |= DT_BUFFER_TOO_SMALL;
+		}
+		
+		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+		{
+			const dtLink* link = &bestTile->links[i];
+			dtPolyRef neighbourRef = link->ref;
+			queryStats.traverseLink();
+			// Skip invalid neighbours and do not follow back to parent.
+			if (!neighbourRef || neighbourRef == parentRef)
+				continue;
+			
+			// Expand to neighbour
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly)))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+		
+			// Do not advance if the polygon is excluded by the filter.
+			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+			
+			// Find edge and calc distance to the edge.
+			float va[3], vb[3];
+			if (!getPortalPoints(bestRef, bestPoly, bestTile, neighbourRef, neighbourPoly, neighbourTile, va, vb))
+				continue;
+			
+			// If the circle is not touching the next polygon, skip it.
+			float tseg;
+			float distSqr = dtDistancePtSegSqr2D(centerPos, va, vb, tseg);
+			if (distSqr > radiusSqr)
+				continue;
+			
+			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef);
+			if (!neighbourNode)
+			{
+				status |= DT_OUT_OF_NODES;
+				continue;
+			}
+			queryStats.touchNode();
+				
+			if (neighbourNode->flags & DT_NODE_CLOSED)
+				continue;
+			
+			// Cost
+			if (neighbourNode->flags == 0)
+				dtVlerp(neighbourNode->pos, va, vb, 0.5f);
+			
+			float cost = filter->getCost(
+				bestNode->pos, neighbourNode->pos,
+				parentRef, parentTile, parentPoly,
+				bestRef, bestTile, bestPoly,
+				neighbourRef, neighbourTile, neighbourPoly);
+
+			const float total = bestNode->total + cost;
+			
+			// The node is already in open list and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+				continue;
+			
+			neighbourNode->id = neighbourRef;
+			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
+			neighbourNode->total = total;
+			
+			if (neighbourNode->flags & DT_NODE_OPEN)
+			{
+				m_openList->modify(neighbourNode);
+			}
+			else
+			{
+				neighbourNode->flags = DT_NODE_OPEN;
+				m_openList->push(neighbourNode);
+				queryStats.updateOpenList(m_openList->size());
+			}
+		}
+	}
+	
+	*resultCount = n;
+	
+	return status;
+}
+
+template<class TFilter>
+dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* verts, const int nverts,
+											  const TFilter* filter,
+											  dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
+											  int* resultCount, const int maxResult) const
+{
+	dtAssert(m_nav);
+	dtAssert(m_nodePool);
+	dtAssert(m_openList);
+
+	dtScopedQueryStats queryStats(m_stats);
+
+	if (!resultCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*resultCount = 0;
+
+	if (!m_nav->isValidPolyRef(startRef) ||
+		!verts || nverts < 3 ||
+		!filter || maxResult < 0)
+	{
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+	
+	// Validate input
+	if (!startRef || !m_nav->isValidPolyRef(startRef))
+		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	m_nodePool->clear();
+	m_openList->clear();
+	
+	float centerPos[3] = {0,0,0};
+	for (int i = 0; i < nverts; ++i)
+		dtVadd(centerPos,centerPos,&verts[i*3]);
+	dtVscale(centerPos,centerPos,1.0f/nverts);
+
+	dtNode* startNode = m_nodePool->getNode(startRef);
+	dtVcopy(startNode->pos, centerPos);
+	startNode->pidx = 0;
+	startNode->cost = 0;
+	startNode->total = 0;
+	startNode->id = startRef;
+	startNode->flags = DT_NODE_OPEN;
+	m_openList->push(startNode);
+	queryStats.updateOpenList(m_openList->size());
+	
+	dtStatus status = DT_SUCCESS;
+
+	int n = 0;
+	
+	while (!m_openList->empty())
+	{
+		dtNode* bestNode = m_openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+		
+		// Get poly and tile.
+		// The API input has been cheked already, skip checking internal data.
+		const dtPolyRef bestRef = bestNode->id;
+		const dtMeshTile* bestTile = 0;
+		const dtPoly* bestPoly = 0;
+		if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		queryStats.expandNode(bestTile);
+		
+		// Get parent poly and tile.
+		dtPolyRef parentRef = 0;
+		const dtMeshTile* parentTile = 0;
+		const dtPoly* parentPoly = 0;
+		if (bestNode->pidx)
+			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+		if (parentRef && dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+		if (n < maxResult)
+		{
+			if (resultRef)
+				resultRef[n] = bestRef;
+			if (resultParent)
+				resultParent[n] = parentRef;
+			if (resultCost)
+				resultCost[n] = bestNode->total;
+
+			++n;
+		}
+		else
+		{
+			status |= DT_BUFFER_TOO_SMALL;
+		}
+		
+		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+		{
+			const dtLink* link = &bestTile->links[i];
+			dtPolyRef neighbourRef = link->ref;
+			queryStats.traverseLink();
+			// Skip invalid neighbours and do not follow back to parent.
+			if (!neighbourRef || neighbourRef == parentRef)
+				continue;
+			
+			// Expand to neighbour
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly)))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+			
+			// Do not advance if the polygon is excluded by the filter.
+			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+			
+			// Find edge and calc distance to the edge.
+			float va[3], vb[3];
+			if (!getPortalPoints(bestRef, bestPoly, bestTile, neighbourRef, neighbourPoly, neighbourTile, va, vb))
+				continue;
+			
+			// If the poly is not touching the edge to the next polygon, skip the connection it.
+			float tmin, tmax;
+			int segMin, segMax;
+			if (!dtIntersectSegmentPoly2D(va, vb, verts, nverts, tmin, tmax, segMin, segMax))
+				continue;
+			if (tmin > 1.0f || tmax < 0.0f)
+				continue;
+			
+			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef);
+			if (!neighbourNode)
+			{
+				status |= DT_OUT_OF_NODES;
+				continue;
+			}
+			queryStats.touchNode();
+			
+			if (neighbourNode->flags & DT_NODE_CLOSED)
+				continue;
+			
+			// Cost
+			if (neighbourNode->flags == 0)
+				dtVlerp(neighbourNode->pos, va, vb, 0.5f);
+			
+			float cost = filter->getCost(
+				bestNode->pos, neighbourNode->pos,
+				parentRef, parentTile, parentPoly,
+				bestRef, bestTile, bestPoly,
+				neighbourRef, neighbourTile, neighbourPoly);
+
+			const float total = bestNode->total + cost;
+			
+			// The node is already in open list and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+				continue;
+			
+			neighbourNode->id = neighbourRef;
+			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
+			neighbourNode->total = total;
+			
+			if (neighbourNode->flags & DT_NODE_OPEN)
+			{
+				m_openList->modify(neighbourNode);
+			}
+			else
+			{
+				neighbourNode->flags = DT_NODE_OPEN;
+				m_openList->push(neighbourNode);
+				queryStats.updateOpenList(m_openList->size());
+			}
+		}
+	}
+	
+	*resultCount = n;
+	
+	return status;
+}
+
 #endif // DETOURNAVMESHQUERY_H
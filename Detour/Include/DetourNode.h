@@ -58,6 +58,9 @@ class dtNodePool
 public:
 	dtNodePool(int maxNodes, int hashSize);
 	~dtNodePool();
+
+	// Removes all the nodes. Takes constant time, the hash buckets of earlier generations are
+	// treated as empty instead of being reset.
 	void clear();
 
 	// Get a dtNode by ref and extra state information. If there is none then - allocate
@@ -89,13 +92,17 @@ public:
 		return sizeof(*this) +
 			sizeof(dtNode)*m_maxNodes +
 			sizeof(dtNodeIndex)*m_maxNodes +
-			sizeof(dtNodeIndex)*m_hashSize;
+			sizeof(unsigned int)*m_hashSize;
 	}
 	
 	inline int getMaxNodes() const { return m_maxNodes; }
 	
 	inline int getHashSize() const { return m_hashSize; }
-	inline dtNodeIndex getFirst(int bucket) const { return m_first[bucket]; }
+	inline dtNodeIndex getFirst(int bucket) const
+	{
+		const unsigned int first = m_first[bucket];
+		return (first >> DT_NODE_GENERATION_SHIFT) == m_generation ? (dtNodeIndex)first : DT_NULL_IDX;
+	}
 	inline dtNodeIndex getNext(int i) const { return m_next[i]; }
 	inline int getNodeCount() const { return m_nodeCount; }
 	
@@ -104,12 +111,18 @@ private:
 	dtNodePool(const dtNodePool&);
 	dtNodePool& operator=(const dtNodePool&);
 	
+	// The first node of each bucket is stored in the low bits, and the generation of the pool
+	// when it was stored in the high bits.
+	static const int DT_NODE_GENERATION_SHIFT = 16;
+	static const unsigned int DT_NODE_MAX_GENERATION = 0xffff;
+
 	dtNode* m_nodes;
-	dtNodeIndex* m_first;
+	unsigned int* m_first;
 	dtNodeIndex* m_next;
 	const int m_maxNodes;
 	const int m_hashSize;
 	int m_nodeCount;
+	unsigned int m_generation;	///< The generation of the pool, counting the clears. [Limit: 1 <= value <= DT_NODE_MAX_GENERATION]
 };
 
 class dtNodeQueue
@@ -149,6 +162,7 @@ public:
 	}
 	
 	inline bool empty() const { return m_size == 0; }
+	inline int size() const { return m_size; }
 	
 	inline int getMemUsed() const
 	{
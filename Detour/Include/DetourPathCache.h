@@ -0,0 +1,155 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURPATHCACHE_H
+#define DETOURPATHCACHE_H
+
+#include <stddef.h>
+#include "DetourNavMeshQuery.h"
+
+/// Path cache statistics. The counters add up until dtPathCache::resetStats().
+/// @ingroup detour
+struct dtPathCacheStats
+{
+	int hits;				///< Paths returned from the cache.
+	int misses;				///< Paths searched because they were not in the cache, or were stale.
+	int staleEntries;		///< Cached paths dropped because a polygon on them has changed.
+	int evictions;			///< Cached paths dropped to make room for new paths.
+	int uncachedPaths;		///< Searched paths not cached: partial, failed, or too long.
+	int entries;			///< The number of cached paths.
+	size_t memory;			///< The memory allocated by the cache.
+};
+
+/// A bounded cache of the paths found by dtNavMeshQuery::findPath, dropping the least
+/// recently used paths first.
+///
+/// The paths are keyed by their start and end polygons and a fingerprint of the filter.
+/// A cached path is returned for any positions within its start and end polygons. Only
+/// complete paths are cached.
+///
+/// The fingerprint only covers the include and exclude flags and the area costs of the
+/// filter. Filters with other state, e.g. subclasses when DT_VIRTUAL_QUERYFILTER is defined,
+/// must pass a key of their own to #findPath, or they get each other's paths.
+///
+/// The polygons of a cached path are checked when the path is returned. A path through a
+/// tile that has been removed or replaced, or through a polygon the filter no longer passes,
+/// is dropped and searched again. Paths that become shorter, e.g. because a new tile was
+/// added, are not found until they are dropped; call #clear after such changes.
+/// @ingroup detour
+class dtPathCache
+{
+public:
+	dtPathCache();
+	~dtPathCache();
+
+	/// Initializes the cache.
+	///  @param[in]		maxEntries		The maximum number of cached paths. [Limit: > 0]
+	///  @param[in]		maxPathSize		The maximum number of polygons of a cached path. [Limit: > 0]
+	/// @return The status flags for the operation.
+	dtStatus init(const int maxEntries, const int maxPathSize);
+
+	/// Returns the cached path between the polygons, or finds it with the query and caches it.
+	/// The parameters are the same as dtNavMeshQuery::findPath.
+	///  @param[in]		query		The query used to find the paths that are not cached.
+	///  @param[in]		startRef	The refrence id of the start polygon.
+	///  @param[in]		endRef		The reference id of the end polygon.
+	///  @param[in]		startPos	A position within the start polygon. [(x, y, z)]
+	///  @param[in]		endPos		A position within the end polygon. [(x, y, z)]
+	///  @param[in]		filter		The polygon filter to apply to the query.
+	///  @param[out]	path		An ordered list of polygon references representing the path. (Start to end.)
+	///  							[(polyRef) * @p pathCount]
+	///  @param[out]	pathCount	The number of polygons returned in the @p path array.
+	///  @param[in]		maxPath		The maximum number of polygons the @p path array can hold. [Limit: >= 1]
+	/// @returns The status flags for the query.
+	dtStatus findPath(const dtNavMeshQuery* query, dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  const dtQueryFilter* filter,
+					  dtPolyRef* path, int* pathCount, const int maxPath);
+
+	/// Returns the cached path between the polygons, or finds it with the query and caches it,
+	/// keyed by the given filter key instead of the fingerprint of the filter.
+	/// The other parameters are the same as the overload above.
+	///  @param[in]		filterKey	The key of the filter, the same for every filter passing the same
+	///  							polygons with the same costs, and different from the keys of the other
+	///  							filters used with the cache.
+	dtStatus findPath(const dtNavMeshQuery* query, dtPolyRef startRef, dtPolyRef endRef,
+					  const float* startPos, const float* endPos,
+					  const dtQueryFilter* filter, const unsigned int filterKey,
+					  dtPolyRef* path, int* pathCount, const int maxPath);
+
+	/// Removes every cached path.
+	void clear();
+
+	/// Returns the fingerprint of the flags and area costs of the filter. (See: #dtGetQueryFilterKey)
+	///  @param[in]		filter		The polygon filter.
+	static unsigned int getFilterKey(const dtQueryFilter* filter);
+
+	const dtPathCacheStats& getStats() const { return m_stats; }
+
+	/// Resets the counters of the statistics.
+	void resetStats();
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtPathCache(const dtPathCache&);
+	dtPathCache& operator=(const dtPathCache&);
+
+	struct Entry
+	{
+		dtPolyRef startRef;
+		dtPolyRef endRef;
+		unsigned int filterKey;
+		int pathCount;
+		int prev;			///< The more recently used entry, or -1.
+		int next;			///< The less recently used entry, or -1.
+		int hashNext;		///< The next entry in the same hash bucket, or -1.
+	};
+
+	void destroy();
+	int findEntry(dtPolyRef startRef, dtPolyRef endRef, const unsigned int filterKey) const;
+	unsigned int hashKey(dtPolyRef startRef, dtPolyRef endRef, const unsigned int filterKey) const;
+	void unlinkEntry(const int idx);
+	void linkEntry(const int idx);
+	void removeEntry(const int idx);
+	void storePath(dtPolyRef startRef, dtPolyRef endRef, const unsigned int filterKey,
+				   const dtPolyRef* path, const int pathCount);
+
+	Entry* m_entries;
+	dtPolyRef* m_paths;		///< The path of each entry. [Size: maxEntries * maxPathSize]
+	int* m_buckets;			///< The first entry of each hash bucket, or -1.
+	int m_bucketMask;
+	int* m_freeEntries;		///< The indices of the unused entries. [Size: maxEntries]
+	int m_nfreeEntries;
+	int m_head;				///< The most recently used entry, or -1.
+	int m_tail;				///< The least recently used entry, or -1.
+	int m_maxEntries;
+	int m_maxPathSize;
+	dtPathCacheStats m_stats;
+};
+
+/// Allocates a path cache using the Detour allocator.
+/// @return A path cache that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtPathCache* dtAllocPathCache();
+
+/// Frees the specified path cache using the Detour allocator.
+///  @param[in]	cache		A path cache allocated using #dtAllocPathCache
+///  @ingroup detour
+void dtFreePathCache(dtPathCache* cache);
+
+#endif // DETOURPATHCACHE_H
@@ -0,0 +1,214 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURQUERYSTATS_H
+#define DETOURQUERYSTATS_H
+
+// Define DT_NO_QUERY_STATS to compile the query statistics out of the queries.
+// The statistics set on a query are then left untouched.
+// Note: The define must be the same for the library and the code using it, the searches
+// taking a filter type are compiled with the code using them. dtNavMeshQuery::init fails
+// with DT_WRONG_VERSION when they differ.
+//#define DT_NO_QUERY_STATS 1
+
+/// The query statistics setting of the code including this header, checked by
+/// dtNavMeshQuery::init against the setting of the library.
+/// @ingroup detour
+#ifdef DT_NO_QUERY_STATS
+static const int DT_QUERY_STATS_CONFIG = 0;
+#else
+static const int DT_QUERY_STATS_CONFIG = 1;
+#endif
+
+struct dtMeshTile;
+
+/// The work done by a query. (See: dtNavMeshQuery::setStats)
+/// @ingroup detour
+struct dtQueryStats
+{
+	int nodesExpanded;		///< The polygons the query stepped from, or tested. (E.g. by dtNavMeshQuery::findNearestPoly)
+	int nodesTouched;		///< The neighbour nodes the query looked at, counted at each look.
+	int openListPeak;		///< The largest number of nodes waiting to be expanded.
+	int tilesTouched;		///< The tiles of the expanded polygons, counted again each time the query comes back to a tile.
+	int linksTraversed;		///< The links the query followed.
+	long long elapsedUsec;	///< The wall time of the query, zero without a clock. [Unit: us] (See: dtQueryStatsSetClock)
+};
+
+/// A function returning a time stamp in microseconds.
+/// @see dtQueryStatsSetClock
+typedef long long (dtQueryClockFunc)();
+
+/// Sets the clock used to time the queries. Without a clock, the elapsed time of the queries is zero.
+///  @param[in]		clockFunc	The clock to use, or null to not time the queries.
+///  @ingroup detour
+void dtQueryStatsSetClock(dtQueryClockFunc* clockFunc);
+
+/// Returns a time stamp from the clock set by #dtQueryStatsSetClock, or zero without a clock.
+/// [Unit: us]
+///  @ingroup detour
+long long dtQueryStatsGetTime();
+
+/// A helper that resets the statistics of a query and times it until it goes out of scope.
+/// Without statistics the helper does nothing but test a null pointer, and with
+/// DT_NO_QUERY_STATS defined it does nothing at all.
+/// @see dtNavMeshQuery::setStats
+class dtScopedQueryStats
+{
+public:
+	/// Constructs an instance and starts the timer.
+	///  @param[in]		stats		The statistics to fill, or null.
+	///  @param[in]		accumulate	True to add to the statistics instead of resetting them.
+	///  							(E.g. the steps of a sliced path search.)
+	inline dtScopedQueryStats(dtQueryStats* stats, const bool accumulate = false) :
+#ifdef DT_NO_QUERY_STATS
+		m_stats(((void)stats, (dtQueryStats*)0)),
+#else
+		m_stats(stats),
+#endif
+		m_lastTile(0),
+		m_start(0)
+	{
+		if (!m_stats)
+			return;
+		if (!accumulate)
+		{
+			m_stats->nodesExpanded = 0;
+			m_stats->nodesTouched = 0;
+			m_stats->openListPeak = 0;
+			m_stats->tilesTouched = 0;
+			m_stats->linksTraversed = 0;
+			m_stats->elapsedUsec = 0;
+		}
+		m_start = dtQueryStatsGetTime();
+	}
+
+	inline ~dtScopedQueryStats()
+	{
+		if (m_stats)
+			m_stats->elapsedUsec += dtQueryStatsGetTime() - m_start;
+	}
+
+	/// Counts a polygon the query steps from, or tests.
+	inline void expandNode(const dtMeshTile* tile)
+	{
+		if (!m_stats)
+			return;
+		m_stats->nodesExpanded++;
+		if (tile != m_lastTile)
+		{
+			m_stats->tilesTouched++;
+			m_lastTile = tile;
+		}
+	}
+
+	/// Counts a neighbour node the query looks at.
+	inline void touchNode() { if (m_stats) m_stats->nodesTouched++; }
+
+	/// Counts a link the query follows.
+	inline void traverseLink() { if (m_stats) m_stats->linksTraversed++; }
+
+	/// Keeps the largest number of nodes waiting to be expanded.
+	inline void updateOpenList(const int size)
+	{
+		if (m_stats && size > m_stats->openListPeak)
+			m_stats->openListPeak = size;
+	}
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtScopedQueryStats(const dtScopedQueryStats&);
+	dtScopedQueryStats& operator=(const dtScopedQueryStats&);
+
+	dtQueryStats* const m_stats;
+	const dtMeshTile* m_lastTile;	///< The tile of the last expanded polygon.
+	long long m_start;				///< The time stamp the query started at.
+};
+
+/// The values of the query statistics.
+/// @see dtQueryStatsHistogram
+enum dtQueryStatsValue
+{
+	DT_QUERY_NODES_EXPANDED = 0,
+	DT_QUERY_NODES_TOUCHED,
+	DT_QUERY_OPEN_LIST_PEAK,
+	DT_QUERY_TILES_TOUCHED,
+	DT_QUERY_LINKS_TRAVERSED,
+	DT_QUERY_ELAPSED_USEC,
+	DT_QUERY_STATS_VALUE_COUNT
+};
+
+/// The number of buckets of the query statistics histograms.
+static const int DT_QUERY_STATS_BUCKET_COUNT = 32;
+
+/// Returns a value of the query statistics.
+///  @param[in]		stats		The query statistics.
+///  @param[in]		value		The value to return.
+///  @ingroup detour
+long long dtGetQueryStatsValue(const dtQueryStats& stats, const dtQueryStatsValue value);
+
+/// Histograms of the statistics of many queries.
+///
+/// The buckets are powers of two: bucket 0 counts the zero values, and bucket @e i the values
+/// in [2^(i-1), 2^i). The last bucket also counts the larger values.
+/// @ingroup detour
+class dtQueryStatsHistogram
+{
+public:
+	dtQueryStatsHistogram();
+
+	/// Adds the statistics of a query to the histograms.
+	///  @param[in]		stats		The statistics of the query.
+	void addSample(const dtQueryStats& stats);
+
+	/// Removes every sample.
+	void reset();
+
+	/// Returns the number of added queries.
+	int getSampleCount() const { return m_sampleCount; }
+
+	/// Returns the number of queries counted in a bucket.
+	///  @param[in]		value		The value of the statistics.
+	///  @param[in]		bucket		The bucket index. [Limits: 0 <= value < #DT_QUERY_STATS_BUCKET_COUNT]
+	int getBucketCount(const dtQueryStatsValue value, const int bucket) const;
+
+	/// Returns the sum of a value over the added queries.
+	long long getTotal(const dtQueryStatsValue value) const;
+
+	/// Returns the largest value of the added queries.
+	long long getMax(const dtQueryStatsValue value) const;
+
+	/// Returns an upper bound of a percentile of a value: the largest value of the bucket
+	/// holding the percentile, or the largest added value if it is smaller.
+	///  @param[in]		value		The value of the statistics.
+	///  @param[in]		percentile	The percentile. [Limits: 0 <= value <= 100]
+	long long getPercentile(const dtQueryStatsValue value, const float percentile) const;
+
+	/// Returns the bucket counting a value.
+	static int getBucket(const long long value);
+
+	/// Returns the smallest value counted in a bucket.
+	static long long getBucketMin(const int bucket);
+
+private:
+	int m_buckets[DT_QUERY_STATS_VALUE_COUNT][DT_QUERY_STATS_BUCKET_COUNT];
+	long long m_totals[DT_QUERY_STATS_VALUE_COUNT];
+	long long m_max[DT_QUERY_STATS_VALUE_COUNT];
+	int m_sampleCount;
+};
+
+#endif // DETOURQUERYSTATS_H
@@ -0,0 +1,70 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURTILECOMPRESSOR_H
+#define DETOURTILECOMPRESSOR_H
+
+#include "DetourStatus.h"
+
+/// Compresses the data of the navigation mesh tiles that have not been used recently.
+/// @see dtNavMesh::setTileCompression
+/// @ingroup detour
+class dtTileCompressor
+{
+public:
+	virtual ~dtTileCompressor() {}
+
+	/// Returns the size of the buffer #compress needs for @p bufferSize bytes of input.
+	virtual int maxCompressedSize(const int bufferSize) = 0;
+
+	/// Compresses the buffer.
+	///  @param[in]		buffer				The data to compress. [Size: @p bufferSize]
+	///  @param[in]		bufferSize			The size of the data.
+	///  @param[out]	compressed			Receives the compressed data. [Size: @p maxCompressedSize]
+	///  @param[in]		maxCompressedSize	The size of the compressed buffer. [Limit: >= #maxCompressedSize(@p bufferSize)]
+	///  @param[out]	compressedSize		The size of the compressed data.
+	/// @return The status flags for the operation.
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+							  unsigned char* compressed, const int maxCompressedSize, int* compressedSize) = 0;
+
+	/// Decompresses data compressed by #compress.
+	///  @param[in]		compressed			The compressed data. [Size: @p compressedSize]
+	///  @param[in]		compressedSize		The size of the compressed data.
+	///  @param[out]	buffer				Receives the data. [Size: @p maxBufferSize]
+	///  @param[in]		maxBufferSize		The size of the buffer.
+	///  @param[out]	bufferSize			The size of the data.
+	/// @return The status flags for the operation.
+	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+								unsigned char* buffer, const int maxBufferSize, int* bufferSize) = 0;
+};
+
+/// A fast byte oriented LZ77 compressor, writing the LZ4 block format.
+/// Decompression checks all the lengths and offsets, so corrupt data fails instead of
+/// writing out of bounds.
+/// @ingroup detour
+class dtLZTileCompressor : public dtTileCompressor
+{
+public:
+	virtual int maxCompressedSize(const int bufferSize);
+	virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
+							  unsigned char* compressed, const int maxCompressedSize, int* compressedSize);
+	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+								unsigned char* buffer, const int maxBufferSize, int* bufferSize);
+};
+
+#endif // DETOURTILECOMPRESSOR_H
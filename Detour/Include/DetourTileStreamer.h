@@ -0,0 +1,228 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef DETOURTILESTREAMER_H
+#define DETOURTILESTREAMER_H
+
+#include <stddef.h>
+#include "DetourNavMesh.h"
+#include "DetourStatus.h"
+
+/// The maximum number of tile layers loaded at one tile location.
+/// @ingroup detour
+static const int DT_TILE_STREAM_MAX_LAYERS = 32;
+
+/// The tiles of one tile location, loaded by a dtTileStreamSource.
+/// @ingroup detour
+struct dtTileStreamLoad
+{
+	int x;				///< The x-location of the tiles. (Set by the streamer.)
+	int y;				///< The y-location of the tiles. (Set by the streamer.)
+	unsigned char* data[DT_TILE_STREAM_MAX_LAYERS];	///< The tile data, allocated with #dtAlloc. [Size: #ntiles]
+	int dataSize[DT_TILE_STREAM_MAX_LAYERS];		///< The size of each tile data. [Size: #ntiles]
+	int ntiles;			///< The number of tiles at the location. Zero if the location has no tiles.
+	dtStatus status;	///< The result of the load.
+	void* userData;		///< Free for the source to use while the load is in flight.
+};
+
+/// Provides the tile data for a dtTileStreamer.
+///
+/// The streamer calls the source only from dtTileStreamer::update(). A source can do the
+/// loading and decoding on its own thread: #beginLoad queues the work, and #isLoadDone
+/// reports when it is finished. The source is responsible for making the results of the
+/// load visible to the calling thread before #isLoadDone returns true.
+/// @ingroup detour
+class dtTileStreamSource
+{
+public:
+	virtual ~dtTileStreamSource() {}
+
+	/// Starts loading the tiles at (dtTileStreamLoad::x, dtTileStreamLoad::y).
+	/// @return The status flags for the operation. On failure the location is not loaded.
+	virtual dtStatus beginLoad(dtTileStreamLoad* load) = 0;
+
+	/// Returns true once the load has finished, and its tiles and status can be read.
+	virtual bool isLoadDone(dtTileStreamLoad* load) = 0;
+
+	/// Tells the source that the tiles of a load in flight are no longer needed.
+	/// The streamer still waits for #isLoadDone before it releases the load.
+	virtual void cancelLoad(dtTileStreamLoad* /*load*/) {}
+
+	/// Blocks until the load has finished. Called when the streamer has to release a load in
+	/// flight right away. (E.g. dtTileStreamer::unloadAll)
+	/// The default polls #isLoadDone. A source loading on its own thread should wait on that
+	/// thread instead of spinning.
+	virtual void waitLoad(dtTileStreamLoad* load)
+	{
+		while (!isLoadDone(load))
+			;
+	}
+
+	/// Returns a time stamp in microseconds, used to keep the commits in the update budget.
+	/// The default has no clock, which leaves only dtTileStreamParams::maxCommitsPerUpdate.
+	virtual long long getTimeUsec() { return 0; }
+};
+
+/// Configuration parameters used to define a tile streamer.
+/// @ingroup detour
+struct dtTileStreamParams
+{
+	int maxEntries;				///< The maximum number of tile locations tracked: resident, empty, or loading. [Limit: > 0]
+	int maxLoads;				///< The maximum number of loads in flight or waiting to be committed. [Limit: > 0]
+	int maxInterestPoints;		///< The maximum number of interest points. [Limit: > 0]
+	size_t maxResidentBytes;	///< The maximum size of the resident tile data, or zero for no limit.
+	float unloadMargin;			///< How far beyond its radius a tile is kept before it is unloaded. [Limit: >= 0]
+	int maxCommitsPerUpdate;	///< The maximum number of locations loaded or unloaded per update, or zero for no limit.
+	int commitBudgetUsec;		///< The time budget of the commits in an update, or zero for no limit. [Unit: us]
+};
+
+/// Tile streaming statistics. The counters add up until dtTileStreamer::resetStats().
+/// @ingroup detour
+struct dtTileStreamStats
+{
+	int requestedLoads;			///< Loads started.
+	int completedLoads;			///< Loads that finished and were committed to the navigation mesh.
+	int failedLoads;			///< Loads that failed, or whose tiles could not be added to the navigation mesh.
+	int cancelledLoads;			///< Loads that were no longer needed when they finished.
+	int droppedLoads;			///< Loads that did not fit in the memory budget.
+	int evictedTiles;			///< Tiles unloaded after leaving the interest radius.
+	int memoryEvictedTiles;		///< Tiles unloaded to make room for nearer tiles.
+	int deferredUpdates;		///< Updates that left work for later because of the commit budget.
+	int residentTiles;			///< The number of tiles in the navigation mesh loaded by the streamer.
+	size_t residentBytes;		///< The size of the resident tile data.
+	size_t peakResidentBytes;	///< The largest the resident tile data has been.
+	int pendingLoads;			///< The number of loads in flight or waiting to be committed.
+};
+
+/// Keeps the tiles around a set of interest points loaded in a navigation mesh.
+///
+/// Each update unloads the tiles that are too far from every interest point, commits the
+/// loads that have finished, nearest first, and starts loading the nearest missing tiles.
+/// Only the commits are limited by the update budget.
+/// @ingroup detour
+class dtTileStreamer
+{
+public:
+	dtTileStreamer();
+	~dtTileStreamer();
+
+	/// Initializes the streamer.
+	///  @param[in]		params		The streamer parameters.
+	///  @param[in]		nav			The navigation mesh the tiles are added to.
+	///  @param[in]		source		Loads the tile data.
+	/// @return The status flags for the operation.
+	dtStatus init(const dtTileStreamParams* params, dtNavMesh* nav, dtTileStreamSource* source);
+
+	/// Sets the points around which the tiles should be loaded.
+	///  @param[in]		pos			The interest points. [(x, y, z) * @p count]
+	///  @param[in]		radius		The radius of each interest point. [Size: @p count]
+	///  @param[in]		count		The number of interest points.
+	/// @return The status flags for the operation.
+	dtStatus setInterestPoints(const float* pos, const float* radius, const int count);
+
+	/// Unloads, commits and starts loading tiles.
+	///  @param[out]	upToDate	Whether every tile within the interest radii is loaded. [opt]
+	/// @return The status flags for the operation.
+	dtStatus update(bool* upToDate = 0);
+
+	/// Unloads all the tiles loaded by the streamer, and waits for the loads in flight.
+	void unloadAll();
+
+	const dtTileStreamParams* getParams() const { return &m_params; }
+	const dtTileStreamStats& getStats() const { return m_stats; }
+
+	/// Resets the counters of the statistics.
+	void resetStats();
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	dtTileStreamer(const dtTileStreamer&);
+	dtTileStreamer& operator=(const dtTileStreamer&);
+
+	enum EntryState
+	{
+		ENTRY_FREE,
+		ENTRY_LOADING,
+		ENTRY_READY,
+		ENTRY_RESIDENT,
+	};
+
+	struct Entry
+	{
+		int x, y;
+		float dist;			///< Distance outside the nearest interest radius, negative inside.
+		size_t bytes;		///< The size of the resident tile data.
+		int ntiles;			///< The number of resident tiles.
+		int load;			///< The index of the load, or -1.
+		unsigned char state;
+		unsigned char cancelled;
+		Entry* next;
+	};
+
+	struct Candidate
+	{
+		int x, y;
+		float dist;
+	};
+
+	void destroy();
+	Entry* findEntry(const int x, const int y) const;
+	Entry* allocEntry(const int x, const int y);
+	void freeEntry(Entry* entry);
+	float calcDist(const int x, const int y) const;
+	void evictEntry(Entry* entry);
+	void releaseLoad(Entry* entry, const bool freeData);
+	bool commitLoad(Entry* entry);
+	bool isOverBudget(const int commits, const long long startTime) const;
+
+	dtTileStreamParams m_params;
+	dtNavMesh* m_nav;
+	dtTileStreamSource* m_source;
+	float m_orig[3];
+	float m_tileWidth, m_tileHeight;
+
+	Entry* m_entries;
+	Entry* m_nextFreeEntry;
+	Entry** m_posLookup;		///< Entry hash lookup.
+	int m_lutMask;
+
+	dtTileStreamLoad* m_loads;
+	int* m_freeLoads;
+	int m_nfreeLoads;
+
+	Entry** m_ready;			///< The finished loads to commit, nearest first. [Size: maxLoads]
+	Candidate* m_candidates;	///< The nearest missing tiles to load. [Size: maxLoads]
+
+	float* m_interestPos;
+	float* m_interestRadius;
+	int m_ninterest;
+
+	dtTileStreamStats m_stats;
+};
+
+/// Allocates a tile streamer object using the Detour allocator.
+/// @return A tile streamer that is ready for initialization, or null on failure.
+///  @ingroup detour
+dtTileStreamer* dtAllocTileStreamer();
+
+/// Frees the specified tile streamer object using the Detour allocator.
+///  @param[in]	streamer		A tile streamer allocated using #dtAllocTileStreamer
+///  @ingroup detour
+void dtFreeTileStreamer(dtTileStreamer* streamer);
+
+#endif // DETOURTILESTREAMER_H
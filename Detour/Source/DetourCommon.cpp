@@ -232,6 +232,81 @@ bool dtClosestHeightPointTriangle(const float* p, const float* a, const float* b
 	return false;
 }
 
+int dtClosestHeightPointTriangle4(const float* p, const float* tris, float& h)
+{
+	const float EPS = 1e-6f;
+	const float* ax = tris;
+	const float* ay = tris + 4;
+	const float* az = tris + 8;
+
+	float u[4], v[4], denom[4];
+	int mask = 0;
+#ifdef DT_SSE2
+	// The same operations as dtClosestHeightPointTriangle, four triangles at a time.
+	const __m128i signBit = _mm_set1_epi32((int)0x80000000);
+	const __m128 a0 = _mm_loadu_ps(ax), a2 = _mm_loadu_ps(az);
+	const __m128 v0x = _mm_sub_ps(_mm_loadu_ps(tris + 24), a0);
+	const __m128 v0z = _mm_sub_ps(_mm_loadu_ps(tris + 32), a2);
+	const __m128 v1x = _mm_sub_ps(_mm_loadu_ps(tris + 12), a0);
+	const __m128 v1z = _mm_sub_ps(_mm_loadu_ps(tris + 20), a2);
+	const __m128 v2x = _mm_sub_ps(_mm_set1_ps(p[0]), a0);
+	const __m128 v2z = _mm_sub_ps(_mm_set1_ps(p[2]), a2);
+
+	__m128 d = _mm_sub_ps(_mm_mul_ps(v0x, v1z), _mm_mul_ps(v0z, v1x));
+	__m128 uu = _mm_sub_ps(_mm_mul_ps(v1z, v2x), _mm_mul_ps(v1x, v2z));
+	__m128 vv = _mm_sub_ps(_mm_mul_ps(v0x, v2z), _mm_mul_ps(v0z, v2x));
+
+	// Negate all three where the denominator is negative.
+	const __m128 flip = _mm_and_ps(_mm_cmplt_ps(d, _mm_setzero_ps()), _mm_castsi128_ps(signBit));
+	const __m128 valid = _mm_cmpnlt_ps(_mm_andnot_ps(_mm_castsi128_ps(signBit), d), _mm_set1_ps(EPS));
+	d = _mm_xor_ps(d, flip);
+	uu = _mm_xor_ps(uu, flip);
+	vv = _mm_xor_ps(vv, flip);
+
+	__m128 inside = _mm_and_ps(valid, _mm_cmpge_ps(uu, _mm_setzero_ps()));
+	inside = _mm_and_ps(inside, _mm_cmpge_ps(vv, _mm_setzero_ps()));
+	inside = _mm_and_ps(inside, _mm_cmple_ps(_mm_add_ps(uu, vv), d));
+	mask = _mm_movemask_ps(inside);
+	if (!mask)
+		return -1;
+	_mm_storeu_ps(u, uu);
+	_mm_storeu_ps(v, vv);
+	_mm_storeu_ps(denom, d);
+#else
+	for (int i = 0; i < 4; ++i)
+	{
+		const float v0[3] = { tris[24+i] - ax[i], tris[28+i] - ay[i], tris[32+i] - az[i] };
+		const float v1[3] = { tris[12+i] - ax[i], tris[16+i] - ay[i], tris[20+i] - az[i] };
+		const float v2[2] = { p[0] - ax[i], p[2] - az[i] };
+		denom[i] = v0[0] * v1[2] - v0[2] * v1[0];
+		if (fabsf(denom[i]) < EPS)
+			continue;
+		u[i] = v1[2] * v2[0] - v1[0] * v2[1];
+		v[i] = v0[0] * v2[1] - v0[2] * v2[0];
+		if (denom[i] < 0)
+		{
+			denom[i] = -denom[i];
+			u[i] = -u[i];
+			v[i] = -v[i];
+		}
+		if (u[i] >= 0.0f && v[i] >= 0.0f && (u[i] + v[i]) <= denom[i])
+			mask |= 1 << i;
+	}
+#endif
+
+	for (int i = 0; i < 4; ++i)
+	{
+		if (mask & (1 << i))
+		{
+			const float v0y = tris[28+i] - ay[i];
+			const float v1y = tris[16+i] - ay[i];
+			h = ay[i] + (v0y * u[i] + v1y * v[i]) / denom[i];
+			return i;
+		}
+	}
+	return -1;
+}
+
 /// @par
 ///
 /// All points are projected onto the xz-plane, so the y-values are ignored.
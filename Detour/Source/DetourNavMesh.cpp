@@ -19,12 +19,14 @@
 #include <float.h>
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include "DetourNavMesh.h"
 #include "DetourNode.h"
 #include "DetourCommon.h"
 #include "DetourMath.h"
 #include "DetourAlloc.h"
 #include "DetourAssert.h"
+#include "DetourTileCompressor.h"
 #include <new>
 
 
@@ -136,6 +138,13 @@ inline void freeLink(dtMeshTile* tile, unsigned int link)
 	tile->linksFreeList = link;
 }
 
+// Off-mesh connection vertices are stored as floats also in quantized tiles.
+inline float* getOffMeshVert(dtMeshTile* tile, const int i)
+{
+	const int base = tile->quantVerts ? tile->header->vertCount - tile->header->offMeshConCount*2 : 0;
+	return &tile->verts[(i - base)*3];
+}
+
 
 dtNavMesh* dtAllocNavMesh()
 {
@@ -194,8 +203,17 @@ dtNavMesh::dtNavMesh() :
 	m_tileLutSize(0),
 	m_tileLutMask(0),
 	m_posLookup(0),
+	m_tileGrid(0),
+	m_gridWidth(0),
+	m_gridHeight(0),
+	m_gridLayers(0),
+	m_gridOverflow(0),
 	m_nextFree(0),
-	m_tiles(0)
+	m_tiles(0),
+	m_compressor(0),
+	m_maxResidentTiles(0),
+	m_tileUseCount(0),
+	m_tileGeneration(0)
 {
 #ifndef DT_POLYREF64
 	m_saltBits = 0;
@@ -203,6 +221,7 @@ dtNavMesh::dtNavMesh() :
 	m_polyBits = 0;
 #endif
 	memset(&m_params, 0, sizeof(dtNavMeshParams));
+	memset(&m_compressionStats, 0, sizeof(m_compressionStats));
 	m_orig[0] = 0;
 	m_orig[1] = 0;
 	m_orig[2] = 0;
@@ -218,11 +237,26 @@ dtNavMesh::~dtNavMesh()
 			m_tiles[i].data = 0;
 			m_tiles[i].dataSize = 0;
 		}
+		dtFree(m_tiles[i].compressedData);
+		dtFree(m_tiles[i].overlay);
+		if (!(m_tiles[i].flags & DT_TILE_SHARED_DATA))
+		{
+			dtFree(m_tiles[i].borderEdges);
+			dtFree(m_tiles[i].polyGridCells);
+		}
 	}
 	dtFree(m_posLookup);
+	dtFree(m_tileGrid);
 	dtFree(m_tiles);
 }
-		
+
+/// @par
+///
+/// Tiles are normally looked up by location with a hash table. If the tile grid
+/// of the mesh is bounded, set dtNavMeshParams::gridWidth and dtNavMeshParams::gridHeight
+/// to use a dense grid instead, which finds the tiles with a single memory access.
+/// Tiles outside the grid, or on a layer above dtNavMeshParams::gridLayers, still go
+/// to the hash table.
 dtStatus dtNavMesh::init(const dtNavMeshParams* params)
 {
 	memcpy(&m_params, params, sizeof(dtNavMeshParams));
@@ -244,6 +278,21 @@ dtStatus dtNavMesh::init(const dtNavMeshParams* params)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	memset(m_tiles, 0, sizeof(dtMeshTile)*m_maxTiles);
 	memset(m_posLookup, 0, sizeof(dtMeshTile*)*m_tileLutSize);
+
+	// Init the dense tile lookup.
+	if (params->gridWidth < 0 || params->gridHeight < 0 || params->gridLayers < 0 || params->polyGridCellSize < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (params->gridWidth > 0 && params->gridHeight > 0)
+	{
+		m_gridWidth = params->gridWidth;
+		m_gridHeight = params->gridHeight;
+		m_gridLayers = dtMax(1, params->gridLayers);
+		const int gridSize = m_gridWidth*m_gridHeight*m_gridLayers;
+		m_tileGrid = (dtMeshTile**)dtAlloc(sizeof(dtMeshTile*)*gridSize, DT_ALLOC_PERM);
+		if (!m_tileGrid)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		memset(m_tileGrid, 0, sizeof(dtMeshTile*)*gridSize);
+	}
 	m_nextFree = 0;
 	for (int i = m_maxTiles-1; i >= 0; --i)
 	{
@@ -276,6 +325,7 @@ dtStatus dtNavMesh::init(unsigned char* data, const int dataSize, const int flag
 		return DT_FAILURE | DT_WRONG_VERSION;
 
 	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
 	dtVcopy(params.orig, header->bmin);
 	params.tileWidth = header->bmax[0] - header->bmin[0];
 	params.tileHeight = header->bmax[2] - header->bmin[2];
@@ -289,6 +339,75 @@ dtStatus dtNavMesh::init(unsigned char* data, const int dataSize, const int flag
 	return addTile(data, dataSize, flags, 0, 0);
 }
 
+/// @par
+///
+/// The tiles of the base mesh are used in place, at the same tile references, so that
+/// the instances of the same content cost little memory. A tile copies its polygons,
+/// links and off-mesh connection vertices when it is first changed: when its polygon
+/// flags or areas are set, or when a neighbour tile is added or removed. Tiles added
+/// to this mesh, for example rebuilt by a tile cache, belong to this mesh only.
+///
+/// The base mesh must not have compressed tiles. It can be queried as usual, but
+/// must not be changed while it is shared.
+dtStatus dtNavMesh::initShared(const dtNavMesh* base)
+{
+	if (!base || base == this || !base->m_tiles)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	for (int i = 0; i < base->m_maxTiles; ++i)
+	{
+		if (base->m_tiles[i].compressedData)
+			return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	dtStatus status = init(&base->m_params);
+	if (dtStatusFailed(status))
+		return status;
+
+	// Use the tiles at the same indices and salts, so that the links stay valid.
+	m_nextFree = 0;
+	for (int i = m_maxTiles-1; i >= 0; --i)
+	{
+		const dtMeshTile* src = &base->m_tiles[i];
+		dtMeshTile* tile = &m_tiles[i];
+		tile->salt = src->salt;
+		if (!src->header)
+		{
+			tile->next = m_nextFree;
+			m_nextFree = tile;
+			continue;
+		}
+		tile->linksFreeList = src->linksFreeList;
+		tile->header = src->header;
+		tile->polys = src->polys;
+		tile->verts = src->verts;
+		tile->links = src->links;
+		tile->detailMeshes = src->detailMeshes;
+		tile->detailVerts = src->detailVerts;
+		tile->detailTris = src->detailTris;
+		tile->bvTree = src->bvTree;
+		tile->bvWideTree = src->bvWideTree;
+		tile->offMeshCons = src->offMeshCons;
+		tile->detailGrids = src->detailGrids;
+		tile->detailGridCells = src->detailGridCells;
+		tile->detailGridTris = src->detailGridTris;
+		tile->quantVerts = src->quantVerts;
+		tile->quantDetailVerts = src->quantDetailVerts;
+		tile->borderEdges = src->borderEdges;
+		memcpy(tile->borderEdgeBase, src->borderEdgeBase, sizeof(tile->borderEdgeBase));
+		memcpy(tile->borderEdgeMaxLen, src->borderEdgeMaxLen, sizeof(tile->borderEdgeMaxLen));
+		tile->polyGridCells = src->polyGridCells;
+		tile->polyGridPolys = src->polyGridPolys;
+		tile->polyGridWidth = src->polyGridWidth;
+		tile->polyGridHeight = src->polyGridHeight;
+		tile->data = src->data;
+		tile->dataSize = src->dataSize;
+		tile->flags = DT_TILE_SHARED_DATA;
+		addTileToLookup(tile);
+	}
+
+	return DT_SUCCESS;
+}
+
 /// @par
 ///
 /// @note The parameters are created automatically when the single tile
@@ -307,7 +426,7 @@ int dtNavMesh::findConnectingPolys(const float* va, const float* vb,
 								   const dtMeshTile* tile, int side,
 								   dtPolyRef* con, float* conarea, int maxcon) const
 {
-	if (!tile) return 0;
+	if (!tile || !tile->borderEdges) return 0;
 
 	// slab 其实就是二维的包围盒
 	// 获取 va-vb 在 side 方向之外的另外两个轴上投影的包围盒
@@ -316,54 +435,288 @@ int dtNavMesh::findConnectingPolys(const float* va, const float* vb,
 	// 获取 va-vb 起始点在 side 方向的轴上的坐标
 	const float apos = getSlabCoord(va, side);
 
-	// Remove links pointing to 'side' and compact the links array. 
-	float bmin[2], bmax[2];
-	unsigned short m = DT_EXT_LINK | (unsigned short)side;
+	// The border edges of the side are sorted by their start point, so only the edges
+	// starting after the start of the segment minus the longest edge can overlap it.
+	const dtBorderEdge* edges = &tile->borderEdges[tile->borderEdgeBase[side]];
+	const int nedges = tile->borderEdgeBase[side+1] - tile->borderEdgeBase[side];
+	const float lo = amin[0] - tile->borderEdgeMaxLen[side] - 0.01f;
+	int first = 0;
+	int last = nedges;
+	while (first < last)
+	{
+		const int mid = (first + last) / 2;
+		if (edges[mid].bmin[0] < lo)
+			first = mid+1;
+		else
+			last = mid;
+	}
+
+	// Collect the polygons with the lowest indices, and the first matching edge of each,
+	// so that the result is the same as when scanning all the polygons of the tile.
+	static const int MAX_CON = 8;
+	unsigned short conPoly[MAX_CON];
+	unsigned short conEdge[MAX_CON];
+	float conArea[MAX_CON*2];
+	maxcon = dtMin(maxcon, MAX_CON);
 	int n = 0;
-	
-	dtPolyRef base = getPolyRefBase(tile);
-	
-	for (int i = 0; i < tile->header->polyCount; ++i)
+
+	for (int k = first; k < nedges && edges[k].bmin[0] <= amax[0]; ++k)
 	{
-		dtPoly* poly = &tile->polys[i];
+		const dtBorderEdge* edge = &edges[k];
+
+		// Segments are not close enough.
+		// 因为要再 side 方向的轴上进行判断
+		// 而 apos bpos 是 va-vb vc-vd 的起始点在 side 方向的轴上的坐标
+		// src tile 中的 va-vb 与 dst tile 中的 vc-vd 在顺序上应该是相反的
+		// 但是这里顺序无关，va-vb vc-vd 必须要重合，所以在 side 方向的轴上坐标应该相等
+		// 所以判断这两个浮点值不大于一个较小值即可判断
+		if (dtAbs(apos-edge->pos) > 0.01f)
+			continue;
+
+		// Check if the segments touch.
+		// 判断两个包围盒是否相交
+		if (!overlapSlabs(amin,amax, edge->bmin,edge->bmax, 0.01f, tile->header->walkableClimb)) continue;
+
+		// Find where the polygon goes in the result.
+		int pos = 0;
+		while (pos < n && conPoly[pos] < edge->poly)
+			pos++;
+		if (pos < n && conPoly[pos] == edge->poly)
+		{
+			if (edge->edge > conEdge[pos])
+				continue;
+		}
+		else
+		{
+			if (pos >= maxcon)
+				continue;
+			if (n < maxcon)
+				n++;
+			for (int i = n-1; i > pos; --i)
+			{
+				conPoly[i] = conPoly[i-1];
+				conEdge[i] = conEdge[i-1];
+				conArea[i*2+0] = conArea[(i-1)*2+0];
+				conArea[i*2+1] = conArea[(i-1)*2+1];
+			}
+		}
+		// conarea 就是相交部分的二维包围盒
+		conPoly[pos] = edge->poly;
+		conEdge[pos] = edge->edge;
+		conArea[pos*2+0] = dtMax(amin[0], edge->bmin[0]);
+		conArea[pos*2+1] = dtMin(amax[0], edge->bmax[0]);
+	}
+
+	const dtPolyRef base = getPolyRefBase(tile);
+	for (int i = 0; i < n; ++i)
+	{
+		con[i] = base | (dtPolyRef)conPoly[i];
+		conarea[i*2+0] = conArea[i*2+0];
+		conarea[i*2+1] = conArea[i*2+1];
+	}
+	return n;
+}
+
+static int compareBorderEdges(const void* va, const void* vb)
+{
+	const dtBorderEdge* a = (const dtBorderEdge*)va;
+	const dtBorderEdge* b = (const dtBorderEdge*)vb;
+	if (a->bmin[0] < b->bmin[0]) return -1;
+	if (a->bmin[0] > b->bmin[0]) return 1;
+	if (a->poly != b->poly) return a->poly < b->poly ? -1 : 1;
+	if (a->edge != b->edge) return a->edge < b->edge ? -1 : 1;
+	return 0;
+}
+
+bool dtNavMesh::buildBorderEdges(dtMeshTile* tile)
+{
+	const dtMeshHeader* header = tile->header;
+
+	tile->borderEdges = 0;
+	memset(tile->borderEdgeBase, 0, sizeof(tile->borderEdgeBase));
+	memset(tile->borderEdgeMaxLen, 0, sizeof(tile->borderEdgeMaxLen));
+
+	// Count the portal edges of each side.
+	int count[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+	for (int i = 0; i < header->polyCount; ++i)
+	{
+		const dtPoly* poly = &tile->polys[i];
+		for (int j = 0; j < poly->vertCount; ++j)
+		{
+			if ((poly->neis[j] & DT_EXT_LINK) && (poly->neis[j] & 0xff) < 8)
+				count[poly->neis[j] & 0xff]++;
+		}
+	}
+	for (int i = 0; i < 8; ++i)
+		tile->borderEdgeBase[i+1] = tile->borderEdgeBase[i] + count[i];
+
+	const int nedges = tile->borderEdgeBase[8];
+	if (!nedges)
+		return true;
+
+	tile->borderEdges = (dtBorderEdge*)dtAlloc(sizeof(dtBorderEdge)*nedges, DT_ALLOC_PERM);
+	if (!tile->borderEdges)
+		return false;
+	memset(tile->borderEdges, 0, sizeof(dtBorderEdge)*nedges);
+
+	int next[8];
+	memcpy(next, tile->borderEdgeBase, sizeof(next));
+	for (int i = 0; i < header->polyCount; ++i)
+	{
+		const dtPoly* poly = &tile->polys[i];
 		const int nv = poly->vertCount;
 		for (int j = 0; j < nv; ++j)
 		{
-			// Skip edges which do not point to the right side.
-			if (poly->neis[j] != m) continue;
+			if ((poly->neis[j] & DT_EXT_LINK) == 0 || (poly->neis[j] & 0xff) >= 8)
+				continue;
+			const int side = poly->neis[j] & 0xff;
+			float tc[3], td[3];
+			const float* vc = tile->getVert(poly->verts[j], tc);
+			const float* vd = tile->getVert(poly->verts[(j+1) % nv], td);
+			dtBorderEdge* edge = &tile->borderEdges[next[side]++];
+			edge->pos = getSlabCoord(vc, side);
+			calcSlabEndPoints(vc, vd, edge->bmin, edge->bmax, side);
+			edge->poly = (unsigned short)i;
+			edge->edge = (unsigned short)j;
+			tile->borderEdgeMaxLen[side] = dtMax(tile->borderEdgeMaxLen[side], edge->bmax[0] - edge->bmin[0]);
+		}
+	}
 
-			const float* vc = &tile->verts[poly->verts[j]*3];
-			const float* vd = &tile->verts[poly->verts[(j+1) % nv]*3];
-			const float bpos = getSlabCoord(vc, side);
-			
-			// Segments are not close enough.
-			// 因为要再 side 方向的轴上进行判断
-			// 而 apos bpos 是 va-vb vc-vd 的起始点在 side 方向的轴上的坐标
-			// src tile 中的 va-vb 与 dst tile 中的 vc-vd 在顺序上应该是相反的
-			// 但是这里顺序无关，va-vb vc-vd 必须要重合，所以在 side 方向的轴上坐标应该相等
-			// 所以判断这两个浮点值不大于一个较小值即可判断
-			if (dtAbs(apos-bpos) > 0.01f)
+	for (int i = 0; i < 8; ++i)
+	{
+		if (count[i] > 1)
+			qsort(&tile->borderEdges[tile->borderEdgeBase[i]], count[i], sizeof(dtBorderEdge), compareBorderEdges);
+	}
+
+	return true;
+}
+
+// Returns true if the convex polygon overlaps the rectangle on the xz-plane.
+static bool overlapPolyRect2D(const float* verts, const int nverts, const float* rmin, const float* rmax)
+{
+	float c[3] = { 0, 0, 0 };
+	for (int i = 0; i < nverts; ++i)
+		dtVadd(c, c, &verts[i*3]);
+	dtVscale(c, c, 1.0f / nverts);
+
+	// The rectangle axes are covered by the bounds, test the polygon edges.
+	for (int i = 0, j = nverts-1; i < nverts; j = i++)
+	{
+		const float* va = &verts[j*3];
+		const float* vb = &verts[i*3];
+		const float nx = vb[2] - va[2];
+		const float nz = va[0] - vb[0];
+		const float side = (c[0] - va[0])*nx + (c[2] - va[2])*nz;
+		bool separated = true;
+		for (int k = 0; k < 4 && separated; ++k)
+		{
+			const float x = (k & 1) ? rmax[0] : rmin[0];
+			const float z = (k & 2) ? rmax[1] : rmin[1];
+			const float d = (x - va[0])*nx + (z - va[2])*nz;
+			separated = side > 0 ? d < 0 : d > 0;
+		}
+		if (separated)
+			return false;
+	}
+	return true;
+}
+
+bool dtNavMesh::buildPolyGrid(dtMeshTile* tile)
+{
+	const dtMeshHeader* header = tile->header;
+	const float cs = m_params.polyGridCellSize;
+	const float fw = dtMathCeilf((header->bmax[0] - header->bmin[0]) / cs);
+	const float fh = dtMathCeilf((header->bmax[2] - header->bmin[2]) / cs);
+
+	tile->polyGridCells = 0;
+	tile->polyGridPolys = 0;
+	tile->polyGridWidth = 0;
+	tile->polyGridHeight = 0;
+
+	// Too fine a grid for the tile, its points are found with the BV tree instead.
+	if (fw > DT_POLY_GRID_MAX_SIZE || fh > DT_POLY_GRID_MAX_SIZE)
+		return true;
+
+	const int w = dtMax(1, (int)fw);
+	const int h = dtMax(1, (int)fh);
+	const int ncells = w*h;
+	tile->polyGridWidth = w;
+	tile->polyGridHeight = h;
+
+	unsigned int* counts = (unsigned int*)dtAlloc(sizeof(unsigned int)*(ncells+1), DT_ALLOC_TEMP);
+	if (!counts)
+		return false;
+	memset(counts, 0, sizeof(unsigned int)*(ncells+1));
+
+	// Count the polygons of each cell, then store them.
+	unsigned int* cells = 0;
+	for (int pass = 0; pass < 2; ++pass)
+	{
+		for (int i = 0; i < header->polyCount; ++i)
+		{
+			const dtPoly* poly = &tile->polys[i];
+			if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
 				continue;
-			
-			// Check if the segments touch.
-			calcSlabEndPoints(vc,vd, bmin,bmax, side);
+			float verts[DT_VERTS_PER_POLYGON*3];
+			float bmin[3], bmax[3];
+			for (int j = 0; j < poly->vertCount; ++j)
+			{
+				dtVcopy(&verts[j*3], tile->getVert(poly->verts[j], &verts[j*3]));
+				if (j == 0)
+				{
+					dtVcopy(bmin, &verts[0]);
+					dtVcopy(bmax, &verts[0]);
+				}
+				dtVmin(bmin, &verts[j*3]);
+				dtVmax(bmax, &verts[j*3]);
+			}
+			const int x0 = dtClamp((int)dtMathFloorf((bmin[0] - header->bmin[0]) / cs), 0, w-1);
+			const int x1 = dtClamp((int)dtMathFloorf((bmax[0] - header->bmin[0]) / cs), 0, w-1);
+			const int z0 = dtClamp((int)dtMathFloorf((bmin[2] - header->bmin[2]) / cs), 0, h-1);
+			const int z1 = dtClamp((int)dtMathFloorf((bmax[2] - header->bmin[2]) / cs), 0, h-1);
+			for (int z = z0; z <= z1; ++z)
+			{
+				for (int x = x0; x <= x1; ++x)
+				{
+					// Cells inside the polygon bounds can still miss a slanted polygon.
+					const float rmin[2] = { header->bmin[0] + x*cs, header->bmin[2] + z*cs };
+					const float rmax[2] = { rmin[0] + cs, rmin[1] + cs };
+					if ((x0 != x1 || z0 != z1) && !overlapPolyRect2D(verts, poly->vertCount, rmin, rmax))
+						continue;
+					if (pass == 0)
+						counts[x + z*w]++;
+					else
+						tile->polyGridPolys[counts[x + z*w]++] = (unsigned short)i;
+				}
+			}
+		}
 
-			// 判断两个包围盒是否相交
-			if (!overlapSlabs(amin,amax, bmin,bmax, 0.01f, tile->header->walkableClimb)) continue;
-			
-			// Add return value.
-			if (n < maxcon)
+		if (pass == 0)
+		{
+			unsigned int total = 0;
+			for (int i = 0; i < ncells; ++i)
 			{
-			    // conarea 就是相交部分的二维包围盒
-				conarea[n*2+0] = dtMax(amin[0], bmin[0]);
-				conarea[n*2+1] = dtMin(amax[0], bmax[0]);
-				con[n] = base | (dtPolyRef)i;
-				n++;
+				const unsigned int n = counts[i];
+				counts[i] = total;
+				total += n;
 			}
-			break;
+			counts[ncells] = total;
+
+			unsigned char* mem = (unsigned char*)dtAlloc(sizeof(unsigned int)*(ncells+1) + sizeof(unsigned short)*total, DT_ALLOC_PERM);
+			if (!mem)
+			{
+				dtFree(counts);
+				return false;
+			}
+			cells = (unsigned int*)mem;
+			memcpy(cells, counts, sizeof(unsigned int)*(ncells+1));
+			tile->polyGridCells = cells;
+			tile->polyGridPolys = (unsigned short*)(mem + sizeof(unsigned int)*(ncells+1));
 		}
 	}
-	return n;
+	dtFree(counts);
+
+	return true;
 }
 
 void dtNavMesh::unconnectLinks(dtMeshTile* tile, dtMeshTile* target)
@@ -424,8 +777,9 @@ void dtNavMesh::connectExtLinks(dtMeshTile* tile, dtMeshTile* target, int side)
 				continue;
 			
 			// Create new links
-			const float* va = &tile->verts[poly->verts[j]*3];
-			const float* vb = &tile->verts[poly->verts[(j+1) % nv]*3];
+			float ta[3], tb[3];
+			const float* va = tile->getVert(poly->verts[j], ta);
+			const float* vb = tile->getVert(poly->verts[(j+1) % nv], tb);
 			dtPolyRef nei[4];
 			float neia[4*2];
 			int nnei = findConnectingPolys(va,vb, target, dtOppositeTile(dir), nei,neia,4);
@@ -505,7 +859,7 @@ void dtNavMesh::connectExtOffMeshLinks(dtMeshTile* tile, dtMeshTile* target, int
 		if (dtSqr(nearestPt[0]-p[0])+dtSqr(nearestPt[2]-p[2]) > dtSqr(targetCon->rad))
 			continue;
 		// Make sure the location is on current mesh.
-		float* v = &target->verts[targetPoly->verts[1]*3];
+		float* v = getOffMeshVert(target, targetPoly->verts[1]);
 		dtVcopy(v, nearestPt);
 				
 		// Link off-mesh connection to target poly.
@@ -604,7 +958,7 @@ void dtNavMesh::baseOffMeshLinks(dtMeshTile* tile)
 		if (dtSqr(nearestPt[0]-p[0])+dtSqr(nearestPt[2]-p[2]) > dtSqr(con->rad))
 			continue;
 		// Make sure the location is on current mesh.
-		float* v = &tile->verts[poly->verts[0]*3];
+		float* v = getOffMeshVert(tile, poly->verts[0]);
 		dtVcopy(v, nearestPt);
 
 		// Link off-mesh connection to target poly.
@@ -643,20 +997,46 @@ void dtNavMesh::baseOffMeshLinks(dtMeshTile* tile)
 
 namespace
 {
-	template<bool onlyBoundary>
-	void closestPointOnDetailEdges(const dtMeshTile* tile, const dtPoly* poly, const float* pos, float* closest)
+	// Gets the vertices of a detail triangle, decoding them into tmp if needed.
+	inline void getDetailTriVerts(const dtMeshTile* tile, const dtPoly* poly, const dtPolyDetail* pd,
+								  const unsigned char* t, float* tmp, const float** v)
 	{
-		const unsigned int ip = (unsigned int)(poly - tile->polys);
-		const dtPolyDetail* pd = &tile->detailMeshes[ip];
+		for (int k = 0; k < 3; ++k)
+		{
+			if (t[k] < poly->vertCount)
+				v[k] = tile->getVert(poly->verts[t[k]], &tmp[k*3]);
+			else
+				v[k] = tile->getDetailVert(pd->vertBase + (t[k] - poly->vertCount), &tmp[k*3]);
+		}
+	}
+
+	// Finds the triangles of the grid cell at the location. The location is clamped to the grid.
+	inline const unsigned char* findDetailGridTris(const dtMeshTile* tile, const dtPolyDetailGrid* grid,
+												   const float* pos, int& count)
+	{
+		const float fx = (pos[0] - grid->bmin[0]) * grid->invCellSize[0];
+		const float fz = (pos[2] - grid->bmin[1]) * grid->invCellSize[1];
+		const int x = fx > 0 ? (int)dtMin(fx, (float)(grid->width-1)) : 0;
+		const int z = fz > 0 ? (int)dtMin(fz, (float)(grid->height-1)) : 0;
+		const unsigned short* cells = &tile->detailGridCells[grid->cellBase + x + z*grid->width];
+		count = cells[1] - cells[0];
+		return &tile->detailGridTris[grid->triBase + cells[0]];
+	}
 
+	// Finds the closest point on the edges of the listed detail triangles, or of all of them if the
+	// list is null. Returns the squared distance to the point on the xz-plane.
+	template<bool onlyBoundary>
+	float closestPointOnDetailTris(const dtMeshTile* tile, const dtPoly* poly, const dtPolyDetail* pd,
+								   const unsigned char* list, const int count, const float* pos, float* closest)
+	{
 		float dmin = FLT_MAX;
 		float tmin = 0;
-		const float* pmin = 0;
-		const float* pmax = 0;
+		float pmin[3] = {0, 0, 0};
+		float pmax[3] = {0, 0, 0};
 
-		for (int i = 0; i < pd->triCount; i++)
+		for (int i = 0; i < count; i++)
 		{
-			const unsigned char* tris = &tile->detailTris[(pd->triBase + i) * 4];
+			const unsigned char* tris = &tile->detailTris[(pd->triBase + (list ? list[i] : i)) * 4];
 			const int ANY_BOUNDARY_EDGE =
 				(DT_DETAIL_EDGE_BOUNDARY << 0) |
 				(DT_DETAIL_EDGE_BOUNDARY << 2) |
@@ -664,19 +1044,15 @@ namespace
 			if (onlyBoundary && (tris[3] & ANY_BOUNDARY_EDGE) == 0)
 				continue;
 
+			float tmp[3*3];
 			const float* v[3];
-			for (int j = 0; j < 3; ++j)
-			{
-				if (tris[j] < poly->vertCount)
-					v[j] = &tile->verts[poly->verts[tris[j]] * 3];
-				else
-					v[j] = &tile->detailVerts[(pd->vertBase + (tris[j] - poly->vertCount)) * 3];
-			}
+			getDetailTriVerts(tile, poly, pd, tris, tmp, v);
 
 			for (int k = 0, j = 2; k < 3; j = k++)
 			{
+				// A list may hold only one of the triangles sharing an inner edge, so look at both sides then.
 				if ((dtGetDetailTriEdgeFlags(tris[3], j) & DT_DETAIL_EDGE_BOUNDARY) == 0 &&
-					(onlyBoundary || tris[j] < tris[k]))
+					(onlyBoundary || (!list && tris[j] < tris[k])))
 				{
 					// Only looking at boundary edges and this is internal, or
 					// this is an inner edge that we will see again or have already seen.
@@ -689,13 +1065,60 @@ namespace
 				{
 					dmin = d;
 					tmin = t;
-					pmin = v[j];
-					pmax = v[k];
+					// Copy, the vertices may be decoded into the scratch space.
+					dtVcopy(pmin, v[j]);
+					dtVcopy(pmax, v[k]);
 				}
 			}
 		}
 
 		dtVlerp(closest, pmin, pmax, tmin);
+		return dmin;
+	}
+
+	template<bool onlyBoundary>
+	void closestPointOnDetailEdges(const dtMeshTile* tile, const dtPoly* poly, const float* pos, float* closest)
+	{
+		const unsigned int ip = (unsigned int)(poly - tile->polys);
+		const dtPolyDetail* pd = &tile->detailMeshes[ip];
+
+		if (pd->grid)
+		{
+			// Inside the polygon the nearest edge is on a triangle of the cell of the point. Outside it,
+			// the boundary of the detail mesh follows the polygon edges, so the nearest boundary edge
+			// is on a triangle of the cell of the nearest point on the polygon edges.
+			const dtPolyDetailGrid* grid = &tile->detailGrids[pd->grid-1];
+			float at[3];
+			dtVcopy(at, pos);
+			float dpoly = 0;
+			if (onlyBoundary)
+			{
+				dpoly = FLT_MAX;
+				for (int i = 0, j = poly->vertCount-1; i < poly->vertCount; j = i++)
+				{
+					float tj[3], ti[3];
+					const float* vj = tile->getVert(poly->verts[j], tj);
+					const float* vi = tile->getVert(poly->verts[i], ti);
+					float t;
+					const float d = dtDistancePtSegSqr2D(pos, vj, vi, t);
+					if (d < dpoly)
+					{
+						dpoly = d;
+						dtVlerp(at, vj, vi, t);
+					}
+				}
+			}
+			int count;
+			const unsigned char* list = findDetailGridTris(tile, grid, at, count);
+			const float d = closestPointOnDetailTris<onlyBoundary>(tile, poly, pd, list, count, pos, closest);
+
+			// Fall back to all the triangles if the detail mesh does not match the polygon.
+			const float tol = 0.01f / dtMin(grid->invCellSize[0], grid->invCellSize[1]);
+			if (d <= dtSqr(dtMathSqrtf(dpoly) + tol))
+				return;
+		}
+
+		closestPointOnDetailTris<onlyBoundary>(tile, poly, pd, 0, pd->triCount, pos, closest);
 	}
 }
 
@@ -712,7 +1135,7 @@ bool dtNavMesh::getPolyHeight(const dtMeshTile* tile, const dtPoly* poly, const
 	float verts[DT_VERTS_PER_POLYGON*3];	
 	const int nv = poly->vertCount;
 	for (int i = 0; i < nv; ++i)
-		dtVcopy(&verts[i*3], &tile->verts[poly->verts[i]*3]);
+		dtVcopy(&verts[i*3], tile->getVert(poly->verts[i], &verts[i*3]));
 	
 	if (!dtPointInPolygon(pos, verts, nv))
 		return false;
@@ -720,20 +1143,27 @@ bool dtNavMesh::getPolyHeight(const dtMeshTile* tile, const dtPoly* poly, const
 	if (!height)
 		return true;
 	
-	// Find height at the location.
-	for (int j = 0; j < pd->triCount; ++j)
+	// Find height at the location, testing the triangles of the grid cell if the detail mesh has a grid.
+	int count = pd->triCount;
+	const unsigned char* list = pd->grid ? findDetailGridTris(tile, &tile->detailGrids[pd->grid-1], pos, count) : 0;
+	for (int j = 0; j < count; j += 4)
 	{
-		const unsigned char* t = &tile->detailTris[(pd->triBase+j)*4];
-		const float* v[3];
-		for (int k = 0; k < 3; ++k)
+		// Test four triangles at a time, stored per vertex and axis.
+		float tris[9*4];
+		const int n = dtMin(4, count - j);
+		if (n < 4)
+			memset(tris, 0, sizeof(tris));
+		for (int i = 0; i < n; ++i)
 		{
-			if (t[k] < poly->vertCount)
-				v[k] = &tile->verts[poly->verts[t[k]]*3];
-			else
-				v[k] = &tile->detailVerts[(pd->vertBase+(t[k]-poly->vertCount))*3];
+			const unsigned char* t = &tile->detailTris[(pd->triBase + (list ? list[j+i] : j+i))*4];
+			float tmp[3*3];
+			const float* v[3];
+			getDetailTriVerts(tile, poly, pd, t, tmp, v);
+			for (int k = 0; k < 9; ++k)
+				tris[k*4+i] = v[k/3][k%3];
 		}
 		float h;
-		if (dtClosestHeightPointTriangle(pos, v[0], v[1], v[2], h))
+		if (dtClosestHeightPointTriangle4(pos, tris, h) >= 0)
 		{
 			*height = h;
 			return true;
@@ -752,9 +1182,12 @@ bool dtNavMesh::getPolyHeight(const dtMeshTile* tile, const dtPoly* poly, const
 
 void dtNavMesh::closestPointOnPoly(dtPolyRef ref, const float* pos, float* closest, bool* posOverPoly) const
 {
-	const dtMeshTile* tile = 0;
-	const dtPoly* poly = 0;
-	getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+	// The tile is already in use, and this may run in the parallel tasks of addTiles,
+	// so the tile is not marked used again.
+	unsigned int salt, it, ip;
+	decodePolyId(ref, salt, it, ip);
+	const dtMeshTile* tile = &m_tiles[it];
+	const dtPoly* poly = &tile->polys[ip];
 
 	dtVcopy(closest, pos);
 	if (getPolyHeight(tile, poly, pos, &closest[1]))
@@ -770,8 +1203,9 @@ void dtNavMesh::closestPointOnPoly(dtPolyRef ref, const float* pos, float* close
 	// Off-mesh connections don't have detail polygons.
 	if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
 	{
-		const float* v0 = &tile->verts[poly->verts[0]*3];
-		const float* v1 = &tile->verts[poly->verts[1]*3];
+		float t0[3], t1[3];
+		const float* v0 = tile->getVert(poly->verts[0], t0);
+		const float* v1 = tile->getVert(poly->verts[1], t1);
 		float t;
 		dtDistancePtSegSqr2D(pos, v0, v1, t);
 		dtVlerp(closest, v0, v1, t);
@@ -833,10 +1267,8 @@ dtPolyRef dtNavMesh::findNearestPolyInTile(const dtMeshTile* tile,
 int dtNavMesh::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, const float* qmax,
 								   dtPolyRef* polys, const int maxPolys) const
 {
-	if (tile->bvTree)
+	if (tile->bvTree || tile->bvWideTree)
 	{
-		const dtBVNode* node = &tile->bvTree[0];
-		const dtBVNode* end = &tile->bvTree[tile->header->bvNodeCount];
 		const float* tbmin = tile->header->bmin;
 		const float* tbmax = tile->header->bmax;
 		const float qfac = tile->header->bvQuantFactor;
@@ -858,9 +1290,43 @@ int dtNavMesh::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, co
 		bmax[1] = (unsigned short)(qfac * maxy + 1) | 1;
 		bmax[2] = (unsigned short)(qfac * maxz + 1) | 1;
 		
-		// Traverse tree
 		dtPolyRef base = getPolyRefBase(tile);
 		int n = 0;
+		
+		if (tile->bvWideTree)
+		{
+			// Traverse the wide tree, testing the children of a node together.
+			int stack[DT_BVWIDE_STACK_SIZE];
+			int nstack = 0;
+			stack[nstack++] = 0;
+			while (nstack > 0)
+			{
+				const dtBVWideNode* node = &tile->bvWideTree[stack[--nstack]];
+				const int mask = dtOverlapQuantBounds4(bmin, bmax, node->bmin[0], node->bmax[0]);
+				// Push in reverse, so that the subtrees are visited in order.
+				for (int i = DT_BVWIDE_WIDTH-1; i >= 0; --i)
+				{
+					if (!(mask & (1 << i)))
+						continue;
+					const int child = node->child[i];
+					if (child < 0)
+					{
+						if (n < maxPolys)
+							polys[n++] = base | (dtPolyRef)~child;
+					}
+					else if (child > 0 && nstack < DT_BVWIDE_STACK_SIZE)
+					{
+						stack[nstack++] = child;
+					}
+				}
+			}
+			
+			return n;
+		}
+		
+		// Traverse tree
+		const dtBVNode* node = &tile->bvTree[0];
+		const dtBVNode* end = &tile->bvTree[tile->header->bvNodeCount];
 		while (node < end)
 		{
 			const bool overlap = dtOverlapQuantBounds(bmin, bmax, node->bmin, node->bmax);
@@ -895,12 +1361,13 @@ int dtNavMesh::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, co
 			if (p->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
 				continue;
 			// Calc polygon bounds.
-			const float* v = &tile->verts[p->verts[0]*3];
+			float tmp[3];
+			const float* v = tile->getVert(p->verts[0], tmp);
 			dtVcopy(bmin, v);
 			dtVcopy(bmax, v);
 			for (int j = 1; j < p->vertCount; ++j)
 			{
-				v = &tile->verts[p->verts[j]*3];
+				v = tile->getVert(p->verts[j], tmp);
 				dtVmin(bmin, v);
 				dtVmax(bmax, v);
 			}
@@ -933,33 +1400,145 @@ int dtNavMesh::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, co
 dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 							dtTileRef lastRef, dtTileRef* result)
 {
-	// Make sure the data is in right format.
-	dtMeshHeader* header = (dtMeshHeader*)data;
-	if (header->magic != DT_NAVMESH_MAGIC)
-		return DT_FAILURE | DT_WRONG_MAGIC;
-	if (header->version != DT_NAVMESH_VERSION)
-		return DT_FAILURE | DT_WRONG_VERSION;
+	// The neighbours are linked to the new tile, so they cannot stay compressed or shared.
+	if (!prepareTilesAround(((const dtMeshHeader*)data)->x, ((const dtMeshHeader*)data)->y))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 
-#ifndef DT_POLYREF64
-	// Do not allow adding more polygons than specified in the NavMesh's maxPolys constraint.
-	// Otherwise, the poly ID cannot be represented with the given number of bits.
-	if (m_polyBits < dtIlog2(dtNextPow2((unsigned int)header->polyCount)))
-		return DT_FAILURE | DT_INVALID_PARAM;
-#endif
-		
-	// Make sure the location is free.
-	if (getTileAt(header->x, header->y, header->layer))
-		return DT_FAILURE | DT_ALREADY_OCCUPIED;
-		
-	// Allocate a tile.
 	dtMeshTile* tile = 0;
-	if (!lastRef)
+	dtStatus status = insertTile(data, dataSize, flags, lastRef, &tile);
+	if (dtStatusFailed(status))
+		return status;
+
+	const dtMeshHeader* header = tile->header;
+
+	connectIntLinks(tile);
+
+	// Base off-mesh connections to their starting polygons and connect connections inside the tile.
+	baseOffMeshLinks(tile);
+	connectExtOffMeshLinks(tile, tile, -1);
+
+	// Create connections with neighbour tiles.
+	static const int MAX_NEIS = 32;
+	dtMeshTile* neis[MAX_NEIS];
+	int nneis;
+	
+	// Connect with layers in current tile.
+	nneis = getTilesAt(header->x, header->y, neis, MAX_NEIS);
+	for (int j = 0; j < nneis; ++j)
 	{
-		if (m_nextFree)
+		if (neis[j] == tile)
+			continue;
+	
+		connectExtLinks(tile, neis[j], -1);
+		connectExtLinks(neis[j], tile, -1);
+		connectExtOffMeshLinks(tile, neis[j], -1);
+		connectExtOffMeshLinks(neis[j], tile, -1);
+	}
+	
+	// Connect with neighbour tiles.
+	for (int i = 0; i < 8; ++i)
+	{
+		nneis = getNeighbourTilesAt(header->x, header->y, i, neis, MAX_NEIS);
+		for (int j = 0; j < nneis; ++j)
 		{
-			tile = m_nextFree;
-			m_nextFree = tile->next;
-			tile->next = 0;
+			connectExtLinks(tile, neis[j], i);
+			connectExtLinks(neis[j], tile, dtOppositeTile(i));
+			connectExtOffMeshLinks(tile, neis[j], i);
+			connectExtOffMeshLinks(neis[j], tile, dtOppositeTile(i));
+		}
+	}
+	
+	if (result)
+		*result = getTileRef(tile);
+	
+	return DT_SUCCESS;
+}
+
+/// Points the tile at the parts of its data.
+static void setTilePointers(dtMeshTile* tile, unsigned char* data)
+{
+	const dtMeshHeader* header = (const dtMeshHeader*)data;
+
+	// Quantized tiles store the mesh vertices as shorts, followed by the off-mesh link vertices as floats.
+	const bool quantized = header->vertFormat == DT_VERTFORMAT_QUANTIZED;
+	const int quantVertCount = quantized ? header->vertCount - header->offMeshConCount*2 : 0;
+	const int offMeshVertsOffset = dtAlign4(sizeof(unsigned short)*3*quantVertCount);
+	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
+	const int vertsSize = dtAlign4(offMeshVertsOffset + sizeof(float)*3*(header->vertCount - quantVertCount));
+	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
+	const int linksSize = dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
+	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
+	const int detailVertsSize = dtAlign4((quantized ? sizeof(unsigned short) : sizeof(float))*3*header->detailVertCount);
+	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
+	const bool wideBvTree = header->bvFormat == DT_BVFORMAT_WIDE;
+	const int bvtreeSize = dtAlign4((wideBvTree ? sizeof(dtBVWideNode) : sizeof(dtBVNode))*header->bvNodeCount);
+	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
+	const int detailGridsSize = dtAlign4(sizeof(dtPolyDetailGrid)*header->detailGridCount);
+	const int detailGridCellsSize = dtAlign4(sizeof(unsigned short)*header->detailGridCellCount);
+	const int detailGridTrisSize = dtAlign4(sizeof(unsigned char)*header->detailGridTriCount);
+	
+	unsigned char* d = data + headerSize;
+	unsigned char* vertsData = dtGetThenAdvanceBufferPointer<unsigned char>(d, vertsSize);
+	tile->polys = dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize);
+	tile->links = dtGetThenAdvanceBufferPointer<dtLink>(d, linksSize);
+	tile->detailMeshes = dtGetThenAdvanceBufferPointer<dtPolyDetail>(d, detailMeshesSize);
+	unsigned char* detailVertsData = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailVertsSize);
+	tile->detailTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
+	unsigned char* bvTreeData = dtGetThenAdvanceBufferPointer<unsigned char>(d, bvtreeSize);
+	tile->offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshLinksSize);
+	tile->detailGrids = dtGetThenAdvanceBufferPointer<dtPolyDetailGrid>(d, detailGridsSize);
+	tile->detailGridCells = dtGetThenAdvanceBufferPointer<unsigned short>(d, detailGridCellsSize);
+	tile->detailGridTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailGridTrisSize);
+
+	// If there are no items in the bvtree, reset the tree pointers.
+	tile->bvTree = bvtreeSize && !wideBvTree ? (dtBVNode*)bvTreeData : 0;
+	tile->bvWideTree = bvtreeSize && wideBvTree ? (dtBVWideNode*)bvTreeData : 0;
+
+	tile->verts = (float*)(vertsData + offMeshVertsOffset);
+	tile->quantVerts = quantized ? (unsigned short*)vertsData : 0;
+	tile->detailVerts = quantized ? 0 : (float*)detailVertsData;
+	tile->quantDetailVerts = quantized ? (unsigned short*)detailVertsData : 0;
+
+	tile->header = (dtMeshHeader*)data;
+	tile->data = data;
+}
+
+dtStatus dtNavMesh::insertTile(unsigned char* data, int dataSize, int flags,
+							   dtTileRef lastRef, dtMeshTile** result)
+{
+	// Make sure the data is in right format.
+	dtMeshHeader* header = (dtMeshHeader*)data;
+	if (header->magic != DT_NAVMESH_MAGIC)
+		return DT_FAILURE | DT_WRONG_MAGIC;
+	if (header->version != DT_NAVMESH_VERSION)
+		return DT_FAILURE | DT_WRONG_VERSION;
+	if (header->vertFormat != DT_VERTFORMAT_FLOAT && header->vertFormat != DT_VERTFORMAT_QUANTIZED)
+		return DT_FAILURE | DT_WRONG_VERSION;
+	if (header->bvFormat != DT_BVFORMAT_BINARY && header->bvFormat != DT_BVFORMAT_WIDE)
+		return DT_FAILURE | DT_WRONG_VERSION;
+	if (flags & DT_TILE_SHARED_DATA)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+#ifndef DT_POLYREF64
+	// Do not allow adding more polygons than specified in the NavMesh's maxPolys constraint.
+	// Otherwise, the poly ID cannot be represented with the given number of bits.
+	if (m_polyBits < dtIlog2(dtNextPow2((unsigned int)header->polyCount)))
+		return DT_FAILURE | DT_INVALID_PARAM;
+#endif
+		
+	// Make sure the location is free.
+	if (findTileAt(header->x, header->y, header->layer))
+		return DT_FAILURE | DT_ALREADY_OCCUPIED;
+		
+	// Allocate a tile.
+	dtMeshTile* tile = 0;
+	if (!lastRef)
+	{
+		if (m_nextFree)
+		{
+			tile = m_nextFree;
+			m_nextFree = tile->next;
+			tile->next = 0;
 		}
 	}
 	else
@@ -994,35 +1573,8 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 	if (!tile)
 		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
-	// Insert tile into the position lut.
-	int h = computeTileHash(header->x, header->y, m_tileLutMask);
-	tile->next = m_posLookup[h];
-	m_posLookup[h] = tile;
-	
 	// Patch header pointers.
-	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
-	const int vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
-	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
-	const int linksSize = dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
-	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
-	const int detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
-	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
-	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
-	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
-	
-	unsigned char* d = data + headerSize;
-	tile->verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
-	tile->polys = dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize);
-	tile->links = dtGetThenAdvanceBufferPointer<dtLink>(d, linksSize);
-	tile->detailMeshes = dtGetThenAdvanceBufferPointer<dtPolyDetail>(d, detailMeshesSize);
-	tile->detailVerts = dtGetThenAdvanceBufferPointer<float>(d, detailVertsSize);
-	tile->detailTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
-	tile->bvTree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvtreeSize);
-	tile->offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshLinksSize);
-
-	// If there are no items in the bvtree, reset the tree pointer.
-	if (!bvtreeSize)
-		tile->bvTree = 0;
+	setTilePointers(tile, data);
 
 	// Build links freelist
 	tile->linksFreeList = 0;
@@ -1031,56 +1583,315 @@ dtStatus dtNavMesh::addTile(unsigned char* data, int dataSize, int flags,
 		tile->links[i].next = i+1;
 
 	// Init tile.
-	tile->header = header;
-	tile->data = data;
 	tile->dataSize = dataSize;
+	tile->lastUsed = m_tileUseCount;
 	tile->flags = flags;
 
-	connectIntLinks(tile);
+	// Index the portal edges, so that the neighbour tiles can be connected quickly.
+	tile->polyGridCells = 0;
+	if (!buildBorderEdges(tile) || (m_params.polyGridCellSize > 0 && !buildPolyGrid(tile)))
+	{
+		dtFree(tile->borderEdges);
+		tile->borderEdges = 0;
+		// Return the tile to the free list, the data still belongs to the caller.
+		tile->header = 0;
+		tile->data = 0;
+		tile->dataSize = 0;
+		tile->flags = 0;
+		tile->next = m_nextFree;
+		m_nextFree = tile;
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
 
-	// Base off-mesh connections to their starting polygons and connect connections inside the tile.
-	baseOffMeshLinks(tile);
-	connectExtOffMeshLinks(tile, tile, -1);
+	// Insert tile into the position lut.
+	addTileToLookup(tile);
+	m_tileGeneration++;
 
-	// Create connections with neighbour tiles.
+	*result = tile;
+
+	return DT_SUCCESS;
+}
+
+void dtNavMesh::addTileToLookup(dtMeshTile* tile)
+{
+	const dtMeshHeader* header = tile->header;
+	dtMeshTile** cell = getGridCell(header->x, header->y);
+	if (cell && header->layer >= 0 && header->layer < m_gridLayers)
+	{
+		tile->next = 0;
+		cell[header->layer] = tile;
+	}
+	else
+	{
+		if (cell)
+			m_gridOverflow++;
+		int h = computeTileHash(header->x, header->y, m_tileLutMask);
+		tile->next = m_posLookup[h];
+		m_posLookup[h] = tile;
+	}
+}
+
+namespace
+{
+	/// A border shared by the tiles of two neighbouring cells, or by the layers of one cell (side -1).
+	/// Stored from the cell on the negative side, so that each border is visited once.
+	struct dtTileBorder
+	{
+		int x, y;
+		int side;
+		int pass;
+	};
+
+	/// The layers of a cell are connected in the first pass, and each of the sides 0-3 in two
+	/// more, split by the parity of the coordinate along which the side steps.
+	static const int DT_TILE_BORDER_PASSES = 9;
+
+	/// The scratch data shared by the work items of dtNavMesh::addTiles.
+	struct dtAddTilesBatch
+	{
+		dtNavMesh* mesh;
+		dtMeshTile** tiles;				///< The new tiles.
+		const unsigned char* isNew;		///< Non-zero for the new tiles, by tile index.
+		const dtTileBorder* borders;	///< The borders of the current pass.
+	};
+
+	void addTileBorder(dtTileBorder* borders, int& nborders, int* passCounts, const int x, const int y, const int side)
+	{
+		dtTileBorder& border = borders[nborders++];
+		border.x = x;
+		border.y = y;
+		border.side = side;
+		// Borders of the same pass never share a cell, so they can be connected at the same time.
+		if (side == -1)
+			border.pass = 0;
+		else if (side == 2)
+			border.pass = 1 + side*2 + (y & 1);
+		else
+			border.pass = 1 + side*2 + (x & 1);
+		passCounts[border.pass]++;
+	}
+}
+
+/// @par
+///
+/// All the tiles are first added to the tile lookup, then the links inside each new tile
+/// are built, and finally each border between two cells with a new tile is connected in a
+/// single pass, in both directions. Borders that do not share a tile are connected at the
+/// same time through @p runner, so with a thread-safe job system the link building scales
+/// with the number of tiles. The resulting links are the same as when adding the tiles one
+/// by one with #addTile.
+///
+/// If any of the tiles cannot be added, none of them is, and the data stays owned by the caller.
+///
+/// @see addTile, dtTaskRunner
+dtStatus dtNavMesh::addTiles(unsigned char** data, const int* dataSizes, const int count, int flags,
+							 dtTileRef* results, dtTaskRunner* runner)
+{
+	if (count <= 0)
+		return DT_SUCCESS;
+	if (!data || !dataSizes)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	dtTaskRunner serialRunner;
+	if (!runner)
+		runner = &serialRunner;
+
+	// The neighbours are linked to the new tiles, so they cannot stay compressed or shared.
+	for (int i = 0; i < count; ++i)
+	{
+		const dtMeshHeader* header = (const dtMeshHeader*)data[i];
+		if (!prepareTilesAround(header->x, header->y))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	dtMeshTile** tiles = (dtMeshTile**)dtAlloc(sizeof(dtMeshTile*)*count, DT_ALLOC_TEMP);
+	unsigned char* isNew = (unsigned char*)dtAlloc(sizeof(unsigned char)*m_maxTiles, DT_ALLOC_TEMP);
+	dtTileBorder* borders = (dtTileBorder*)dtAlloc(sizeof(dtTileBorder)*count*9*2, DT_ALLOC_TEMP);
+	if (!tiles || !isNew || !borders)
+	{
+		dtFree(tiles);
+		dtFree(isNew);
+		dtFree(borders);
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memset(isNew, 0, sizeof(unsigned char)*m_maxTiles);
+
+	// Claim all the tiles first, so that the neighbours are known when connecting.
+	for (int i = 0; i < count; ++i)
+	{
+		dtStatus status = insertTile(data[i], dataSizes[i], flags, 0, &tiles[i]);
+		if (dtStatusFailed(status))
+		{
+			// Take the tiles out again, without freeing the data.
+			for (int j = i-1; j >= 0; --j)
+			{
+				tiles[j]->flags = 0;
+				removeTile(getTileRef(tiles[j]), 0, 0);
+			}
+			dtFree(tiles);
+			dtFree(isNew);
+			dtFree(borders);
+			return status;
+		}
+		isNew[tiles[i] - m_tiles] = 1;
+	}
+
+	dtAddTilesBatch batch;
+	batch.mesh = this;
+	batch.tiles = tiles;
+	batch.isNew = isNew;
+	batch.borders = borders;
+
+	// Links inside the tiles only touch the tile itself.
+	runner->parallelFor(count, connectTilesTask, &batch);
+
+	// Collect the borders of the new cells, each of them once. The border on side 4-7 of a cell
+	// is the border on side 0-3 of the neighbour cell, so only sides 0-3 are used, and the borders
+	// towards the neighbours on sides 4-7 are stored from the neighbour unless it is new too.
+	static const int offset[4*2] = { 1,0, 1,1, 0,1, -1,1 };
 	static const int MAX_NEIS = 32;
 	dtMeshTile* neis[MAX_NEIS];
-	int nneis;
-	
-	// Connect with layers in current tile.
-	nneis = getTilesAt(header->x, header->y, neis, MAX_NEIS);
-	for (int j = 0; j < nneis; ++j)
+	int passCounts[DT_TILE_BORDER_PASSES];
+	memset(passCounts, 0, sizeof(passCounts));
+	int nborders = 0;
+	for (int i = 0; i < count; ++i)
 	{
-		if (neis[j] == tile)
+		const int x = tiles[i]->header->x;
+		const int y = tiles[i]->header->y;
+		// Visit each cell once, from its first new layer.
+		const int nneis = getTilesAt(x, y, neis, MAX_NEIS);
+		int first = 0;
+		while (first < nneis && !isNew[neis[first] - m_tiles])
+			first++;
+		if (first < nneis && neis[first] != tiles[i])
 			continue;
-	
-		connectExtLinks(tile, neis[j], -1);
-		connectExtLinks(neis[j], tile, -1);
-		connectExtOffMeshLinks(tile, neis[j], -1);
-		connectExtOffMeshLinks(neis[j], tile, -1);
+
+		addTileBorder(borders, nborders, passCounts, x, y, -1);
+		for (int side = 0; side < 4; ++side)
+		{
+			addTileBorder(borders, nborders, passCounts, x, y, side);
+
+			const int nx = x - offset[side*2+0];
+			const int ny = y - offset[side*2+1];
+			const int nprev = getTilesAt(nx, ny, neis, MAX_NEIS);
+			bool prevIsNew = false;
+			for (int j = 0; j < nprev && !prevIsNew; ++j)
+				prevIsNew = isNew[neis[j] - m_tiles] != 0;
+			if (!prevIsNew && nprev > 0)
+				addTileBorder(borders, nborders, passCounts, nx, ny, side);
+		}
 	}
-	
-	// Connect with neighbour tiles.
-	for (int i = 0; i < 8; ++i)
+
+	// Group the borders by pass.
+	int passStart[DT_TILE_BORDER_PASSES+1];
+	passStart[0] = 0;
+	for (int i = 0; i < DT_TILE_BORDER_PASSES; ++i)
+		passStart[i+1] = passStart[i] + passCounts[i];
+	dtTileBorder* sorted = borders + count*9;
+	int next[DT_TILE_BORDER_PASSES];
+	memcpy(next, passStart, sizeof(next));
+	for (int i = 0; i < nborders; ++i)
+		sorted[next[borders[i].pass]++] = borders[i];
+
+	for (int i = 0; i < DT_TILE_BORDER_PASSES; ++i)
 	{
-		nneis = getNeighbourTilesAt(header->x, header->y, i, neis, MAX_NEIS);
-		for (int j = 0; j < nneis; ++j)
+		if (!passCounts[i])
+			continue;
+		batch.borders = &sorted[passStart[i]];
+		runner->parallelFor(passCounts[i], connectBordersTask, &batch);
+	}
+
+	if (results)
+	{
+		for (int i = 0; i < count; ++i)
+			results[i] = getTileRef(tiles[i]);
+	}
+
+	dtFree(tiles);
+	dtFree(isNew);
+	dtFree(borders);
+
+	return DT_SUCCESS;
+}
+
+void dtNavMesh::connectTilesTask(void* userData, const int begin, const int end)
+{
+	dtAddTilesBatch* batch = (dtAddTilesBatch*)userData;
+	dtNavMesh* mesh = batch->mesh;
+	for (int i = begin; i < end; ++i)
+	{
+		dtMeshTile* tile = batch->tiles[i];
+		mesh->connectIntLinks(tile);
+		// Base off-mesh connections to their starting polygons and connect connections inside the tile.
+		mesh->baseOffMeshLinks(tile);
+		mesh->connectExtOffMeshLinks(tile, tile, -1);
+	}
+}
+
+void dtNavMesh::connectBordersTask(void* userData, const int begin, const int end)
+{
+	dtAddTilesBatch* batch = (dtAddTilesBatch*)userData;
+	dtNavMesh* mesh = batch->mesh;
+
+	static const int MAX_NEIS = 32;
+	dtMeshTile* tiles[MAX_NEIS];
+	dtMeshTile* neis[MAX_NEIS];
+
+	for (int i = begin; i < end; ++i)
+	{
+		const dtTileBorder& border = batch->borders[i];
+		const int ntiles = mesh->getTilesAt(border.x, border.y, tiles, MAX_NEIS);
+
+		if (border.side == -1)
 		{
-			connectExtLinks(tile, neis[j], i);
-			connectExtLinks(neis[j], tile, dtOppositeTile(i));
-			connectExtOffMeshLinks(tile, neis[j], i);
-			connectExtOffMeshLinks(neis[j], tile, dtOppositeTile(i));
+			// Connect with layers in current tile.
+			for (int j = 0; j < ntiles; ++j)
+			{
+				for (int k = j+1; k < ntiles; ++k)
+				{
+					if (!batch->isNew[tiles[j] - mesh->m_tiles] && !batch->isNew[tiles[k] - mesh->m_tiles])
+						continue;
+					mesh->connectExtLinks(tiles[j], tiles[k], -1);
+					mesh->connectExtLinks(tiles[k], tiles[j], -1);
+					mesh->connectExtOffMeshLinks(tiles[j], tiles[k], -1);
+					mesh->connectExtOffMeshLinks(tiles[k], tiles[j], -1);
+				}
+			}
+			continue;
+		}
+
+		// Connect with neighbour tiles.
+		const int nneis = mesh->getNeighbourTilesAt(border.x, border.y, border.side, neis, MAX_NEIS);
+		const int opposite = dtOppositeTile(border.side);
+		for (int j = 0; j < ntiles; ++j)
+		{
+			for (int k = 0; k < nneis; ++k)
+			{
+				if (!batch->isNew[tiles[j] - mesh->m_tiles] && !batch->isNew[neis[k] - mesh->m_tiles])
+					continue;
+				mesh->connectExtLinks(tiles[j], neis[k], border.side);
+				mesh->connectExtLinks(neis[k], tiles[j], opposite);
+				mesh->connectExtOffMeshLinks(tiles[j], neis[k], border.side);
+				mesh->connectExtOffMeshLinks(neis[k], tiles[j], opposite);
+			}
 		}
 	}
-	
-	if (result)
-		*result = getTileRef(tile);
-	
-	return DT_SUCCESS;
 }
 
-const dtMeshTile* dtNavMesh::getTileAt(const int x, const int y, const int layer) const
+dtMeshTile** dtNavMesh::getGridCell(const int x, const int y) const
 {
+	if (!m_tileGrid || x < 0 || y < 0 || x >= m_gridWidth || y >= m_gridHeight)
+		return 0;
+	return &m_tileGrid[(x + y*m_gridWidth)*m_gridLayers];
+}
+
+dtMeshTile* dtNavMesh::findTileAt(const int x, const int y, const int layer) const
+{
+	// Find tile in the dense grid.
+	dtMeshTile** cell = getGridCell(x, y);
+	if (cell && layer >= 0 && layer < m_gridLayers)
+		return cell[layer];
+
 	// Find tile based on hash.
 	int h = computeTileHash(x,y,m_tileLutMask);
 	dtMeshTile* tile = m_posLookup[h];
@@ -1098,6 +1909,14 @@ const dtMeshTile* dtNavMesh::getTileAt(const int x, const int y, const int layer
 	return 0;
 }
 
+const dtMeshTile* dtNavMesh::getTileAt(const int x, const int y, const int layer) const
+{
+	dtMeshTile* tile = findTileAt(x, y, layer);
+	if (tile && !useTile(tile))
+		return 0;
+	return tile;
+}
+
 int dtNavMesh::getNeighbourTilesAt(const int x, const int y, const int side, dtMeshTile** tiles, const int maxTiles) const
 {
 	int nx = x, ny = y;
@@ -1120,6 +1939,20 @@ int dtNavMesh::getTilesAt(const int x, const int y, dtMeshTile** tiles, const in
 {
 	int n = 0;
 	
+	// Find tiles in the dense grid.
+	dtMeshTile** cell = getGridCell(x, y);
+	if (cell)
+	{
+		for (int i = 0; i < m_gridLayers; ++i)
+		{
+			if (cell[i] && n < maxTiles)
+				tiles[n++] = cell[i];
+		}
+		// Only tiles on higher layers are in the hash.
+		if (!m_gridOverflow)
+			return n;
+	}
+	
 	// Find tile based on hash.
 	int h = computeTileHash(x,y,m_tileLutMask);
 	dtMeshTile* tile = m_posLookup[h];
@@ -1146,6 +1979,20 @@ int dtNavMesh::getTilesAt(const int x, const int y, dtMeshTile const** tiles, co
 {
 	int n = 0;
 	
+	// Find tiles in the dense grid.
+	dtMeshTile** cell = getGridCell(x, y);
+	if (cell)
+	{
+		for (int i = 0; i < m_gridLayers; ++i)
+		{
+			if (cell[i] && n < maxTiles && useTile(cell[i]))
+				tiles[n++] = cell[i];
+		}
+		// Only tiles on higher layers are in the hash.
+		if (!m_gridOverflow)
+			return n;
+	}
+	
 	// Find tile based on hash.
 	int h = computeTileHash(x,y,m_tileLutMask);
 	dtMeshTile* tile = m_posLookup[h];
@@ -1155,7 +2002,7 @@ int dtNavMesh::getTilesAt(const int x, const int y, dtMeshTile const** tiles, co
 			tile->header->x == x &&
 			tile->header->y == y)
 		{
-			if (n < maxTiles)
+			if (n < maxTiles && useTile(tile))
 				tiles[n++] = tile;
 		}
 		tile = tile->next;
@@ -1167,21 +2014,10 @@ int dtNavMesh::getTilesAt(const int x, const int y, dtMeshTile const** tiles, co
 
 dtTileRef dtNavMesh::getTileRefAt(const int x, const int y, const int layer) const
 {
-	// Find tile based on hash.
-	int h = computeTileHash(x,y,m_tileLutMask);
-	dtMeshTile* tile = m_posLookup[h];
-	while (tile)
-	{
-		if (tile->header &&
-			tile->header->x == x &&
-			tile->header->y == y &&
-			tile->header->layer == layer)
-		{
-			return getTileRef(tile);
-		}
-		tile = tile->next;
-	}
-	return 0;
+	const dtMeshTile* tile = getTileAt(x, y, layer);
+	if (!tile)
+		return 0;
+	return getTileRef(tile);
 }
 
 const dtMeshTile* dtNavMesh::getTileByRef(dtTileRef ref) const
@@ -1195,6 +2031,8 @@ const dtMeshTile* dtNavMesh::getTileByRef(dtTileRef ref) const
 	const dtMeshTile* tile = &m_tiles[tileIndex];
 	if (tile->salt != tileSalt)
 		return 0;
+	if (tile->header && !useTile(tile))
+		return 0;
 	return tile;
 }
 
@@ -1210,6 +2048,9 @@ dtMeshTile* dtNavMesh::getTile(int i)
 
 const dtMeshTile* dtNavMesh::getTile(int i) const
 {
+	// A tile that cannot be decompressed is seen as compressed, with only the header.
+	if (m_tiles[i].header)
+		useTile(&m_tiles[i]);
 	return &m_tiles[i];
 }
 
@@ -1227,6 +2068,7 @@ dtStatus dtNavMesh::getTileAndPolyByRef(const dtPolyRef ref, const dtMeshTile**
 	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
 	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
 	if (ip >= (unsigned int)m_tiles[it].header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
+	if (!useTile(&m_tiles[it])) return DT_FAILURE | DT_OUT_OF_MEMORY;
 	*tile = &m_tiles[it];
 	*poly = &m_tiles[it].polys[ip];
 	return DT_SUCCESS;
@@ -1237,12 +2079,16 @@ dtStatus dtNavMesh::getTileAndPolyByRef(const dtPolyRef ref, const dtMeshTile**
 /// @warning Only use this function if it is known that the provided polygon
 /// reference is valid. This function is faster than #getTileAndPolyByRef, but
 /// it does not validate the reference.
-void dtNavMesh::getTileAndPolyByRefUnsafe(const dtPolyRef ref, const dtMeshTile** tile, const dtPoly** poly) const
+///
+/// It only fails when tile compression is enabled and the tile cannot be decompressed.
+dtStatus dtNavMesh::getTileAndPolyByRefUnsafe(const dtPolyRef ref, const dtMeshTile** tile, const dtPoly** poly) const
 {
 	unsigned int salt, it, ip;
 	decodePolyId(ref, salt, it, ip);
+	if (!useTile(&m_tiles[it])) return DT_FAILURE | DT_OUT_OF_MEMORY;
 	*tile = &m_tiles[it];
 	*poly = &m_tiles[it].polys[ip];
+	return DT_SUCCESS;
 }
 
 bool dtNavMesh::isValidPolyRef(dtPolyRef ref) const
@@ -1253,7 +2099,8 @@ bool dtNavMesh::isValidPolyRef(dtPolyRef ref) const
 	if (it >= (unsigned int)m_maxTiles) return false;
 	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return false;
 	if (ip >= (unsigned int)m_tiles[it].header->polyCount) return false;
-	return true;
+	// The references are validated before they are used, so make sure the tile can be used.
+	return useTile(&m_tiles[it]);
 }
 
 /// @par
@@ -1273,23 +2120,37 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	dtMeshTile* tile = &m_tiles[tileIndex];
 	if (tile->salt != tileSalt)
 		return DT_FAILURE | DT_INVALID_PARAM;
+
+	// The links of the neighbours to the tile are removed, so they cannot stay compressed or shared.
+	if (!prepareTilesAround(tile->header->x, tile->header->y, tile))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
-	// Remove tile from hash lookup.
-	int h = computeTileHash(tile->header->x,tile->header->y,m_tileLutMask);
-	dtMeshTile* prev = 0;
-	dtMeshTile* cur = m_posLookup[h];
-	while (cur)
+	// Remove tile from the dense grid, or from hash lookup.
+	dtMeshTile** cell = getGridCell(tile->header->x, tile->header->y);
+	if (cell && tile->header->layer >= 0 && tile->header->layer < m_gridLayers)
+	{
+		cell[tile->header->layer] = 0;
+	}
+	else
 	{
-		if (cur == tile)
+		if (cell)
+			m_gridOverflow--;
+		int h = computeTileHash(tile->header->x,tile->header->y,m_tileLutMask);
+		dtMeshTile* prev = 0;
+		dtMeshTile* cur = m_posLookup[h];
+		while (cur)
 		{
-			if (prev)
-				prev->next = cur->next;
-			else
-				m_posLookup[h] = cur->next;
-			break;
+			if (cur == tile)
+			{
+				if (prev)
+					prev->next = cur->next;
+				else
+					m_posLookup[h] = cur->next;
+				break;
+			}
+			prev = cur;
+			cur = cur->next;
 		}
-		prev = cur;
-		cur = cur->next;
 	}
 	
 	// Remove connections to neighbour tiles.
@@ -1314,7 +2175,17 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	}
 		
 	// Reset tile.
-	if (tile->flags & DT_TILE_FREE_DATA)
+	if (tile->compressedData)
+	{
+		// Only tiles that own their data are compressed.
+		dtFree(tile->compressedData);
+		tile->compressedData = 0;
+		tile->compressedSize = 0;
+		tile->dataSize = 0;
+		if (data) *data = 0;
+		if (dataSize) *dataSize = 0;
+	}
+	else if (tile->flags & DT_TILE_FREE_DATA)
 	{
 		// Owns data
 		dtFree(tile->data);
@@ -1323,12 +2194,32 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 		if (data) *data = 0;
 		if (dataSize) *dataSize = 0;
 	}
+	else if (tile->flags & DT_TILE_SHARED_DATA)
+	{
+		// The data belongs to the base mesh.
+		tile->data = 0;
+		tile->dataSize = 0;
+		if (data) *data = 0;
+		if (dataSize) *dataSize = 0;
+	}
 	else
 	{
 		if (data) *data = tile->data;
 		if (dataSize) *dataSize = tile->dataSize;
 	}
 
+	// Shared tiles use the border edges and polygon grid of the base mesh.
+	if (!(tile->flags & DT_TILE_SHARED_DATA))
+	{
+		dtFree(tile->borderEdges);
+		dtFree(tile->polyGridCells);
+	}
+	tile->borderEdges = 0;
+	tile->polyGridCells = 0;
+	tile->polyGridPolys = 0;
+	dtFree(tile->overlay);
+	tile->overlay = 0;
+
 	tile->header = 0;
 	tile->flags = 0;
 	tile->linksFreeList = 0;
@@ -1337,9 +2228,15 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	tile->links = 0;
 	tile->detailMeshes = 0;
 	tile->detailVerts = 0;
+	tile->quantVerts = 0;
+	tile->quantDetailVerts = 0;
 	tile->detailTris = 0;
 	tile->bvTree = 0;
+	tile->bvWideTree = 0;
 	tile->offMeshCons = 0;
+	tile->detailGrids = 0;
+	tile->detailGridCells = 0;
+	tile->detailGridTris = 0;
 
 	// Update salt, salt should never be zero.
 #ifdef DT_POLYREF64
@@ -1354,6 +2251,8 @@ dtStatus dtNavMesh::removeTile(dtTileRef ref, unsigned char** data, int* dataSiz
 	tile->next = m_nextFree;
 	m_nextFree = tile;
 
+	m_tileGeneration++;
+
 	return DT_SUCCESS;
 }
 
@@ -1461,6 +2360,8 @@ dtStatus dtNavMesh::restoreTileState(dtMeshTile* tile, const unsigned char* data
 		return DT_FAILURE | DT_WRONG_VERSION;
 	if (tileState->ref != getTileRef(tile))
 		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!unshareTile(tile))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	
 	// Restore per poly state.
 	for (int i = 0; i < tile->header->polyCount; ++i)
@@ -1492,6 +2393,7 @@ dtStatus dtNavMesh::getOffMeshConnectionPolyEndPoints(dtPolyRef prevRef, dtPolyR
 	decodePolyId(polyRef, salt, it, ip);
 	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
 	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
+	if (!useTile(&m_tiles[it])) return DT_FAILURE | DT_OUT_OF_MEMORY;
 	const dtMeshTile* tile = &m_tiles[it];
 	if (ip >= (unsigned int)tile->header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
 	const dtPoly* poly = &tile->polys[ip];
@@ -1517,8 +2419,9 @@ dtStatus dtNavMesh::getOffMeshConnectionPolyEndPoints(dtPolyRef prevRef, dtPolyR
 		}
 	}
 	
-	dtVcopy(startPos, &tile->verts[poly->verts[idx0]*3]);
-	dtVcopy(endPos, &tile->verts[poly->verts[idx1]*3]);
+	float tmp[3];
+	dtVcopy(startPos, tile->getVert(poly->verts[idx0], tmp));
+	dtVcopy(endPos, tile->getVert(poly->verts[idx1], tmp));
 
 	return DT_SUCCESS;
 }
@@ -1535,6 +2438,7 @@ const dtOffMeshConnection* dtNavMesh::getOffMeshConnectionByRef(dtPolyRef ref) c
 	decodePolyId(ref, salt, it, ip);
 	if (it >= (unsigned int)m_maxTiles) return 0;
 	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return 0;
+	if (!useTile(&m_tiles[it])) return 0;
 	const dtMeshTile* tile = &m_tiles[it];
 	if (ip >= (unsigned int)tile->header->polyCount) return 0;
 	const dtPoly* poly = &tile->polys[ip];
@@ -1556,8 +2460,11 @@ dtStatus dtNavMesh::setPolyFlags(dtPolyRef ref, unsigned short flags)
 	decodePolyId(ref, salt, it, ip);
 	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
 	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
+	if (!useTile(&m_tiles[it])) return DT_FAILURE | DT_OUT_OF_MEMORY;
 	dtMeshTile* tile = &m_tiles[it];
 	if (ip >= (unsigned int)tile->header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
+	if (tile->polys[ip].flags == flags) return DT_SUCCESS;
+	if (!unshareTile(tile)) return DT_FAILURE | DT_OUT_OF_MEMORY;
 	dtPoly* poly = &tile->polys[ip];
 	
 	// Change flags.
@@ -1573,6 +2480,7 @@ dtStatus dtNavMesh::getPolyFlags(dtPolyRef ref, unsigned short* resultFlags) con
 	decodePolyId(ref, salt, it, ip);
 	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
 	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
+	if (!useTile(&m_tiles[it])) return DT_FAILURE | DT_OUT_OF_MEMORY;
 	const dtMeshTile* tile = &m_tiles[it];
 	if (ip >= (unsigned int)tile->header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
 	const dtPoly* poly = &tile->polys[ip];
@@ -1589,8 +2497,11 @@ dtStatus dtNavMesh::setPolyArea(dtPolyRef ref, unsigned char area)
 	decodePolyId(ref, salt, it, ip);
 	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
 	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
+	if (!useTile(&m_tiles[it])) return DT_FAILURE | DT_OUT_OF_MEMORY;
 	dtMeshTile* tile = &m_tiles[it];
 	if (ip >= (unsigned int)tile->header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
+	if (tile->polys[ip].getArea() == area) return DT_SUCCESS;
+	if (!unshareTile(tile)) return DT_FAILURE | DT_OUT_OF_MEMORY;
 	dtPoly* poly = &tile->polys[ip];
 	
 	poly->setArea(area);
@@ -1605,6 +2516,7 @@ dtStatus dtNavMesh::getPolyArea(dtPolyRef ref, unsigned char* resultArea) const
 	decodePolyId(ref, salt, it, ip);
 	if (it >= (unsigned int)m_maxTiles) return DT_FAILURE | DT_INVALID_PARAM;
 	if (m_tiles[it].salt != salt || m_tiles[it].header == 0) return DT_FAILURE | DT_INVALID_PARAM;
+	if (!useTile(&m_tiles[it])) return DT_FAILURE | DT_OUT_OF_MEMORY;
 	const dtMeshTile* tile = &m_tiles[it];
 	if (ip >= (unsigned int)tile->header->polyCount) return DT_FAILURE | DT_INVALID_PARAM;
 	const dtPoly* poly = &tile->polys[ip];
@@ -1614,3 +2526,291 @@ dtStatus dtNavMesh::getPolyArea(dtPolyRef ref, unsigned char* resultArea) const
 	return DT_SUCCESS;
 }
 
+
+/// @par
+///
+/// Compressed tiles keep only their header in memory. A tile is decompressed when it is used:
+/// when it is found by reference or location, reached through a link, or returned by
+/// #getTile. The tiles stay
+/// decompressed until #compressColdTiles is called, which compresses the least recently used
+/// tiles over the budget. Call it between the queries, for example once per frame, as the
+/// pointers to the tile data returned before the call may no longer be valid after it.
+///
+/// Only the tiles added with #DT_TILE_FREE_DATA are compressed, and only if their data
+/// shrinks. The other tiles are always resident, and are not counted in the budget.
+///
+/// @warning Using a tile changes the navigation mesh while compression is enabled, so the
+/// queries of several threads must not run on the navigation mesh at the same time.
+dtStatus dtNavMesh::setTileCompression(dtTileCompressor* compressor, const int maxResidentTiles)
+{
+	if (maxResidentTiles < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	// The tiles compressed by the previous compressor are decompressed with it.
+	if (m_compressor && compressor != m_compressor)
+	{
+		for (int i = 0; i < m_maxTiles; ++i)
+		{
+			dtMeshTile* tile = &m_tiles[i];
+			if (tile->compressedData && !decompressTile(tile))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+		}
+	}
+
+	m_compressor = compressor;
+	m_maxResidentTiles = maxResidentTiles;
+
+	return DT_SUCCESS;
+}
+
+namespace
+{
+	struct dtTileAge
+	{
+		unsigned int age;
+		dtMeshTile* tile;
+	};
+
+	int compareTileAge(const void* va, const void* vb)
+	{
+		const dtTileAge* a = (const dtTileAge*)va;
+		const dtTileAge* b = (const dtTileAge*)vb;
+		// Oldest first.
+		if (a->age > b->age)
+			return -1;
+		if (a->age < b->age)
+			return 1;
+		return 0;
+	}
+}
+
+dtStatus dtNavMesh::compressColdTiles()
+{
+	if (!m_compressor)
+		return DT_SUCCESS;
+
+	int nresident = 0;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const dtMeshTile* tile = &m_tiles[i];
+		if (tile->header && !tile->compressedData && (tile->flags & DT_TILE_FREE_DATA))
+			nresident++;
+	}
+	if (nresident <= m_maxResidentTiles)
+		return DT_SUCCESS;
+
+	dtTileAge* ages = (dtTileAge*)dtAlloc(sizeof(dtTileAge)*nresident, DT_ALLOC_TEMP);
+	if (!ages)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	int n = 0;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		dtMeshTile* tile = &m_tiles[i];
+		if (tile->header && !tile->compressedData && (tile->flags & DT_TILE_FREE_DATA))
+		{
+			// The difference is correct when the use count wraps around.
+			ages[n].age = m_tileUseCount - tile->lastUsed;
+			ages[n].tile = tile;
+			n++;
+		}
+	}
+	qsort(ages, n, sizeof(dtTileAge), compareTileAge);
+
+	dtStatus status = DT_SUCCESS;
+	for (int i = 0; i < n - m_maxResidentTiles; ++i)
+	{
+		if (!compressTile(ages[i].tile))
+			status = DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	dtFree(ages);
+
+	return status;
+}
+
+void dtNavMesh::getTileCompressionStats(dtTileCompressionStats* stats) const
+{
+	*stats = m_compressionStats;
+	stats->residentTiles = 0;
+	stats->compressedTiles = 0;
+	stats->compressedBytes = 0;
+	stats->uncompressedBytes = 0;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const dtMeshTile* tile = &m_tiles[i];
+		if (tile->compressedData)
+		{
+			stats->compressedTiles++;
+			stats->compressedBytes += tile->compressedSize;
+			stats->uncompressedBytes += tile->dataSize;
+		}
+		else if (tile->header && (tile->flags & DT_TILE_FREE_DATA))
+		{
+			stats->residentTiles++;
+		}
+	}
+}
+
+void dtNavMesh::resetTileCompressionStats()
+{
+	memset(&m_compressionStats, 0, sizeof(m_compressionStats));
+}
+
+bool dtNavMesh::touchTile(const dtMeshTile* constTile) const
+{
+	dtMeshTile* tile = &m_tiles[constTile - m_tiles];
+	tile->lastUsed = ++m_tileUseCount;
+	if (!tile->compressedData)
+	{
+		m_compressionStats.hits++;
+		return true;
+	}
+	m_compressionStats.misses++;
+	return decompressTile(tile);
+}
+
+bool dtNavMesh::compressTile(dtMeshTile* tile)
+{
+	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
+	const int maxSize = m_compressor->maxCompressedSize(tile->dataSize);
+	unsigned char* buffer = (unsigned char*)dtAlloc(maxSize, DT_ALLOC_TEMP);
+	if (!buffer)
+	{
+		m_compressionStats.failures++;
+		return false;
+	}
+
+	int size = 0;
+	dtStatus status = m_compressor->compress(tile->data, tile->dataSize, buffer, maxSize, &size);
+	if (dtStatusFailed(status) || headerSize + size >= tile->dataSize)
+	{
+		// Incompressible tiles stay resident, and are tried again once they are the oldest again.
+		dtFree(buffer);
+		tile->lastUsed = m_tileUseCount;
+		if (dtStatusFailed(status))
+			m_compressionStats.failures++;
+		return !dtStatusFailed(status);
+	}
+
+	unsigned char* compressed = (unsigned char*)dtAlloc(headerSize + size, DT_ALLOC_PERM);
+	if (!compressed)
+	{
+		dtFree(buffer);
+		m_compressionStats.failures++;
+		return false;
+	}
+	memcpy(compressed, tile->header, sizeof(dtMeshHeader));
+	memcpy(compressed + headerSize, buffer, size);
+	dtFree(buffer);
+
+	dtFree(tile->data);
+	tile->data = 0;
+	tile->header = (dtMeshHeader*)compressed;
+	tile->polys = 0;
+	tile->verts = 0;
+	tile->links = 0;
+	tile->detailMeshes = 0;
+	tile->detailVerts = 0;
+	tile->quantVerts = 0;
+	tile->quantDetailVerts = 0;
+	tile->detailTris = 0;
+	tile->bvTree = 0;
+	tile->bvWideTree = 0;
+	tile->offMeshCons = 0;
+	tile->detailGrids = 0;
+	tile->detailGridCells = 0;
+	tile->detailGridTris = 0;
+	tile->compressedData = compressed;
+	tile->compressedSize = headerSize + size;
+
+	m_compressionStats.compressions++;
+
+	return true;
+}
+
+bool dtNavMesh::decompressTile(dtMeshTile* tile) const
+{
+	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
+	unsigned char* data = (unsigned char*)dtAlloc(tile->dataSize, DT_ALLOC_PERM);
+	if (!data)
+	{
+		m_compressionStats.failures++;
+		return false;
+	}
+
+	int size = 0;
+	dtStatus status = m_compressor->decompress(tile->compressedData + headerSize, tile->compressedSize - headerSize,
+											   data, tile->dataSize, &size);
+	if (dtStatusFailed(status) || size != tile->dataSize)
+	{
+		dtFree(data);
+		m_compressionStats.failures++;
+		return false;
+	}
+
+	dtFree(tile->compressedData);
+	tile->compressedData = 0;
+	tile->compressedSize = 0;
+	setTilePointers(tile, data);
+
+	return true;
+}
+
+bool dtNavMesh::prepareTilesAround(const int x, const int y, const dtMeshTile* skip)
+{
+	static const int MAX_NEIS = 32;
+	dtMeshTile* neis[MAX_NEIS];
+	for (int dy = -1; dy <= 1; ++dy)
+	{
+		for (int dx = -1; dx <= 1; ++dx)
+		{
+			const int nneis = getTilesAt(x + dx, y + dy, neis, MAX_NEIS);
+			for (int i = 0; i < nneis; ++i)
+			{
+				if (neis[i] == skip)
+					continue;
+				if (neis[i]->compressedData && !decompressTile(neis[i]))
+					return false;
+				if (!unshareTile(neis[i]))
+					return false;
+			}
+		}
+	}
+	return true;
+}
+
+bool dtNavMesh::unshareTile(dtMeshTile* tile)
+{
+	if (!(tile->flags & DT_TILE_SHARED_DATA) || tile->overlay)
+		return true;
+
+	const dtMeshHeader* header = tile->header;
+	// Only the off-mesh connection vertices are changed, but they are stored after the polygon
+	// vertices in a float tile.
+	const int nverts = header->offMeshConCount == 0 ? 0 : (tile->quantVerts ? header->offMeshConCount*2 : header->vertCount);
+	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
+	const int linksSize = dtAlign4(sizeof(dtLink)*header->maxLinkCount);
+	const int vertsSize = dtAlign4(sizeof(float)*3*nverts);
+
+	unsigned char* overlay = (unsigned char*)dtAlloc(polysSize + linksSize + vertsSize, DT_ALLOC_PERM);
+	if (!overlay)
+		return false;
+
+	unsigned char* d = overlay;
+	dtPoly* polys = dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize);
+	dtLink* links = dtGetThenAdvanceBufferPointer<dtLink>(d, linksSize);
+	float* verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
+	memcpy(polys, tile->polys, sizeof(dtPoly)*header->polyCount);
+	memcpy(links, tile->links, sizeof(dtLink)*header->maxLinkCount);
+	tile->polys = polys;
+	tile->links = links;
+	if (nverts)
+	{
+		memcpy(verts, tile->verts, sizeof(float)*3*nverts);
+		tile->verts = verts;
+	}
+	tile->overlay = overlay;
+
+	return true;
+}
@@ -110,7 +110,167 @@ inline int longestAxis(unsigned short x, unsigned short y, unsigned short z)
 	return axis;
 }
 
-static void subdivide(BVItem* items, int nitems, int imin, int imax, int& curNode, dtBVNode* nodes)
+// Number of bins used when evaluating split candidates along an axis.
+static const int BV_BINS = 16;
+
+// Depth beyond which splits fall back to median splits, which keeps the trees shallow
+// enough for the traversal stack.
+static const int BV_MAX_SAH_DEPTH = 32;
+
+inline float halfArea(const unsigned short* bmin, const unsigned short* bmax)
+{
+	const float dx = (float)(bmax[0] - bmin[0]);
+	const float dy = (float)(bmax[1] - bmin[1]);
+	const float dz = (float)(bmax[2] - bmin[2]);
+	return dx*dy + dy*dz + dz*dx;
+}
+
+inline void growBounds(unsigned short* bmin, unsigned short* bmax, const unsigned short* amin, const unsigned short* amax)
+{
+	for (int i = 0; i < 3; ++i)
+	{
+		if (amin[i] < bmin[i]) bmin[i] = amin[i];
+		if (amax[i] > bmax[i]) bmax[i] = amax[i];
+	}
+}
+
+inline int binIndex(const BVItem& it, const int axis, const int cmin, const float scale)
+{
+	// The centroid is kept doubled to stay in integers.
+	return dtClamp((int)((it.bmin[axis] + it.bmax[axis] - cmin) * scale), 0, BV_BINS-1);
+}
+
+static int medianSplit(BVItem* items, const int imin, const int imax)
+{
+	const int inum = imax - imin;
+	unsigned short bmin[3], bmax[3];
+	calcExtends(items, inum, imin, imax, bmin, bmax);
+	
+	int	axis = longestAxis(bmax[0] - bmin[0],
+						   bmax[1] - bmin[1],
+						   bmax[2] - bmin[2]);
+	
+	if (axis == 0)
+	{
+		// Sort along x-axis
+		qsort(items+imin, inum, sizeof(BVItem), compareItemX);
+	}
+	else if (axis == 1)
+	{
+		// Sort along y-axis
+		qsort(items+imin, inum, sizeof(BVItem), compareItemY);
+	}
+	else
+	{
+		// Sort along z-axis
+		qsort(items+imin, inum, sizeof(BVItem), compareItemZ);
+	}
+	
+	return imin+inum/2;
+}
+
+// Splits the items in two with the binned surface area heuristic, and returns the index of
+// the first item of the second part. Both parts are non-empty.
+static int splitItems(BVItem* items, const int imin, const int imax, const int depth)
+{
+	if (depth > BV_MAX_SAH_DEPTH)
+		return medianSplit(items, imin, imax);
+
+	int cmin[3] = { 0x7fffffff, 0x7fffffff, 0x7fffffff };
+	int cmax[3] = { 0, 0, 0 };
+	for (int i = imin; i < imax; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			const int c = items[i].bmin[j] + items[i].bmax[j];
+			cmin[j] = dtMin(cmin[j], c);
+			cmax[j] = dtMax(cmax[j], c);
+		}
+	}
+
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestBin = 0;
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		if (cmax[axis] == cmin[axis])
+			continue;
+		const float scale = BV_BINS / (float)(cmax[axis] - cmin[axis]);
+
+		int counts[BV_BINS];
+		unsigned short bmins[BV_BINS][3];
+		unsigned short bmaxs[BV_BINS][3];
+		for (int b = 0; b < BV_BINS; ++b)
+		{
+			counts[b] = 0;
+			bmins[b][0] = bmins[b][1] = bmins[b][2] = 0xffff;
+			bmaxs[b][0] = bmaxs[b][1] = bmaxs[b][2] = 0;
+		}
+		for (int i = imin; i < imax; ++i)
+		{
+			const int b = binIndex(items[i], axis, cmin[axis], scale);
+			counts[b]++;
+			growBounds(bmins[b], bmaxs[b], items[i].bmin, items[i].bmax);
+		}
+
+		// Sweep from the right to get the cost of everything above each bin boundary.
+		float rightArea[BV_BINS];
+		int rightCount[BV_BINS];
+		unsigned short rmin[3] = { 0xffff, 0xffff, 0xffff };
+		unsigned short rmax[3] = { 0, 0, 0 };
+		int rn = 0;
+		for (int b = BV_BINS-1; b > 0; --b)
+		{
+			rn += counts[b];
+			growBounds(rmin, rmax, bmins[b], bmaxs[b]);
+			rightCount[b] = rn;
+			rightArea[b] = rn > 0 ? halfArea(rmin, rmax) : 0.0f;
+		}
+
+		// Sweep from the left and evaluate the surface area heuristic at each boundary.
+		unsigned short lmin[3] = { 0xffff, 0xffff, 0xffff };
+		unsigned short lmax[3] = { 0, 0, 0 };
+		int ln = 0;
+		for (int b = 1; b < BV_BINS; ++b)
+		{
+			ln += counts[b-1];
+			growBounds(lmin, lmax, bmins[b-1], bmaxs[b-1]);
+			if (ln == 0 || rightCount[b] == 0)
+				continue;
+			const float cost = halfArea(lmin, lmax)*ln + rightArea[b]*rightCount[b];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
+		}
+	}
+
+	if (bestAxis == -1)
+		return medianSplit(items, imin, imax);
+
+	// Partition with the same bin mapping as above, so that both sides are non-empty.
+	const float scale = BV_BINS / (float)(cmax[bestAxis] - cmin[bestAxis]);
+	int i = imin;
+	int j = imax - 1;
+	while (i <= j)
+	{
+		if (binIndex(items[i], bestAxis, cmin[bestAxis], scale) < bestBin)
+		{
+			i++;
+		}
+		else
+		{
+			dtSwap(items[i], items[j]);
+			j--;
+		}
+	}
+	dtAssert(i > imin && i < imax);
+	return i;
+}
+
+static void subdivide(BVItem* items, int nitems, int imin, int imax, int depth, int& curNode, dtBVNode* nodes)
 {
 	int inum = imax - imin;
 	int icur = curNode;
@@ -135,32 +295,12 @@ static void subdivide(BVItem* items, int nitems, int imin, int imax, int& curNod
 		// Split
 		calcExtends(items, nitems, imin, imax, node.bmin, node.bmax);
 		
-		int	axis = longestAxis(node.bmax[0] - node.bmin[0],
-							   node.bmax[1] - node.bmin[1],
-							   node.bmax[2] - node.bmin[2]);
-		
-		if (axis == 0)
-		{
-			// Sort along x-axis
-			qsort(items+imin, inum, sizeof(BVItem), compareItemX);
-		}
-		else if (axis == 1)
-		{
-			// Sort along y-axis
-			qsort(items+imin, inum, sizeof(BVItem), compareItemY);
-		}
-		else
-		{
-			// Sort along z-axis
-			qsort(items+imin, inum, sizeof(BVItem), compareItemZ);
-		}
-		
-		int isplit = imin+inum/2;
+		int isplit = splitItems(items, imin, imax, depth);
 		
 		// Left
-		subdivide(items, nitems, imin, isplit, curNode, nodes);
+		subdivide(items, nitems, imin, isplit, depth+1, curNode, nodes);
 		// Right
-		subdivide(items, nitems, isplit, imax, curNode, nodes);
+		subdivide(items, nitems, isplit, imax, depth+1, curNode, nodes);
 		
 		int iescape = curNode - icur;
 		// Negative index means escape.
@@ -168,11 +308,78 @@ static void subdivide(BVItem* items, int nitems, int imin, int imax, int& curNod
 	}
 }
 
-static int createBVTree(dtNavMeshCreateParams* params, dtBVNode* nodes, int /*nnodes*/)
+static int subdivideWide(BVItem* items, int nitems, int imin, int imax, int depth, int& curNode, dtBVWideNode* nodes)
+{
+	const int icur = curNode++;
+	
+	// Split the items in up to four parts, always splitting the largest part. A part that fits
+	// in a node is split only if its items fit in the free children, so that the nodes stay full.
+	int pmin[DT_BVWIDE_WIDTH], pmax[DT_BVWIDE_WIDTH], pdepth[DT_BVWIDE_WIDTH];
+	int nparts = 1;
+	pmin[0] = imin;
+	pmax[0] = imax;
+	pdepth[0] = depth;
+	while (nparts < DT_BVWIDE_WIDTH)
+	{
+		int best = -1;
+		for (int i = 0; i < nparts; ++i)
+		{
+			const int count = pmax[i] - pmin[i];
+			if (count <= 1 || (count <= DT_BVWIDE_WIDTH && count - 1 > DT_BVWIDE_WIDTH - nparts))
+				continue;
+			if (best == -1 || count > pmax[best] - pmin[best])
+				best = i;
+		}
+		if (best == -1)
+			break;
+		const int isplit = splitItems(items, pmin[best], pmax[best], pdepth[best]);
+		// Keep the parts in order, so that the nodes are stored depth first.
+		for (int i = nparts; i > best+1; --i)
+		{
+			pmin[i] = pmin[i-1];
+			pmax[i] = pmax[i-1];
+			pdepth[i] = pdepth[i-1];
+		}
+		pmin[best+1] = isplit;
+		pmax[best+1] = pmax[best];
+		pmax[best] = isplit;
+		pdepth[best]++;
+		pdepth[best+1] = pdepth[best];
+		nparts++;
+	}
+	
+	for (int i = 0; i < DT_BVWIDE_WIDTH; ++i)
+	{
+		unsigned short bmin[3] = { 0xffff, 0xffff, 0xffff };
+		unsigned short bmax[3] = { 0, 0, 0 };
+		int child = 0;
+		if (i < nparts)
+		{
+			calcExtends(items, nitems, pmin[i], pmax[i], bmin, bmax);
+			if (pmax[i] - pmin[i] == 1)
+				child = ~items[pmin[i]].i;
+			else
+				child = subdivideWide(items, nitems, pmin[i], pmax[i], pdepth[i], curNode, nodes);
+		}
+		dtBVWideNode& node = nodes[icur];
+		for (int j = 0; j < 3; ++j)
+		{
+			node.bmin[j][i] = bmin[j];
+			node.bmax[j][i] = bmax[j];
+		}
+		node.child[i] = child;
+	}
+	
+	return icur;
+}
+
+// Calculates the quantized bounds of the polygons.
+static BVItem* createBVItems(dtNavMeshCreateParams* params)
 {
-	// Build tree
 	float quantFactor = 1 / params->cs;
 	BVItem* items = (BVItem*)dtAlloc(sizeof(BVItem)*params->polyCount, DT_ALLOC_TEMP);
+	if (!items)
+		return 0;
 	for (int i = 0; i < params->polyCount; i++)
 	{
 		BVItem& it = items[i];
@@ -232,8 +439,32 @@ static int createBVTree(dtNavMeshCreateParams* params, dtBVNode* nodes, int /*nn
 		}
 	}
 	
+	return items;
+}
+
+static int createBVTree(dtNavMeshCreateParams* params, dtBVNode* nodes, int /*nnodes*/)
+{
+	BVItem* items = createBVItems(params);
+	if (!items)
+		return 0;
+	
+	int curNode = 0;
+	subdivide(items, params->polyCount, 0, params->polyCount, 0, curNode, nodes);
+	
+	dtFree(items);
+	
+	return curNode;
+}
+
+// Builds the 4-ary tree, and returns the number of nodes. A tree of n polygons has at most n nodes.
+static int createWideBVTree(dtNavMeshCreateParams* params, dtBVWideNode* nodes)
+{
+	BVItem* items = createBVItems(params);
+	if (!items)
+		return 0;
+	
 	int curNode = 0;
-	subdivide(items, params->polyCount, 0, params->polyCount, curNode, nodes);
+	subdivideWide(items, params->polyCount, 0, params->polyCount, 0, curNode, nodes);
 	
 	dtFree(items);
 	
@@ -268,6 +499,169 @@ static unsigned char classifyOffMeshPoint(const float* pt, const float* bmin, co
 	return 0xff;	
 }
 
+static void quantizeDetailVerts(const dtMeshHeader* header, const float* verts, const int nverts, unsigned short* out)
+{
+	for (int i = 0; i < nverts; ++i)
+	{
+		for (int j = 0; j < 3; ++j)
+		{
+			const float step = header->detailVertStep[j];
+			const float q = step > 0 ? (verts[i*3+j] - header->bmin[j]) / step + 0.5f : 0.0f;
+			out[i*3+j] = (unsigned short)dtClamp(q, 0.0f, 65535.0f);
+		}
+	}
+}
+
+// Detail meshes with fewer triangles are searched linearly.
+static const int DETAIL_GRID_MIN_TRIS = 8;
+
+// Sets up the bounds and size of the grid of detail mesh i, returns false if the mesh gets no grid.
+static bool setupDetailGrid(const dtNavMeshCreateParams* params, const int i, dtPolyDetailGrid& grid)
+{
+	const int vb = (int)params->detailMeshes[i*4+0];
+	const int nv = (int)params->detailMeshes[i*4+1];
+	const int ntris = (int)params->detailMeshes[i*4+3];
+	if (ntris < DETAIL_GRID_MIN_TRIS)
+		return false;
+
+	float bmin[2] = { FLT_MAX, FLT_MAX };
+	float bmax[2] = { -FLT_MAX, -FLT_MAX };
+	for (int j = 0; j < nv; ++j)
+	{
+		const float* v = &params->detailVerts[(vb+j)*3];
+		bmin[0] = dtMin(bmin[0], v[0]);
+		bmin[1] = dtMin(bmin[1], v[2]);
+		bmax[0] = dtMax(bmax[0], v[0]);
+		bmax[1] = dtMax(bmax[1], v[2]);
+	}
+	const float w = bmax[0] - bmin[0];
+	const float h = bmax[1] - bmin[1];
+	if (!(w > 0) || !(h > 0))
+		return false;
+
+	// Aim for about four triangles per cell.
+	const float cs = dtMathSqrtf(w*h / (ntris*0.25f));
+	const int gw = dtClamp((int)dtMathCeilf(w / cs), 1, DT_DETAIL_GRID_MAX_SIZE);
+	const int gh = dtClamp((int)dtMathCeilf(h / cs), 1, DT_DETAIL_GRID_MAX_SIZE);
+	grid.bmin[0] = bmin[0];
+	grid.bmin[1] = bmin[1];
+	grid.invCellSize[0] = gw / w;
+	grid.invCellSize[1] = gh / h;
+	grid.width = (unsigned char)gw;
+	grid.height = (unsigned char)gh;
+	return true;
+}
+
+// Returns true if triangle abc overlaps the rectangle on the xz-plane.
+static bool overlapTriRect2D(const float* a, const float* b, const float* c, const float* rmin, const float* rmax)
+{
+	const float* v[3] = { a, b, c };
+	for (int j = 2, k = 0; k < 3; j = k++)
+	{
+		// Separated if the rectangle is on the other side of the edge than the third vertex.
+		const float* p = v[j];
+		const float* q = v[k];
+		const float* r = v[3-j-k];
+		const float nx = p[2] - q[2];
+		const float nz = q[0] - p[0];
+		const float side = nx*(r[0] - p[0]) + nz*(r[2] - p[2]);
+		if (side == 0)
+			return true;
+		const float ex = (side > 0 ? (nx > 0 ? rmax[0] : rmin[0]) : (nx > 0 ? rmin[0] : rmax[0])) - p[0];
+		const float ez = (side > 0 ? (nz > 0 ? rmax[1] : rmin[1]) : (nz > 0 ? rmin[1] : rmax[1])) - p[2];
+		const float d = nx*ex + nz*ez;
+		if (side > 0 ? d < 0 : d > 0)
+			return false;
+	}
+	return true;
+}
+
+// Finds the cells of the grid of detail mesh i that triangle j overlaps, returns their count.
+static int findDetailGridCells(const dtNavMeshCreateParams* params, const int i, const int j,
+							   const dtPolyDetailGrid& grid, const float* pad, unsigned char* cells)
+{
+	const int vb = (int)params->detailMeshes[i*4+0];
+	const unsigned char* t = &params->detailTris[((int)params->detailMeshes[i*4+2] + j)*4];
+	const float* v[3];
+	float tmin[2] = { FLT_MAX, FLT_MAX };
+	float tmax[2] = { -FLT_MAX, -FLT_MAX };
+	for (int k = 0; k < 3; ++k)
+	{
+		v[k] = &params->detailVerts[(vb+t[k])*3];
+		tmin[0] = dtMin(tmin[0], v[k][0]);
+		tmin[1] = dtMin(tmin[1], v[k][2]);
+		tmax[0] = dtMax(tmax[0], v[k][0]);
+		tmax[1] = dtMax(tmax[1], v[k][2]);
+	}
+
+	const float csx = 1.0f / grid.invCellSize[0];
+	const float csz = 1.0f / grid.invCellSize[1];
+	const int x0 = dtClamp((int)dtMathFloorf((tmin[0] - pad[0] - grid.bmin[0]) * grid.invCellSize[0]), 0, grid.width-1);
+	const int x1 = dtClamp((int)dtMathFloorf((tmax[0] + pad[0] - grid.bmin[0]) * grid.invCellSize[0]), 0, grid.width-1);
+	const int z0 = dtClamp((int)dtMathFloorf((tmin[1] - pad[1] - grid.bmin[1]) * grid.invCellSize[1]), 0, grid.height-1);
+	const int z1 = dtClamp((int)dtMathFloorf((tmax[1] + pad[1] - grid.bmin[1]) * grid.invCellSize[1]), 0, grid.height-1);
+
+	int n = 0;
+	for (int z = z0; z <= z1; ++z)
+	{
+		for (int x = x0; x <= x1; ++x)
+		{
+			const float rmin[2] = { grid.bmin[0] + x*csx - pad[0], grid.bmin[1] + z*csz - pad[1] };
+			const float rmax[2] = { grid.bmin[0] + (x+1)*csx + pad[0], grid.bmin[1] + (z+1)*csz + pad[1] };
+			if (overlapTriRect2D(v[0], v[1], v[2], rmin, rmax))
+				cells[n++] = (unsigned char)(x + z*grid.width);
+		}
+	}
+	return n;
+}
+
+// Builds the grid of detail mesh i, or only counts its cells and triangle indices if grid is null.
+// The triangles are binned with some padding, so that the lookups find them despite rounding.
+static bool buildDetailGrid(const dtNavMeshCreateParams* params, const int i, const float* step,
+							dtPolyDetailGrid* grid, unsigned short* gridCells, unsigned char* gridTris,
+							int& ncells, int& ntris)
+{
+	dtPolyDetailGrid tmp;
+	if (!setupDetailGrid(params, i, tmp))
+		return false;
+	const float pad[2] = { 0.01f / tmp.invCellSize[0] + step[0], 0.01f / tmp.invCellSize[1] + step[2] };
+	const int triCount = (int)params->detailMeshes[i*4+3];
+	const int cellCount = tmp.width*tmp.height;
+	unsigned char cells[DT_DETAIL_GRID_MAX_SIZE*DT_DETAIL_GRID_MAX_SIZE];
+
+	ncells = cellCount+1;
+	ntris = 0;
+	if (!grid)
+	{
+		for (int j = 0; j < triCount; ++j)
+			ntris += findDetailGridCells(params, i, j, tmp, pad, cells);
+		return true;
+	}
+
+	// Count the triangles of each cell, then fill the cells.
+	memset(gridCells, 0, sizeof(unsigned short)*(cellCount+1));
+	for (int j = 0; j < triCount; ++j)
+	{
+		const int n = findDetailGridCells(params, i, j, tmp, pad, cells);
+		for (int k = 0; k < n; ++k)
+			gridCells[cells[k]+1]++;
+	}
+	for (int k = 0; k < cellCount; ++k)
+		gridCells[k+1] = (unsigned short)(gridCells[k+1] + gridCells[k]);
+	unsigned short fill[DT_DETAIL_GRID_MAX_SIZE*DT_DETAIL_GRID_MAX_SIZE];
+	memcpy(fill, gridCells, sizeof(unsigned short)*cellCount);
+	for (int j = 0; j < triCount; ++j)
+	{
+		const int n = findDetailGridCells(params, i, j, tmp, pad, cells);
+		for (int k = 0; k < n; ++k)
+			gridTris[fill[cells[k]]++] = (unsigned char)j;
+	}
+	ntris = gridCells[cellCount];
+
+	*grid = tmp;
+	return true;
+}
+
 // TODO: Better error handling.
 
 /// @par
@@ -423,24 +817,77 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 		}
 	}
 	
+	// A binary BV tree has a leaf per polygon, the size of the wide tree is known only once it is built.
+	dtBVWideNode* wideBvTree = 0;
+	int bvNodeCount = params->buildBvTree ? params->polyCount*2 - 1 : 0;
+	if (params->buildBvTree && params->wideBvTree)
+	{
+		wideBvTree = (dtBVWideNode*)dtAlloc(sizeof(dtBVWideNode)*params->polyCount, DT_ALLOC_TEMP);
+		if (!wideBvTree)
+		{
+			dtFree(offMeshConClass);
+			return false;
+		}
+		bvNodeCount = createWideBVTree(params, wideBvTree);
+		if (!bvNodeCount)
+		{
+			dtFree(wideBvTree);
+			dtFree(offMeshConClass);
+			return false;
+		}
+	}
+	
 	// Calculate data size
+	// Quantized tiles store the mesh vertices as shorts, followed by the off-mesh link vertices as floats.
+	const bool quantize = params->quantizeVerts;
+	
+	// Count the grids over the detail meshes with many triangles.
+	float detailGridStep[3] = { 0, 0, 0 };
+	if (quantize)
+	{
+		for (int i = 0; i < 3; ++i)
+			detailGridStep[i] = (params->bmax[i] - params->bmin[i]) / 65535.0f;
+	}
+	int detailGridCount = 0;
+	int detailGridCellCount = 0;
+	int detailGridTriCount = 0;
+	if (params->buildDetailGrids && params->detailMeshes)
+	{
+		for (int i = 0; i < params->polyCount && detailGridCount < 0xffff; ++i)
+		{
+			int ncells, ntris;
+			if (buildDetailGrid(params, i, detailGridStep, 0, 0, 0, ncells, ntris))
+			{
+				detailGridCount++;
+				detailGridCellCount += ncells;
+				detailGridTriCount += ntris;
+			}
+		}
+	}
+	
+	const int offMeshVertsOffset = quantize ? dtAlign4(sizeof(unsigned short)*3*params->vertCount) : (int)sizeof(float)*3*params->vertCount;
 	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
-	const int vertsSize = dtAlign4(sizeof(float)*3*totVertCount);
+	const int vertsSize = dtAlign4(offMeshVertsOffset + sizeof(float)*3*storedOffMeshConCount*2);
 	const int polysSize = dtAlign4(sizeof(dtPoly)*totPolyCount);
 	const int linksSize = dtAlign4(sizeof(dtLink)*maxLinkCount);
 	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*params->polyCount);
-	const int detailVertsSize = dtAlign4(sizeof(float)*3*uniqueDetailVertCount);
+	const int detailVertsSize = dtAlign4((quantize ? sizeof(unsigned short) : sizeof(float))*3*uniqueDetailVertCount);
 	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*detailTriCount);
-	const int bvTreeSize = params->buildBvTree ? dtAlign4(sizeof(dtBVNode)*params->polyCount*2) : 0;
+	const int bvTreeSize = dtAlign4((wideBvTree ? sizeof(dtBVWideNode) : sizeof(dtBVNode))*bvNodeCount);
 	const int offMeshConsSize = dtAlign4(sizeof(dtOffMeshConnection)*storedOffMeshConCount);
+	const int detailGridsSize = dtAlign4(sizeof(dtPolyDetailGrid)*detailGridCount);
+	const int detailGridCellsSize = dtAlign4(sizeof(unsigned short)*detailGridCellCount);
+	const int detailGridTrisSize = dtAlign4(sizeof(unsigned char)*detailGridTriCount);
 	
 	const int dataSize = headerSize + vertsSize + polysSize + linksSize +
 						 detailMeshesSize + detailVertsSize + detailTrisSize +
-						 bvTreeSize + offMeshConsSize;
+						 bvTreeSize + offMeshConsSize +
+						 detailGridsSize + detailGridCellsSize + detailGridTrisSize;
 						 
 	unsigned char* data = (unsigned char*)dtAlloc(sizeof(unsigned char)*dataSize, DT_ALLOC_PERM);
 	if (!data)
 	{
+		dtFree(wideBvTree);
 		dtFree(offMeshConClass);
 		return false;
 	}
@@ -449,15 +896,17 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	unsigned char* d = data;
 
 	dtMeshHeader* header = dtGetThenAdvanceBufferPointer<dtMeshHeader>(d, headerSize);
-	float* navVerts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
+	unsigned char* navVertsData = dtGetThenAdvanceBufferPointer<unsigned char>(d, vertsSize);
 	dtPoly* navPolys = dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize);
 	d += linksSize; // Ignore links; just leave enough space for them. They'll be created on load.
 	dtPolyDetail* navDMeshes = dtGetThenAdvanceBufferPointer<dtPolyDetail>(d, detailMeshesSize);
-	float* navDVerts = dtGetThenAdvanceBufferPointer<float>(d, detailVertsSize);
+	unsigned char* navDVertsData = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailVertsSize);
 	unsigned char* navDTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
-	dtBVNode* navBvtree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvTreeSize);
+	unsigned char* navBvtree = dtGetThenAdvanceBufferPointer<unsigned char>(d, bvTreeSize);
 	dtOffMeshConnection* offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshConsSize);
-	
+	dtPolyDetailGrid* navDGrids = dtGetThenAdvanceBufferPointer<dtPolyDetailGrid>(d, detailGridsSize);
+	unsigned short* navDGridCells = dtGetThenAdvanceBufferPointer<unsigned short>(d, detailGridCellsSize);
+	unsigned char* navDGridTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailGridTrisSize);
 	
 	// Store header
 	header->magic = DT_NAVMESH_MAGIC;
@@ -480,22 +929,44 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	header->walkableRadius = params->walkableRadius;
 	header->walkableClimb = params->walkableClimb;
 	header->offMeshConCount = storedOffMeshConCount;
-	header->bvNodeCount = params->buildBvTree ? params->polyCount*2 : 0;
+	header->bvNodeCount = bvNodeCount;
+	header->bvFormat = wideBvTree ? DT_BVFORMAT_WIDE : DT_BVFORMAT_BINARY;
+	header->detailGridCount = detailGridCount;
+	header->detailGridCellCount = detailGridCellCount;
+	header->detailGridTriCount = detailGridTriCount;
+	header->vertFormat = quantize ? DT_VERTFORMAT_QUANTIZED : DT_VERTFORMAT_FLOAT;
+	if (quantize)
+	{
+		header->vertStep[0] = params->cs;
+		header->vertStep[1] = params->ch;
+		header->vertStep[2] = params->cs;
+		for (int i = 0; i < 3; ++i)
+			header->detailVertStep[i] = (params->bmax[i] - params->bmin[i]) / 65535.0f;
+	}
 	
 	const int offMeshVertsBase = params->vertCount;
 	const int offMeshPolyBase = params->polyCount;
 	
 	// Store vertices
 	// Mesh vertices
-	for (int i = 0; i < params->vertCount; ++i)
+	if (quantize)
 	{
-		const unsigned short* iv = &params->verts[i*3];
-		float* v = &navVerts[i*3];
-		v[0] = params->bmin[0] + iv[0] * params->cs;
-		v[1] = params->bmin[1] + iv[1] * params->ch;
-		v[2] = params->bmin[2] + iv[2] * params->cs;
+		memcpy(navVertsData, params->verts, sizeof(unsigned short)*3*params->vertCount);
+	}
+	else
+	{
+		float* navVerts = (float*)navVertsData;
+		for (int i = 0; i < params->vertCount; ++i)
+		{
+			const unsigned short* iv = &params->verts[i*3];
+			float* v = &navVerts[i*3];
+			v[0] = params->bmin[0] + iv[0] * params->cs;
+			v[1] = params->bmin[1] + iv[1] * params->ch;
+			v[2] = params->bmin[2] + iv[2] * params->cs;
+		}
 	}
 	// Off-mesh link vertices.
+	float* offMeshVerts = (float*)(navVertsData + offMeshVertsOffset);
 	int n = 0;
 	for (int i = 0; i < params->offMeshConCount; ++i)
 	{
@@ -503,7 +974,7 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 		if (offMeshConClass[i*2+0] == 0xff)
 		{
 			const float* linkv = &params->offMeshConVerts[i*2*3];
-			float* v = &navVerts[(offMeshVertsBase + n*2)*3];
+			float* v = &offMeshVerts[n*2*3];
 			dtVcopy(&v[0], &linkv[0]);
 			dtVcopy(&v[3], &linkv[3]);
 			n++;
@@ -601,12 +1072,32 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 			// Copy vertices except the first 'nv' verts which are equal to nav poly verts.
 			if (ndv-nv)
 			{
-				memcpy(&navDVerts[vbase*3], &params->detailVerts[(vb+nv)*3], sizeof(float)*3*(ndv-nv));
+				if (quantize)
+					quantizeDetailVerts(header, &params->detailVerts[(vb+nv)*3], ndv-nv, (unsigned short*)navDVertsData + vbase*3);
+				else
+					memcpy((float*)navDVertsData + vbase*3, &params->detailVerts[(vb+nv)*3], sizeof(float)*3*(ndv-nv));
 				vbase += (unsigned short)(ndv-nv);
 			}
 		}
 		// Store triangles.
 		memcpy(navDTris, params->detailTris, sizeof(unsigned char)*4*params->detailTriCount);
+		
+		// Store the grids, in the order they were counted.
+		int ngrids = 0;
+		int cellBase = 0;
+		int triBase = 0;
+		for (int i = 0; i < params->polyCount && ngrids < detailGridCount; ++i)
+		{
+			dtPolyDetailGrid* grid = &navDGrids[ngrids];
+			int ncells, ntris;
+			if (!buildDetailGrid(params, i, detailGridStep, grid, &navDGridCells[cellBase], &navDGridTris[triBase], ncells, ntris))
+				continue;
+			grid->cellBase = (unsigned int)cellBase;
+			grid->triBase = (unsigned int)triBase;
+			navDMeshes[i].grid = (unsigned short)(++ngrids);
+			cellBase += ncells;
+			triBase += ntris;
+		}
 	}
 	else
 	{
@@ -637,9 +1128,14 @@ bool dtCreateNavMeshData(dtNavMeshCreateParams* params, unsigned char** outData,
 	}
 
 	// Store and create BVtree.
-	if (params->buildBvTree)
+	if (wideBvTree)
+	{
+		memcpy(navBvtree, wideBvTree, sizeof(dtBVWideNode)*bvNodeCount);
+		dtFree(wideBvTree);
+	}
+	else if (params->buildBvTree)
 	{
-		createBVTree(params, navBvtree, 2*params->polyCount);
+		createBVTree(params, (dtBVNode*)navBvtree, bvNodeCount);
 	}
 	
 	// Store Off-Mesh connections.
@@ -712,6 +1208,16 @@ bool dtNavMeshHeaderSwapEndian(unsigned char* data, const int /*dataSize*/)
 	dtSwapEndian(&header->bmax[1]);
 	dtSwapEndian(&header->bmax[2]);
 	dtSwapEndian(&header->bvQuantFactor);
+	dtSwapEndian(&header->vertFormat);
+	dtSwapEndian(&header->bvFormat);
+	dtSwapEndian(&header->detailGridCount);
+	dtSwapEndian(&header->detailGridCellCount);
+	dtSwapEndian(&header->detailGridTriCount);
+	for (int i = 0; i < 3; ++i)
+	{
+		dtSwapEndian(&header->vertStep[i]);
+		dtSwapEndian(&header->detailVertStep[i]);
+	}
 
 	// Freelist index and pointers are updated when tile is added, no need to swap.
 
@@ -734,30 +1240,45 @@ bool dtNavMeshDataSwapEndian(unsigned char* data, const int /*dataSize*/)
 		return false;
 	
 	// Patch header pointers.
+	const bool quantized = header->vertFormat == DT_VERTFORMAT_QUANTIZED;
+	const int quantVertCount = quantized ? header->vertCount - header->offMeshConCount*2 : 0;
+	const int offMeshVertsOffset = dtAlign4(sizeof(unsigned short)*3*quantVertCount);
 	const int headerSize = dtAlign4(sizeof(dtMeshHeader));
-	const int vertsSize = dtAlign4(sizeof(float)*3*header->vertCount);
+	const int vertsSize = dtAlign4(offMeshVertsOffset + sizeof(float)*3*(header->vertCount - quantVertCount));
 	const int polysSize = dtAlign4(sizeof(dtPoly)*header->polyCount);
 	const int linksSize = dtAlign4(sizeof(dtLink)*(header->maxLinkCount));
 	const int detailMeshesSize = dtAlign4(sizeof(dtPolyDetail)*header->detailMeshCount);
-	const int detailVertsSize = dtAlign4(sizeof(float)*3*header->detailVertCount);
+	const int detailVertsSize = dtAlign4((quantized ? sizeof(unsigned short) : sizeof(float))*3*header->detailVertCount);
 	const int detailTrisSize = dtAlign4(sizeof(unsigned char)*4*header->detailTriCount);
-	const int bvtreeSize = dtAlign4(sizeof(dtBVNode)*header->bvNodeCount);
+	const bool wideBvTree = header->bvFormat == DT_BVFORMAT_WIDE;
+	const int bvtreeSize = dtAlign4((wideBvTree ? sizeof(dtBVWideNode) : sizeof(dtBVNode))*header->bvNodeCount);
 	const int offMeshLinksSize = dtAlign4(sizeof(dtOffMeshConnection)*header->offMeshConCount);
+	const int detailGridsSize = dtAlign4(sizeof(dtPolyDetailGrid)*header->detailGridCount);
+	const int detailGridCellsSize = dtAlign4(sizeof(unsigned short)*header->detailGridCellCount);
 	
 	unsigned char* d = data + headerSize;
-	float* verts = dtGetThenAdvanceBufferPointer<float>(d, vertsSize);
+	unsigned char* vertsData = dtGetThenAdvanceBufferPointer<unsigned char>(d, vertsSize);
 	dtPoly* polys = dtGetThenAdvanceBufferPointer<dtPoly>(d, polysSize);
 	d += linksSize; // Ignore links; they technically should be endian-swapped but all their data is overwritten on load anyway.
 	//dtLink* links = dtGetThenAdvanceBufferPointer<dtLink>(d, linksSize);
 	dtPolyDetail* detailMeshes = dtGetThenAdvanceBufferPointer<dtPolyDetail>(d, detailMeshesSize);
-	float* detailVerts = dtGetThenAdvanceBufferPointer<float>(d, detailVertsSize);
+	unsigned char* detailVertsData = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailVertsSize);
 	d += detailTrisSize; // Ignore detail tris; single bytes can't be endian-swapped.
 	//unsigned char* detailTris = dtGetThenAdvanceBufferPointer<unsigned char>(d, detailTrisSize);
-	dtBVNode* bvTree = dtGetThenAdvanceBufferPointer<dtBVNode>(d, bvtreeSize);
+	unsigned char* bvTreeData = dtGetThenAdvanceBufferPointer<unsigned char>(d, bvtreeSize);
 	dtOffMeshConnection* offMeshCons = dtGetThenAdvanceBufferPointer<dtOffMeshConnection>(d, offMeshLinksSize);
+	dtPolyDetailGrid* detailGrids = dtGetThenAdvanceBufferPointer<dtPolyDetailGrid>(d, detailGridsSize);
+	unsigned short* detailGridCells = dtGetThenAdvanceBufferPointer<unsigned short>(d, detailGridCellsSize);
+	// Ignore the grid triangles; single bytes can't be endian-swapped.
 	
 	// Vertices
-	for (int i = 0; i < header->vertCount*3; ++i)
+	unsigned short* quantVerts = (unsigned short*)vertsData;
+	for (int i = 0; i < quantVertCount*3; ++i)
+	{
+		dtSwapEndian(&quantVerts[i]);
+	}
+	float* verts = (float*)(vertsData + offMeshVertsOffset);
+	for (int i = 0; i < (header->vertCount - quantVertCount)*3; ++i)
 	{
 		dtSwapEndian(&verts[i]);
 	}
@@ -783,18 +1304,36 @@ bool dtNavMeshDataSwapEndian(unsigned char* data, const int /*dataSize*/)
 		dtPolyDetail* pd = &detailMeshes[i];
 		dtSwapEndian(&pd->vertBase);
 		dtSwapEndian(&pd->triBase);
+		dtSwapEndian(&pd->grid);
 	}
 	
 	// Detail verts
 	for (int i = 0; i < header->detailVertCount*3; ++i)
 	{
-		dtSwapEndian(&detailVerts[i]);
+		if (quantized)
+			dtSwapEndian(&((unsigned short*)detailVertsData)[i]);
+		else
+			dtSwapEndian(&((float*)detailVertsData)[i]);
 	}
 
 	// BV-tree
 	for (int i = 0; i < header->bvNodeCount; ++i)
 	{
-		dtBVNode* node = &bvTree[i];
+		if (wideBvTree)
+		{
+			dtBVWideNode* node = &((dtBVWideNode*)bvTreeData)[i];
+			for (int k = 0; k < DT_BVWIDE_WIDTH; ++k)
+			{
+				for (int j = 0; j < 3; ++j)
+				{
+					dtSwapEndian(&node->bmin[j][k]);
+					dtSwapEndian(&node->bmax[j][k]);
+				}
+				dtSwapEndian(&node->child[k]);
+			}
+			continue;
+		}
+		dtBVNode* node = &((dtBVNode*)bvTreeData)[i];
 		for (int j = 0; j < 3; ++j)
 		{
 			dtSwapEndian(&node->bmin[j]);
@@ -812,6 +1351,21 @@ bool dtNavMeshDataSwapEndian(unsigned char* data, const int /*dataSize*/)
 		dtSwapEndian(&con->rad);
 		dtSwapEndian(&con->poly);
 	}
+
+	// Detail mesh grids.
+	for (int i = 0; i < header->detailGridCount; ++i)
+	{
+		dtPolyDetailGrid* grid = &detailGrids[i];
+		for (int j = 0; j < 2; ++j)
+		{
+			dtSwapEndian(&grid->bmin[j]);
+			dtSwapEndian(&grid->invCellSize[j]);
+		}
+		dtSwapEndian(&grid->cellBase);
+		dtSwapEndian(&grid->triBase);
+	}
+	for (int i = 0; i < header->detailGridCellCount; ++i)
+		dtSwapEndian(&detailGridCells[i]);
 	
 	return true;
 }
@@ -0,0 +1,187 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourNavMeshFlowField.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include <string.h>
+#include <new>
+
+dtNavMeshFlowField* dtAllocNavMeshFlowField()
+{
+	void* mem = dtAlloc(sizeof(dtNavMeshFlowField), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtNavMeshFlowField;
+}
+
+void dtFreeNavMeshFlowField(dtNavMeshFlowField* field)
+{
+	if (!field) return;
+	field->~dtNavMeshFlowField();
+	dtFree(field);
+}
+
+dtNavMeshFlowField::dtNavMeshFlowField() :
+	m_nav(0),
+	m_filter(0),
+	m_goalRef(0),
+	m_tiles(0),
+	m_maxTiles(0)
+{
+	memset(m_goalPos, 0, sizeof(m_goalPos));
+}
+
+dtNavMeshFlowField::~dtNavMeshFlowField()
+{
+	destroy();
+}
+
+void dtNavMeshFlowField::destroy()
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		dtFree(m_tiles[i].costs);
+		dtFree(m_tiles[i].next);
+	}
+	dtFree(m_tiles);
+	m_tiles = 0;
+	m_maxTiles = 0;
+	m_nav = 0;
+	m_filter = 0;
+	m_goalRef = 0;
+	memset(m_goalPos, 0, sizeof(m_goalPos));
+}
+
+dtStatus dtNavMeshFlowField::init(const dtNavMesh* nav)
+{
+	if (!nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	destroy();
+
+	m_tiles = (TileField*)dtAlloc(sizeof(TileField)*nav->getMaxTiles(), DT_ALLOC_PERM);
+	if (!m_tiles)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_tiles, 0, sizeof(TileField)*nav->getMaxTiles());
+
+	m_nav = nav;
+	m_maxTiles = nav->getMaxTiles();
+
+	return DT_SUCCESS;
+}
+
+void dtNavMeshFlowField::invalidatePoly(dtPolyRef ref)
+{
+	if (!m_nav)
+		return;
+	const unsigned int it = m_nav->decodePolyIdTile(ref);
+	if (it < (unsigned int)m_maxTiles)
+		m_tiles[it].dirty = true;
+}
+
+bool dtNavMeshFlowField::syncTiles()
+{
+	bool outOfMemory = false;
+
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const dtMeshHeader* header = m_nav->getTileHeader(i);
+		const unsigned int salt = m_nav->getTileSalt(i);
+		const int polyCount = header ? header->polyCount : 0;
+		TileField& tf = m_tiles[i];
+		if (!tf.dirty && tf.salt == salt && tf.polyCount == polyCount)
+			continue;
+
+		if (tf.salt != salt || tf.polyCount != polyCount)
+		{
+			dtFree(tf.costs);
+			dtFree(tf.next);
+			tf.costs = 0;
+			tf.next = 0;
+			tf.salt = salt;
+			tf.polyCount = 0;
+			if (polyCount)
+			{
+				tf.costs = (float*)dtAlloc(sizeof(float)*polyCount, DT_ALLOC_PERM);
+				tf.next = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*polyCount, DT_ALLOC_PERM);
+				if (!tf.costs || !tf.next)
+				{
+					dtFree(tf.costs);
+					dtFree(tf.next);
+					tf.costs = 0;
+					tf.next = 0;
+					tf.dirty = true;
+					outOfMemory = true;
+					continue;
+				}
+				tf.polyCount = polyCount;
+			}
+		}
+
+		for (int j = 0; j < tf.polyCount; ++j)
+		{
+			tf.costs[j] = FLT_MAX;
+			tf.next[j] = 0;
+		}
+		tf.dirty = tf.polyCount > 0;
+	}
+
+	return !outOfMemory;
+}
+
+/// @par
+///
+/// The path is found in O(path length), without searching. It is the path of the last
+/// update of the field, tiles changed since then are not followed.
+dtStatus dtNavMeshFlowField::getPath(dtPolyRef startRef, dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	if (!pathCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*pathCount = 0;
+
+	if (!m_nav || !path || maxPath <= 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	if (getCost(startRef) == FLT_MAX)
+		return DT_FAILURE;
+
+	int n = 0;
+	dtPolyRef ref = startRef;
+	while (ref != m_goalRef)
+	{
+		if (n >= maxPath)
+		{
+			*pathCount = n;
+			return DT_SUCCESS | DT_BUFFER_TOO_SMALL;
+		}
+		path[n++] = ref;
+		ref = getNextRef(ref);
+		if (!ref)
+			return DT_FAILURE;
+	}
+	if (n >= maxPath)
+	{
+		*pathCount = n;
+		return DT_SUCCESS | DT_BUFFER_TOO_SMALL;
+	}
+	path[n++] = ref;
+	*pathCount = n;
+
+	return DT_SUCCESS;
+}
@@ -0,0 +1,415 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourNavMeshIslands.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include "DetourCommon.h"
+#include <string.h>
+#include <new>
+
+dtNavMeshIslands* dtAllocNavMeshIslands()
+{
+	void* mem = dtAlloc(sizeof(dtNavMeshIslands), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtNavMeshIslands;
+}
+
+void dtFreeNavMeshIslands(dtNavMeshIslands* islands)
+{
+	if (!islands) return;
+	islands->~dtNavMeshIslands();
+	dtFree(islands);
+}
+
+dtNavMeshIslands::dtNavMeshIslands() :
+	m_nav(0),
+	m_flagSetCount(0),
+	m_tiles(0),
+	m_maxTiles(0),
+	m_parents(0),
+	m_labelCount(0),
+	m_maxLabels(0),
+	m_tileGeneration(0),
+	m_invalidated(true)
+{
+	memset(m_flagSets, 0, sizeof(m_flagSets));
+}
+
+dtNavMeshIslands::~dtNavMeshIslands()
+{
+	destroy();
+}
+
+void dtNavMeshIslands::destroy()
+{
+	freeLabels();
+	dtFree(m_tiles);
+	m_tiles = 0;
+	m_maxTiles = 0;
+	m_flagSetCount = 0;
+	m_nav = 0;
+}
+
+void dtNavMeshIslands::freeLabels()
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		dtFree(m_tiles[i].labels);
+		memset(&m_tiles[i], 0, sizeof(TileIslands));
+		m_tiles[i].dirty = true;
+	}
+	dtFree(m_parents);
+	m_parents = 0;
+	m_labelCount = 0;
+	m_maxLabels = 0;
+	m_invalidated = true;
+}
+
+dtStatus dtNavMeshIslands::init(const dtNavMesh* nav)
+{
+	if (!nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	destroy();
+
+	m_tiles = (TileIslands*)dtAlloc(sizeof(TileIslands)*nav->getMaxTiles(), DT_ALLOC_PERM);
+	if (!m_tiles)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_nav = nav;
+	m_maxTiles = nav->getMaxTiles();
+	memset(m_tiles, 0, sizeof(TileIslands)*m_maxTiles);
+	freeLabels();
+
+	return DT_SUCCESS;
+}
+
+int dtNavMeshIslands::addFlagSet(const unsigned short includeFlags, const unsigned short excludeFlags)
+{
+	const int index = findFlagSet(includeFlags, excludeFlags);
+	if (index >= 0)
+		return index;
+	if (m_flagSetCount >= DT_MAX_ISLAND_FLAG_SETS)
+		return -1;
+
+	m_flagSets[m_flagSetCount].includeFlags = includeFlags;
+	m_flagSets[m_flagSetCount].excludeFlags = excludeFlags;
+	m_flagSetCount++;
+
+	// The labels of every polygon change size, search everything again.
+	freeLabels();
+
+	return m_flagSetCount-1;
+}
+
+int dtNavMeshIslands::findFlagSet(const unsigned short includeFlags, const unsigned short excludeFlags) const
+{
+	for (int i = 0; i < m_flagSetCount; ++i)
+	{
+		if (m_flagSets[i].includeFlags == includeFlags && m_flagSets[i].excludeFlags == excludeFlags)
+			return i;
+	}
+	return -1;
+}
+
+void dtNavMeshIslands::invalidatePoly(dtPolyRef ref)
+{
+	if (!m_nav)
+		return;
+	const unsigned int it = m_nav->decodePolyIdTile(ref);
+	if (it < (unsigned int)m_maxTiles)
+	{
+		m_tiles[it].dirty = true;
+		m_invalidated = true;
+	}
+}
+
+void dtNavMeshIslands::invalidate()
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+		m_tiles[i].dirty = true;
+	m_invalidated = true;
+}
+
+unsigned int dtNavMeshIslands::findRoot(unsigned int label)
+{
+	while (m_parents[label] != label)
+	{
+		m_parents[label] = m_parents[m_parents[label]];
+		label = m_parents[label];
+	}
+	return label;
+}
+
+bool dtNavMeshIslands::reserveLabels(const int count)
+{
+	if (m_labelCount + count <= m_maxLabels)
+		return true;
+
+	const int maxLabels = dtMax(m_labelCount + count, m_maxLabels*2);
+	unsigned int* parents = (unsigned int*)dtAlloc(sizeof(unsigned int)*maxLabels, DT_ALLOC_PERM);
+	if (!parents)
+		return false;
+	if (m_labelCount)
+		memcpy(parents, m_parents, sizeof(unsigned int)*m_labelCount);
+	dtFree(m_parents);
+	m_parents = parents;
+	m_maxLabels = maxLabels;
+
+	return true;
+}
+
+bool dtNavMeshIslands::isUpToDate() const
+{
+	return m_nav && !m_invalidated && m_tileGeneration == m_nav->getTileGeneration();
+}
+
+/// @par
+///
+/// Call this after adding or removing tiles, and after invalidating polygons. The tiles
+/// that changed get new labels, and so do the polygons of the islands that touched them,
+/// as the islands may have been split. The labels are then joined across the links of
+/// these tiles and of the tiles around them.
+dtStatus dtNavMeshIslands::update()
+{
+	if (!m_nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!m_flagSetCount || isUpToDate())
+		return DT_SUCCESS;
+
+	const int stride = m_flagSetCount;
+	const unsigned int tileGeneration = m_nav->getTileGeneration();
+
+	// The islands that touch the changed tiles.
+	unsigned char* dirtyIslands = 0;
+	if (m_labelCount > 0)
+	{
+		dirtyIslands = (unsigned char*)dtAlloc(m_labelCount, DT_ALLOC_TEMP);
+		if (!dirtyIslands)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		memset(dirtyIslands, 0, m_labelCount);
+	}
+
+	bool outOfMemory = false;
+	bool anyDirtyIslands = false;
+	int totalPolys = 0;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const dtMeshTile* tile = m_nav->peekTile(i);
+		const int polyCount = tile->header ? tile->header->polyCount : 0;
+		totalPolys += polyCount;
+		TileIslands& ti = m_tiles[i];
+		if (!ti.dirty && ti.salt == tile->salt && ti.polyCount == polyCount)
+			continue;
+
+		for (int j = 0; j < ti.polyCount*stride; ++j)
+		{
+			const unsigned int label = ti.labels[j];
+			if (label != 0 && label != UNSET_LABEL)
+			{
+				dirtyIslands[m_parents[label]] = 1;
+				anyDirtyIslands = true;
+			}
+		}
+
+		if (ti.salt != tile->salt || ti.polyCount != polyCount)
+		{
+			dtFree(ti.labels);
+			ti.labels = 0;
+			ti.salt = tile->salt;
+			ti.polyCount = 0;
+			if (polyCount)
+			{
+				ti.labels = (unsigned int*)dtAlloc(sizeof(unsigned int)*polyCount*stride, DT_ALLOC_PERM);
+				if (!ti.labels)
+				{
+					ti.dirty = true;
+					outOfMemory = true;
+					continue;
+				}
+				ti.polyCount = polyCount;
+			}
+		}
+		for (int j = 0; j < ti.polyCount*stride; ++j)
+			ti.labels[j] = UNSET_LABEL;
+		ti.dirty = ti.polyCount > 0;
+	}
+
+	// The islands touching the changed tiles may have split, search them again.
+	if (anyDirtyIslands)
+	{
+		for (int i = 0; i < m_maxTiles; ++i)
+		{
+			TileIslands& ti = m_tiles[i];
+			if (ti.dirty)
+				continue;
+			for (int j = 0; j < ti.polyCount*stride; ++j)
+			{
+				const unsigned int label = ti.labels[j];
+				if (label != 0 && label != UNSET_LABEL && dirtyIslands[m_parents[label]])
+				{
+					ti.labels[j] = UNSET_LABEL;
+					ti.dirty = true;
+				}
+			}
+		}
+	}
+	dtFree(dirtyIslands);
+
+	if (outOfMemory)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+	// The labels of the islands searched again are not used anymore. Start over when
+	// they outnumber the polygons.
+	int newLabels = 0;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (m_tiles[i].dirty)
+			newLabels += m_tiles[i].polyCount*stride;
+	}
+	if (m_labelCount + newLabels > 2*totalPolys*stride + 1)
+	{
+		for (int i = 0; i < m_maxTiles; ++i)
+		{
+			TileIslands& ti = m_tiles[i];
+			for (int j = 0; j < ti.polyCount*stride; ++j)
+				ti.labels[j] = UNSET_LABEL;
+			ti.dirty = ti.polyCount > 0;
+		}
+		m_labelCount = 0;
+		newLabels = totalPolys*stride;
+	}
+	if (!m_labelCount)
+		newLabels++;
+	if (!reserveLabels(newLabels))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	if (!m_labelCount)
+	{
+		m_parents[0] = 0;
+		m_labelCount = 1;
+	}
+
+	// Give each polygon passing the flags a label of its own.
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		TileIslands& ti = m_tiles[i];
+		if (!ti.dirty)
+			continue;
+		const dtMeshTile* tile = m_nav->peekTile(i);
+		if (!m_nav->useTile(tile))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		for (int j = 0; j < ti.polyCount; ++j)
+		{
+			const unsigned short flags = tile->polys[j].flags;
+			for (int k = 0; k < stride; ++k)
+			{
+				unsigned int& label = ti.labels[j*stride + k];
+				if (label != UNSET_LABEL)
+					continue;
+				if ((flags & m_flagSets[k].includeFlags) != 0 && (flags & m_flagSets[k].excludeFlags) == 0)
+				{
+					label = (unsigned int)m_labelCount++;
+					m_parents[label] = label;
+				}
+				else
+				{
+					label = 0;
+				}
+			}
+		}
+	}
+
+	// The changed labels are linked from the tiles themselves and from the tiles around them.
+	// (See: dtNavMesh::connectExtOffMeshLinks)
+	unsigned char* scan = (unsigned char*)dtAlloc(m_maxTiles, DT_ALLOC_TEMP);
+	if (!scan)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(scan, 0, m_maxTiles);
+	static const int MAX_NEIS = 32;
+	dtMeshTile* neis[MAX_NEIS];	// Found without marking the tiles used.
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		if (!m_tiles[i].dirty)
+			continue;
+		const dtMeshTile* tile = m_nav->peekTile(i);
+		for (int y = tile->header->y - 1; y <= tile->header->y + 1; ++y)
+		{
+			for (int x = tile->header->x - 1; x <= tile->header->x + 1; ++x)
+			{
+				const int nneis = m_nav->getTilesAt(x, y, neis, MAX_NEIS);
+				for (int j = 0; j < nneis; ++j)
+					scan[m_nav->decodePolyIdTile(m_nav->getPolyRefBase(neis[j]))] = 1;
+			}
+		}
+	}
+
+	// Join the labels of linked polygons.
+	dtStatus status = DT_SUCCESS;
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const TileIslands& ti = m_tiles[i];
+		if (!scan[i] || !ti.polyCount)
+			continue;
+		const dtMeshTile* tile = m_nav->peekTile(i);
+		if (!m_nav->useTile(tile))
+		{
+			status = DT_FAILURE | DT_OUT_OF_MEMORY;
+			break;
+		}
+		for (int j = 0; j < ti.polyCount; ++j)
+		{
+			for (unsigned int k = tile->polys[j].firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				unsigned int salt, it, ip;
+				m_nav->decodePolyId(tile->links[k].ref, salt, it, ip);
+				const TileIslands& nti = m_tiles[it];
+				if (nti.salt != salt || ip >= (unsigned int)nti.polyCount)
+					continue;
+				for (int l = 0; l < stride; ++l)
+				{
+					const unsigned int a = ti.labels[j*stride + l];
+					const unsigned int b = nti.labels[ip*stride + l];
+					if (!a || !b)
+						continue;
+					// The smaller label is the root, so the parents come before their children.
+					const unsigned int ra = findRoot(a);
+					const unsigned int rb = findRoot(b);
+					if (ra < rb)
+						m_parents[rb] = ra;
+					else if (rb < ra)
+						m_parents[ra] = rb;
+				}
+			}
+		}
+	}
+	dtFree(scan);
+
+	if (dtStatusFailed(status))
+		return status;
+
+	// Point every label at its root.
+	for (int i = 1; i < m_labelCount; ++i)
+		m_parents[i] = m_parents[m_parents[i]];
+
+	for (int i = 0; i < m_maxTiles; ++i)
+		m_tiles[i].dirty = false;
+	m_tileGeneration = tileGeneration;
+	m_invalidated = false;
+
+	return DT_SUCCESS;
+}
@@ -0,0 +1,131 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourNavMeshLandmarks.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include <string.h>
+#include <new>
+
+dtNavMeshLandmarks* dtAllocNavMeshLandmarks()
+{
+	void* mem = dtAlloc(sizeof(dtNavMeshLandmarks), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtNavMeshLandmarks;
+}
+
+void dtFreeNavMeshLandmarks(dtNavMeshLandmarks* landmarks)
+{
+	if (!landmarks) return;
+	landmarks->~dtNavMeshLandmarks();
+	dtFree(landmarks);
+}
+
+dtNavMeshLandmarks::dtNavMeshLandmarks() :
+	m_nav(0),
+	m_maxLandmarks(0),
+	m_upToDateMask(0),
+	m_filterKey(0),
+	m_tiles(0),
+	m_maxTiles(0)
+{
+	memset(m_landmarks, 0, sizeof(m_landmarks));
+}
+
+dtNavMeshLandmarks::~dtNavMeshLandmarks()
+{
+	destroy();
+}
+
+void dtNavMeshLandmarks::destroy()
+{
+	for (int i = 0; i < m_maxTiles; ++i)
+		dtFree(m_tiles[i].costs);
+	dtFree(m_tiles);
+	m_tiles = 0;
+	m_maxTiles = 0;
+	m_maxLandmarks = 0;
+	m_upToDateMask = 0;
+	m_filterKey = 0;
+	m_nav = 0;
+	memset(m_landmarks, 0, sizeof(m_landmarks));
+}
+
+dtStatus dtNavMeshLandmarks::init(const dtNavMesh* nav, const int maxLandmarks)
+{
+	if (!nav || maxLandmarks <= 0 || maxLandmarks > DT_MAX_LANDMARKS)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	destroy();
+
+	m_tiles = (TileCosts*)dtAlloc(sizeof(TileCosts)*nav->getMaxTiles(), DT_ALLOC_PERM);
+	if (!m_tiles)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_tiles, 0, sizeof(TileCosts)*nav->getMaxTiles());
+
+	m_nav = nav;
+	m_maxTiles = nav->getMaxTiles();
+	m_maxLandmarks = maxLandmarks;
+
+	return DT_SUCCESS;
+}
+
+void dtNavMeshLandmarks::invalidate()
+{
+	m_upToDateMask = 0;
+}
+
+bool dtNavMeshLandmarks::syncTiles(bool& outOfMemory)
+{
+	bool changed = false;
+	outOfMemory = false;
+
+	for (int i = 0; i < m_maxTiles; ++i)
+	{
+		const dtMeshHeader* header = m_nav->getTileHeader(i);
+		const unsigned int salt = m_nav->getTileSalt(i);
+		const int polyCount = header ? header->polyCount : 0;
+		TileCosts& tc = m_tiles[i];
+		if (tc.salt == salt && tc.polyCount == polyCount)
+			continue;
+
+		changed = true;
+		dtFree(tc.costs);
+		tc.costs = 0;
+		tc.salt = salt;
+		tc.polyCount = 0;
+		if (!polyCount)
+			continue;
+
+		const int n = polyCount*m_maxLandmarks;
+		tc.costs = (float*)dtAlloc(sizeof(float)*n, DT_ALLOC_PERM);
+		if (!tc.costs)
+		{
+			outOfMemory = true;
+			continue;
+		}
+		for (int j = 0; j < n; ++j)
+			tc.costs[j] = FLT_MAX;
+		tc.polyCount = polyCount;
+	}
+
+	if (changed)
+		m_upToDateMask = 0;
+
+	return changed;
+}
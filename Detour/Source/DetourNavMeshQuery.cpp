@@ -83,25 +83,31 @@ float dtQueryFilter::getCost(const float* pa, const float* pb,
 {
 	return dtVdist(pa, pb) * m_areaCost[curPoly->getArea()];
 }
-#else
-inline bool dtQueryFilter::passFilter(const dtPolyRef /*ref*/,
-									  const dtMeshTile* /*tile*/,
-									  const dtPoly* poly) const
+#endif
+
+// FNV-1a.
+static unsigned int hashFilterBytes(const void* data, const size_t size, unsigned int hash)
 {
-	return (poly->flags & m_includeFlags) != 0 && (poly->flags & m_excludeFlags) == 0;
+	const unsigned char* p = (const unsigned char*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash ^= p[i];
+		hash *= 16777619u;
+	}
+	return hash;
 }
 
-inline float dtQueryFilter::getCost(const float* pa, const float* pb,
-									const dtPolyRef /*prevRef*/, const dtMeshTile* /*prevTile*/, const dtPoly* /*prevPoly*/,
-									const dtPolyRef /*curRef*/, const dtMeshTile* /*curTile*/, const dtPoly* curPoly,
-									const dtPolyRef /*nextRef*/, const dtMeshTile* /*nextTile*/, const dtPoly* /*nextPoly*/) const
+unsigned int dtGetQueryFilterKey(const dtQueryFilter* filter)
 {
-	return dtVdist(pa, pb) * m_areaCost[curPoly->getArea()];
+	const unsigned short flags[2] = { filter->getIncludeFlags(), filter->getExcludeFlags() };
+	unsigned int hash = hashFilterBytes(flags, sizeof(flags), 2166136261u);
+	for (int i = 0; i < DT_MAX_AREAS; ++i)
+	{
+		const float cost = filter->getAreaCost(i);
+		hash = hashFilterBytes(&cost, sizeof(cost), hash);
+	}
+	return hash;
 }
-#endif	
-	
-static const float H_SCALE = 0.999f; // Search heuristic scale.
-
 
 dtNavMeshQuery* dtAllocNavMeshQuery()
 {
@@ -117,6 +123,86 @@ void dtFreeNavMeshQuery(dtNavMeshQuery* navmesh)
 	dtFree(navmesh);
 }
 
+dtSlicedSearch* dtAllocSlicedSearch()
+{
+	void* mem = dtAlloc(sizeof(dtSlicedSearch), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtSlicedSearch;
+}
+
+void dtFreeSlicedSearch(dtSlicedSearch* search)
+{
+	if (!search) return;
+	search->~dtSlicedSearch();
+	dtFree(search);
+}
+
+dtSlicedSearch::dtSlicedSearch() :
+	m_nodePool(0),
+	m_openList(0),
+	m_stats(0)
+{
+	memset(&m_query, 0, sizeof(dtQueryData));
+}
+
+dtSlicedSearch::~dtSlicedSearch()
+{
+	if (m_nodePool)
+		m_nodePool->~dtNodePool();
+	if (m_openList)
+		m_openList->~dtNodeQueue();
+	dtFree(m_nodePool);
+	dtFree(m_openList);
+}
+
+/// @par
+///
+/// The pool and the open list are reused if they are large enough. Any search in
+/// progress is discarded.
+dtStatus dtSlicedSearch::init(const int maxNodes)
+{
+	if (maxNodes <= 0 || maxNodes > DT_NULL_IDX || maxNodes > (1 << DT_NODE_PARENT_BITS) - 1)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	memset(&m_query, 0, sizeof(dtQueryData));
+
+	if (!m_nodePool || m_nodePool->getMaxNodes() < maxNodes)
+	{
+		if (m_nodePool)
+		{
+			m_nodePool->~dtNodePool();
+			dtFree(m_nodePool);
+			m_nodePool = 0;
+		}
+		m_nodePool = new (dtAlloc(sizeof(dtNodePool), DT_ALLOC_PERM)) dtNodePool(maxNodes, dtNextPow2(maxNodes/4));
+		if (!m_nodePool)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	else
+	{
+		m_nodePool->clear();
+	}
+
+	if (!m_openList || m_openList->getCapacity() < maxNodes)
+	{
+		if (m_openList)
+		{
+			m_openList->~dtNodeQueue();
+			dtFree(m_openList);
+			m_openList = 0;
+		}
+		m_openList = new (dtAlloc(sizeof(dtNodeQueue), DT_ALLOC_PERM)) dtNodeQueue(maxNodes);
+		if (!m_openList)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	else
+	{
+		m_openList->clear();
+	}
+
+	return DT_SUCCESS;
+}
+
 //////////////////////////////////////////////////////////////////////////////////////////
 
 /// @class dtNavMeshQuery
@@ -139,7 +225,10 @@ dtNavMeshQuery::dtNavMeshQuery() :
 	m_nav(0),
 	m_tinyNodePool(0),
 	m_nodePool(0),
-	m_openList(0)
+	m_openList(0),
+	m_landmarks(0),
+	m_islands(0),
+	m_stats(0)
 {
 	memset(&m_query, 0, sizeof(dtQueryData));
 }
@@ -163,12 +252,20 @@ dtNavMeshQuery::~dtNavMeshQuery()
 /// functions are used.
 ///
 /// This function can be used multiple times.
-dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes)
+dtStatus dtNavMeshQuery::init(const dtNavMesh* nav, const int maxNodes, const int statsConfig)
 {
 	if (maxNodes > DT_NULL_IDX || maxNodes > (1 << DT_NODE_PARENT_BITS) - 1)
 		return DT_FAILURE | DT_INVALID_PARAM;
+	// The searches compiled with the caller would not match the ones of the library.
+	if (statsConfig != DT_QUERY_STATS_CONFIG)
+		return DT_FAILURE | DT_WRONG_VERSION;
 
 	m_nav = nav;
+
+	if (m_landmarks && m_landmarks->getNavMesh() != nav)
+		m_landmarks = 0;
+	if (m_islands && m_islands->getNavMesh() != nav)
+		m_islands = 0;
 	
 	if (!m_nodePool || m_nodePool->getMaxNodes() < maxNodes)
 	{
@@ -231,7 +328,7 @@ dtStatus dtNavMeshQuery::findRandomPoint(const dtQueryFilter* filter, float (*fr
 	float tsum = 0.0f;
 	for (int i = 0; i < m_nav->getMaxTiles(); i++)
 	{
-		const dtMeshTile* t = m_nav->getTile(i);
+		const dtMeshTile* t = m_nav->peekTile(i);
 		if (!t || !t->header) continue;
 		
 		// Choose random tile using reservoi sampling.
@@ -243,6 +340,8 @@ dtStatus dtNavMeshQuery::findRandomPoint(const dtQueryFilter* filter, float (*fr
 	}
 	if (!tile)
 		return DT_FAILURE;
+	if (!m_nav->useTile(tile))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 
 	// Randomly pick one polygon weighted by polygon area.
 	const dtPoly* poly = 0;
@@ -265,9 +364,10 @@ dtStatus dtNavMeshQuery::findRandomPoint(const dtQueryFilter* filter, float (*fr
 		float polyArea = 0.0f;
 		for (int j = 2; j < p->vertCount; ++j)
 		{
-			const float* va = &tile->verts[p->verts[0]*3];
-			const float* vb = &tile->verts[p->verts[j-1]*3];
-			const float* vc = &tile->verts[p->verts[j]*3];
+			float ta[3], tb[3], tc[3];
+			const float* va = tile->getVert(p->verts[0], ta);
+			const float* vb = tile->getVert(p->verts[j-1], tb);
+			const float* vc = tile->getVert(p->verts[j], tc);
 			polyArea += dtTriArea2D(va,vb,vc);
 		}
 
@@ -285,15 +385,10 @@ dtStatus dtNavMeshQuery::findRandomPoint(const dtQueryFilter* filter, float (*fr
 		return DT_FAILURE;
 
 	// Randomly pick point on polygon.
-	const float* v = &tile->verts[poly->verts[0]*3];
 	float verts[3*DT_VERTS_PER_POLYGON];
 	float areas[DT_VERTS_PER_POLYGON];
-	dtVcopy(&verts[0*3],v);
-	for (int j = 1; j < poly->vertCount; ++j)
-	{
-		v = &tile->verts[poly->verts[j]*3];
-		dtVcopy(&verts[j*3],v);
-	}
+	for (int j = 0; j < poly->vertCount; ++j)
+		dtVcopy(&verts[j*3], tile->getVert(poly->verts[j], &verts[j*3]));
 	
 	const float s = frand();
 	const float t = frand();
@@ -332,7 +427,8 @@ dtStatus dtNavMeshQuery::findRandomPointAroundCircle(dtPolyRef startRef, const f
 	
 	const dtMeshTile* startTile = 0;
 	const dtPoly* startPoly = 0;
-	m_nav->getTileAndPolyByRefUnsafe(startRef, &startTile, &startPoly);
+	if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(startRef, &startTile, &startPoly)))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 	if (!filter->passFilter(startRef, startTile, startPoly))
 		return DT_FAILURE | DT_INVALID_PARAM;
 	
@@ -368,7 +464,8 @@ dtStatus dtNavMeshQuery::findRandomPointAroundCircle(dtPolyRef startRef, const f
 		const dtPolyRef bestRef = bestNode->id;
 		const dtMeshTile* bestTile = 0;
 		const dtPoly* bestPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
+		if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
 
 		// Place random locations on on ground.
 		if (bestPoly->getType() == DT_POLYTYPE_GROUND)
@@ -377,9 +474,10 @@ dtStatus dtNavMeshQuery::findRandomPointAroundCircle(dtPolyRef startRef, const f
 			float polyArea = 0.0f;
 			for (int j = 2; j < bestPoly->vertCount; ++j)
 			{
-				const float* va = &bestTile->verts[bestPoly->verts[0]*3];
-				const float* vb = &bestTile->verts[bestPoly->verts[j-1]*3];
-				const float* vc = &bestTile->verts[bestPoly->verts[j]*3];
+				float ta[3], tb[3], tc[3];
+				const float* va = bestTile->getVert(bestPoly->verts[0], ta);
+				const float* vb = bestTile->getVert(bestPoly->verts[j-1], tb);
+				const float* vc = bestTile->getVert(bestPoly->verts[j], tc);
 				polyArea += dtTriArea2D(va,vb,vc);
 			}
 			// Choose random polygon weighted by area, using reservoi sampling.
@@ -400,8 +498,8 @@ dtStatus dtNavMeshQuery::findRandomPointAroundCircle(dtPolyRef startRef, const f
 		const dtPoly* parentPoly = 0;
 		if (bestNode->pidx)
 			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
-		if (parentRef)
-			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
+		if (parentRef && dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
 		
 		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
 		{
@@ -414,7 +512,8 @@ dtStatus dtNavMeshQuery::findRandomPointAroundCircle(dtPolyRef startRef, const f
 			// Expand to neighbour
 			const dtMeshTile* neighbourTile = 0;
 			const dtPoly* neighbourPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+			if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly)))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
 			
 			// Do not advance if the polygon is excluded by the filter.
 			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
@@ -472,15 +571,10 @@ dtStatus dtNavMeshQuery::findRandomPointAroundCircle(dtPolyRef startRef, const f
 		return DT_FAILURE;
 	
 	// Randomly pick point on polygon.
-	const float* v = &randomTile->verts[randomPoly->verts[0]*3];
 	float verts[3*DT_VERTS_PER_POLYGON];
 	float areas[DT_VERTS_PER_POLYGON];
-	dtVcopy(&verts[0*3],v);
-	for (int j = 1; j < randomPoly->vertCount; ++j)
-	{
-		v = &randomTile->verts[randomPoly->verts[j]*3];
-		dtVcopy(&verts[j*3],v);
-	}
+	for (int j = 0; j < randomPoly->vertCount; ++j)
+		dtVcopy(&verts[j*3], randomTile->getVert(randomPoly->verts[j], &verts[j*3]));
 	
 	const float s = frand();
 	const float t = frand();
@@ -555,7 +649,7 @@ dtStatus dtNavMeshQuery::closestPointOnPolyBoundary(dtPolyRef ref, const float*
 	int nv = 0;
 	for (int i = 0; i < (int)poly->vertCount; ++i)
 	{
-		dtVcopy(&verts[nv*3], &tile->verts[poly->verts[i]*3]);
+		dtVcopy(&verts[nv*3], tile->getVert(poly->verts[i], &verts[nv*3]));
 		nv++;
 	}		
 	
@@ -608,8 +702,9 @@ dtStatus dtNavMeshQuery::getPolyHeight(dtPolyRef ref, const float* pos, float* h
 	// case it here.
 	if (poly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
 	{
-		const float* v0 = &tile->verts[poly->verts[0]*3];
-		const float* v1 = &tile->verts[poly->verts[1]*3];
+		float t0[3], t1[3];
+		const float* v0 = tile->getVert(poly->verts[0], t0);
+		const float* v1 = tile->getVert(poly->verts[1], t1);
 		float t;
 		dtDistancePtSegSqr2D(pos, v0, v1, t);
 		if (height)
@@ -626,6 +721,7 @@ dtStatus dtNavMeshQuery::getPolyHeight(dtPolyRef ref, const float* pos, float* h
 class dtFindNearestPolyQuery : public dtPolyQuery
 {
 	const dtNavMeshQuery* m_query;
+	dtScopedQueryStats& m_queryStats;
 	const float* m_center;
 	float m_nearestDistanceSqr;
 	dtPolyRef m_nearestRef;
@@ -633,8 +729,8 @@ class dtFindNearestPolyQuery : public dtPolyQuery
 	bool m_overPoly;
 
 public:
-	dtFindNearestPolyQuery(const dtNavMeshQuery* query, const float* center)
-		: m_query(query), m_center(center), m_nearestDistanceSqr(FLT_MAX), m_nearestRef(0), m_nearestPoint(), m_overPoly(false)
+	dtFindNearestPolyQuery(const dtNavMeshQuery* query, dtScopedQueryStats& queryStats, const float* center)
+		: m_query(query), m_queryStats(queryStats), m_center(center), m_nearestDistanceSqr(FLT_MAX), m_nearestRef(0), m_nearestPoint(), m_overPoly(false)
 	{
 	}
 
@@ -648,6 +744,8 @@ public:
 
 		for (int i = 0; i < count; ++i)
 		{
+			m_queryStats.expandNode(tile);
+
 			dtPolyRef ref = refs[i];
 			float closestPtPoly[3];
 			float diff[3];
@@ -701,12 +799,33 @@ dtStatus dtNavMeshQuery::findNearestPoly(const float* center, const float* halfE
 {
 	dtAssert(m_nav);
 
+	dtScopedQueryStats queryStats(m_stats);
+
 	if (!nearestRef)
 		return DT_FAILURE | DT_INVALID_PARAM;
 
+	// A point on the mesh is found in the polygon grids. Any polygon under the point within
+	// climb height is as near as a polygon can be.
+	float height;
+	if (center && dtVisfinite(center) && halfExtents && dtVisfinite(halfExtents) && filter)
+	{
+		const dtPolyRef ref = findPolyOverPoint(center, halfExtents[1], filter, &height, queryStats);
+		if (ref)
+		{
+			*nearestRef = ref;
+			if (nearestPt)
+			{
+				dtVset(nearestPt, center[0], height, center[2]);
+				if (isOverPoly)
+					*isOverPoly = true;
+			}
+			return DT_SUCCESS;
+		}
+	}
+
 	// queryPolygons below will check rest of params
 	
-	dtFindNearestPolyQuery query(this, center);
+	dtFindNearestPolyQuery query(this, queryStats, center);
 
 	dtStatus status = queryPolygons(center, halfExtents, filter, &query);
 	if (dtStatusFailed(status))
@@ -725,6 +844,89 @@ dtStatus dtNavMeshQuery::findNearestPoly(const float* center, const float* halfE
 	return DT_SUCCESS;
 }
 
+// Returns true if the point is on an edge of the polygon on the xz-plane, within a few float
+// ulps of its coordinates, where a search could find it as near as the polygon it is over.
+static bool isOnPolyEdge(const dtMeshTile* tile, const dtPoly* poly, const float* pos, const float epsSqr)
+{
+	for (int i = 0, j = (int)poly->vertCount-1; i < (int)poly->vertCount; j = i++)
+	{
+		float ta[3], tb[3];
+		const float* va = tile->getVert(poly->verts[j], ta);
+		const float* vb = tile->getVert(poly->verts[i], tb);
+		float t;
+		if (dtDistancePtSegSqr2D(pos, va, vb, t) <= epsSqr)
+			return true;
+	}
+	return false;
+}
+
+dtPolyRef dtNavMeshQuery::findPolyOverPoint(const float* pos, const float maxHeight, const dtQueryFilter* filter,
+											 float* height, dtScopedQueryStats& queryStats) const
+{
+	dtAssert(m_nav);
+	if (!(m_nav->m_params.polyGridCellSize > 0))
+		return 0;
+	const float cs = m_nav->m_params.polyGridCellSize;
+	const float ics = 1.0f / cs;
+	const float eps = 1e-6f * (dtAbs(pos[0]) + dtAbs(pos[2]) + 1.0f);
+
+	int tx, ty;
+	m_nav->calcTileLoc(pos, &tx, &ty);
+	static const int MAX_LAYERS = 32;
+	const dtMeshTile* tiles[MAX_LAYERS];
+	const int ntiles = m_nav->getTilesAt(tx, ty, tiles, MAX_LAYERS);
+
+	dtPolyRef found = 0;
+	for (int i = 0; i < ntiles; ++i)
+	{
+		const dtMeshTile* tile = tiles[i];
+		const float maxDiff = dtMin(maxHeight, tile->header->walkableClimb);
+		if (pos[1] < tile->header->bmin[1] - maxDiff || pos[1] > tile->header->bmax[1] + maxDiff)
+			continue;
+		if (!tile->polyGridCells)
+			return 0;
+		const float fx = (pos[0] - tile->header->bmin[0]) * ics;
+		const float fz = (pos[2] - tile->header->bmin[2]) * ics;
+		const int x = (int)dtMathFloorf(fx);
+		const int z = (int)dtMathFloorf(fz);
+		if (x < 0 || z < 0 || x >= tile->polyGridWidth || z >= tile->polyGridHeight)
+			continue;
+		// A polygon touching a point on a cell edge may only be listed in the next cell.
+		if ((fx - x)*cs <= eps || (x+1 - fx)*cs <= eps || (fz - z)*cs <= eps || (z+1 - fz)*cs <= eps)
+			return 0;
+
+		const dtPolyRef base = m_nav->getPolyRefBase(tile);
+		const int cell = x + z*tile->polyGridWidth;
+		for (unsigned int j = tile->polyGridCells[cell]; j < tile->polyGridCells[cell+1]; ++j)
+		{
+			const unsigned int ip = tile->polyGridPolys[j];
+			const dtPoly* poly = &tile->polys[ip];
+			const dtPolyRef ref = base | (dtPolyRef)ip;
+			if (!filter->passFilter(ref, tile, poly))
+				continue;
+			queryStats.expandNode(tile);
+			float h;
+			if (m_nav->getPolyHeight(tile, poly, pos, &h))
+			{
+				if (dtAbs(pos[1] - h) > maxDiff)
+					continue;
+				// The polygons are equally near, the BV tree search decides between them.
+				if (found)
+					return 0;
+				found = ref;
+				*height = h;
+			}
+			else if (isOnPolyEdge(tile, poly, pos, eps*eps))
+			{
+				// The point is on the edge of a polygon it is not over, which can be as near.
+				return 0;
+			}
+		}
+	}
+
+	return found;
+}
+
 void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qmin, const float* qmax,
 										 const dtQueryFilter* filter, dtPolyQuery* query) const
 {
@@ -734,10 +936,8 @@ void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qm
 	dtPoly* polys[batchSize];
 	int n = 0;
 
-	if (tile->bvTree)
+	if (tile->bvTree || tile->bvWideTree)
 	{
-		const dtBVNode* node = &tile->bvTree[0];
-		const dtBVNode* end = &tile->bvTree[tile->header->bvNodeCount];
 		const float* tbmin = tile->header->bmin;
 		const float* tbmax = tile->header->bmax;
 		const float qfac = tile->header->bvQuantFactor;
@@ -759,8 +959,56 @@ void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qm
 		bmax[1] = (unsigned short)(qfac * maxy + 1) | 1;
 		bmax[2] = (unsigned short)(qfac * maxz + 1) | 1;
 
-		// Traverse tree
 		const dtPolyRef base = m_nav->getPolyRefBase(tile);
+		
+		if (tile->bvWideTree)
+		{
+			// Traverse the wide tree, testing the children of a node together.
+			int stack[DT_BVWIDE_STACK_SIZE];
+			int nstack = 0;
+			stack[nstack++] = 0;
+			while (nstack > 0)
+			{
+				const dtBVWideNode* node = &tile->bvWideTree[stack[--nstack]];
+				const int mask = dtOverlapQuantBounds4(bmin, bmax, node->bmin[0], node->bmax[0]);
+				// Push in reverse, so that the subtrees are visited in order.
+				for (int i = DT_BVWIDE_WIDTH-1; i >= 0; --i)
+				{
+					if (!(mask & (1 << i)))
+						continue;
+					const int child = node->child[i];
+					if (child > 0)
+					{
+						if (nstack < DT_BVWIDE_STACK_SIZE)
+							stack[nstack++] = child;
+						continue;
+					}
+					if (child == 0)
+						continue;
+					
+					const dtPolyRef ref = base | (dtPolyRef)~child;
+					if (filter->passFilter(ref, tile, &tile->polys[~child]))
+					{
+						polyRefs[n] = ref;
+						polys[n] = &tile->polys[~child];
+						
+						if (n == batchSize - 1)
+						{
+							query->process(tile, polys, polyRefs, batchSize);
+							n = 0;
+						}
+						else
+						{
+							n++;
+						}
+					}
+				}
+			}
+		}
+		
+		// Traverse tree
+		const dtBVNode* node = tile->bvTree;
+		const dtBVNode* end = tile->bvTree ? &tile->bvTree[tile->header->bvNodeCount] : 0;
 		while (node < end)
 		{
 			const bool overlap = dtOverlapQuantBounds(bmin, bmax, node->bmin, node->bmax);
@@ -810,12 +1058,13 @@ void dtNavMeshQuery::queryPolygonsInTile(const dtMeshTile* tile, const float* qm
 			if (!filter->passFilter(ref, tile, p))
 				continue;
 			// Calc polygon bounds.
-			const float* v = &tile->verts[p->verts[0]*3];
+			float tmp[3];
+			const float* v = tile->getVert(p->verts[0], tmp);
 			dtVcopy(bmin, v);
 			dtVcopy(bmax, v);
 			for (int j = 1; j < p->vertCount; ++j)
 			{
-				v = &tile->verts[p->verts[j]*3];
+				v = tile->getVert(p->verts[j], tmp);
 				dtVmin(bmin, v);
 				dtVmax(bmax, v);
 			}
@@ -959,269 +1208,183 @@ dtStatus dtNavMeshQuery::queryPolygons(const float* center, const float* halfExt
 /// The start and end positions are used to calculate traversal costs. 
 /// (The y-values impact the result.)
 ///
+/// If landmarks are set, the heuristic is the larger of the straight line distance and
+/// the cost bound of the landmarks. The cost bounds are only used if the landmarks were
+/// found with the flags and area costs of @p filter, other filters use the straight line
+/// distance. (See: #setLandmarks)
+///
+/// If islands are set and the end polygon is on another island than the start polygon,
+/// the path is the start polygon only, without searching. Out of date islands do not
+/// skip any search. (See: #setIslands)
+///
 dtStatus dtNavMeshQuery::findPath(dtPolyRef startRef, dtPolyRef endRef,
 								  const float* startPos, const float* endPos,
 								  const dtQueryFilter* filter,
 								  dtPolyRef* path, int* pathCount, const int maxPath) const
 {
-	dtAssert(m_nav);
-	dtAssert(m_nodePool);
-	dtAssert(m_openList);
+	return findPath<dtQueryFilter>(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
+}
 
-	if (!pathCount)
-		return DT_FAILURE | DT_INVALID_PARAM;
+dtStatus dtNavMeshQuery::getPathToNode(dtNode* endNode, dtPolyRef* path, int* pathCount, int maxPath) const
+{
+	// Find the length of the entire path.
+	dtNode* curNode = endNode;
+	int length = 0;
+	do
+	{
+		length++;
+		curNode = m_nodePool->getNodeAtIdx(curNode->pidx);
+	} while (curNode);
 
-	*pathCount = 0;
-	
-	// Validate input
-	if (!m_nav->isValidPolyRef(startRef) || !m_nav->isValidPolyRef(endRef) ||
-		!startPos || !dtVisfinite(startPos) ||
-		!endPos || !dtVisfinite(endPos) ||
-		!filter || !path || maxPath <= 0)
+	// If the path cannot be fully stored then advance to the last node we will be able to store.
+	curNode = endNode;
+	int writeCount;
+	for (writeCount = length; writeCount > maxPath; writeCount--)
 	{
-		return DT_FAILURE | DT_INVALID_PARAM;
+		dtAssert(curNode);
+
+		curNode = m_nodePool->getNodeAtIdx(curNode->pidx);
 	}
 
-	if (startRef == endRef)
+	// Write path
+	for (int i = writeCount - 1; i >= 0; i--)
 	{
-		path[0] = startRef;
-		*pathCount = 1;
-		return DT_SUCCESS;
+		dtAssert(curNode);
+
+		path[i] = curNode->id;
+		curNode = m_nodePool->getNodeAtIdx(curNode->pidx);
 	}
-	
-	m_nodePool->clear();
-	m_openList->clear();
-	
-	dtNode* startNode = m_nodePool->getNode(startRef);
-	dtVcopy(startNode->pos, startPos);
-	startNode->pidx = 0;
-	startNode->cost = 0;
-	startNode->total = dtVdist(startPos, endPos) * H_SCALE;
-	startNode->id = startRef;
-	startNode->flags = DT_NODE_OPEN;
-	m_openList->push(startNode);
-	
-	dtNode* lastBestNode = startNode;
-	float lastBestNodeCost = startNode->total;
-	
-	bool outOfNodes = false;
-	
-	while (!m_openList->empty())
+
+	dtAssert(!curNode);
+
+	*pathCount = dtMin(length, maxPath);
+
+	if (length > maxPath)
+		return DT_SUCCESS | DT_BUFFER_TOO_SMALL;
+
+	return DT_SUCCESS;
+}
+
+
+int dtNavMeshQuery::findOffMeshTilesAround(const dtMeshTile* tile, const dtMeshTile** tiles, const int maxTiles) const
+{
+	// The off-mesh connections ending in the tile are in the tile itself, or in the tiles
+	// around it. (See: dtNavMesh::connectExtOffMeshLinks)
+	static const int MAX_NEIS = 32;
+	dtMeshTile* neis[MAX_NEIS];
+	int n = 0;
+
+	for (int y = tile->header->y - 1; y <= tile->header->y + 1; ++y)
 	{
-		// Remove node from open list and put it in closed list.
-		dtNode* bestNode = m_openList->pop();
-		bestNode->flags &= ~DT_NODE_OPEN;
-		bestNode->flags |= DT_NODE_CLOSED;
-		
-		// Reached the goal, stop searching.
-		if (bestNode->id == endRef)
+		for (int x = tile->header->x - 1; x <= tile->header->x + 1; ++x)
 		{
-			lastBestNode = bestNode;
-			break;
+			const int nneis = m_nav->getTilesAt(x, y, neis, MAX_NEIS);
+			for (int j = 0; j < nneis && n < maxTiles; ++j)
+			{
+				if (neis[j]->header->offMeshConCount > 0 && m_nav->useTile(neis[j]))
+					tiles[n++] = neis[j];
+			}
 		}
-		
-		// Get current poly and tile.
-		// The API input has been cheked already, skip checking internal data.
-		const dtPolyRef bestRef = bestNode->id;
-		const dtMeshTile* bestTile = 0;
-		const dtPoly* bestPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
-		
-		// Get parent poly and tile.
-		dtPolyRef parentRef = 0;
-		const dtMeshTile* parentTile = 0;
-		const dtPoly* parentPoly = 0;
-		if (bestNode->pidx)
-			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
-		if (parentRef)
-			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
-		
-		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
-		{
-			dtPolyRef neighbourRef = bestTile->links[i].ref;
-			
-			// Skip invalid ids and do not expand back to where we came from.
-			if (!neighbourRef || neighbourRef == parentRef)
-				continue;
-			
-			// Get neighbour poly and tile.
-			// The API input has been cheked already, skip checking internal data.
-			const dtMeshTile* neighbourTile = 0;
-			const dtPoly* neighbourPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);			
-			
-			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
-				continue;
+	}
 
-			// deal explicitly with crossing tile boundaries
-			unsigned char crossSide = 0;
-			if (bestTile->links[i].side != 0xff)
-				crossSide = bestTile->links[i].side >> 1;
+	return n;
+}
 
-			// get the node
-			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, crossSide);
-			if (!neighbourNode)
-			{
-				outOfNodes = true;
-				continue;
-			}
-			
-			// If the node is visited the first time, calculate node position.
-			if (neighbourNode->flags == 0)
-			{
-				getEdgeMidPoint(bestRef, bestPoly, bestTile,
-								neighbourRef, neighbourPoly, neighbourTile,
-								neighbourNode->pos);
-			}
-
-			// Calculate cost and heuristic.
-			float cost = 0;
-			float heuristic = 0;
-			
-			// Special case for last node.
-			if (neighbourRef == endRef)
-			{
-				// Cost
-				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
-													  parentRef, parentTile, parentPoly,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly);
-				const float endCost = filter->getCost(neighbourNode->pos, endPos,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly,
-													  0, 0, 0);
-				
-				cost = bestNode->cost + curCost + endCost;
-				heuristic = 0;
-			}
-			else
-			{
-				// Cost
-				const float curCost = filter->getCost(bestNode->pos, neighbourNode->pos,
-													  parentRef, parentTile, parentPoly,
-													  bestRef, bestTile, bestPoly,
-													  neighbourRef, neighbourTile, neighbourPoly);
-				cost = bestNode->cost + curCost;
-				heuristic = dtVdist(neighbourNode->pos, endPos)*H_SCALE;
-			}
-
-			const float total = cost + heuristic;
-			
-			// The node is already in open list and the new result is worse, skip.
-			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
-				continue;
-			// The node is already visited and process, and the new result is worse, skip.
-			if ((neighbourNode->flags & DT_NODE_CLOSED) && total >= neighbourNode->total)
-				continue;
-			
-			// Add or update the node.
-			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
-			neighbourNode->id = neighbourRef;
-			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
-			neighbourNode->cost = cost;
-			neighbourNode->total = total;
-			
-			if (neighbourNode->flags & DT_NODE_OPEN)
-			{
-				// Already in open, update node location.
-				m_openList->modify(neighbourNode);
-			}
-			else
-			{
-				// Put the node in open list.
-				neighbourNode->flags |= DT_NODE_OPEN;
-				m_openList->push(neighbourNode);
-			}
-			
-			// Update nearest node to target so far.
-			if (heuristic < lastBestNodeCost)
-			{
-				lastBestNodeCost = heuristic;
-				lastBestNode = neighbourNode;
-			}
-		}
-	}
-
-	dtStatus status = getPathToNode(lastBestNode, path, pathCount, maxPath);
-
-	if (lastBestNode->id != endRef)
-		status |= DT_PARTIAL_RESULT;
-
-	if (outOfNodes)
-		status |= DT_OUT_OF_NODES;
-	
-	return status;
+/// @par
+///
+/// @warning Calling any non-slice methods before calling finalizeSlicedFindPath() 
+/// or finalizeSlicedFindPathPartial() may result in corrupted data!
+///
+/// The @p filter pointer is stored and used for the duration of the sliced
+/// path query.
+///
+dtStatus dtNavMeshQuery::initSlicedFindPath(dtPolyRef startRef, dtPolyRef endRef,
+											const float* startPos, const float* endPos,
+											const dtQueryFilter* filter, const unsigned int options)
+{
+	return initSlicedFindPath(m_query, m_nodePool, m_openList, m_stats, startRef, endRef, startPos, endPos, filter, options);
 }
 
-dtStatus dtNavMeshQuery::getPathToNode(dtNode* endNode, dtPolyRef* path, int* pathCount, int maxPath) const
+dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 {
-	// Find the length of the entire path.
-	dtNode* curNode = endNode;
-	int length = 0;
-	do
-	{
-		length++;
-		curNode = m_nodePool->getNodeAtIdx(curNode->pidx);
-	} while (curNode);
-
-	// If the path cannot be fully stored then advance to the last node we will be able to store.
-	curNode = endNode;
-	int writeCount;
-	for (writeCount = length; writeCount > maxPath; writeCount--)
-	{
-		dtAssert(curNode);
-
-		curNode = m_nodePool->getNodeAtIdx(curNode->pidx);
-	}
-
-	// Write path
-	for (int i = writeCount - 1; i >= 0; i--)
-	{
-		dtAssert(curNode);
-
-		path[i] = curNode->id;
-		curNode = m_nodePool->getNodeAtIdx(curNode->pidx);
-	}
-
-	dtAssert(!curNode);
-
-	*pathCount = dtMin(length, maxPath);
-
-	if (length > maxPath)
-		return DT_SUCCESS | DT_BUFFER_TOO_SMALL;
+	return updateSlicedFindPath(m_query, m_nodePool, m_openList, m_stats, maxIter, doneIters);
+}
 
-	return DT_SUCCESS;
+dtStatus dtNavMeshQuery::finalizeSlicedFindPath(dtPolyRef* path, int* pathCount, const int maxPath)
+{
+	return finalizeSlicedFindPath(m_query, m_nodePool, m_stats, path, pathCount, maxPath);
 }
 
+dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(const dtPolyRef* existing, const int existingSize,
+													   dtPolyRef* path, int* pathCount, const int maxPath)
+{
+	return finalizeSlicedFindPathPartial(m_query, m_nodePool, m_stats, existing, existingSize, path, pathCount, maxPath);
+}
 
 /// @par
 ///
-/// @warning Calling any non-slice methods before calling finalizeSlicedFindPath() 
-/// or finalizeSlicedFindPathPartial() may result in corrupted data!
+/// Each search context keeps its own nodes, so searches in different contexts can be
+/// interleaved on one query object, and with the non-slice methods of the query.
 ///
 /// The @p filter pointer is stored and used for the duration of the sliced
 /// path query.
 ///
-dtStatus dtNavMeshQuery::initSlicedFindPath(dtPolyRef startRef, dtPolyRef endRef,
+dtStatus dtNavMeshQuery::initSlicedFindPath(dtSlicedSearch* search, dtPolyRef startRef, dtPolyRef endRef,
 											const float* startPos, const float* endPos,
-											const dtQueryFilter* filter, const unsigned int options)
+											const dtQueryFilter* filter, const unsigned int options) const
+{
+	if (!search || !search->m_nodePool || !search->m_openList)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	return initSlicedFindPath(search->m_query, search->m_nodePool, search->m_openList, search->m_stats,
+							  startRef, endRef, startPos, endPos, filter, options);
+}
+
+dtStatus dtNavMeshQuery::updateSlicedFindPath(dtSlicedSearch* search, const int maxIter, int* doneIters) const
+{
+	if (!search || !search->m_nodePool || !search->m_openList)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	return updateSlicedFindPath(search->m_query, search->m_nodePool, search->m_openList, search->m_stats, maxIter, doneIters);
+}
+
+dtStatus dtNavMeshQuery::finalizeSlicedFindPath(dtSlicedSearch* search, dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	if (!search || !search->m_nodePool || !search->m_openList)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	return finalizeSlicedFindPath(search->m_query, search->m_nodePool, search->m_stats, path, pathCount, maxPath);
+}
+
+dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(dtSlicedSearch* search, const dtPolyRef* existing, const int existingSize,
+													   dtPolyRef* path, int* pathCount, const int maxPath) const
+{
+	if (!search || !search->m_nodePool || !search->m_openList)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	return finalizeSlicedFindPathPartial(search->m_query, search->m_nodePool, search->m_stats,
+										 existing, existingSize, path, pathCount, maxPath);
+}
+
+dtStatus dtNavMeshQuery::initSlicedFindPath(dtQueryData& query, dtNodePool* nodePool, dtNodeQueue* openList,
+											dtQueryStats* stats, dtPolyRef startRef, dtPolyRef endRef,
+											const float* startPos, const float* endPos,
+											const dtQueryFilter* filter, const unsigned int options) const
 {
 	dtAssert(m_nav);
-	dtAssert(m_nodePool);
-	dtAssert(m_openList);
+	dtAssert(nodePool);
+	dtAssert(openList);
+
+	dtScopedQueryStats queryStats(stats);
 
 	// Init path state.
-	memset(&m_query, 0, sizeof(dtQueryData));
-	m_query.status = DT_FAILURE;
-	m_query.startRef = startRef;
-	m_query.endRef = endRef;
+	memset(&query, 0, sizeof(dtQueryData));
+	query.status = DT_FAILURE;
+	query.startRef = startRef;
+	query.endRef = endRef;
 	if (startPos)
-		dtVcopy(m_query.startPos, startPos);
+		dtVcopy(query.startPos, startPos);
 	if (endPos)
-		dtVcopy(m_query.endPos, endPos);
-	m_query.filter = filter;
-	m_query.options = options;
-	m_query.raycastLimitSqr = FLT_MAX;
+		dtVcopy(query.endPos, endPos);
+	query.filter = filter;
+	query.options = options;
+	query.raycastLimitSqr = FLT_MAX;
 	
 	// Validate input
 	if (!m_nav->isValidPolyRef(startRef) || !m_nav->isValidPolyRef(endRef) ||
@@ -1238,43 +1401,56 @@ dtStatus dtNavMeshQuery::initSlicedFindPath(dtPolyRef startRef, dtPolyRef endRef
 		// so it is enough to compute it from the first tile.
 		const dtMeshTile* tile = m_nav->getTileByRef(startRef);
 		float agentRadius = tile->header->walkableRadius;
-		m_query.raycastLimitSqr = dtSqr(agentRadius * DT_RAY_CAST_LIMIT_PROPORTIONS);
+		query.raycastLimitSqr = dtSqr(agentRadius * DT_RAY_CAST_LIMIT_PROPORTIONS);
 	}
 
 	if (startRef == endRef)
 	{
-		m_query.status = DT_SUCCESS;
+		query.status = DT_SUCCESS;
 		return DT_SUCCESS;
 	}
 	
-	m_nodePool->clear();
-	m_openList->clear();
+	nodePool->clear();
+	openList->clear();
 	
-	dtNode* startNode = m_nodePool->getNode(startRef);
+	dtNode* startNode = nodePool->getNode(startRef);
 	dtVcopy(startNode->pos, startPos);
 	startNode->pidx = 0;
 	startNode->cost = 0;
-	startNode->total = dtVdist(startPos, endPos) * H_SCALE;
+	startNode->total = dtVdist(startPos, endPos) * DT_HEURISTIC_SCALE;
 	startNode->id = startRef;
 	startNode->flags = DT_NODE_OPEN;
-	m_openList->push(startNode);
 	
-	m_query.status = DT_IN_PROGRESS;
-	m_query.lastBestNode = startNode;
-	m_query.lastBestNodeCost = startNode->total;
+	query.lastBestNode = startNode;
+	query.lastBestNodeCost = startNode->total;
+
+	// The end is on another island, the search ends at the start.
+	if (m_islands && !m_islands->isConnected(startRef, endRef, findIslandFlagSet(filter)))
+	{
+		startNode->flags = DT_NODE_CLOSED;
+		query.status = DT_SUCCESS;
+		return query.status;
+	}
+
+	openList->push(startNode);
+	queryStats.updateOpenList(openList->size());
+	query.status = DT_IN_PROGRESS;
 	
-	return m_query.status;
+	return query.status;
 }
 	
-dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
+dtStatus dtNavMeshQuery::updateSlicedFindPath(dtQueryData& query, dtNodePool* nodePool, dtNodeQueue* openList,
+											  dtQueryStats* stats, const int maxIter, int* doneIters) const
 {
-	if (!dtStatusInProgress(m_query.status))
-		return m_query.status;
+	if (!dtStatusInProgress(query.status))
+		return query.status;
+
+	dtScopedQueryStats queryStats(stats, true);
 
 	// Make sure the request is still valid.
-	if (!m_nav->isValidPolyRef(m_query.startRef) || !m_nav->isValidPolyRef(m_query.endRef))
+	if (!m_nav->isValidPolyRef(query.startRef) || !m_nav->isValidPolyRef(query.endRef))
 	{
-		m_query.status = DT_FAILURE;
+		query.status = DT_FAILURE;
 		return DT_FAILURE;
 	}
 
@@ -1282,24 +1458,24 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 	rayHit.maxPath = 0;
 		
 	int iter = 0;
-	while (iter < maxIter && !m_openList->empty())
+	while (iter < maxIter && !openList->empty())
 	{
 		iter++;
 		
 		// Remove node from open list and put it in closed list.
-		dtNode* bestNode = m_openList->pop();
+		dtNode* bestNode = openList->pop();
 		bestNode->flags &= ~DT_NODE_OPEN;
 		bestNode->flags |= DT_NODE_CLOSED;
 		
 		// Reached the goal, stop searching.
-		if (bestNode->id == m_query.endRef)
+		if (bestNode->id == query.endRef)
 		{
-			m_query.lastBestNode = bestNode;
-			const dtStatus details = m_query.status & DT_STATUS_DETAIL_MASK;
-			m_query.status = DT_SUCCESS | details;
+			query.lastBestNode = bestNode;
+			const dtStatus details = query.status & DT_STATUS_DETAIL_MASK;
+			query.status = DT_SUCCESS | details;
 			if (doneIters)
 				*doneIters = iter;
-			return m_query.status;
+			return query.status;
 		}
 		
 		// Get current poly and tile.
@@ -1310,11 +1486,12 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 		if (dtStatusFailed(m_nav->getTileAndPolyByRef(bestRef, &bestTile, &bestPoly)))
 		{
 			// The polygon has disappeared during the sliced query, fail.
-			m_query.status = DT_FAILURE;
+			query.status = DT_FAILURE;
 			if (doneIters)
 				*doneIters = iter;
-			return m_query.status;
+			return query.status;
 		}
+		queryStats.expandNode(bestTile);
 		
 		// Get parent and grand parent poly and tile.
 		dtPolyRef parentRef = 0, grandpaRef = 0;
@@ -1323,10 +1500,10 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 		dtNode* parentNode = 0;
 		if (bestNode->pidx)
 		{
-			parentNode = m_nodePool->getNodeAtIdx(bestNode->pidx);
+			parentNode = nodePool->getNodeAtIdx(bestNode->pidx);
 			parentRef = parentNode->id;
 			if (parentNode->pidx)
-				grandpaRef = m_nodePool->getNodeAtIdx(parentNode->pidx)->id;
+				grandpaRef = nodePool->getNodeAtIdx(parentNode->pidx)->id;
 		}
 		if (parentRef)
 		{
@@ -1334,24 +1511,25 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			if (invalidParent || (grandpaRef && !m_nav->isValidPolyRef(grandpaRef)) )
 			{
 				// The polygon has disappeared during the sliced query, fail.
-				m_query.status = DT_FAILURE;
+				query.status = DT_FAILURE;
 				if (doneIters)
 					*doneIters = iter;
-				return m_query.status;
+				return query.status;
 			}
 		}
 
 		// decide whether to test raycast to previous nodes
 		bool tryLOS = false;
-		if (m_query.options & DT_FINDPATH_ANY_ANGLE)
+		if (query.options & DT_FINDPATH_ANY_ANGLE)
 		{
-			if ((parentRef != 0) && (dtVdistSqr(parentNode->pos, bestNode->pos) < m_query.raycastLimitSqr))
+			if ((parentRef != 0) && (dtVdistSqr(parentNode->pos, bestNode->pos) < query.raycastLimitSqr))
 				tryLOS = true;
 		}
 		
 		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
 		{
 			dtPolyRef neighbourRef = bestTile->links[i].ref;
+			queryStats.traverseLink();
 			
 			// Skip invalid ids and do not expand back to where we came from.
 			if (!neighbourRef || neighbourRef == parentRef)
@@ -1361,18 +1539,25 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			// The API input has been cheked already, skip checking internal data.
 			const dtMeshTile* neighbourTile = 0;
 			const dtPoly* neighbourPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);			
-			
-			if (!m_query.filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+			if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly)))
+			{
+				query.status = DT_FAILURE | DT_OUT_OF_MEMORY;
+				if (doneIters)
+					*doneIters = iter;
+				return query.status;
+			}
+
+			if (!query.filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
 				continue;
 			
 			// get the neighbor node
-			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef, 0);
+			dtNode* neighbourNode = nodePool->getNode(neighbourRef, 0);
 			if (!neighbourNode)
 			{
-				m_query.status |= DT_OUT_OF_NODES;
+				query.status |= DT_OUT_OF_NODES;
 				continue;
 			}
+			queryStats.touchNode();
 			
 			// do not expand to nodes that were already visited from the same parent
 			if (neighbourNode->pidx != 0 && neighbourNode->pidx == bestNode->pidx)
@@ -1395,7 +1580,7 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			rayHit.pathCost = rayHit.t = 0;
 			if (tryLOS)
 			{
-				raycast(parentRef, parentNode->pos, neighbourNode->pos, m_query.filter, DT_RAYCAST_USE_COSTS, &rayHit, grandpaRef);
+				raycast(parentRef, parentNode->pos, neighbourNode->pos, query.filter, DT_RAYCAST_USE_COSTS, &rayHit, grandpaRef, queryStats);
 				foundShortCut = rayHit.t >= 1.0f;
 			}
 
@@ -1408,7 +1593,7 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			else
 			{
 				// No shortcut found.
-				const float curCost = m_query.filter->getCost(bestNode->pos, neighbourNode->pos,
+				const float curCost = query.filter->getCost(bestNode->pos, neighbourNode->pos,
 															  parentRef, parentTile, parentPoly,
 															bestRef, bestTile, bestPoly,
 															neighbourRef, neighbourTile, neighbourPoly);
@@ -1416,9 +1601,9 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			}
 
 			// Special case for last node.
-			if (neighbourRef == m_query.endRef)
+			if (neighbourRef == query.endRef)
 			{
-				const float endCost = m_query.filter->getCost(neighbourNode->pos, m_query.endPos,
+				const float endCost = query.filter->getCost(neighbourNode->pos, query.endPos,
 															  bestRef, bestTile, bestPoly,
 															  neighbourRef, neighbourTile, neighbourPoly,
 															  0, 0, 0);
@@ -1428,7 +1613,7 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			}
 			else
 			{
-				heuristic = dtVdist(neighbourNode->pos, m_query.endPos)*H_SCALE;
+				heuristic = dtVdist(neighbourNode->pos, query.endPos)*DT_HEURISTIC_SCALE;
 			}
 			
 			const float total = cost + heuristic;
@@ -1441,7 +1626,7 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 				continue;
 			
 			// Add or update the node.
-			neighbourNode->pidx = foundShortCut ? bestNode->pidx : m_nodePool->getNodeIdx(bestNode);
+			neighbourNode->pidx = foundShortCut ? bestNode->pidx : nodePool->getNodeIdx(bestNode);
 			neighbourNode->id = neighbourRef;
 			neighbourNode->flags = (neighbourNode->flags & ~(DT_NODE_CLOSED | DT_NODE_PARENT_DETACHED));
 			neighbourNode->cost = cost;
@@ -1452,39 +1637,43 @@ dtStatus dtNavMeshQuery::updateSlicedFindPath(const int maxIter, int* doneIters)
 			if (neighbourNode->flags & DT_NODE_OPEN)
 			{
 				// Already in open, update node location.
-				m_openList->modify(neighbourNode);
+				openList->modify(neighbourNode);
 			}
 			else
 			{
 				// Put the node in open list.
 				neighbourNode->flags |= DT_NODE_OPEN;
-				m_openList->push(neighbourNode);
+				openList->push(neighbourNode);
+				queryStats.updateOpenList(openList->size());
 			}
 			
 			// Update nearest node to target so far.
-			if (heuristic < m_query.lastBestNodeCost)
+			if (heuristic < query.lastBestNodeCost)
 			{
-				m_query.lastBestNodeCost = heuristic;
-				m_query.lastBestNode = neighbourNode;
+				query.lastBestNodeCost = heuristic;
+				query.lastBestNode = neighbourNode;
 			}
 		}
 	}
 	
 	// Exhausted all nodes, but could not find path.
-	if (m_openList->empty())
+	if (openList->empty())
 	{
-		const dtStatus details = m_query.status & DT_STATUS_DETAIL_MASK;
-		m_query.status = DT_SUCCESS | details;
+		const dtStatus details = query.status & DT_STATUS_DETAIL_MASK;
+		query.status = DT_SUCCESS | details;
 	}
 
 	if (doneIters)
 		*doneIters = iter;
 
-	return m_query.status;
+	return query.status;
 }
 
-dtStatus dtNavMeshQuery::finalizeSlicedFindPath(dtPolyRef* path, int* pathCount, const int maxPath)
+dtStatus dtNavMeshQuery::finalizeSlicedFindPath(dtQueryData& query, dtNodePool* nodePool, dtQueryStats* stats,
+												dtPolyRef* path, int* pathCount, const int maxPath) const
 {
+	dtScopedQueryStats queryStats(stats, true);
+
 	if (!pathCount)
 		return DT_FAILURE | DT_INVALID_PARAM;
 
@@ -1493,35 +1682,35 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPath(dtPolyRef* path, int* pathCount,
 	if (!path || maxPath <= 0)
 		return DT_FAILURE | DT_INVALID_PARAM;
 	
-	if (dtStatusFailed(m_query.status))
+	if (dtStatusFailed(query.status))
 	{
 		// Reset query.
-		memset(&m_query, 0, sizeof(dtQueryData));
+		memset(&query, 0, sizeof(dtQueryData));
 		return DT_FAILURE;
 	}
 
 	int n = 0;
 
-	if (m_query.startRef == m_query.endRef)
+	if (query.startRef == query.endRef)
 	{
 		// Special case: the search starts and ends at same poly.
-		path[n++] = m_query.startRef;
+		path[n++] = query.startRef;
 	}
 	else
 	{
 		// Reverse the path.
-		dtAssert(m_query.lastBestNode);
+		dtAssert(query.lastBestNode);
 		
-		if (m_query.lastBestNode->id != m_query.endRef)
-			m_query.status |= DT_PARTIAL_RESULT;
+		if (query.lastBestNode->id != query.endRef)
+			query.status |= DT_PARTIAL_RESULT;
 		
 		dtNode* prev = 0;
-		dtNode* node = m_query.lastBestNode;
+		dtNode* node = query.lastBestNode;
 		int prevRay = 0;
 		do
 		{
-			dtNode* next = m_nodePool->getNodeAtIdx(node->pidx);
-			node->pidx = m_nodePool->getNodeIdx(prev);
+			dtNode* next = nodePool->getNodeAtIdx(node->pidx);
+			node->pidx = nodePool->getNodeIdx(prev);
 			prev = node;
 			int nextRay = node->flags & DT_NODE_PARENT_DETACHED; // keep track of whether parent is not adjacent (i.e. due to raycast shortcut)
 			node->flags = (node->flags & ~DT_NODE_PARENT_DETACHED) | prevRay; // and store it in the reversed path's node
@@ -1534,14 +1723,15 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPath(dtPolyRef* path, int* pathCount,
 		node = prev;
 		do
 		{
-			dtNode* next = m_nodePool->getNodeAtIdx(node->pidx);
+			dtNode* next = nodePool->getNodeAtIdx(node->pidx);
 			dtStatus status = 0;
 			if (node->flags & DT_NODE_PARENT_DETACHED)
 			{
-				float t, normal[3];
-				int m;
-				status = raycast(node->id, node->pos, next->pos, m_query.filter, &t, normal, path+n, &m, maxPath-n);
-				n += m;
+				dtRaycastHit hit;
+				hit.path = path+n;
+				hit.maxPath = maxPath-n;
+				status = raycast(node->id, node->pos, next->pos, query.filter, 0, &hit, 0, queryStats);
+				n += hit.pathCount;
 				// raycast ends on poly boundary and the path might include the next poly boundary.
 				if (path[n-1] == next->id)
 					n--; // remove to avoid duplicates
@@ -1555,7 +1745,7 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPath(dtPolyRef* path, int* pathCount,
 
 			if (status & DT_STATUS_DETAIL_MASK)
 			{
-				m_query.status |= status & DT_STATUS_DETAIL_MASK;
+				query.status |= status & DT_STATUS_DETAIL_MASK;
 				break;
 			}
 			node = next;
@@ -1563,19 +1753,22 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPath(dtPolyRef* path, int* pathCount,
 		while (node);
 	}
 	
-	const dtStatus details = m_query.status & DT_STATUS_DETAIL_MASK;
+	const dtStatus details = query.status & DT_STATUS_DETAIL_MASK;
 
 	// Reset query.
-	memset(&m_query, 0, sizeof(dtQueryData));
+	memset(&query, 0, sizeof(dtQueryData));
 	
 	*pathCount = n;
 	
 	return DT_SUCCESS | details;
 }
 
-dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(const dtPolyRef* existing, const int existingSize,
-													   dtPolyRef* path, int* pathCount, const int maxPath)
+dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(dtQueryData& query, dtNodePool* nodePool, dtQueryStats* stats,
+													   const dtPolyRef* existing, const int existingSize,
+													   dtPolyRef* path, int* pathCount, const int maxPath) const
 {
+	dtScopedQueryStats queryStats(stats, true);
+
 	if (!pathCount)
 		return DT_FAILURE | DT_INVALID_PARAM;
 
@@ -1584,19 +1777,19 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(const dtPolyRef* existing
 	if (!existing || existingSize <= 0 || !path || !pathCount || maxPath <= 0)
 		return DT_FAILURE | DT_INVALID_PARAM;
 	
-	if (dtStatusFailed(m_query.status))
+	if (dtStatusFailed(query.status))
 	{
 		// Reset query.
-		memset(&m_query, 0, sizeof(dtQueryData));
+		memset(&query, 0, sizeof(dtQueryData));
 		return DT_FAILURE;
 	}
 	
 	int n = 0;
 	
-	if (m_query.startRef == m_query.endRef)
+	if (query.startRef == query.endRef)
 	{
 		// Special case: the search starts and ends at same poly.
-		path[n++] = m_query.startRef;
+		path[n++] = query.startRef;
 	}
 	else
 	{
@@ -1605,24 +1798,24 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(const dtPolyRef* existing
 		dtNode* node = 0;
 		for (int i = existingSize-1; i >= 0; --i)
 		{
-			m_nodePool->findNodes(existing[i], &node, 1);
+			nodePool->findNodes(existing[i], &node, 1);
 			if (node)
 				break;
 		}
 		
 		if (!node)
 		{
-			m_query.status |= DT_PARTIAL_RESULT;
-			dtAssert(m_query.lastBestNode);
-			node = m_query.lastBestNode;
+			query.status |= DT_PARTIAL_RESULT;
+			dtAssert(query.lastBestNode);
+			node = query.lastBestNode;
 		}
 		
 		// Reverse the path.
 		int prevRay = 0;
 		do
 		{
-			dtNode* next = m_nodePool->getNodeAtIdx(node->pidx);
-			node->pidx = m_nodePool->getNodeIdx(prev);
+			dtNode* next = nodePool->getNodeAtIdx(node->pidx);
+			node->pidx = nodePool->getNodeIdx(prev);
 			prev = node;
 			int nextRay = node->flags & DT_NODE_PARENT_DETACHED; // keep track of whether parent is not adjacent (i.e. due to raycast shortcut)
 			node->flags = (node->flags & ~DT_NODE_PARENT_DETACHED) | prevRay; // and store it in the reversed path's node
@@ -1635,14 +1828,15 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(const dtPolyRef* existing
 		node = prev;
 		do
 		{
-			dtNode* next = m_nodePool->getNodeAtIdx(node->pidx);
+			dtNode* next = nodePool->getNodeAtIdx(node->pidx);
 			dtStatus status = 0;
 			if (node->flags & DT_NODE_PARENT_DETACHED)
 			{
-				float t, normal[3];
-				int m;
-				status = raycast(node->id, node->pos, next->pos, m_query.filter, &t, normal, path+n, &m, maxPath-n);
-				n += m;
+				dtRaycastHit hit;
+				hit.path = path+n;
+				hit.maxPath = maxPath-n;
+				status = raycast(node->id, node->pos, next->pos, query.filter, 0, &hit, 0, queryStats);
+				n += hit.pathCount;
 				// raycast ends on poly boundary and the path might include the next poly boundary.
 				if (path[n-1] == next->id)
 					n--; // remove to avoid duplicates
@@ -1656,7 +1850,7 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(const dtPolyRef* existing
 
 			if (status & DT_STATUS_DETAIL_MASK)
 			{
-				m_query.status |= status & DT_STATUS_DETAIL_MASK;
+				query.status |= status & DT_STATUS_DETAIL_MASK;
 				break;
 			}
 			node = next;
@@ -1664,10 +1858,10 @@ dtStatus dtNavMeshQuery::finalizeSlicedFindPathPartial(const dtPolyRef* existing
 		while (node);
 	}
 	
-	const dtStatus details = m_query.status & DT_STATUS_DETAIL_MASK;
+	const dtStatus details = query.status & DT_STATUS_DETAIL_MASK;
 
 	// Reset query.
-	memset(&m_query, 0, sizeof(dtQueryData));
+	memset(&query, 0, sizeof(dtQueryData));
 	
 	*pathCount = n;
 	
@@ -2056,6 +2250,8 @@ dtStatus dtNavMeshQuery::moveAlongSurface(dtPolyRef startRef, const float* start
 	dtAssert(m_nav);
 	dtAssert(m_tinyNodePool);
 
+	dtScopedQueryStats queryStats(m_stats);
+
 	if (!visitedCount)
 		return DT_FAILURE | DT_INVALID_PARAM;
 
@@ -2085,6 +2281,7 @@ dtStatus dtNavMeshQuery::moveAlongSurface(dtPolyRef startRef, const float* start
 	startNode->id = startRef;
 	startNode->flags = DT_NODE_CLOSED;
 	stack[nstack++] = startNode;
+	queryStats.updateOpenList(nstack);
 	
 	float bestPos[3];
 	float bestDist = FLT_MAX;
@@ -2111,12 +2308,14 @@ dtStatus dtNavMeshQuery::moveAlongSurface(dtPolyRef startRef, const float* start
 		const dtPolyRef curRef = curNode->id;
 		const dtMeshTile* curTile = 0;
 		const dtPoly* curPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(curRef, &curTile, &curPoly);			
+		if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(curRef, &curTile, &curPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		queryStats.expandNode(curTile);
 		
 		// Collect vertices.
 		const int nverts = curPoly->vertCount;
 		for (int i = 0; i < nverts; ++i)
-			dtVcopy(&verts[i*3], &curTile->verts[curPoly->verts[i]*3]);
+			dtVcopy(&verts[i*3], curTile->getVert(curPoly->verts[i], &verts[i*3]));
 		
 		// If target is inside the poly, stop search.
 		if (dtPointInPolygon(endPos, verts, nverts))
@@ -2140,13 +2339,15 @@ dtStatus dtNavMeshQuery::moveAlongSurface(dtPolyRef startRef, const float* start
 				for (unsigned int k = curPoly->firstLink; k != DT_NULL_LINK; k = curTile->links[k].next)
 				{
 					const dtLink* link = &curTile->links[k];
+					queryStats.traverseLink();
 					if (link->edge == j)
 					{
 						if (link->ref != 0)
 						{
 							const dtMeshTile* neiTile = 0;
 							const dtPoly* neiPoly = 0;
-							m_nav->getTileAndPolyByRefUnsafe(link->ref, &neiTile, &neiPoly);
+							if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(link->ref, &neiTile, &neiPoly)))
+								return DT_FAILURE | DT_OUT_OF_MEMORY;
 							if (filter->passFilter(link->ref, neiTile, neiPoly))
 							{
 								if (nneis < MAX_NEIS)
@@ -2160,6 +2361,7 @@ dtStatus dtNavMeshQuery::moveAlongSurface(dtPolyRef startRef, const float* start
 			{
 				const unsigned int idx = (unsigned int)(curPoly->neis[j]-1);
 				const dtPolyRef ref = m_nav->getPolyRefBase(curTile) | idx;
+				queryStats.traverseLink();
 				if (filter->passFilter(ref, curTile, &curTile->polys[idx]))
 				{
 					// Internal edge, encode id.
@@ -2190,6 +2392,7 @@ dtStatus dtNavMeshQuery::moveAlongSurface(dtPolyRef startRef, const float* start
 					dtNode* neighbourNode = m_tinyNodePool->getNode(neis[k]);
 					if (!neighbourNode)
 						continue;
+					queryStats.touchNode();
 					// Skip if already visited.
 					if (neighbourNode->flags & DT_NODE_CLOSED)
 						continue;
@@ -2209,6 +2412,7 @@ dtStatus dtNavMeshQuery::moveAlongSurface(dtPolyRef startRef, const float* start
 						neighbourNode->pidx = m_tinyNodePool->getNodeIdx(curNode);
 						neighbourNode->flags |= DT_NODE_CLOSED;
 						stack[nstack++] = neighbourNode;
+						queryStats.updateOpenList(nstack);
 					}
 				}
 			}
@@ -2300,8 +2504,8 @@ dtStatus dtNavMeshQuery::getPortalPoints(dtPolyRef from, const dtPoly* fromPoly,
 			if (fromTile->links[i].ref == to)
 			{
 				const int v = fromTile->links[i].edge;
-				dtVcopy(left, &fromTile->verts[fromPoly->verts[v]*3]);
-				dtVcopy(right, &fromTile->verts[fromPoly->verts[v]*3]);
+				dtVcopy(left, fromTile->getVert(fromPoly->verts[v], left));
+				dtVcopy(right, left);
 				return DT_SUCCESS;
 			}
 		}
@@ -2315,8 +2519,8 @@ dtStatus dtNavMeshQuery::getPortalPoints(dtPolyRef from, const dtPoly* fromPoly,
 			if (toTile->links[i].ref == from)
 			{
 				const int v = toTile->links[i].edge;
-				dtVcopy(left, &toTile->verts[toPoly->verts[v]*3]);
-				dtVcopy(right, &toTile->verts[toPoly->verts[v]*3]);
+				dtVcopy(left, toTile->getVert(toPoly->verts[v], left));
+				dtVcopy(right, left);
 				return DT_SUCCESS;
 			}
 		}
@@ -2326,8 +2530,11 @@ dtStatus dtNavMeshQuery::getPortalPoints(dtPolyRef from, const dtPoly* fromPoly,
 	// Find portal vertices.
 	const int v0 = fromPoly->verts[link->edge];
 	const int v1 = fromPoly->verts[(link->edge+1) % (int)fromPoly->vertCount];
-	dtVcopy(left, &fromTile->verts[v0*3]);
-	dtVcopy(right, &fromTile->verts[v1*3]);
+	float t0[3], t1[3];
+	const float* va = fromTile->getVert(v0, t0);
+	const float* vb = fromTile->getVert(v1, t1);
+	dtVcopy(left, va);
+	dtVcopy(right, vb);
 	
 	// If the link is at tile boundary, dtClamp the vertices to
 	// the link width.
@@ -2339,8 +2546,8 @@ dtStatus dtNavMeshQuery::getPortalPoints(dtPolyRef from, const dtPoly* fromPoly,
 			const float s = 1.0f/255.0f;
 			const float tmin = link->bmin*s;
 			const float tmax = link->bmax*s;
-			dtVlerp(left, &fromTile->verts[v0*3], &fromTile->verts[v1*3], tmin);
-			dtVlerp(right, &fromTile->verts[v0*3], &fromTile->verts[v1*3], tmax);
+			dtVlerp(left, va, vb, tmin);
+			dtVlerp(right, va, vb, tmax);
 		}
 	}
 	
@@ -2475,264 +2682,122 @@ dtStatus dtNavMeshQuery::raycast(dtPolyRef startRef, const float* startPos, cons
 								 const dtQueryFilter* filter, const unsigned int options,
 								 dtRaycastHit* hit, dtPolyRef prevRef) const
 {
-	dtAssert(m_nav);
+	return raycast<dtQueryFilter>(startRef, startPos, endPos, filter, options, hit, prevRef);
+}
 
-	if (!hit)
-		return DT_FAILURE | DT_INVALID_PARAM;
+/// @par
+///
+/// At least one result array must be provided.
+///
+/// The order of the result set is from least to highest cost to reach the polygon.
+///
+/// A common use case for this method is to perform Dijkstra searches. 
+/// Candidate polygons are found by searching the graph beginning at the start polygon.
+///
+/// If a polygon is not found via the graph search, even if it intersects the 
+/// search circle, it will not be included in the result set. For example:
+///
+/// polyA is the start polygon.
+/// polyB shares an edge with polyA. (Is adjacent.)
+/// polyC shares an edge with polyB, but not with polyA
+/// Even if the search circle overlaps polyC, it will not be included in the 
+/// result set unless polyB is also in the set.
+/// 
+/// The value of the center point is used as the start position for cost 
+/// calculations. It is not projected onto the surface of the mesh, so its 
+/// y-value will effect the costs.
+///
+/// Intersection tests occur in 2D. All polygons and the search circle are 
+/// projected onto the xz-plane. So the y-value of the center point does not 
+/// effect intersection tests.
+///
+/// If the result arrays are to small to hold the entire result set, they will be 
+/// filled to capacity.
+/// 
+dtStatus dtNavMeshQuery::findPolysAroundCircle(dtPolyRef startRef, const float* centerPos, const float radius,
+											   const dtQueryFilter* filter,
+											   dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
+											   int* resultCount, const int maxResult) const
+{
+	return findPolysAroundCircle<dtQueryFilter>(startRef, centerPos, radius, filter,
+												resultRef, resultParent, resultCost, resultCount, maxResult);
+}
 
-	hit->t = 0;
-	hit->pathCount = 0;
-	hit->pathCost = 0;
+/// @par
+///
+/// The order of the result set is from least to highest cost.
+/// 
+/// At least one result array must be provided.
+///
+/// A common use case for this method is to perform Dijkstra searches. 
+/// Candidate polygons are found by searching the graph beginning at the start 
+/// polygon.
+/// 
+/// The same intersection test restrictions that apply to findPolysAroundCircle()
+/// method apply to this method.
+/// 
+/// The 3D centroid of the search polygon is used as the start position for cost 
+/// calculations.
+/// 
+/// Intersection tests occur in 2D. All polygons are projected onto the 
+/// xz-plane. So the y-values of the vertices do not effect intersection tests.
+/// 
+/// If the result arrays are is too small to hold the entire result set, they will 
+/// be filled to capacity.
+///
+dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* verts, const int nverts,
+											  const dtQueryFilter* filter,
+											  dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
+											  int* resultCount, const int maxResult) const
+{
+	return findPolysAroundShape<dtQueryFilter>(startRef, verts, nverts, filter,
+											   resultRef, resultParent, resultCost, resultCount, maxResult);
+}
 
-	// Validate input
-	if (!m_nav->isValidPolyRef(startRef) ||
-		!startPos || !dtVisfinite(startPos) ||
-		!endPos || !dtVisfinite(endPos) ||
-		!filter ||
-		(prevRef && !m_nav->isValidPolyRef(prevRef)))
-	{
+dtStatus dtNavMeshQuery::getPathFromDijkstraSearch(dtPolyRef endRef, dtPolyRef* path, int* pathCount, int maxPath) const
+{
+	if (!m_nav->isValidPolyRef(endRef) || !path || !pathCount || maxPath < 0)
 		return DT_FAILURE | DT_INVALID_PARAM;
-	}
-	
-	float dir[3], curPos[3], lastPos[3];
-	float verts[DT_VERTS_PER_POLYGON*3+3];	
-	int n = 0;
-
-	dtVcopy(curPos, startPos);
-	dtVsub(dir, endPos, startPos);
-	dtVset(hit->hitNormal, 0, 0, 0);
 
-	dtStatus status = DT_SUCCESS;
+	*pathCount = 0;
 
-	const dtMeshTile* prevTile, *tile, *nextTile;
-	const dtPoly* prevPoly, *poly, *nextPoly;
-	dtPolyRef curRef;
+	dtNode* endNode;
+	if (m_nodePool->findNodes(endRef, &endNode, 1) != 1 ||
+		(endNode->flags & DT_NODE_CLOSED) == 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
 
-	// The API input has been checked already, skip checking internal data.
-	curRef = startRef;
-	tile = 0;
-	poly = 0;
-	m_nav->getTileAndPolyByRefUnsafe(curRef, &tile, &poly);
-	nextTile = prevTile = tile;
-	nextPoly = prevPoly = poly;
-	if (prevRef)
-		m_nav->getTileAndPolyByRefUnsafe(prevRef, &prevTile, &prevPoly);
-
-	while (curRef)
-	{
-		// Cast ray against current polygon.
-		
-		// Collect vertices.
-		int nv = 0;
-		for (int i = 0; i < (int)poly->vertCount; ++i)
-		{
-			dtVcopy(&verts[nv*3], &tile->verts[poly->verts[i]*3]);
-			nv++;
-		}
-		
-		float tmin, tmax;
-		int segMin, segMax;
-		if (!dtIntersectSegmentPoly2D(startPos, endPos, verts, nv, tmin, tmax, segMin, segMax))
-		{
-			// Could not hit the polygon, keep the old t and report hit.
-			hit->pathCount = n;
-			return status;
-		}
-
-		hit->hitEdgeIndex = segMax;
-
-		// Keep track of furthest t so far.
-		if (tmax > hit->t)
-			hit->t = tmax;
-		
-		// Store visited polygons.
-		if (n < hit->maxPath)
-			hit->path[n++] = curRef;
-		else
-			status |= DT_BUFFER_TOO_SMALL;
-
-		// Ray end is completely inside the polygon.
-		if (segMax == -1)
-		{
-			hit->t = FLT_MAX;
-			hit->pathCount = n;
-			
-			// add the cost
-			if (options & DT_RAYCAST_USE_COSTS)
-				hit->pathCost += filter->getCost(curPos, endPos, prevRef, prevTile, prevPoly, curRef, tile, poly, curRef, tile, poly);
-			return status;
-		}
-
-		// Follow neighbours.
-		dtPolyRef nextRef = 0;
-		
-		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
-		{
-			const dtLink* link = &tile->links[i];
-			
-			// Find link which contains this edge.
-			if ((int)link->edge != segMax)
-				continue;
-			
-			// Get pointer to the next polygon.
-			nextTile = 0;
-			nextPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(link->ref, &nextTile, &nextPoly);
-			
-			// Skip off-mesh connections.
-			if (nextPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
-				continue;
-			
-			// Skip links based on filter.
-			if (!filter->passFilter(link->ref, nextTile, nextPoly))
-				continue;
-			
-			// If the link is internal, just return the ref.
-			if (link->side == 0xff)
-			{
-				nextRef = link->ref;
-				break;
-			}
-			
-			// If the link is at tile boundary,
-			
-			// Check if the link spans the whole edge, and accept.
-			if (link->bmin == 0 && link->bmax == 255)
-			{
-				nextRef = link->ref;
-				break;
-			}
-			
-			// Check for partial edge links.
-			const int v0 = poly->verts[link->edge];
-			const int v1 = poly->verts[(link->edge+1) % poly->vertCount];
-			const float* left = &tile->verts[v0*3];
-			const float* right = &tile->verts[v1*3];
-			
-			// Check that the intersection lies inside the link portal.
-			if (link->side == 0 || link->side == 4)
-			{
-				// Calculate link size.
-				const float s = 1.0f/255.0f;
-				float lmin = left[2] + (right[2] - left[2])*(link->bmin*s);
-				float lmax = left[2] + (right[2] - left[2])*(link->bmax*s);
-				if (lmin > lmax) dtSwap(lmin, lmax);
-				
-				// Find Z intersection.
-				float z = startPos[2] + (endPos[2]-startPos[2])*tmax;
-				if (z >= lmin && z <= lmax)
-				{
-					nextRef = link->ref;
-					break;
-				}
-			}
-			else if (link->side == 2 || link->side == 6)
-			{
-				// Calculate link size.
-				const float s = 1.0f/255.0f;
-				float lmin = left[0] + (right[0] - left[0])*(link->bmin*s);
-				float lmax = left[0] + (right[0] - left[0])*(link->bmax*s);
-				if (lmin > lmax) dtSwap(lmin, lmax);
-				
-				// Find X intersection.
-				float x = startPos[0] + (endPos[0]-startPos[0])*tmax;
-				if (x >= lmin && x <= lmax)
-				{
-					nextRef = link->ref;
-					break;
-				}
-			}
-		}
-		
-		// add the cost
-		if (options & DT_RAYCAST_USE_COSTS)
-		{
-			// compute the intersection point at the furthest end of the polygon
-			// and correct the height (since the raycast moves in 2d)
-			dtVcopy(lastPos, curPos);
-			dtVmad(curPos, startPos, dir, hit->t);
-			float* e1 = &verts[segMax*3];
-			float* e2 = &verts[((segMax+1)%nv)*3];
-			float eDir[3], diff[3];
-			dtVsub(eDir, e2, e1);
-			dtVsub(diff, curPos, e1);
-			float s = dtSqr(eDir[0]) > dtSqr(eDir[2]) ? diff[0] / eDir[0] : diff[2] / eDir[2];
-			curPos[1] = e1[1] + eDir[1] * s;
-
-			hit->pathCost += filter->getCost(lastPos, curPos, prevRef, prevTile, prevPoly, curRef, tile, poly, nextRef, nextTile, nextPoly);
-		}
-
-		if (!nextRef)
-		{
-			// No neighbour, we hit a wall.
-			
-			// Calculate hit normal.
-			const int a = segMax;
-			const int b = segMax+1 < nv ? segMax+1 : 0;
-			const float* va = &verts[a*3];
-			const float* vb = &verts[b*3];
-			const float dx = vb[0] - va[0];
-			const float dz = vb[2] - va[2];
-			hit->hitNormal[0] = dz;
-			hit->hitNormal[1] = 0;
-			hit->hitNormal[2] = -dx;
-			dtVnormalize(hit->hitNormal);
-			
-			hit->pathCount = n;
-			return status;
-		}
-
-		// No hit, advance to neighbour polygon.
-		prevRef = curRef;
-		curRef = nextRef;
-		prevTile = tile;
-		tile = nextTile;
-		prevPoly = poly;
-		poly = nextPoly;
-	}
-	
-	hit->pathCount = n;
-	
-	return status;
+	return getPathToNode(endNode, path, pathCount, maxPath);
 }
 
 /// @par
 ///
-/// At least one result array must be provided.
-///
-/// The order of the result set is from least to highest cost to reach the polygon.
+/// This method is optimized for a small search radius and small number of result 
+/// polygons.
 ///
-/// A common use case for this method is to perform Dijkstra searches. 
-/// Candidate polygons are found by searching the graph beginning at the start polygon.
+/// Candidate polygons are found by searching the navigation graph beginning at 
+/// the start polygon.
 ///
-/// If a polygon is not found via the graph search, even if it intersects the 
-/// search circle, it will not be included in the result set. For example:
+/// The same intersection test restrictions that apply to the findPolysAroundCircle 
+/// mehtod applies to this method.
 ///
-/// polyA is the start polygon.
-/// polyB shares an edge with polyA. (Is adjacent.)
-/// polyC shares an edge with polyB, but not with polyA
-/// Even if the search circle overlaps polyC, it will not be included in the 
-/// result set unless polyB is also in the set.
+/// The value of the center point is used as the start point for cost calculations. 
+/// It is not projected onto the surface of the mesh, so its y-value will effect 
+/// the costs.
 /// 
-/// The value of the center point is used as the start position for cost 
-/// calculations. It is not projected onto the surface of the mesh, so its 
-/// y-value will effect the costs.
-///
 /// Intersection tests occur in 2D. All polygons and the search circle are 
 /// projected onto the xz-plane. So the y-value of the center point does not 
 /// effect intersection tests.
-///
-/// If the result arrays are to small to hold the entire result set, they will be 
-/// filled to capacity.
 /// 
-dtStatus dtNavMeshQuery::findPolysAroundCircle(dtPolyRef startRef, const float* centerPos, const float radius,
-											   const dtQueryFilter* filter,
-											   dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
-											   int* resultCount, const int maxResult) const
+/// If the result arrays are is too small to hold the entire result set, they will 
+/// be filled to capacity.
+/// 
+dtStatus dtNavMeshQuery::findLocalNeighbourhood(dtPolyRef startRef, const float* centerPos, const float radius,
+												const dtQueryFilter* filter,
+												dtPolyRef* resultRef, dtPolyRef* resultParent,
+												int* resultCount, const int maxResult) const
 {
 	dtAssert(m_nav);
-	dtAssert(m_nodePool);
-	dtAssert(m_openList);
+	dtAssert(m_tinyNodePool);
 
 	if (!resultCount)
 		return DT_FAILURE | DT_INVALID_PARAM;
@@ -2746,82 +2811,88 @@ dtStatus dtNavMeshQuery::findPolysAroundCircle(dtPolyRef startRef, const float*
 	{
 		return DT_FAILURE | DT_INVALID_PARAM;
 	}
+
+	static const int MAX_STACK = 48;
+	dtNode* stack[MAX_STACK];
+	int nstack = 0;
 	
-	m_nodePool->clear();
-	m_openList->clear();
+	m_tinyNodePool->clear();
 	
-	dtNode* startNode = m_nodePool->getNode(startRef);
-	dtVcopy(startNode->pos, centerPos);
+	dtNode* startNode = m_tinyNodePool->getNode(startRef);
 	startNode->pidx = 0;
-	startNode->cost = 0;
-	startNode->total = 0;
 	startNode->id = startRef;
-	startNode->flags = DT_NODE_OPEN;
-	m_openList->push(startNode);
+	startNode->flags = DT_NODE_CLOSED;
+	stack[nstack++] = startNode;
+	
+	const float radiusSqr = dtSqr(radius);
+	
+	float pa[DT_VERTS_PER_POLYGON*3];
+	float pb[DT_VERTS_PER_POLYGON*3];
 	
 	dtStatus status = DT_SUCCESS;
 	
 	int n = 0;
+	if (n < maxResult)
+	{
+		resultRef[n] = startNode->id;
+		if (resultParent)
+			resultParent[n] = 0;
+		++n;
+	}
+	else
+	{
+		status |= DT_BUFFER_TOO_SMALL;
+	}
 	
-	const float radiusSqr = dtSqr(radius);
-	
-	while (!m_openList->empty())
+	while (nstack)
 	{
-		dtNode* bestNode = m_openList->pop();
-		bestNode->flags &= ~DT_NODE_OPEN;
-		bestNode->flags |= DT_NODE_CLOSED;
+		// Pop front.
+		dtNode* curNode = stack[0];
+		for (int i = 0; i < nstack-1; ++i)
+			stack[i] = stack[i+1];
+		nstack--;
 		
 		// Get poly and tile.
 		// The API input has been cheked already, skip checking internal data.
-		const dtPolyRef bestRef = bestNode->id;
-		const dtMeshTile* bestTile = 0;
-		const dtPoly* bestPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
-		
-		// Get parent poly and tile.
-		dtPolyRef parentRef = 0;
-		const dtMeshTile* parentTile = 0;
-		const dtPoly* parentPoly = 0;
-		if (bestNode->pidx)
-			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
-		if (parentRef)
-			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
-
-		if (n < maxResult)
-		{
-			if (resultRef)
-				resultRef[n] = bestRef;
-			if (resultParent)
-				resultParent[n] = parentRef;
-			if (resultCost)
-				resultCost[n] = bestNode->total;
-			++n;
-		}
-		else
-		{
-			status |= DT_BUFFER_TOO_SMALL;
-		}
+		const dtPolyRef curRef = curNode->id;
+		const dtMeshTile* curTile = 0;
+		const dtPoly* curPoly = 0;
+		if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(curRef, &curTile, &curPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
 		
-		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+		for (unsigned int i = curPoly->firstLink; i != DT_NULL_LINK; i = curTile->links[i].next)
 		{
-			const dtLink* link = &bestTile->links[i];
+			const dtLink* link = &curTile->links[i];
 			dtPolyRef neighbourRef = link->ref;
-			// Skip invalid neighbours and do not follow back to parent.
-			if (!neighbourRef || neighbourRef == parentRef)
+			// Skip invalid neighbours.
+			if (!neighbourRef)
+				continue;
+			
+			// Skip if cannot alloca more nodes.
+			dtNode* neighbourNode = m_tinyNodePool->getNode(neighbourRef);
+			if (!neighbourNode)
+				continue;
+			// Skip visited.
+			if (neighbourNode->flags & DT_NODE_CLOSED)
 				continue;
 			
 			// Expand to neighbour
 			const dtMeshTile* neighbourTile = 0;
 			const dtPoly* neighbourPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
-		
+			if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly)))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+			
+			// Skip off-mesh connections.
+			if (neighbourPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
+				continue;
+			
 			// Do not advance if the polygon is excluded by the filter.
 			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
 				continue;
 			
 			// Find edge and calc distance to the edge.
 			float va[3], vb[3];
-			if (!getPortalPoints(bestRef, bestPoly, bestTile, neighbourRef, neighbourPoly, neighbourTile, va, vb))
+			if (!getPortalPoints(curRef, curPoly, curTile, neighbourRef, neighbourPoly, neighbourTile, va, vb))
 				continue;
 			
 			// If the circle is not touching the next polygon, skip it.
@@ -2830,44 +2901,72 @@ dtStatus dtNavMeshQuery::findPolysAroundCircle(dtPolyRef startRef, const float*
 			if (distSqr > radiusSqr)
 				continue;
 			
-			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef);
-			if (!neighbourNode)
-			{
-				status |= DT_OUT_OF_NODES;
-				continue;
-			}
-				
-			if (neighbourNode->flags & DT_NODE_CLOSED)
-				continue;
+			// Mark node visited, this is done before the overlap test so that
+			// we will not visit the poly again if the test fails.
+			neighbourNode->flags |= DT_NODE_CLOSED;
+			neighbourNode->pidx = m_tinyNodePool->getNodeIdx(curNode);
 			
-			// Cost
-			if (neighbourNode->flags == 0)
-				dtVlerp(neighbourNode->pos, va, vb, 0.5f);
+			// Check that the polygon does not collide with existing polygons.
 			
-			float cost = filter->getCost(
-				bestNode->pos, neighbourNode->pos,
-				parentRef, parentTile, parentPoly,
-				bestRef, bestTile, bestPoly,
-				neighbourRef, neighbourTile, neighbourPoly);
-
-			const float total = bestNode->total + cost;
+			// Collect vertices of the neighbour poly.
+			const int npa = neighbourPoly->vertCount;
+			for (int k = 0; k < npa; ++k)
+				dtVcopy(&pa[k*3], neighbourTile->getVert(neighbourPoly->verts[k], &pa[k*3]));
 			
-			// The node is already in open list and the new result is worse, skip.
-			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+			bool overlap = false;
+			for (int j = 0; j < n; ++j)
+			{
+				dtPolyRef pastRef = resultRef[j];
+				
+				// Connected polys do not overlap.
+				bool connected = false;
+				for (unsigned int k = curPoly->firstLink; k != DT_NULL_LINK; k = curTile->links[k].next)
+				{
+					if (curTile->links[k].ref == pastRef)
+					{
+						connected = true;
+						break;
+					}
+				}
+				if (connected)
+					continue;
+				
+				// Potentially overlapping.
+				const dtMeshTile* pastTile = 0;
+				const dtPoly* pastPoly = 0;
+				if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(pastRef, &pastTile, &pastPoly)))
+					return DT_FAILURE | DT_OUT_OF_MEMORY;
+				
+				// Get vertices and test overlap
+				const int npb = pastPoly->vertCount;
+				for (int k = 0; k < npb; ++k)
+					dtVcopy(&pb[k*3], pastTile->getVert(pastPoly->verts[k], &pb[k*3]));
+				
+				if (dtOverlapPolyPoly2D(pa,npa, pb,npb))
+				{
+					overlap = true;
+					break;
+				}
+			}
+			if (overlap)
 				continue;
 			
-			neighbourNode->id = neighbourRef;
-			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
-			neighbourNode->total = total;
-			
-			if (neighbourNode->flags & DT_NODE_OPEN)
+			// This poly is fine, store and advance to the poly.
+			if (n < maxResult)
 			{
-				m_openList->modify(neighbourNode);
+				resultRef[n] = neighbourRef;
+				if (resultParent)
+					resultParent[n] = curRef;
+				++n;
 			}
 			else
 			{
-				neighbourNode->flags = DT_NODE_OPEN;
-				m_openList->push(neighbourNode);
+				status |= DT_BUFFER_TOO_SMALL;
+			}
+			
+			if (nstack < MAX_STACK)
+			{
+				stack[nstack++] = neighbourNode;
 			}
 		}
 	}
@@ -2877,61 +2976,225 @@ dtStatus dtNavMeshQuery::findPolysAroundCircle(dtPolyRef startRef, const float*
 	return status;
 }
 
+
+struct dtSegInterval
+{
+	dtPolyRef ref;
+	short tmin, tmax;
+};
+
+static void insertInterval(dtSegInterval* ints, int& nints, const int maxInts,
+						   const short tmin, const short tmax, const dtPolyRef ref)
+{
+	if (nints+1 > maxInts) return;
+	// Find insertion point.
+	int idx = 0;
+	while (idx < nints)
+	{
+		if (tmax <= ints[idx].tmin)
+			break;
+		idx++;
+	}
+	// Move current results.
+	if (nints-idx)
+		memmove(ints+idx+1, ints+idx, sizeof(dtSegInterval)*(nints-idx));
+	// Store
+	ints[idx].ref = ref;
+	ints[idx].tmin = tmin;
+	ints[idx].tmax = tmax;
+	nints++;
+}
+
 /// @par
 ///
-/// The order of the result set is from least to highest cost.
-/// 
-/// At least one result array must be provided.
-///
-/// A common use case for this method is to perform Dijkstra searches. 
-/// Candidate polygons are found by searching the graph beginning at the start 
-/// polygon.
-/// 
-/// The same intersection test restrictions that apply to findPolysAroundCircle()
-/// method apply to this method.
+/// If the @p segmentRefs parameter is provided, then all polygon segments will be returned. 
+/// Otherwise only the wall segments are returned.
 /// 
-/// The 3D centroid of the search polygon is used as the start position for cost 
-/// calculations.
+/// A segment that is normally a portal will be included in the result set as a 
+/// wall if the @p filter results in the neighbor polygon becoomming impassable.
 /// 
-/// Intersection tests occur in 2D. All polygons are projected onto the 
-/// xz-plane. So the y-values of the vertices do not effect intersection tests.
+/// The @p segmentVerts and @p segmentRefs buffers should normally be sized for the 
+/// maximum segments per polygon of the source navigation mesh.
 /// 
-/// If the result arrays are is too small to hold the entire result set, they will 
-/// be filled to capacity.
-///
-dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* verts, const int nverts,
-											  const dtQueryFilter* filter,
-											  dtPolyRef* resultRef, dtPolyRef* resultParent, float* resultCost,
-											  int* resultCount, const int maxResult) const
+dtStatus dtNavMeshQuery::getPolyWallSegments(dtPolyRef ref, const dtQueryFilter* filter,
+											 float* segmentVerts, dtPolyRef* segmentRefs, int* segmentCount,
+											 const int maxSegments) const
 {
 	dtAssert(m_nav);
-	dtAssert(m_nodePool);
-	dtAssert(m_openList);
 
-	if (!resultCount)
+	if (!segmentCount)
 		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	*segmentCount = 0;
 
-	*resultCount = 0;
+	const dtMeshTile* tile = 0;
+	const dtPoly* poly = 0;
+	if (dtStatusFailed(m_nav->getTileAndPolyByRef(ref, &tile, &poly)))
+		return DT_FAILURE | DT_INVALID_PARAM;
 
-	if (!m_nav->isValidPolyRef(startRef) ||
-		!verts || nverts < 3 ||
-		!filter || maxResult < 0)
-	{
+	if (!filter || !segmentVerts || maxSegments < 0)
 		return DT_FAILURE | DT_INVALID_PARAM;
+	
+	int n = 0;
+	static const int MAX_INTERVAL = 16;
+	dtSegInterval ints[MAX_INTERVAL];
+	int nints;
+	
+	const bool storePortals = segmentRefs != 0;
+	
+	dtStatus status = DT_SUCCESS;
+	
+	for (int i = 0, j = (int)poly->vertCount-1; i < (int)poly->vertCount; j = i++)
+	{
+		// Skip non-solid edges.
+		nints = 0;
+		if (poly->neis[j] & DT_EXT_LINK)
+		{
+			// Tile border.
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				const dtLink* link = &tile->links[k];
+				if (link->edge == j)
+				{
+					if (link->ref != 0)
+					{
+						const dtMeshTile* neiTile = 0;
+						const dtPoly* neiPoly = 0;
+						if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(link->ref, &neiTile, &neiPoly)))
+							return DT_FAILURE | DT_OUT_OF_MEMORY;
+						if (filter->passFilter(link->ref, neiTile, neiPoly))
+						{
+							insertInterval(ints, nints, MAX_INTERVAL, link->bmin, link->bmax, link->ref);
+						}
+					}
+				}
+			}
+		}
+		else
+		{
+			// Internal edge
+			dtPolyRef neiRef = 0;
+			if (poly->neis[j])
+			{
+				const unsigned int idx = (unsigned int)(poly->neis[j]-1);
+				neiRef = m_nav->getPolyRefBase(tile) | idx;
+				if (!filter->passFilter(neiRef, tile, &tile->polys[idx]))
+					neiRef = 0;
+			}
+
+			// If the edge leads to another polygon and portals are not stored, skip.
+			if (neiRef != 0 && !storePortals)
+				continue;
+			
+			if (n < maxSegments)
+			{
+				float tj[3], ti[3];
+				const float* vj = tile->getVert(poly->verts[j], tj);
+				const float* vi = tile->getVert(poly->verts[i], ti);
+				float* seg = &segmentVerts[n*6];
+				dtVcopy(seg+0, vj);
+				dtVcopy(seg+3, vi);
+				if (segmentRefs)
+					segmentRefs[n] = neiRef;
+				n++;
+			}
+			else
+			{
+				status |= DT_BUFFER_TOO_SMALL;
+			}
+			
+			continue;
+		}
+		
+		// Add sentinels
+		insertInterval(ints, nints, MAX_INTERVAL, -1, 0, 0);
+		insertInterval(ints, nints, MAX_INTERVAL, 255, 256, 0);
+		
+		// Store segments.
+		float tj[3], ti[3];
+		const float* vj = tile->getVert(poly->verts[j], tj);
+		const float* vi = tile->getVert(poly->verts[i], ti);
+		for (int k = 1; k < nints; ++k)
+		{
+			// Portal segment.
+			if (storePortals && ints[k].ref)
+			{
+				const float tmin = ints[k].tmin/255.0f; 
+				const float tmax = ints[k].tmax/255.0f; 
+				if (n < maxSegments)
+				{
+					float* seg = &segmentVerts[n*6];
+					dtVlerp(seg+0, vj,vi, tmin);
+					dtVlerp(seg+3, vj,vi, tmax);
+					if (segmentRefs)
+						segmentRefs[n] = ints[k].ref;
+					n++;
+				}
+				else
+				{
+					status |= DT_BUFFER_TOO_SMALL;
+				}
+			}
+
+			// Wall segment.
+			const int imin = ints[k-1].tmax;
+			const int imax = ints[k].tmin;
+			if (imin != imax)
+			{
+				const float tmin = imin/255.0f; 
+				const float tmax = imax/255.0f; 
+				if (n < maxSegments)
+				{
+					float* seg = &segmentVerts[n*6];
+					dtVlerp(seg+0, vj,vi, tmin);
+					dtVlerp(seg+3, vj,vi, tmax);
+					if (segmentRefs)
+						segmentRefs[n] = 0;
+					n++;
+				}
+				else
+				{
+					status |= DT_BUFFER_TOO_SMALL;
+				}
+			}
+		}
 	}
 	
+	*segmentCount = n;
+	
+	return status;
+}
+
+/// @par
+///
+/// @p hitPos is not adjusted using the height detail data.
+///
+/// @p hitDist will equal the search radius if there is no wall within the 
+/// radius. In this case the values of @p hitPos and @p hitNormal are
+/// undefined.
+///
+/// The normal will become unpredicable if @p hitDist is a very small number.
+///
+dtStatus dtNavMeshQuery::findDistanceToWall(dtPolyRef startRef, const float* centerPos, const float maxRadius,
+											const dtQueryFilter* filter,
+											float* hitDist, float* hitPos, float* hitNormal) const
+{
+	dtAssert(m_nav);
+	dtAssert(m_nodePool);
+	dtAssert(m_openList);
+	
 	// Validate input
-	if (!startRef || !m_nav->isValidPolyRef(startRef))
+	if (!m_nav->isValidPolyRef(startRef) ||
+		!centerPos || !dtVisfinite(centerPos) ||
+		maxRadius < 0 || !dtMathIsfinite(maxRadius) ||
+		!filter || !hitDist || !hitPos || !hitNormal)
+	{
 		return DT_FAILURE | DT_INVALID_PARAM;
+	}
 	
 	m_nodePool->clear();
 	m_openList->clear();
 	
-	float centerPos[3] = {0,0,0};
-	for (int i = 0; i < nverts; ++i)
-		dtVadd(centerPos,centerPos,&verts[i*3]);
-	dtVscale(centerPos,centerPos,1.0f/nverts);
-
 	dtNode* startNode = m_nodePool->getNode(startRef);
 	dtVcopy(startNode->pos, centerPos);
 	startNode->pidx = 0;
@@ -2941,9 +3204,9 @@ dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* v
 	startNode->flags = DT_NODE_OPEN;
 	m_openList->push(startNode);
 	
+	float radiusSqr = dtSqr(maxRadius);
+	
 	dtStatus status = DT_SUCCESS;
-
-	int n = 0;
 	
 	while (!m_openList->empty())
 	{
@@ -2956,7 +3219,8 @@ dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* v
 		const dtPolyRef bestRef = bestNode->id;
 		const dtMeshTile* bestTile = 0;
 		const dtPoly* bestPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
+		if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
 		
 		// Get parent poly and tile.
 		dtPolyRef parentRef = 0;
@@ -2964,26 +3228,65 @@ dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* v
 		const dtPoly* parentPoly = 0;
 		if (bestNode->pidx)
 			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
-		if (parentRef)
-			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
-
-		if (n < maxResult)
-		{
-			if (resultRef)
-				resultRef[n] = bestRef;
-			if (resultParent)
-				resultParent[n] = parentRef;
-			if (resultCost)
-				resultCost[n] = bestNode->total;
-
-			++n;
-		}
-		else
-		{
-			status |= DT_BUFFER_TOO_SMALL;
-		}
+		if (parentRef && dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
 		
-		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
+		// Hit test walls.
+		for (int i = 0, j = (int)bestPoly->vertCount-1; i < (int)bestPoly->vertCount; j = i++)
+		{
+			// Skip non-solid edges.
+			if (bestPoly->neis[j] & DT_EXT_LINK)
+			{
+				// Tile border.
+				bool solid = true;
+				for (unsigned int k = bestPoly->firstLink; k != DT_NULL_LINK; k = bestTile->links[k].next)
+				{
+					const dtLink* link = &bestTile->links[k];
+					if (link->edge == j)
+					{
+						if (link->ref != 0)
+						{
+							const dtMeshTile* neiTile = 0;
+							const dtPoly* neiPoly = 0;
+							if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(link->ref, &neiTile, &neiPoly)))
+								return DT_FAILURE | DT_OUT_OF_MEMORY;
+							if (filter->passFilter(link->ref, neiTile, neiPoly))
+								solid = false;
+						}
+						break;
+					}
+				}
+				if (!solid) continue;
+			}
+			else if (bestPoly->neis[j])
+			{
+				// Internal edge
+				const unsigned int idx = (unsigned int)(bestPoly->neis[j]-1);
+				const dtPolyRef ref = m_nav->getPolyRefBase(bestTile) | idx;
+				if (filter->passFilter(ref, bestTile, &bestTile->polys[idx]))
+					continue;
+			}
+			
+			// Calc distance to the edge.
+			float tj[3], ti[3];
+			const float* vj = bestTile->getVert(bestPoly->verts[j], tj);
+			const float* vi = bestTile->getVert(bestPoly->verts[i], ti);
+			float tseg;
+			float distSqr = dtDistancePtSegSqr2D(centerPos, vj, vi, tseg);
+			
+			// Edge is too far, skip.
+			if (distSqr > radiusSqr)
+				continue;
+			
+			// Hit wall, update radius.
+			radiusSqr = distSqr;
+			// Calculate hit pos.
+			hitPos[0] = vj[0] + (vi[0] - vj[0])*tseg;
+			hitPos[1] = vj[1] + (vi[1] - vj[1])*tseg;
+			hitPos[2] = vj[2] + (vi[2] - vj[2])*tseg;
+		}
+		
+		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
 		{
 			const dtLink* link = &bestTile->links[i];
 			dtPolyRef neighbourRef = link->ref;
@@ -2991,28 +3294,30 @@ dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* v
 			if (!neighbourRef || neighbourRef == parentRef)
 				continue;
 			
-			// Expand to neighbour
+			// Expand to neighbour.
 			const dtMeshTile* neighbourTile = 0;
 			const dtPoly* neighbourPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
+			if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly)))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
 			
-			// Do not advance if the polygon is excluded by the filter.
-			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+			// Skip off-mesh connections.
+			if (neighbourPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
 				continue;
 			
-			// Find edge and calc distance to the edge.
-			float va[3], vb[3];
-			if (!getPortalPoints(bestRef, bestPoly, bestTile, neighbourRef, neighbourPoly, neighbourTile, va, vb))
-				continue;
+			// Calc distance to the edge.
+			float ta[3], tb[3];
+			const float* va = bestTile->getVert(bestPoly->verts[link->edge], ta);
+			const float* vb = bestTile->getVert(bestPoly->verts[(link->edge+1) % bestPoly->vertCount], tb);
+			float tseg;
+			float distSqr = dtDistancePtSegSqr2D(centerPos, va, vb, tseg);
 			
-			// If the poly is not touching the edge to the next polygon, skip the connection it.
-			float tmin, tmax;
-			int segMin, segMax;
-			if (!dtIntersectSegmentPoly2D(va, vb, verts, nverts, tmin, tmax, segMin, segMax))
-				continue;
-			if (tmin > 1.0f || tmax < 0.0f)
+			// If the circle is not touching the next polygon, skip it.
+			if (distSqr > radiusSqr)
 				continue;
 			
+			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+
 			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef);
 			if (!neighbourNode)
 			{
@@ -3025,593 +3330,751 @@ dtStatus dtNavMeshQuery::findPolysAroundShape(dtPolyRef startRef, const float* v
 			
 			// Cost
 			if (neighbourNode->flags == 0)
-				dtVlerp(neighbourNode->pos, va, vb, 0.5f);
+			{
+				getEdgeMidPoint(bestRef, bestPoly, bestTile,
+								neighbourRef, neighbourPoly, neighbourTile, neighbourNode->pos);
+			}
 			
-			float cost = filter->getCost(
-				bestNode->pos, neighbourNode->pos,
-				parentRef, parentTile, parentPoly,
-				bestRef, bestTile, bestPoly,
-				neighbourRef, neighbourTile, neighbourPoly);
-
-			const float total = bestNode->total + cost;
+			const float total = bestNode->total + dtVdist(bestNode->pos, neighbourNode->pos);
 			
 			// The node is already in open list and the new result is worse, skip.
 			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
 				continue;
 			
 			neighbourNode->id = neighbourRef;
+			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
 			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
 			neighbourNode->total = total;
-			
+				
 			if (neighbourNode->flags & DT_NODE_OPEN)
 			{
 				m_openList->modify(neighbourNode);
 			}
 			else
 			{
-				neighbourNode->flags = DT_NODE_OPEN;
+				neighbourNode->flags |= DT_NODE_OPEN;
 				m_openList->push(neighbourNode);
 			}
 		}
 	}
 	
-	*resultCount = n;
+	// Calc hit normal.
+	dtVsub(hitNormal, centerPos, hitPos);
+	dtVnormalize(hitNormal);
+	
+	*hitDist = dtMathSqrtf(radiusSqr);
 	
 	return status;
 }
 
-dtStatus dtNavMeshQuery::getPathFromDijkstraSearch(dtPolyRef endRef, dtPolyRef* path, int* pathCount, int maxPath) const
+static dtStatus getPolyCenter(const dtNavMesh* nav, dtPolyRef ref, float* center)
 {
-	if (!m_nav->isValidPolyRef(endRef) || !path || !pathCount || maxPath < 0)
-		return DT_FAILURE | DT_INVALID_PARAM;
-
-	*pathCount = 0;
+	const dtMeshTile* tile = 0;
+	const dtPoly* poly = 0;
+	if (dtStatusFailed(nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly)))
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 
-	dtNode* endNode;
-	if (m_nodePool->findNodes(endRef, &endNode, 1) != 1 ||
-		(endNode->flags & DT_NODE_CLOSED) == 0)
-		return DT_FAILURE | DT_INVALID_PARAM;
+	dtVset(center, 0, 0, 0);
+	for (int i = 0; i < (int)poly->vertCount; ++i)
+	{
+		float tmp[3];
+		dtVadd(center, center, tile->getVert(poly->verts[i], tmp));
+	}
+	dtVscale(center, center, 1.0f / poly->vertCount);
 
-	return getPathToNode(endNode, path, pathCount, maxPath);
+	return DT_SUCCESS;
 }
 
 /// @par
 ///
-/// This method is optimized for a small search radius and small number of result 
-/// polygons.
+/// The landmarks are placed one at a time, each on the polygon farthest from the
+/// landmarks placed before it, and a search from each landmark finds its cost to every
+/// polygon. The searches follow the links both ways, so that the costs bound the cost of
+/// the paths in either direction. Each landmark takes a search over the whole mesh, which
+/// is why the number of landmarks updated per call is limited by @p maxUpdates.
 ///
-/// Candidate polygons are found by searching the navigation graph beginning at 
-/// the start polygon.
+/// The tiles added or removed since the last call are found here, and mark every landmark
+/// out of date. The landmarks that are out of date are not used by the heuristic until
+/// they have been updated again. The landmarks on removed tiles are placed again.
 ///
-/// The same intersection test restrictions that apply to the findPolysAroundCircle 
-/// mehtod applies to this method.
+/// The query needs a node for each polygon reached by a landmark. If the node pool
+/// runs out, the polygons not reached have no cost bound and #DT_OUT_OF_NODES is returned.
 ///
-/// The value of the center point is used as the start point for cost calculations. 
-/// It is not projected onto the surface of the mesh, so its y-value will effect 
-/// the costs.
-/// 
-/// Intersection tests occur in 2D. All polygons and the search circle are 
-/// projected onto the xz-plane. So the y-value of the center point does not 
-/// effect intersection tests.
-/// 
-/// If the result arrays are is too small to hold the entire result set, they will 
-/// be filled to capacity.
-/// 
-dtStatus dtNavMeshQuery::findLocalNeighbourhood(dtPolyRef startRef, const float* centerPos, const float radius,
-												const dtQueryFilter* filter,
-												dtPolyRef* resultRef, dtPolyRef* resultParent,
-												int* resultCount, const int maxResult) const
+/// The landmarks keep the fingerprint of @p filter (See: #dtGetQueryFilterKey), and
+/// findPath only uses their cost bounds with filters of the same fingerprint. Updating the
+/// landmarks with a filter of another fingerprint marks every landmark out of date.
+///
+dtStatus dtNavMeshQuery::updateLandmarks(dtNavMeshLandmarks* landmarks, const dtQueryFilter* filter,
+										 const int maxUpdates, bool* upToDate)
 {
 	dtAssert(m_nav);
-	dtAssert(m_tinyNodePool);
+	dtAssert(m_nodePool);
+	dtAssert(m_openList);
 
-	if (!resultCount)
+	if (upToDate)
+		*upToDate = false;
+
+	if (!landmarks || landmarks->getNavMesh() != m_nav || !filter || maxUpdates < 0)
 		return DT_FAILURE | DT_INVALID_PARAM;
 
-	*resultCount = 0;
+	dtStatus status = DT_SUCCESS;
 
-	if (!m_nav->isValidPolyRef(startRef) ||
-		!centerPos || !dtVisfinite(centerPos) ||
-		radius < 0 || !dtMathIsfinite(radius) ||
-		!filter || maxResult < 0)
+	const unsigned int filterKey = dtGetQueryFilterKey(filter);
+	if (landmarks->m_filterKey != filterKey)
 	{
-		return DT_FAILURE | DT_INVALID_PARAM;
+		landmarks->m_filterKey = filterKey;
+		landmarks->invalidate();
 	}
 
-	static const int MAX_STACK = 48;
-	dtNode* stack[MAX_STACK];
-	int nstack = 0;
-	
-	m_tinyNodePool->clear();
-	
-	dtNode* startNode = m_tinyNodePool->getNode(startRef);
-	startNode->pidx = 0;
-	startNode->id = startRef;
-	startNode->flags = DT_NODE_CLOSED;
-	stack[nstack++] = startNode;
-	
-	const float radiusSqr = dtSqr(radius);
-	
-	float pa[DT_VERTS_PER_POLYGON*3];
-	float pb[DT_VERTS_PER_POLYGON*3];
-	
-	dtStatus status = DT_SUCCESS;
-	
-	int n = 0;
-	if (n < maxResult)
+	bool outOfMemory = false;
+	landmarks->syncTiles(outOfMemory);
+	if (outOfMemory)
+		status |= DT_OUT_OF_MEMORY;
+
+	int updates = 0;
+	for (int i = 0; i < landmarks->m_maxLandmarks && updates < maxUpdates; ++i)
 	{
-		resultRef[n] = startNode->id;
-		if (resultParent)
-			resultParent[n] = 0;
-		++n;
+		if (landmarks->m_upToDateMask & (1u << i))
+			continue;
+
+		// Place the landmarks again if their polygon is gone.
+		dtNavMeshLandmarks::Landmark& landmark = landmarks->m_landmarks[i];
+		if (landmark.ref && !isValidPolyRef(landmark.ref, filter))
+			landmark.ref = 0;
+		dtStatus landmarkStatus = DT_SUCCESS;
+		if (!landmark.ref)
+			landmarkStatus = placeLandmark(landmarks, i, filter);
+		if (dtStatusSucceed(landmarkStatus))
+			landmarkStatus = findLandmarkCosts(landmarks, i, filter);
+
+		// A landmark whose tiles could not be decompressed is updated again by the next call.
+		status |= landmarkStatus;
+		if (dtStatusSucceed(landmarkStatus))
+			landmarks->m_upToDateMask |= 1u << i;
+		updates++;
 	}
-	else
+
+	if (upToDate)
+		*upToDate = landmarks->isUpToDate();
+
+	return status;
+}
+
+/// @par
+///
+/// The landmarks are used until they are replaced. After tiles are added or removed,
+/// call #updateLandmarks before the next path is searched, the cost bounds of the
+/// tiles that did not change could otherwise be too high.
+///
+dtStatus dtNavMeshQuery::setLandmarks(const dtNavMeshLandmarks* landmarks)
+{
+	if (landmarks && landmarks->getNavMesh() != m_nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_landmarks = landmarks;
+
+	return DT_SUCCESS;
+}
+
+/// @par
+///
+/// The islands of the flag set matching the include and exclude flags of the filter are
+/// used. A filter without a matching flag set is always searched.
+///
+/// The filter must pass the polygons that pass its flags, as dtQueryFilter::passFilter does.
+dtStatus dtNavMeshQuery::setIslands(const dtNavMeshIslands* islands)
+{
+	if (islands && islands->getNavMesh() != m_nav)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	m_islands = islands;
+
+	return DT_SUCCESS;
+}
+
+bool dtNavMeshQuery::isReachable(dtPolyRef startRef, dtPolyRef endRef, const dtQueryFilter* filter) const
+{
+	if (!m_islands || !filter)
+		return true;
+	return m_islands->isConnected(startRef, endRef, findIslandFlagSet(filter));
+}
+
+bool dtNavMeshQuery::hasLandmarkCosts(const dtQueryFilter* filter) const
+{
+	return m_landmarks->getFilterKey() == dtGetQueryFilterKey(filter);
+}
+
+int dtNavMeshQuery::findIslandFlagSet(const dtQueryFilter* filter) const
+{
+	return m_islands->findFlagSet(filter->getIncludeFlags(), filter->getExcludeFlags());
+}
+
+dtStatus dtNavMeshQuery::placeLandmark(dtNavMeshLandmarks* landmarks, const int index, const dtQueryFilter* filter)
+{
+	dtNavMeshLandmarks::Landmark& landmark = landmarks->m_landmarks[index];
+	const int stride = landmarks->m_maxLandmarks;
+
+	// Without other landmarks, search from the first polygon to find the one farthest from it.
+	unsigned int mask = landmarks->m_upToDateMask;
+	if (!mask)
 	{
-		status |= DT_BUFFER_TOO_SMALL;
+		for (int i = 0; i < m_nav->getMaxTiles() && !landmark.ref; ++i)
+		{
+			const dtMeshTile* tile = m_nav->peekTile(i);
+			if (!tile->header)
+				continue;
+			if (!m_nav->useTile(tile))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+			const dtPolyRef base = m_nav->getPolyRefBase(tile);
+			for (int j = 0; j < tile->header->polyCount; ++j)
+			{
+				if (filter->passFilter(base | (dtPolyRef)j, tile, &tile->polys[j]))
+				{
+					landmark.ref = base | (dtPolyRef)j;
+					break;
+				}
+			}
+		}
+		if (!landmark.ref)
+			return DT_SUCCESS;
+		dtStatus status = getPolyCenter(m_nav, landmark.ref, landmark.pos);
+		if (dtStatusSucceed(status))
+			status = findLandmarkCosts(landmarks, index, filter);
+		if (dtStatusFailed(status))
+		{
+			landmark.ref = 0;
+			return status;
+		}
+		mask = 1u << index;
 	}
-	
-	while (nstack)
+
+	// Pick the polygon with the highest cost to the nearest landmark.
+	dtPolyRef bestRef = 0;
+	float bestCost = 0;
+	for (int i = 0; i < landmarks->m_maxTiles; ++i)
 	{
-		// Pop front.
-		dtNode* curNode = stack[0];
-		for (int i = 0; i < nstack-1; ++i)
-			stack[i] = stack[i+1];
-		nstack--;
-		
-		// Get poly and tile.
-		// The API input has been cheked already, skip checking internal data.
-		const dtPolyRef curRef = curNode->id;
-		const dtMeshTile* curTile = 0;
-		const dtPoly* curPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(curRef, &curTile, &curPoly);
-		
-		for (unsigned int i = curPoly->firstLink; i != DT_NULL_LINK; i = curTile->links[i].next)
+		const dtNavMeshLandmarks::TileCosts& tc = landmarks->m_tiles[i];
+		for (int j = 0; j < tc.polyCount; ++j)
 		{
-			const dtLink* link = &curTile->links[i];
-			dtPolyRef neighbourRef = link->ref;
-			// Skip invalid neighbours.
-			if (!neighbourRef)
-				continue;
-			
-			// Skip if cannot alloca more nodes.
-			dtNode* neighbourNode = m_tinyNodePool->getNode(neighbourRef);
-			if (!neighbourNode)
-				continue;
-			// Skip visited.
-			if (neighbourNode->flags & DT_NODE_CLOSED)
-				continue;
-			
-			// Expand to neighbour
-			const dtMeshTile* neighbourTile = 0;
-			const dtPoly* neighbourPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
-			
-			// Skip off-mesh connections.
-			if (neighbourPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
-				continue;
-			
-			// Do not advance if the polygon is excluded by the filter.
-			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
-				continue;
-			
-			// Find edge and calc distance to the edge.
-			float va[3], vb[3];
-			if (!getPortalPoints(curRef, curPoly, curTile, neighbourRef, neighbourPoly, neighbourTile, va, vb))
-				continue;
-			
-			// If the circle is not touching the next polygon, skip it.
-			float tseg;
-			float distSqr = dtDistancePtSegSqr2D(centerPos, va, vb, tseg);
-			if (distSqr > radiusSqr)
-				continue;
-			
-			// Mark node visited, this is done before the overlap test so that
-			// we will not visit the poly again if the test fails.
-			neighbourNode->flags |= DT_NODE_CLOSED;
-			neighbourNode->pidx = m_tinyNodePool->getNodeIdx(curNode);
-			
-			// Check that the polygon does not collide with existing polygons.
-			
-			// Collect vertices of the neighbour poly.
-			const int npa = neighbourPoly->vertCount;
-			for (int k = 0; k < npa; ++k)
-				dtVcopy(&pa[k*3], &neighbourTile->verts[neighbourPoly->verts[k]*3]);
-			
-			bool overlap = false;
-			for (int j = 0; j < n; ++j)
+			const float* costs = &tc.costs[j*stride];
+			float cost = FLT_MAX;
+			for (int k = 0; k < stride; ++k)
 			{
-				dtPolyRef pastRef = resultRef[j];
-				
-				// Connected polys do not overlap.
-				bool connected = false;
-				for (unsigned int k = curPoly->firstLink; k != DT_NULL_LINK; k = curTile->links[k].next)
+				if (mask & (1u << k))
+					cost = dtMin(cost, costs[k]);
+			}
+			if (cost != FLT_MAX && cost > bestCost)
+			{
+				bestCost = cost;
+				bestRef = m_nav->encodePolyId(tc.salt, (unsigned int)i, (unsigned int)j);
+			}
+		}
+	}
+
+	landmark.ref = bestRef;
+	if (bestRef && dtStatusFailed(getPolyCenter(m_nav, bestRef, landmark.pos)))
+	{
+		landmark.ref = 0;
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtNavMeshQuery::findLandmarkCosts(dtNavMeshLandmarks* landmarks, const int index, const dtQueryFilter* filter)
+{
+	const int stride = landmarks->m_maxLandmarks;
+	for (int i = 0; i < landmarks->m_maxTiles; ++i)
+	{
+		const dtNavMeshLandmarks::TileCosts& tc = landmarks->m_tiles[i];
+		for (int j = 0; j < tc.polyCount; ++j)
+			tc.costs[j*stride + index] = FLT_MAX;
+	}
+
+	const dtNavMeshLandmarks::Landmark& landmark = landmarks->m_landmarks[index];
+	if (!landmark.ref)
+		return DT_SUCCESS;
+
+	m_nodePool->clear();
+	m_openList->clear();
+
+	dtNode* startNode = m_nodePool->getNode(landmark.ref);
+	dtVcopy(startNode->pos, landmark.pos);
+	startNode->pidx = 0;
+	startNode->cost = 0;
+	startNode->total = 0;
+	startNode->id = landmark.ref;
+	startNode->flags = DT_NODE_OPEN;
+	m_openList->push(startNode);
+
+	dtStatus status = DT_SUCCESS;
+
+	static const int MAX_OFFMESH_TILES = 32;
+	const dtMeshTile* offMeshTiles[MAX_OFFMESH_TILES];
+	const dtMeshTile* offMeshTile = 0;
+	int nOffMeshTiles = 0;
+
+	while (!m_openList->empty())
+	{
+		dtNode* bestNode = m_openList->pop();
+		bestNode->flags &= ~DT_NODE_OPEN;
+		bestNode->flags |= DT_NODE_CLOSED;
+
+		// Get poly and tile.
+		// The API input has been cheked already, skip checking internal data.
+		const dtPolyRef bestRef = bestNode->id;
+		const dtMeshTile* bestTile = 0;
+		const dtPoly* bestPoly = 0;
+		if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+		const dtNavMeshLandmarks::TileCosts& tc = landmarks->m_tiles[m_nav->decodePolyIdTile(bestRef)];
+		if (tc.costs)
+			tc.costs[m_nav->decodePolyIdPoly(bestRef)*stride + index] = bestNode->total;
+
+		// Get parent poly and tile.
+		dtPolyRef parentRef = 0;
+		const dtMeshTile* parentTile = 0;
+		const dtPoly* parentPoly = 0;
+		if (bestNode->pidx)
+			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+		if (parentRef && dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+		// The search also steps back over the off-mesh connections that have no link from
+		// this polygon.
+		if (bestTile != offMeshTile)
+		{
+			offMeshTile = bestTile;
+			nOffMeshTiles = findOffMeshTilesAround(bestTile, offMeshTiles, MAX_OFFMESH_TILES);
+		}
+
+		unsigned int i = bestPoly->firstLink;
+		int itile = 0;
+		int icon = 0;
+		for (;;)
+		{
+			dtPolyRef neighbourRef = 0;
+			bool backward = false;
+			if (i != DT_NULL_LINK)
+			{
+				neighbourRef = bestTile->links[i].ref;
+				i = bestTile->links[i].next;
+			}
+			else if (itile < nOffMeshTiles)
+			{
+				const dtMeshTile* conTile = offMeshTiles[itile];
+				const int ip = conTile->header->offMeshBase + icon;
+				if (++icon == conTile->header->offMeshConCount)
 				{
-					if (curTile->links[k].ref == pastRef)
-					{
-						connected = true;
-						break;
-					}
+					icon = 0;
+					itile++;
 				}
-				if (connected)
+				if (!isLinkedTo(conTile, &conTile->polys[ip], bestRef))
 					continue;
-				
-				// Potentially overlapping.
-				const dtMeshTile* pastTile = 0;
-				const dtPoly* pastPoly = 0;
-				m_nav->getTileAndPolyByRefUnsafe(pastRef, &pastTile, &pastPoly);
-				
-				// Get vertices and test overlap
-				const int npb = pastPoly->vertCount;
-				for (int k = 0; k < npb; ++k)
-					dtVcopy(&pb[k*3], &pastTile->verts[pastPoly->verts[k]*3]);
-				
-				if (dtOverlapPolyPoly2D(pa,npa, pb,npb))
-				{
-					overlap = true;
-					break;
-				}
+				neighbourRef = m_nav->getPolyRefBase(conTile) | (dtPolyRef)ip;
+				if (isLinkedTo(bestTile, bestPoly, neighbourRef))
+					continue;
+				backward = true;
 			}
-			if (overlap)
+			else
+			{
+				break;
+			}
+
+			// Skip invalid neighbours and do not follow back to parent.
+			if (!neighbourRef || neighbourRef == parentRef)
 				continue;
-			
-			// This poly is fine, store and advance to the poly.
-			if (n < maxResult)
+
+			// Expand to neighbour
+			const dtMeshTile* neighbourTile = 0;
+			const dtPoly* neighbourPoly = 0;
+			if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly)))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+			// Do not advance if the polygon is excluded by the filter.
+			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
+				continue;
+
+			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef);
+			if (!neighbourNode)
 			{
-				resultRef[n] = neighbourRef;
-				if (resultParent)
-					resultParent[n] = curRef;
-				++n;
+				status |= DT_OUT_OF_NODES;
+				continue;
 			}
-			else
+
+			if (neighbourNode->flags & DT_NODE_CLOSED)
+				continue;
+
+			// The connections stepped back over have no link to this polygon, their position
+			// is where they land on it.
+			if (neighbourNode->flags == 0)
 			{
-				status |= DT_BUFFER_TOO_SMALL;
+				if (backward)
+					getEdgeMidPoint(neighbourRef, neighbourPoly, neighbourTile,
+									bestRef, bestPoly, bestTile, neighbourNode->pos);
+				else
+					getEdgeMidPoint(bestRef, bestPoly, bestTile,
+									neighbourRef, neighbourPoly, neighbourTile, neighbourNode->pos);
 			}
-			
-			if (nstack < MAX_STACK)
+
+			const float cost = filter->getCost(bestNode->pos, neighbourNode->pos,
+											   parentRef, parentTile, parentPoly,
+											   bestRef, bestTile, bestPoly,
+											   neighbourRef, neighbourTile, neighbourPoly);
+			const float total = bestNode->total + cost;
+
+			// The node is already in open list and the new result is worse, skip.
+			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+				continue;
+
+			neighbourNode->id = neighbourRef;
+			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
+			neighbourNode->total = total;
+
+			if (neighbourNode->flags & DT_NODE_OPEN)
 			{
-				stack[nstack++] = neighbourNode;
+				m_openList->modify(neighbourNode);
+			}
+			else
+			{
+				neighbourNode->flags = DT_NODE_OPEN;
+				m_openList->push(neighbourNode);
 			}
 		}
 	}
-	
-	*resultCount = n;
-	
+
 	return status;
 }
 
-
-struct dtSegInterval
+/// @par
+///
+/// The search uses the node pool of the query, so the field reaches at most as many
+/// polygons as the query has nodes. (See: #init) The polygons it does not reach have
+/// the cost FLT_MAX.
+///
+/// The @p filter pointer is stored and used by #updateFlowField.
+///
+dtStatus dtNavMeshQuery::findFlowField(dtNavMeshFlowField* field, dtPolyRef goalRef, const float* goalPos,
+									   const dtQueryFilter* filter)
 {
-	dtPolyRef ref;
-	short tmin, tmax;
-};
+	dtAssert(m_nav);
 
-static void insertInterval(dtSegInterval* ints, int& nints, const int maxInts,
-						   const short tmin, const short tmax, const dtPolyRef ref)
-{
-	if (nints+1 > maxInts) return;
-	// Find insertion point.
-	int idx = 0;
-	while (idx < nints)
+	if (!field || field->getNavMesh() != m_nav || !m_nav->isValidPolyRef(goalRef) ||
+		!goalPos || !dtVisfinite(goalPos) || !filter)
 	{
-		if (tmax <= ints[idx].tmin)
-			break;
-		idx++;
+		return DT_FAILURE | DT_INVALID_PARAM;
 	}
-	// Move current results.
-	if (nints-idx)
-		memmove(ints+idx+1, ints+idx, sizeof(dtSegInterval)*(nints-idx));
-	// Store
-	ints[idx].ref = ref;
-	ints[idx].tmin = tmin;
-	ints[idx].tmax = tmax;
-	nints++;
+
+	field->m_goalRef = goalRef;
+	dtVcopy(field->m_goalPos, goalPos);
+	field->m_filter = filter;
+	for (int i = 0; i < field->m_maxTiles; ++i)
+		field->m_tiles[i].dirty = true;
+
+	return updateFlowField(field);
 }
 
 /// @par
 ///
-/// If the @p segmentRefs parameter is provided, then all polygon segments will be returned. 
-/// Otherwise only the wall segments are returned.
-/// 
-/// A segment that is normally a portal will be included in the result set as a 
-/// wall if the @p filter results in the neighbor polygon becoomming impassable.
-/// 
-/// The @p segmentVerts and @p segmentRefs buffers should normally be sized for the 
-/// maximum segments per polygon of the source navigation mesh.
-/// 
-dtStatus dtNavMeshQuery::getPolyWallSegments(dtPolyRef ref, const dtQueryFilter* filter,
-											 float* segmentVerts, dtPolyRef* segmentRefs, int* segmentCount,
-											 const int maxSegments) const
+/// Only the polygons whose path to the goal crosses a changed tile, and the polygons
+/// whose path gets cheaper through the changed tiles, are searched again.
+///
+dtStatus dtNavMeshQuery::updateFlowField(dtNavMeshFlowField* field)
 {
 	dtAssert(m_nav);
 
-	if (!segmentCount)
+	if (!field || field->getNavMesh() != m_nav || !field->m_filter)
 		return DT_FAILURE | DT_INVALID_PARAM;
-	
-	*segmentCount = 0;
 
-	const dtMeshTile* tile = 0;
-	const dtPoly* poly = 0;
-	if (dtStatusFailed(m_nav->getTileAndPolyByRef(ref, &tile, &poly)))
-		return DT_FAILURE | DT_INVALID_PARAM;
+	if (!field->syncTiles())
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
 
-	if (!filter || !segmentVerts || maxSegments < 0)
-		return DT_FAILURE | DT_INVALID_PARAM;
-	
-	int n = 0;
-	static const int MAX_INTERVAL = 16;
-	dtSegInterval ints[MAX_INTERVAL];
-	int nints;
-	
-	const bool storePortals = segmentRefs != 0;
-	
-	dtStatus status = DT_SUCCESS;
-	
-	for (int i = 0, j = (int)poly->vertCount-1; i < (int)poly->vertCount; j = i++)
+	// Nothing reaches a goal that is gone.
+	if (!m_nav->isValidPolyRef(field->m_goalRef))
 	{
-		// Skip non-solid edges.
-		nints = 0;
-		if (poly->neis[j] & DT_EXT_LINK)
+		for (int i = 0; i < field->m_maxTiles; ++i)
 		{
-			// Tile border.
-			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			dtNavMeshFlowField::TileField& tf = field->m_tiles[i];
+			for (int j = 0; j < tf.polyCount; ++j)
 			{
-				const dtLink* link = &tile->links[k];
-				if (link->edge == j)
+				tf.costs[j] = FLT_MAX;
+				tf.next[j] = 0;
+			}
+			tf.dirty = false;
+		}
+		return DT_FAILURE;
+	}
+
+	return repairFlowField(field);
+}
+
+dtStatus dtNavMeshQuery::repairFlowField(dtNavMeshFlowField* field)
+{
+	dtAssert(m_nodePool);
+	dtAssert(m_openList);
+
+	dtNavMeshFlowField::TileField* tiles = field->m_tiles;
+	const int maxTiles = field->m_maxTiles;
+	const dtQueryFilter* filter = field->m_filter;
+
+	int* offsets = (int*)dtAlloc(sizeof(int)*maxTiles, DT_ALLOC_TEMP);
+	if (!offsets)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	int polyCount = 0;
+	for (int i = 0; i < maxTiles; ++i)
+	{
+		offsets[i] = polyCount;
+		polyCount += tiles[i].polyCount;
+	}
+
+	// 0: not visited, 1: the path to the goal is kept, 2: it is not known, 3: being visited.
+	unsigned char* marks = (unsigned char*)dtAlloc(polyCount + 1, DT_ALLOC_TEMP);
+	int* stack = (int*)dtAlloc(sizeof(int)*(polyCount + 1), DT_ALLOC_TEMP);
+	if (!marks || !stack)
+	{
+		dtFree(offsets);
+		dtFree(marks);
+		dtFree(stack);
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+	memset(marks, 0, polyCount);
+
+	// Drop the paths that cross the changed tiles. Each path is followed until it reaches
+	// the goal, or a polygon whose path is known to be kept or dropped.
+	for (int i = 0; i < maxTiles; ++i)
+	{
+		for (int j = 0; j < tiles[i].polyCount; ++j)
+		{
+			unsigned int it = (unsigned int)i, ip = (unsigned int)j;
+			int nstack = 0;
+			unsigned char mark = 2;
+			for (;;)
+			{
+				const int idx = offsets[it] + (int)ip;
+				if (marks[idx])
 				{
-					if (link->ref != 0)
-					{
-						const dtMeshTile* neiTile = 0;
-						const dtPoly* neiPoly = 0;
-						m_nav->getTileAndPolyByRefUnsafe(link->ref, &neiTile, &neiPoly);
-						if (filter->passFilter(link->ref, neiTile, neiPoly))
-						{
-							insertInterval(ints, nints, MAX_INTERVAL, link->bmin, link->bmax, link->ref);
-						}
-					}
+					mark = marks[idx] == 3 ? 2 : marks[idx];
+					break;
+				}
+				marks[idx] = 3;
+				stack[nstack++] = idx;
+
+				const dtNavMeshFlowField::TileField& tf = tiles[it];
+				if (tf.dirty || tf.costs[ip] == FLT_MAX)
+					break;
+				if (!tf.next[ip])
+				{
+					if (m_nav->encodePolyId(tf.salt, it, ip) == field->m_goalRef)
+						mark = 1;
+					break;
 				}
+				unsigned int salt;
+				m_nav->decodePolyId(tf.next[ip], salt, it, ip);
+				if (it >= (unsigned int)maxTiles || tiles[it].salt != salt || ip >= (unsigned int)tiles[it].polyCount)
+					break;
 			}
+			for (int k = 0; k < nstack; ++k)
+				marks[stack[k]] = mark;
 		}
-		else
+	}
+	dtFree(stack);
+
+	for (int i = 0; i < maxTiles; ++i)
+	{
+		dtNavMeshFlowField::TileField& tf = tiles[i];
+		for (int j = 0; j < tf.polyCount; ++j)
 		{
-			// Internal edge
-			dtPolyRef neiRef = 0;
-			if (poly->neis[j])
+			if (marks[offsets[i] + j] == 2)
 			{
-				const unsigned int idx = (unsigned int)(poly->neis[j]-1);
-				neiRef = m_nav->getPolyRefBase(tile) | idx;
-				if (!filter->passFilter(neiRef, tile, &tile->polys[idx]))
-					neiRef = 0;
+				tf.costs[j] = FLT_MAX;
+				tf.next[j] = 0;
 			}
+		}
+	}
 
-			// If the edge leads to another polygon and portals are not stored, skip.
-			if (neiRef != 0 && !storePortals)
+	m_nodePool->clear();
+	m_openList->clear();
+
+	dtStatus status = DT_SUCCESS;
+
+	// Search from the goal, and from the kept polygons next to the dropped ones.
+	const dtPolyRef goalRef = field->m_goalRef;
+	if (field->getCost(goalRef) == FLT_MAX || tiles[m_nav->decodePolyIdTile(goalRef)].dirty)
+	{
+		dtNode* goalNode = m_nodePool->getNode(goalRef);
+		dtVcopy(goalNode->pos, field->m_goalPos);
+		goalNode->pidx = 0;
+		goalNode->cost = 0;
+		goalNode->total = 0;
+		goalNode->id = goalRef;
+		goalNode->flags = DT_NODE_OPEN;
+		m_openList->push(goalNode);
+	}
+	for (int i = 0; i < maxTiles && !dtStatusFailed(status); ++i)
+	{
+		const dtNavMeshFlowField::TileField& tf = tiles[i];
+		if (!tf.polyCount)
+			continue;
+		const dtPolyRef base = m_nav->encodePolyId(tf.salt, (unsigned int)i, 0);
+		for (int j = 0; j < tf.polyCount && !dtStatusFailed(status); ++j)
+		{
+			if (marks[offsets[i] + j] != 2)
 				continue;
-			
-			if (n < maxSegments)
-			{
-				const float* vj = &tile->verts[poly->verts[j]*3];
-				const float* vi = &tile->verts[poly->verts[i]*3];
-				float* seg = &segmentVerts[n*6];
-				dtVcopy(seg+0, vj);
-				dtVcopy(seg+3, vi);
-				if (segmentRefs)
-					segmentRefs[n] = neiRef;
-				n++;
-			}
-			else
+			const dtPolyRef ref = base | (dtPolyRef)j;
+			const dtMeshTile* tile = 0;
+			const dtPoly* poly = 0;
+			if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly)))
 			{
-				status |= DT_BUFFER_TOO_SMALL;
+				status = DT_FAILURE | DT_OUT_OF_MEMORY;
+				break;
 			}
-			
-			continue;
-		}
-		
-		// Add sentinels
-		insertInterval(ints, nints, MAX_INTERVAL, -1, 0, 0);
-		insertInterval(ints, nints, MAX_INTERVAL, 255, 256, 0);
-		
-		// Store segments.
-		const float* vj = &tile->verts[poly->verts[j]*3];
-		const float* vi = &tile->verts[poly->verts[i]*3];
-		for (int k = 1; k < nints; ++k)
-		{
-			// Portal segment.
-			if (storePortals && ints[k].ref)
+			if (!filter->passFilter(ref, tile, poly))
+				continue;
+
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
 			{
-				const float tmin = ints[k].tmin/255.0f; 
-				const float tmax = ints[k].tmax/255.0f; 
-				if (n < maxSegments)
-				{
-					float* seg = &segmentVerts[n*6];
-					dtVlerp(seg+0, vj,vi, tmin);
-					dtVlerp(seg+3, vj,vi, tmax);
-					if (segmentRefs)
-						segmentRefs[n] = ints[k].ref;
-					n++;
-				}
-				else
+				const dtPolyRef seedRef = tile->links[k].ref;
+				unsigned int salt, it, ip;
+				m_nav->decodePolyId(seedRef, salt, it, ip);
+				if (!seedRef || marks[offsets[it] + ip] != 1)
+					continue;
+
+				dtNode* seedNode = m_nodePool->getNode(seedRef);
+				if (!seedNode)
 				{
-					status |= DT_BUFFER_TOO_SMALL;
+					status |= DT_OUT_OF_NODES;
+					continue;
 				}
-			}
+				if (seedNode->flags)
+					continue;
 
-			// Wall segment.
-			const int imin = ints[k-1].tmax;
-			const int imax = ints[k].tmin;
-			if (imin != imax)
-			{
-				const float tmin = imin/255.0f; 
-				const float tmax = imax/255.0f; 
-				if (n < maxSegments)
+				// The node is where the path leaves the polygon.
+				const dtNavMeshFlowField::TileField& stf = tiles[it];
+				const dtPolyRef nextRef = stf.next[ip];
+				if (nextRef)
 				{
-					float* seg = &segmentVerts[n*6];
-					dtVlerp(seg+0, vj,vi, tmin);
-					dtVlerp(seg+3, vj,vi, tmax);
-					if (segmentRefs)
-						segmentRefs[n] = 0;
-					n++;
+					const dtMeshTile* seedTile = 0;
+					const dtPoly* seedPoly = 0;
+					const dtMeshTile* nextTile = 0;
+					const dtPoly* nextPoly = 0;
+					if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(seedRef, &seedTile, &seedPoly)) ||
+						dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(nextRef, &nextTile, &nextPoly)))
+					{
+						status = DT_FAILURE | DT_OUT_OF_MEMORY;
+						break;
+					}
+					getEdgeMidPoint(seedRef, seedPoly, seedTile, nextRef, nextPoly, nextTile, seedNode->pos);
 				}
 				else
 				{
-					status |= DT_BUFFER_TOO_SMALL;
+					dtVcopy(seedNode->pos, field->m_goalPos);
 				}
+				seedNode->pidx = 0;
+				seedNode->cost = 0;
+				seedNode->total = stf.costs[ip];
+				seedNode->id = seedRef;
+				seedNode->flags = DT_NODE_OPEN;
+				m_openList->push(seedNode);
 			}
 		}
 	}
-	
-	*segmentCount = n;
-	
-	return status;
-}
+	dtFree(marks);
+	dtFree(offsets);
+
+	// The tiles are left dirty, so they are searched again by the next update.
+	if (dtStatusFailed(status))
+		return status;
+
+	static const int MAX_OFFMESH_TILES = 32;
+	const dtMeshTile* offMeshTiles[MAX_OFFMESH_TILES];
+	const dtMeshTile* offMeshTile = 0;
+	int nOffMeshTiles = 0;
 
-/// @par
-///
-/// @p hitPos is not adjusted using the height detail data.
-///
-/// @p hitDist will equal the search radius if there is no wall within the 
-/// radius. In this case the values of @p hitPos and @p hitNormal are
-/// undefined.
-///
-/// The normal will become unpredicable if @p hitDist is a very small number.
-///
-dtStatus dtNavMeshQuery::findDistanceToWall(dtPolyRef startRef, const float* centerPos, const float maxRadius,
-											const dtQueryFilter* filter,
-											float* hitDist, float* hitPos, float* hitNormal) const
-{
-	dtAssert(m_nav);
-	dtAssert(m_nodePool);
-	dtAssert(m_openList);
-	
-	// Validate input
-	if (!m_nav->isValidPolyRef(startRef) ||
-		!centerPos || !dtVisfinite(centerPos) ||
-		maxRadius < 0 || !dtMathIsfinite(maxRadius) ||
-		!filter || !hitDist || !hitPos || !hitNormal)
-	{
-		return DT_FAILURE | DT_INVALID_PARAM;
-	}
-	
-	m_nodePool->clear();
-	m_openList->clear();
-	
-	dtNode* startNode = m_nodePool->getNode(startRef);
-	dtVcopy(startNode->pos, centerPos);
-	startNode->pidx = 0;
-	startNode->cost = 0;
-	startNode->total = 0;
-	startNode->id = startRef;
-	startNode->flags = DT_NODE_OPEN;
-	m_openList->push(startNode);
-	
-	float radiusSqr = dtSqr(maxRadius);
-	
-	dtStatus status = DT_SUCCESS;
-	
 	while (!m_openList->empty())
 	{
 		dtNode* bestNode = m_openList->pop();
 		bestNode->flags &= ~DT_NODE_OPEN;
 		bestNode->flags |= DT_NODE_CLOSED;
-		
+
 		// Get poly and tile.
 		// The API input has been cheked already, skip checking internal data.
 		const dtPolyRef bestRef = bestNode->id;
 		const dtMeshTile* bestTile = 0;
 		const dtPoly* bestPoly = 0;
-		m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly);
-		
-		// Get parent poly and tile.
+		if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(bestRef, &bestTile, &bestPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+		// Get parent poly and tile, the next polygon toward the goal.
 		dtPolyRef parentRef = 0;
 		const dtMeshTile* parentTile = 0;
 		const dtPoly* parentPoly = 0;
 		if (bestNode->pidx)
 			parentRef = m_nodePool->getNodeAtIdx(bestNode->pidx)->id;
+		if (parentRef && dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly)))
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+		// The seeds keep their next polygon.
+		dtNavMeshFlowField::TileField& tf = tiles[m_nav->decodePolyIdTile(bestRef)];
+		const unsigned int bestIp = m_nav->decodePolyIdPoly(bestRef);
+		tf.costs[bestIp] = bestNode->total;
 		if (parentRef)
-			m_nav->getTileAndPolyByRefUnsafe(parentRef, &parentTile, &parentPoly);
-		
-		// Hit test walls.
-		for (int i = 0, j = (int)bestPoly->vertCount-1; i < (int)bestPoly->vertCount; j = i++)
+			tf.next[bestIp] = parentRef;
+
+		// The search steps against the links, including the off-mesh connections that have
+		// no link from this polygon.
+		if (bestTile != offMeshTile)
 		{
-			// Skip non-solid edges.
-			if (bestPoly->neis[j] & DT_EXT_LINK)
+			offMeshTile = bestTile;
+			nOffMeshTiles = findOffMeshTilesAround(bestTile, offMeshTiles, MAX_OFFMESH_TILES);
+		}
+
+		unsigned int i = bestPoly->firstLink;
+		int itile = 0;
+		int icon = 0;
+		for (;;)
+		{
+			dtPolyRef neighbourRef = 0;
+			if (i != DT_NULL_LINK)
 			{
-				// Tile border.
-				bool solid = true;
-				for (unsigned int k = bestPoly->firstLink; k != DT_NULL_LINK; k = bestTile->links[k].next)
+				neighbourRef = bestTile->links[i].ref;
+				i = bestTile->links[i].next;
+			}
+			else if (itile < nOffMeshTiles)
+			{
+				const dtMeshTile* conTile = offMeshTiles[itile];
+				const int ip = conTile->header->offMeshBase + icon;
+				if (++icon == conTile->header->offMeshConCount)
 				{
-					const dtLink* link = &bestTile->links[k];
-					if (link->edge == j)
-					{
-						if (link->ref != 0)
-						{
-							const dtMeshTile* neiTile = 0;
-							const dtPoly* neiPoly = 0;
-							m_nav->getTileAndPolyByRefUnsafe(link->ref, &neiTile, &neiPoly);
-							if (filter->passFilter(link->ref, neiTile, neiPoly))
-								solid = false;
-						}
-						break;
-					}
+					icon = 0;
+					itile++;
 				}
-				if (!solid) continue;
+				if (!isLinkedTo(conTile, &conTile->polys[ip], bestRef))
+					continue;
+				neighbourRef = m_nav->getPolyRefBase(conTile) | (dtPolyRef)ip;
+				if (isLinkedTo(bestTile, bestPoly, neighbourRef))
+					continue;
 			}
-			else if (bestPoly->neis[j])
+			else
 			{
-				// Internal edge
-				const unsigned int idx = (unsigned int)(bestPoly->neis[j]-1);
-				const dtPolyRef ref = m_nav->getPolyRefBase(bestTile) | idx;
-				if (filter->passFilter(ref, bestTile, &bestTile->polys[idx]))
-					continue;
+				break;
 			}
-			
-			// Calc distance to the edge.
-			const float* vj = &bestTile->verts[bestPoly->verts[j]*3];
-			const float* vi = &bestTile->verts[bestPoly->verts[i]*3];
-			float tseg;
-			float distSqr = dtDistancePtSegSqr2D(centerPos, vj, vi, tseg);
-			
-			// Edge is too far, skip.
-			if (distSqr > radiusSqr)
-				continue;
-			
-			// Hit wall, update radius.
-			radiusSqr = distSqr;
-			// Calculate hit pos.
-			hitPos[0] = vj[0] + (vi[0] - vj[0])*tseg;
-			hitPos[1] = vj[1] + (vi[1] - vj[1])*tseg;
-			hitPos[2] = vj[2] + (vi[2] - vj[2])*tseg;
-		}
-		
-		for (unsigned int i = bestPoly->firstLink; i != DT_NULL_LINK; i = bestTile->links[i].next)
-		{
-			const dtLink* link = &bestTile->links[i];
-			dtPolyRef neighbourRef = link->ref;
+
 			// Skip invalid neighbours and do not follow back to parent.
 			if (!neighbourRef || neighbourRef == parentRef)
 				continue;
-			
-			// Expand to neighbour.
+
 			const dtMeshTile* neighbourTile = 0;
 			const dtPoly* neighbourPoly = 0;
-			m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly);
-			
-			// Skip off-mesh connections.
-			if (neighbourPoly->getType() == DT_POLYTYPE_OFFMESH_CONNECTION)
-				continue;
-			
-			// Calc distance to the edge.
-			const float* va = &bestTile->verts[bestPoly->verts[link->edge]*3];
-			const float* vb = &bestTile->verts[bestPoly->verts[(link->edge+1) % bestPoly->vertCount]*3];
-			float tseg;
-			float distSqr = dtDistancePtSegSqr2D(centerPos, va, vb, tseg);
-			
-			// If the circle is not touching the next polygon, skip it.
-			if (distSqr > radiusSqr)
-				continue;
-			
+			if (dtStatusFailed(m_nav->getTileAndPolyByRefUnsafe(neighbourRef, &neighbourTile, &neighbourPoly)))
+				return DT_FAILURE | DT_OUT_OF_MEMORY;
+
+			// Do not advance if the polygon is excluded by the filter, or cannot be left
+			// toward the current polygon.
 			if (!filter->passFilter(neighbourRef, neighbourTile, neighbourPoly))
 				continue;
+			if (!isLinkedTo(neighbourTile, neighbourPoly, bestRef))
+				continue;
 
 			dtNode* neighbourNode = m_nodePool->getNode(neighbourRef);
 			if (!neighbourNode)
@@ -3619,46 +4082,44 @@ dtStatus dtNavMeshQuery::findDistanceToWall(dtPolyRef startRef, const float* cen
 				status |= DT_OUT_OF_NODES;
 				continue;
 			}
-			
 			if (neighbourNode->flags & DT_NODE_CLOSED)
 				continue;
-			
-			// Cost
+
+			// The polygons not in the search yet start from their kept cost.
 			if (neighbourNode->flags == 0)
 			{
-				getEdgeMidPoint(bestRef, bestPoly, bestTile,
-								neighbourRef, neighbourPoly, neighbourTile, neighbourNode->pos);
+				getEdgeMidPoint(neighbourRef, neighbourPoly, neighbourTile,
+								bestRef, bestPoly, bestTile, neighbourNode->pos);
+				const dtNavMeshFlowField::TileField& ntf = tiles[m_nav->decodePolyIdTile(neighbourRef)];
+				neighbourNode->total = ntf.costs[m_nav->decodePolyIdPoly(neighbourRef)];
 			}
-			
-			const float total = bestNode->total + dtVdist(bestNode->pos, neighbourNode->pos);
-			
-			// The node is already in open list and the new result is worse, skip.
-			if ((neighbourNode->flags & DT_NODE_OPEN) && total >= neighbourNode->total)
+
+			const float total = bestNode->total + filter->getCost(neighbourNode->pos, bestNode->pos,
+																  neighbourRef, neighbourTile, neighbourPoly,
+																  bestRef, bestTile, bestPoly,
+																  parentRef, parentTile, parentPoly);
+			if (total >= neighbourNode->total)
 				continue;
-			
+
 			neighbourNode->id = neighbourRef;
-			neighbourNode->flags = (neighbourNode->flags & ~DT_NODE_CLOSED);
 			neighbourNode->pidx = m_nodePool->getNodeIdx(bestNode);
 			neighbourNode->total = total;
-				
+
 			if (neighbourNode->flags & DT_NODE_OPEN)
 			{
 				m_openList->modify(neighbourNode);
 			}
 			else
 			{
-				neighbourNode->flags |= DT_NODE_OPEN;
+				neighbourNode->flags = DT_NODE_OPEN;
 				m_openList->push(neighbourNode);
 			}
 		}
 	}
-	
-	// Calc hit normal.
-	dtVsub(hitNormal, centerPos, hitPos);
-	dtVnormalize(hitNormal);
-	
-	*hitDist = dtMathSqrtf(radiusSqr);
-	
+
+	for (int i = 0; i < maxTiles; ++i)
+		tiles[i].dirty = false;
+
 	return status;
 }
 
@@ -0,0 +1,311 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourPathCache.h"
+#include "DetourCommon.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include <string.h>
+#include <new>
+
+namespace
+{
+	// FNV-1a.
+	inline unsigned int hashBytes(const void* data, const size_t size, unsigned int hash)
+	{
+		const unsigned char* p = (const unsigned char*)data;
+		for (size_t i = 0; i < size; ++i)
+		{
+			hash ^= p[i];
+			hash *= 16777619u;
+		}
+		return hash;
+	}
+
+	const unsigned int HASH_SEED = 2166136261u;
+}
+
+dtPathCache* dtAllocPathCache()
+{
+	void* mem = dtAlloc(sizeof(dtPathCache), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtPathCache;
+}
+
+void dtFreePathCache(dtPathCache* cache)
+{
+	if (!cache) return;
+	cache->~dtPathCache();
+	dtFree(cache);
+}
+
+dtPathCache::dtPathCache() :
+	m_entries(0),
+	m_paths(0),
+	m_buckets(0),
+	m_bucketMask(0),
+	m_freeEntries(0),
+	m_nfreeEntries(0),
+	m_head(-1),
+	m_tail(-1),
+	m_maxEntries(0),
+	m_maxPathSize(0)
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+dtPathCache::~dtPathCache()
+{
+	destroy();
+}
+
+void dtPathCache::destroy()
+{
+	dtFree(m_entries);
+	dtFree(m_paths);
+	dtFree(m_buckets);
+	dtFree(m_freeEntries);
+	m_entries = 0;
+	m_paths = 0;
+	m_buckets = 0;
+	m_freeEntries = 0;
+	m_bucketMask = 0;
+	m_nfreeEntries = 0;
+	m_head = -1;
+	m_tail = -1;
+	m_maxEntries = 0;
+	m_maxPathSize = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+dtStatus dtPathCache::init(const int maxEntries, const int maxPathSize)
+{
+	if (maxEntries <= 0 || maxPathSize <= 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	destroy();
+
+	const int bucketCount = (int)dtNextPow2((unsigned int)maxEntries);
+	m_entries = (Entry*)dtAlloc(sizeof(Entry)*maxEntries, DT_ALLOC_PERM);
+	m_paths = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*maxEntries*maxPathSize, DT_ALLOC_PERM);
+	m_buckets = (int*)dtAlloc(sizeof(int)*bucketCount, DT_ALLOC_PERM);
+	m_freeEntries = (int*)dtAlloc(sizeof(int)*maxEntries, DT_ALLOC_PERM);
+	if (!m_entries || !m_paths || !m_buckets || !m_freeEntries)
+	{
+		destroy();
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	}
+
+	m_maxEntries = maxEntries;
+	m_maxPathSize = maxPathSize;
+	m_bucketMask = bucketCount-1;
+	m_stats.memory = sizeof(Entry)*maxEntries + sizeof(dtPolyRef)*maxEntries*maxPathSize +
+		sizeof(int)*bucketCount + sizeof(int)*maxEntries;
+
+	clear();
+
+	return DT_SUCCESS;
+}
+
+void dtPathCache::clear()
+{
+	for (int i = 0; i <= m_bucketMask && m_buckets; ++i)
+		m_buckets[i] = -1;
+	// The lowest indices are used first.
+	for (int i = 0; i < m_maxEntries; ++i)
+		m_freeEntries[i] = m_maxEntries-1 - i;
+	m_nfreeEntries = m_maxEntries;
+	m_head = -1;
+	m_tail = -1;
+	m_stats.entries = 0;
+}
+
+void dtPathCache::resetStats()
+{
+	m_stats.hits = 0;
+	m_stats.misses = 0;
+	m_stats.staleEntries = 0;
+	m_stats.evictions = 0;
+	m_stats.uncachedPaths = 0;
+}
+
+unsigned int dtPathCache::getFilterKey(const dtQueryFilter* filter)
+{
+	return dtGetQueryFilterKey(filter);
+}
+
+unsigned int dtPathCache::hashKey(dtPolyRef startRef, dtPolyRef endRef,
+								  const unsigned int filterKey) const
+{
+	unsigned int hash = hashBytes(&startRef, sizeof(startRef), HASH_SEED);
+	hash = hashBytes(&endRef, sizeof(endRef), hash);
+	hash = hashBytes(&filterKey, sizeof(filterKey), hash);
+	return hash & (unsigned int)m_bucketMask;
+}
+
+int dtPathCache::findEntry(dtPolyRef startRef, dtPolyRef endRef,
+						   const unsigned int filterKey) const
+{
+	int idx = m_buckets[hashKey(startRef, endRef, filterKey)];
+	while (idx != -1)
+	{
+		const Entry& e = m_entries[idx];
+		if (e.startRef == startRef && e.endRef == endRef && e.filterKey == filterKey)
+			return idx;
+		idx = e.hashNext;
+	}
+	return -1;
+}
+
+void dtPathCache::unlinkEntry(const int idx)
+{
+	Entry& e = m_entries[idx];
+	if (e.prev != -1)
+		m_entries[e.prev].next = e.next;
+	else
+		m_head = e.next;
+	if (e.next != -1)
+		m_entries[e.next].prev = e.prev;
+	else
+		m_tail = e.prev;
+	e.prev = e.next = -1;
+}
+
+void dtPathCache::linkEntry(const int idx)
+{
+	Entry& e = m_entries[idx];
+	e.prev = -1;
+	e.next = m_head;
+	if (m_head != -1)
+		m_entries[m_head].prev = idx;
+	m_head = idx;
+	if (m_tail == -1)
+		m_tail = idx;
+}
+
+void dtPathCache::removeEntry(const int idx)
+{
+	const Entry& e = m_entries[idx];
+	int* prev = &m_buckets[hashKey(e.startRef, e.endRef, e.filterKey)];
+	while (*prev != idx)
+	{
+		dtAssert(*prev != -1);
+		prev = &m_entries[*prev].hashNext;
+	}
+	*prev = e.hashNext;
+
+	unlinkEntry(idx);
+	m_freeEntries[m_nfreeEntries++] = idx;
+	m_stats.entries--;
+}
+
+void dtPathCache::storePath(dtPolyRef startRef, dtPolyRef endRef, const unsigned int filterKey,
+							const dtPolyRef* path, const int pathCount)
+{
+	if (!m_nfreeEntries)
+	{
+		dtAssert(m_tail != -1);
+		removeEntry(m_tail);
+		m_stats.evictions++;
+	}
+
+	const int idx = m_freeEntries[--m_nfreeEntries];
+	Entry& e = m_entries[idx];
+	e.startRef = startRef;
+	e.endRef = endRef;
+	e.filterKey = filterKey;
+	e.pathCount = pathCount;
+	memcpy(&m_paths[idx*m_maxPathSize], path, sizeof(dtPolyRef)*pathCount);
+
+	const unsigned int bucket = hashKey(startRef, endRef, filterKey);
+	e.hashNext = m_buckets[bucket];
+	m_buckets[bucket] = idx;
+	linkEntry(idx);
+	m_stats.entries++;
+}
+
+/// @par
+///
+/// A cached path is the path found for the first positions it was searched with. The
+/// filter fingerprint covers the include and exclude flags and the area costs, so filters
+/// that override dtQueryFilter::passFilter or dtQueryFilter::getCost need their own cache.
+///
+/// If the path array is to small to hold the full result, it will be filled as
+/// far as possible from the start polygon toward the end polygon.
+dtStatus dtPathCache::findPath(const dtNavMeshQuery* query, dtPolyRef startRef, dtPolyRef endRef,
+							   const float* startPos, const float* endPos,
+							   const dtQueryFilter* filter,
+							   dtPolyRef* path, int* pathCount, const int maxPath)
+{
+	if (!filter)
+	{
+		if (pathCount)
+			*pathCount = 0;
+		return DT_FAILURE | DT_INVALID_PARAM;
+	}
+	return findPath(query, startRef, endRef, startPos, endPos, filter, getFilterKey(filter), path, pathCount, maxPath);
+}
+
+dtStatus dtPathCache::findPath(const dtNavMeshQuery* query, dtPolyRef startRef, dtPolyRef endRef,
+							   const float* startPos, const float* endPos,
+							   const dtQueryFilter* filter, const unsigned int filterKey,
+							   dtPolyRef* path, int* pathCount, const int maxPath)
+{
+	if (!pathCount)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	*pathCount = 0;
+
+	if (!m_entries || !query || !filter || !path || maxPath <= 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const int idx = findEntry(startRef, endRef, filterKey);
+	if (idx != -1)
+	{
+		// Drop the path if any of its polygons has changed.
+		const Entry& e = m_entries[idx];
+		const dtPolyRef* cached = &m_paths[idx*m_maxPathSize];
+		bool valid = true;
+		for (int i = 0; i < e.pathCount && valid; ++i)
+			valid = query->isValidPolyRef(cached[i], filter);
+
+		if (valid)
+		{
+			const int n = dtMin(e.pathCount, maxPath);
+			memcpy(path, cached, sizeof(dtPolyRef)*n);
+			*pathCount = n;
+			unlinkEntry(idx);
+			linkEntry(idx);
+			m_stats.hits++;
+			return n < e.pathCount ? (DT_SUCCESS | DT_BUFFER_TOO_SMALL) : DT_SUCCESS;
+		}
+
+		removeEntry(idx);
+		m_stats.staleEntries++;
+	}
+
+	m_stats.misses++;
+
+	const dtStatus status = query->findPath(startRef, endRef, startPos, endPos, filter, path, pathCount, maxPath);
+	if (status == DT_SUCCESS && *pathCount <= m_maxPathSize)
+		storePath(startRef, endRef, filterKey, path, *pathCount);
+	else
+		m_stats.uncachedPaths++;
+
+	return status;
+}
@@ -0,0 +1,134 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourQueryStats.h"
+#include "DetourAssert.h"
+#include <string.h>
+
+static dtQueryClockFunc* sQueryClockFunc = 0;
+
+void dtQueryStatsSetClock(dtQueryClockFunc* clockFunc)
+{
+	sQueryClockFunc = clockFunc;
+}
+
+long long dtQueryStatsGetTime()
+{
+	return sQueryClockFunc ? sQueryClockFunc() : 0;
+}
+
+long long dtGetQueryStatsValue(const dtQueryStats& stats, const dtQueryStatsValue value)
+{
+	switch (value)
+	{
+	case DT_QUERY_NODES_EXPANDED: return stats.nodesExpanded;
+	case DT_QUERY_NODES_TOUCHED: return stats.nodesTouched;
+	case DT_QUERY_OPEN_LIST_PEAK: return stats.openListPeak;
+	case DT_QUERY_TILES_TOUCHED: return stats.tilesTouched;
+	case DT_QUERY_LINKS_TRAVERSED: return stats.linksTraversed;
+	case DT_QUERY_ELAPSED_USEC: return stats.elapsedUsec;
+	default: break;
+	}
+	dtAssert(false);
+	return 0;
+}
+
+dtQueryStatsHistogram::dtQueryStatsHistogram()
+{
+	reset();
+}
+
+void dtQueryStatsHistogram::reset()
+{
+	memset(m_buckets, 0, sizeof(m_buckets));
+	memset(m_totals, 0, sizeof(m_totals));
+	memset(m_max, 0, sizeof(m_max));
+	m_sampleCount = 0;
+}
+
+void dtQueryStatsHistogram::addSample(const dtQueryStats& stats)
+{
+	for (int i = 0; i < DT_QUERY_STATS_VALUE_COUNT; ++i)
+	{
+		const long long v = dtGetQueryStatsValue(stats, (dtQueryStatsValue)i);
+		m_buckets[i][getBucket(v)]++;
+		m_totals[i] += v;
+		if (v > m_max[i])
+			m_max[i] = v;
+	}
+	m_sampleCount++;
+}
+
+int dtQueryStatsHistogram::getBucketCount(const dtQueryStatsValue value, const int bucket) const
+{
+	if (value < 0 || value >= DT_QUERY_STATS_VALUE_COUNT || bucket < 0 || bucket >= DT_QUERY_STATS_BUCKET_COUNT)
+		return 0;
+	return m_buckets[value][bucket];
+}
+
+long long dtQueryStatsHistogram::getTotal(const dtQueryStatsValue value) const
+{
+	if (value < 0 || value >= DT_QUERY_STATS_VALUE_COUNT)
+		return 0;
+	return m_totals[value];
+}
+
+long long dtQueryStatsHistogram::getMax(const dtQueryStatsValue value) const
+{
+	if (value < 0 || value >= DT_QUERY_STATS_VALUE_COUNT)
+		return 0;
+	return m_max[value];
+}
+
+long long dtQueryStatsHistogram::getPercentile(const dtQueryStatsValue value, const float percentile) const
+{
+	if (value < 0 || value >= DT_QUERY_STATS_VALUE_COUNT || !m_sampleCount)
+		return 0;
+
+	// The number of samples at or below the percentile, at least one.
+	int rank = (int)(percentile * 0.01f * m_sampleCount + 0.5f);
+	if (rank < 1) rank = 1;
+	if (rank > m_sampleCount) rank = m_sampleCount;
+
+	int count = 0;
+	for (int i = 0; i < DT_QUERY_STATS_BUCKET_COUNT-1; ++i)
+	{
+		count += m_buckets[value][i];
+		if (count >= rank)
+		{
+			const long long bucketMax = getBucketMin(i+1) - 1;
+			return bucketMax < m_max[value] ? bucketMax : m_max[value];
+		}
+	}
+	return m_max[value];
+}
+
+int dtQueryStatsHistogram::getBucket(const long long value)
+{
+	int bucket = 0;
+	for (long long v = value; v > 0 && bucket < DT_QUERY_STATS_BUCKET_COUNT-1; v >>= 1)
+		bucket++;
+	return bucket;
+}
+
+long long dtQueryStatsHistogram::getBucketMin(const int bucket)
+{
+	if (bucket <= 0)
+		return 0;
+	return 1LL << (bucket-1);
+}
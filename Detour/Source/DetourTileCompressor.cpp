@@ -0,0 +1,217 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourTileCompressor.h"
+#include <string.h>
+
+namespace
+{
+	// Sequences are a token (literal length << 4 | match length - LZ_MIN_MATCH), extra literal
+	// length bytes, the literals, a little endian offset, and extra match length bytes.
+	// The last sequence has only literals.
+	const int LZ_MIN_MATCH = 4;
+	const int LZ_LAST_LITERALS = 5;		// The last bytes are always literals.
+	const int LZ_MATCH_START_LIMIT = 12;	// No match starts this close to the end.
+	const int LZ_MAX_OFFSET = 65535;
+	const int LZ_HASH_BITS = 12;
+
+	inline unsigned int readU32(const unsigned char* p)
+	{
+		return (unsigned int)p[0] | ((unsigned int)p[1] << 8) | ((unsigned int)p[2] << 16) | ((unsigned int)p[3] << 24);
+	}
+
+	inline unsigned int hashU32(const unsigned int v)
+	{
+		return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+	}
+
+	inline unsigned char* writeLength(unsigned char* op, int len)
+	{
+		while (len >= 255)
+		{
+			*op++ = 255;
+			len -= 255;
+		}
+		*op++ = (unsigned char)len;
+		return op;
+	}
+
+	// Reads the extra bytes of a length, returns false if the data ends.
+	inline bool readLength(const unsigned char*& ip, const unsigned char* iend, int& len)
+	{
+		unsigned char b;
+		do
+		{
+			if (ip >= iend)
+				return false;
+			b = *ip++;
+			len += b;
+		}
+		while (b == 255);
+		return true;
+	}
+
+	unsigned char* writeSequence(unsigned char* op, const unsigned char* literals, const int nliterals,
+								 const int offset, const int matchLen)
+	{
+		unsigned char* token = op++;
+		*token = (unsigned char)((nliterals < 15 ? nliterals : 15) << 4);
+		if (nliterals >= 15)
+			op = writeLength(op, nliterals - 15);
+		memcpy(op, literals, nliterals);
+		op += nliterals;
+
+		if (matchLen == 0)
+			return op;
+
+		*op++ = (unsigned char)(offset & 0xff);
+		*op++ = (unsigned char)(offset >> 8);
+		const int len = matchLen - LZ_MIN_MATCH;
+		*token |= (unsigned char)(len < 15 ? len : 15);
+		if (len >= 15)
+			op = writeLength(op, len - 15);
+		return op;
+	}
+}
+
+int dtLZTileCompressor::maxCompressedSize(const int bufferSize)
+{
+	return bufferSize + bufferSize/255 + 16;
+}
+
+dtStatus dtLZTileCompressor::compress(const unsigned char* buffer, const int bufferSize,
+									  unsigned char* compressed, const int maxSize, int* compressedSize)
+{
+	if (bufferSize < 0 || !compressedSize)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (maxSize < maxCompressedSize(bufferSize))
+		return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+
+	int table[1 << LZ_HASH_BITS];
+	for (int i = 0; i < (1 << LZ_HASH_BITS); ++i)
+		table[i] = -1;
+
+	unsigned char* op = compressed;
+	int ip = 0;
+	int anchor = 0;
+	const int matchStartLimit = bufferSize - LZ_MATCH_START_LIMIT;
+	const int matchEndLimit = bufferSize - LZ_LAST_LITERALS;
+
+	while (ip < matchStartLimit)
+	{
+		const unsigned int seq = readU32(buffer + ip);
+		const unsigned int h = hashU32(seq);
+		int ref = table[h];
+		table[h] = ip;
+		if (ref < 0 || ip - ref > LZ_MAX_OFFSET || readU32(buffer + ref) != seq)
+		{
+			ip++;
+			continue;
+		}
+
+		// Extend the match both ways.
+		int len = LZ_MIN_MATCH;
+		while (ip + len < matchEndLimit && buffer[ref + len] == buffer[ip + len])
+			len++;
+		while (ip > anchor && ref > 0 && buffer[ip - 1] == buffer[ref - 1])
+		{
+			ip--;
+			ref--;
+			len++;
+		}
+
+		op = writeSequence(op, buffer + anchor, ip - anchor, ip - ref, len);
+		ip += len;
+		anchor = ip;
+
+		// Index one position inside the match, so that runs keep matching.
+		if (ip - 2 >= 0 && ip - 2 < matchStartLimit)
+			table[hashU32(readU32(buffer + ip - 2))] = ip - 2;
+	}
+
+	op = writeSequence(op, buffer + anchor, bufferSize - anchor, 0, 0);
+	*compressedSize = (int)(op - compressed);
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtLZTileCompressor::decompress(const unsigned char* compressed, const int compressedSize,
+										unsigned char* buffer, const int maxBufferSize, int* bufferSize)
+{
+	if (compressedSize <= 0 || !bufferSize)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	const unsigned char* ip = compressed;
+	const unsigned char* iend = compressed + compressedSize;
+	unsigned char* op = buffer;
+	unsigned char* oend = buffer + maxBufferSize;
+
+	for (;;)
+	{
+		const unsigned char token = *ip++;
+
+		int nliterals = token >> 4;
+		if (nliterals == 15 && !readLength(ip, iend, nliterals))
+			return DT_FAILURE | DT_INVALID_PARAM;
+		if (nliterals > iend - ip)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		if (nliterals > oend - op)
+			return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+		memcpy(op, ip, nliterals);
+		ip += nliterals;
+		op += nliterals;
+
+		// The last sequence has no match.
+		if (ip == iend)
+			break;
+
+		if (iend - ip < 2)
+			return DT_FAILURE | DT_INVALID_PARAM;
+		const int offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (offset == 0 || offset > op - buffer)
+			return DT_FAILURE | DT_INVALID_PARAM;
+
+		int len = token & 15;
+		if (len == 15 && !readLength(ip, iend, len))
+			return DT_FAILURE | DT_INVALID_PARAM;
+		len += LZ_MIN_MATCH;
+		if (len > oend - op)
+			return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+
+		// The match can overlap the output, copy forwards.
+		const unsigned char* src = op - offset;
+		if (offset >= len)
+		{
+			memcpy(op, src, len);
+			op += len;
+		}
+		else
+		{
+			for (int i = 0; i < len; ++i)
+				*op++ = *src++;
+		}
+
+		if (ip >= iend)
+			return DT_FAILURE | DT_INVALID_PARAM;
+	}
+
+	*bufferSize = (int)(op - buffer);
+
+	return DT_SUCCESS;
+}
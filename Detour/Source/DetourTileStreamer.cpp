@@ -0,0 +1,598 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "DetourTileStreamer.h"
+#include "DetourCommon.h"
+#include "DetourMath.h"
+#include "DetourAlloc.h"
+#include "DetourAssert.h"
+#include <string.h>
+#include <float.h>
+#include <new>
+
+dtTileStreamer* dtAllocTileStreamer()
+{
+	void* mem = dtAlloc(sizeof(dtTileStreamer), DT_ALLOC_PERM);
+	if (!mem) return 0;
+	return new(mem) dtTileStreamer;
+}
+
+void dtFreeTileStreamer(dtTileStreamer* streamer)
+{
+	if (!streamer) return;
+	streamer->~dtTileStreamer();
+	dtFree(streamer);
+}
+
+inline int computeTileHash(int x, int y, const int mask)
+{
+	const unsigned int h1 = 0x8da6b343; // Large multiplicative constants;
+	const unsigned int h2 = 0xd8163841; // here arbitrarily chosen primes
+	unsigned int n = h1 * x + h2 * y;
+	return (int)(n & mask);
+}
+
+dtTileStreamer::dtTileStreamer() :
+	m_nav(0),
+	m_source(0),
+	m_tileWidth(0),
+	m_tileHeight(0),
+	m_entries(0),
+	m_nextFreeEntry(0),
+	m_posLookup(0),
+	m_lutMask(0),
+	m_loads(0),
+	m_freeLoads(0),
+	m_nfreeLoads(0),
+	m_ready(0),
+	m_candidates(0),
+	m_interestPos(0),
+	m_interestRadius(0),
+	m_ninterest(0)
+{
+	memset(&m_params, 0, sizeof(m_params));
+	memset(m_orig, 0, sizeof(m_orig));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+dtTileStreamer::~dtTileStreamer()
+{
+	destroy();
+}
+
+void dtTileStreamer::destroy()
+{
+	// The navigation mesh may be gone already, so only the loads are released.
+	if (m_entries)
+	{
+		for (int i = 0; i < m_params.maxEntries; ++i)
+		{
+			Entry* entry = &m_entries[i];
+			if (entry->state == ENTRY_LOADING)
+			{
+				m_source->cancelLoad(&m_loads[entry->load]);
+				m_source->waitLoad(&m_loads[entry->load]);
+				releaseLoad(entry, true);
+			}
+			else if (entry->state == ENTRY_READY)
+			{
+				releaseLoad(entry, true);
+			}
+		}
+	}
+	dtFree(m_entries);
+	m_entries = 0;
+	m_nextFreeEntry = 0;
+	dtFree(m_posLookup);
+	m_posLookup = 0;
+	dtFree(m_loads);
+	m_loads = 0;
+	dtFree(m_freeLoads);
+	m_freeLoads = 0;
+	m_nfreeLoads = 0;
+	dtFree(m_ready);
+	m_ready = 0;
+	dtFree(m_candidates);
+	m_candidates = 0;
+	dtFree(m_interestPos);
+	m_interestPos = 0;
+	dtFree(m_interestRadius);
+	m_interestRadius = 0;
+	m_ninterest = 0;
+	m_nav = 0;
+	m_source = 0;
+}
+
+dtStatus dtTileStreamer::init(const dtTileStreamParams* params, dtNavMesh* nav, dtTileStreamSource* source)
+{
+	destroy();
+
+	if (!params || !nav || !source)
+		return DT_FAILURE | DT_INVALID_PARAM;
+	if (params->maxEntries <= 0 || params->maxLoads <= 0 || params->maxInterestPoints <= 0 ||
+		params->unloadMargin < 0 || params->maxCommitsPerUpdate < 0 || params->commitBudgetUsec < 0)
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	memcpy(&m_params, params, sizeof(dtTileStreamParams));
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_nav = nav;
+	m_source = source;
+
+	const dtNavMeshParams* navParams = nav->getParams();
+	dtVcopy(m_orig, navParams->orig);
+	m_tileWidth = navParams->tileWidth;
+	m_tileHeight = navParams->tileHeight;
+
+	// Entries
+	m_entries = (Entry*)dtAlloc(sizeof(Entry)*m_params.maxEntries, DT_ALLOC_PERM);
+	if (!m_entries)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_entries, 0, sizeof(Entry)*m_params.maxEntries);
+	m_nextFreeEntry = 0;
+	for (int i = m_params.maxEntries-1; i >= 0; --i)
+	{
+		m_entries[i].state = ENTRY_FREE;
+		m_entries[i].load = -1;
+		m_entries[i].next = m_nextFreeEntry;
+		m_nextFreeEntry = &m_entries[i];
+	}
+
+	const int lutSize = (int)dtNextPow2((unsigned int)dtMax(1, m_params.maxEntries/4));
+	m_lutMask = lutSize-1;
+	m_posLookup = (Entry**)dtAlloc(sizeof(Entry*)*lutSize, DT_ALLOC_PERM);
+	if (!m_posLookup)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_posLookup, 0, sizeof(Entry*)*lutSize);
+
+	// Loads
+	m_loads = (dtTileStreamLoad*)dtAlloc(sizeof(dtTileStreamLoad)*m_params.maxLoads, DT_ALLOC_PERM);
+	m_freeLoads = (int*)dtAlloc(sizeof(int)*m_params.maxLoads, DT_ALLOC_PERM);
+	m_ready = (Entry**)dtAlloc(sizeof(Entry*)*m_params.maxLoads, DT_ALLOC_PERM);
+	m_candidates = (Candidate*)dtAlloc(sizeof(Candidate)*m_params.maxLoads, DT_ALLOC_PERM);
+	if (!m_loads || !m_freeLoads || !m_ready || !m_candidates)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	memset(m_loads, 0, sizeof(dtTileStreamLoad)*m_params.maxLoads);
+	for (int i = 0; i < m_params.maxLoads; ++i)
+		m_freeLoads[i] = m_params.maxLoads-1-i;
+	m_nfreeLoads = m_params.maxLoads;
+
+	// Interest points
+	m_interestPos = (float*)dtAlloc(sizeof(float)*3*m_params.maxInterestPoints, DT_ALLOC_PERM);
+	m_interestRadius = (float*)dtAlloc(sizeof(float)*m_params.maxInterestPoints, DT_ALLOC_PERM);
+	if (!m_interestPos || !m_interestRadius)
+		return DT_FAILURE | DT_OUT_OF_MEMORY;
+	m_ninterest = 0;
+
+	return DT_SUCCESS;
+}
+
+dtStatus dtTileStreamer::setInterestPoints(const float* pos, const float* radius, const int count)
+{
+	if (count < 0 || (count > 0 && (!pos || !radius)))
+		return DT_FAILURE | DT_INVALID_PARAM;
+
+	dtStatus status = DT_SUCCESS;
+	m_ninterest = count;
+	if (m_ninterest > m_params.maxInterestPoints)
+	{
+		m_ninterest = m_params.maxInterestPoints;
+		status |= DT_BUFFER_TOO_SMALL;
+	}
+	if (m_ninterest > 0)
+	{
+		memcpy(m_interestPos, pos, sizeof(float)*3*m_ninterest);
+		memcpy(m_interestRadius, radius, sizeof(float)*m_ninterest);
+	}
+	return status;
+}
+
+void dtTileStreamer::resetStats()
+{
+	m_stats.requestedLoads = 0;
+	m_stats.completedLoads = 0;
+	m_stats.failedLoads = 0;
+	m_stats.cancelledLoads = 0;
+	m_stats.droppedLoads = 0;
+	m_stats.evictedTiles = 0;
+	m_stats.memoryEvictedTiles = 0;
+	m_stats.deferredUpdates = 0;
+	m_stats.peakResidentBytes = m_stats.residentBytes;
+}
+
+dtTileStreamer::Entry* dtTileStreamer::findEntry(const int x, const int y) const
+{
+	Entry* entry = m_posLookup[computeTileHash(x, y, m_lutMask)];
+	while (entry)
+	{
+		if (entry->x == x && entry->y == y)
+			return entry;
+		entry = entry->next;
+	}
+	return 0;
+}
+
+dtTileStreamer::Entry* dtTileStreamer::allocEntry(const int x, const int y)
+{
+	Entry* entry = m_nextFreeEntry;
+	if (!entry)
+		return 0;
+	m_nextFreeEntry = entry->next;
+
+	entry->x = x;
+	entry->y = y;
+	entry->dist = 0;
+	entry->bytes = 0;
+	entry->ntiles = 0;
+	entry->load = -1;
+	entry->state = ENTRY_LOADING;
+	entry->cancelled = 0;
+
+	const int h = computeTileHash(x, y, m_lutMask);
+	entry->next = m_posLookup[h];
+	m_posLookup[h] = entry;
+	return entry;
+}
+
+void dtTileStreamer::freeEntry(Entry* entry)
+{
+	const int h = computeTileHash(entry->x, entry->y, m_lutMask);
+	Entry* prev = 0;
+	Entry* cur = m_posLookup[h];
+	while (cur)
+	{
+		if (cur == entry)
+		{
+			if (prev)
+				prev->next = cur->next;
+			else
+				m_posLookup[h] = cur->next;
+			break;
+		}
+		prev = cur;
+		cur = cur->next;
+	}
+
+	entry->state = ENTRY_FREE;
+	entry->next = m_nextFreeEntry;
+	m_nextFreeEntry = entry;
+}
+
+float dtTileStreamer::calcDist(const int x, const int y) const
+{
+	const float minx = m_orig[0] + x*m_tileWidth;
+	const float minz = m_orig[2] + y*m_tileHeight;
+	const float maxx = minx + m_tileWidth;
+	const float maxz = minz + m_tileHeight;
+
+	float dist = FLT_MAX;
+	for (int i = 0; i < m_ninterest; ++i)
+	{
+		const float* p = &m_interestPos[i*3];
+		const float dx = dtMax(0.0f, dtMax(minx - p[0], p[0] - maxx));
+		const float dz = dtMax(0.0f, dtMax(minz - p[2], p[2] - maxz));
+		dist = dtMin(dist, dtMathSqrtf(dx*dx + dz*dz) - m_interestRadius[i]);
+	}
+	return dist;
+}
+
+void dtTileStreamer::releaseLoad(Entry* entry, const bool freeData)
+{
+	dtTileStreamLoad* load = &m_loads[entry->load];
+	if (freeData)
+	{
+		for (int i = 0; i < load->ntiles; ++i)
+			dtFree(load->data[i]);
+	}
+	load->ntiles = 0;
+	m_freeLoads[m_nfreeLoads++] = entry->load;
+	entry->load = -1;
+}
+
+void dtTileStreamer::evictEntry(Entry* entry)
+{
+	const dtMeshTile* tiles[DT_TILE_STREAM_MAX_LAYERS];
+	const int n = m_nav->getTilesAt(entry->x, entry->y, tiles, DT_TILE_STREAM_MAX_LAYERS);
+	for (int i = 0; i < n; ++i)
+		m_nav->removeTile(m_nav->getTileRef(tiles[i]), 0, 0);
+
+	m_stats.residentTiles -= entry->ntiles;
+	m_stats.residentBytes -= entry->bytes;
+	entry->ntiles = 0;
+	entry->bytes = 0;
+}
+
+bool dtTileStreamer::commitLoad(Entry* entry)
+{
+	dtTileStreamLoad* load = &m_loads[entry->load];
+	size_t bytes = 0;
+	for (int i = 0; i < load->ntiles; ++i)
+		bytes += (size_t)load->dataSize[i];
+
+	// Make room by unloading tiles farther away than this one.
+	if (m_params.maxResidentBytes > 0)
+	{
+		while (m_stats.residentBytes + bytes > m_params.maxResidentBytes)
+		{
+			Entry* farthest = 0;
+			for (int i = 0; i < m_params.maxEntries; ++i)
+			{
+				Entry* e = &m_entries[i];
+				if (e->state == ENTRY_RESIDENT && e->bytes > 0 && e->dist > entry->dist &&
+					(!farthest || e->dist > farthest->dist))
+					farthest = e;
+			}
+			if (!farthest)
+				break;
+			m_stats.memoryEvictedTiles += farthest->ntiles;
+			evictEntry(farthest);
+			freeEntry(farthest);
+		}
+		if (m_stats.residentBytes + bytes > m_params.maxResidentBytes)
+		{
+			releaseLoad(entry, true);
+			freeEntry(entry);
+			m_stats.droppedLoads++;
+			return false;
+		}
+	}
+
+	if (load->ntiles > 0)
+	{
+		dtStatus status = m_nav->addTiles(load->data, load->dataSize, load->ntiles, DT_TILE_FREE_DATA, 0);
+		if (dtStatusFailed(status))
+		{
+			// Keep the location as empty, so that it is not loaded again while it is in range.
+			releaseLoad(entry, true);
+			entry->state = ENTRY_RESIDENT;
+			m_stats.failedLoads++;
+			return false;
+		}
+	}
+
+	entry->ntiles = load->ntiles;
+	entry->bytes = bytes;
+	entry->state = ENTRY_RESIDENT;
+	releaseLoad(entry, false);
+
+	m_stats.completedLoads++;
+	m_stats.residentTiles += entry->ntiles;
+	m_stats.residentBytes += entry->bytes;
+	m_stats.peakResidentBytes = dtMax(m_stats.peakResidentBytes, m_stats.residentBytes);
+	return true;
+}
+
+bool dtTileStreamer::isOverBudget(const int commits, const long long startTime) const
+{
+	if (m_params.maxCommitsPerUpdate > 0 && commits >= m_params.maxCommitsPerUpdate)
+		return true;
+	if (m_params.commitBudgetUsec > 0 && m_source->getTimeUsec() - startTime >= m_params.commitBudgetUsec)
+		return true;
+	return false;
+}
+
+/// @par
+///
+/// The tiles of a location are added to the navigation mesh with dtNavMesh::addTiles() and the
+/// #DT_TILE_FREE_DATA flag, and unloaded by removing every tile at the location. The streamer
+/// expects to own the tile locations it loads.
+///
+/// Each location loaded or unloaded counts as one commit against dtTileStreamParams::maxCommitsPerUpdate
+/// and dtTileStreamParams::commitBudgetUsec. Work that does not fit is left for the next update.
+dtStatus dtTileStreamer::update(bool* upToDate)
+{
+	if (!m_nav)
+		return DT_FAILURE;
+
+	const long long startTime = m_source->getTimeUsec();
+	bool deferred = false;
+	int commits = 0;
+
+	// Update the distances, and collect the loads that have finished.
+	int nready = 0;
+	float farthestResident = -FLT_MAX;
+	for (int i = 0; i < m_params.maxEntries; ++i)
+	{
+		Entry* entry = &m_entries[i];
+		if (entry->state == ENTRY_FREE)
+			continue;
+
+		entry->dist = calcDist(entry->x, entry->y);
+		const bool keep = entry->dist <= m_params.unloadMargin;
+
+		if (entry->state == ENTRY_LOADING)
+		{
+			dtTileStreamLoad* load = &m_loads[entry->load];
+			if (!keep && !entry->cancelled)
+			{
+				m_source->cancelLoad(load);
+				entry->cancelled = 1;
+			}
+			if (!m_source->isLoadDone(load))
+				continue;
+			if (entry->cancelled)
+			{
+				releaseLoad(entry, true);
+				freeEntry(entry);
+				m_stats.cancelledLoads++;
+			}
+			else if (dtStatusFailed(load->status))
+			{
+				// Keep the location as empty, so that it is not loaded again while it is in range.
+				releaseLoad(entry, true);
+				entry->state = ENTRY_RESIDENT;
+				m_stats.failedLoads++;
+			}
+			else
+			{
+				entry->state = ENTRY_READY;
+			}
+		}
+
+		if (entry->state == ENTRY_READY)
+		{
+			if (!keep)
+			{
+				releaseLoad(entry, true);
+				freeEntry(entry);
+				m_stats.cancelledLoads++;
+				continue;
+			}
+			// Insertion sort, nearest first.
+			int j = nready++;
+			for (; j > 0 && m_ready[j-1]->dist > entry->dist; --j)
+				m_ready[j] = m_ready[j-1];
+			m_ready[j] = entry;
+		}
+		else if (entry->state == ENTRY_RESIDENT)
+		{
+			if (!keep)
+			{
+				// Unload the tiles that are too far.
+				if (entry->ntiles > 0)
+				{
+					if (isOverBudget(commits, startTime))
+					{
+						deferred = true;
+						continue;
+					}
+					commits++;
+					m_stats.evictedTiles += entry->ntiles;
+					evictEntry(entry);
+				}
+				freeEntry(entry);
+			}
+			else if (entry->bytes > 0)
+			{
+				farthestResident = dtMax(farthestResident, entry->dist);
+			}
+		}
+	}
+
+	// Commit the finished loads, nearest first.
+	for (int i = 0; i < nready; ++i)
+	{
+		if (isOverBudget(commits, startTime))
+		{
+			deferred = true;
+			break;
+		}
+		commits++;
+		commitLoad(m_ready[i]);
+	}
+
+	// Start loading the nearest missing tiles.
+	bool missing = false;
+	int ncand = 0;
+	const bool memoryFull = m_params.maxResidentBytes > 0 && m_stats.residentBytes >= m_params.maxResidentBytes;
+	for (int i = 0; i < m_ninterest; ++i)
+	{
+		const float* p = &m_interestPos[i*3];
+		const float r = m_interestRadius[i];
+		const int minx = (int)dtMathFloorf((p[0] - r - m_orig[0]) / m_tileWidth);
+		const int miny = (int)dtMathFloorf((p[2] - r - m_orig[2]) / m_tileHeight);
+		const int maxx = (int)dtMathFloorf((p[0] + r - m_orig[0]) / m_tileWidth);
+		const int maxy = (int)dtMathFloorf((p[2] + r - m_orig[2]) / m_tileHeight);
+		for (int y = miny; y <= maxy; ++y)
+		{
+			for (int x = minx; x <= maxx; ++x)
+			{
+				const float dist = calcDist(x, y);
+				if (dist > 0 || findEntry(x, y))
+					continue;
+				missing = true;
+				// Tiles farther than everything resident would not fit anyway.
+				if (memoryFull && dist >= farthestResident)
+					continue;
+				if (ncand == m_nfreeLoads && (ncand == 0 || m_candidates[ncand-1].dist <= dist))
+					continue;
+				bool found = false;
+				for (int j = 0; j < ncand && !found; ++j)
+					found = m_candidates[j].x == x && m_candidates[j].y == y;
+				if (found)
+					continue;
+				// Insertion sort, nearest first.
+				int j = ncand < m_nfreeLoads ? ncand++ : ncand-1;
+				for (; j > 0 && m_candidates[j-1].dist > dist; --j)
+					m_candidates[j] = m_candidates[j-1];
+				m_candidates[j].x = x;
+				m_candidates[j].y = y;
+				m_candidates[j].dist = dist;
+			}
+		}
+	}
+
+	for (int i = 0; i < ncand; ++i)
+	{
+		Entry* entry = allocEntry(m_candidates[i].x, m_candidates[i].y);
+		if (!entry)
+			break;
+		entry->dist = m_candidates[i].dist;
+		entry->load = m_freeLoads[--m_nfreeLoads];
+
+		dtTileStreamLoad* load = &m_loads[entry->load];
+		memset(load, 0, sizeof(dtTileStreamLoad));
+		load->x = entry->x;
+		load->y = entry->y;
+		m_stats.requestedLoads++;
+		if (dtStatusFailed(m_source->beginLoad(load)))
+		{
+			releaseLoad(entry, true);
+			entry->state = ENTRY_RESIDENT;
+			m_stats.failedLoads++;
+		}
+	}
+
+	m_stats.pendingLoads = m_params.maxLoads - m_nfreeLoads;
+	if (deferred)
+		m_stats.deferredUpdates++;
+	if (upToDate)
+		*upToDate = !missing && !deferred && m_stats.pendingLoads == 0;
+
+	return DT_SUCCESS;
+}
+
+void dtTileStreamer::unloadAll()
+{
+	if (!m_nav)
+		return;
+	for (int i = 0; i < m_params.maxEntries; ++i)
+	{
+		Entry* entry = &m_entries[i];
+		if (entry->state == ENTRY_FREE)
+			continue;
+		if (entry->state == ENTRY_LOADING)
+		{
+			m_source->cancelLoad(&m_loads[entry->load]);
+			m_source->waitLoad(&m_loads[entry->load]);
+			releaseLoad(entry, true);
+			m_stats.cancelledLoads++;
+		}
+		else if (entry->state == ENTRY_READY)
+		{
+			releaseLoad(entry, true);
+			m_stats.cancelledLoads++;
+		}
+		else if (entry->ntiles > 0)
+		{
+			m_stats.evictedTiles += entry->ntiles;
+			evictEntry(entry);
+		}
+		freeEntry(entry);
+	}
+	m_stats.pendingLoads = 0;
+}
@@ -24,8 +24,36 @@
 
 static const unsigned int DT_PATHQ_INVALID = 0;
 
+/// The number of update ticks tracked by the latency histogram of dtPathQueueStats.
+/// Longer latencies are counted in the last bin.
+static const int DT_PATHQ_LATENCY_BINS = 64;
+
 typedef unsigned int dtPathQueueRef;
 
+/// Called from dtPathQueue::update when a request is done. The path is only valid during the call,
+/// and the request is released when the call returns, unless dtPathQueue::getPathResult released it.
+typedef void (*dtPathQueueCallback)(void* userData, dtPathQueueRef ref, dtStatus status,
+									const dtPolyRef* path, const int npath);
+
+/// Path queue statistics. The counters add up until dtPathQueue::resetStats().
+struct dtPathQueueStats
+{
+	int pendingRequests;		///< The number of requests waiting for a worker.
+	int peakPendingRequests;	///< The largest number of requests that have waited for a worker.
+	int completedRequests;		///< Requests that found a path, partial or not.
+	int failedRequests;			///< Requests that failed.
+	int expiredRequests;		///< Requests that reached their deadline, included in the counts above.
+	long long totalIterations;	///< The search iterations of the completed and failed requests.
+	int maxIterations;			///< The most search iterations taken by a request.
+	int latency[DT_PATHQ_LATENCY_BINS];	///< The number of requests done after each number of update ticks.
+};
+
+/// Finds paths asynchronously with sliced searches.
+///
+/// The pending requests wait in a queue that grows as needed, ordered by priority and
+/// then by age. Each update hands them out to a number of workers, each with its own
+/// query object, and runs the workers through a dtTaskRunner, so that they can search
+/// in parallel.
 class dtPathQueue
 {
 	struct PathQuery
@@ -39,36 +67,101 @@ class dtPathQueue
 		int npath;
 		/// State.
 		dtStatus status;
-		int keepAlive;
+		int doneTick;				///< The update tick when the request was done.
 		const dtQueryFilter* filter; ///< TODO: This is potentially dangerous!
+		/// Scheduling.
+		int priority;
+		unsigned int order;			///< The request count when the request was made, for FIFO order.
+		int requestTick;			///< The update tick when the request was made.
+		int deadlineTick;			///< The update tick by which the request ends, or zero.
+		int iterations;
+		dtPathQueueCallback callback;
+		void* userData;
+		int next;					///< The next free request, request whose callback is due, or done request.
+		int prev;					///< The previous done request.
+	};
+
+	struct Worker
+	{
+		dtNavMeshQuery* navquery;
+		int request;				///< The index of the request being searched, or -1.
+		int iters;					///< The iterations left in the current update.
 	};
 	
-	static const int MAX_QUEUE = 8;
-	PathQuery m_queue[MAX_QUEUE];
+	PathQuery* m_queue;
+	int m_queueSize;
+	int m_freeRequest;
+	int m_finishedHead, m_finishedTail;	///< The requests whose callbacks are due.
+	int m_doneHead, m_doneTail;		///< The done requests without callbacks, in the order they were done.
+	int* m_pending;					///< A heap of the requests waiting for a worker. [Size: m_queueSize]
+	int m_npending;
+	Worker* m_workers;
+	int m_nworkers;
 	dtPathQueueRef m_nextHandle;
+	unsigned int m_order;
+	int m_tick;
 	int m_maxPathSize;
-	int m_queueHead;
-	dtNavMeshQuery* m_navquery;
+	dtPathQueueStats m_stats;
 	
 	void purge();
+	bool grow();
+	bool isBefore(const int a, const int b) const;
+	void pushPending(const int request);
+	int popPending();
+	void expirePending();
+	void finishRequest(const int request);
+	void freeRequest(const int request);
+	void unlinkDone(const int request);
+	int findRequest(dtPathQueueRef ref) const;
+	void updateWorker(Worker& worker);
+	static void updateWorkers(void* userData, const int begin, const int end);
 	
 public:
 	dtPathQueue();
 	~dtPathQueue();
 	
-	bool init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav);
+	/// Initializes the queue.
+	///  @param[in]		maxPathSize			The maximum number of polygons of a path.
+	///  @param[in]		maxSearchNodeCount	The maximum number of search nodes of each worker.
+	///  @param[in]		nav					The navigation mesh.
+	///  @param[in]		maxWorkers			The number of searches run at once. [Limit: > 0, 1 if the tiles of
+	///										@p nav are compressed (See: dtNavMesh::setTileCompression)]
+	bool init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav, const int maxWorkers = 1);
 	
-	void update(const int maxIters);
+	/// Runs the searches for up to @p maxIters iterations per worker.
+	///  @param[in]		maxIters	The maximum number of search iterations of each worker.
+	///  @param[in]		runner		Runs the workers in parallel. [opt] Not used while the tiles of the
+	///								navigation mesh are compressed.
+	void update(const int maxIters, dtTaskRunner* runner = 0);
 	
+	/// Requests a path.
+	///  @param[in]		priority	The requests with a higher priority are searched first.
+	///  @param[in]		deadline	The number of updates within which the request ends, or zero for no limit.
+	///							 	A search still running then returns its partial path.
+	///  @param[in]		callback	Called when the request is done, instead of polling the request. [opt]
+	///  @param[in]		userData	The data passed to @p callback. [opt]
+	/// @return The reference of the request, or #DT_PATHQ_INVALID if the queue could not grow.
 	dtPathQueueRef request(dtPolyRef startRef, dtPolyRef endRef,
 						   const float* startPos, const float* endPos, 
-						   const dtQueryFilter* filter);
+						   const dtQueryFilter* filter, const int priority = 0, const int deadline = 0,
+						   dtPathQueueCallback callback = 0, void* userData = 0);
 	
 	dtStatus getRequestStatus(dtPathQueueRef ref) const;
 	
 	dtStatus getPathResult(dtPathQueueRef ref, dtPolyRef* path, int* pathSize, const int maxPath);
 	
-	inline const dtNavMeshQuery* getNavQuery() const { return m_navquery; }
+	inline const dtNavMeshQuery* getNavQuery() const { return m_nworkers ? m_workers[0].navquery : 0; }
+	inline int getWorkerCount() const { return m_nworkers; }
+	inline const dtNavMeshQuery* getWorkerNavQuery(const int i) const { return m_workers[i].navquery; }
+
+	inline const dtPathQueueStats& getStats() const { return m_stats; }
+
+	/// Resets the counters of the statistics.
+	void resetStats();
+
+	/// Returns the number of update ticks within which the given fraction of the requests were done.
+	///  @param[in]		fraction	The fraction of the requests, e.g. 0.9 for the 90th percentile. [Limits: 0 <= value <= 1]
+	int getLatencyPercentile(const float fraction) const;
 
 private:
 	// Explicitly disabled copy constructor and copy assignment operator.
@@ -21,17 +21,34 @@
 #include "DetourNavMesh.h"
 #include "DetourNavMeshQuery.h"
 #include "DetourAlloc.h"
+#include "DetourAssert.h"
 #include "DetourCommon.h"
+#include "DetourMath.h"
+
+// The request index is in the low bits of the request references.
+static const int PATHQ_INDEX_BITS = 20;
+static const int PATHQ_MAX_QUEUE = 1 << PATHQ_INDEX_BITS;
+static const unsigned int PATHQ_MAX_HANDLE = (1u << (32 - PATHQ_INDEX_BITS)) - 1;
 
 
 dtPathQueue::dtPathQueue() :
+	m_queue(0),
+	m_queueSize(0),
+	m_freeRequest(-1),
+	m_finishedHead(-1),
+	m_finishedTail(-1),
+	m_doneHead(-1),
+	m_doneTail(-1),
+	m_pending(0),
+	m_npending(0),
+	m_workers(0),
+	m_nworkers(0),
 	m_nextHandle(1),
-	m_maxPathSize(0),
-	m_queueHead(0),
-	m_navquery(0)
+	m_order(0),
+	m_tick(0),
+	m_maxPathSize(0)
 {
-	for (int i = 0; i < MAX_QUEUE; ++i)
-		m_queue[i].path = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
 }
 
 dtPathQueue::~dtPathQueue()
@@ -41,119 +58,402 @@ dtPathQueue::~dtPathQueue()
 
 void dtPathQueue::purge()
 {
-	dtFreeNavMeshQuery(m_navquery);
-	m_navquery = 0;
-	for (int i = 0; i < MAX_QUEUE; ++i)
-	{
+	for (int i = 0; i < m_nworkers; ++i)
+		dtFreeNavMeshQuery(m_workers[i].navquery);
+	dtFree(m_workers);
+	m_workers = 0;
+	m_nworkers = 0;
+	for (int i = 0; i < m_queueSize; ++i)
 		dtFree(m_queue[i].path);
-		m_queue[i].path = 0;
-	}
+	dtFree(m_queue);
+	m_queue = 0;
+	m_queueSize = 0;
+	m_freeRequest = -1;
+	m_finishedHead = -1;
+	m_finishedTail = -1;
+	m_doneHead = -1;
+	m_doneTail = -1;
+	dtFree(m_pending);
+	m_pending = 0;
+	m_npending = 0;
 }
 
-bool dtPathQueue::init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav)
+bool dtPathQueue::init(const int maxPathSize, const int maxSearchNodeCount, dtNavMesh* nav, const int maxWorkers)
 {
 	purge();
 
-	m_navquery = dtAllocNavMeshQuery();
-	if (!m_navquery)
+	if (maxWorkers <= 0)
 		return false;
-	if (dtStatusFailed(m_navquery->init(nav, maxSearchNodeCount)))
+	// The workers would decompress the tiles of the navigation mesh at the same time.
+	if (maxWorkers > 1 && nav->isTileCompressionEnabled())
 		return false;
-	
-	m_maxPathSize = maxPathSize;
-	for (int i = 0; i < MAX_QUEUE; ++i)
+
+	m_workers = (Worker*)dtAlloc(sizeof(Worker)*maxWorkers, DT_ALLOC_PERM);
+	if (!m_workers)
+		return false;
+	for (int i = 0; i < maxWorkers; ++i)
 	{
-		m_queue[i].ref = DT_PATHQ_INVALID;
-		m_queue[i].path = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*m_maxPathSize, DT_ALLOC_PERM);
-		if (!m_queue[i].path)
+		Worker& worker = m_workers[i];
+		worker.navquery = dtAllocNavMeshQuery();
+		worker.request = -1;
+		worker.iters = 0;
+		if (!worker.navquery)
+			return false;
+		m_nworkers++;
+		if (dtStatusFailed(worker.navquery->init(nav, maxSearchNodeCount)))
 			return false;
 	}
 	
-	m_queueHead = 0;
+	m_maxPathSize = maxPathSize;
+	m_tick = 0;
+	memset(&m_stats, 0, sizeof(m_stats));
 	
-	return true;
+	return grow();
 }
 
-void dtPathQueue::update(const int maxIters)
+bool dtPathQueue::grow()
 {
-	static const int MAX_KEEP_ALIVE = 2; // in update ticks.
+	static const int MIN_QUEUE = 8;
+	const int size = m_queueSize ? m_queueSize*2 : MIN_QUEUE;
+	if (size > PATHQ_MAX_QUEUE)
+		return false;
 
-	// Update path request until there is nothing to update
-	// or upto maxIters pathfinder iterations has been consumed.
-	int iterCount = maxIters;
-	
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	PathQuery* queue = (PathQuery*)dtAlloc(sizeof(PathQuery)*size, DT_ALLOC_PERM);
+	int* pending = (int*)dtAlloc(sizeof(int)*size, DT_ALLOC_PERM);
+	if (!queue || !pending)
 	{
-		PathQuery& q = m_queue[m_queueHead % MAX_QUEUE];
-		
-		// Skip inactive requests.
-		if (q.ref == DT_PATHQ_INVALID)
-		{
-			m_queueHead++;
+		dtFree(queue);
+		dtFree(pending);
+		return false;
+	}
+	if (m_queueSize)
+	{
+		memcpy(queue, m_queue, sizeof(PathQuery)*m_queueSize);
+		memcpy(pending, m_pending, sizeof(int)*m_npending);
+	}
+	dtFree(m_queue);
+	dtFree(m_pending);
+	m_queue = queue;
+	m_pending = pending;
+
+	// Add the new requests to the free list, keeping the lowest first.
+	int added = 0;
+	for (int i = size-1; i >= m_queueSize; --i)
+	{
+		PathQuery& q = m_queue[i];
+		q.ref = DT_PATHQ_INVALID;
+		q.path = (dtPolyRef*)dtAlloc(sizeof(dtPolyRef)*m_maxPathSize, DT_ALLOC_PERM);
+		if (!q.path)
 			continue;
-		}
-		
-		// Handle completed request.
-		if (dtStatusSucceed(q.status) || dtStatusFailed(q.status))
+		q.status = 0;
+		q.next = m_freeRequest;
+		m_freeRequest = i;
+		added++;
+	}
+	const int oldSize = m_queueSize;
+	m_queueSize = size;
+	// Requests whose path could not be allocated stay out of the free list.
+	for (int i = oldSize; i < size; ++i)
+	{
+		if (!m_queue[i].path)
+			m_queue[i].next = -1;
+	}
+
+	return added > 0;
+}
+
+// Returns true if the request a is searched before b: higher priority first, then older first.
+bool dtPathQueue::isBefore(const int a, const int b) const
+{
+	const PathQuery& qa = m_queue[a];
+	const PathQuery& qb = m_queue[b];
+	if (qa.priority != qb.priority)
+		return qa.priority > qb.priority;
+	return (int)(qa.order - qb.order) < 0;
+}
+
+void dtPathQueue::pushPending(const int request)
+{
+	int i = m_npending++;
+	while (i > 0)
+	{
+		const int parent = (i-1)/2;
+		if (!isBefore(request, m_pending[parent]))
+			break;
+		m_pending[i] = m_pending[parent];
+		i = parent;
+	}
+	m_pending[i] = request;
+}
+
+int dtPathQueue::popPending()
+{
+	const int top = m_pending[0];
+	const int last = m_pending[--m_npending];
+	int i = 0;
+	for (;;)
+	{
+		int child = i*2+1;
+		if (child >= m_npending)
+			break;
+		if (child+1 < m_npending && isBefore(m_pending[child+1], m_pending[child]))
+			child++;
+		if (!isBefore(m_pending[child], last))
+			break;
+		m_pending[i] = m_pending[child];
+		i = child;
+	}
+	if (m_npending)
+		m_pending[i] = last;
+	return top;
+}
+
+// Fails the pending requests that reached their deadline before a worker got to them.
+void dtPathQueue::expirePending()
+{
+	int n = 0;
+	for (int i = 0; i < m_npending; ++i)
+	{
+		const int request = m_pending[i];
+		PathQuery& q = m_queue[request];
+		if (q.deadlineTick && m_tick >= q.deadlineTick)
 		{
-			// If the path result has not been read in few frames, free the slot.
-			q.keepAlive++;
-			if (q.keepAlive > MAX_KEEP_ALIVE)
-			{
-				q.ref = DT_PATHQ_INVALID;
-				q.status = 0;
-			}
-			
-			m_queueHead++;
-			continue;
+			q.status = DT_FAILURE;
+			m_stats.expiredRequests++;
+			finishRequest(request);
 		}
-		
-		// Handle query start.
-		if (q.status == 0)
+		else
 		{
-			q.status = m_navquery->initSlicedFindPath(q.startRef, q.endRef, q.startPos, q.endPos, q.filter);
-		}		
-		// Handle query in progress.
-		if (dtStatusInProgress(q.status))
+			m_pending[n++] = request;
+		}
+	}
+	if (n == m_npending)
+		return;
+
+	// Rebuild the heap.
+	const int count = n;
+	m_npending = 0;
+	for (int i = 0; i < count; ++i)
+		pushPending(m_pending[i]);
+}
+
+void dtPathQueue::finishRequest(const int request)
+{
+	PathQuery& q = m_queue[request];
+	q.doneTick = m_tick;
+
+	if (dtStatusFailed(q.status))
+		m_stats.failedRequests++;
+	else
+		m_stats.completedRequests++;
+	m_stats.totalIterations += q.iterations;
+	m_stats.maxIterations = dtMax(m_stats.maxIterations, q.iterations);
+	m_stats.latency[dtMin(m_tick - q.requestTick, DT_PATHQ_LATENCY_BINS-1)]++;
+
+	// Queue the callback.
+	if (q.callback)
+	{
+		q.next = -1;
+		if (m_finishedTail != -1)
+			m_queue[m_finishedTail].next = request;
+		else
+			m_finishedHead = request;
+		m_finishedTail = request;
+	}
+	// Or wait for the result to be read, the requests are done in the order they expire.
+	else
+	{
+		q.next = -1;
+		q.prev = m_doneTail;
+		if (m_doneTail != -1)
+			m_queue[m_doneTail].next = request;
+		else
+			m_doneHead = request;
+		m_doneTail = request;
+	}
+}
+
+void dtPathQueue::unlinkDone(const int request)
+{
+	const PathQuery& q = m_queue[request];
+	if (q.prev != -1)
+		m_queue[q.prev].next = q.next;
+	else
+		m_doneHead = q.next;
+	if (q.next != -1)
+		m_queue[q.next].prev = q.prev;
+	else
+		m_doneTail = q.prev;
+}
+
+void dtPathQueue::freeRequest(const int request)
+{
+	PathQuery& q = m_queue[request];
+	if (q.ref == DT_PATHQ_INVALID)
+		return;
+	// The done requests with callbacks are freed after their callback, the others wait in a list.
+	if (!q.callback && q.status != 0 && !dtStatusInProgress(q.status))
+		unlinkDone(request);
+	q.ref = DT_PATHQ_INVALID;
+	q.status = 0;
+	q.next = m_freeRequest;
+	m_freeRequest = request;
+}
+
+int dtPathQueue::findRequest(dtPathQueueRef ref) const
+{
+	const int request = (int)(ref & (PATHQ_MAX_QUEUE-1));
+	if (ref == DT_PATHQ_INVALID || request >= m_queueSize || m_queue[request].ref != ref)
+		return -1;
+	return request;
+}
+
+// Runs the search of a worker, only touching the worker and its request.
+void dtPathQueue::updateWorker(Worker& worker)
+{
+	PathQuery& q = m_queue[worker.request];
+
+	// Handle query start.
+	if (q.status == 0)
+	{
+		q.status = worker.navquery->initSlicedFindPath(q.startRef, q.endRef, q.startPos, q.endPos, q.filter);
+	}
+	// Handle query in progress.
+	if (dtStatusInProgress(q.status))
+	{
+		int iters = 0;
+		q.status = worker.navquery->updateSlicedFindPath(worker.iters, &iters);
+		worker.iters -= iters;
+		q.iterations += iters;
+	}
+	if (dtStatusSucceed(q.status))
+	{
+		q.status = worker.navquery->finalizeSlicedFindPath(q.path, &q.npath, m_maxPathSize);
+	}
+}
+
+void dtPathQueue::updateWorkers(void* userData, const int begin, const int end)
+{
+	dtPathQueue* pathq = (dtPathQueue*)userData;
+	for (int i = begin; i < end; ++i)
+	{
+		Worker& worker = pathq->m_workers[i];
+		if (worker.request != -1 && worker.iters > 0)
+			pathq->updateWorker(worker);
+	}
+}
+
+/// @par
+///
+/// The workers take the pending requests in order. A worker that finishes its search takes
+/// the next request in the same update, until it has used its iterations. The callbacks
+/// of the finished requests are called from this function.
+///
+/// The workers only read the navigation mesh, which must not change during the update.
+/// Tile compression changes the mesh when a compressed tile is used, so it needs a runner
+/// that runs the workers one at a time.
+void dtPathQueue::update(const int maxIters, dtTaskRunner* runner)
+{
+	static const int MAX_KEEP_ALIVE = 2; // in update ticks.
+
+	m_tick++;
+
+	// If the path result has not been read in few frames, free the slot.
+	while (m_doneHead != -1 && m_tick - m_queue[m_doneHead].doneTick > MAX_KEEP_ALIVE)
+		freeRequest(m_doneHead);
+
+	for (int i = 0; i < m_nworkers; ++i)
+		m_workers[i].iters = maxIters;
+
+	for (;;)
+	{
+		// Hand out the pending requests to the idle workers.
+		int active = 0;
+		for (int i = 0; i < m_nworkers; ++i)
 		{
-			int iters = 0;
-			q.status = m_navquery->updateSlicedFindPath(iterCount, &iters);
-			iterCount -= iters;
+			Worker& worker = m_workers[i];
+			if (worker.iters <= 0)
+				continue;
+			if (worker.request == -1 && m_npending)
+				worker.request = popPending();
+			if (worker.request != -1)
+				active++;
 		}
-		if (dtStatusSucceed(q.status))
+		if (!active)
+			break;
+
+		// The compression may have been enabled after init.
+		const bool compressed = m_workers[0].navquery->getAttachedNavMesh()->isTileCompressionEnabled();
+		dtAssert(!(runner && m_nworkers > 1 && compressed));
+		if (runner && !compressed)
+			runner->parallelFor(m_nworkers, updateWorkers, this);
+		else
+			updateWorkers(this, 0, m_nworkers);
+
+		// Handle completed requests.
+		for (int i = 0; i < m_nworkers; ++i)
 		{
-			q.status = m_navquery->finalizeSlicedFindPath(q.path, &q.npath, m_maxPathSize);
+			Worker& worker = m_workers[i];
+			if (worker.request == -1 || dtStatusInProgress(m_queue[worker.request].status))
+				continue;
+			finishRequest(worker.request);
+			worker.request = -1;
 		}
+	}
 
-		if (iterCount <= 0)
-			break;
+	// The searches that reached their deadline return the path to the node nearest the end.
+	for (int i = 0; i < m_nworkers; ++i)
+	{
+		Worker& worker = m_workers[i];
+		if (worker.request == -1)
+			continue;
+		PathQuery& q = m_queue[worker.request];
+		if (!q.deadlineTick || m_tick < q.deadlineTick)
+			continue;
+		q.status = worker.navquery->finalizeSlicedFindPath(q.path, &q.npath, m_maxPathSize);
+		m_stats.expiredRequests++;
+		finishRequest(worker.request);
+		worker.request = -1;
+	}
+	expirePending();
+
+	m_stats.pendingRequests = m_npending;
 
-		m_queueHead++;
+	// Call the callbacks last, in the order the requests were done, as they can make new requests.
+	int request = m_finishedHead;
+	m_finishedHead = m_finishedTail = -1;
+	while (request != -1)
+	{
+		const PathQuery& q = m_queue[request];
+		const int next = q.next;
+		const dtPathQueueRef ref = q.ref;
+		q.callback(q.userData, ref, q.status, q.path, dtStatusFailed(q.status) ? 0 : q.npath);
+		// The callback may have read the result, freeing the request, and a new request may
+		// have taken its slot since.
+		if (m_queue[request].ref == ref)
+			freeRequest(request);
+		request = next;
 	}
 }
 
 dtPathQueueRef dtPathQueue::request(dtPolyRef startRef, dtPolyRef endRef,
 									const float* startPos, const float* endPos,
-									const dtQueryFilter* filter)
+									const dtQueryFilter* filter, const int priority, const int deadline,
+									dtPathQueueCallback callback, void* userData)
 {
+	if (!m_nworkers)
+		return DT_PATHQ_INVALID;
+
 	// Find empty slot
-	int slot = -1;
-	for (int i = 0; i < MAX_QUEUE; ++i)
-	{
-		if (m_queue[i].ref == DT_PATHQ_INVALID)
-		{
-			slot = i;
-			break;
-		}
-	}
-	// Could not find slot.
-	if (slot == -1)
+	if (m_freeRequest == -1 && !grow())
 		return DT_PATHQ_INVALID;
+	const int slot = m_freeRequest;
 	
-	dtPathQueueRef ref = m_nextHandle++;
-	if (m_nextHandle == DT_PATHQ_INVALID) m_nextHandle++;
+	dtPathQueueRef ref = (m_nextHandle << PATHQ_INDEX_BITS) | (dtPathQueueRef)slot;
+	if (++m_nextHandle > PATHQ_MAX_HANDLE) m_nextHandle = 1;
 	
 	PathQuery& q = m_queue[slot];
+	m_freeRequest = q.next;
 	q.ref = ref;
 	dtVcopy(q.startPos, startPos);
 	q.startRef = startRef;
@@ -163,38 +463,73 @@ dtPathQueueRef dtPathQueue::request(dtPolyRef startRef, dtPolyRef endRef,
 	q.status = 0;
 	q.npath = 0;
 	q.filter = filter;
-	q.keepAlive = 0;
+	q.doneTick = 0;
+	q.priority = priority;
+	q.order = m_order++;
+	q.requestTick = m_tick;
+	q.deadlineTick = deadline > 0 ? m_tick + deadline : 0;
+	q.iterations = 0;
+	q.callback = callback;
+	q.userData = userData;
+	q.next = -1;
+	q.prev = -1;
+
+	pushPending(slot);
+	m_stats.pendingRequests = m_npending;
+	m_stats.peakPendingRequests = dtMax(m_stats.peakPendingRequests, m_npending);
 	
 	return ref;
 }
 
 dtStatus dtPathQueue::getRequestStatus(dtPathQueueRef ref) const
 {
-	for (int i = 0; i < MAX_QUEUE; ++i)
-	{
-		if (m_queue[i].ref == ref)
-			return m_queue[i].status;
-	}
-	return DT_FAILURE;
+	const int request = findRequest(ref);
+	if (request == -1)
+		return DT_FAILURE;
+	return m_queue[request].status;
 }
 
 dtStatus dtPathQueue::getPathResult(dtPathQueueRef ref, dtPolyRef* path, int* pathSize, const int maxPath)
 {
-	for (int i = 0; i < MAX_QUEUE; ++i)
+	const int request = findRequest(ref);
+	if (request == -1)
+		return DT_FAILURE;
+
+	PathQuery& q = m_queue[request];
+	if (q.status == 0 || dtStatusInProgress(q.status))
+		return DT_FAILURE;
+	dtStatus details = q.status & DT_STATUS_DETAIL_MASK;
+	// Copy path
+	int n = dtStatusFailed(q.status) ? 0 : dtMin(q.npath, maxPath);
+	memcpy(path, q.path, sizeof(dtPolyRef)*n);
+	*pathSize = n;
+	// Free request for reuse.
+	freeRequest(request);
+	return details | DT_SUCCESS;
+}
+
+void dtPathQueue::resetStats()
+{
+	memset(&m_stats, 0, sizeof(m_stats));
+	m_stats.pendingRequests = m_npending;
+	m_stats.peakPendingRequests = m_npending;
+}
+
+int dtPathQueue::getLatencyPercentile(const float fraction) const
+{
+	int count = 0;
+	for (int i = 0; i < DT_PATHQ_LATENCY_BINS; ++i)
+		count += m_stats.latency[i];
+	if (!count)
+		return 0;
+
+	const int target = dtMax(1, (int)dtMathCeilf(fraction * count));
+	int n = 0;
+	for (int i = 0; i < DT_PATHQ_LATENCY_BINS; ++i)
 	{
-		if (m_queue[i].ref == ref)
-		{
-			PathQuery& q = m_queue[i];
-			dtStatus details = q.status & DT_STATUS_DETAIL_MASK;
-			// Free request for reuse.
-			q.ref = DT_PATHQ_INVALID;
-			q.status = 0;
-			// Copy path
-			int n = dtMin(q.npath, maxPath);
-			memcpy(path, q.path, sizeof(dtPolyRef)*n);
-			*pathSize = n;
-			return details | DT_SUCCESS;
-		}
+		n += m_stats.latency[i];
+		if (n >= target)
+			return i;
 	}
-	return DT_FAILURE;
+	return DT_PATHQ_LATENCY_BINS-1;
 }
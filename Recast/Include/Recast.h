@@ -95,6 +95,10 @@ enum rcTimerLabel
 	RC_MAX_TIMERS
 };
 
+/// A function that processes the items [@p begin, @p end) of a parallel loop.
+/// @see rcContext::parallelFor
+typedef void (*rcParallelForFunc)(void* userData, const int begin, const int end);
+
 /// Provides an interface for optional logging and performance tracking of the Recast 
 /// build process.
 /// @ingroup recast
@@ -139,6 +143,12 @@ public:
 	///  @return The accumulated time of the timer, or -1 if timers are disabled or the timer has never been started.
 	inline int getAccumulatedTime(const rcTimerLabel label) const { return m_timerEnabled ? doGetAccumulatedTime(label) : -1; }
 
+	/// Runs @p func over the items [0, @p count), possibly split into ranges that run concurrently.
+	///  @param[in]		count		The number of items.
+	///  @param[in]		func		The function to run on each range of items.
+	///  @param[in]		userData	The data passed to @p func.
+	inline void parallelFor(const int count, rcParallelForFunc func, void* userData) { if (count > 0) doParallelFor(count, func, userData); }
+
 protected:
 
 	/// Clears all log entries.
@@ -165,6 +175,16 @@ protected:
 	///  @param[in]		label	The category of the timer.
 	///  @return The accumulated time of the timer, or -1 if timers are disabled or the timer has never been started.
 	virtual int doGetAccumulatedTime(const rcTimerLabel /*label*/) const { return -1; }
+
+	/// Runs @p func over the items [0, @p count).
+	/// The default implementation runs a single range on the calling thread. Override this
+	/// to run the ranges on a thread pool; the ranges must be disjoint, cover every item and
+	/// all be finished when the call returns. The functions run this way do not log or use
+	/// the timers, but they do allocate, so the allocator must be thread-safe.
+	///  @param[in]		count		The number of items. [Limit: > 0]
+	///  @param[in]		func		The function to run on each range of items.
+	///  @param[in]		userData	The data passed to @p func.
+	virtual void doParallelFor(const int count, rcParallelForFunc func, void* userData) { func(userData, 0, count); }
 	
 	/// True if logging is enabled.
 	bool m_logEnabled;
@@ -312,6 +332,33 @@ private:
 	rcHeightfield& operator=(const rcHeightfield&);
 };
 
+/// A heightfield covering the grid of a whole tiled build, stored as square chunks of cells.
+/// Geometry is rasterized into the store once, and each tile then copies its bordered
+/// area out of it instead of rasterizing the border it shares with its neighbours.
+/// @ingroup recast
+/// @see rcAllocHeightfieldStore, rcCreateHeightfieldStore, rcRasterizeTrianglesToStore, rcCopyHeightfieldFromStore
+struct rcHeightfieldStore
+{
+	rcHeightfieldStore();
+	~rcHeightfieldStore();
+
+	int width;				///< The width of the store. (Along the x-axis in cell units.)
+	int height;				///< The height of the store. (Along the z-axis in cell units.)
+	int chunkSize;			///< The width/height of a chunk. (In cell units.)
+	int nchunksx;			///< The number of chunks along the x-axis.
+	int nchunksy;			///< The number of chunks along the z-axis.
+	float bmin[3];  		///< The minimum bounds in world space. [(x, y, z)]
+	float bmax[3];			///< The maximum bounds in world space. [(x, y, z)]
+	float cs;				///< The size of each cell. (On the xz-plane.)
+	float ch;				///< The height of each cell. (The minimum increment along the y-axis.)
+	rcHeightfield** chunks;	///< The chunks, or null where nothing has been rasterized yet. [Size: #nchunksx*#nchunksy]
+
+private:
+	// Explicitly-disabled copy constructor and copy assignment operator.
+	rcHeightfieldStore(const rcHeightfieldStore&);
+	rcHeightfieldStore& operator=(const rcHeightfieldStore&);
+};
+
 /// Provides information on the content of a cell column in a compact heightfield. 
 struct rcCompactCell
 {
@@ -449,6 +496,37 @@ struct rcPolyMeshDetail
 	int ntris;				///< The number of triangles in #tris.
 };
 
+/// A node in a chunky triangle mesh.
+/// @see rcChunkyTriMesh
+struct rcChunkyTriMeshNode
+{
+	float bmin[3];	///< The minimum bounds of the node's triangles. [(x, y, z)]
+	float bmax[3];	///< The maximum bounds of the node's triangles. [(x, y, z)]
+	int i;			///< The index of the leaf's first triangle in rcChunkyTriMesh::tris, or the negated escape offset of an internal node.
+	int n;			///< The number of triangles in the leaf.
+};
+
+/// A triangle mesh partitioned into an AABB tree of small chunks of triangles, used to
+/// quickly gather the input geometry overlapping a tile, a box or a segment.
+/// @ingroup recast
+/// @see rcAllocChunkyTriMesh, rcCreateChunkyTriMesh, rcGetChunksOverlappingRect
+struct rcChunkyTriMesh
+{
+	rcChunkyTriMesh();
+	~rcChunkyTriMesh();
+
+	rcChunkyTriMeshNode* nodes;	///< The tree nodes in depth-first order. [Size: #nnodes]
+	int nnodes;					///< The number of nodes.
+	int* tris;					///< The triangles, stored contiguously per leaf. [(vertA, vertB, vertC) * #ntris]
+	int ntris;					///< The number of triangles.
+	int maxTrisPerChunk;		///< The largest number of triangles in a leaf.
+
+private:
+	// Explicitly-disabled copy constructor and copy assignment operator.
+	rcChunkyTriMesh(const rcChunkyTriMesh&);
+	rcChunkyTriMesh& operator=(const rcChunkyTriMesh&);
+};
+
 /// @name Allocation Functions
 /// Functions used to allocate and de-allocate Recast objects.
 /// @see rcAllocSetCustom
@@ -466,6 +544,30 @@ rcHeightfield* rcAllocHeightfield();
 ///  @see rcAllocHeightfield
 void rcFreeHeightField(rcHeightfield* hf);
 
+/// Allocates a heightfield store object using the Recast allocator.
+///  @return A heightfield store that is ready for initialization, or null on failure.
+///  @ingroup recast
+///  @see rcCreateHeightfieldStore, rcFreeHeightfieldStore
+rcHeightfieldStore* rcAllocHeightfieldStore();
+
+/// Frees the specified heightfield store object using the Recast allocator.
+///  @param[in]		store	A heightfield store allocated using #rcAllocHeightfieldStore
+///  @ingroup recast
+///  @see rcAllocHeightfieldStore
+void rcFreeHeightfieldStore(rcHeightfieldStore* store);
+
+/// Allocates a chunky triangle mesh object using the Recast allocator.
+///  @return A chunky triangle mesh that is ready for initialization, or null on failure.
+///  @ingroup recast
+///  @see rcCreateChunkyTriMesh, rcFreeChunkyTriMesh
+rcChunkyTriMesh* rcAllocChunkyTriMesh();
+
+/// Frees the specified chunky triangle mesh using the Recast allocator.
+///  @param[in]		cm		A chunky triangle mesh allocated using #rcAllocChunkyTriMesh
+///  @ingroup recast
+///  @see rcAllocChunkyTriMesh
+void rcFreeChunkyTriMesh(rcChunkyTriMesh* cm);
+
 /// Allocates a compact heightfield object using the Recast allocator.
 ///  @return A compact heightfield that is ready for initialization, or null on failure.
 ///  @ingroup recast
@@ -805,6 +907,21 @@ bool rcCreateHeightfield(rcContext* ctx, rcHeightfield& hf, int width, int heigh
 						 const float* bmin, const float* bmax,
 						 float cs, float ch);
 
+/// Initializes a new heightfield store.
+///  @ingroup recast
+///  @param[in,out]	ctx			The build context to use during the operation.
+///  @param[in,out]	store		The allocated heightfield store to initialize.
+///  @param[in]		width		The width of the store along the x-axis. [Limit: >= 0] [Units: vx]
+///  @param[in]		height		The height of the store along the z-axis. [Limit: >= 0] [Units: vx]
+///  @param[in]		chunkSize	The width/height of a chunk. [Limit: > 0] [Units: vx]
+///  @param[in]		bmin		The minimum bounds of the store's AABB. [(x, y, z)] [Units: wu]
+///  @param[in]		bmax		The maximum bounds of the store's AABB. [(x, y, z)] [Units: wu]
+///  @param[in]		cs			The xz-plane cell size to use for the store. [Limit: > 0] [Units: wu]
+///  @param[in]		ch			The y-axis cell size to use for the store. [Limit: > 0] [Units: wu]
+///  @returns True if the operation completed successfully.
+bool rcCreateHeightfieldStore(rcContext* ctx, rcHeightfieldStore& store, int width, int height, int chunkSize,
+							  const float* bmin, const float* bmax, float cs, float ch);
+
 /// Sets the area id of all triangles with a slope below the specified value
 /// to #RC_WALKABLE_AREA.
 ///  @ingroup recast
@@ -909,6 +1026,50 @@ bool rcRasterizeTriangles(rcContext* ctx, const float* verts, const int nv,
 bool rcRasterizeTriangles(rcContext* ctx, const float* verts, const unsigned char* areas, const int nt,
 						  rcHeightfield& solid, const int flagMergeThr = 1);
 
+/// Rasterizes an indexed triangle mesh into the chunks of the specified heightfield store.
+///  @ingroup recast
+///  @param[in,out]	ctx				The build context to use during the operation.
+///  @param[in]		verts			The vertices. [(x, y, z) * @p nv]
+///  @param[in]		nv				The number of vertices.
+///  @param[in]		tris			The triangle indices. [(vertA, vertB, vertC) * @p nt]
+///  @param[in]		areas			The area id's of the triangles. [Limit: <= #RC_WALKABLE_AREA] [Size: @p nt]
+///  @param[in]		nt				The number of triangles.
+///  @param[in,out]	store			An initialized heightfield store.
+///  @param[in]		flagMergeThr	The distance where the walkable flag is favored over the non-walkable flag. 
+///  								[Limit: >= 0] [Units: vx]
+///  @returns True if the operation completed successfully.
+bool rcRasterizeTrianglesToStore(rcContext* ctx, const float* verts, const int nv,
+								 const int* tris, const unsigned char* areas, const int nt,
+								 rcHeightfieldStore& store, const int flagMergeThr = 1);
+
+/// Copies the spans of the store cells covered by the specified heightfield into it,
+/// except for its outermost rows and columns.
+///  @ingroup recast
+///  @param[in,out]	ctx		The build context to use during the operation.
+///  @param[in]		store	A heightfield store with all geometry rasterized.
+///  @param[in]		x		The store column of the heightfield's first cell. [Units: vx]
+///  @param[in]		y		The store row of the heightfield's first cell. [Units: vx]
+///  @param[in,out]	hf		An initialized, empty heightfield.
+///  @returns True if the operation completed successfully.
+bool rcCopyHeightfieldFromStore(rcContext* ctx, const rcHeightfieldStore& store, const int x, const int y,
+								rcHeightfield& hf);
+
+/// Rasterizes an indexed triangle mesh into the outermost rows and columns of the specified heightfield only.
+///  @ingroup recast
+///  @param[in,out]	ctx				The build context to use during the operation.
+///  @param[in]		verts			The vertices. [(x, y, z) * @p nv]
+///  @param[in]		nv				The number of vertices.
+///  @param[in]		tris			The triangle indices. [(vertA, vertB, vertC) * @p nt]
+///  @param[in]		areas			The area id's of the triangles. [Limit: <= #RC_WALKABLE_AREA] [Size: @p nt]
+///  @param[in]		nt				The number of triangles.
+///  @param[in,out]	solid			An initialized heightfield.
+///  @param[in]		flagMergeThr	The distance where the walkable flag is favored over the non-walkable flag. 
+///  								[Limit: >= 0] [Units: vx]
+///  @returns True if the operation completed successfully.
+bool rcRasterizeHeightfieldEdges(rcContext* ctx, const float* verts, const int nv,
+								 const int* tris, const unsigned char* areas, const int nt,
+								 rcHeightfield& solid, const int flagMergeThr = 1);
+
 /// Marks non-walkable spans as walkable if their maximum is within @p walkableClimp of a walkable neighbor. 
 ///  @ingroup recast
 ///  @param[in,out]	ctx				The build context to use during the operation.
@@ -943,6 +1104,51 @@ void rcFilterWalkableLowHeightSpans(rcContext* ctx, int walkableHeight, rcHeight
 ///  @returns The number of spans in the heightfield.
 int rcGetHeightFieldSpanCount(rcContext* ctx, rcHeightfield& hf);
 
+/// Partitions a triangle mesh into an AABB tree of chunks with at most @p trisPerChunk triangles each.
+///  @ingroup recast
+///  @param[in,out]	ctx				The build context to use during the operation.
+///  @param[in]		verts			The vertices. [(x, y, z) * nv]
+///  @param[in]		tris			The triangle vertex indices. [(vertA, vertB, vertC) * @p ntris]
+///  @param[in]		ntris			The number of triangles.
+///  @param[in]		trisPerChunk	The maximum number of triangles in a leaf chunk. [Limit: > 0]
+///  @param[out]	cm				The chunky mesh to build. (Must be pre-allocated.)
+///  @returns True if the operation completed successfully.
+bool rcCreateChunkyTriMesh(rcContext* ctx, const float* verts, const int* tris, const int ntris,
+						   const int trisPerChunk, rcChunkyTriMesh& cm);
+
+/// Finds the leaf chunks whose bounds overlap a rectangle on the xz-plane.
+///  @ingroup recast
+///  @param[in]		cm		The chunky mesh.
+///  @param[in]		bmin	The minimum bounds of the rectangle. [(x, z)]
+///  @param[in]		bmax	The maximum bounds of the rectangle. [(x, z)]
+///  @param[out]	ids		The indices of the overlapping leaf nodes in rcChunkyTriMesh::nodes. [Size: @p maxIds]
+///  @param[in]		maxIds	The maximum number of ids to return.
+///  @returns The number of ids returned.
+int rcGetChunksOverlappingRect(const rcChunkyTriMesh& cm, const float* bmin, const float* bmax,
+							   int* ids, const int maxIds);
+
+/// Finds the leaf chunks whose bounds overlap an axis-aligned box.
+///  @ingroup recast
+///  @param[in]		cm		The chunky mesh.
+///  @param[in]		bmin	The minimum bounds of the box. [(x, y, z)]
+///  @param[in]		bmax	The maximum bounds of the box. [(x, y, z)]
+///  @param[out]	ids		The indices of the overlapping leaf nodes in rcChunkyTriMesh::nodes. [Size: @p maxIds]
+///  @param[in]		maxIds	The maximum number of ids to return.
+///  @returns The number of ids returned.
+int rcGetChunksOverlappingBox(const rcChunkyTriMesh& cm, const float* bmin, const float* bmax,
+							  int* ids, const int maxIds);
+
+/// Finds the leaf chunks whose bounds are crossed by the segment pq.
+///  @ingroup recast
+///  @param[in]		cm		The chunky mesh.
+///  @param[in]		p		The start of the segment. [(x, y, z)]
+///  @param[in]		q		The end of the segment. [(x, y, z)]
+///  @param[out]	ids		The indices of the overlapping leaf nodes in rcChunkyTriMesh::nodes. [Size: @p maxIds]
+///  @param[in]		maxIds	The maximum number of ids to return.
+///  @returns The number of ids returned.
+int rcGetChunksOverlappingSegment(const rcChunkyTriMesh& cm, const float* p, const float* q,
+								  int* ids, const int maxIds);
+
 /// @}
 /// @name Compact Heightfield Functions
 /// @see rcCompactHeightfield
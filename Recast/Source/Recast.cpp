@@ -129,6 +129,63 @@ void rcFreeHeightField(rcHeightfield* hf)
 	rcDelete(hf);
 }
 
+rcHeightfieldStore* rcAllocHeightfieldStore()
+{
+	return rcNew<rcHeightfieldStore>(RC_ALLOC_PERM);
+}
+rcHeightfieldStore::rcHeightfieldStore()
+	: width()
+	, height()
+	, chunkSize()
+	, nchunksx()
+	, nchunksy()
+	, bmin()
+	, bmax()
+	, cs()
+	, ch()
+	, chunks()
+{
+}
+
+rcHeightfieldStore::~rcHeightfieldStore()
+{
+	if (chunks)
+	{
+		for (int i = 0; i < nchunksx*nchunksy; ++i)
+			rcFreeHeightField(chunks[i]);
+	}
+	rcFree(chunks);
+}
+
+void rcFreeHeightfieldStore(rcHeightfieldStore* store)
+{
+	rcDelete(store);
+}
+
+rcChunkyTriMesh* rcAllocChunkyTriMesh()
+{
+	return rcNew<rcChunkyTriMesh>(RC_ALLOC_PERM);
+}
+rcChunkyTriMesh::rcChunkyTriMesh()
+	: nodes()
+	, nnodes()
+	, tris()
+	, ntris()
+	, maxTrisPerChunk()
+{
+}
+
+rcChunkyTriMesh::~rcChunkyTriMesh()
+{
+	rcFree(nodes);
+	rcFree(tris);
+}
+
+void rcFreeChunkyTriMesh(rcChunkyTriMesh* cm)
+{
+	rcDelete(cm);
+}
+
 rcCompactHeightfield* rcAllocCompactHeightfield()
 {
 	return rcNew<rcCompactHeightfield>(RC_ALLOC_PERM);
@@ -314,6 +371,36 @@ bool rcCreateHeightfield(rcContext* ctx, rcHeightfield& hf, int width, int heigh
 	return true;
 }
 
+/// @par
+///
+/// The chunks are only allocated once geometry is rasterized into them.
+///
+/// @see rcAllocHeightfieldStore, rcHeightfieldStore, rcRasterizeTrianglesToStore
+bool rcCreateHeightfieldStore(rcContext* ctx, rcHeightfieldStore& store, int width, int height, int chunkSize,
+							  const float* bmin, const float* bmax, float cs, float ch)
+{
+	rcIgnoreUnused(ctx);
+
+	if (chunkSize <= 0)
+		return false;
+
+	store.width = width;
+	store.height = height;
+	store.chunkSize = chunkSize;
+	store.nchunksx = (width + chunkSize-1) / chunkSize;
+	store.nchunksy = (height + chunkSize-1) / chunkSize;
+	rcVcopy(store.bmin, bmin);
+	rcVcopy(store.bmax, bmax);
+	store.cs = cs;
+	store.ch = ch;
+	const int nchunks = store.nchunksx*store.nchunksy;
+	store.chunks = (rcHeightfield**)rcAlloc(sizeof(rcHeightfield*)*nchunks, RC_ALLOC_PERM);
+	if (!store.chunks)
+		return false;
+	memset(store.chunks, 0, sizeof(rcHeightfield*)*nchunks);
+	return true;
+}
+
 static void calcTriNormal(const float* v0, const float* v1, const float* v2, float* norm)
 {
 	float e0[3], e1[3];
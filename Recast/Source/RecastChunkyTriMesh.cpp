@@ -0,0 +1,616 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "Recast.h"
+#include "RecastAlloc.h"
+#include "RecastAssert.h"
+
+namespace
+{
+/// Number of bins used when evaluating split candidates along an axis.
+const int CHUNKY_BINS = 16;
+
+/// Depth beyond which splits fall back to a balanced median split, so that
+/// degenerate triangle distributions cannot produce arbitrarily deep trees.
+const int CHUNKY_MAX_SAH_DEPTH = 48;
+
+/// Depth of the splits made before the subtrees are built through rcContext::parallelFor.
+/// The splits above it partition all the triangles and stay serial.
+const int CHUNKY_PARALLEL_DEPTH = 2;
+const int CHUNKY_MAX_SUBTREES = 1 << CHUNKY_PARALLEL_DEPTH;
+
+struct BoundsItem
+{
+	float bmin[3];
+	float bmax[3];
+	int i;
+};
+
+struct BuildContext
+{
+	BoundsItem* items;
+	const int* inTris;
+	int* outTris;
+	int curTri;
+	int trisPerChunk;
+	rcTempVector<rcChunkyTriMeshNode> nodes;
+};
+
+/// A subtree below the serial splits. Its triangles are the items [imin, imax), which are
+/// also the slots of its triangles in rcChunkyTriMesh::tris.
+struct SubtreeBuild
+{
+	int imin;
+	int imax;
+	int depth;
+	rcTempVector<rcChunkyTriMeshNode> nodes;
+};
+
+/// The serial splits, in heap order, and the subtrees below them in depth-first order.
+struct TopBuild
+{
+	BoundsItem* items;
+	const int* inTris;
+	int* outTris;
+	int trisPerChunk;
+	int splits[CHUNKY_MAX_SUBTREES-1];	///< The split index of each top node, or -1 if it is a subtree.
+	SubtreeBuild subtrees[CHUNKY_MAX_SUBTREES];
+	int nsubtrees;
+};
+
+inline float centroid(const BoundsItem& it, const int axis)
+{
+	return (it.bmin[axis] + it.bmax[axis]) * 0.5f;
+}
+
+inline float halfArea(const float* bmin, const float* bmax)
+{
+	const float dx = bmax[0] - bmin[0];
+	const float dy = bmax[1] - bmin[1];
+	const float dz = bmax[2] - bmin[2];
+	return dx*dy + dy*dz + dz*dx;
+}
+
+inline void emptyBounds(float* bmin, float* bmax)
+{
+	bmin[0] = bmin[1] = bmin[2] = FLT_MAX;
+	bmax[0] = bmax[1] = bmax[2] = -FLT_MAX;
+}
+
+inline void growBounds(float* bmin, float* bmax, const float* amin, const float* amax)
+{
+	rcVmin(bmin, amin);
+	rcVmax(bmax, amax);
+}
+} // namespace
+
+static void calcExtends(const BoundsItem* items, const int imin, const int imax, float* bmin, float* bmax)
+{
+	rcVcopy(bmin, items[imin].bmin);
+	rcVcopy(bmax, items[imin].bmax);
+	for (int i = imin+1; i < imax; ++i)
+		growBounds(bmin, bmax, items[i].bmin, items[i].bmax);
+}
+
+static void calcCentroidExtends(const BoundsItem* items, const int imin, const int imax, float* cmin, float* cmax)
+{
+	emptyBounds(cmin, cmax);
+	for (int i = imin; i < imax; ++i)
+	{
+		float c[3];
+		c[0] = centroid(items[i], 0);
+		c[1] = centroid(items[i], 1);
+		c[2] = centroid(items[i], 2);
+		growBounds(cmin, cmax, c, c);
+	}
+}
+
+static int medianSplit(BoundsItem* items, const int imin, const int imax, const float* cmin, const float* cmax)
+{
+	const int isplit = imin + (imax - imin) / 2;
+
+	int axis = 0;
+	if (cmax[1] - cmin[1] > cmax[axis] - cmin[axis]) axis = 1;
+	if (cmax[2] - cmin[2] > cmax[axis] - cmin[axis]) axis = 2;
+	if (cmax[axis] - cmin[axis] <= 0.0f)
+	{
+		// All centroids coincide, any order is as good as any other.
+		return isplit;
+	}
+
+	// Quickselect the median along the longest axis.
+	int lo = imin;
+	int hi = imax - 1;
+	while (lo < hi)
+	{
+		const float pivot = centroid(items[lo + (hi - lo) / 2], axis);
+		int i = lo;
+		int j = hi;
+		while (i <= j)
+		{
+			while (centroid(items[i], axis) < pivot) i++;
+			while (centroid(items[j], axis) > pivot) j--;
+			if (i <= j)
+			{
+				rcSwap(items[i], items[j]);
+				i++;
+				j--;
+			}
+		}
+		if (isplit <= j)
+			hi = j;
+		else if (isplit >= i)
+			lo = i;
+		else
+			break;
+	}
+	return isplit;
+}
+
+static int binnedSplit(BoundsItem* items, const int imin, const int imax, const float* cmin, const float* cmax)
+{
+	float bestCost = FLT_MAX;
+	int bestAxis = -1;
+	int bestBin = 0;
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		const float extent = cmax[axis] - cmin[axis];
+		if (extent <= 0.0f)
+			continue;
+		const float scale = CHUNKY_BINS / extent;
+
+		int counts[CHUNKY_BINS];
+		float bmins[CHUNKY_BINS][3];
+		float bmaxs[CHUNKY_BINS][3];
+		for (int b = 0; b < CHUNKY_BINS; ++b)
+		{
+			counts[b] = 0;
+			emptyBounds(bmins[b], bmaxs[b]);
+		}
+
+		for (int i = imin; i < imax; ++i)
+		{
+			const BoundsItem& it = items[i];
+			const int b = rcClamp((int)((centroid(it, axis) - cmin[axis]) * scale), 0, CHUNKY_BINS-1);
+			counts[b]++;
+			growBounds(bmins[b], bmaxs[b], it.bmin, it.bmax);
+		}
+
+		// Sweep from the right to get the cost of everything above each bin boundary.
+		float rightArea[CHUNKY_BINS];
+		int rightCount[CHUNKY_BINS];
+		float rmin[3], rmax[3];
+		emptyBounds(rmin, rmax);
+		int rn = 0;
+		for (int b = CHUNKY_BINS-1; b > 0; --b)
+		{
+			rn += counts[b];
+			growBounds(rmin, rmax, bmins[b], bmaxs[b]);
+			rightCount[b] = rn;
+			rightArea[b] = rn > 0 ? halfArea(rmin, rmax) : 0.0f;
+		}
+
+		// Sweep from the left and evaluate the surface area heuristic at each boundary.
+		float lmin[3], lmax[3];
+		emptyBounds(lmin, lmax);
+		int ln = 0;
+		for (int b = 1; b < CHUNKY_BINS; ++b)
+		{
+			ln += counts[b-1];
+			growBounds(lmin, lmax, bmins[b-1], bmaxs[b-1]);
+			if (ln == 0 || rightCount[b] == 0)
+				continue;
+			const float cost = halfArea(lmin, lmax) * ln + rightArea[b] * rightCount[b];
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				bestAxis = axis;
+				bestBin = b;
+			}
+		}
+	}
+
+	if (bestAxis == -1)
+		return medianSplit(items, imin, imax, cmin, cmax);
+
+	// Split at the bin boundary, using the same bin mapping as above so that
+	// both sides are guaranteed to be non-empty.
+	const float scale = CHUNKY_BINS / (cmax[bestAxis] - cmin[bestAxis]);
+	int i = imin;
+	int j = imax - 1;
+	while (i <= j)
+	{
+		const int b = rcClamp((int)((centroid(items[i], bestAxis) - cmin[bestAxis]) * scale), 0, CHUNKY_BINS-1);
+		if (b < bestBin)
+		{
+			i++;
+		}
+		else
+		{
+			rcSwap(items[i], items[j]);
+			j--;
+		}
+	}
+	rcAssert(i > imin && i < imax);
+	return i;
+}
+
+static void subdivide(BuildContext& bc, const int imin, const int imax, const int depth)
+{
+	const int inum = imax - imin;
+	const int icur = (int)bc.nodes.size();
+
+	rcChunkyTriMeshNode node;
+	calcExtends(bc.items, imin, imax, node.bmin, node.bmax);
+	node.i = 0;
+	node.n = 0;
+
+	if (inum <= bc.trisPerChunk)
+	{
+		// Leaf
+		node.i = bc.curTri;
+		node.n = inum;
+		bc.nodes.push_back(node);
+
+		// Copy triangles.
+		for (int i = imin; i < imax; ++i)
+		{
+			const int* src = &bc.inTris[bc.items[i].i*3];
+			int* dst = &bc.outTris[bc.curTri*3];
+			bc.curTri++;
+			dst[0] = src[0];
+			dst[1] = src[1];
+			dst[2] = src[2];
+		}
+		return;
+	}
+
+	bc.nodes.push_back(node);
+
+	// Split
+	float cmin[3], cmax[3];
+	calcCentroidExtends(bc.items, imin, imax, cmin, cmax);
+
+	const int isplit = depth < CHUNKY_MAX_SAH_DEPTH
+		? binnedSplit(bc.items, imin, imax, cmin, cmax)
+		: medianSplit(bc.items, imin, imax, cmin, cmax);
+
+	// Left
+	subdivide(bc, imin, isplit, depth+1);
+	// Right
+	subdivide(bc, isplit, imax, depth+1);
+
+	// Negative index means escape.
+	const int iescape = (int)bc.nodes.size() - icur;
+	bc.nodes[icur].i = -iescape;
+}
+
+// Makes the splits above CHUNKY_PARALLEL_DEPTH and collects the subtrees below them.
+static void splitTop(TopBuild& tb, const int imin, const int imax, const int depth, const int inode)
+{
+	if (depth == CHUNKY_PARALLEL_DEPTH || imax - imin <= tb.trisPerChunk)
+	{
+		if (inode < CHUNKY_MAX_SUBTREES-1)
+			tb.splits[inode] = -1;
+		SubtreeBuild& sub = tb.subtrees[tb.nsubtrees++];
+		sub.imin = imin;
+		sub.imax = imax;
+		sub.depth = depth;
+		return;
+	}
+
+	float cmin[3], cmax[3];
+	calcCentroidExtends(tb.items, imin, imax, cmin, cmax);
+	const int isplit = binnedSplit(tb.items, imin, imax, cmin, cmax);
+	tb.splits[inode] = isplit;
+
+	splitTop(tb, imin, isplit, depth+1, inode*2+1);
+	splitTop(tb, isplit, imax, depth+1, inode*2+2);
+}
+
+static void buildSubtrees(void* userData, const int s0, const int s1)
+{
+	TopBuild& tb = *(TopBuild*)userData;
+	for (int s = s0; s < s1; ++s)
+	{
+		SubtreeBuild& sub = tb.subtrees[s];
+		BuildContext bc;
+		bc.items = tb.items;
+		bc.inTris = tb.inTris;
+		bc.outTris = tb.outTris;
+		// Leaves store their triangles in item order.
+		bc.curTri = sub.imin;
+		bc.trisPerChunk = tb.trisPerChunk;
+		bc.nodes.reserve(((sub.imax - sub.imin + tb.trisPerChunk-1) / tb.trisPerChunk) * 2);
+		subdivide(bc, sub.imin, sub.imax, sub.depth);
+		bc.nodes.swap(sub.nodes);
+	}
+}
+
+// Appends the top nodes and the built subtrees to the tree in depth-first order.
+static void gatherTop(TopBuild& tb, rcTempVector<rcChunkyTriMeshNode>& nodes,
+					  const int imin, const int imax, const int inode, int& isubtree)
+{
+	if (inode >= CHUNKY_MAX_SUBTREES-1 || tb.splits[inode] == -1)
+	{
+		const SubtreeBuild& sub = tb.subtrees[isubtree++];
+		for (int i = 0; i < (int)sub.nodes.size(); ++i)
+			nodes.push_back(sub.nodes[i]);
+		return;
+	}
+
+	const int icur = (int)nodes.size();
+	rcChunkyTriMeshNode node;
+	calcExtends(tb.items, imin, imax, node.bmin, node.bmax);
+	node.i = 0;
+	node.n = 0;
+	nodes.push_back(node);
+
+	const int isplit = tb.splits[inode];
+	gatherTop(tb, nodes, imin, isplit, inode*2+1, isubtree);
+	gatherTop(tb, nodes, isplit, imax, inode*2+2, isubtree);
+
+	// Negative index means escape.
+	const int iescape = (int)nodes.size() - icur;
+	nodes[icur].i = -iescape;
+}
+
+/// @par
+///
+/// Leaves are split until they hold at most @p trisPerChunk triangles. Split planes are
+/// chosen with a binned surface area heuristic over the triangle centroids, which keeps
+/// the build O(n log n) and avoids sorting.
+///
+/// The nodes are stored depth-first with the triangles of each leaf stored contiguously
+/// in rcChunkyTriMesh::tris, so the queries walk the tree without a stack.
+///
+/// The first splits are made serially, and the subtrees below them are built through
+/// rcContext::parallelFor. The tree does not depend on how the work is scheduled.
+///
+/// @see rcAllocChunkyTriMesh, rcChunkyTriMesh, rcGetChunksOverlappingRect
+bool rcCreateChunkyTriMesh(rcContext* ctx, const float* verts, const int* tris, const int ntris,
+						   const int trisPerChunk, rcChunkyTriMesh& cm)
+{
+	rcAssert(ctx);
+
+	if (trisPerChunk <= 0)
+	{
+		ctx->log(RC_LOG_ERROR, "rcCreateChunkyTriMesh: Invalid number of triangles per chunk %d.", trisPerChunk);
+		return false;
+	}
+
+	rcFree(cm.nodes);
+	rcFree(cm.tris);
+	cm.nodes = 0;
+	cm.nnodes = 0;
+	cm.tris = 0;
+	cm.ntris = 0;
+	cm.maxTrisPerChunk = 0;
+
+	if (ntris <= 0)
+		return true;
+
+	cm.tris = (int*)rcAlloc(sizeof(int)*ntris*3, RC_ALLOC_PERM);
+	if (!cm.tris)
+	{
+		ctx->log(RC_LOG_ERROR, "rcCreateChunkyTriMesh: Out of memory 'tris' (%d).", ntris*3);
+		return false;
+	}
+	cm.ntris = ntris;
+
+	rcScopedDelete<BoundsItem> items((BoundsItem*)rcAlloc(sizeof(BoundsItem)*ntris, RC_ALLOC_TEMP));
+	if (!items)
+	{
+		ctx->log(RC_LOG_ERROR, "rcCreateChunkyTriMesh: Out of memory 'items' (%d).", ntris);
+		return false;
+	}
+
+	for (int i = 0; i < ntris; i++)
+	{
+		const int* t = &tris[i*3];
+		BoundsItem& it = items[i];
+		it.i = i;
+		// Calc triangle bounds.
+		rcVcopy(it.bmin, &verts[t[0]*3]);
+		rcVcopy(it.bmax, &verts[t[0]*3]);
+		for (int j = 1; j < 3; ++j)
+		{
+			rcVmin(it.bmin, &verts[t[j]*3]);
+			rcVmax(it.bmax, &verts[t[j]*3]);
+		}
+	}
+
+	// Build tree
+	TopBuild tb;
+	tb.items = items;
+	tb.inTris = tris;
+	tb.outTris = cm.tris;
+	tb.trisPerChunk = trisPerChunk;
+	tb.nsubtrees = 0;
+	splitTop(tb, 0, ntris, 0, 0);
+	ctx->parallelFor(tb.nsubtrees, buildSubtrees, &tb);
+
+	rcTempVector<rcChunkyTriMeshNode> nodes;
+	nodes.reserve(((ntris + trisPerChunk-1) / trisPerChunk) * 2);
+	int isubtree = 0;
+	gatherTop(tb, nodes, 0, ntris, 0, isubtree);
+	rcAssert(isubtree == tb.nsubtrees);
+
+	cm.nnodes = (int)nodes.size();
+	cm.nodes = (rcChunkyTriMeshNode*)rcAlloc(sizeof(rcChunkyTriMeshNode)*cm.nnodes, RC_ALLOC_PERM);
+	if (!cm.nodes)
+	{
+		ctx->log(RC_LOG_ERROR, "rcCreateChunkyTriMesh: Out of memory 'nodes' (%d).", cm.nnodes);
+		cm.nnodes = 0;
+		return false;
+	}
+	memcpy(cm.nodes, &nodes[0], sizeof(rcChunkyTriMeshNode)*cm.nnodes);
+
+	// Calc max tris per node.
+	for (int i = 0; i < cm.nnodes; ++i)
+	{
+		const rcChunkyTriMeshNode& node = cm.nodes[i];
+		const bool isLeaf = node.i >= 0;
+		if (!isLeaf) continue;
+		if (node.n > cm.maxTrisPerChunk)
+			cm.maxTrisPerChunk = node.n;
+	}
+
+	return true;
+}
+
+inline bool checkOverlapRect(const float amin[2], const float amax[2], const float* bmin, const float* bmax)
+{
+	bool overlap = true;
+	overlap = (amin[0] > bmax[0] || amax[0] < bmin[0]) ? false : overlap;
+	overlap = (amin[1] > bmax[2] || amax[1] < bmin[2]) ? false : overlap;
+	return overlap;
+}
+
+inline bool checkOverlapBox(const float* amin, const float* amax, const float* bmin, const float* bmax)
+{
+	bool overlap = true;
+	overlap = (amin[0] > bmax[0] || amax[0] < bmin[0]) ? false : overlap;
+	overlap = (amin[1] > bmax[1] || amax[1] < bmin[1]) ? false : overlap;
+	overlap = (amin[2] > bmax[2] || amax[2] < bmin[2]) ? false : overlap;
+	return overlap;
+}
+
+static bool checkOverlapSegment(const float* p, const float* q, const float* bmin, const float* bmax)
+{
+	static const float EPSILON = 1e-6f;
+
+	float tmin = 0;
+	float tmax = 1;
+	float d[3];
+	rcVsub(d, q, p);
+
+	for (int i = 0; i < 3; i++)
+	{
+		if (fabsf(d[i]) < EPSILON)
+		{
+			// Ray is parallel to slab. No hit if origin not within slab
+			if (p[i] < bmin[i] || p[i] > bmax[i])
+				return false;
+		}
+		else
+		{
+			// Compute intersection t value of ray with near and far plane of slab
+			const float ood = 1.0f / d[i];
+			float t1 = (bmin[i] - p[i]) * ood;
+			float t2 = (bmax[i] - p[i]) * ood;
+			if (t1 > t2) { float tmp = t1; t1 = t2; t2 = tmp; }
+			if (t1 > tmin) tmin = t1;
+			if (t2 < tmax) tmax = t2;
+			if (tmin > tmax) return false;
+		}
+	}
+	return true;
+}
+
+int rcGetChunksOverlappingRect(const rcChunkyTriMesh& cm, const float* bmin, const float* bmax,
+							   int* ids, const int maxIds)
+{
+	// Traverse tree
+	int i = 0;
+	int n = 0;
+	while (i < cm.nnodes)
+	{
+		const rcChunkyTriMeshNode* node = &cm.nodes[i];
+		const bool overlap = checkOverlapRect(bmin, bmax, node->bmin, node->bmax);
+		const bool isLeafNode = node->i >= 0;
+
+		if (isLeafNode && overlap)
+		{
+			if (n < maxIds)
+			{
+				ids[n] = i;
+				n++;
+			}
+		}
+
+		if (overlap || isLeafNode)
+			i++;
+		else
+			i += -node->i;
+	}
+
+	return n;
+}
+
+int rcGetChunksOverlappingBox(const rcChunkyTriMesh& cm, const float* bmin, const float* bmax,
+							  int* ids, const int maxIds)
+{
+	int i = 0;
+	int n = 0;
+	while (i < cm.nnodes)
+	{
+		const rcChunkyTriMeshNode* node = &cm.nodes[i];
+		const bool overlap = checkOverlapBox(bmin, bmax, node->bmin, node->bmax);
+		const bool isLeafNode = node->i >= 0;
+
+		if (isLeafNode && overlap)
+		{
+			if (n < maxIds)
+			{
+				ids[n] = i;
+				n++;
+			}
+		}
+
+		if (overlap || isLeafNode)
+			i++;
+		else
+			i += -node->i;
+	}
+
+	return n;
+}
+
+int rcGetChunksOverlappingSegment(const rcChunkyTriMesh& cm, const float* p, const float* q,
+								  int* ids, const int maxIds)
+{
+	int i = 0;
+	int n = 0;
+	while (i < cm.nnodes)
+	{
+		const rcChunkyTriMeshNode* node = &cm.nodes[i];
+		const bool overlap = checkOverlapSegment(p, q, node->bmin, node->bmax);
+		const bool isLeafNode = node->i >= 0;
+
+		if (isLeafNode && overlap)
+		{
+			if (n < maxIds)
+			{
+				ids[n] = i;
+				n++;
+			}
+		}
+
+		if (overlap || isLeafNode)
+			i++;
+		else
+			i += -node->i;
+	}
+
+	return n;
+}
@@ -773,6 +773,8 @@ struct rcContourRegion
 	rcContour* outline;
 	rcContourHole* holes;
 	int nholes;
+	int nfailed;		// The number of holes that could not be merged.
+	bool outOfMemory;
 };
 
 struct rcPotentialDiagonal
@@ -834,7 +836,7 @@ static int compareDiagDist(const void* va, const void* vb)
 }
 
 
-static void mergeRegionHoles(rcContext* ctx, rcContourRegion& region)
+static void mergeRegionHoles(rcContourRegion& region)
 {
 	// Sort holes from left to right.
 	// 找出所有 hole 轮廓里，x 坐标最小的顶点
@@ -851,7 +853,7 @@ static void mergeRegionHoles(rcContext* ctx, rcContourRegion& region)
 	rcScopedDelete<rcPotentialDiagonal> diags((rcPotentialDiagonal*)rcAlloc(sizeof(rcPotentialDiagonal)*maxVerts, RC_ALLOC_TEMP));
 	if (!diags)
 	{
-		ctx->log(RC_LOG_WARNING, "mergeRegionHoles: Failed to allocated diags %d.", maxVerts);
+		region.outOfMemory = true;
 		return;
 	}
 	
@@ -911,19 +913,257 @@ static void mergeRegionHoles(rcContext* ctx, rcContourRegion& region)
 			bestVertex = (bestVertex + 1) % hole->nverts;
 		}
 		
-		if (index == -1)
+		if (index == -1 || !mergeContours(*region.outline, *hole, index, bestVertex))
 		{
-			ctx->log(RC_LOG_WARNING, "mergeHoles: Failed to find merge points for %p and %p.", region.outline, hole);
+			// Failed to find merge points, or to merge the contours.
+			region.nfailed++;
 			continue;
 		}
-		if (!mergeContours(*region.outline, *hole, index, bestVertex))
+	}
+}
+
+
+struct rcTracedContour
+{
+	rcContour cont;
+	int start;	// The span the contour was traced from, contours are ordered by it.
+};
+
+struct rcRegionContours
+{
+	rcTracedContour* conts;
+	int nconts;
+	int firstSeed;	// The first of the region's boundary spans in rcContourBuildData::seeds.
+	int nseeds;
+	bool failed;
+};
+
+struct rcContourBuildData
+{
+	rcCompactHeightfield* chf;
+	unsigned char* flags;
+	const int* seeds;			// Boundary spans grouped by region, as (span, cell) pairs.
+	rcRegionContours* regions;
+	float maxError;
+	int maxEdgeLen;
+	int buildFlags;
+};
+
+struct rcHoleMergeData
+{
+	rcContourRegion* regions;
+	const int* ids;
+};
+
+// Marks the non-connected edges of the spans in rows [y0, y1).
+static void markBoundaries(void* userData, const int y0, const int y1)
+{
+	rcContourBuildData& data = *(rcContourBuildData*)userData;
+	const rcCompactHeightfield& chf = *data.chf;
+	unsigned char* flags = data.flags;
+	const int w = chf.width;
+
+	for (int y = y0; y < y1; ++y)
+	{
+		for (int x = 0; x < w; ++x)
 		{
-			ctx->log(RC_LOG_WARNING, "mergeHoles: Failed to merge contours %p and %p.", region.outline, hole);
-			continue;
+			const rcCompactCell& c = chf.cells[x+y*w];
+			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
+			{
+				unsigned char res = 0;
+				const rcCompactSpan& s = chf.spans[i];
+				if (!chf.spans[i].reg || (chf.spans[i].reg & RC_BORDER_REG))
+				{
+					// 如果不在任何区域内，或者是边界 region，则标记为 0，表示后面可以略过处理
+					flags[i] = 0;
+					continue;
+				}
+
+				for (int dir = 0; dir < 4; ++dir)
+				{
+					unsigned short r = 0;
+					if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
+					{
+						const int ax = x + rcGetDirOffsetX(dir);
+						const int ay = y + rcGetDirOffsetY(dir);
+						const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
+						r = chf.spans[ai].reg;
+					}
+
+					// 该方向上，当前 span 与邻接 span 的 region 相同，代表是连通的
+					// 标记该方向为连通
+					if (r == chf.spans[i].reg)
+						res |= (1 << dir);
+				}
+
+				// 前面是连通标记，这里取反，得到不连通标记
+				flags[i] = res ^ 0xf; // Inverse, mark non connected edges.
+			}
+		}
+	}
+}
+
+static void freeTracedContours(rcTracedContour* conts, const int nconts)
+{
+	for (int i = 0; i < nconts; ++i)
+	{
+		rcFree(conts[i].cont.verts);
+		rcFree(conts[i].cont.rverts);
+	}
+}
+
+static void freeRegionContours(rcRegionContours* regions, const int nregions)
+{
+	for (int i = 0; i < nregions; ++i)
+	{
+		freeTracedContours(regions[i].conts, regions[i].nconts);
+		rcFree(regions[i].conts);
+		regions[i].conts = 0;
+		regions[i].nconts = 0;
+	}
+}
+
+// Traces the raw contours of the regions [r0, r1).
+static void traceRegionContours(void* userData, const int r0, const int r1)
+{
+	rcContourBuildData& data = *(rcContourBuildData*)userData;
+	rcCompactHeightfield& chf = *data.chf;
+	unsigned char* flags = data.flags;
+
+	rcIntArray verts(256);
+	rcTempVector<rcTracedContour> traced;
+
+	for (int r = r0; r < r1; ++r)
+	{
+		rcRegionContours& region = data.regions[r];
+		traced.clear();
+
+		for (int k = 0; k < region.nseeds; ++k)
+		{
+			const int* seed = &data.seeds[(region.firstSeed + k)*2];
+			const int i = seed[0];
+			// The span may have been visited while tracing an earlier contour.
+			if (flags[i] == 0)
+				continue;
+
+			verts.clear();
+			walkContour(seed[1] % chf.width, seed[1] / chf.width, i, chf, flags, verts);
+
+			rcTracedContour tc;
+			memset(&tc, 0, sizeof(tc));
+			tc.start = i;
+			tc.cont.reg = (unsigned short)r;
+			tc.cont.area = chf.areas[i];
+			tc.cont.nrverts = verts.size()/4;
+			tc.cont.rverts = (int*)rcAlloc(sizeof(int)*rcMax(tc.cont.nrverts, 1)*4, RC_ALLOC_PERM);
+			if (!tc.cont.rverts)
+			{
+				region.failed = true;
+				break;
+			}
+			if (tc.cont.nrverts > 0)
+				memcpy(tc.cont.rverts, &verts[0], sizeof(int)*tc.cont.nrverts*4);
+			traced.push_back(tc);
+		}
+
+		const int n = (int)traced.size();
+		if (!region.failed && n > 0)
+		{
+			region.conts = (rcTracedContour*)rcAlloc(sizeof(rcTracedContour)*n, RC_ALLOC_TEMP);
+			if (region.conts)
+			{
+				memcpy(region.conts, &traced[0], sizeof(rcTracedContour)*n);
+				region.nconts = n;
+				continue;
+			}
+			region.failed = true;
 		}
+		if (n > 0)
+			freeTracedContours(&traced[0], n);
 	}
 }
 
+// Simplifies the contours of the regions [r0, r1).
+static void simplifyRegionContours(void* userData, const int r0, const int r1)
+{
+	rcContourBuildData& data = *(rcContourBuildData*)userData;
+	const int borderSize = data.chf->borderSize;
+
+	rcIntArray verts(256);
+	rcIntArray simplified(64);
+
+	for (int r = r0; r < r1; ++r)
+	{
+		rcRegionContours& region = data.regions[r];
+		for (int k = 0; k < region.nconts && !region.failed; ++k)
+		{
+			rcContour* cont = &region.conts[k].cont;
+
+			verts.resize(cont->nrverts*4);
+			if (cont->nrverts > 0)
+				memcpy(&verts[0], cont->rverts, sizeof(int)*cont->nrverts*4);
+			simplified.clear();
+
+			// 主要是：
+			// 1.在 maxError 范围内对折线做平滑处理
+			// 2.对大于 maxEdgeLen 的线段做拆分处理
+			simplifyContour(verts, simplified, data.maxError, data.maxEdgeLen, data.buildFlags);
+
+			// 将相邻的 x z 坐标相等的点进行合并
+			removeDegenerateSegments(simplified);
+
+			// Contours with less than 3 vertices are dropped when the contours are gathered.
+			if (simplified.size()/4 < 3)
+				continue;
+
+			// 将计算出的轮廓线上的顶点复制到目标结构中
+			cont->nverts = simplified.size()/4;
+			cont->verts = (int*)rcAlloc(sizeof(int)*cont->nverts*4, RC_ALLOC_PERM);
+			if (!cont->verts)
+			{
+				cont->nverts = 0;
+				region.failed = true;
+				break;
+			}
+			memcpy(cont->verts, &simplified[0], sizeof(int)*cont->nverts*4);
+			if (borderSize > 0)
+			{
+				// If the heightfield was build with bordersize, remove the offset.
+				for (int j = 0; j < cont->nverts; ++j)
+				{
+					int* v = &cont->verts[j*4];
+					v[0] -= borderSize;
+					v[2] -= borderSize;
+				}
+				for (int j = 0; j < cont->nrverts; ++j)
+				{
+					int* v = &cont->rverts[j*4];
+					v[0] -= borderSize;
+					v[2] -= borderSize;
+				}
+			}
+		}
+	}
+}
+
+static int compareTracedContours(const void* va, const void* vb)
+{
+	const rcTracedContour* a = *(const rcTracedContour* const*)va;
+	const rcTracedContour* b = *(const rcTracedContour* const*)vb;
+	if (a->start < b->start)
+		return -1;
+	if (a->start > b->start)
+		return 1;
+	return 0;
+}
+
+// Merges the holes of the regions listed in [i0, i1).
+static void mergeHolesOfRegions(void* userData, const int i0, const int i1)
+{
+	rcHoleMergeData& data = *(rcHoleMergeData*)userData;
+	for (int i = i0; i < i1; ++i)
+		mergeRegionHoles(data.regions[data.ids[i]]);
+}
 
 /// @par
 ///
@@ -935,6 +1175,10 @@ static void mergeRegionHoles(rcContext* ctx, rcContourRegion& region)
 ///
 /// Setting @p maxEdgeLength to zero will disabled the edge length feature.
 ///
+/// The edge flags, the regions' contours and the hole merging are processed through
+/// rcContext::parallelFor. The contours are stored in the order a serial scan over the
+/// spans finds them, so the result does not depend on how the work is scheduled.
+///
 /// See the #rcConfig documentation for more information on the configuration parameters.
 ///
 /// @see rcAllocContourSet, rcCompactHeightfield, rcContourSet, rcConfig
@@ -970,11 +1214,7 @@ bool rcBuildContours(rcContext* ctx, rcCompactHeightfield& chf,
 	cset.borderSize = chf.borderSize;
 	cset.maxError = maxError;
 
-	int maxContours = rcMax((int)chf.maxRegions, 8);
-	cset.conts = (rcContour*)rcAlloc(sizeof(rcContour)*maxContours, RC_ALLOC_PERM);
-	if (!cset.conts)
-		return false;
-	cset.nconts = 0;
+	const int nregions = chf.maxRegions+1;
 
 	rcScopedDelete<unsigned char> flags((unsigned char*)rcAlloc(sizeof(unsigned char)*chf.spanCount, RC_ALLOC_TEMP));
 	if (!flags)
@@ -982,57 +1222,50 @@ bool rcBuildContours(rcContext* ctx, rcCompactHeightfield& chf,
 		ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'flags' (%d).", chf.spanCount);
 		return false;
 	}
+	rcScopedDelete<rcRegionContours> regionConts((rcRegionContours*)rcAlloc(sizeof(rcRegionContours)*nregions, RC_ALLOC_TEMP));
+	if (!regionConts)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'regionConts' (%d).", nregions);
+		return false;
+	}
+	memset(regionConts, 0, sizeof(rcRegionContours)*nregions);
+
+	rcContourBuildData data;
+	data.chf = &chf;
+	data.flags = flags;
+	data.seeds = 0;
+	data.regions = regionConts;
+	data.maxError = maxError;
+	data.maxEdgeLen = maxEdgeLen;
+	data.buildFlags = buildFlags;
 	
 	ctx->startTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
 	
 	// Mark boundaries.
 	// 这里是将所有 span 四方向里不连通的边标记出来，保存到 flags 数组中
 	// 供后续 walkContour 使用
-	for (int y = 0; y < h; ++y)
-	{
-		for (int x = 0; x < w; ++x)
-		{
-			const rcCompactCell& c = chf.cells[x+y*w];
-			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
-			{
-				unsigned char res = 0;
-				const rcCompactSpan& s = chf.spans[i];
-				if (!chf.spans[i].reg || (chf.spans[i].reg & RC_BORDER_REG))
-				{
-					// 如果不在任何区域内，或者是边界 region，则标记为 0，表示后面可以略过处理
-					flags[i] = 0;
-					continue;
-				}
-
-				for (int dir = 0; dir < 4; ++dir)
-				{
-					unsigned short r = 0;
-					if (rcGetCon(s, dir) != RC_NOT_CONNECTED)
-					{
-						const int ax = x + rcGetDirOffsetX(dir);
-						const int ay = y + rcGetDirOffsetY(dir);
-						const int ai = (int)chf.cells[ax+ay*w].index + rcGetCon(s, dir);
-						r = chf.spans[ai].reg;
-					}
+	ctx->parallelFor(h, markBoundaries, &data);
 
-					// 该方向上，当前 span 与邻接 span 的 region 相同，代表是连通的
-					// 标记该方向为连通
-					if (r == chf.spans[i].reg)
-						res |= (1 << dir);
-				}
-
-				// 前面是连通标记，这里取反，得到不连通标记
-				flags[i] = res ^ 0xf; // Inverse, mark non connected edges.
-			}
-		}
+	// Group the spans on region boundaries by region, in scan order.
+	// The contours of different regions do not share any spans, so each region can be traced on its own.
+	for (int i = 0; i < chf.spanCount; ++i)
+	{
+		if (flags[i] != 0 && flags[i] != 0xf)
+			regionConts[chf.spans[i].reg].nseeds++;
+	}
+	int nseeds = 0;
+	for (int i = 0; i < nregions; ++i)
+	{
+		regionConts[i].firstSeed = nseeds;
+		nseeds += regionConts[i].nseeds;
+		regionConts[i].nseeds = 0;
+	}
+	rcScopedDelete<int> seeds((int*)rcAlloc(sizeof(int)*rcMax(nseeds, 1)*2, RC_ALLOC_TEMP));
+	if (!seeds)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'seeds' (%d).", nseeds);
+		return false;
 	}
-	
-	ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
-	
-	rcIntArray verts(256); // 用于存放轮廓上顶点的临时数组
-	rcIntArray simplified(64); // 用于存放平滑处理后的轮廓顶点的临时数组
-	
-	// 遍历所有的 span，将 flags[i] != 0 的 span 所属的区域进行描边处理
 	for (int y = 0; y < h; ++y)
 	{
 		for (int x = 0; x < w; ++x)
@@ -1040,117 +1273,77 @@ bool rcBuildContours(rcContext* ctx, rcCompactHeightfield& chf,
 			const rcCompactCell& c = chf.cells[x+y*w];
 			for (int i = (int)c.index, ni = (int)(c.index+c.count); i < ni; ++i)
 			{
-				// flags[i] == 0：无reg、边界reg、处于 region 内部位置（因为四方向邻接的都是相同 reg 的 span），或者几个方向均已处理完毕，这四种情况可以直接略过
+				// flags[i] == 0：无reg、边界reg、处于 region 内部位置（因为四方向邻接的都是相同 reg 的 span），这几种情况可以直接略过
 				// flags[i] == 0xf：四方向均不连通或均为不同的 region，也可以直接略过
 				// 因为这些情况里，这个 span 肯定不是轮廓线上的位置，对于构建轮廓线没有帮助
 				if (flags[i] == 0 || flags[i] == 0xf)
-				{
-					flags[i] = 0;
-					continue;
-				}
-
-				const unsigned short reg = chf.spans[i].reg;
-				if (!reg || (reg & RC_BORDER_REG)) // 这个判断是多余的
 					continue;
-				const unsigned char area = chf.areas[i];
-				// 到这里， i 代表的一定是在 region 轮廓线上的 span
-
-				verts.clear();
-				simplified.clear();
-				
-				ctx->startTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+				rcRegionContours& rc = regionConts[chf.spans[i].reg];
+				int* seed = &seeds[(rc.firstSeed + rc.nseeds++)*2];
+				seed[0] = i;
+				seed[1] = x+y*w;
+			}
+		}
+	}
+	data.seeds = seeds;
 
-				// walkContour: 绕着 region 边缘遍历一圈，把边缘的格子点坐标都保存到 verts 数组中
-				// 数据格式为：x h y r
-				// 分别对应格子 x 轴坐标、span 的边缘高度、格子的 y 坐标、region 标记（按位分段保存了 reg id、是否边缘节点、是否区域边缘）
-				walkContour(x, y, i, chf, flags, verts);
+	// walkContour: 绕着 region 边缘遍历一圈，把边缘的格子点坐标都保存到 rverts 数组中
+	ctx->parallelFor(nregions, traceRegionContours, &data);
 
-				ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
+	ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_TRACE);
 
-				ctx->startTimer(RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
-				// simplifyContour: 将区域轮廓进行简化处理
-				// 主要是：
-				// 1.在 maxError 范围内对折线做平滑处理
-				// 2.对大于 maxEdgeLen 的线段做拆分处理
-				simplifyContour(verts, simplified, maxError, maxEdgeLen, buildFlags);
+	ctx->startTimer(RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
 
-				// 将相邻的 x z 坐标相等的点进行合并
-				removeDegenerateSegments(simplified);
+	// simplifyContour: 将区域轮廓进行简化处理
+	ctx->parallelFor(nregions, simplifyRegionContours, &data);
 
-				ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
+	ctx->stopTimer(RC_TIMER_BUILD_CONTOURS_SIMPLIFY);
 
-				// Store region->contour remap info.
-				// Create contour.
-				if (simplified.size()/4 >= 3)
-				{
-					if (cset.nconts >= maxContours)
-					{
-						// Allocate more contours.
-						// This happens when a region has holes.
-						const int oldMax = maxContours;
-						maxContours *= 2;
-						rcContour* newConts = (rcContour*)rcAlloc(sizeof(rcContour)*maxContours, RC_ALLOC_PERM);
-						for (int j = 0; j < cset.nconts; ++j)
-						{
-							newConts[j] = cset.conts[j];
-							// Reset source pointers to prevent data deletion.
-							cset.conts[j].verts = 0;
-							cset.conts[j].rverts = 0;
-						}
-						rcFree(cset.conts);
-						cset.conts = newConts;
-						
-						ctx->log(RC_LOG_WARNING, "rcBuildContours: Expanding max contours from %d to %d.", oldMax, maxContours);
-					}
-					
-					rcContour* cont = &cset.conts[cset.nconts++];
+	// Gather the contours in the order a serial scan of the spans would have found them.
+	int nconts = 0;
+	for (int i = 0; i < nregions; ++i)
+	{
+		if (regionConts[i].failed)
+		{
+			ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory while building the contours of region %d.", i);
+			freeRegionContours(regionConts, nregions);
+			return false;
+		}
+		for (int j = 0; j < regionConts[i].nconts; ++j)
+		{
+			if (regionConts[i].conts[j].cont.nverts > 0)
+				nconts++;
+		}
+	}
 
-					// 将计算出的轮廓线上的顶点复制到目标结构中
-					cont->nverts = simplified.size()/4;
-					cont->verts = (int*)rcAlloc(sizeof(int)*cont->nverts*4, RC_ALLOC_PERM);
-					if (!cont->verts)
-					{
-						ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'verts' (%d).", cont->nverts);
-						return false;
-					}
-					memcpy(cont->verts, &simplified[0], sizeof(int)*cont->nverts*4);
-					if (borderSize > 0)
-					{
-						// If the heightfield was build with bordersize, remove the offset.
-						for (int j = 0; j < cont->nverts; ++j)
-						{
-							int* v = &cont->verts[j*4];
-							v[0] -= borderSize;
-							v[2] -= borderSize;
-						}
-					}
-					
-					cont->nrverts = verts.size()/4;
-					cont->rverts = (int*)rcAlloc(sizeof(int)*cont->nrverts*4, RC_ALLOC_PERM);
-					if (!cont->rverts)
-					{
-						ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'rverts' (%d).", cont->nrverts);
-						return false;
-					}
-					memcpy(cont->rverts, &verts[0], sizeof(int)*cont->nrverts*4);
-					if (borderSize > 0)
-					{
-						// If the heightfield was build with bordersize, remove the offset.
-						// ? 为什么这里要减去偏移？因为 cset 的 bmin bmax 已经添加了 borderSize 偏移吗
-						for (int j = 0; j < cont->nrverts; ++j)
-						{
-							int* v = &cont->rverts[j*4];
-							v[0] -= borderSize;
-							v[2] -= borderSize;
-						}
-					}
-					
-					cont->reg = reg;
-					cont->area = area;
-				}
-			}
+	rcScopedDelete<rcTracedContour*> order((rcTracedContour**)rcAlloc(sizeof(rcTracedContour*)*rcMax(nconts, 1), RC_ALLOC_TEMP));
+	cset.conts = (rcContour*)rcAlloc(sizeof(rcContour)*rcMax(nconts, 1), RC_ALLOC_PERM);
+	if (!order || !cset.conts)
+	{
+		ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'conts' (%d).", nconts);
+		freeRegionContours(regionConts, nregions);
+		return false;
+	}
+	int n = 0;
+	for (int i = 0; i < nregions; ++i)
+	{
+		for (int j = 0; j < regionConts[i].nconts; ++j)
+		{
+			rcTracedContour& tc = regionConts[i].conts[j];
+			if (tc.cont.nverts > 0)
+				order[n++] = &tc;
 		}
 	}
+	qsort(order, nconts, sizeof(rcTracedContour*), compareTracedContours);
+	for (int i = 0; i < nconts; ++i)
+	{
+		cset.conts[i] = order[i]->cont;
+		// The contour set owns the data now.
+		order[i]->cont.verts = 0;
+		order[i]->cont.rverts = 0;
+	}
+	cset.nconts = nconts;
+	freeRegionContours(regionConts, nregions);
 	
 	// Merge holes if needed.
 	// TODO 孔洞的处理
@@ -1180,7 +1373,6 @@ bool rcBuildContours(rcContext* ctx, rcCompactHeightfield& chf,
 		{
 			// Collect outline contour and holes contours per region.
 			// We assume that there is one outline and multiple holes.
-			const int nregions = chf.maxRegions+1;
 			rcScopedDelete<rcContourRegion> regions((rcContourRegion*)rcAlloc(sizeof(rcContourRegion)*nregions, RC_ALLOC_TEMP));
 			if (!regions)
 			{
@@ -1231,6 +1423,14 @@ bool rcBuildContours(rcContext* ctx, rcCompactHeightfield& chf,
 			}
 			
 			// Finally merge each regions holes into the outline.
+			// The regions are independent, so they are merged in parallel.
+			rcScopedDelete<int> mergeIds((int*)rcAlloc(sizeof(int)*nregions, RC_ALLOC_TEMP));
+			if (!mergeIds)
+			{
+				ctx->log(RC_LOG_ERROR, "rcBuildContours: Out of memory 'mergeIds' (%d).", nregions);
+				return false;
+			}
+			int nmerge = 0;
 			for (int i = 0; i < nregions; i++)
 			{
 				rcContourRegion& reg = regions[i];
@@ -1238,7 +1438,7 @@ bool rcBuildContours(rcContext* ctx, rcCompactHeightfield& chf,
 				
 				if (reg.outline)
 				{
-					mergeRegionHoles(ctx, reg);
+					mergeIds[nmerge++] = i;
 				}
 				else
 				{
@@ -1248,6 +1448,20 @@ bool rcBuildContours(rcContext* ctx, rcCompactHeightfield& chf,
 					ctx->log(RC_LOG_ERROR, "rcBuildContours: Bad outline for region %d, contour simplification is likely too aggressive.", i);
 				}
 			}
+
+			rcHoleMergeData mergeData;
+			mergeData.regions = regions;
+			mergeData.ids = mergeIds;
+			ctx->parallelFor(nmerge, mergeHolesOfRegions, &mergeData);
+
+			for (int i = 0; i < nmerge; i++)
+			{
+				const rcContourRegion& reg = regions[mergeIds[i]];
+				if (reg.outOfMemory)
+					ctx->log(RC_LOG_WARNING, "mergeRegionHoles: Failed to allocate diags for region %d.", mergeIds[i]);
+				else if (reg.nfailed)
+					ctx->log(RC_LOG_WARNING, "mergeHoles: Failed to merge %d of %d holes of region %d.", reg.nfailed, reg.nholes, mergeIds[i]);
+			}
 		}
 		
 	}
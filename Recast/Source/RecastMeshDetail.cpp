@@ -64,35 +64,6 @@ inline float vcross2(const float* p1, const float* p2, const float* p3)
 	return u1 * v2 - v1 * u2;
 }
 
-static bool circumCircle(const float* p1, const float* p2, const float* p3,
-						 float* c, float& r)
-{
-	static const float EPS = 1e-6f;
-	// Calculate the circle relative to p1, to avoid some precision issues.
-	const float v1[3] = {0,0,0};
-	float v2[3], v3[3];
-	rcVsub(v2, p2,p1);
-	rcVsub(v3, p3,p1);
-	
-	const float cp = vcross2(v1, v2, v3);
-	if (fabsf(cp) > EPS)
-	{
-		const float v1Sq = vdot2(v1,v1);
-		const float v2Sq = vdot2(v2,v2);
-		const float v3Sq = vdot2(v3,v3);
-		c[0] = (v1Sq*(v2[2]-v3[2]) + v2Sq*(v3[2]-v1[2]) + v3Sq*(v1[2]-v2[2])) / (2*cp);
-		c[1] = 0;
-		c[2] = (v1Sq*(v3[0]-v2[0]) + v2Sq*(v1[0]-v3[0]) + v3Sq*(v2[0]-v1[0])) / (2*cp);
-		r = vdist2(c, v1);
-		rcVadd(c, c, p1);
-		return true;
-	}
-	
-	rcVcopy(c, p1);
-	r = 0;
-	return false;
-}
-
 static float distPtTri(const float* p, const float* a, const float* b, const float* c)
 {
 	float v0[3], v1[3], v2[3];
@@ -281,255 +252,329 @@ static unsigned short getHeight(const float fx, const float fy, const float fz,
 }
 
 
-enum EdgeValues
+/// Scratch data for the incremental Delaunay triangulation of a detail polygon.
+struct rcDelaunayMesh
 {
-	EV_UNDEF = -1,
-	EV_HULL = -2,
+	rcIntArray tris;		///< Vertices and neighbour triangles, (a, b, c, nab, nbc, nca) per triangle.
+	rcIntArray touched;		///< The insertion that last changed each triangle.
+	rcIntArray stack;		///< Triangles whose edge opposite the new point needs legalizing.
+	rcIntArray sampleTris;	///< The triangle each sample was last located in.
+	rcTempVector<float> sampleDists;	///< The height error of each sample against its triangle.
 };
 
-static int findEdge(const int* edges, int nedges, int s, int t)
+inline int dtri(const rcDelaunayMesh& dm, const int t, const int i) { return dm.tris[t*6+i]; }
+
+// Returns true if d is inside the circumcircle of the counter-clockwise triangle abc.
+static bool inCircumCircle(const float* a, const float* b, const float* c, const float* d)
 {
-	for (int i = 0; i < nedges; i++)
-	{
-		const int* e = &edges[i*4];
-		if ((e[0] == s && e[1] == t) || (e[0] == t && e[1] == s))
-			return i;
-	}
-	return EV_UNDEF;
+	// Calculate relative to d, in double to keep the predicate stable for thin triangles.
+	const double adx = a[0]-d[0], adz = a[2]-d[2];
+	const double bdx = b[0]-d[0], bdz = b[2]-d[2];
+	const double cdx = c[0]-d[0], cdz = c[2]-d[2];
+	const double ad = adx*adx + adz*adz;
+	const double bd = bdx*bdx + bdz*bdz;
+	const double cd = cdx*cdx + cdz*cdz;
+	const double det = ad*(bdx*cdz - cdx*bdz) - bd*(adx*cdz - cdx*adz) + cd*(adx*bdz - bdx*adz);
+	const double mag = ad*fabs(bdx*cdz - cdx*bdz) + bd*fabs(adx*cdz - cdx*adz) + cd*fabs(adx*bdz - bdx*adz);
+	// Treat (almost) cocircular points as outside, so that edges are never flipped back and forth.
+	return det > mag*1e-9;
 }
 
-static int addEdge(rcContext* ctx, int* edges, int& nedges, const int maxEdges, int s, int t, int l, int r)
+// Replaces the neighbour link 'from' of triangle t with 'to'.
+static void replaceNeighbour(rcDelaunayMesh& dm, const int t, const int from, const int to)
 {
-	if (nedges >= maxEdges)
-	{
-		ctx->log(RC_LOG_ERROR, "addEdge: Too many edges (%d/%d).", nedges, maxEdges);
-		return EV_UNDEF;
-	}
-	
-	// Add edge if not already in the triangulation.
-	int e = findEdge(edges, nedges, s, t);
-	if (e == EV_UNDEF)
-	{
-		int* edge = &edges[nedges*4];
-		edge[0] = s;
-		edge[1] = t;
-		edge[2] = l;
-		edge[3] = r;
-		return nedges++;
-	}
-	else
+	if (t < 0) return;
+	for (int i = 0; i < 3; ++i)
 	{
-		return EV_UNDEF;
+		if (dm.tris[t*6+3+i] == from)
+		{
+			dm.tris[t*6+3+i] = to;
+			return;
+		}
 	}
 }
 
-static void updateLeftFace(int* e, int s, int t, int f)
+static void setTri(rcDelaunayMesh& dm, const int t, const int a, const int b, const int c,
+				   const int nab, const int nbc, const int nca, const int stamp)
 {
-	if (e[0] == s && e[1] == t && e[2] == EV_UNDEF)
-		e[2] = f;
-	else if (e[1] == s && e[0] == t && e[3] == EV_UNDEF)
-		e[3] = f;
+	int* tri = &dm.tris[t*6];
+	tri[0] = a; tri[1] = b; tri[2] = c;
+	tri[3] = nab; tri[4] = nbc; tri[5] = nca;
+	dm.touched[t] = stamp;
 }
 
-static int overlapSegSeg2d(const float* a, const float* b, const float* c, const float* d)
+static int addTri(rcDelaunayMesh& dm)
 {
-	const float a1 = vcross2(a, b, d);
-	const float a2 = vcross2(a, b, c);
-	if (a1*a2 < 0.0f)
-	{
-		float a3 = vcross2(c, d, a);
-		float a4 = a3 + a2 - a1;
-		if (a3 * a4 < 0.0f)
-			return 1;
-	}
-	return 0;
+	const int t = dm.touched.size();
+	dm.tris.resize((t+1)*6);
+	dm.touched.push(0);
+	return t;
 }
 
-static bool overlapEdges(const float* pts, const int* edges, int nedges, int s1, int t1)
+// Turns the triangle fan from triangulateHull() into a counter-clockwise triangle mesh with
+// neighbour links, and flips its edges until it is a Delaunay triangulation of the hull.
+// Returns true if the triangles had to be reversed.
+static bool buildDelaunayMesh(const float* verts, const rcIntArray& tris, rcDelaunayMesh& dm)
 {
-	for (int i = 0; i < nedges; ++i)
-	{
-		const int s0 = edges[i*4+0];
-		const int t0 = edges[i*4+1];
-		// Same or connected edges do not overlap.
-		if (s0 == s1 || s0 == t1 || t0 == s1 || t0 == t1)
-			continue;
-		if (overlapSegSeg2d(&pts[s0*3],&pts[t0*3], &pts[s1*3],&pts[t1*3]))
-			return true;
-	}
-	return false;
-}
+	const int ntris = tris.size()/4;
 
-static void completeFacet(rcContext* ctx, const float* pts, int npts, int* edges, int& nedges, const int maxEdges, int& nfaces, int e)
-{
-	static const float EPS = 1e-5f;
-	
-	int* edge = &edges[e*4];
-	
-	// Cache s and t.
-	int s,t;
-	if (edge[2] == EV_UNDEF)
-	{
-		s = edge[0];
-		t = edge[1];
-	}
-	else if (edge[3] == EV_UNDEF)
-	{
-		s = edge[1];
-		t = edge[0];
-	}
-	else
+	float area = 0;
+	for (int i = 0; i < ntris; ++i)
+		area += vcross2(&verts[tris[i*4+0]*3], &verts[tris[i*4+1]*3], &verts[tris[i*4+2]*3]);
+	const bool reversed = area < 0;
+
+	dm.tris.resize(ntris*6);
+	dm.touched.resize(ntris);
+	for (int i = 0; i < ntris; ++i)
 	{
-	    // Edge already completed.
-	    return;
+		if (reversed)
+			setTri(dm, i, tris[i*4+0], tris[i*4+2], tris[i*4+1], -1, -1, -1, 0);
+		else
+			setTri(dm, i, tris[i*4+0], tris[i*4+1], tris[i*4+2], -1, -1, -1, 0);
 	}
-    
-	// Find best point on left of edge.
-	int pt = npts;
-	float c[3] = {0,0,0};
-	float r = -1;
-	for (int u = 0; u < npts; ++u)
+
+	// Link the neighbours. The polygons are small, so a quadratic search is fine here.
+	for (int i = 0; i < ntris; ++i)
 	{
-		if (u == s || u == t) continue;
-		if (vcross2(&pts[s*3], &pts[t*3], &pts[u*3]) > EPS)
+		for (int e = 0; e < 3; ++e)
 		{
-			if (r < 0)
+			if (dtri(dm, i, 3+e) != -1) continue;
+			const int a = dtri(dm, i, e);
+			const int b = dtri(dm, i, (e+1)%3);
+			for (int j = i+1; j < ntris && dtri(dm, i, 3+e) == -1; ++j)
 			{
-				// The circle is not updated yet, do it now.
-				pt = u;
-				circumCircle(&pts[s*3], &pts[t*3], &pts[u*3], c, r);
-				continue;
-			}
-			const float d = vdist2(c, &pts[u*3]);
-			const float tol = 0.001f;
-			if (d > r*(1+tol))
-			{
-				// Outside current circumcircle, skip.
-				continue;
-			}
-			else if (d < r*(1-tol))
-			{
-				// Inside safe circumcircle, update circle.
-				pt = u;
-				circumCircle(&pts[s*3], &pts[t*3], &pts[u*3], c, r);
+				for (int f = 0; f < 3; ++f)
+				{
+					if (dtri(dm, j, f) == b && dtri(dm, j, (f+1)%3) == a)
+					{
+						dm.tris[i*6+3+e] = j;
+						dm.tris[j*6+3+f] = i;
+						break;
+					}
+				}
 			}
-			else
+		}
+	}
+
+	// Lawson flips, at most a few passes are needed for a fan this size.
+	const int maxPasses = ntris*ntris + 1;
+	for (int pass = 0; pass < maxPasses; ++pass)
+	{
+		bool flipped = false;
+		for (int t = 0; t < ntris; ++t)
+		{
+			for (int e = 0; e < 3; ++e)
 			{
-				// Inside epsilon circum circle, do extra tests to make sure the edge is valid.
-				// s-u and t-u cannot overlap with s-pt nor t-pt if they exists.
-				if (overlapEdges(pts, edges, nedges, s,u))
+				const int u = dtri(dm, t, 3+e);
+				if (u < t) continue; // Hull edge, or visited from the other side.
+				const int a = dtri(dm, t, e);
+				const int b = dtri(dm, t, (e+1)%3);
+				const int c = dtri(dm, t, (e+2)%3);
+				int f = 0;
+				while (dtri(dm, u, 3+f) != t) f++;
+				const int d = dtri(dm, u, (f+2)%3);
+				const float* va = &verts[a*3];
+				const float* vb = &verts[b*3];
+				const float* vc = &verts[c*3];
+				const float* vd = &verts[d*3];
+				if (!inCircumCircle(va, vb, vc, vd))
 					continue;
-				if (overlapEdges(pts, edges, nedges, t,u))
+				if (!(vcross2(vc, vd, va) * vcross2(vc, vd, vb) < 0))
 					continue;
-				// Edge is valid.
-				pt = u;
-				circumCircle(&pts[s*3], &pts[t*3], &pts[u*3], c, r);
+				const int nbc = dtri(dm, t, 3+(e+1)%3);
+				const int nca = dtri(dm, t, 3+(e+2)%3);
+				const int nad = dtri(dm, u, 3+(f+1)%3);
+				const int ndb = dtri(dm, u, 3+(f+2)%3);
+				setTri(dm, t, a, d, c, nad, u, nca, 0);
+				setTri(dm, u, d, b, c, ndb, nbc, t, 0);
+				replaceNeighbour(dm, nad, u, t);
+				replaceNeighbour(dm, nbc, t, u);
+				flipped = true;
+				break;
 			}
 		}
+		if (!flipped)
+			break;
 	}
-	
-	// Add new triangle or update edge info if s-t is on hull.
-	if (pt < npts)
+
+	return reversed;
+}
+
+// Returns the height error of p against triangle t, or against the whole mesh if p is not on t.
+static float distToDelaunayMesh(const float* p, const float* verts, const rcDelaunayMesh& dm, const int t)
+{
+	if (t != -1)
 	{
-		// Update face information of edge being completed.
-		updateLeftFace(&edges[e*4], s, t, nfaces);
-		
-		// Add new edge or update face info of old edge.
-		e = findEdge(edges, nedges, pt, s);
-		if (e == EV_UNDEF)
-		    addEdge(ctx, edges, nedges, maxEdges, pt, s, nfaces, EV_UNDEF);
-		else
-		    updateLeftFace(&edges[e*4], pt, s, nfaces);
-		
-		// Add new edge or update face info of old edge.
-		e = findEdge(edges, nedges, t, pt);
-		if (e == EV_UNDEF)
-		    addEdge(ctx, edges, nedges, maxEdges, t, pt, nfaces, EV_UNDEF);
-		else
-		    updateLeftFace(&edges[e*4], t, pt, nfaces);
-		
-		nfaces++;
+		const float d = distPtTri(p, &verts[dtri(dm, t, 0)*3], &verts[dtri(dm, t, 1)*3], &verts[dtri(dm, t, 2)*3]);
+		if (d != FLT_MAX)
+			return d;
 	}
-	else
+	float dmin = FLT_MAX;
+	for (int i = 0; i < dm.touched.size(); ++i)
 	{
-		updateLeftFace(&edges[e*4], s, t, EV_HULL);
+		const float d = distPtTri(p, &verts[dtri(dm, i, 0)*3], &verts[dtri(dm, i, 1)*3], &verts[dtri(dm, i, 2)*3]);
+		if (d < dmin)
+			dmin = d;
 	}
+	if (dmin == FLT_MAX) return -1;
+	return dmin;
 }
 
-static void delaunayHull(rcContext* ctx, const int npts, const float* pts,
-						 const int nhull, const int* hull,
-						 rcIntArray& tris, rcIntArray& edges)
+// Finds the triangle containing p by walking towards it from triangle 'start'.
+// Returns -1 if p is outside of the mesh.
+static int locateTri(const float* verts, const rcDelaunayMesh& dm, int start, const float* p)
 {
-	int nfaces = 0;
-	int nedges = 0;
-	const int maxEdges = npts*10;
-	edges.resize(maxEdges*4);
-	
-	for (int i = 0, j = nhull-1; i < nhull; j=i++)
-		addEdge(ctx, &edges[0], nedges, maxEdges, hull[j],hull[i], EV_HULL, EV_UNDEF);
-	
-	int currentEdge = 0;
-	while (currentEdge < nedges)
-	{
-		if (edges[currentEdge*4+2] == EV_UNDEF)
-			completeFacet(ctx, pts, npts, &edges[0], nedges, maxEdges, nfaces, currentEdge);
-		if (edges[currentEdge*4+3] == EV_UNDEF)
-			completeFacet(ctx, pts, npts, &edges[0], nedges, maxEdges, nfaces, currentEdge);
-		currentEdge++;
-	}
-	
-	// Create tris
-	tris.resize(nfaces*4);
-	for (int i = 0; i < nfaces*4; ++i)
-		tris[i] = -1;
-	
-	for (int i = 0; i < nedges; ++i)
+	const int ntris = dm.touched.size();
+	int t = start;
+	int prevTri = -1;
+	for (int iter = 0; iter < ntris*3; ++iter)
 	{
-		const int* e = &edges[i*4];
-		if (e[3] >= 0)
-		{
-			// Left face
-			int* t = &tris[e[3]*4];
-			if (t[0] == -1)
-			{
-				t[0] = e[0];
-				t[1] = e[1];
-			}
-			else if (t[0] == e[1])
-				t[2] = e[0];
-			else if (t[1] == e[0])
-				t[2] = e[1];
-		}
-		if (e[2] >= 0)
+		int next = -2;
+		for (int e = 0; e < 3; ++e)
 		{
-			// Right
-			int* t = &tris[e[2]*4];
-			if (t[0] == -1)
+			const float* va = &verts[dtri(dm, t, e)*3];
+			const float* vb = &verts[dtri(dm, t, (e+1)%3)*3];
+			if (vcross2(va, vb, p) < 0)
 			{
-				t[0] = e[1];
-				t[1] = e[0];
+				const int n = dtri(dm, t, 3+e);
+				// Do not step straight back, that is how a walk can get stuck on nearly collinear points.
+				if (n == prevTri && n != -1)
+					continue;
+				next = n;
+				break;
 			}
-			else if (t[0] == e[0])
-				t[2] = e[1];
-			else if (t[1] == e[1])
-				t[2] = e[0];
 		}
+		if (next == -2)
+			return t;
+		if (next == -1)
+			return -1;
+		prevTri = t;
+		t = next;
 	}
-	
-	for (int i = 0; i < tris.size()/4; ++i)
+
+	// Walk did not converge, do a linear search.
+	for (t = 0; t < ntris; ++t)
 	{
-		int* t = &tris[i*4];
-		if (t[0] == -1 || t[1] == -1 || t[2] == -1)
+		bool inside = true;
+		for (int e = 0; e < 3 && inside; ++e)
+			inside = vcross2(&verts[dtri(dm, t, e)*3], &verts[dtri(dm, t, (e+1)%3)*3], p) >= 0;
+		if (inside)
+			return t;
+	}
+	return -1;
+}
+
+// Flips the edges opposite of vertex p of the triangles on the stack until they are all Delaunay.
+static void legalizeEdges(const float* verts, rcDelaunayMesh& dm, const int p, const int stamp)
+{
+	const float* vp = &verts[p*3];
+	// Each flip removes an illegal edge for good, the limit is just a guard against round-off.
+	const int maxFlips = dm.touched.size()*3;
+	for (int nflips = 0; dm.stack.size() > 0 && nflips < maxFlips; )
+	{
+		const int t = dm.stack.pop();
+		// The new point is always the third vertex of the triangles on the stack.
+		if (dtri(dm, t, 2) != p)
+			continue;
+		const int u = dtri(dm, t, 3);
+		if (u == -1)
+			continue; // Hull edge.
+		const int a = dtri(dm, t, 0);
+		const int b = dtri(dm, t, 1);
+		int f = 0;
+		while (dtri(dm, u, 3+f) != t) f++;
+		const int d = dtri(dm, u, (f+2)%3);
+		const float* va = &verts[a*3];
+		const float* vb = &verts[b*3];
+		const float* vd = &verts[d*3];
+		if (!inCircumCircle(va, vb, vp, vd))
+			continue;
+		if (!(vcross2(vp, vd, va) * vcross2(vp, vd, vb) < 0))
+			continue;
+		const int nbp = dtri(dm, t, 4);
+		const int npa = dtri(dm, t, 5);
+		const int nad = dtri(dm, u, 3+(f+1)%3);
+		const int ndb = dtri(dm, u, 3+(f+2)%3);
+		setTri(dm, t, a, d, p, nad, u, npa, stamp);
+		setTri(dm, u, d, b, p, ndb, nbp, t, stamp);
+		replaceNeighbour(dm, nad, u, t);
+		replaceNeighbour(dm, nbp, t, u);
+		dm.stack.push(t);
+		dm.stack.push(u);
+		nflips++;
+	}
+}
+
+// Inserts vertex p, which lies in triangle t, and restores the Delaunay property around it.
+static void insertPoint(const float* verts, rcDelaunayMesh& dm, const int t, const int p, const int stamp)
+{
+	static const float EPS = 1e-5f;
+	const float* vp = &verts[p*3];
+
+	// Check if the point is on one of the triangle edges.
+	int onEdge = -1;
+	for (int e = 0; e < 3; ++e)
+	{
+		const float* va = &verts[dtri(dm, t, e)*3];
+		const float* vb = &verts[dtri(dm, t, (e+1)%3)*3];
+		if (dtri(dm, t, 3+e) != -1 && fabsf(vcross2(va, vb, vp)) <= EPS*vdist2(va, vb))
 		{
-			ctx->log(RC_LOG_WARNING, "delaunayHull: Removing dangling face %d [%d,%d,%d].", i, t[0],t[1],t[2]);
-			t[0] = tris[tris.size()-4];
-			t[1] = tris[tris.size()-3];
-			t[2] = tris[tris.size()-2];
-			t[3] = tris[tris.size()-1];
-			tris.resize(tris.size()-4);
-			--i;
+			onEdge = e;
+			break;
 		}
 	}
+
+	dm.stack.clear();
+
+	if (onEdge == -1)
+	{
+		// Split the triangle in three.
+		const int a = dtri(dm, t, 0);
+		const int b = dtri(dm, t, 1);
+		const int c = dtri(dm, t, 2);
+		const int nab = dtri(dm, t, 3);
+		const int nbc = dtri(dm, t, 4);
+		const int nca = dtri(dm, t, 5);
+		const int t1 = addTri(dm);
+		const int t2 = addTri(dm);
+		setTri(dm, t, a, b, p, nab, t1, t2, stamp);
+		setTri(dm, t1, b, c, p, nbc, t2, t, stamp);
+		setTri(dm, t2, c, a, p, nca, t, t1, stamp);
+		replaceNeighbour(dm, nbc, t, t1);
+		replaceNeighbour(dm, nca, t, t2);
+		dm.stack.push(t);
+		dm.stack.push(t1);
+		dm.stack.push(t2);
+	}
+	else
+	{
+		// Split the edge, and the triangles on both sides of it.
+		const int a = dtri(dm, t, onEdge);
+		const int b = dtri(dm, t, (onEdge+1)%3);
+		const int c = dtri(dm, t, (onEdge+2)%3);
+		const int nbc = dtri(dm, t, 3+(onEdge+1)%3);
+		const int nca = dtri(dm, t, 3+(onEdge+2)%3);
+		const int u = dtri(dm, t, 3+onEdge);
+		int f = 0;
+		while (dtri(dm, u, 3+f) != t) f++;
+		const int d = dtri(dm, u, (f+2)%3);
+		const int nad = dtri(dm, u, 3+(f+1)%3);
+		const int ndb = dtri(dm, u, 3+(f+2)%3);
+		const int t1 = addTri(dm);
+		const int t3 = addTri(dm);
+		setTri(dm, t, c, a, p, nca, u, t1, stamp);
+		setTri(dm, t1, b, c, p, nbc, t, t3, stamp);
+		setTri(dm, u, a, d, p, nad, t3, t, stamp);
+		setTri(dm, t3, d, b, p, ndb, t1, u, stamp);
+		replaceNeighbour(dm, nbc, t, t1);
+		replaceNeighbour(dm, ndb, u, t3);
+		dm.stack.push(t);
+		dm.stack.push(t1);
+		dm.stack.push(u);
+		dm.stack.push(t3);
+	}
+
+	legalizeEdges(verts, dm, p, stamp);
 }
 
 // Calculate minimum extend of the polygon.
@@ -639,7 +684,7 @@ static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 							const float sampleDist, const float sampleMaxError,
 							const int heightSearchRadius, const rcCompactHeightfield& chf,
 							const rcHeightPatch& hp, float* verts, int& nverts,
-							rcIntArray& tris, rcIntArray& edges, rcIntArray& samples)
+							rcIntArray& tris, rcDelaunayMesh& dm, rcIntArray& samples)
 {
 	static const int MAX_VERTS = 127;
 	static const int MAX_TRIS = 255;	// Max tris for delaunay is 2n-2-k (n=num verts, k=num hull verts).
@@ -653,8 +698,9 @@ static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 	for (int i = 0; i < nin; ++i)
 		rcVcopy(&verts[i*3], &in[i*3]);
 	
-	edges.clear();
 	tris.clear();
+	dm.tris.clear();
+	dm.touched.clear();
 	
 	const float cs = chf.cs;
 	const float ics = 1.0f/cs;
@@ -776,7 +822,7 @@ static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 	}
 	
 	// Tessellate the base mesh.
-	// We're using the triangulateHull instead of delaunayHull as it tends to
+	// We're using the triangulateHull instead of a Delaunay triangulation as it tends to
 	// create a bit better triangulation for long thin triangles when there
 	// are no internal points.
 	triangulateHull(nverts, verts, nhull, hull, nin, tris);
@@ -824,7 +870,14 @@ static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 		// Add the samples starting from the one that has the most
 		// error. The procedure stops when all samples are added
 		// or when the max error is within treshold.
+		// The first sample is picked against the hull triangulation, after that the
+		// samples are added one by one to a Delaunay triangulation of the hull, and only
+		// the samples whose triangle was changed by the last insertion are measured again.
 		const int nsamples = samples.size()/4;
+		dm.sampleTris.resize(nsamples);
+		dm.sampleDists.resize(nsamples);
+		bool reversed = false;
+		int lastTri = -1;
 		for (int iter = 0; iter < nsamples; ++iter)
 		{
 			if (nverts >= MAX_VERTS)
@@ -844,7 +897,21 @@ static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 				pt[0] = s[0]*sampleDist + getJitterX(i)*cs*0.1f;
 				pt[1] = s[1]*chf.ch;
 				pt[2] = s[2]*sampleDist + getJitterY(i)*cs*0.1f;
-				float d = distToTriMesh(pt, verts, nverts, &tris[0], tris.size()/4);
+				float d;
+				if (iter == 0)
+				{
+					d = distToTriMesh(pt, verts, nverts, &tris[0], tris.size()/4);
+				}
+				else
+				{
+					const int st = dm.sampleTris[i];
+					if (st == -1 || dm.touched[st] == iter)
+					{
+						dm.sampleTris[i] = locateTri(verts, dm, st != -1 ? st : lastTri, pt);
+						dm.sampleDists[i] = distToDelaunayMesh(pt, verts, dm, dm.sampleTris[i]);
+					}
+					d = dm.sampleDists[i];
+				}
 				if (d < 0) continue; // did not hit the mesh.
 				if (d > bestd)
 				{
@@ -858,15 +925,40 @@ static bool buildPolyDetail(rcContext* ctx, const float* in, const int nin,
 				break;
 			// Mark sample as added.
 			samples[besti*4+3] = 1;
+			
+			if (iter == 0)
+			{
+				reversed = buildDelaunayMesh(verts, tris, dm);
+				for (int i = 0; i < nsamples; ++i)
+					dm.sampleTris[i] = -1;
+				lastTri = 0;
+			}
+			
 			// Add the new sample point.
 			rcVcopy(&verts[nverts*3],bestpt);
 			nverts++;
 			
-			// Create new triangulation.
-			// TODO: Incremental add instead of full rebuild.
-			edges.clear();
+			const int t = iter == 0 ? locateTri(verts, dm, lastTri, bestpt) : dm.sampleTris[besti];
+			if (t == -1)
+			{
+				// Only happens for samples that hit the mesh within the tolerance of distPtTri.
+				nverts--;
+				continue;
+			}
+			insertPoint(verts, dm, t, nverts-1, iter+1);
+			lastTri = t;
+		}
+		
+		if (dm.touched.size() > 0)
+		{
 			tris.clear();
-			delaunayHull(ctx, nverts, verts, nhull, hull, tris, edges);
+			for (int i = 0; i < dm.touched.size(); ++i)
+			{
+				tris.push(dtri(dm, i, 0));
+				tris.push(dtri(dm, i, reversed ? 2 : 1));
+				tris.push(dtri(dm, i, reversed ? 1 : 2));
+				tris.push(0);
+			}
 		}
 	}
 	
@@ -1186,7 +1278,7 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 	const int borderSize = mesh.borderSize;
 	const int heightSearchRadius = rcMax(1, (int)ceilf(mesh.maxEdgeError));
 	
-	rcIntArray edges(64);
+	rcDelaunayMesh dm;
 	rcIntArray tris(512);
 	rcIntArray arr(512);
 	rcIntArray samples(512);
@@ -1303,7 +1395,7 @@ bool rcBuildPolyMeshDetail(rcContext* ctx, const rcPolyMesh& mesh, const rcCompa
 							 sampleDist, sampleMaxError,
 							 heightSearchRadius, chf, hp,
 							 verts, nverts, tris,
-							 edges, samples))
+							 dm, samples))
 		{
 			return false;
 		}
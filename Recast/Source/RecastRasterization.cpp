@@ -273,6 +273,18 @@ static void dividePoly(const float* in, int nin,
 	*nout2 = n;
 }
 
+// Controls how rasterizeTri treats geometry beyond the heightfield bounds.
+enum rcRasterizeEdgeMode
+{
+	// Geometry below the minimum x/z bounds is clamped into the first row and column.
+	// (The behaviour of a stand-alone heightfield.)
+	RC_RASTERIZE_CLAMP_EDGES,
+	// Geometry outside the bounds is discarded. (Used for store chunks, which must seam exactly.)
+	RC_RASTERIZE_CLIP_EDGES,
+	// Like RC_RASTERIZE_CLAMP_EDGES, but only the first and last rows and columns receive spans.
+	RC_RASTERIZE_ONLY_EDGES,
+};
+
 // v0, v1, v2: 三角形的三个顶点
 // area: 可行走标记
 // hf: 高度场
@@ -280,11 +292,12 @@ static void dividePoly(const float* in, int nin,
 // cs: cell size，用于确定多边形切割时的原始坐标步长
 // ics, ich: cs ch 的倒数
 // flagMergeThr: 确定 y 轴上两个连续 span 是否能合并的高度
+// edgeMode: 高度场边界外几何体的处理方式，见 rcRasterizeEdgeMode
 static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
 						 const unsigned char area, rcHeightfield& hf,
 						 const float* bmin, const float* bmax,
 						 const float cs, const float ics, const float ich,
-						 const int flagMergeThr)
+						 const int flagMergeThr, const rcRasterizeEdgeMode edgeMode)
 {
 	const int w = hf.width;
 	const int h = hf.height;
@@ -306,12 +319,24 @@ static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
 	if (!overlapBounds(bmin, bmax, tmin, tmax))
 		return true;
 
+	// Only triangles reaching into the outermost rows or columns can affect the edges.
+	if (edgeMode == RC_RASTERIZE_ONLY_EDGES &&
+		tmin[0] > bmin[0]+cs && tmax[0] < bmax[0]-cs &&
+		tmin[2] > bmin[2]+cs && tmax[2] < bmax[2]-cs)
+		return true;
+
+	// When clipping, start one row/column early so that the first cut discards
+	// everything below the minimum bounds.
+	const int edgeMin = edgeMode == RC_RASTERIZE_CLIP_EDGES ? -1 : 0;
+
 	// Calculate the footprint of the triangle on the grid's y-axi
 	// 求出三角形包围盒在 z 轴坐标上的最小和最大偏移值，乘以 ics 将其由原始坐标转换为格子坐标系 y 轴坐标
 	// 最后 tcClamp 将其限定在高度场坐标范围内
-	int y0 = (int)((tmin[2] - bmin[2])*ics);
+	int y0 = (int)floorf((tmin[2] - bmin[2])*ics);
 	int y1 = (int)((tmax[2] - bmin[2])*ics);
-	y0 = rcClamp(y0, 0, h-1);
+	if (edgeMode == RC_RASTERIZE_CLIP_EDGES && y0 >= h)
+		return true;
+	y0 = rcClamp(y0, edgeMin, h-1);
 	y1 = rcClamp(y1, 0, h-1);
 	
 	// Clip the triangle into all grid cells it touches.
@@ -346,6 +371,7 @@ static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
 		dividePoly(in, nvIn, inrow, &nvrow, p1, &nvIn, cz+cs, 2);
 		rcSwap(in, p1);
 		if (nvrow < 3) continue; // 没有割到东西
+		if (y < 0) continue;
 
 		// find the horizontal bounds in the row
 		float minX = inrow[0], maxX = inrow[0];
@@ -356,11 +382,18 @@ static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
 		}
 
 		// 计算出切割出的待光栅化多边形里，其包围盒与高度场包围盒在 x 轴上的差值
-		int x0 = (int)((minX - bmin[0])*ics);
+		int x0 = (int)floorf((minX - bmin[0])*ics);
 		int x1 = (int)((maxX - bmin[0])*ics);
-		x0 = rcClamp(x0, 0, w-1);
+		if (edgeMode == RC_RASTERIZE_CLIP_EDGES && x0 >= w)
+			continue;
+		x0 = rcClamp(x0, edgeMin, w-1);
 		x1 = rcClamp(x1, 0, w-1);
 
+		// Between the first and last row, only the first and last column are of interest to the edge pass.
+		const bool edgeRow = y == 0 || y == h-1;
+		if (edgeMode == RC_RASTERIZE_ONLY_EDGES && !edgeRow && x0 > 0 && x1 < w-1)
+			continue;
+
 		int nv, nv2 = nvrow;
 
         // 遍历切割出的多边形，在 x 轴上对其再次进行切割
@@ -371,6 +404,8 @@ static bool rasterizeTri(const float* v0, const float* v1, const float* v2,
 			dividePoly(inrow, nv2, p1, &nv, p2, &nv2, cx+cs, 0);
 			rcSwap(inrow, p2);
 			if (nv < 3) continue;
+			if (x < 0) continue;
+			if (edgeMode == RC_RASTERIZE_ONLY_EDGES && !edgeRow && x > 0 && x < w-1) continue;
 			
 			// Calculate min and max of the span.
 			// 计算出切割出的多边形在原始坐标里 y 轴上的最小和最大高度
@@ -418,7 +453,7 @@ bool rcRasterizeTriangle(rcContext* ctx, const float* v0, const float* v1, const
 
 	const float ics = 1.0f/solid.cs;
 	const float ich = 1.0f/solid.ch;
-	if (!rasterizeTri(v0, v1, v2, area, solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr))
+	if (!rasterizeTri(v0, v1, v2, area, solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr, RC_RASTERIZE_CLAMP_EDGES))
 	{
 		ctx->log(RC_LOG_ERROR, "rcRasterizeTriangle: Out of memory.");
 		return false;
@@ -449,7 +484,7 @@ bool rcRasterizeTriangles(rcContext* ctx, const float* verts, const int /*nv*/,
 		const float* v1 = &verts[tris[i*3+1]*3];
 		const float* v2 = &verts[tris[i*3+2]*3];
 		// Rasterize.
-		if (!rasterizeTri(v0, v1, v2, areas[i], solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr))
+		if (!rasterizeTri(v0, v1, v2, areas[i], solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr, RC_RASTERIZE_CLAMP_EDGES))
 		{
 			ctx->log(RC_LOG_ERROR, "rcRasterizeTriangles: Out of memory.");
 			return false;
@@ -483,7 +518,7 @@ bool rcRasterizeTriangles(rcContext* ctx, const float* verts, const int /*nv*/,
 		const float* v1 = &verts[tris[i*3+1]*3];
 		const float* v2 = &verts[tris[i*3+2]*3];
 		// Rasterize.
-		if (!rasterizeTri(v0, v1, v2, areas[i], solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr))
+		if (!rasterizeTri(v0, v1, v2, areas[i], solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr, RC_RASTERIZE_CLAMP_EDGES))
 		{
 			ctx->log(RC_LOG_ERROR, "rcRasterizeTriangles: Out of memory.");
 			return false;
@@ -514,7 +549,7 @@ bool rcRasterizeTriangles(rcContext* ctx, const float* verts, const unsigned cha
 		const float* v1 = &verts[(i*3+1)*3];
 		const float* v2 = &verts[(i*3+2)*3];
 		// Rasterize.
-		if (!rasterizeTri(v0, v1, v2, areas[i], solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr))
+		if (!rasterizeTri(v0, v1, v2, areas[i], solid, solid.bmin, solid.bmax, solid.cs, ics, ich, flagMergeThr, RC_RASTERIZE_CLAMP_EDGES))
 		{
 			ctx->log(RC_LOG_ERROR, "rcRasterizeTriangles: Out of memory.");
 			return false;
@@ -523,3 +558,183 @@ bool rcRasterizeTriangles(rcContext* ctx, const float* verts, const unsigned cha
 
 	return true;
 }
+
+// Returns the store chunk at the specified chunk coordinates, creating it on first use.
+static rcHeightfield* getStoreChunk(rcHeightfieldStore& store, const int cx, const int cy)
+{
+	rcHeightfield*& chunk = store.chunks[cx + cy*store.nchunksx];
+	if (chunk)
+		return chunk;
+
+	const int x = cx*store.chunkSize;
+	const int y = cy*store.chunkSize;
+	const int w = rcMin(store.chunkSize, store.width - x);
+	const int h = rcMin(store.chunkSize, store.height - y);
+	float bmin[3], bmax[3];
+	bmin[0] = store.bmin[0] + x*store.cs;
+	bmin[1] = store.bmin[1];
+	bmin[2] = store.bmin[2] + y*store.cs;
+	bmax[0] = bmin[0] + w*store.cs;
+	bmax[1] = store.bmax[1];
+	bmax[2] = bmin[2] + h*store.cs;
+
+	chunk = rcAllocHeightfield();
+	if (!chunk)
+		return 0;
+	if (!rcCreateHeightfield(0, *chunk, w, h, bmin, bmax, store.cs, store.ch))
+	{
+		rcFreeHeightField(chunk);
+		chunk = 0;
+	}
+	return chunk;
+}
+
+/// @par
+///
+/// Each triangle is clipped against the chunks it overlaps, so every cell of the store is
+/// rasterized exactly once no matter how many tiles later read it.  Triangles should be
+/// passed in the same order a per-tile build would rasterize them in, since span merging
+/// is order dependent.
+///
+/// @see rcHeightfieldStore, rcCopyHeightfieldFromStore
+bool rcRasterizeTrianglesToStore(rcContext* ctx, const float* verts, const int /*nv*/,
+								 const int* tris, const unsigned char* areas, const int nt,
+								 rcHeightfieldStore& store, const int flagMergeThr)
+{
+	rcAssert(ctx);
+
+	rcScopedTimer timer(ctx, RC_TIMER_RASTERIZE_TRIANGLES);
+
+	const float ics = 1.0f/store.cs;
+	const float ich = 1.0f/store.ch;
+	for (int i = 0; i < nt; ++i)
+	{
+		const float* v0 = &verts[tris[i*3+0]*3];
+		const float* v1 = &verts[tris[i*3+1]*3];
+		const float* v2 = &verts[tris[i*3+2]*3];
+
+		float tmin[3], tmax[3];
+		rcVcopy(tmin, v0);
+		rcVcopy(tmax, v0);
+		rcVmin(tmin, v1);
+		rcVmin(tmin, v2);
+		rcVmax(tmax, v1);
+		rcVmax(tmax, v2);
+		if (!overlapBounds(store.bmin, store.bmax, tmin, tmax))
+			continue;
+
+		// Find the chunks touched by the triangle.
+		const int x0 = rcClamp((int)floorf((tmin[0] - store.bmin[0])*ics), 0, store.width-1);
+		const int x1 = rcClamp((int)((tmax[0] - store.bmin[0])*ics), 0, store.width-1);
+		const int y0 = rcClamp((int)floorf((tmin[2] - store.bmin[2])*ics), 0, store.height-1);
+		const int y1 = rcClamp((int)((tmax[2] - store.bmin[2])*ics), 0, store.height-1);
+
+		for (int cy = y0/store.chunkSize; cy <= y1/store.chunkSize; ++cy)
+		{
+			for (int cx = x0/store.chunkSize; cx <= x1/store.chunkSize; ++cx)
+			{
+				rcHeightfield* chunk = getStoreChunk(store, cx, cy);
+				if (!chunk || !rasterizeTri(v0, v1, v2, areas[i], *chunk, chunk->bmin, chunk->bmax,
+											store.cs, ics, ich, flagMergeThr, RC_RASTERIZE_CLIP_EDGES))
+				{
+					ctx->log(RC_LOG_ERROR, "rcRasterizeTrianglesToStore: Out of memory.");
+					return false;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+/// @par
+///
+/// The spans of a store cell are already sorted and merged, so they are appended
+/// to the heightfield columns as they are.  Cells outside the store are left empty.
+///
+/// A stand-alone rasterization clamps geometry outside its bounds into the outermost
+/// rows and columns of the heightfield, so those cells are not copied.  Fill them with
+/// #rcRasterizeHeightfieldEdges to get the same result as a stand-alone rasterization.
+///
+/// The result is only bit-identical when the heightfield and store bounds fall on exact
+/// multiples of the cell size.  Otherwise the cell edges of the two differ in the last
+/// bits, and a sliver of a triangle grazing an edge can land in the cell on the other side
+/// of it, adding a span or changing the area merged into one.
+///
+/// @see rcHeightfieldStore, rcRasterizeTrianglesToStore, rcRasterizeHeightfieldEdges
+bool rcCopyHeightfieldFromStore(rcContext* ctx, const rcHeightfieldStore& store, const int x, const int y,
+								rcHeightfield& hf)
+{
+	rcAssert(ctx);
+
+	const int cs = store.chunkSize;
+	for (int hy = 1; hy < hf.height-1; ++hy)
+	{
+		const int sy = y + hy;
+		if (sy < 0 || sy >= store.height)
+			continue;
+		for (int hx = 1; hx < hf.width-1; ++hx)
+		{
+			const int sx = x + hx;
+			if (sx < 0 || sx >= store.width)
+				continue;
+			const rcHeightfield* chunk = store.chunks[sx/cs + (sy/cs)*store.nchunksx];
+			if (!chunk)
+				continue;
+
+			rcSpan** tail = &hf.spans[hx + hy*hf.width];
+			while (*tail)
+				tail = &(*tail)->next;
+			for (const rcSpan* s = chunk->spans[(sx%cs) + (sy%cs)*chunk->width]; s; s = s->next)
+			{
+				rcSpan* ns = allocSpan(hf);
+				if (!ns)
+				{
+					ctx->log(RC_LOG_ERROR, "rcCopyHeightfieldFromStore: Out of memory.");
+					return false;
+				}
+				ns->smin = s->smin;
+				ns->smax = s->smax;
+				ns->area = s->area;
+				ns->next = 0;
+				*tail = ns;
+				tail = &ns->next;
+			}
+		}
+	}
+
+	return true;
+}
+
+/// @par
+///
+/// Pass the same triangles, in the same order, that a stand-alone rasterization of the
+/// heightfield would use.  Triangles that cannot reach the outermost rows or columns are
+/// rejected early, and spans are only added to those cells.
+///
+/// @see rcCopyHeightfieldFromStore
+bool rcRasterizeHeightfieldEdges(rcContext* ctx, const float* verts, const int /*nv*/,
+								 const int* tris, const unsigned char* areas, const int nt,
+								 rcHeightfield& solid, const int flagMergeThr)
+{
+	rcAssert(ctx);
+
+	rcScopedTimer timer(ctx, RC_TIMER_RASTERIZE_TRIANGLES);
+
+	const float ics = 1.0f/solid.cs;
+	const float ich = 1.0f/solid.ch;
+	for (int i = 0; i < nt; ++i)
+	{
+		const float* v0 = &verts[tris[i*3+0]*3];
+		const float* v1 = &verts[tris[i*3+1]*3];
+		const float* v2 = &verts[tris[i*3+2]*3];
+		if (!rasterizeTri(v0, v1, v2, areas[i], solid, solid.bmin, solid.bmax, solid.cs, ics, ich,
+						  flagMergeThr, RC_RASTERIZE_ONLY_EDGES))
+		{
+			ctx->log(RC_LOG_ERROR, "rcRasterizeHeightfieldEdges: Out of memory.");
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,166 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#ifndef GEOMSTREAM_H
+#define GEOMSTREAM_H
+
+#include <stdio.h>
+
+/// Input geometry stored on disk as a uniform grid of cells on the xz-plane,
+/// so that a tiled build can read just the triangles around the tile it builds.
+///
+/// Each triangle is stored once, in the cell containing its centroid. Each cell has
+/// its own vertex list, and the cell table at the end of the file records where each
+/// cell is stored and the bounds of its triangles.
+
+static const int GEOMSTREAM_MAGIC = 'R'<<24 | 'C'<<16 | 'G'<<8 | 'S'; //'RCGS';
+static const int GEOMSTREAM_VERSION = 1;
+
+struct GeomStreamHeader
+{
+	int magic;
+	int version;
+	float bmin[3];			///< The bounds of the grid.
+	float bmax[3];
+	float cellSize;			///< The size of a grid cell on the xz-plane.
+	int width;				///< The number of cells along the x-axis.
+	int height;				///< The number of cells along the z-axis.
+	float overhang;			///< How far triangles reach beyond the cell they are stored in.
+	int maxVertsPerCell;
+	int maxTrisPerCell;
+	long long tableOffset;	///< The file offset of the cell table. [Size: #width * #height]
+};
+
+struct GeomStreamCellInfo
+{
+	long long offset;		///< The file offset of the cell data, or 0 if the cell is empty.
+	int nverts;
+	int ntris;
+	float bmin[3];			///< The bounds of the triangles in the cell.
+	float bmax[3];
+};
+
+/// Geometry of a cell that has been read into memory.
+struct GeomStreamCell
+{
+	float* verts;	///< [(x, y, z) * nverts]
+	int* tris;		///< [(vertA, vertB, vertC) * ntris]
+	int nverts;
+	int ntris;
+	int index;		///< The index of the cell in the grid.
+};
+
+/// Writes a geometry stream one cell at a time, so the geometry never has to be
+/// in memory all at once.
+class GeomStreamWriter
+{
+	FILE* m_fp;
+	GeomStreamHeader m_header;
+	GeomStreamCellInfo* m_cells;
+
+public:
+	GeomStreamWriter();
+	~GeomStreamWriter();
+
+	bool create(const char* path, const float* bmin, const float* bmax, const float cellSize);
+
+	/// Writes the triangles of cell (@p x, @p y). Each cell can be written once, in any order.
+	/// The triangles should have their centroid inside the cell, but may extend out of it.
+	bool addCell(const int x, const int y, const float* verts, const int nverts, const int* tris, const int ntris);
+
+	/// Writes the cell table and finishes the file.
+	bool close();
+
+	int getGridWidth() const { return m_header.width; }
+	int getGridHeight() const { return m_header.height; }
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	GeomStreamWriter(const GeomStreamWriter&);
+	GeomStreamWriter& operator=(const GeomStreamWriter&);
+};
+
+/// Writes an in-memory mesh to a geometry stream, binning its triangles into cells.
+bool writeGeomStream(const char* path, const float* verts, const int nverts, const int* tris, const int ntris,
+					 const float* bmin, const float* bmax, const float cellSize);
+
+/// Reads cells of a geometry stream on demand, keeping the most recently used
+/// cells in memory up to a fixed budget.
+class GeomStream
+{
+public:
+	struct Stats
+	{
+		int hits;				///< Cell requests served from memory.
+		int misses;				///< Cell requests that had to read the file.
+		int evictions;			///< Cells dropped to stay within the budget.
+		int residentCells;
+		size_t residentBytes;
+		size_t peakResidentBytes;
+	};
+
+private:
+	FILE* m_fp;
+	GeomStreamHeader m_header;
+	GeomStreamCellInfo* m_cells;
+	GeomStreamCell** m_resident;	///< The loaded cells, by cell index.
+	int* m_lruPrev;					///< The LRU list of loaded cells, by cell index.
+	int* m_lruNext;
+	int m_lruHead;					///< The most recently used cell.
+	int m_lruTail;					///< The least recently used cell.
+	size_t m_maxResidentBytes;
+	Stats m_stats;
+
+	void unlinkCell(const int idx);
+	void linkCellFront(const int idx);
+	void evictCell(const int idx);
+	void calcCellRange(const float* bmin, const float* bmax, int& x0, int& y0, int& x1, int& y1) const;
+
+public:
+	GeomStream();
+	~GeomStream();
+
+	/// Opens a geometry stream that keeps at most @p maxResidentBytes of cell geometry in memory.
+	bool open(const char* path, const size_t maxResidentBytes);
+	void close();
+
+	/// Finds the non-empty cells with triangles overlapping the bounds on the xz-plane.
+	///  @return The number of cells written to @p cells.
+	int queryCells(const float* bmin, const float* bmax, int* cells, const int maxCells) const;
+
+	/// Returns the number of cells queryCells() looks at for the bounds, the most it can return.
+	int getMaxCellCount(const float* bmin, const float* bmax) const;
+
+	/// Returns the geometry of a cell, reading it from disk if it is not resident.
+	/// The returned cell stays valid until the next call to getCell() or close().
+	const GeomStreamCell* getCell(const int idx);
+
+	void setMaxResidentBytes(const size_t maxResidentBytes);
+	size_t getMaxResidentBytes() const { return m_maxResidentBytes; }
+
+	const GeomStreamHeader& getHeader() const { return m_header; }
+	const Stats& getStats() const { return m_stats; }
+	void resetStats();
+
+private:
+	// Explicitly disabled copy constructor and copy assignment operator.
+	GeomStream(const GeomStream&);
+	GeomStream& operator=(const GeomStream&);
+};
+
+#endif // GEOMSTREAM_H
@@ -19,7 +19,7 @@
 #ifndef INPUTGEOM_H
 #define INPUTGEOM_H
 
-#include "ChunkyTriMesh.h"
+#include "Recast.h"
 #include "MeshLoaderObj.h"
 
 static const int MAX_CONVEXVOL_PTS = 12;
@@ -22,7 +22,6 @@
 #include "Sample.h"
 #include "DetourNavMesh.h"
 #include "Recast.h"
-#include "ChunkyTriMesh.h"
 
 
 class Sample_TempObstacles : public Sample
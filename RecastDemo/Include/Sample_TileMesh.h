@@ -22,13 +22,15 @@
 #include "Sample.h"
 #include "DetourNavMesh.h"
 #include "Recast.h"
-#include "ChunkyTriMesh.h"
 
 class Sample_TileMesh : public Sample
 {
 protected:
 	bool m_keepInterResults;
 	bool m_buildAll;
+	bool m_sharedRasterization;
+	bool m_streamGeometry;
+	float m_streamBudgetMB;
 	float m_totalBuildTimeMs;
 
 	unsigned char* m_triareas;
@@ -75,7 +77,12 @@ protected:
 	float m_tileMemUsage;
 	int m_tileTriCount;
 
-	unsigned char* buildTileMesh(const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize);
+	unsigned char* buildTileMesh(const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize,
+								 const rcHeightfieldStore* store = 0, class GeomStream* stream = 0);
+	bool rasterizeTileTriangles(const float* verts, const int nverts, const int* tris, const int ntris,
+								const bool edgesOnly);
+	rcHeightfieldStore* rasterizeAllTiles(const int tw, const int th);
+	class GeomStream* openGeomStream(const float tileWorldSize);
 	
 	void cleanup();
 	
@@ -0,0 +1,447 @@
+//
+// Copyright (c) 2009-2010 Mikko Mononen memon@inside.org
+//
+// This software is provided 'as-is', without any express or implied
+// warranty.  In no event will the authors be held liable for any damages
+// arising from the use of this software.
+// Permission is granted to anyone to use this software for any purpose,
+// including commercial applications, and to alter it and redistribute it
+// freely, subject to the following restrictions:
+// 1. The origin of this software must not be misrepresented; you must not
+//    claim that you wrote the original software. If you use this software
+//    in a product, an acknowledgment in the product documentation would be
+//    appreciated but is not required.
+// 2. Altered source versions must be plainly marked as such, and must not be
+//    misrepresented as being the original software.
+// 3. This notice may not be removed or altered from any source distribution.
+//
+
+#include "GeomStream.h"
+#include <string.h>
+#include <math.h>
+#include "Recast.h"
+
+#ifdef _WIN32
+#	define fseek64 _fseeki64
+#	define ftell64 _ftelli64
+#else
+#	define fseek64 fseeko
+#	define ftell64 ftello
+#endif
+
+static size_t cellMemory(const int nverts, const int ntris)
+{
+	return sizeof(GeomStreamCell) + sizeof(float)*nverts*3 + sizeof(int)*ntris*3;
+}
+
+static void freeCell(GeomStreamCell* cell)
+{
+	if (!cell) return;
+	delete [] cell->verts;
+	delete [] cell->tris;
+	delete cell;
+}
+
+GeomStreamWriter::GeomStreamWriter() :
+	m_fp(0),
+	m_cells(0)
+{
+	memset(&m_header, 0, sizeof(m_header));
+}
+
+GeomStreamWriter::~GeomStreamWriter()
+{
+	if (m_fp)
+		fclose(m_fp);
+	delete [] m_cells;
+}
+
+bool GeomStreamWriter::create(const char* path, const float* bmin, const float* bmax, const float cellSize)
+{
+	if (m_fp || cellSize <= 0.0f)
+		return false;
+
+	memset(&m_header, 0, sizeof(m_header));
+	m_header.magic = GEOMSTREAM_MAGIC;
+	m_header.version = GEOMSTREAM_VERSION;
+	rcVcopy(m_header.bmin, bmin);
+	rcVcopy(m_header.bmax, bmax);
+	m_header.cellSize = cellSize;
+	m_header.width = rcMax(1, (int)ceilf((bmax[0] - bmin[0]) / cellSize));
+	m_header.height = rcMax(1, (int)ceilf((bmax[2] - bmin[2]) / cellSize));
+
+	const int ncells = m_header.width * m_header.height;
+	m_cells = new GeomStreamCellInfo[ncells];
+	memset(m_cells, 0, sizeof(GeomStreamCellInfo)*ncells);
+
+	m_fp = fopen(path, "wb");
+	if (!m_fp)
+		return false;
+
+	// Reserve space for the header, it is written again on close.
+	return fwrite(&m_header, sizeof(m_header), 1, m_fp) == 1;
+}
+
+bool GeomStreamWriter::addCell(const int x, const int y, const float* verts, const int nverts, const int* tris, const int ntris)
+{
+	if (!m_fp || x < 0 || y < 0 || x >= m_header.width || y >= m_header.height)
+		return false;
+	GeomStreamCellInfo& info = m_cells[x + y*m_header.width];
+	if (info.offset)
+		return false;
+	if (!ntris)
+		return true;
+
+	info.offset = ftell64(m_fp);
+	info.nverts = nverts;
+	info.ntris = ntris;
+
+	// Bounds of the triangles, and how far they reach outside the cell.
+	rcVcopy(info.bmin, &verts[tris[0]*3]);
+	rcVcopy(info.bmax, &verts[tris[0]*3]);
+	for (int i = 0; i < ntris*3; ++i)
+	{
+		rcVmin(info.bmin, &verts[tris[i]*3]);
+		rcVmax(info.bmax, &verts[tris[i]*3]);
+	}
+	const float cs = m_header.cellSize;
+	const float cxmin = m_header.bmin[0] + x*cs;
+	const float czmin = m_header.bmin[2] + y*cs;
+	float overhang = m_header.overhang;
+	overhang = rcMax(overhang, cxmin - info.bmin[0]);
+	overhang = rcMax(overhang, czmin - info.bmin[2]);
+	overhang = rcMax(overhang, info.bmax[0] - (cxmin + cs));
+	overhang = rcMax(overhang, info.bmax[2] - (czmin + cs));
+	m_header.overhang = overhang;
+	m_header.maxVertsPerCell = rcMax(m_header.maxVertsPerCell, nverts);
+	m_header.maxTrisPerCell = rcMax(m_header.maxTrisPerCell, ntris);
+
+	if (fwrite(verts, sizeof(float)*3, nverts, m_fp) != (size_t)nverts)
+		return false;
+	if (fwrite(tris, sizeof(int)*3, ntris, m_fp) != (size_t)ntris)
+		return false;
+	return true;
+}
+
+bool GeomStreamWriter::close()
+{
+	if (!m_fp)
+		return false;
+
+	bool ok = true;
+	m_header.tableOffset = ftell64(m_fp);
+	const size_t ncells = (size_t)(m_header.width * m_header.height);
+	ok &= fwrite(m_cells, sizeof(GeomStreamCellInfo), ncells, m_fp) == ncells;
+	ok &= fseek64(m_fp, 0, SEEK_SET) == 0;
+	ok &= fwrite(&m_header, sizeof(m_header), 1, m_fp) == 1;
+	ok &= fclose(m_fp) == 0;
+	m_fp = 0;
+
+	delete [] m_cells;
+	m_cells = 0;
+
+	return ok;
+}
+
+bool writeGeomStream(const char* path, const float* verts, const int nverts, const int* tris, const int ntris,
+					 const float* bmin, const float* bmax, const float cellSize)
+{
+	GeomStreamWriter writer;
+	if (!writer.create(path, bmin, bmax, cellSize))
+		return false;
+
+	const int w = writer.getGridWidth();
+	const int h = writer.getGridHeight();
+	const int ncells = w*h;
+
+	// Bin the triangles by centroid with a counting sort.
+	int* triCell = new int[ntris];
+	int* cellStart = new int[ncells+1];
+	int* sorted = new int[ntris];
+	memset(cellStart, 0, sizeof(int)*(ncells+1));
+	for (int i = 0; i < ntris; ++i)
+	{
+		const float* va = &verts[tris[i*3+0]*3];
+		const float* vb = &verts[tris[i*3+1]*3];
+		const float* vc = &verts[tris[i*3+2]*3];
+		const float cx = (va[0] + vb[0] + vc[0]) / 3.0f;
+		const float cz = (va[2] + vb[2] + vc[2]) / 3.0f;
+		const int x = rcClamp((int)floorf((cx - bmin[0]) / cellSize), 0, w-1);
+		const int y = rcClamp((int)floorf((cz - bmin[2]) / cellSize), 0, h-1);
+		triCell[i] = x + y*w;
+		cellStart[triCell[i]+1]++;
+	}
+	for (int i = 0; i < ncells; ++i)
+		cellStart[i+1] += cellStart[i];
+	for (int i = 0; i < ntris; ++i)
+		sorted[cellStart[triCell[i]]++] = i;
+	for (int i = ncells; i > 0; --i)
+		cellStart[i] = cellStart[i-1];
+	cellStart[0] = 0;
+
+	// Remap the vertices of each cell to a local vertex list.
+	int* remap = new int[nverts];
+	memset(remap, 0xff, sizeof(int)*nverts);
+	float* cellVerts = new float[ntris*3*3];
+	int* cellTris = new int[ntris*3];
+
+	bool ok = true;
+	for (int c = 0; c < ncells && ok; ++c)
+	{
+		const int first = cellStart[c];
+		const int n = cellStart[c+1] - first;
+		if (!n)
+			continue;
+		int nv = 0;
+		for (int i = 0; i < n; ++i)
+		{
+			const int* t = &tris[sorted[first+i]*3];
+			for (int j = 0; j < 3; ++j)
+			{
+				if (remap[t[j]] == -1)
+				{
+					rcVcopy(&cellVerts[nv*3], &verts[t[j]*3]);
+					remap[t[j]] = nv++;
+				}
+				cellTris[i*3+j] = remap[t[j]];
+			}
+		}
+		ok = writer.addCell(c % w, c / w, cellVerts, nv, cellTris, n);
+
+		for (int i = 0; i < n; ++i)
+		{
+			const int* t = &tris[sorted[first+i]*3];
+			remap[t[0]] = remap[t[1]] = remap[t[2]] = -1;
+		}
+	}
+
+	delete [] cellTris;
+	delete [] cellVerts;
+	delete [] remap;
+	delete [] sorted;
+	delete [] cellStart;
+	delete [] triCell;
+
+	return writer.close() && ok;
+}
+
+GeomStream::GeomStream() :
+	m_fp(0),
+	m_cells(0),
+	m_resident(0),
+	m_lruPrev(0),
+	m_lruNext(0),
+	m_lruHead(-1),
+	m_lruTail(-1),
+	m_maxResidentBytes(0)
+{
+	memset(&m_header, 0, sizeof(m_header));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+GeomStream::~GeomStream()
+{
+	close();
+}
+
+bool GeomStream::open(const char* path, const size_t maxResidentBytes)
+{
+	close();
+
+	m_fp = fopen(path, "rb");
+	if (!m_fp)
+		return false;
+
+	if (fread(&m_header, sizeof(m_header), 1, m_fp) != 1 ||
+		m_header.magic != GEOMSTREAM_MAGIC || m_header.version != GEOMSTREAM_VERSION ||
+		m_header.width <= 0 || m_header.height <= 0)
+	{
+		close();
+		return false;
+	}
+
+	const int ncells = m_header.width * m_header.height;
+	m_cells = new GeomStreamCellInfo[ncells];
+	if (fseek64(m_fp, m_header.tableOffset, SEEK_SET) != 0 ||
+		fread(m_cells, sizeof(GeomStreamCellInfo), ncells, m_fp) != (size_t)ncells)
+	{
+		close();
+		return false;
+	}
+
+	m_resident = new GeomStreamCell*[ncells];
+	m_lruPrev = new int[ncells];
+	m_lruNext = new int[ncells];
+	memset(m_resident, 0, sizeof(GeomStreamCell*)*ncells);
+	m_lruHead = m_lruTail = -1;
+	m_maxResidentBytes = maxResidentBytes;
+	resetStats();
+
+	return true;
+}
+
+void GeomStream::close()
+{
+	if (m_resident)
+	{
+		for (int i = 0; i < m_header.width*m_header.height; ++i)
+			freeCell(m_resident[i]);
+	}
+	delete [] m_resident;
+	delete [] m_lruPrev;
+	delete [] m_lruNext;
+	delete [] m_cells;
+	m_resident = 0;
+	m_lruPrev = 0;
+	m_lruNext = 0;
+	m_cells = 0;
+	m_lruHead = m_lruTail = -1;
+	if (m_fp)
+		fclose(m_fp);
+	m_fp = 0;
+	memset(&m_header, 0, sizeof(m_header));
+	memset(&m_stats, 0, sizeof(m_stats));
+}
+
+void GeomStream::resetStats()
+{
+	m_stats.hits = 0;
+	m_stats.misses = 0;
+	m_stats.evictions = 0;
+	m_stats.peakResidentBytes = m_stats.residentBytes;
+}
+
+void GeomStream::calcCellRange(const float* bmin, const float* bmax, int& x0, int& y0, int& x1, int& y1) const
+{
+	// Triangles are stored by centroid, so look in the cells they can reach the bounds from.
+	const float cs = m_header.cellSize;
+	const float pad = m_header.overhang;
+	x0 = rcMax(0, (int)floorf((bmin[0] - pad - m_header.bmin[0]) / cs));
+	y0 = rcMax(0, (int)floorf((bmin[2] - pad - m_header.bmin[2]) / cs));
+	x1 = rcMin(m_header.width-1, (int)floorf((bmax[0] + pad - m_header.bmin[0]) / cs));
+	y1 = rcMin(m_header.height-1, (int)floorf((bmax[2] + pad - m_header.bmin[2]) / cs));
+}
+
+int GeomStream::getMaxCellCount(const float* bmin, const float* bmax) const
+{
+	if (!m_cells)
+		return 0;
+	int x0, y0, x1, y1;
+	calcCellRange(bmin, bmax, x0, y0, x1, y1);
+	if (x1 < x0 || y1 < y0)
+		return 0;
+	return (x1 - x0 + 1) * (y1 - y0 + 1);
+}
+
+int GeomStream::queryCells(const float* bmin, const float* bmax, int* cells, const int maxCells) const
+{
+	if (!m_cells)
+		return 0;
+
+	int x0, y0, x1, y1;
+	calcCellRange(bmin, bmax, x0, y0, x1, y1);
+
+	int n = 0;
+	for (int y = y0; y <= y1; ++y)
+	{
+		for (int x = x0; x <= x1; ++x)
+		{
+			const int idx = x + y*m_header.width;
+			const GeomStreamCellInfo& info = m_cells[idx];
+			if (!info.ntris)
+				continue;
+			if (info.bmin[0] > bmax[0] || info.bmax[0] < bmin[0] ||
+				info.bmin[2] > bmax[2] || info.bmax[2] < bmin[2])
+				continue;
+			if (n < maxCells)
+				cells[n++] = idx;
+		}
+	}
+	return n;
+}
+
+void GeomStream::unlinkCell(const int idx)
+{
+	const int prev = m_lruPrev[idx];
+	const int next = m_lruNext[idx];
+	if (prev != -1) m_lruNext[prev] = next; else m_lruHead = next;
+	if (next != -1) m_lruPrev[next] = prev; else m_lruTail = prev;
+}
+
+void GeomStream::linkCellFront(const int idx)
+{
+	m_lruPrev[idx] = -1;
+	m_lruNext[idx] = m_lruHead;
+	if (m_lruHead != -1)
+		m_lruPrev[m_lruHead] = idx;
+	m_lruHead = idx;
+	if (m_lruTail == -1)
+		m_lruTail = idx;
+}
+
+void GeomStream::evictCell(const int idx)
+{
+	GeomStreamCell* cell = m_resident[idx];
+	unlinkCell(idx);
+	m_stats.residentBytes -= cellMemory(cell->nverts, cell->ntris);
+	m_stats.residentCells--;
+	m_stats.evictions++;
+	freeCell(cell);
+	m_resident[idx] = 0;
+}
+
+const GeomStreamCell* GeomStream::getCell(const int idx)
+{
+	if (!m_cells || idx < 0 || idx >= m_header.width*m_header.height)
+		return 0;
+
+	if (m_resident[idx])
+	{
+		m_stats.hits++;
+		unlinkCell(idx);
+		linkCellFront(idx);
+		return m_resident[idx];
+	}
+
+	m_stats.misses++;
+
+	const GeomStreamCellInfo& info = m_cells[idx];
+	const size_t bytes = cellMemory(info.nverts, info.ntris);
+
+	// Make room for the new cell. A cell larger than the whole budget is still loaded.
+	while (m_lruTail != -1 && m_stats.residentBytes + bytes > m_maxResidentBytes)
+		evictCell(m_lruTail);
+
+	GeomStreamCell* cell = new GeomStreamCell;
+	cell->verts = new float[info.nverts*3];
+	cell->tris = new int[info.ntris*3];
+	cell->nverts = info.nverts;
+	cell->ntris = info.ntris;
+	cell->index = idx;
+
+	if (info.ntris)
+	{
+		if (fseek64(m_fp, info.offset, SEEK_SET) != 0 ||
+			fread(cell->verts, sizeof(float)*3, info.nverts, m_fp) != (size_t)info.nverts ||
+			fread(cell->tris, sizeof(int)*3, info.ntris, m_fp) != (size_t)info.ntris)
+		{
+			freeCell(cell);
+			return 0;
+		}
+	}
+
+	m_resident[idx] = cell;
+	linkCellFront(idx);
+	m_stats.residentCells++;
+	m_stats.residentBytes += bytes;
+	m_stats.peakResidentBytes = rcMax(m_stats.peakResidentBytes, m_stats.residentBytes);
+
+	return cell;
+}
+
+void GeomStream::setMaxResidentBytes(const size_t maxResidentBytes)
+{
+	m_maxResidentBytes = maxResidentBytes;
+	while (m_lruTail != -1 && m_stats.residentBytes > m_maxResidentBytes)
+		evictCell(m_lruTail);
+}
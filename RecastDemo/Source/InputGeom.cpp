@@ -24,7 +24,6 @@
 #include <algorithm>
 #include "Recast.h"
 #include "InputGeom.h"
-#include "ChunkyTriMesh.h"
 #include "MeshLoaderObj.h"
 #include "DebugDraw.h"
 #include "RecastDebugDraw.h"
@@ -118,7 +117,7 @@ InputGeom::InputGeom() :
 
 InputGeom::~InputGeom()
 {
-	delete m_chunkyMesh;
+	rcFreeChunkyTriMesh(m_chunkyMesh);
 	delete m_mesh;
 }
 		
@@ -126,7 +125,7 @@ bool InputGeom::loadMesh(rcContext* ctx, const std::string& filepath)
 {
 	if (m_mesh)
 	{
-		delete m_chunkyMesh;
+		rcFreeChunkyTriMesh(m_chunkyMesh);
 		m_chunkyMesh = 0;
 		delete m_mesh;
 		m_mesh = 0;
@@ -148,13 +147,13 @@ bool InputGeom::loadMesh(rcContext* ctx, const std::string& filepath)
 
 	rcCalcBounds(m_mesh->getVerts(), m_mesh->getVertCount(), m_meshBMin, m_meshBMax);
 
-	m_chunkyMesh = new rcChunkyTriMesh;
+	m_chunkyMesh = rcAllocChunkyTriMesh();
 	if (!m_chunkyMesh)
 	{
 		ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Out of memory 'm_chunkyMesh'.");
 		return false;
 	}
-	if (!rcCreateChunkyTriMesh(m_mesh->getVerts(), m_mesh->getTris(), m_mesh->getTriCount(), 256, m_chunkyMesh))
+	if (!rcCreateChunkyTriMesh(ctx, m_mesh->getVerts(), m_mesh->getTris(), m_mesh->getTriCount(), 256, *m_chunkyMesh))
 	{
 		ctx->log(RC_LOG_ERROR, "buildTiledNavigation: Failed to build chunky mesh.");
 		return false;
@@ -428,14 +427,16 @@ bool InputGeom::raycastMesh(float* src, float* dst, float& tmin)
 	float btmin, btmax;
 	if (!isectSegAABB(src, dst, m_meshBMin, m_meshBMax, btmin, btmax))
 		return false;
-	float p[2], q[2];
+	float p[3], q[3];
 	p[0] = src[0] + (dst[0]-src[0])*btmin;
-	p[1] = src[2] + (dst[2]-src[2])*btmin;
+	p[1] = src[1] + (dst[1]-src[1])*btmin;
+	p[2] = src[2] + (dst[2]-src[2])*btmin;
 	q[0] = src[0] + (dst[0]-src[0])*btmax;
-	q[1] = src[2] + (dst[2]-src[2])*btmax;
+	q[1] = src[1] + (dst[1]-src[1])*btmax;
+	q[2] = src[2] + (dst[2]-src[2])*btmax;
 	
 	int cid[512];
-	const int ncid = rcGetChunksOverlappingSegment(m_chunkyMesh, p, q, cid, 512);
+	const int ncid = rcGetChunksOverlappingSegment(*m_chunkyMesh, p, q, cid, 512);
 	if (!ncid)
 		return false;
 	
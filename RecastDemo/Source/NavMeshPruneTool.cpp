@@ -150,7 +150,8 @@ static void floodNavmesh(dtNavMesh* nav, NavmeshFlags* flags, dtPolyRef start, u
 		// The API input has been cheked already, skip checking internal data.
 		const dtMeshTile* tile = 0;
 		const dtPoly* poly = 0;
-		nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+		if (dtStatusFailed(nav->getTileAndPolyByRefUnsafe(ref, &tile, &poly)))
+			continue;
 
 		// Visit linked polygons.
 		for (unsigned int i = poly->firstLink; i != DT_NULL_LINK; i = tile->links[i].next)
@@ -1025,7 +1025,8 @@ static void getPolyCenter(dtNavMesh* navMesh, dtPolyRef ref, float* center)
 		
 	for (int i = 0; i < (int)poly->vertCount; ++i)
 	{
-		const float* v = &tile->verts[poly->verts[i]*3];
+		float tmp[3];
+		const float* v = tile->getVert(poly->verts[i], tmp);
 		center[0] += v[0];
 		center[1] += v[1];
 		center[2] += v[2];
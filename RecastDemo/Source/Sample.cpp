@@ -323,7 +323,7 @@ void Sample::renderOverlayToolStates(double* proj, double* model, int* view)
 }
 
 static const int NAVMESHSET_MAGIC = 'M'<<24 | 'S'<<16 | 'E'<<8 | 'T'; //'MSET';
-static const int NAVMESHSET_VERSION = 1;
+static const int NAVMESHSET_VERSION = 2;
 
 struct NavMeshSetHeader
 {
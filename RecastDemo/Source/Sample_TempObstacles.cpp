@@ -337,7 +337,7 @@ int Sample_TempObstacles::rasterizeTileLayers(
 	tbmax[0] = tcfg.bmax[0];
 	tbmax[1] = tcfg.bmax[2];
 	int cid[512];// TODO: Make grow when returning too many items.
-	const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
+	const int ncid = rcGetChunksOverlappingRect(*chunkyMesh, tbmin, tbmax, cid, 512);
 	if (!ncid)
 	{
 		return 0; // empty
@@ -1281,6 +1281,9 @@ bool Sample_TempObstacles::handleBuild()
 	params.tileHeight = m_tileSize*m_cellSize;
 	params.maxTiles = m_maxTiles;
 	params.maxPolys = m_maxPolysPerTile;
+	params.gridWidth = tw;
+	params.gridHeight = th;
+	params.gridLayers = EXPECTED_LAYERS_PER_TILE;
 	
 	status = m_navMesh->init(&params);
 	if (dtStatusFailed(status))
@@ -1384,7 +1387,7 @@ void Sample_TempObstacles::getTilePos(const float* pos, int& tx, int& ty)
 }
 
 static const int TILECACHESET_MAGIC = 'T'<<24 | 'S'<<16 | 'E'<<8 | 'T'; //'TSET';
-static const int TILECACHESET_VERSION = 1;
+static const int TILECACHESET_VERSION = 2;
 
 struct TileCacheSetHeader
 {
@@ -29,6 +29,7 @@
 #endif
 #include "imgui.h"
 #include "InputGeom.h"
+#include "GeomStream.h"
 #include "Sample.h"
 #include "Sample_TileMesh.h"
 #include "Recast.h"
@@ -178,6 +179,9 @@ public:
 Sample_TileMesh::Sample_TileMesh() :
 	m_keepInterResults(false),
 	m_buildAll(true),
+	m_sharedRasterization(false),
+	m_streamGeometry(false),
+	m_streamBudgetMB(64.0f),
 	m_totalBuildTimeMs(0),
 	m_triareas(0),
 	m_solid(0),
@@ -233,6 +237,14 @@ void Sample_TileMesh::handleSettings()
 
 	if (imguiCheck("Build All Tiles", m_buildAll))
 		m_buildAll = !m_buildAll;
+
+	if (imguiCheck("Shared Tile Rasterization", m_sharedRasterization, !m_streamGeometry))
+		m_sharedRasterization = !m_sharedRasterization;
+
+	if (imguiCheck("Stream Geometry From Disk", m_streamGeometry))
+		m_streamGeometry = !m_streamGeometry;
+	if (m_streamGeometry)
+		imguiSlider("Stream Budget (MB)", &m_streamBudgetMB, 1.0f, 1024.0f, 1.0f);
 	
 	imguiLabel("Tiling");
 	imguiSlider("TileSize", &m_tileSize, 16.0f, 1024.0f, 16.0f);
@@ -604,12 +616,22 @@ bool Sample_TileMesh::handleBuild()
 		return false;
 	}
 
+	const float* bmin = m_geom->getNavMeshBoundsMin();
+	const float* bmax = m_geom->getNavMeshBoundsMax();
+	int gw = 0, gh = 0;
+	rcCalcGridSize(bmin, bmax, m_cellSize, &gw, &gh);
+	const int ts = (int)m_tileSize;
+
 	dtNavMeshParams params;
-	rcVcopy(params.orig, m_geom->getNavMeshBoundsMin());
+	memset(&params, 0, sizeof(params));
+	rcVcopy(params.orig, bmin);
 	params.tileWidth = m_tileSize*m_cellSize;
 	params.tileHeight = m_tileSize*m_cellSize;
 	params.maxTiles = m_maxTiles;
 	params.maxPolys = m_maxPolysPerTile;
+	params.gridWidth = (gw + ts-1) / ts;
+	params.gridHeight = (gh + ts-1) / ts;
+	params.gridLayers = 1;
 	
 	dtStatus status;
 	
@@ -740,6 +762,13 @@ void Sample_TileMesh::buildAllTiles()
 	// Start the build process.
 	m_ctx->startTimer(RC_TIMER_TEMP);
 
+	// With streaming, each tile reads its triangles from disk through a fixed size cache.
+	// The shared store holds the whole world in memory, so it is not used then.
+	GeomStream* stream = m_streamGeometry ? openGeomStream(tcs) : 0;
+
+	// Rasterize the geometry once, so that the tiles do not re-rasterize the borders they share.
+	rcHeightfieldStore* store = m_sharedRasterization && !stream ? rasterizeAllTiles(tw, th) : 0;
+
 	for (int y = 0; y < th; ++y)
 	{
 		for (int x = 0; x < tw; ++x)
@@ -753,7 +782,7 @@ void Sample_TileMesh::buildAllTiles()
 			m_lastBuiltTileBmax[2] = bmin[2] + (y+1)*tcs;
 			
 			int dataSize = 0;
-			unsigned char* data = buildTileMesh(x, y, m_lastBuiltTileBmin, m_lastBuiltTileBmax, dataSize);
+			unsigned char* data = buildTileMesh(x, y, m_lastBuiltTileBmin, m_lastBuiltTileBmax, dataSize, store, stream);
 			if (data)
 			{
 				// Remove any previous data (navmesh owns and deletes the data).
@@ -766,6 +795,16 @@ void Sample_TileMesh::buildAllTiles()
 		}
 	}
 	
+	rcFreeHeightfieldStore(store);
+
+	if (stream)
+	{
+		const GeomStream::Stats& stats = stream->getStats();
+		m_ctx->log(RC_LOG_PROGRESS, "Geometry stream: %d hits, %d misses, %d evictions, peak %.1f MB.",
+				   stats.hits, stats.misses, stats.evictions, stats.peakResidentBytes/(1024.0f*1024.0f));
+		delete stream;
+	}
+
 	// Start the build process.	
 	m_ctx->stopTimer(RC_TIMER_TEMP);
 
@@ -792,7 +831,112 @@ void Sample_TileMesh::removeAllTiles()
 }
 
 
-unsigned char* Sample_TileMesh::buildTileMesh(const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize)
+GeomStream* Sample_TileMesh::openGeomStream(const float tileWorldSize)
+{
+	if (!m_geom || !m_geom->getMesh())
+		return 0;
+
+	// The sample converts the loaded mesh, a real bake would stream a file exported by the world editor.
+	static const char* path = "streamed_geom.bin";
+	const rcMeshLoaderObj* mesh = m_geom->getMesh();
+	if (!writeGeomStream(path, mesh->getVerts(), mesh->getVertCount(), mesh->getTris(), mesh->getTriCount(),
+						 m_geom->getNavMeshBoundsMin(), m_geom->getNavMeshBoundsMax(), tileWorldSize))
+	{
+		m_ctx->log(RC_LOG_ERROR, "openGeomStream: Could not write '%s'.", path);
+		return 0;
+	}
+
+	GeomStream* stream = new GeomStream;
+	if (!stream->open(path, (size_t)(m_streamBudgetMB*1024.0f*1024.0f)))
+	{
+		m_ctx->log(RC_LOG_ERROR, "openGeomStream: Could not open '%s'.", path);
+		delete stream;
+		return 0;
+	}
+	return stream;
+}
+
+bool Sample_TileMesh::rasterizeTileTriangles(const float* verts, const int nverts, const int* tris, const int ntris,
+											 const bool edgesOnly)
+{
+	m_tileTriCount += ntris;
+	
+	memset(m_triareas, 0, ntris*sizeof(unsigned char));
+	rcMarkWalkableTriangles(m_ctx, m_cfg.walkableSlopeAngle,
+							verts, nverts, tris, ntris, m_triareas);
+	
+	if (edgesOnly)
+		return rcRasterizeHeightfieldEdges(m_ctx, verts, nverts, tris, m_triareas, ntris, *m_solid, m_cfg.walkableClimb);
+	return rcRasterizeTriangles(m_ctx, verts, nverts, tris, m_triareas, ntris, *m_solid, m_cfg.walkableClimb);
+}
+
+rcHeightfieldStore* Sample_TileMesh::rasterizeAllTiles(const int tw, const int th)
+{
+	if (!m_geom || !m_geom->getMesh() || !m_geom->getChunkyMesh())
+		return 0;
+
+	const float* verts = m_geom->getMesh()->getVerts();
+	const int nverts = m_geom->getMesh()->getVertCount();
+	const rcChunkyTriMesh* chunkyMesh = m_geom->getChunkyMesh();
+
+	// Use the same settings as buildTileMesh().
+	const float walkableSlopeAngle = m_agentMaxSlope;
+	const int walkableClimb = (int)floorf(m_agentMaxClimb / m_cellHeight);
+	const int borderSize = (int)ceilf(m_agentRadius / m_cellSize) + 3;
+	const int ts = (int)m_tileSize;
+
+	// The store covers every tile together with its border.
+	const float* bmin = m_geom->getNavMeshBoundsMin();
+	const float* bmax = m_geom->getNavMeshBoundsMax();
+	const int width = tw*ts + borderSize*2;
+	const int height = th*ts + borderSize*2;
+	float sbmin[3], sbmax[3];
+	rcVcopy(sbmin, bmin);
+	rcVcopy(sbmax, bmax);
+	sbmin[0] -= borderSize*m_cellSize;
+	sbmin[2] -= borderSize*m_cellSize;
+	sbmax[0] = sbmin[0] + width*m_cellSize;
+	sbmax[2] = sbmin[2] + height*m_cellSize;
+
+	rcHeightfieldStore* store = rcAllocHeightfieldStore();
+	if (!store)
+	{
+		m_ctx->log(RC_LOG_ERROR, "rasterizeAllTiles: Out of memory 'store'.");
+		return 0;
+	}
+	if (!rcCreateHeightfieldStore(m_ctx, *store, width, height, ts, sbmin, sbmax, m_cellSize, m_cellHeight))
+	{
+		m_ctx->log(RC_LOG_ERROR, "rasterizeAllTiles: Could not create heightfield store.");
+		rcFreeHeightfieldStore(store);
+		return 0;
+	}
+
+	// Rasterize in chunk order, which is the order the tiles would see the triangles in.
+	unsigned char* triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
+	for (int i = 0; i < chunkyMesh->nnodes; ++i)
+	{
+		const rcChunkyTriMeshNode& node = chunkyMesh->nodes[i];
+		if (node.i < 0)
+			continue;
+		const int* ctris = &chunkyMesh->tris[node.i*3];
+		const int nctris = node.n;
+
+		memset(triareas, 0, nctris*sizeof(unsigned char));
+		rcMarkWalkableTriangles(m_ctx, walkableSlopeAngle, verts, nverts, ctris, nctris, triareas);
+		if (!rcRasterizeTrianglesToStore(m_ctx, verts, nverts, ctris, triareas, nctris, *store, walkableClimb))
+		{
+			delete [] triareas;
+			rcFreeHeightfieldStore(store);
+			return 0;
+		}
+	}
+	delete [] triareas;
+
+	return store;
+}
+
+unsigned char* Sample_TileMesh::buildTileMesh(const int tx, const int ty, const float* bmin, const float* bmax, int& dataSize,
+											  const rcHeightfieldStore* store, GeomStream* stream)
 {
 	if (!m_geom || !m_geom->getMesh() || !m_geom->getChunkyMesh())
 	{
@@ -884,39 +1028,64 @@ unsigned char* Sample_TileMesh::buildTileMesh(const int tx, const int ty, const
 	// Allocate array that can hold triangle flags.
 	// If you have multiple meshes you need to process, allocate
 	// and array which can hold the max number of triangles you need to process.
-	m_triareas = new unsigned char[chunkyMesh->maxTrisPerChunk];
+	const int maxTris = stream ? stream->getHeader().maxTrisPerCell : chunkyMesh->maxTrisPerChunk;
+	m_triareas = new unsigned char[maxTris];
 	if (!m_triareas)
 	{
-		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'm_triareas' (%d).", chunkyMesh->maxTrisPerChunk);
+		m_ctx->log(RC_LOG_ERROR, "buildNavigation: Out of memory 'm_triareas' (%d).", maxTris);
 		return 0;
 	}
 	
-	float tbmin[2], tbmax[2];
-	tbmin[0] = m_cfg.bmin[0];
-	tbmin[1] = m_cfg.bmin[2];
-	tbmax[0] = m_cfg.bmax[0];
-	tbmax[1] = m_cfg.bmax[2];
-	int cid[512];// TODO: Make grow when returning too many items.
-	const int ncid = rcGetChunksOverlappingRect(chunkyMesh, tbmin, tbmax, cid, 512);
-	if (!ncid)
-		return 0;
-	
 	m_tileTriCount = 0;
 	
-	for (int i = 0; i < ncid; ++i)
+	if (stream)
 	{
-		const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
-		const int* ctris = &chunkyMesh->tris[node.i*3];
-		const int nctris = node.n;
-		
-		m_tileTriCount += nctris;
+		// Pull the triangles of the cells around the tile from disk.
+		const int maxCells = stream->getMaxCellCount(m_cfg.bmin, m_cfg.bmax);
+		if (!maxCells)
+			return 0;
+		int* cells = new int[maxCells];
+		const int ncells = stream->queryCells(m_cfg.bmin, m_cfg.bmax, cells, maxCells);
 		
-		memset(m_triareas, 0, nctris*sizeof(unsigned char));
-		rcMarkWalkableTriangles(m_ctx, m_cfg.walkableSlopeAngle,
-								verts, nverts, ctris, nctris, m_triareas);
+		bool ok = ncells > 0;
+		for (int i = 0; i < ncells && ok; ++i)
+		{
+			const GeomStreamCell* cell = stream->getCell(cells[i]);
+			if (!cell)
+			{
+				m_ctx->log(RC_LOG_ERROR, "buildNavigation: Could not read geometry cell %d.", cells[i]);
+				ok = false;
+				break;
+			}
+			ok = rasterizeTileTriangles(cell->verts, cell->nverts, cell->tris, cell->ntris, false);
+		}
+		delete [] cells;
+		if (!ok)
+			return 0;
+	}
+	else
+	{
+		float tbmin[2], tbmax[2];
+		tbmin[0] = m_cfg.bmin[0];
+		tbmin[1] = m_cfg.bmin[2];
+		tbmax[0] = m_cfg.bmax[0];
+		tbmax[1] = m_cfg.bmax[2];
+		int cid[512];// TODO: Make grow when returning too many items.
+		const int ncid = rcGetChunksOverlappingRect(*chunkyMesh, tbmin, tbmax, cid, 512);
+		if (!ncid)
+			return 0;
 		
-		if (!rcRasterizeTriangles(m_ctx, verts, nverts, ctris, m_triareas, nctris, *m_solid, m_cfg.walkableClimb))
+		// With a shared store, the inside of the tile is already rasterized and only
+		// the outermost cells, where geometry outside the tile gets clamped, are left to do.
+		if (store && !rcCopyHeightfieldFromStore(m_ctx, *store, tx*m_cfg.tileSize, ty*m_cfg.tileSize, *m_solid))
 			return 0;
+		
+		for (int i = 0; i < ncid; ++i)
+		{
+			const rcChunkyTriMeshNode& node = chunkyMesh->nodes[cid[i]];
+			if (!rasterizeTileTriangles(verts, nverts, &chunkyMesh->tris[node.i*3], node.n, store != 0))
+				return 0;
+		}
 	}
 	
 	if (!m_keepInterResults)
@@ -1,6 +1,22 @@
+#include <string.h>
+#include <math.h>
+
 #include "catch.hpp"
 
 #include "DetourCommon.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourNavMeshLandmarks.h"
+#include "DetourNavMeshIslands.h"
+#include "DetourNavMeshFlowField.h"
+#include "DetourQueryStats.h"
+#include "DetourPathCache.h"
+#include "DetourNode.h"
+#include "DetourAlloc.h"
+#include "DetourStatus.h"
+#include "DetourTileStreamer.h"
+#include "DetourTileCompressor.h"
 
 TEST_CASE("dtRandomPointInConvexPoly")
 {
@@ -31,3 +47,2992 @@ TEST_CASE("dtRandomPointInConvexPoly")
 		REQUIRE(out[2] == Approx(0));
 	}
 }
+
+static const int TILE_CELLS = 60;
+static const float TILE_CS = 0.5f;
+static const float TILE_SIZE = TILE_CELLS*TILE_CS;
+
+// Builds a tile made of n*n square polygons, with portals on all four sides.
+static unsigned char* createGridTile(const int tx, const int ty, const int n, int& dataSize, const bool wideBvTree = false)
+{
+	const int nverts = (n+1)*(n+1);
+	const int npolys = n*n;
+	const int nvp = 4;
+	unsigned short* verts = new unsigned short[nverts*3];
+	unsigned short* polys = new unsigned short[npolys*nvp*2];
+	unsigned short* flags = new unsigned short[npolys];
+	unsigned char* areas = new unsigned char[npolys];
+
+	for (int z = 0; z <= n; ++z)
+	{
+		for (int x = 0; x <= n; ++x)
+		{
+			unsigned short* v = &verts[(x + z*(n+1))*3];
+			v[0] = (unsigned short)(x*TILE_CELLS/n);
+			v[1] = 0;
+			v[2] = (unsigned short)(z*TILE_CELLS/n);
+		}
+	}
+	for (int z = 0; z < n; ++z)
+	{
+		for (int x = 0; x < n; ++x)
+		{
+			const int i = x + z*n;
+			unsigned short* p = &polys[i*nvp*2];
+			// Same winding as the polygons from rcBuildPolyMesh.
+			p[0] = (unsigned short)(x + z*(n+1));
+			p[1] = (unsigned short)(x + (z+1)*(n+1));
+			p[2] = (unsigned short)(x+1 + (z+1)*(n+1));
+			p[3] = (unsigned short)(x+1 + z*(n+1));
+			// Neighbours, or portal flags (0x8000 | dir) on the tile border.
+			p[4] = x > 0 ? (unsigned short)(i-1) : 0x8000 | 0;
+			p[5] = z < n-1 ? (unsigned short)(i+n) : 0x8000 | 1;
+			p[6] = x < n-1 ? (unsigned short)(i+1) : 0x8000 | 2;
+			p[7] = z > 0 ? (unsigned short)(i-n) : 0x8000 | 3;
+			flags[i] = 1;
+			areas[i] = 0;
+		}
+	}
+
+	dtNavMeshCreateParams params;
+	memset(&params, 0, sizeof(params));
+	params.verts = verts;
+	params.vertCount = nverts;
+	params.polys = polys;
+	params.polyFlags = flags;
+	params.polyAreas = areas;
+	params.polyCount = npolys;
+	params.nvp = nvp;
+	params.tileX = tx;
+	params.tileY = ty;
+	params.bmin[0] = tx*TILE_SIZE;
+	params.bmin[1] = 0;
+	params.bmin[2] = ty*TILE_SIZE;
+	params.bmax[0] = (tx+1)*TILE_SIZE;
+	params.bmax[1] = 1;
+	params.bmax[2] = (ty+1)*TILE_SIZE;
+	params.walkableHeight = 2;
+	params.walkableRadius = 0.5f;
+	params.walkableClimb = 0.5f;
+	params.cs = TILE_CS;
+	params.ch = TILE_CS;
+	params.buildBvTree = true;
+	params.wideBvTree = wideBvTree;
+
+	unsigned char* data = 0;
+	dataSize = 0;
+	dtCreateNavMeshData(&params, &data, &dataSize);
+
+	delete [] verts;
+	delete [] polys;
+	delete [] flags;
+	delete [] areas;
+	return data;
+}
+
+// Neighbouring tiles have a different number of polygons per side, so that their portals do not line up.
+static int gridTilePolysPerSide(const int tx, const int ty)
+{
+	return 3 + (tx*2 + ty) % 3;
+}
+
+// Returns the number of links from all polygons of a tile to polygons of the other tile.
+static int countLinksTo(const dtNavMesh& mesh, const dtMeshTile* tile, const dtMeshTile* other)
+{
+	const unsigned int otherIndex = mesh.decodePolyIdTile(mesh.getTileRef(other));
+	int count = 0;
+	for (int i = 0; i < tile->header->polyCount; ++i)
+	{
+		for (unsigned int j = tile->polys[i].firstLink; j != DT_NULL_LINK; j = tile->links[j].next)
+		{
+			if (mesh.decodePolyIdTile(tile->links[j].ref) == otherIndex)
+				count++;
+		}
+	}
+	return count;
+}
+
+// Returns the number of portal segments the two sides of a shared border are split into.
+static int expectedPortalCount(const int n, const int m)
+{
+	int count = 0;
+	for (int i = 0; i < n; ++i)
+	{
+		for (int j = 0; j < m; ++j)
+		{
+			const int lo = dtMax(i*TILE_CELLS/n, j*TILE_CELLS/m);
+			const int hi = dtMin((i+1)*TILE_CELLS/n, (j+1)*TILE_CELLS/m);
+			if (hi > lo)
+				count++;
+		}
+	}
+	return count;
+}
+
+TEST_CASE("dtNavMesh::addTile")
+{
+	const int gridSize = 4;
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = TILE_SIZE;
+	params.tileHeight = TILE_SIZE;
+	params.maxTiles = gridSize*gridSize;
+	params.maxPolys = 64;
+
+	dtNavMesh* mesh = dtAllocNavMesh();
+	REQUIRE(mesh);
+	REQUIRE(dtStatusSucceed(mesh->init(&params)));
+
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+			REQUIRE(data);
+			REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+	}
+
+	SECTION("Every overlapping portal is linked both ways")
+	{
+		for (int y = 0; y < gridSize; ++y)
+		{
+			for (int x = 0; x < gridSize; ++x)
+			{
+				const dtMeshTile* tile = mesh->getTileAt(x, y, 0);
+				REQUIRE(tile);
+				const int n = gridTilePolysPerSide(x, y);
+				if (x+1 < gridSize)
+				{
+					const dtMeshTile* nei = mesh->getTileAt(x+1, y, 0);
+					const int expected = expectedPortalCount(n, gridTilePolysPerSide(x+1, y));
+					REQUIRE(countLinksTo(*mesh, tile, nei) == expected);
+					REQUIRE(countLinksTo(*mesh, nei, tile) == expected);
+				}
+				if (y+1 < gridSize)
+				{
+					const dtMeshTile* nei = mesh->getTileAt(x, y+1, 0);
+					const int expected = expectedPortalCount(n, gridTilePolysPerSide(x, y+1));
+					REQUIRE(countLinksTo(*mesh, tile, nei) == expected);
+					REQUIRE(countLinksTo(*mesh, nei, tile) == expected);
+				}
+			}
+		}
+	}
+
+	SECTION("Removing and adding a tile restores its links")
+	{
+		const dtMeshTile* left = mesh->getTileAt(0, 1, 0);
+		const dtMeshTile* tile = mesh->getTileAt(1, 1, 0);
+		const int linksBefore = countLinksTo(*mesh, left, tile);
+		REQUIRE(linksBefore > 0);
+
+		unsigned char* data = 0;
+		int dataSize = 0;
+		const dtTileRef ref = mesh->getTileRef(tile);
+		REQUIRE(dtStatusSucceed(mesh->removeTile(ref, &data, &dataSize)));
+		for (int i = 0; i < left->header->polyCount; ++i)
+		{
+			for (unsigned int j = left->polys[i].firstLink; j != DT_NULL_LINK; j = left->links[j].next)
+				REQUIRE(mesh->decodePolyIdTile(left->links[j].ref) != mesh->decodePolyIdTile(ref));
+		}
+
+		// The data is owned by the mesh, so it was freed on removal.
+		REQUIRE(data == 0);
+		data = createGridTile(1, 1, gridTilePolysPerSide(1, 1), dataSize);
+		dtTileRef newRef = 0;
+		REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, ref, &newRef)));
+		REQUIRE(newRef == ref);
+		REQUIRE(countLinksTo(*mesh, left, mesh->getTileAt(1, 1, 0)) == linksBefore);
+	}
+
+	dtFreeNavMesh(mesh);
+}
+
+// Runs the items one at a time in reverse order, to check that the result does not depend on the scheduling.
+class ReverseTaskRunner : public dtTaskRunner
+{
+public:
+	int calls;
+	ReverseTaskRunner() : calls(0) {}
+	virtual void parallelFor(const int count, dtParallelForFunc func, void* userData)
+	{
+		calls++;
+		for (int i = count-1; i >= 0; --i)
+			func(userData, i, i+1);
+	}
+};
+
+// Returns the links of a polygon as (ref, edge, side, bmin, bmax) tuples, sorted.
+static int getSortedLinks(const dtMeshTile* tile, const int poly, unsigned long long* links, const int maxLinks)
+{
+	int n = 0;
+	for (unsigned int j = tile->polys[poly].firstLink; j != DT_NULL_LINK && n < maxLinks; j = tile->links[j].next)
+	{
+		const dtLink& link = tile->links[j];
+		links[n++] = ((unsigned long long)link.ref << 32) | ((unsigned long long)link.edge << 24) |
+			((unsigned long long)link.side << 16) | ((unsigned long long)link.bmin << 8) | link.bmax;
+	}
+	for (int i = 1; i < n; ++i)
+	{
+		for (int j = i; j > 0 && links[j-1] > links[j]; --j)
+			dtSwap(links[j-1], links[j]);
+	}
+	return n;
+}
+
+TEST_CASE("dtNavMesh::addTiles")
+{
+	const int gridSize = 5;
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = TILE_SIZE;
+	params.tileHeight = TILE_SIZE;
+	params.maxTiles = gridSize*gridSize;
+	params.maxPolys = 64;
+
+	// Reference mesh, built one tile at a time.
+	dtNavMesh* serial = dtAllocNavMesh();
+	REQUIRE(dtStatusSucceed(serial->init(&params)));
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+			REQUIRE(dtStatusSucceed(serial->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+	}
+
+	dtNavMesh* batched = dtAllocNavMesh();
+	REQUIRE(dtStatusSucceed(batched->init(&params)));
+
+	// The first row is added one by one, the rest in a batch next to it.
+	unsigned char* data[gridSize*gridSize];
+	int dataSizes[gridSize*gridSize];
+	int count = 0;
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* tileData = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+			if (y == 0)
+			{
+				REQUIRE(dtStatusSucceed(batched->addTile(tileData, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+			}
+			else
+			{
+				data[count] = tileData;
+				dataSizes[count] = dataSize;
+				count++;
+			}
+		}
+	}
+
+	SECTION("The links are the same as when adding the tiles one by one")
+	{
+		ReverseTaskRunner runner;
+		dtTileRef refs[gridSize*gridSize];
+		REQUIRE(dtStatusSucceed(batched->addTiles(data, dataSizes, count, DT_TILE_FREE_DATA, refs, &runner)));
+		REQUIRE(runner.calls > 1);
+
+		for (int i = 0; i < count; ++i)
+			REQUIRE(batched->getTileByRef(refs[i]) != 0);
+
+		const dtNavMesh* a = serial;
+		const dtNavMesh* b = batched;
+		for (int i = 0; i < a->getMaxTiles(); ++i)
+		{
+			const dtMeshTile* ta = a->getTile(i);
+			const dtMeshTile* tb = b->getTile(i);
+			REQUIRE((ta->header == 0) == (tb->header == 0));
+			if (!ta->header)
+				continue;
+			REQUIRE(ta->header->x == tb->header->x);
+			REQUIRE(ta->header->y == tb->header->y);
+			for (int j = 0; j < ta->header->polyCount; ++j)
+			{
+				static const int MAX_LINKS = 16;
+				unsigned long long la[MAX_LINKS], lb[MAX_LINKS];
+				const int na = getSortedLinks(ta, j, la, MAX_LINKS);
+				const int nb = getSortedLinks(tb, j, lb, MAX_LINKS);
+				REQUIRE(na == nb);
+				for (int k = 0; k < na; ++k)
+					REQUIRE(la[k] == lb[k]);
+			}
+		}
+	}
+
+	SECTION("A failed batch adds nothing")
+	{
+		// Make the last tile overlap one of the tiles already in the mesh.
+		dtMeshHeader* header = (dtMeshHeader*)data[count-1];
+		header->x = 0;
+		header->y = 0;
+		REQUIRE(dtStatusFailed(batched->addTiles(data, dataSizes, count, DT_TILE_FREE_DATA, 0)));
+		for (int y = 1; y < gridSize; ++y)
+		{
+			for (int x = 0; x < gridSize; ++x)
+				REQUIRE(batched->getTileAt(x, y, 0) == 0);
+		}
+		// The data still belongs to the caller.
+		for (int i = 0; i < count; ++i)
+			dtFree(data[i]);
+	}
+
+	dtFreeNavMesh(serial);
+	dtFreeNavMesh(batched);
+}
+
+TEST_CASE("dtNavMesh tile grid lookup")
+{
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = TILE_SIZE;
+	params.tileHeight = TILE_SIZE;
+	params.maxTiles = 64;
+	params.maxPolys = 64;
+
+	// Reference mesh, which finds all tiles by hash.
+	dtNavMesh* hashed = dtAllocNavMesh();
+	REQUIRE(dtStatusSucceed(hashed->init(&params)));
+
+	// A 3x3 grid with two layers; the tiles around it and on the third layer go to the hash.
+	params.gridWidth = 3;
+	params.gridHeight = 3;
+	params.gridLayers = 2;
+	dtNavMesh* gridded = dtAllocNavMesh();
+	REQUIRE(dtStatusSucceed(gridded->init(&params)));
+
+	dtNavMesh* meshes[2] = { hashed, gridded };
+	for (int m = 0; m < 2; ++m)
+	{
+		for (int y = -1; y <= 3; ++y)
+		{
+			for (int x = -1; x <= 3; ++x)
+			{
+				for (int layer = 0; layer < 3; ++layer)
+				{
+					// Stack layers only on some tiles.
+					if (layer > 0 && (x+y+layer) % 2)
+						continue;
+					int dataSize = 0;
+					unsigned char* data = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+					REQUIRE(data);
+					((dtMeshHeader*)data)->layer = layer;
+					REQUIRE(dtStatusSucceed(meshes[m]->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+				}
+			}
+		}
+	}
+
+	SECTION("Finds the same tiles and links as the hash")
+	{
+		for (int y = -2; y <= 4; ++y)
+		{
+			for (int x = -2; x <= 4; ++x)
+			{
+				for (int layer = 0; layer < 4; ++layer)
+				{
+					const dtMeshTile* ta = hashed->getTileAt(x, y, layer);
+					const dtMeshTile* tb = gridded->getTileAt(x, y, layer);
+					REQUIRE((ta == 0) == (tb == 0));
+					if (!ta)
+						continue;
+					REQUIRE(hashed->getTileRef(ta) == gridded->getTileRef(tb));
+					REQUIRE(gridded->getTileRefAt(x, y, layer) == gridded->getTileRef(tb));
+					REQUIRE(tb->header->layer == layer);
+				}
+
+				static const int MAX_TILES = 8;
+				const dtMeshTile* tilesA[MAX_TILES];
+				const dtMeshTile* tilesB[MAX_TILES];
+				const int na = hashed->getTilesAt(x, y, tilesA, MAX_TILES);
+				const int nb = gridded->getTilesAt(x, y, tilesB, MAX_TILES);
+				REQUIRE(na == nb);
+				for (int i = 0; i < nb; ++i)
+					REQUIRE(gridded->getTileAt(x, y, tilesB[i]->header->layer) == tilesB[i]);
+			}
+		}
+
+		for (int i = 0; i < hashed->getMaxTiles(); ++i)
+		{
+			const dtMeshTile* ta = ((const dtNavMesh*)hashed)->getTile(i);
+			const dtMeshTile* tb = ((const dtNavMesh*)gridded)->getTile(i);
+			REQUIRE((ta->header == 0) == (tb->header == 0));
+			if (!ta->header)
+				continue;
+			for (int j = 0; j < ta->header->polyCount; ++j)
+			{
+				static const int MAX_LINKS = 16;
+				unsigned long long la[MAX_LINKS], lb[MAX_LINKS];
+				const int na = getSortedLinks(ta, j, la, MAX_LINKS);
+				const int nb = getSortedLinks(tb, j, lb, MAX_LINKS);
+				REQUIRE(na == nb);
+				for (int k = 0; k < na; ++k)
+					REQUIRE(la[k] == lb[k]);
+			}
+		}
+	}
+
+	SECTION("Removed tiles are no longer found")
+	{
+		// Inside the grid, outside the grid, and on a layer above the grid.
+		const int removed[3][3] = { { 1, 1, 0 }, { -1, 2, 0 }, { 0, 0, 2 } };
+		for (int i = 0; i < 3; ++i)
+		{
+			const int* r = removed[i];
+			const dtTileRef ref = gridded->getTileRefAt(r[0], r[1], r[2]);
+			REQUIRE(ref != 0);
+			REQUIRE(dtStatusSucceed(gridded->removeTile(ref, 0, 0)));
+			REQUIRE(gridded->getTileAt(r[0], r[1], r[2]) == 0);
+			REQUIRE(gridded->getTileRefAt(r[0], r[1], r[2]) == 0);
+
+			static const int MAX_TILES = 8;
+			const dtMeshTile* tiles[MAX_TILES];
+			const int n = gridded->getTilesAt(r[0], r[1], tiles, MAX_TILES);
+			REQUIRE(n == hashed->getTilesAt(r[0], r[1], tiles, MAX_TILES) - 1);
+		}
+		// The other layers at the same location are still there.
+		REQUIRE(gridded->getTileAt(0, 0, 0) != 0);
+	}
+
+	dtFreeNavMesh(hashed);
+	dtFreeNavMesh(gridded);
+}
+
+// Loads grid tiles in a 5x5 world, finishing each load after a number of polls.
+class DelayedStreamSource : public dtTileStreamSource
+{
+public:
+	int delay;
+	int loads;
+	int waits;
+	DelayedStreamSource(const int d) : delay(d), loads(0), waits(0) {}
+	virtual dtStatus beginLoad(dtTileStreamLoad* load)
+	{
+		loads++;
+		if (load->x >= 0 && load->y >= 0 && load->x < 5 && load->y < 5)
+		{
+			load->data[0] = createGridTile(load->x, load->y, gridTilePolysPerSide(load->x, load->y), load->dataSize[0]);
+			load->ntiles = 1;
+		}
+		load->status = DT_SUCCESS;
+		load->userData = (void*)(size_t)delay;
+		return DT_SUCCESS;
+	}
+	virtual bool isLoadDone(dtTileStreamLoad* load)
+	{
+		size_t polls = (size_t)load->userData;
+		if (polls == 0)
+			return true;
+		load->userData = (void*)(polls-1);
+		return false;
+	}
+	virtual void waitLoad(dtTileStreamLoad* load)
+	{
+		waits++;
+		load->userData = 0;
+	}
+};
+
+static int countStreamedTiles(const dtNavMesh* mesh)
+{
+	int n = 0;
+	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	{
+		if (mesh->getTile(i)->header)
+			n++;
+	}
+	return n;
+}
+
+TEST_CASE("dtTileStreamer")
+{
+	dtNavMeshParams navParams;
+	memset(&navParams, 0, sizeof(navParams));
+	navParams.tileWidth = TILE_SIZE;
+	navParams.tileHeight = TILE_SIZE;
+	navParams.maxTiles = 32;
+	navParams.maxPolys = 64;
+	dtNavMesh* mesh = dtAllocNavMesh();
+	REQUIRE(dtStatusSucceed(mesh->init(&navParams)));
+
+	dtTileStreamParams params;
+	memset(&params, 0, sizeof(params));
+	params.maxEntries = 64;
+	params.maxLoads = 4;
+	params.maxInterestPoints = 2;
+	params.unloadMargin = TILE_SIZE*0.25f;
+
+	// The centre of tile (2, 2), with a radius reaching the 3x3 tiles around it.
+	const float pos[3] = { TILE_SIZE*2.5f, 0, TILE_SIZE*2.5f };
+	const float radius = TILE_SIZE;
+
+	SECTION("Loads the tiles within the radius, and unloads them when out of range")
+	{
+		DelayedStreamSource source(1);
+		params.maxCommitsPerUpdate = 2;
+		dtTileStreamer streamer;
+		REQUIRE(dtStatusSucceed(streamer.init(&params, mesh, &source)));
+		REQUIRE(dtStatusSucceed(streamer.setInterestPoints(pos, &radius, 1)));
+
+		bool upToDate = false;
+		int updates = 0;
+		int prevResident = 0;
+		while (!upToDate && updates < 100)
+		{
+			REQUIRE(dtStatusSucceed(streamer.update(&upToDate)));
+			updates++;
+			const dtTileStreamStats& stats = streamer.getStats();
+			REQUIRE(stats.residentTiles - prevResident <= params.maxCommitsPerUpdate);
+			REQUIRE(stats.pendingLoads <= params.maxLoads);
+			prevResident = stats.residentTiles;
+		}
+		REQUIRE(upToDate);
+
+		const dtTileStreamStats& stats = streamer.getStats();
+		REQUIRE(stats.residentTiles == 9);
+		REQUIRE(stats.completedLoads == 9);
+		REQUIRE(source.loads == 9);
+		REQUIRE(stats.residentBytes > 0);
+		REQUIRE(countStreamedTiles(mesh) == 9);
+		for (int y = 1; y <= 3; ++y)
+		{
+			for (int x = 1; x <= 3; ++x)
+				REQUIRE(mesh->getTileAt(x, y, 0) != 0);
+		}
+		// The tiles are linked to each other.
+		REQUIRE(countLinksTo(*mesh, mesh->getTileAt(2, 2, 0), mesh->getTileAt(1, 2, 0)) > 0);
+
+		// Moving within the margin keeps the tiles.
+		const float near[3] = { pos[0] + TILE_SIZE*0.2f, 0, pos[2] };
+		streamer.setInterestPoints(near, &radius, 1);
+		REQUIRE(dtStatusSucceed(streamer.update(0)));
+		REQUIRE(mesh->getTileAt(1, 2, 0) != 0);
+
+		// Without interest points everything is unloaded, a few tiles per update.
+		streamer.setInterestPoints(0, 0, 0);
+		REQUIRE(dtStatusSucceed(streamer.update(&upToDate)));
+		REQUIRE(!upToDate);
+		REQUIRE(streamer.getStats().residentTiles == 7);
+		for (int i = 0; i < 4; ++i)
+			streamer.update(&upToDate);
+		REQUIRE(upToDate);
+		REQUIRE(streamer.getStats().residentTiles == 0);
+		REQUIRE(streamer.getStats().evictedTiles == 9);
+		REQUIRE(streamer.getStats().deferredUpdates > 0);
+		REQUIRE(countStreamedTiles(mesh) == 0);
+	}
+
+	SECTION("Loads that are no longer needed are cancelled")
+	{
+		DelayedStreamSource source(3);
+		dtTileStreamer streamer;
+		REQUIRE(dtStatusSucceed(streamer.init(&params, mesh, &source)));
+		REQUIRE(dtStatusSucceed(streamer.setInterestPoints(pos, &radius, 1)));
+		REQUIRE(dtStatusSucceed(streamer.update(0)));
+		REQUIRE(streamer.getStats().pendingLoads == params.maxLoads);
+
+		// Move away before the loads finish.
+		const float far[3] = { TILE_SIZE*20, 0, TILE_SIZE*20 };
+		streamer.setInterestPoints(far, &radius, 1);
+		for (int i = 0; i < 8; ++i)
+			streamer.update(0);
+		REQUIRE(streamer.getStats().cancelledLoads == params.maxLoads);
+		// The locations around the new point have no tiles.
+		REQUIRE(streamer.getStats().residentBytes == 0);
+		REQUIRE(streamer.getStats().residentTiles == 0);
+		REQUIRE(countStreamedTiles(mesh) == 0);
+	}
+
+	SECTION("Stays within the memory budget, keeping the nearest tiles")
+	{
+		DelayedStreamSource source(0);
+		int dataSize = 0;
+		unsigned char* data = createGridTile(2, 2, gridTilePolysPerSide(2, 2), dataSize);
+		dtFree(data);
+		params.maxResidentBytes = (size_t)dataSize*3;
+
+		dtTileStreamer streamer;
+		REQUIRE(dtStatusSucceed(streamer.init(&params, mesh, &source)));
+		REQUIRE(dtStatusSucceed(streamer.setInterestPoints(pos, &radius, 1)));
+		for (int i = 0; i < 10; ++i)
+		{
+			REQUIRE(dtStatusSucceed(streamer.update(0)));
+			REQUIRE(streamer.getStats().residentBytes <= params.maxResidentBytes);
+		}
+		REQUIRE(streamer.getStats().residentTiles > 0);
+		REQUIRE(streamer.getStats().peakResidentBytes <= params.maxResidentBytes);
+		REQUIRE(mesh->getTileAt(2, 2, 0) != 0);
+
+		streamer.unloadAll();
+		REQUIRE(countStreamedTiles(mesh) == 0);
+	}
+
+	SECTION("Waits for the loads in flight when unloading everything")
+	{
+		DelayedStreamSource source(1000);
+		dtTileStreamer* streamer = dtAllocTileStreamer();
+		REQUIRE(dtStatusSucceed(streamer->init(&params, mesh, &source)));
+		REQUIRE(dtStatusSucceed(streamer->setInterestPoints(pos, &radius, 1)));
+		REQUIRE(dtStatusSucceed(streamer->update(0)));
+		REQUIRE(streamer->getStats().pendingLoads == params.maxLoads);
+
+		streamer->unloadAll();
+		REQUIRE(source.waits == params.maxLoads);
+		REQUIRE(streamer->getStats().pendingLoads == 0);
+		REQUIRE(countStreamedTiles(mesh) == 0);
+
+		// Loads in flight are waited for when the streamer is freed, too.
+		REQUIRE(dtStatusSucceed(streamer->update(0)));
+		REQUIRE(streamer->getStats().pendingLoads == params.maxLoads);
+		dtFreeTileStreamer(streamer);
+		REQUIRE(source.waits == params.maxLoads*2);
+	}
+
+	dtFreeNavMesh(mesh);
+}
+
+// A single quad tile with a raised detail vertex in the middle and an off-mesh connection across it.
+static unsigned char* createDetailTile(const bool quantize, int& dataSize)
+{
+	const unsigned short verts[4*3] = { 0,0,0, 0,0,TILE_CELLS, TILE_CELLS,0,TILE_CELLS, TILE_CELLS,0,0 };
+	const unsigned short polys[4*2] = { 0,1,2,3, 0x800f,0x800f,0x800f,0x800f };
+	const unsigned short flags = 1;
+	const unsigned char area = 0;
+	const unsigned int detailMeshes[4] = { 0, 5, 0, 4 };
+	const float detailVerts[5*3] = {
+		0,0,0, 0,0,TILE_SIZE, TILE_SIZE,0,TILE_SIZE, TILE_SIZE,0,0, TILE_SIZE*0.5f,0.75f,TILE_SIZE*0.5f };
+	const unsigned char detailTris[4*4] = { 0,1,4,0x01, 1,2,4,0x01, 2,3,4,0x01, 3,0,4,0x01 };
+	const float offMeshVerts[6] = { 2,0,2, TILE_SIZE-2,0,TILE_SIZE-2 };
+	const float offMeshRad = 1.0f;
+	const unsigned short offMeshFlags = 1;
+	const unsigned char offMeshArea = 0;
+	const unsigned char offMeshDir = 1;
+
+	dtNavMeshCreateParams params;
+	memset(&params, 0, sizeof(params));
+	params.verts = verts;
+	params.vertCount = 4;
+	params.polys = polys;
+	params.polyFlags = &flags;
+	params.polyAreas = &area;
+	params.polyCount = 1;
+	params.nvp = 4;
+	params.detailMeshes = detailMeshes;
+	params.detailVerts = detailVerts;
+	params.detailVertsCount = 5;
+	params.detailTris = detailTris;
+	params.detailTriCount = 4;
+	params.offMeshConVerts = offMeshVerts;
+	params.offMeshConRad = &offMeshRad;
+	params.offMeshConFlags = &offMeshFlags;
+	params.offMeshConAreas = &offMeshArea;
+	params.offMeshConDir = &offMeshDir;
+	params.offMeshConCount = 1;
+	params.bmin[0] = 0;
+	params.bmin[1] = 0;
+	params.bmin[2] = 0;
+	params.bmax[0] = TILE_SIZE;
+	params.bmax[1] = 1;
+	params.bmax[2] = TILE_SIZE;
+	params.walkableHeight = 2;
+	params.walkableRadius = 0.5f;
+	params.walkableClimb = 0.5f;
+	params.cs = TILE_CS;
+	params.ch = TILE_CS;
+	params.buildBvTree = true;
+	params.quantizeVerts = quantize;
+
+	unsigned char* data = 0;
+	dataSize = 0;
+	dtCreateNavMeshData(&params, &data, &dataSize);
+	return data;
+}
+
+TEST_CASE("dtCreateNavMeshData quantized vertices")
+{
+	dtNavMeshParams navParams;
+	memset(&navParams, 0, sizeof(navParams));
+	navParams.tileWidth = TILE_SIZE;
+	navParams.tileHeight = TILE_SIZE;
+	navParams.maxTiles = 4;
+	navParams.maxPolys = 64;
+
+	dtNavMesh* meshes[2];
+	int dataSizes[2];
+	for (int i = 0; i < 2; ++i)
+	{
+		unsigned char* data = createDetailTile(i == 1, dataSizes[i]);
+		REQUIRE(data);
+		meshes[i] = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(meshes[i]->init(&navParams)));
+		REQUIRE(dtStatusSucceed(meshes[i]->addTile(data, dataSizes[i], DT_TILE_FREE_DATA, 0, 0)));
+	}
+	const dtMeshTile* floatTile = ((const dtNavMesh*)meshes[0])->getTileAt(0, 0, 0);
+	const dtMeshTile* quantTile = ((const dtNavMesh*)meshes[1])->getTileAt(0, 0, 0);
+	REQUIRE(floatTile->header->vertFormat == DT_VERTFORMAT_FLOAT);
+	REQUIRE(quantTile->header->vertFormat == DT_VERTFORMAT_QUANTIZED);
+	REQUIRE(dataSizes[1] < dataSizes[0]);
+
+	SECTION("The polygon vertices are decoded exactly")
+	{
+		REQUIRE(floatTile->header->vertCount == quantTile->header->vertCount);
+		// The off-mesh connection vertices are snapped to the detail mesh, so only the polygon vertices are exact.
+		const int nverts = floatTile->header->vertCount - floatTile->header->offMeshConCount*2;
+		for (int i = 0; i < nverts; ++i)
+		{
+			float ta[3], tb[3];
+			const float* a = floatTile->getVert(i, ta);
+			const float* b = quantTile->getVert(i, tb);
+			REQUIRE(a[0] == b[0]);
+			REQUIRE(a[1] == b[1]);
+			REQUIRE(a[2] == b[2]);
+		}
+		float tmp[3];
+		const float* v = quantTile->getDetailVert(0, tmp);
+		REQUIRE(fabsf(v[1] - 0.75f) <= quantTile->header->detailVertStep[1]);
+	}
+
+	SECTION("Queries give the same results")
+	{
+		dtNavMeshQuery* queries[2];
+		for (int i = 0; i < 2; ++i)
+		{
+			queries[i] = dtAllocNavMeshQuery();
+			REQUIRE(dtStatusSucceed(queries[i]->init(meshes[i], 64)));
+		}
+
+		dtQueryFilter filter;
+		const float halfExtents[3] = { 2, 4, 2 };
+		const float points[4][3] = { { TILE_SIZE*0.5f, 0, TILE_SIZE*0.5f }, { 3, 1, 7 }, { 20, 0, 11 }, { 29.5f, 0, 0.5f } };
+		for (int i = 0; i < 4; ++i)
+		{
+			dtPolyRef refs[2];
+			float nearest[2][3];
+			float heights[2];
+			float closest[2][3];
+			for (int j = 0; j < 2; ++j)
+			{
+				REQUIRE(dtStatusSucceed(queries[j]->findNearestPoly(points[i], halfExtents, &filter, &refs[j], nearest[j])));
+				REQUIRE(dtStatusSucceed(queries[j]->getPolyHeight(refs[j], points[i], &heights[j])));
+				REQUIRE(dtStatusSucceed(queries[j]->closestPointOnPoly(refs[j], points[i], closest[j], 0)));
+			}
+			REQUIRE(refs[0] == refs[1]);
+			const float tolerance = quantTile->header->detailVertStep[1] + 1e-5f;
+			REQUIRE(fabsf(heights[0] - heights[1]) <= tolerance);
+			REQUIRE(fabsf(closest[0][1] - closest[1][1]) <= tolerance);
+			REQUIRE(fabsf(nearest[0][1] - nearest[1][1]) <= tolerance);
+		}
+
+		// Outside the polygon the closest point is on the detail edges.
+		const float outside[3] = { -1, 0, 10 };
+		float closest[2][3];
+		for (int j = 0; j < 2; ++j)
+			REQUIRE(dtStatusSucceed(queries[j]->closestPointOnPoly(meshes[j]->getPolyRefBase(j == 0 ? floatTile : quantTile),
+																   outside, closest[j], 0)));
+		REQUIRE(closest[0][0] == closest[1][0]);
+		REQUIRE(fabsf(closest[0][2] - closest[1][2]) <= 1e-5f);
+		REQUIRE(fabsf(closest[0][1] - closest[1][1]) <= quantTile->header->detailVertStep[1] + 1e-5f);
+
+		// The off-mesh connection is snapped to the mesh in both formats.
+		const dtPolyRef base = meshes[0]->getPolyRefBase(floatTile);
+		float start[2][3], end[2][3];
+		for (int j = 0; j < 2; ++j)
+		{
+			REQUIRE(dtStatusSucceed(meshes[j]->getOffMeshConnectionPolyEndPoints(base, base | 1, start[j], end[j])));
+			REQUIRE(start[j][0] == 2.0f);
+		}
+		REQUIRE(fabsf(start[0][1] - start[1][1]) <= quantTile->header->detailVertStep[1] + 1e-5f);
+		REQUIRE(fabsf(end[0][1] - end[1][1]) <= quantTile->header->detailVertStep[1] + 1e-5f);
+
+		for (int i = 0; i < 2; ++i)
+			dtFreeNavMeshQuery(queries[i]);
+	}
+
+	SECTION("Swapping the endianness twice restores the data")
+	{
+		int dataSize = 0;
+		unsigned char* data = createDetailTile(true, dataSize);
+		unsigned char* copy = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_TEMP);
+		memcpy(copy, data, dataSize);
+		REQUIRE(dtNavMeshDataSwapEndian(data, dataSize));
+		REQUIRE(dtNavMeshHeaderSwapEndian(data, dataSize));
+		REQUIRE(memcmp(data, copy, dataSize) != 0);
+		REQUIRE(dtNavMeshHeaderSwapEndian(data, dataSize));
+		REQUIRE(dtNavMeshDataSwapEndian(data, dataSize));
+		REQUIRE(memcmp(data, copy, dataSize) == 0);
+		dtFree(copy);
+		dtFree(data);
+	}
+
+	for (int i = 0; i < 2; ++i)
+		dtFreeNavMesh(meshes[i]);
+}
+
+TEST_CASE("dtLZTileCompressor")
+{
+	dtLZTileCompressor compressor;
+	static const int SIZE = 5000;
+	unsigned char input[SIZE];
+	unsigned char compressed[SIZE*2];
+	unsigned char output[SIZE];
+
+	unsigned int seed = 1;
+	for (int i = 0; i < SIZE; ++i)
+	{
+		seed = seed*1103515245 + 12345;
+		// Random bytes, with runs and repeated blocks in between.
+		if (i >= 1000 && i < 2000)
+			input[i] = (unsigned char)(i & 3);
+		else if (i >= 3000 && i < 4000)
+			input[i] = input[i - 2500];
+		else
+			input[i] = (unsigned char)(seed >> 16);
+	}
+
+	const int sizes[] = { 0, 1, 12, 13, 100, 1500, SIZE };
+	for (int i = 0; i < (int)(sizeof(sizes)/sizeof(sizes[0])); ++i)
+	{
+		const int size = sizes[i];
+		REQUIRE(compressor.maxCompressedSize(size) <= (int)sizeof(compressed));
+		int compressedSize = 0;
+		REQUIRE(dtStatusSucceed(compressor.compress(input, size, compressed, sizeof(compressed), &compressedSize)));
+		REQUIRE(compressedSize <= compressor.maxCompressedSize(size));
+		int outputSize = -1;
+		REQUIRE(dtStatusSucceed(compressor.decompress(compressed, compressedSize, output, SIZE, &outputSize)));
+		REQUIRE(outputSize == size);
+		REQUIRE(memcmp(input, output, size) == 0);
+	}
+
+	SECTION("Repeated data shrinks")
+	{
+		int compressedSize = 0;
+		REQUIRE(dtStatusSucceed(compressor.compress(input + 1000, 1000, compressed, sizeof(compressed), &compressedSize)));
+		REQUIRE(compressedSize < 50);
+	}
+
+	SECTION("Corrupt data fails without overrunning the buffer")
+	{
+		int compressedSize = 0;
+		REQUIRE(dtStatusSucceed(compressor.compress(input, SIZE, compressed, sizeof(compressed), &compressedSize)));
+		int outputSize = 0;
+		REQUIRE(dtStatusFailed(compressor.decompress(compressed, compressedSize - 3, output, SIZE, &outputSize)));
+		REQUIRE(dtStatusFailed(compressor.decompress(compressed, compressedSize, output, SIZE - 1, &outputSize)));
+	}
+}
+
+// An LZ compressor whose decompression can be made to fail.
+struct FailingTileCompressor : public dtLZTileCompressor
+{
+	bool failDecompress;
+
+	FailingTileCompressor() : failDecompress(false) {}
+
+	virtual dtStatus decompress(const unsigned char* compressed, const int compressedSize,
+								unsigned char* buffer, const int maxBufferSize, int* bufferSize)
+	{
+		if (failDecompress)
+			return DT_FAILURE | DT_OUT_OF_MEMORY;
+		return dtLZTileCompressor::decompress(compressed, compressedSize, buffer, maxBufferSize, bufferSize);
+	}
+};
+
+TEST_CASE("dtNavMesh tile compression")
+{
+	const int gridSize = 3;
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = TILE_SIZE;
+	params.tileHeight = TILE_SIZE;
+	params.maxTiles = gridSize*gridSize;
+	params.maxPolys = 64;
+
+	dtNavMesh* mesh = dtAllocNavMesh();
+	REQUIRE(mesh);
+	REQUIRE(dtStatusSucceed(mesh->init(&params)));
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+			REQUIRE(data);
+			REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+	}
+
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(mesh, 512)));
+	dtQueryFilter filter;
+	const float halfExtents[3] = { 1, 1, 1 };
+	const float startPos[3] = { 1, 0, 1 };
+	const float endPos[3] = { TILE_SIZE*gridSize - 1, 0, TILE_SIZE*gridSize - 1 };
+
+	// Finds the path across the whole mesh.
+	struct PathResult
+	{
+		dtPolyRef path[256];
+		int npath;
+	};
+	PathResult expected;
+	dtPolyRef startRef = 0, endRef = 0;
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(startPos, halfExtents, &filter, &startRef, 0)));
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(endPos, halfExtents, &filter, &endRef, 0)));
+	REQUIRE(dtStatusSucceed(query->findPath(startRef, endRef, startPos, endPos, &filter, expected.path, &expected.npath, 256)));
+	REQUIRE(expected.path[expected.npath-1] == endRef);
+
+	FailingTileCompressor compressor;
+	REQUIRE(dtStatusSucceed(mesh->setTileCompression(&compressor, 1)));
+	REQUIRE(dtStatusSucceed(mesh->compressColdTiles()));
+	dtTileCompressionStats stats;
+	mesh->getTileCompressionStats(&stats);
+	REQUIRE(stats.compressedTiles == gridSize*gridSize - 1);
+	REQUIRE(stats.residentTiles == 1);
+	REQUIRE(stats.compressedBytes < stats.uncompressedBytes);
+
+	SECTION("Queries decompress the tiles they use")
+	{
+		mesh->resetTileCompressionStats();
+		PathResult result;
+		REQUIRE(dtStatusSucceed(query->findPath(startRef, endRef, startPos, endPos, &filter, result.path, &result.npath, 256)));
+		REQUIRE(result.npath == expected.npath);
+		REQUIRE(memcmp(result.path, expected.path, sizeof(dtPolyRef)*expected.npath) == 0);
+
+		mesh->getTileCompressionStats(&stats);
+		REQUIRE(stats.misses > 0);
+		REQUIRE(stats.hits > stats.misses);
+		REQUIRE(stats.compressions == 0);
+
+		// The tiles used last stay resident.
+		REQUIRE(dtStatusSucceed(mesh->compressColdTiles()));
+		mesh->getTileCompressionStats(&stats);
+		REQUIRE(stats.residentTiles == 1);
+		const dtMeshTile* last = mesh->getTileByRef(mesh->getTileRefAt(gridSize-1, gridSize-1, 0));
+		REQUIRE(last->compressedData == 0);
+		REQUIRE(stats.hits > 0);
+	}
+
+	SECTION("Tiles can be removed and added next to compressed tiles")
+	{
+		const dtTileRef ref = mesh->getTileRefAt(1, 1, 0);
+		REQUIRE(dtStatusSucceed(mesh->removeTile(ref, 0, 0)));
+		REQUIRE(dtStatusSucceed(mesh->compressColdTiles()));
+
+		int dataSize = 0;
+		unsigned char* data = createGridTile(1, 1, gridTilePolysPerSide(1, 1), dataSize);
+		REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		REQUIRE(dtStatusSucceed(mesh->compressColdTiles()));
+
+		PathResult result;
+		REQUIRE(dtStatusSucceed(query->findPath(startRef, endRef, startPos, endPos, &filter, result.path, &result.npath, 256)));
+		REQUIRE(result.path[result.npath-1] == endRef);
+
+		const dtMeshTile* tile = mesh->getTileAt(1, 1, 0);
+		const dtMeshTile* left = mesh->getTileAt(0, 1, 0);
+		REQUIRE(countLinksTo(*mesh, left, tile) == expectedPortalCount(gridTilePolysPerSide(0, 1), gridTilePolysPerSide(1, 1)));
+	}
+
+	SECTION("Searches fail on tiles that cannot be decompressed")
+	{
+		// The start and end tiles are resident, the tiles between them are not.
+		REQUIRE(mesh->getTileByRef(mesh->getTileRefAt(0, 0, 0)));
+		compressor.failDecompress = true;
+
+		PathResult result;
+		const dtStatus status = query->findPath(startRef, endRef, startPos, endPos, &filter, result.path, &result.npath, 256);
+		REQUIRE(dtStatusFailed(status));
+		REQUIRE(dtStatusDetail(status, DT_OUT_OF_MEMORY));
+		compressor.failDecompress = false;
+	}
+
+	SECTION("Reading the tile headers does not decompress the tiles")
+	{
+		mesh->resetTileCompressionStats();
+		int polyCount = 0;
+		for (int i = 0; i < mesh->getMaxTiles(); ++i)
+		{
+			const dtMeshHeader* header = mesh->getTileHeader(i);
+			REQUIRE(header);
+			polyCount += header->polyCount;
+		}
+		REQUIRE(polyCount > 0);
+		REQUIRE(mesh->getTileSalt(mesh->decodePolyIdTile(startRef)) == mesh->decodePolyIdSalt(startRef));
+		mesh->getTileCompressionStats(&stats);
+		REQUIRE(stats.hits == 0);
+		REQUIRE(stats.misses == 0);
+		REQUIRE(stats.compressedTiles == gridSize*gridSize - 1);
+	}
+
+	SECTION("Disabling the compression decompresses all tiles")
+	{
+		REQUIRE(dtStatusSucceed(mesh->setTileCompression(0, 0)));
+		mesh->getTileCompressionStats(&stats);
+		REQUIRE(stats.compressedTiles == 0);
+		REQUIRE(stats.residentTiles == gridSize*gridSize);
+	}
+
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(mesh);
+}
+
+// Returns the number of tiles of the mesh that copied their shared state.
+static int countUnsharedTiles(const dtNavMesh* mesh)
+{
+	int count = 0;
+	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = mesh->getTile(i);
+		if (tile->header && (!(tile->flags & DT_TILE_SHARED_DATA) || tile->overlay))
+			count++;
+	}
+	return count;
+}
+
+TEST_CASE("dtNavMesh::initShared")
+{
+	const int gridSize = 3;
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = TILE_SIZE;
+	params.tileHeight = TILE_SIZE;
+	params.maxTiles = gridSize*gridSize;
+	params.maxPolys = 64;
+
+	dtNavMesh* base = dtAllocNavMesh();
+	REQUIRE(base);
+	REQUIRE(dtStatusSucceed(base->init(&params)));
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+			REQUIRE(data);
+			REQUIRE(dtStatusSucceed(base->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+	}
+
+	dtNavMesh* instances[2];
+	dtNavMeshQuery* queries[3];
+	for (int i = 0; i < 2; ++i)
+	{
+		instances[i] = dtAllocNavMesh();
+		REQUIRE(instances[i]);
+		REQUIRE(dtStatusSucceed(instances[i]->initShared(base)));
+		REQUIRE(countUnsharedTiles(instances[i]) == 0);
+	}
+	dtNavMesh* meshes[3] = { base, instances[0], instances[1] };
+	for (int i = 0; i < 3; ++i)
+	{
+		queries[i] = dtAllocNavMeshQuery();
+		REQUIRE(queries[i]);
+		REQUIRE(dtStatusSucceed(queries[i]->init(meshes[i], 512)));
+	}
+
+	dtQueryFilter filter;
+	const float halfExtents[3] = { 1, 1, 1 };
+	const float startPos[3] = { 1, 0, TILE_SIZE*1.5f };
+	const float endPos[3] = { TILE_SIZE*gridSize - 1, 0, TILE_SIZE*1.5f };
+	dtPolyRef startRef = 0, endRef = 0;
+	REQUIRE(dtStatusSucceed(queries[0]->findNearestPoly(startPos, halfExtents, &filter, &startRef, 0)));
+	REQUIRE(dtStatusSucceed(queries[0]->findNearestPoly(endPos, halfExtents, &filter, &endRef, 0)));
+
+	dtPolyRef paths[3][256];
+	int npaths[3];
+	for (int i = 0; i < 3; ++i)
+	{
+		REQUIRE(dtStatusSucceed(queries[i]->findPath(startRef, endRef, startPos, endPos, &filter, paths[i], &npaths[i], 256)));
+		REQUIRE(npaths[i] == npaths[0]);
+		REQUIRE(memcmp(paths[i], paths[0], sizeof(dtPolyRef)*npaths[0]) == 0);
+	}
+
+	SECTION("Polygon flags are per instance")
+	{
+		// Block the middle column of the middle tile in the first instance.
+		const dtMeshTile* middle = instances[0]->getTileAt(1, 1, 0);
+		const int n = gridTilePolysPerSide(1, 1);
+		const dtPolyRef middleBase = instances[0]->getPolyRefBase(middle);
+		for (int z = 0; z < n; ++z)
+			REQUIRE(dtStatusSucceed(instances[0]->setPolyFlags(middleBase | (dtPolyRef)(n/2 + z*n), 2)));
+		REQUIRE(countUnsharedTiles(instances[0]) == 1);
+
+		// Setting the same flags does not copy the tile.
+		REQUIRE(dtStatusSucceed(instances[1]->setPolyFlags(middleBase, 1)));
+		REQUIRE(countUnsharedTiles(instances[1]) == 0);
+
+		// The path goes around the blocked polygons in the first instance only.
+		filter.setIncludeFlags(1);
+		for (int i = 0; i < 3; ++i)
+		{
+			dtPolyRef path[256];
+			int npath = 0;
+			REQUIRE(dtStatusSucceed(queries[i]->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 256)));
+			REQUIRE(path[npath-1] == endRef);
+			bool blocked = false;
+			for (int j = 0; j < npath; ++j)
+				blocked |= path[j] == (middleBase | (dtPolyRef)(n/2 + (n/2)*n));
+			REQUIRE(blocked == (i != 1));
+		}
+
+		unsigned short flags = 0;
+		REQUIRE(dtStatusSucceed(base->getPolyFlags(middleBase | (dtPolyRef)(n/2), &flags)));
+		REQUIRE(flags == 1);
+	}
+
+	SECTION("Rebuilt tiles belong to the instance")
+	{
+		const dtTileRef ref = instances[0]->getTileRefAt(1, 1, 0);
+		unsigned char* removedData = 0;
+		REQUIRE(dtStatusSucceed(instances[0]->removeTile(ref, &removedData, 0)));
+		// The data belongs to the base mesh.
+		REQUIRE(removedData == 0);
+		REQUIRE(instances[0]->getTileAt(1, 1, 0) == 0);
+
+		const dtMeshTile* left = instances[0]->getTileAt(0, 1, 0);
+		REQUIRE(left->overlay);
+		// The tile indices are the same in both meshes.
+		REQUIRE(countLinksTo(*base, left, base->getTileAt(1, 1, 0)) == 0);
+		// The base mesh keeps its links.
+		const int expected = expectedPortalCount(gridTilePolysPerSide(0, 1), gridTilePolysPerSide(1, 1));
+		REQUIRE(countLinksTo(*base, base->getTileAt(0, 1, 0), base->getTileAt(1, 1, 0)) == expected);
+
+		// The path goes around the removed tile.
+		dtPolyRef path[256];
+		int npath = 0;
+		REQUIRE(dtStatusSucceed(queries[1]->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 256)));
+		REQUIRE(path[npath-1] == endRef);
+		for (int j = 0; j < npath; ++j)
+			REQUIRE(instances[0]->decodePolyIdTile(path[j]) != instances[0]->decodePolyIdTile(ref));
+
+		int dataSize = 0;
+		unsigned char* data = createGridTile(1, 1, gridTilePolysPerSide(1, 1), dataSize);
+		REQUIRE(dtStatusSucceed(instances[0]->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		const dtMeshTile* tile = instances[0]->getTileAt(1, 1, 0);
+		REQUIRE((tile->flags & DT_TILE_SHARED_DATA) == 0);
+		REQUIRE(countLinksTo(*instances[0], left, tile) == expected);
+		REQUIRE(countLinksTo(*instances[0], tile, left) == expected);
+
+		REQUIRE(dtStatusSucceed(queries[1]->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 256)));
+		REQUIRE(path[npath-1] == endRef);
+		REQUIRE(npath == npaths[0]);
+
+		// The other instance still uses the base tiles.
+		REQUIRE(countUnsharedTiles(instances[1]) == 0);
+		REQUIRE(dtStatusSucceed(queries[2]->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 256)));
+		REQUIRE(npath == npaths[0]);
+	}
+
+	SECTION("Tiles cannot be added as shared")
+	{
+		int dataSize = 0;
+		unsigned char* data = createGridTile(5, 5, 3, dataSize);
+		REQUIRE(dtStatusFailed(instances[1]->addTile(data, dataSize, DT_TILE_SHARED_DATA, 0, 0)));
+		dtFree(data);
+	}
+
+	for (int i = 0; i < 3; ++i)
+		dtFreeNavMeshQuery(queries[i]);
+	for (int i = 0; i < 2; ++i)
+		dtFreeNavMesh(instances[i]);
+
+	// The base mesh is intact after the instances are gone.
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(dtStatusSucceed(query->init(base, 512)));
+	dtPolyRef path[256];
+	int npath = 0;
+	filter.setIncludeFlags(0xffff);
+	REQUIRE(dtStatusSucceed(query->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 256)));
+	REQUIRE(npath == npaths[0]);
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(base);
+}
+
+TEST_CASE("dtCreateNavMeshData wide BV tree")
+{
+	SECTION("The four box test matches the single box test")
+	{
+		unsigned short bmin[12], bmax[12];
+		for (int seed = 0; seed < 1000; ++seed)
+		{
+			unsigned int r = 1234567u + seed*7919u;
+			for (int i = 0; i < 12; ++i)
+			{
+				r = r*1103515245u + 12345u;
+				const unsigned short a = (unsigned short)(r >> 16);
+				r = r*1103515245u + 12345u;
+				const unsigned short b = (unsigned short)(r >> 16);
+				bmin[i] = dtMin(a, b);
+				bmax[i] = dtMax(a, b);
+			}
+			r = r*1103515245u + 12345u;
+			const unsigned short qmin[3] = { (unsigned short)(r >> 16), (unsigned short)(r >> 17), (unsigned short)(r >> 18) };
+			const unsigned short qmax[3] = { (unsigned short)(qmin[0] + 20000), (unsigned short)(qmin[1] + 20000), (unsigned short)(qmin[2] + 20000) };
+			const int mask = dtOverlapQuantBounds4(qmin, qmax, bmin, bmax);
+			for (int i = 0; i < 4; ++i)
+			{
+				const unsigned short amin[3] = { bmin[i], bmin[4+i], bmin[8+i] };
+				const unsigned short amax[3] = { bmax[i], bmax[4+i], bmax[8+i] };
+				REQUIRE(((mask >> i) & 1) == (dtOverlapQuantBounds(qmin, qmax, amin, amax) ? 1 : 0));
+			}
+		}
+	}
+
+	dtNavMeshParams navParams;
+	memset(&navParams, 0, sizeof(navParams));
+	navParams.tileWidth = TILE_SIZE;
+	navParams.tileHeight = TILE_SIZE;
+	navParams.maxTiles = 4;
+	navParams.maxPolys = 1024;
+
+	const int n = 30;
+	dtNavMesh* meshes[2];
+	dtNavMeshQuery* queries[2];
+	int dataSizes[2];
+	for (int i = 0; i < 2; ++i)
+	{
+		unsigned char* data = createGridTile(0, 0, n, dataSizes[i], i == 1);
+		REQUIRE(data);
+		meshes[i] = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(meshes[i]->init(&navParams)));
+		REQUIRE(dtStatusSucceed(meshes[i]->addTile(data, dataSizes[i], DT_TILE_FREE_DATA, 0, 0)));
+		queries[i] = dtAllocNavMeshQuery();
+		REQUIRE(dtStatusSucceed(queries[i]->init(meshes[i], 64)));
+	}
+	const dtMeshTile* binaryTile = ((const dtNavMesh*)meshes[0])->getTileAt(0, 0, 0);
+	const dtMeshTile* wideTile = ((const dtNavMesh*)meshes[1])->getTileAt(0, 0, 0);
+	REQUIRE(binaryTile->header->bvFormat == DT_BVFORMAT_BINARY);
+	REQUIRE(wideTile->header->bvFormat == DT_BVFORMAT_WIDE);
+	REQUIRE(binaryTile->bvTree);
+	REQUIRE(!binaryTile->bvWideTree);
+	REQUIRE(!wideTile->bvTree);
+	REQUIRE(wideTile->bvWideTree);
+	// A 4-ary tree has at most a third as many nodes as polygons, and the nodes are four times the size.
+	REQUIRE(wideTile->header->bvNodeCount <= (n*n + 1)/2);
+	REQUIRE(dataSizes[1] < dataSizes[0]);
+
+	SECTION("Queries find the same polygons")
+	{
+		dtQueryFilter filter;
+		for (int i = 0; i < 200; ++i)
+		{
+			const float x = (i*7 % 61) * 0.5f;
+			const float z = (i*13 % 59) * 0.5f;
+			const float ext = 0.25f + (i % 9);
+			const float center[3] = { x, 0.5f, z };
+			const float halfExtents[3] = { ext, 1, ext*0.5f };
+
+			dtPolyRef polys[2][n*n];
+			int npolys[2];
+			for (int j = 0; j < 2; ++j)
+			{
+				REQUIRE(dtStatusSucceed(queries[j]->queryPolygons(center, halfExtents, &filter, polys[j], &npolys[j], n*n)));
+				// Both meshes use the same references, sort them to compare.
+				for (int a = 1; a < npolys[j]; ++a)
+				{
+					for (int b = a; b > 0 && polys[j][b-1] > polys[j][b]; --b)
+						dtSwap(polys[j][b-1], polys[j][b]);
+				}
+			}
+			REQUIRE(npolys[0] > 0);
+			REQUIRE(npolys[0] == npolys[1]);
+			REQUIRE(memcmp(polys[0], polys[1], sizeof(dtPolyRef)*npolys[0]) == 0);
+
+			dtPolyRef nearest[2];
+			float nearestPt[2][3];
+			for (int j = 0; j < 2; ++j)
+				REQUIRE(dtStatusSucceed(queries[j]->findNearestPoly(center, halfExtents, &filter, &nearest[j], nearestPt[j])));
+			// The points can be on the edge between two polygons, which are then equally near.
+			REQUIRE(dtVequal(nearestPt[0], nearestPt[1]));
+		}
+	}
+
+	SECTION("The tree survives an endian swap")
+	{
+		int dataSize = 0;
+		unsigned char* data = createGridTile(0, 0, n, dataSize, true);
+		unsigned char* copy = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_TEMP);
+		memcpy(copy, data, dataSize);
+		REQUIRE(dtNavMeshDataSwapEndian(copy, dataSize));
+		REQUIRE(dtNavMeshHeaderSwapEndian(copy, dataSize));
+		REQUIRE(memcmp(copy, data, dataSize) != 0);
+		REQUIRE(dtNavMeshHeaderSwapEndian(copy, dataSize));
+		REQUIRE(dtNavMeshDataSwapEndian(copy, dataSize));
+		REQUIRE(memcmp(copy, data, dataSize) == 0);
+		dtFree(copy);
+		dtFree(data);
+	}
+
+	for (int i = 0; i < 2; ++i)
+	{
+		dtFreeNavMeshQuery(queries[i]);
+		dtFreeNavMesh(meshes[i]);
+	}
+}
+
+// Moves a tile made by createGridTile up into another layer.
+static void moveGridTileToLayer(unsigned char* data, const int layer, const float dy)
+{
+	dtMeshHeader* header = (dtMeshHeader*)data;
+	header->layer = layer;
+	header->bmin[1] += dy;
+	header->bmax[1] += dy;
+	float* verts = (float*)(data + dtAlign4(sizeof(dtMeshHeader)));
+	for (int i = 0; i < header->vertCount; ++i)
+		verts[i*3+1] += dy;
+}
+
+TEST_CASE("dtNavMesh polygon lookup grid")
+{
+	dtNavMeshParams navParams;
+	memset(&navParams, 0, sizeof(navParams));
+	navParams.tileWidth = TILE_SIZE;
+	navParams.tileHeight = TILE_SIZE;
+	navParams.maxTiles = 8;
+	navParams.maxPolys = 256;
+
+	// The same two layers, with and without polygon grids.
+	const float layerHeight = 3.0f;
+	dtNavMesh* meshes[2];
+	dtNavMeshQuery* queries[2];
+	for (int i = 0; i < 2; ++i)
+	{
+		navParams.polyGridCellSize = i == 0 ? 2.0f : 0.0f;
+		meshes[i] = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(meshes[i]->init(&navParams)));
+		for (int layer = 0; layer < 2; ++layer)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(0, 0, layer == 0 ? 7 : 5, dataSize);
+			REQUIRE(data);
+			moveGridTileToLayer(data, layer, layer*layerHeight);
+			REQUIRE(dtStatusSucceed(meshes[i]->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+		queries[i] = dtAllocNavMeshQuery();
+		REQUIRE(dtStatusSucceed(queries[i]->init(meshes[i], 64)));
+	}
+
+	SECTION("The cells list the polygons overlapping them")
+	{
+		for (int layer = 0; layer < 2; ++layer)
+		{
+			const dtMeshTile* tile = ((const dtNavMesh*)meshes[0])->getTileAt(0, 0, layer);
+			REQUIRE(tile->polyGridCells);
+			REQUIRE(tile->polyGridWidth == 15);
+			REQUIRE(tile->polyGridHeight == 15);
+			REQUIRE(!((const dtNavMesh*)meshes[1])->getTileAt(0, 0, layer)->polyGridCells);
+			for (int c = 0; c < tile->polyGridWidth*tile->polyGridHeight; ++c)
+			{
+				const unsigned int n = tile->polyGridCells[c+1] - tile->polyGridCells[c];
+				REQUIRE(n >= 1);
+				REQUIRE(n <= 4);
+			}
+		}
+	}
+
+	SECTION("Nearest polygons match the search without grids")
+	{
+		dtQueryFilter filter;
+		const float halfExtents[3] = { 1, 2, 1 };
+		const float heights[4] = { 0.1f, layerHeight - 0.2f, layerHeight*0.5f, 10.0f };
+		for (int i = 0; i < 400; ++i)
+		{
+			const float pos[3] = { 0.05f + (i*37 % 599)*0.05f, heights[i % 4], 0.05f + (i*53 % 599)*0.05f };
+			dtPolyRef refs[2];
+			float pts[2][3];
+			bool over[2] = { false, false };
+			for (int j = 0; j < 2; ++j)
+				REQUIRE(dtStatusSucceed(queries[j]->findNearestPoly(pos, halfExtents, &filter, &refs[j], pts[j], &over[j])));
+			REQUIRE(refs[0] == refs[1]);
+			if (!refs[0])
+				continue;
+			REQUIRE(dtVdist(pts[0], pts[1]) < 1e-4f);
+			REQUIRE(over[0] == over[1]);
+		}
+
+		// Points on a lattice through the edges and corners of the polygons, where the polygons
+		// next to an edge are as near as the one the point is over.
+		for (int i = 0; i < 141*141; ++i)
+		{
+			const float pos[3] = { (i % 141)*TILE_SIZE/140.0f, (i % 3)*0.2f, (i / 141)*TILE_SIZE/140.0f };
+			dtPolyRef refs[2];
+			for (int j = 0; j < 2; ++j)
+				REQUIRE(dtStatusSucceed(queries[j]->findNearestPoly(pos, halfExtents, &filter, &refs[j], 0)));
+			REQUIRE(refs[0] == refs[1]);
+		}
+
+		// A point on the upper layer is found on it.
+		const float upper[3] = { 10.1f, layerHeight + 0.1f, 10.1f };
+		dtPolyRef ref = 0;
+		REQUIRE(dtStatusSucceed(queries[0]->findNearestPoly(upper, halfExtents, &filter, &ref, 0)));
+		REQUIRE(meshes[0]->decodePolyIdTile(ref) == meshes[0]->decodePolyIdTile(meshes[0]->getTileRefAt(0, 0, 1)));
+	}
+
+	SECTION("Stacked polygons within climb height match the search without grids")
+	{
+		for (int i = 0; i < 2; ++i)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(0, 0, 4, dataSize);
+			REQUIRE(data);
+			moveGridTileToLayer(data, 2, 0.2f);
+			REQUIRE(dtStatusSucceed(meshes[i]->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+
+		dtQueryFilter filter;
+		const float halfExtents[3] = { 1, 2, 1 };
+		for (int i = 0; i < 100; ++i)
+		{
+			const float pos[3] = { 0.05f + (i*37 % 599)*0.05f, 0.1f, 0.05f + (i*53 % 599)*0.05f };
+			dtPolyRef refs[2];
+			for (int j = 0; j < 2; ++j)
+				REQUIRE(dtStatusSucceed(queries[j]->findNearestPoly(pos, halfExtents, &filter, &refs[j], 0)));
+			REQUIRE(refs[0]);
+			REQUIRE(refs[0] == refs[1]);
+		}
+	}
+
+	SECTION("Tiles needing too many cells have no grid")
+	{
+		navParams.polyGridCellSize = TILE_SIZE / (DT_POLY_GRID_MAX_SIZE + 0.5f);
+		dtNavMesh* fine = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(fine->init(&navParams)));
+		int dataSize = 0;
+		unsigned char* data = createGridTile(0, 0, 7, dataSize);
+		REQUIRE(data);
+		REQUIRE(dtStatusSucceed(fine->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		const dtMeshTile* tile = ((const dtNavMesh*)fine)->getTileAt(0, 0, 0);
+		REQUIRE(!tile->polyGridCells);
+
+		// The points are found with the BV tree.
+		dtNavMeshQuery* query = dtAllocNavMeshQuery();
+		REQUIRE(dtStatusSucceed(query->init(fine, 64)));
+		dtQueryFilter filter;
+		const float pos[3] = { 10.1f, 0.1f, 10.1f };
+		const float halfExtents[3] = { 1, 2, 1 };
+		dtPolyRef ref = 0;
+		REQUIRE(dtStatusSucceed(query->findNearestPoly(pos, halfExtents, &filter, &ref, 0)));
+		REQUIRE(ref);
+		dtFreeNavMeshQuery(query);
+		dtFreeNavMesh(fine);
+	}
+
+	SECTION("Shared meshes share the grids")
+	{
+		dtNavMesh* instance = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(instance->initShared(meshes[0])));
+		const dtMeshTile* tile = ((const dtNavMesh*)instance)->getTileAt(0, 0, 1);
+		REQUIRE(tile->polyGridCells == ((const dtNavMesh*)meshes[0])->getTileAt(0, 0, 1)->polyGridCells);
+
+		// A rebuilt tile gets its own grid.
+		REQUIRE(dtStatusSucceed(instance->removeTile(instance->getTileRefAt(0, 0, 1), 0, 0)));
+		int dataSize = 0;
+		unsigned char* data = createGridTile(0, 0, 3, dataSize);
+		moveGridTileToLayer(data, 1, layerHeight);
+		REQUIRE(dtStatusSucceed(instance->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		tile = ((const dtNavMesh*)instance)->getTileAt(0, 0, 1);
+		REQUIRE(tile->polyGridCells);
+		REQUIRE(tile->polyGridCells != ((const dtNavMesh*)meshes[0])->getTileAt(0, 0, 1)->polyGridCells);
+		dtFreeNavMesh(instance);
+	}
+
+	for (int i = 0; i < 2; ++i)
+	{
+		dtFreeNavMeshQuery(queries[i]);
+		dtFreeNavMesh(meshes[i]);
+	}
+}
+
+// A single quad tile with a wavy detail mesh of 2*n*n triangles.
+static unsigned char* createTerrainTile(const int n, const bool detailGrids, const bool quantize, int& dataSize)
+{
+	const unsigned short verts[4*3] = { 0,0,0, 0,0,TILE_CELLS, TILE_CELLS,0,TILE_CELLS, TILE_CELLS,0,0 };
+	const unsigned short polys[4*2] = { 0,1,2,3, 0x800f,0x800f,0x800f,0x800f };
+	const unsigned short flags = 1;
+	const unsigned char area = 0;
+
+	// The polygon vertices come first, then the rest of the (n+1)^2 samples.
+	const int nverts = (n+1)*(n+1);
+	const int ntris = 2*n*n;
+	float* detailVerts = new float[nverts*3];
+	unsigned char* detailTris = new unsigned char[ntris*4];
+	int* index = new int[nverts];
+	const int corners[4] = { 0, n*(n+1), n*(n+1)+n, n };
+	for (int i = 0; i < nverts; ++i)
+		index[i] = -1;
+	for (int i = 0; i < 4; ++i)
+		index[corners[i]] = i;
+	int nv = 4;
+	for (int i = 0; i < nverts; ++i)
+	{
+		if (index[i] < 0)
+			index[i] = nv++;
+		const float x = (i % (n+1)) * TILE_SIZE / n;
+		const float z = (i / (n+1)) * TILE_SIZE / n;
+		float* v = &detailVerts[index[i]*3];
+		v[0] = x;
+		v[1] = index[i] < 4 ? 0.0f : 0.3f*sinf(x*0.4f) + 0.2f*sinf(z*0.3f);
+		v[2] = z;
+	}
+	int nt = 0;
+	for (int z = 0; z < n; ++z)
+	{
+		for (int x = 0; x < n; ++x)
+		{
+			const int a = index[z*(n+1)+x], b = index[(z+1)*(n+1)+x];
+			const int c = index[(z+1)*(n+1)+x+1], d = index[z*(n+1)+x+1];
+			const int quad[2][3] = { { a, b, c }, { a, c, d } };
+			for (int k = 0; k < 2; ++k)
+			{
+				unsigned char* t = &detailTris[nt++*4];
+				t[3] = 0;
+				for (int j = 0; j < 3; ++j)
+				{
+					t[j] = (unsigned char)quad[k][j];
+					const float* p = &detailVerts[quad[k][j]*3];
+					const float* q = &detailVerts[quad[k][(j+1)%3]*3];
+					if ((p[0] == q[0] && (p[0] == 0 || p[0] == TILE_SIZE)) || (p[2] == q[2] && (p[2] == 0 || p[2] == TILE_SIZE)))
+						t[3] |= DT_DETAIL_EDGE_BOUNDARY << (j*2);
+				}
+			}
+		}
+	}
+	const unsigned int detailMeshes[4] = { 0, (unsigned int)nverts, 0, (unsigned int)ntris };
+
+	dtNavMeshCreateParams params;
+	memset(&params, 0, sizeof(params));
+	params.verts = verts;
+	params.vertCount = 4;
+	params.polys = polys;
+	params.polyFlags = &flags;
+	params.polyAreas = &area;
+	params.polyCount = 1;
+	params.nvp = 4;
+	params.detailMeshes = detailMeshes;
+	params.detailVerts = detailVerts;
+	params.detailVertsCount = nverts;
+	params.detailTris = detailTris;
+	params.detailTriCount = ntris;
+	params.bmin[0] = 0;
+	params.bmin[1] = -1;
+	params.bmin[2] = 0;
+	params.bmax[0] = TILE_SIZE;
+	params.bmax[1] = 1;
+	params.bmax[2] = TILE_SIZE;
+	params.walkableHeight = 2;
+	params.walkableRadius = 0.5f;
+	params.walkableClimb = 0.5f;
+	params.cs = TILE_CS;
+	params.ch = TILE_CS;
+	params.buildBvTree = true;
+	params.quantizeVerts = quantize;
+	params.buildDetailGrids = detailGrids;
+
+	unsigned char* data = 0;
+	dataSize = 0;
+	dtCreateNavMeshData(&params, &data, &dataSize);
+	delete [] detailVerts;
+	delete [] detailTris;
+	delete [] index;
+	return data;
+}
+
+TEST_CASE("dtCreateNavMeshData detail grids")
+{
+	dtNavMeshParams navParams;
+	memset(&navParams, 0, sizeof(navParams));
+	navParams.tileWidth = TILE_SIZE;
+	navParams.tileHeight = TILE_SIZE;
+	navParams.maxTiles = 4;
+	navParams.maxPolys = 64;
+
+	// The same terrain with and without grids, with float and quantized vertices.
+	const int n = 10;
+	dtNavMesh* meshes[4];
+	dtNavMeshQuery* queries[4];
+	const dtMeshTile* tiles[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		int dataSize = 0;
+		unsigned char* data = createTerrainTile(n, (i & 1) != 0, i >= 2, dataSize);
+		REQUIRE(data);
+		meshes[i] = dtAllocNavMesh();
+		REQUIRE(dtStatusSucceed(meshes[i]->init(&navParams)));
+		REQUIRE(dtStatusSucceed(meshes[i]->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		queries[i] = dtAllocNavMeshQuery();
+		REQUIRE(dtStatusSucceed(queries[i]->init(meshes[i], 64)));
+		tiles[i] = ((const dtNavMesh*)meshes[i])->getTileAt(0, 0, 0);
+	}
+	const dtPolyRef ref = meshes[0]->getPolyRefBase(tiles[0]);
+
+	SECTION("The grid cells list a few triangles each")
+	{
+		for (int i = 0; i < 4; ++i)
+		{
+			const dtMeshTile* tile = tiles[i];
+			if (!(i & 1))
+			{
+				REQUIRE(tile->header->detailGridCount == 0);
+				REQUIRE(tile->detailMeshes[0].grid == 0);
+				continue;
+			}
+			REQUIRE(tile->header->detailGridCount == 1);
+			REQUIRE(tile->detailMeshes[0].grid == 1);
+			const dtPolyDetailGrid& grid = tile->detailGrids[0];
+			REQUIRE(grid.width == 8);
+			REQUIRE(grid.height == 8);
+			// The cells also list the triangles touching their borders.
+			const unsigned short* cells = &tile->detailGridCells[grid.cellBase];
+			for (int c = 0; c < grid.width*grid.height; ++c)
+			{
+				REQUIRE(cells[c+1] - cells[c] >= 4);
+				REQUIRE(cells[c+1] - cells[c] <= 16);
+			}
+		}
+	}
+
+	SECTION("Heights and closest points match the search without grids")
+	{
+		for (int i = 0; i < 500; ++i)
+		{
+			// Inside the polygon, on the detail vertices and edges, and outside it.
+			const float inside[3] = { 0.05f + (i*37 % 599)*0.05f, 0, 0.05f + (i*53 % 599)*0.05f };
+			const float outside[3] = { -5.0f + (i*29 % 401)*0.1f, 0, (i % 2) ? -0.5f - (i % 7) : TILE_SIZE + (i % 5) };
+			float heights[4];
+			float closest[4][3];
+			bool over[4];
+			for (int j = 0; j < 4; ++j)
+			{
+				REQUIRE(dtStatusSucceed(queries[j]->getPolyHeight(ref, inside, &heights[j])));
+				REQUIRE(dtStatusSucceed(queries[j]->closestPointOnPoly(ref, outside, closest[j], &over[j])));
+				REQUIRE(!over[j]);
+			}
+			REQUIRE(heights[0] == heights[1]);
+			REQUIRE(heights[2] == heights[3]);
+			REQUIRE(dtVdist(closest[0], closest[1]) < 1e-5f);
+			REQUIRE(dtVdist(closest[2], closest[3]) < 1e-5f);
+		}
+	}
+
+	SECTION("The grids survive an endian swap")
+	{
+		int dataSize = 0;
+		unsigned char* data = createTerrainTile(n, true, true, dataSize);
+		unsigned char* copy = (unsigned char*)dtAlloc(dataSize, DT_ALLOC_TEMP);
+		memcpy(copy, data, dataSize);
+		REQUIRE(dtNavMeshDataSwapEndian(copy, dataSize));
+		REQUIRE(dtNavMeshHeaderSwapEndian(copy, dataSize));
+		REQUIRE(memcmp(copy, data, dataSize) != 0);
+		REQUIRE(dtNavMeshHeaderSwapEndian(copy, dataSize));
+		REQUIRE(dtNavMeshDataSwapEndian(copy, dataSize));
+		REQUIRE(memcmp(copy, data, dataSize) == 0);
+		dtFree(copy);
+		dtFree(data);
+	}
+
+	for (int i = 0; i < 4; ++i)
+	{
+		dtFreeNavMeshQuery(queries[i]);
+		dtFreeNavMesh(meshes[i]);
+	}
+}
+
+TEST_CASE("dtNodePool::clear")
+{
+	dtNodePool pool(64, 16);
+
+	// Stores nodes for the refs from base, returns how many were found in the hash buckets.
+	struct Fill
+	{
+		static int run(dtNodePool& pool, const dtPolyRef base, const int count)
+		{
+			for (int i = 0; i < count; ++i)
+				pool.getNode(base + i);
+			int n = 0;
+			for (int i = 0; i < pool.getHashSize(); ++i)
+				for (dtNodeIndex j = pool.getFirst(i); j != DT_NULL_IDX; j = pool.getNext(j))
+					n++;
+			return n;
+		}
+	};
+
+	REQUIRE(Fill::run(pool, 1, 40) == 40);
+	REQUIRE(pool.findNode(1, 0));
+	REQUIRE(pool.getNodeCount() == 40);
+
+	SECTION("The nodes are gone after a clear")
+	{
+		pool.clear();
+		REQUIRE(pool.getNodeCount() == 0);
+		REQUIRE(!pool.findNode(1, 0));
+		for (int i = 0; i < pool.getHashSize(); ++i)
+			REQUIRE(pool.getFirst(i) == DT_NULL_IDX);
+
+		// New nodes do not chain to the old ones.
+		REQUIRE(Fill::run(pool, 1000, 10) == 10);
+		REQUIRE(!pool.findNode(5, 0));
+		dtNode* node = pool.findNode(1003, 0);
+		REQUIRE(node);
+		REQUIRE(node->id == 1003);
+	}
+
+	SECTION("The buckets stay consistent when the generation wraps around")
+	{
+		for (int i = 0; i < 70000; ++i)
+		{
+			pool.clear();
+			if (i % 997 == 0)
+				REQUIRE(Fill::run(pool, (dtPolyRef)i*64 + 1, 1 + i % 50) == 1 + i % 50);
+		}
+		REQUIRE(Fill::run(pool, 1, 64) == 64);
+		REQUIRE(!pool.getNode(100));
+		for (int i = 1; i <= 64; ++i)
+			REQUIRE(pool.findNode(i, 0) == pool.getNode(i));
+	}
+}
+
+// A filter that is not derived from dtQueryFilter, blocking one polygon.
+struct BlockingFilter
+{
+	dtPolyRef blocked;
+
+	bool passFilter(const dtPolyRef ref, const dtMeshTile*, const dtPoly* poly) const
+	{
+		return ref != blocked && (poly->flags & 1) != 0;
+	}
+
+	float getCost(const float* pa, const float* pb,
+				  const dtPolyRef, const dtMeshTile*, const dtPoly*,
+				  const dtPolyRef, const dtMeshTile*, const dtPoly*,
+				  const dtPolyRef, const dtMeshTile*, const dtPoly*) const
+	{
+		return dtVdist(pa, pb);
+	}
+};
+
+TEST_CASE("dtNavMeshQuery custom filter types")
+{
+	const int gridSize = 3;
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = TILE_SIZE;
+	params.tileHeight = TILE_SIZE;
+	params.maxTiles = gridSize*gridSize;
+	params.maxPolys = 64;
+
+	dtNavMesh* mesh = dtAllocNavMesh();
+	REQUIRE(mesh);
+	REQUIRE(dtStatusSucceed(mesh->init(&params)));
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+			REQUIRE(data);
+			REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+	}
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(mesh, 512)));
+
+	dtQueryFilter filter;
+	BlockingFilter custom;
+	custom.blocked = 0;
+	const float halfExtents[3] = { 1, 1, 1 };
+	const float startPos[3] = { 1, 0, TILE_SIZE*1.5f };
+	const float endPos[3] = { TILE_SIZE*gridSize - 1, 0, TILE_SIZE*1.5f };
+	dtPolyRef startRef = 0, endRef = 0;
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(startPos, halfExtents, &filter, &startRef, 0)));
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(endPos, halfExtents, &filter, &endRef, 0)));
+
+	dtPolyRef expected[256];
+	int nexpected = 0;
+	REQUIRE(dtStatusSucceed(query->findPath(startRef, endRef, startPos, endPos, &filter, expected, &nexpected, 256)));
+	REQUIRE(expected[nexpected-1] == endRef);
+
+	SECTION("An equivalent filter gives the same results")
+	{
+		dtPolyRef path[256];
+		int npath = 0;
+		REQUIRE(dtStatusSucceed(query->findPath(startRef, endRef, startPos, endPos, &custom, path, &npath, 256)));
+		REQUIRE(npath == nexpected);
+		REQUIRE(memcmp(path, expected, sizeof(dtPolyRef)*npath) == 0);
+
+		dtRaycastHit hits[2];
+		dtPolyRef hitPaths[2][256];
+		for (int i = 0; i < 2; ++i)
+		{
+			memset(&hits[i], 0, sizeof(dtRaycastHit));
+			hits[i].path = hitPaths[i];
+			hits[i].maxPath = 256;
+		}
+		REQUIRE(dtStatusSucceed(query->raycast(startRef, startPos, endPos, &filter, DT_RAYCAST_USE_COSTS, &hits[0])));
+		REQUIRE(dtStatusSucceed(query->raycast(startRef, startPos, endPos, &custom, DT_RAYCAST_USE_COSTS, &hits[1])));
+		REQUIRE(hits[1].t == hits[0].t);
+		REQUIRE(hits[1].pathCost == hits[0].pathCost);
+		REQUIRE(hits[1].pathCount == hits[0].pathCount);
+		REQUIRE(memcmp(hitPaths[1], hitPaths[0], sizeof(dtPolyRef)*hits[0].pathCount) == 0);
+
+		dtPolyRef refs[2][256];
+		float costs[2][256];
+		int counts[2];
+		REQUIRE(dtStatusSucceed(query->findPolysAroundCircle(startRef, startPos, 20, &filter, refs[0], 0, costs[0], &counts[0], 256)));
+		REQUIRE(dtStatusSucceed(query->findPolysAroundCircle(startRef, startPos, 20, &custom, refs[1], 0, costs[1], &counts[1], 256)));
+		REQUIRE(counts[1] == counts[0]);
+		REQUIRE(memcmp(refs[1], refs[0], sizeof(dtPolyRef)*counts[0]) == 0);
+		REQUIRE(memcmp(costs[1], costs[0], sizeof(float)*counts[0]) == 0);
+
+		const float shape[12] = { 0, 0, 40, 12, 0, 40, 12, 0, 50, 0, 0, 50 };
+		REQUIRE(dtStatusSucceed(query->findPolysAroundShape(startRef, shape, 4, &filter, refs[0], 0, costs[0], &counts[0], 256)));
+		REQUIRE(dtStatusSucceed(query->findPolysAroundShape(startRef, shape, 4, &custom, refs[1], 0, costs[1], &counts[1], 256)));
+		REQUIRE(counts[1] == counts[0]);
+		REQUIRE(memcmp(refs[1], refs[0], sizeof(dtPolyRef)*counts[0]) == 0);
+	}
+
+	SECTION("The searches skip the polygons the filter rejects")
+	{
+		custom.blocked = expected[nexpected/2];
+
+		dtPolyRef path[256];
+		int npath = 0;
+		REQUIRE(dtStatusSucceed(query->findPath(startRef, endRef, startPos, endPos, &custom, path, &npath, 256)));
+		REQUIRE(path[npath-1] == endRef);
+		for (int i = 0; i < npath; ++i)
+			REQUIRE(path[i] != custom.blocked);
+
+		dtPolyRef refs[256];
+		int count = 0;
+		REQUIRE(dtStatusSucceed(query->findPolysAroundCircle(startRef, startPos, TILE_SIZE*gridSize, &custom, refs, 0, 0, &count, 256)));
+		REQUIRE(count > 0);
+		for (int i = 0; i < count; ++i)
+			REQUIRE(refs[i] != custom.blocked);
+	}
+
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(mesh);
+}
+
+// Returns the length of the straight path along the corridor.
+static float straightPathLength(dtNavMeshQuery* query, const float* startPos, const float* endPos,
+								const dtPolyRef* path, const int npath)
+{
+	float straight[256*3];
+	int nstraight = 0;
+	REQUIRE(dtStatusSucceed(query->findStraightPath(startPos, endPos, path, npath, straight, 0, 0, &nstraight, 256)));
+	float len = 0;
+	for (int i = 1; i < nstraight; ++i)
+		len += dtVdist(&straight[(i-1)*3], &straight[i*3]);
+	return len;
+}
+
+TEST_CASE("dtNavMeshLandmarks")
+{
+	const int gridSize = 3;
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = TILE_SIZE;
+	params.tileHeight = TILE_SIZE;
+	params.maxTiles = gridSize*gridSize;
+	params.maxPolys = 64;
+
+	dtNavMesh* mesh = dtAllocNavMesh();
+	REQUIRE(mesh);
+	REQUIRE(dtStatusSucceed(mesh->init(&params)));
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+			REQUIRE(data);
+			REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+	}
+
+	// A wall through the middle column of tiles, with a gap at the far end.
+	for (int y = 0; y < gridSize; ++y)
+	{
+		const dtMeshTile* tile = ((const dtNavMesh*)mesh)->getTileAt(1, y, 0);
+		const int n = gridTilePolysPerSide(1, y);
+		const dtPolyRef base = mesh->getPolyRefBase(tile);
+		for (int z = 0; z < (y == gridSize-1 ? n-1 : n); ++z)
+			REQUIRE(dtStatusSucceed(mesh->setPolyFlags(base | (dtPolyRef)(z*n + n/2), 2)));
+	}
+	dtQueryFilter filter;
+	filter.setIncludeFlags(1);
+
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(mesh, 512)));
+
+	const int maxLandmarks = 4;
+	dtNavMeshLandmarks* landmarks = dtAllocNavMeshLandmarks();
+	REQUIRE(landmarks);
+	REQUIRE(dtStatusSucceed(landmarks->init(mesh, maxLandmarks)));
+
+	bool upToDate = true;
+	for (int i = 0; i < maxLandmarks; ++i)
+	{
+		REQUIRE(!landmarks->isUpToDate());
+		REQUIRE(query->updateLandmarks(landmarks, &filter, 1, &upToDate) == DT_SUCCESS);
+		REQUIRE(upToDate == (i == maxLandmarks-1));
+	}
+	for (int i = 0; i < maxLandmarks; ++i)
+	{
+		const dtPolyRef ref = landmarks->getLandmarkRef(i);
+		REQUIRE(query->isValidPolyRef(ref, &filter));
+		REQUIRE(landmarks->getCosts(ref)[i] == 0);
+		for (int j = 0; j < i; ++j)
+			REQUIRE(landmarks->getLandmarkRef(j) != ref);
+	}
+
+	SECTION("Finds the costs of the landmarks")
+	{
+		// The same search as from the landmark, as there are no off-mesh connections.
+		const dtPolyRef landmarkRef = landmarks->getLandmarkRef(1);
+		const dtMeshTile* tile = 0;
+		const dtPoly* poly = 0;
+		REQUIRE(dtStatusSucceed(mesh->getTileAndPolyByRefUnsafe(landmarkRef, &tile, &poly)));
+		float center[3] = { 0, 0, 0 };
+		for (int i = 0; i < (int)poly->vertCount; ++i)
+			dtVadd(center, center, &tile->verts[poly->verts[i]*3]);
+		dtVscale(center, center, 1.0f / poly->vertCount);
+
+		dtPolyRef refs[512];
+		float costs[512];
+		int nrefs = 0;
+		REQUIRE(dtStatusSucceed(query->findPolysAroundCircle(landmarkRef, center, 1000.0f, &filter, refs, 0, costs, &nrefs, 512)));
+		REQUIRE(nrefs > 100);
+		for (int i = 0; i < nrefs; ++i)
+			REQUIRE(landmarks->getCosts(refs[i])[1] == Approx(costs[i]));
+	}
+
+	SECTION("Finds the same paths with fewer nodes")
+	{
+		const float halfExtents[3] = { 1, 1, 1 };
+		int nodes[2] = { 0, 0 };
+		float totals[2] = { 0, 0 };
+		for (int i = 0; i < 20; ++i)
+		{
+			const float startPos[3] = { 1 + (i*7 % 13)*2.0f, 0, 1 + (i*13 % 29)*2.0f };
+			const float endPos[3] = { TILE_SIZE*gridSize - 1 - (i*5 % 13)*2.0f, 0, 1 + (i*17 % 29)*2.0f };
+			dtPolyRef startRef = 0, endRef = 0;
+			REQUIRE(dtStatusSucceed(query->findNearestPoly(startPos, halfExtents, &filter, &startRef, 0)));
+			REQUIRE(dtStatusSucceed(query->findNearestPoly(endPos, halfExtents, &filter, &endRef, 0)));
+
+			float lens[2];
+			for (int j = 0; j < 2; ++j)
+			{
+				REQUIRE(dtStatusSucceed(query->setLandmarks(j ? landmarks : 0)));
+				dtPolyRef path[256];
+				int npath = 0;
+				const dtStatus status = query->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 256);
+				REQUIRE(dtStatusSucceed(status));
+				REQUIRE(!dtStatusDetail(status, DT_PARTIAL_RESULT));
+				REQUIRE(path[npath-1] == endRef);
+				lens[j] = straightPathLength(query, startPos, endPos, path, npath);
+				nodes[j] += query->getNodePool()->getNodeCount();
+			}
+			// The nodes sit on the first portal visited, so the paths can differ a little.
+			REQUIRE(lens[1] <= lens[0]*1.03f);
+			totals[0] += lens[0];
+			totals[1] += lens[1];
+		}
+		REQUIRE(totals[1] <= totals[0]*1.005f);
+		REQUIRE(nodes[1] < nodes[0]);
+	}
+
+	SECTION("Does not use the cost bounds of another filter")
+	{
+		// The costs of the landmarks found with higher area costs are too high for the
+		// filter, the search would stop at the first path to the end it reaches.
+		dtQueryFilter costly = filter;
+		costly.setAreaCost(0, 10.0f);
+		REQUIRE(landmarks->getFilterKey() == dtGetQueryFilterKey(&filter));
+		REQUIRE(dtStatusSucceed(query->updateLandmarks(landmarks, &costly, maxLandmarks, &upToDate)));
+		REQUIRE(upToDate);
+		REQUIRE(landmarks->getFilterKey() == dtGetQueryFilterKey(&costly));
+
+		const float halfExtents[3] = { 1, 1, 1 };
+		for (int i = 0; i < 20; ++i)
+		{
+			const float startPos[3] = { 1 + (i*7 % 13)*2.0f, 0, 1 + (i*13 % 29)*2.0f };
+			const float endPos[3] = { TILE_SIZE*gridSize - 1 - (i*5 % 13)*2.0f, 0, 1 + (i*17 % 29)*2.0f };
+			dtPolyRef startRef = 0, endRef = 0;
+			REQUIRE(dtStatusSucceed(query->findNearestPoly(startPos, halfExtents, &filter, &startRef, 0)));
+			REQUIRE(dtStatusSucceed(query->findNearestPoly(endPos, halfExtents, &filter, &endRef, 0)));
+
+			dtPolyRef paths[2][256];
+			int npaths[2] = { 0, 0 };
+			for (int j = 0; j < 2; ++j)
+			{
+				REQUIRE(dtStatusSucceed(query->setLandmarks(j ? landmarks : 0)));
+				REQUIRE(dtStatusSucceed(query->findPath(startRef, endRef, startPos, endPos, &filter, paths[j], &npaths[j], 256)));
+			}
+			REQUIRE(npaths[1] == npaths[0]);
+			REQUIRE(memcmp(paths[1], paths[0], sizeof(dtPolyRef)*npaths[0]) == 0);
+		}
+	}
+
+	SECTION("Updates the landmarks after tiles change")
+	{
+		const dtTileRef tileRef = mesh->getTileRefAt(2, 0, 0);
+		const dtPolyRef polyRef = mesh->getPolyRefBase(mesh->getTileByRef(tileRef));
+		REQUIRE(landmarks->getCosts(polyRef));
+		REQUIRE(dtStatusSucceed(mesh->removeTile(tileRef, 0, 0)));
+
+		REQUIRE(dtStatusSucceed(query->updateLandmarks(landmarks, &filter, 0, &upToDate)));
+		REQUIRE(!upToDate);
+		REQUIRE(!landmarks->getCosts(polyRef));
+
+		int dataSize = 0;
+		unsigned char* data = createGridTile(2, 0, gridTilePolysPerSide(2, 0), dataSize);
+		REQUIRE(data);
+		REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		const dtPolyRef newRef = mesh->getPolyRefBase(((const dtNavMesh*)mesh)->getTileAt(2, 0, 0));
+
+		// No cost bounds until the landmarks are updated.
+		REQUIRE(landmarks->getCostBound(landmarks->getCosts(landmarks->getLandmarkRef(0)), landmarks->getCosts(newRef)) == 0);
+		for (int i = 0; i < maxLandmarks; ++i)
+			REQUIRE(dtStatusSucceed(query->updateLandmarks(landmarks, &filter, 1, &upToDate)));
+		REQUIRE(upToDate);
+		for (int i = 0; i < maxLandmarks; ++i)
+		{
+			REQUIRE(query->isValidPolyRef(landmarks->getLandmarkRef(i), &filter));
+			REQUIRE(landmarks->getCosts(newRef)[i] < FLT_MAX);
+		}
+		REQUIRE(landmarks->getCostBound(landmarks->getCosts(landmarks->getLandmarkRef(0)), landmarks->getCosts(newRef)) > 0);
+	}
+
+	dtFreeNavMeshLandmarks(landmarks);
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(mesh);
+}
+
+TEST_CASE("dtSlicedSearch")
+{
+	const int gridSize = 3;
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = TILE_SIZE;
+	params.tileHeight = TILE_SIZE;
+	params.maxTiles = gridSize*gridSize;
+	params.maxPolys = 64;
+
+	dtNavMesh* mesh = dtAllocNavMesh();
+	REQUIRE(mesh);
+	REQUIRE(dtStatusSucceed(mesh->init(&params)));
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+			REQUIRE(data);
+			REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+	}
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(mesh, 512)));
+
+	dtQueryFilter filter;
+	const float halfExtents[3] = { 1, 1, 1 };
+
+	static const int SEARCH_COUNT = 8;
+	dtSlicedSearch* searches[SEARCH_COUNT];
+	for (int i = 0; i < SEARCH_COUNT; ++i)
+	{
+		searches[i] = dtAllocSlicedSearch();
+		REQUIRE(searches[i]);
+		REQUIRE(dtStatusSucceed(searches[i]->init(512)));
+	}
+
+	dtPolyRef startRefs[SEARCH_COUNT], endRefs[SEARCH_COUNT];
+	float startPos[SEARCH_COUNT][3], endPos[SEARCH_COUNT][3];
+	for (int i = 0; i < SEARCH_COUNT; ++i)
+	{
+		dtVset(startPos[i], 1 + ((i+1)*7 % 29)*3.0f, 0, 1 + ((i+1)*13 % 29)*3.0f);
+		dtVset(endPos[i], 1 + ((i+1)*17 % 29)*3.0f, 0, 1 + ((i+1)*5 % 29)*3.0f);
+		REQUIRE(dtStatusSucceed(query->findNearestPoly(startPos[i], halfExtents, &filter, &startRefs[i], 0)));
+		REQUIRE(dtStatusSucceed(query->findNearestPoly(endPos[i], halfExtents, &filter, &endRefs[i], 0)));
+	}
+
+	SECTION("Interleaved searches find the same paths as the query's own search")
+	{
+		for (int i = 0; i < SEARCH_COUNT; ++i)
+			REQUIRE(dtStatusInProgress(query->initSlicedFindPath(searches[i], startRefs[i], endRefs[i], startPos[i], endPos[i], &filter)));
+
+		// Advance the searches a few nodes at a time, with other searches on the query in between.
+		bool done = false;
+		while (!done)
+		{
+			done = true;
+			for (int i = 0; i < SEARCH_COUNT; ++i)
+			{
+				const dtStatus status = query->updateSlicedFindPath(searches[i], 4, 0);
+				REQUIRE(!dtStatusFailed(status));
+				done = done && !dtStatusInProgress(status);
+			}
+
+			dtPolyRef path[256];
+			int npath = 0;
+			REQUIRE(dtStatusSucceed(query->findPath(startRefs[0], endRefs[1], startPos[0], endPos[1], &filter, path, &npath, 256)));
+		}
+
+		for (int i = 0; i < SEARCH_COUNT; ++i)
+		{
+			REQUIRE(dtStatusSucceed(searches[i]->getStatus()));
+
+			dtPolyRef path[256], expected[256];
+			int npath = 0, nexpected = 0;
+			REQUIRE(dtStatusSucceed(query->finalizeSlicedFindPath(searches[i], path, &npath, 256)));
+			REQUIRE(searches[i]->getStatus() == 0);
+
+			query->initSlicedFindPath(startRefs[i], endRefs[i], startPos[i], endPos[i], &filter);
+			REQUIRE(dtStatusSucceed(query->updateSlicedFindPath(100000, 0)));
+			REQUIRE(dtStatusSucceed(query->finalizeSlicedFindPath(expected, &nexpected, 256)));
+
+			REQUIRE(npath == nexpected);
+			for (int j = 0; j < npath; ++j)
+				REQUIRE(path[j] == expected[j]);
+			REQUIRE(path[0] == startRefs[i]);
+			REQUIRE(path[npath-1] == endRefs[i]);
+		}
+	}
+
+	SECTION("Incomplete searches return the path to the furthest visited polygon")
+	{
+		REQUIRE(dtStatusInProgress(query->initSlicedFindPath(searches[0], startRefs[0], endRefs[0], startPos[0], endPos[0], &filter)));
+		REQUIRE(dtStatusInProgress(query->updateSlicedFindPath(searches[0], 2, 0)));
+
+		const dtPolyRef existing[2] = { startRefs[0], endRefs[0] };
+		dtPolyRef path[256];
+		int npath = 0;
+		REQUIRE(dtStatusSucceed(query->finalizeSlicedFindPathPartial(searches[0], existing, 2, path, &npath, 256)));
+		REQUIRE(npath == 1);
+		REQUIRE(path[0] == startRefs[0]);
+	}
+
+	SECTION("Searches need an initialized context")
+	{
+		dtSlicedSearch* empty = dtAllocSlicedSearch();
+		REQUIRE(empty);
+		dtPolyRef path[16];
+		int npath = 0;
+		REQUIRE(dtStatusFailed(query->initSlicedFindPath(empty, startRefs[0], endRefs[0], startPos[0], endPos[0], &filter)));
+		REQUIRE(dtStatusFailed(query->initSlicedFindPath(0, startRefs[0], endRefs[0], startPos[0], endPos[0], &filter)));
+		REQUIRE(dtStatusFailed(query->updateSlicedFindPath(empty, 4, 0)));
+		REQUIRE(dtStatusFailed(query->finalizeSlicedFindPath(empty, path, &npath, 16)));
+		REQUIRE(dtStatusFailed(empty->init(0)));
+		dtFreeSlicedSearch(empty);
+	}
+
+	for (int i = 0; i < SEARCH_COUNT; ++i)
+		dtFreeSlicedSearch(searches[i]);
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(mesh);
+}
+
+TEST_CASE("dtNavMeshIslands")
+{
+	const int gridSize = 3;
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = TILE_SIZE;
+	params.tileHeight = TILE_SIZE;
+	params.maxTiles = gridSize*gridSize;
+	params.maxPolys = 64;
+
+	dtNavMesh* mesh = dtAllocNavMesh();
+	REQUIRE(mesh);
+	REQUIRE(dtStatusSucceed(mesh->init(&params)));
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+			REQUIRE(data);
+			REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+	}
+
+	// Flag the middle column of tiles apart, splitting the mesh in two for the first flag set.
+	for (int y = 0; y < gridSize; ++y)
+	{
+		const dtMeshTile* tile = ((const dtNavMesh*)mesh)->getTileAt(1, y, 0);
+		const dtPolyRef base = mesh->getPolyRefBase(tile);
+		for (int i = 0; i < tile->header->polyCount; ++i)
+			REQUIRE(dtStatusSucceed(mesh->setPolyFlags(base | (dtPolyRef)i, 2)));
+	}
+
+	dtNavMeshIslands* islands = dtAllocNavMeshIslands();
+	REQUIRE(islands);
+	REQUIRE(dtStatusSucceed(islands->init(mesh)));
+	REQUIRE(islands->addFlagSet(1, 0) == 0);
+	REQUIRE(islands->addFlagSet(3, 0) == 1);
+	REQUIRE(islands->addFlagSet(1, 0) == 0);
+	REQUIRE(dtStatusSucceed(islands->update()));
+
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(mesh, 2048)));
+
+	dtQueryFilter filter;
+	filter.setIncludeFlags(1);
+	const float halfExtents[3] = { 1, 1, 1 };
+
+	const float leftPos[3] = { 2, 0, TILE_SIZE*0.5f };
+	const float rightPos[3] = { TILE_SIZE*gridSize - 2, 0, TILE_SIZE*2.5f };
+	dtPolyRef leftRef = 0, rightRef = 0;
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(leftPos, halfExtents, &filter, &leftRef, 0)));
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(rightPos, halfExtents, &filter, &rightRef, 0)));
+
+	SECTION("Polygons are on the same island when a search reaches one from the other")
+	{
+		REQUIRE(islands->getIsland(leftRef, 0) != 0);
+		REQUIRE(islands->getIsland(rightRef, 0) != 0);
+		REQUIRE(!islands->isConnected(leftRef, rightRef, 0));
+		REQUIRE(islands->isConnected(leftRef, rightRef, 1));
+		REQUIRE(islands->getIsland(mesh->getPolyRefBase(((const dtNavMesh*)mesh)->getTileAt(1, 1, 0)), 0) == 0);
+
+		for (int i = 0; i < 40; ++i)
+		{
+			const float startPos[3] = { 1 + ((i+1)*7 % 29)*3.0f, 0, 1 + ((i+1)*13 % 29)*3.0f };
+			const float endPos[3] = { 1 + ((i+1)*17 % 29)*3.0f, 0, 1 + ((i+1)*5 % 29)*3.0f };
+			dtPolyRef startRef = 0, endRef = 0;
+			query->findNearestPoly(startPos, halfExtents, &filter, &startRef, 0);
+			query->findNearestPoly(endPos, halfExtents, &filter, &endRef, 0);
+			if (!startRef || !endRef)
+				continue;
+
+			dtPolyRef path[256];
+			int npath = 0;
+			const dtStatus status = query->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 256);
+			REQUIRE(dtStatusSucceed(status));
+			REQUIRE(islands->isConnected(startRef, endRef, 0) == !dtStatusDetail(status, DT_PARTIAL_RESULT));
+		}
+	}
+
+	SECTION("Paths to other islands are not searched")
+	{
+		REQUIRE(dtStatusSucceed(query->setIslands(islands)));
+		REQUIRE(!query->isReachable(leftRef, rightRef, &filter));
+
+		dtPolyRef path[256];
+		int npath = 0;
+		dtStatus status = query->findPath(leftRef, rightRef, leftPos, rightPos, &filter, path, &npath, 256);
+		REQUIRE(status == (DT_SUCCESS | DT_PARTIAL_RESULT));
+		REQUIRE(npath == 1);
+		REQUIRE(path[0] == leftRef);
+
+		REQUIRE(query->initSlicedFindPath(leftRef, rightRef, leftPos, rightPos, &filter) == DT_SUCCESS);
+		REQUIRE(query->updateSlicedFindPath(100, 0) == DT_SUCCESS);
+		status = query->finalizeSlicedFindPath(path, &npath, 256);
+		REQUIRE(status == (DT_SUCCESS | DT_PARTIAL_RESULT));
+		REQUIRE(npath == 1);
+		REQUIRE(path[0] == leftRef);
+
+		// The second flag set joins the islands.
+		filter.setIncludeFlags(3);
+		REQUIRE(query->isReachable(leftRef, rightRef, &filter));
+		status = query->findPath(leftRef, rightRef, leftPos, rightPos, &filter, path, &npath, 256);
+		REQUIRE(status == DT_SUCCESS);
+		REQUIRE(path[npath-1] == rightRef);
+
+		// Filters without a flag set are searched.
+		filter.setIncludeFlags(1);
+		filter.setExcludeFlags(4);
+		REQUIRE(query->isReachable(leftRef, rightRef, &filter));
+		status = query->findPath(leftRef, rightRef, leftPos, rightPos, &filter, path, &npath, 256);
+		REQUIRE(dtStatusDetail(status, DT_PARTIAL_RESULT));
+		REQUIRE(npath > 1);
+	}
+
+	SECTION("Changed polygon flags join and split the islands")
+	{
+		const dtPolyRef base = mesh->getPolyRefBase(((const dtNavMesh*)mesh)->getTileAt(1, 1, 0));
+		const int n = gridTilePolysPerSide(1, 1);
+		for (int x = 0; x < n; ++x)
+		{
+			REQUIRE(dtStatusSucceed(mesh->setPolyFlags(base | (dtPolyRef)x, 1)));
+			islands->invalidatePoly(base | (dtPolyRef)x);
+		}
+		REQUIRE(islands->getIsland(base, 0) == 0);
+		REQUIRE(dtStatusSucceed(islands->update()));
+		REQUIRE(islands->getIsland(base, 0) != 0);
+		REQUIRE(islands->isConnected(leftRef, rightRef, 0));
+		REQUIRE(islands->getIsland(leftRef, 0) == islands->getIsland(rightRef, 0));
+
+		REQUIRE(dtStatusSucceed(mesh->setPolyFlags(base | (dtPolyRef)(n/2), 2)));
+		islands->invalidatePoly(base);
+		REQUIRE(dtStatusSucceed(islands->update()));
+		REQUIRE(!islands->isConnected(leftRef, rightRef, 0));
+		REQUIRE(islands->isConnected(leftRef, base, 0));
+		REQUIRE(islands->isConnected(rightRef, base | (dtPolyRef)(n-1), 0));
+	}
+
+	SECTION("Removed and added tiles join and split the islands")
+	{
+		const dtPolyRef bottomRef = leftRef;
+		const dtPolyRef topRef = mesh->getPolyRefBase(((const dtNavMesh*)mesh)->getTileAt(0, 2, 0));
+		REQUIRE(islands->isConnected(bottomRef, topRef, 0));
+
+		REQUIRE(dtStatusSucceed(mesh->removeTile(mesh->getTileRefAt(0, 1, 0), 0, 0)));
+		REQUIRE(dtStatusSucceed(islands->update()));
+		REQUIRE(!islands->isConnected(bottomRef, topRef, 0));
+		REQUIRE(islands->isConnected(bottomRef, topRef, 1));
+
+		int dataSize = 0;
+		unsigned char* data = createGridTile(0, 1, gridTilePolysPerSide(0, 1), dataSize);
+		REQUIRE(data);
+		REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		REQUIRE(dtStatusSucceed(islands->update()));
+		REQUIRE(islands->isConnected(bottomRef, topRef, 0));
+		REQUIRE(islands->getIsland(bottomRef, 0) == islands->getIsland(topRef, 0));
+		REQUIRE(islands->getIsland(bottomRef, 0) != islands->getIsland(rightRef, 0));
+	}
+
+	SECTION("Out of date islands do not skip searches")
+	{
+		const dtPolyRef bottomRef = leftRef;
+		const float topPos[3] = { 2, 0, TILE_SIZE*2.5f };
+		dtPolyRef topRef = 0;
+		REQUIRE(dtStatusSucceed(query->findNearestPoly(topPos, halfExtents, &filter, &topRef, 0)));
+		REQUIRE(dtStatusSucceed(query->setIslands(islands)));
+
+		REQUIRE(dtStatusSucceed(mesh->removeTile(mesh->getTileRefAt(0, 1, 0), 0, 0)));
+		REQUIRE(dtStatusSucceed(islands->update()));
+		REQUIRE(islands->isUpToDate());
+		REQUIRE(!query->isReachable(bottomRef, topRef, &filter));
+
+		// Add the bridging tile back without updating the islands.
+		int dataSize = 0;
+		unsigned char* data = createGridTile(0, 1, gridTilePolysPerSide(0, 1), dataSize);
+		REQUIRE(data);
+		REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		REQUIRE(!islands->isUpToDate());
+		REQUIRE(query->isReachable(bottomRef, topRef, &filter));
+
+		dtPolyRef path[256];
+		int npath = 0;
+		REQUIRE(query->findPath(bottomRef, topRef, leftPos, topPos, &filter, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(path[npath-1] == topRef);
+
+		REQUIRE(dtStatusSucceed(islands->update()));
+		REQUIRE(islands->isUpToDate());
+		REQUIRE(query->isReachable(bottomRef, topRef, &filter));
+
+		// The same for invalidated polygons, anywhere on the mesh.
+		REQUIRE(!query->isReachable(leftRef, rightRef, &filter));
+		const dtPolyRef base = mesh->getPolyRefBase(((const dtNavMesh*)mesh)->getTileAt(1, 1, 0));
+		const int n = gridTilePolysPerSide(1, 1);
+		for (int x = 0; x < n; ++x)
+			REQUIRE(dtStatusSucceed(mesh->setPolyFlags(base | (dtPolyRef)x, 1)));
+		islands->invalidatePoly(base);
+		REQUIRE(!islands->isUpToDate());
+		REQUIRE(query->findPath(leftRef, rightRef, leftPos, rightPos, &filter, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(path[npath-1] == rightRef);
+	}
+
+	SECTION("Checking the islands does not use the tiles")
+	{
+		dtLZTileCompressor compressor;
+		REQUIRE(dtStatusSucceed(mesh->setTileCompression(&compressor, 0)));
+		REQUIRE(dtStatusSucceed(mesh->compressColdTiles()));
+		mesh->resetTileCompressionStats();
+
+		REQUIRE(islands->isUpToDate());
+		REQUIRE(!islands->isConnected(leftRef, rightRef, 0));
+		REQUIRE(dtStatusSucceed(islands->update()));
+		dtTileCompressionStats stats;
+		mesh->getTileCompressionStats(&stats);
+		REQUIRE(stats.hits == 0);
+		REQUIRE(stats.misses == 0);
+
+		// The islands are out of date once a tile is removed.
+		const unsigned int generation = mesh->getTileGeneration();
+		REQUIRE(dtStatusSucceed(mesh->removeTile(mesh->getTileRefAt(2, 2, 0), 0, 0)));
+		REQUIRE(mesh->getTileGeneration() != generation);
+		REQUIRE(!islands->isUpToDate());
+		REQUIRE(dtStatusSucceed(mesh->compressColdTiles()));
+		REQUIRE(dtStatusSucceed(islands->update()));
+		REQUIRE(islands->isUpToDate());
+		REQUIRE(islands->getIsland(rightRef, 0) == 0);
+		REQUIRE(dtStatusSucceed(mesh->setTileCompression(0, 0)));
+	}
+
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMeshIslands(islands);
+	dtFreeNavMesh(mesh);
+}
+
+TEST_CASE("dtPathCache")
+{
+	const int gridSize = 3;
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = TILE_SIZE;
+	params.tileHeight = TILE_SIZE;
+	params.maxTiles = gridSize*gridSize;
+	params.maxPolys = 64;
+
+	dtNavMesh* mesh = dtAllocNavMesh();
+	REQUIRE(mesh);
+	REQUIRE(dtStatusSucceed(mesh->init(&params)));
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+			REQUIRE(data);
+			REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+	}
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(mesh, 2048)));
+
+	const int maxEntries = 4;
+	dtPathCache* cache = dtAllocPathCache();
+	REQUIRE(cache);
+	REQUIRE(dtStatusSucceed(cache->init(maxEntries, 256)));
+	REQUIRE(cache->getStats().memory > 0);
+
+	dtQueryFilter filter;
+	const float halfExtents[3] = { 1, 1, 1 };
+
+	static const int POINT_COUNT = maxEntries + 2;
+	float pos[POINT_COUNT][3];
+	dtPolyRef refs[POINT_COUNT];
+	for (int i = 0; i < POINT_COUNT; ++i)
+	{
+		dtVset(pos[i], 2 + i*13.0f, 0, TILE_SIZE*gridSize - 2 - i*11.0f);
+		REQUIRE(dtStatusSucceed(query->findNearestPoly(pos[i], halfExtents, &filter, &refs[i], 0)));
+	}
+	const float leftPos[3] = { 2, 0, TILE_SIZE*1.5f };
+	const float rightPos[3] = { TILE_SIZE*gridSize - 2, 0, TILE_SIZE*1.5f };
+	dtPolyRef leftRef = 0, rightRef = 0;
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(leftPos, halfExtents, &filter, &leftRef, 0)));
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(rightPos, halfExtents, &filter, &rightRef, 0)));
+
+	dtPolyRef path[256], expected[256];
+	int npath = 0, nexpected = 0;
+	REQUIRE(dtStatusSucceed(query->findPath(leftRef, rightRef, leftPos, rightPos, &filter, expected, &nexpected, 256)));
+
+	SECTION("Returns the cached paths")
+	{
+		for (int i = 0; i < 3; ++i)
+		{
+			REQUIRE(cache->findPath(query, leftRef, rightRef, leftPos, rightPos, &filter, path, &npath, 256) == DT_SUCCESS);
+			REQUIRE(npath == nexpected);
+			for (int j = 0; j < npath; ++j)
+				REQUIRE(path[j] == expected[j]);
+		}
+		REQUIRE(cache->getStats().misses == 1);
+		REQUIRE(cache->getStats().hits == 2);
+		REQUIRE(cache->getStats().entries == 1);
+
+		// Too small path arrays get the start of the path.
+		REQUIRE(cache->findPath(query, leftRef, rightRef, leftPos, rightPos, &filter, path, &npath, 2) == (DT_SUCCESS | DT_BUFFER_TOO_SMALL));
+		REQUIRE(npath == 2);
+		REQUIRE(path[1] == expected[1]);
+
+		// Other filters have their own paths.
+		dtQueryFilter costly;
+		costly.setAreaCost(0, 2.0f);
+		REQUIRE(dtPathCache::getFilterKey(&costly) != dtPathCache::getFilterKey(&filter));
+		REQUIRE(dtStatusSucceed(cache->findPath(query, leftRef, rightRef, leftPos, rightPos, &costly, path, &npath, 256)));
+		REQUIRE(cache->getStats().misses == 2);
+		REQUIRE(cache->getStats().entries == 2);
+
+		// So do filters with keys of their own, even with the same flags and costs.
+		const unsigned int customKey = dtPathCache::getFilterKey(&filter) + 1;
+		REQUIRE(cache->findPath(query, leftRef, rightRef, leftPos, rightPos, &filter, customKey, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(cache->getStats().misses == 3);
+		REQUIRE(cache->getStats().entries == 3);
+		REQUIRE(cache->findPath(query, leftRef, rightRef, leftPos, rightPos, &filter, customKey, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(cache->getStats().hits == 4);
+
+		cache->clear();
+		REQUIRE(cache->getStats().entries == 0);
+		REQUIRE(cache->findPath(query, leftRef, rightRef, leftPos, rightPos, &filter, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(cache->getStats().misses == 4);
+	}
+
+	SECTION("Drops the paths through changed tiles and polygons")
+	{
+		REQUIRE(dtStatusSucceed(cache->findPath(query, leftRef, rightRef, leftPos, rightPos, &filter, path, &npath, 256)));
+
+		// Replace the middle tile, the path goes through it.
+		const dtTileRef tileRef = mesh->getTileRefAt(1, 1, 0);
+		REQUIRE(dtStatusSucceed(mesh->removeTile(tileRef, 0, 0)));
+		int dataSize = 0;
+		unsigned char* data = createGridTile(1, 1, gridTilePolysPerSide(1, 1), dataSize);
+		REQUIRE(data);
+		REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+
+		REQUIRE(cache->findPath(query, leftRef, rightRef, leftPos, rightPos, &filter, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(cache->getStats().staleEntries == 1);
+		REQUIRE(cache->getStats().misses == 2);
+		for (int i = 0; i < npath; ++i)
+			REQUIRE(query->isValidPolyRef(path[i], &filter));
+
+		// Exclude a polygon of the path.
+		REQUIRE(dtStatusSucceed(mesh->setPolyFlags(path[npath/2], 0)));
+		REQUIRE(cache->findPath(query, leftRef, rightRef, leftPos, rightPos, &filter, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(cache->getStats().staleEntries == 2);
+		REQUIRE(cache->getStats().hits == 0);
+		for (int i = 0; i < npath; ++i)
+			REQUIRE(query->isValidPolyRef(path[i], &filter));
+	}
+
+	SECTION("Drops the least recently used paths")
+	{
+		for (int i = 0; i < maxEntries; ++i)
+			REQUIRE(dtStatusSucceed(cache->findPath(query, refs[i], refs[i+1], pos[i], pos[i+1], &filter, path, &npath, 256)));
+		REQUIRE(cache->getStats().entries == maxEntries);
+
+		// Use the first path again, the second is now the oldest.
+		REQUIRE(dtStatusSucceed(cache->findPath(query, refs[0], refs[1], pos[0], pos[1], &filter, path, &npath, 256)));
+		REQUIRE(cache->getStats().hits == 1);
+		REQUIRE(dtStatusSucceed(cache->findPath(query, refs[maxEntries], refs[maxEntries+1], pos[maxEntries], pos[maxEntries+1], &filter, path, &npath, 256)));
+		REQUIRE(cache->getStats().evictions == 1);
+		REQUIRE(cache->getStats().entries == maxEntries);
+
+		REQUIRE(dtStatusSucceed(cache->findPath(query, refs[0], refs[1], pos[0], pos[1], &filter, path, &npath, 256)));
+		REQUIRE(cache->getStats().hits == 2);
+		REQUIRE(dtStatusSucceed(cache->findPath(query, refs[1], refs[2], pos[1], pos[2], &filter, path, &npath, 256)));
+		REQUIRE(cache->getStats().hits == 2);
+		REQUIRE(cache->getStats().misses == maxEntries + 2);
+	}
+
+	dtFreePathCache(cache);
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(mesh);
+}
+
+// Checks that the path of every polygon the field reaches ends at the goal, getting cheaper
+// at each step, and returns the number of polygons reached.
+static int checkFlowField(const dtNavMesh* mesh, const dtNavMeshFlowField* field)
+{
+	int reached = 0;
+	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile* tile = mesh->getTile(i);
+		if (!tile->header)
+			continue;
+		const dtPolyRef base = mesh->getPolyRefBase(tile);
+		for (int j = 0; j < tile->header->polyCount; ++j)
+		{
+			const dtPolyRef ref = base | (dtPolyRef)j;
+			if (field->getCost(ref) == FLT_MAX)
+				continue;
+			reached++;
+
+			dtPolyRef path[256];
+			int npath = 0;
+			REQUIRE(field->getPath(ref, path, &npath, 256) == DT_SUCCESS);
+			REQUIRE(path[0] == ref);
+			REQUIRE(path[npath-1] == field->getGoalRef());
+			for (int k = 1; k < npath; ++k)
+				REQUIRE(field->getCost(path[k]) < field->getCost(path[k-1]));
+		}
+	}
+	return reached;
+}
+
+TEST_CASE("dtNavMeshFlowField")
+{
+	const int gridSize = 3;
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = TILE_SIZE;
+	params.tileHeight = TILE_SIZE;
+	params.maxTiles = gridSize*gridSize;
+	params.maxPolys = 64;
+
+	dtNavMesh* mesh = dtAllocNavMesh();
+	REQUIRE(mesh);
+	REQUIRE(dtStatusSucceed(mesh->init(&params)));
+	int totalPolys = 0;
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+			REQUIRE(data);
+			REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+			totalPolys += gridTilePolysPerSide(x, y)*gridTilePolysPerSide(x, y);
+		}
+	}
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(mesh, 2048)));
+
+	dtQueryFilter filter;
+	const float halfExtents[3] = { 1, 1, 1 };
+	const float goalPos[3] = { TILE_SIZE*gridSize - 2, 0, TILE_SIZE*1.5f };
+	dtPolyRef goalRef = 0;
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(goalPos, halfExtents, &filter, &goalRef, 0)));
+
+	dtNavMeshFlowField* field = dtAllocNavMeshFlowField();
+	REQUIRE(field);
+	REQUIRE(dtStatusSucceed(field->init(mesh)));
+	REQUIRE(query->findFlowField(field, goalRef, goalPos, &filter) == DT_SUCCESS);
+	REQUIRE(field->getCost(goalRef) == 0);
+	REQUIRE(field->getNextRef(goalRef) == 0);
+
+	SECTION("Every polygon has a path to the goal")
+	{
+		REQUIRE(checkFlowField(mesh, field) == totalPolys);
+
+		// The cost is close to the length of the searched path. It is measured from where the
+		// path leaves the start polygon.
+		for (int i = 0; i < 20; ++i)
+		{
+			const float startPos[3] = { 1 + ((i+1)*7 % 29)*3.0f, 0, 1 + ((i+1)*13 % 29)*3.0f };
+			dtPolyRef startRef = 0;
+			REQUIRE(dtStatusSucceed(query->findNearestPoly(startPos, halfExtents, &filter, &startRef, 0)));
+
+			dtPolyRef path[256];
+			int npath = 0;
+			REQUIRE(query->findPath(startRef, goalRef, startPos, goalPos, &filter, path, &npath, 256) == DT_SUCCESS);
+			float straightPath[256*3];
+			int nstraight = 0;
+			REQUIRE(dtStatusSucceed(query->findStraightPath(startPos, goalPos, path, npath, straightPath, 0, 0, &nstraight, 256)));
+			float length = 0;
+			for (int j = 1; j < nstraight; ++j)
+				length += dtVdist(&straightPath[(j-1)*3], &straightPath[j*3]);
+
+			const float cost = field->getCost(startRef);
+			REQUIRE(cost >= length - TILE_SIZE*0.5f);
+			REQUIRE(cost <= length*1.5f + TILE_SIZE*0.25f);
+		}
+	}
+
+	SECTION("Updates the polygons whose paths cross changed tiles")
+	{
+		dtNavMeshFlowField* fresh = dtAllocNavMeshFlowField();
+		REQUIRE(fresh);
+		REQUIRE(dtStatusSucceed(fresh->init(mesh)));
+
+		// The costs are measured between edge midpoints, so an updated field is close to a
+		// new one but not the same.
+
+		// Remove the middle tile, the paths go around it.
+		const dtMeshTile* middle = ((const dtNavMesh*)mesh)->getTileAt(1, 1, 0);
+		const int middlePolys = middle->header->polyCount;
+		const dtPolyRef middleRef = mesh->getPolyRefBase(middle);
+		REQUIRE(dtStatusSucceed(mesh->removeTile(mesh->getTileRef(middle), 0, 0)));
+		REQUIRE(query->updateFlowField(field) == DT_SUCCESS);
+		REQUIRE(field->getCost(middleRef) == FLT_MAX);
+		REQUIRE(checkFlowField(mesh, field) == totalPolys - middlePolys);
+
+		REQUIRE(query->findFlowField(fresh, goalRef, goalPos, &filter) == DT_SUCCESS);
+		for (int i = 0; i < mesh->getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = ((const dtNavMesh*)mesh)->getTile(i);
+			if (!tile->header)
+				continue;
+			const dtPolyRef base = mesh->getPolyRefBase(tile);
+			for (int j = 0; j < tile->header->polyCount; ++j)
+			{
+				const float cost = fresh->getCost(base | (dtPolyRef)j);
+				REQUIRE(cost != FLT_MAX);
+				REQUIRE(fabsf(field->getCost(base | (dtPolyRef)j) - cost) <= cost*0.1f);
+			}
+		}
+
+		// Add it back, the paths through it are cheaper again.
+		int dataSize = 0;
+		unsigned char* data = createGridTile(1, 1, gridTilePolysPerSide(1, 1), dataSize);
+		REQUIRE(data);
+		REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		REQUIRE(query->updateFlowField(field) == DT_SUCCESS);
+		REQUIRE(checkFlowField(mesh, field) == totalPolys);
+
+		REQUIRE(query->findFlowField(fresh, goalRef, goalPos, &filter) == DT_SUCCESS);
+		for (int i = 0; i < mesh->getMaxTiles(); ++i)
+		{
+			const dtMeshTile* tile = ((const dtNavMesh*)mesh)->getTile(i);
+			if (!tile->header)
+				continue;
+			const dtPolyRef base = mesh->getPolyRefBase(tile);
+			for (int j = 0; j < tile->header->polyCount; ++j)
+			{
+				const float cost = fresh->getCost(base | (dtPolyRef)j);
+				REQUIRE(cost != FLT_MAX);
+				REQUIRE(fabsf(field->getCost(base | (dtPolyRef)j) - cost) <= cost*0.1f);
+			}
+		}
+
+		dtFreeNavMeshFlowField(fresh);
+	}
+
+	SECTION("Updates the polygons of invalidated tiles")
+	{
+		// Exclude the polygon next to the goal on the path of a far polygon.
+		const float startPos[3] = { 2, 0, TILE_SIZE*1.5f };
+		dtPolyRef startRef = 0;
+		REQUIRE(dtStatusSucceed(query->findNearestPoly(startPos, halfExtents, &filter, &startRef, 0)));
+		dtPolyRef path[256];
+		int npath = 0;
+		REQUIRE(field->getPath(startRef, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(npath > 2);
+		const dtPolyRef excludedRef = path[npath-2];
+
+		REQUIRE(dtStatusSucceed(mesh->setPolyFlags(excludedRef, 0)));
+		field->invalidatePoly(excludedRef);
+		REQUIRE(field->getCost(excludedRef) == FLT_MAX);
+		REQUIRE(query->updateFlowField(field) == DT_SUCCESS);
+		REQUIRE(field->getCost(excludedRef) == FLT_MAX);
+		REQUIRE(checkFlowField(mesh, field) == totalPolys - 1);
+		REQUIRE(field->getPath(startRef, path, &npath, 256) == DT_SUCCESS);
+		for (int i = 0; i < npath; ++i)
+			REQUIRE(path[i] != excludedRef);
+
+		// Too small path arrays get the start of the path.
+		REQUIRE(field->getPath(startRef, path, &npath, 2) == (DT_SUCCESS | DT_BUFFER_TOO_SMALL));
+		REQUIRE(npath == 2);
+		REQUIRE(path[0] == startRef);
+	}
+
+	SECTION("Nothing reaches a removed goal")
+	{
+		const dtMeshTile* goalTile = 0;
+		const dtPoly* goalPoly = 0;
+		REQUIRE(dtStatusSucceed(mesh->getTileAndPolyByRef(goalRef, &goalTile, &goalPoly)));
+		REQUIRE(dtStatusSucceed(mesh->removeTile(mesh->getTileRef(goalTile), 0, 0)));
+		REQUIRE(dtStatusFailed(query->updateFlowField(field)));
+		REQUIRE(checkFlowField(mesh, field) == 0);
+	}
+
+	dtFreeNavMeshFlowField(field);
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(mesh);
+}
+
+// A clock advancing by one microsecond at each call.
+static long long s_testClock = 0;
+static long long testClock()
+{
+	return ++s_testClock;
+}
+
+TEST_CASE("dtQueryStats")
+{
+	const int gridSize = 3;
+
+	dtNavMeshParams params;
+	memset(&params, 0, sizeof(params));
+	params.tileWidth = TILE_SIZE;
+	params.tileHeight = TILE_SIZE;
+	params.maxTiles = gridSize*gridSize;
+	params.maxPolys = 64;
+
+	dtNavMesh* mesh = dtAllocNavMesh();
+	REQUIRE(mesh);
+	REQUIRE(dtStatusSucceed(mesh->init(&params)));
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int dataSize = 0;
+			unsigned char* data = createGridTile(x, y, gridTilePolysPerSide(x, y), dataSize);
+			REQUIRE(data);
+			REQUIRE(dtStatusSucceed(mesh->addTile(data, dataSize, DT_TILE_FREE_DATA, 0, 0)));
+		}
+	}
+	dtNavMeshQuery* query = dtAllocNavMeshQuery();
+	REQUIRE(query);
+	REQUIRE(dtStatusSucceed(query->init(mesh, 2048)));
+
+	dtQueryFilter filter;
+	const float halfExtents[3] = { 1, 1, 1 };
+	const float startPos[3] = { 2, 0, 2 };
+	const float endPos[3] = { TILE_SIZE*gridSize - 2, 0, TILE_SIZE*gridSize - 2 };
+	dtPolyRef startRef = 0, endRef = 0;
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(startPos, halfExtents, &filter, &startRef, 0)));
+	REQUIRE(dtStatusSucceed(query->findNearestPoly(endPos, halfExtents, &filter, &endRef, 0)));
+
+	dtQueryStats stats;
+	memset(&stats, 0xff, sizeof(stats));
+	dtPolyRef path[256];
+	int npath = 0;
+
+	dtQueryStatsSetClock(testClock);
+
+#ifdef DT_NO_QUERY_STATS
+	SECTION("The statistics are compiled out")
+	{
+		query->setStats(&stats);
+		REQUIRE(query->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(stats.nodesExpanded == -1);
+		REQUIRE(stats.elapsedUsec == -1);
+	}
+#else
+	SECTION("The statistics are filled only when set")
+	{
+		REQUIRE(query->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(stats.nodesExpanded == -1);
+
+		query->setStats(&stats);
+		REQUIRE(query->getStats() == &stats);
+		REQUIRE(query->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(stats.nodesExpanded >= npath - 1);
+		REQUIRE(stats.nodesTouched >= npath - 1);
+		REQUIRE(stats.linksTraversed >= stats.nodesTouched);
+		REQUIRE(stats.openListPeak > 0);
+		REQUIRE(stats.tilesTouched >= gridSize);
+		REQUIRE(stats.elapsedUsec > 0);
+
+		// Each query resets the statistics.
+		const dtQueryStats pathStats = stats;
+		dtPolyRef nearestRef = 0;
+		REQUIRE(dtStatusSucceed(query->findNearestPoly(startPos, halfExtents, &filter, &nearestRef, 0)));
+		REQUIRE(stats.nodesExpanded > 0);
+		REQUIRE(stats.nodesExpanded < pathStats.nodesExpanded);
+		REQUIRE(query->findPath(startRef, startRef, startPos, startPos, &filter, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(stats.nodesExpanded == 0);
+		REQUIRE(stats.linksTraversed == 0);
+
+		query->setStats(0);
+		REQUIRE(query->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(stats.nodesExpanded == 0);
+	}
+
+	SECTION("The sliced searches add up their steps")
+	{
+		query->setStats(&stats);
+		REQUIRE(query->findPath(startRef, endRef, startPos, endPos, &filter, path, &npath, 256) == DT_SUCCESS);
+		const dtQueryStats pathStats = stats;
+
+		dtQueryStats slicedStats;
+		dtSlicedSearch* search = dtAllocSlicedSearch();
+		REQUIRE(search);
+		REQUIRE(dtStatusSucceed(search->init(2048)));
+		search->setStats(&slicedStats);
+		REQUIRE(search->getStats() == &slicedStats);
+
+		dtStatus status = query->initSlicedFindPath(search, startRef, endRef, startPos, endPos, &filter);
+		while (dtStatusInProgress(status))
+			status = query->updateSlicedFindPath(search, 4, 0);
+		REQUIRE(query->finalizeSlicedFindPath(search, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(slicedStats.nodesExpanded == pathStats.nodesExpanded);
+		REQUIRE(slicedStats.linksTraversed == pathStats.linksTraversed);
+		REQUIRE(slicedStats.openListPeak > 0);
+		REQUIRE(slicedStats.elapsedUsec > 0);
+
+		// The query statistics are not used by the search context.
+		REQUIRE(stats.nodesExpanded == pathStats.nodesExpanded);
+
+		// The sliced search of the query fills the query statistics.
+		status = query->initSlicedFindPath(startRef, endRef, startPos, endPos, &filter);
+		while (dtStatusInProgress(status))
+			status = query->updateSlicedFindPath(4, 0);
+		REQUIRE(query->finalizeSlicedFindPath(path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(stats.nodesExpanded == pathStats.nodesExpanded);
+
+		dtFreeSlicedSearch(search);
+	}
+
+	SECTION("The other queries fill the statistics")
+	{
+		query->setStats(&stats);
+
+		dtPolyRef nearestRef = 0;
+		REQUIRE(dtStatusSucceed(query->findNearestPoly(startPos, halfExtents, &filter, &nearestRef, 0)));
+		REQUIRE(stats.nodesExpanded > 0);
+		REQUIRE(stats.tilesTouched == 1);
+
+		dtRaycastHit hit;
+		memset(&hit, 0, sizeof(hit));
+		hit.path = path;
+		hit.maxPath = 256;
+		REQUIRE(dtStatusSucceed(query->raycast(startRef, startPos, endPos, &filter, 0, &hit)));
+		REQUIRE(stats.nodesExpanded == hit.pathCount);
+		REQUIRE(stats.tilesTouched >= gridSize);
+
+		float resultPos[3];
+		REQUIRE(dtStatusSucceed(query->moveAlongSurface(startRef, startPos, endPos, &filter, resultPos, path, &npath, 256)));
+		REQUIRE(stats.nodesExpanded > 0);
+		REQUIRE(stats.openListPeak > 0);
+
+		dtPolyRef refs[256];
+		int nrefs = 0;
+		REQUIRE(dtStatusSucceed(query->findPolysAroundCircle(startRef, startPos, TILE_SIZE*0.5f, &filter, refs, 0, 0, &nrefs, 256)));
+		REQUIRE(stats.nodesExpanded == nrefs);
+		REQUIRE(stats.nodesTouched >= nrefs - 1);
+
+		const float verts[4*3] = { 0,0,0, TILE_SIZE,0,0, TILE_SIZE,0,TILE_SIZE, 0,0,TILE_SIZE };
+		REQUIRE(dtStatusSucceed(query->findPolysAroundShape(startRef, verts, 4, &filter, refs, 0, 0, &nrefs, 256)));
+		REQUIRE(stats.nodesExpanded == nrefs);
+		REQUIRE(stats.tilesTouched >= 1);
+	}
+#endif
+
+	SECTION("The query refuses code built with another statistics setting")
+	{
+		dtNavMeshQuery* other = dtAllocNavMeshQuery();
+		REQUIRE(other);
+		REQUIRE(other->init(mesh, 64, DT_QUERY_STATS_CONFIG ^ 1) == (DT_FAILURE | DT_WRONG_VERSION));
+		REQUIRE(dtStatusSucceed(other->init(mesh, 64)));
+		dtFreeNavMeshQuery(other);
+	}
+
+	SECTION("The histograms count the queries in power of two buckets")
+	{
+		REQUIRE(dtQueryStatsHistogram::getBucket(0) == 0);
+		REQUIRE(dtQueryStatsHistogram::getBucket(1) == 1);
+		REQUIRE(dtQueryStatsHistogram::getBucket(3) == 2);
+		REQUIRE(dtQueryStatsHistogram::getBucket(4) == 3);
+		REQUIRE(dtQueryStatsHistogram::getBucket(1LL << 40) == DT_QUERY_STATS_BUCKET_COUNT-1);
+		REQUIRE(dtQueryStatsHistogram::getBucketMin(3) == 4);
+
+		dtQueryStatsHistogram histogram;
+		memset(&stats, 0, sizeof(stats));
+		for (int i = 0; i < 100; ++i)
+		{
+			stats.nodesExpanded = i;
+			stats.elapsedUsec = i < 90 ? 10 : 1000;
+			histogram.addSample(stats);
+		}
+		REQUIRE(histogram.getSampleCount() == 100);
+		REQUIRE(histogram.getBucketCount(DT_QUERY_NODES_EXPANDED, 0) == 1);
+		REQUIRE(histogram.getBucketCount(DT_QUERY_NODES_EXPANDED, 4) == 8);
+		REQUIRE(histogram.getTotal(DT_QUERY_NODES_EXPANDED) == 99*100/2);
+		REQUIRE(histogram.getMax(DT_QUERY_NODES_EXPANDED) == 99);
+		REQUIRE(histogram.getBucketCount(DT_QUERY_TILES_TOUCHED, 0) == 100);
+		REQUIRE(histogram.getPercentile(DT_QUERY_ELAPSED_USEC, 50) == 15);
+		REQUIRE(histogram.getPercentile(DT_QUERY_ELAPSED_USEC, 95) == 1000);
+		REQUIRE(histogram.getPercentile(DT_QUERY_NODES_EXPANDED, 100) == 99);
+
+		histogram.reset();
+		REQUIRE(histogram.getSampleCount() == 0);
+		REQUIRE(histogram.getBucketCount(DT_QUERY_NODES_EXPANDED, 0) == 0);
+	}
+
+	dtQueryStatsSetClock(0);
+	dtFreeNavMeshQuery(query);
+	dtFreeNavMesh(mesh);
+}
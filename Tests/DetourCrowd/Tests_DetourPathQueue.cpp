@@ -0,0 +1,510 @@
+#include <string.h>
+
+#include "catch.hpp"
+
+#include "DetourAlloc.h"
+#include "DetourNavMesh.h"
+#include "DetourNavMeshBuilder.h"
+#include "DetourNavMeshQuery.h"
+#include "DetourPathQueue.h"
+#include "DetourStatus.h"
+#include "DetourTileCompressor.h"
+
+static const int GRID_POLYS = 10;
+static const int GRID_CELLS = 60;
+static const float GRID_CS = 0.5f;
+static const float POLY_SIZE = GRID_CELLS*GRID_CS/GRID_POLYS;
+
+// Builds a navigation mesh of one tile made of GRID_POLYS*GRID_POLYS square polygons.
+static dtNavMesh* createGridMesh()
+{
+	const int n = GRID_POLYS;
+	const int nverts = (n+1)*(n+1);
+	const int npolys = n*n;
+	const int nvp = 4;
+	unsigned short verts[nverts*3];
+	unsigned short polys[npolys*nvp*2];
+	unsigned short flags[npolys];
+	unsigned char areas[npolys];
+
+	for (int z = 0; z <= n; ++z)
+	{
+		for (int x = 0; x <= n; ++x)
+		{
+			unsigned short* v = &verts[(x + z*(n+1))*3];
+			v[0] = (unsigned short)(x*GRID_CELLS/n);
+			v[1] = 0;
+			v[2] = (unsigned short)(z*GRID_CELLS/n);
+		}
+	}
+	for (int z = 0; z < n; ++z)
+	{
+		for (int x = 0; x < n; ++x)
+		{
+			const int i = x + z*n;
+			unsigned short* p = &polys[i*nvp*2];
+			p[0] = (unsigned short)(x + z*(n+1));
+			p[1] = (unsigned short)(x + (z+1)*(n+1));
+			p[2] = (unsigned short)(x+1 + (z+1)*(n+1));
+			p[3] = (unsigned short)(x+1 + z*(n+1));
+			p[4] = x > 0 ? (unsigned short)(i-1) : 0xffff;
+			p[5] = z < n-1 ? (unsigned short)(i+n) : 0xffff;
+			p[6] = x < n-1 ? (unsigned short)(i+1) : 0xffff;
+			p[7] = z > 0 ? (unsigned short)(i-n) : 0xffff;
+			flags[i] = 1;
+			areas[i] = 0;
+		}
+	}
+
+	dtNavMeshCreateParams params;
+	memset(&params, 0, sizeof(params));
+	params.verts = verts;
+	params.vertCount = nverts;
+	params.polys = polys;
+	params.polyFlags = flags;
+	params.polyAreas = areas;
+	params.polyCount = npolys;
+	params.nvp = nvp;
+	params.bmax[0] = GRID_CELLS*GRID_CS;
+	params.bmax[1] = 1;
+	params.bmax[2] = GRID_CELLS*GRID_CS;
+	params.walkableHeight = 2;
+	params.walkableRadius = 0.5f;
+	params.walkableClimb = 0.5f;
+	params.cs = GRID_CS;
+	params.ch = GRID_CS;
+	params.buildBvTree = true;
+
+	unsigned char* data = 0;
+	int dataSize = 0;
+	if (!dtCreateNavMeshData(&params, &data, &dataSize))
+		return 0;
+	dtNavMesh* mesh = dtAllocNavMesh();
+	if (!mesh || dtStatusFailed(mesh->init(data, dataSize, DT_TILE_FREE_DATA)))
+	{
+		dtFree(data);
+		dtFreeNavMesh(mesh);
+		return 0;
+	}
+	return mesh;
+}
+
+// A path request between the centres of two polygons of the grid.
+struct GridRequest
+{
+	dtPolyRef startRef, endRef;
+	float startPos[3], endPos[3];
+
+	GridRequest(const dtNavMesh* mesh, const int sx, const int sz, const int ex, const int ez)
+	{
+		const dtPolyRef base = mesh->getPolyRefBase(mesh->getTile(0));
+		startRef = base | (dtPolyRef)(sx + sz*GRID_POLYS);
+		endRef = base | (dtPolyRef)(ex + ez*GRID_POLYS);
+		startPos[0] = (sx + 0.5f)*POLY_SIZE; startPos[1] = 0; startPos[2] = (sz + 0.5f)*POLY_SIZE;
+		endPos[0] = (ex + 0.5f)*POLY_SIZE; endPos[1] = 0; endPos[2] = (ez + 0.5f)*POLY_SIZE;
+	}
+
+	dtPathQueueRef send(dtPathQueue& pathq, const dtQueryFilter* filter, const int priority = 0, const int deadline = 0,
+						dtPathQueueCallback callback = 0, void* userData = 0) const
+	{
+		return pathq.request(startRef, endRef, startPos, endPos, filter, priority, deadline, callback, userData);
+	}
+};
+
+static const int MAX_CALLBACK_CALLS = 32;
+
+// Records the calls of the path queue callbacks.
+struct CallbackLog
+{
+	struct Call
+	{
+		int id;
+		dtPathQueueRef ref;
+		dtStatus status;
+		int npath;
+		dtPolyRef first, last;
+	};
+
+	Call calls[MAX_CALLBACK_CALLS];
+	int ncalls;
+
+	// Optionally reads the result and makes a new request from the callback.
+	dtPathQueue* pathq;
+	bool readResult;
+	const GridRequest* nextRequest;
+	const dtQueryFilter* filter;
+	dtPathQueueRef nextRef;
+	dtStatus readStatus;
+
+	CallbackLog() : ncalls(0), pathq(0), readResult(false), nextRequest(0), filter(0), nextRef(DT_PATHQ_INVALID), readStatus(0) {}
+};
+
+struct CallbackData
+{
+	CallbackLog* log;
+	int id;
+};
+
+static void logCallback(void* userData, dtPathQueueRef ref, dtStatus status, const dtPolyRef* path, const int npath)
+{
+	const CallbackData* data = (const CallbackData*)userData;
+	CallbackLog* log = data->log;
+	REQUIRE(log->ncalls < MAX_CALLBACK_CALLS);
+	CallbackLog::Call& call = log->calls[log->ncalls++];
+	call.id = data->id;
+	call.ref = ref;
+	call.status = status;
+	call.npath = npath;
+	call.first = npath ? path[0] : 0;
+	call.last = npath ? path[npath-1] : 0;
+
+	if (log->readResult)
+	{
+		dtPolyRef result[256];
+		int nresult = 0;
+		log->readStatus = log->pathq->getPathResult(ref, result, &nresult, 256);
+	}
+	if (log->nextRequest)
+		log->nextRef = log->nextRequest->send(*log->pathq, log->filter);
+}
+
+// The result of a request, copied by its callback.
+struct StoredPath
+{
+	dtPolyRef path[256];
+	int npath;
+	dtStatus status;
+};
+
+static void storePath(void* userData, dtPathQueueRef /*ref*/, dtStatus status, const dtPolyRef* path, const int npath)
+{
+	StoredPath* stored = (StoredPath*)userData;
+	memcpy(stored->path, path, sizeof(dtPolyRef)*npath);
+	stored->npath = npath;
+	stored->status = status;
+}
+
+// Runs the workers one at a time in reverse order.
+class ReverseTaskRunner : public dtTaskRunner
+{
+public:
+	int calls;
+	ReverseTaskRunner() : calls(0) {}
+	virtual void parallelFor(const int count, dtParallelForFunc func, void* userData)
+	{
+		calls++;
+		for (int i = count-1; i >= 0; --i)
+			func(userData, i, i+1);
+	}
+};
+
+TEST_CASE("dtPathQueue")
+{
+	dtNavMesh* mesh = createGridMesh();
+	REQUIRE(mesh);
+
+	dtQueryFilter filter;
+	dtPolyRef path[256];
+	int npath = 0;
+	const int maxIters = 1000;
+
+	dtPathQueue pathq;
+	REQUIRE(pathq.init(256, 512, mesh));
+	REQUIRE(pathq.getWorkerCount() == 1);
+
+	SECTION("Grows past the initial requests")
+	{
+		const int count = 20;
+		dtPathQueueRef refs[count];
+		for (int i = 0; i < count; ++i)
+		{
+			const GridRequest req(mesh, 0, i % GRID_POLYS, GRID_POLYS-1, (i*3) % GRID_POLYS);
+			refs[i] = req.send(pathq, &filter);
+			REQUIRE(refs[i] != DT_PATHQ_INVALID);
+			for (int j = 0; j < i; ++j)
+				REQUIRE(refs[j] != refs[i]);
+			REQUIRE(pathq.getRequestStatus(refs[i]) == 0);
+		}
+		REQUIRE(pathq.getStats().pendingRequests == count);
+
+		pathq.update(maxIters*count);
+		for (int i = 0; i < count; ++i)
+		{
+			const GridRequest req(mesh, 0, i % GRID_POLYS, GRID_POLYS-1, (i*3) % GRID_POLYS);
+			REQUIRE(pathq.getPathResult(refs[i], path, &npath, 256) == DT_SUCCESS);
+			REQUIRE(npath > 0);
+			REQUIRE(path[0] == req.startRef);
+			REQUIRE(path[npath-1] == req.endRef);
+			// The result is read once.
+			REQUIRE(dtStatusFailed(pathq.getPathResult(refs[i], path, &npath, 256)));
+		}
+	}
+
+	SECTION("Searches by priority, then in request order")
+	{
+		const int count = 6;
+		const int priorities[count] = { 0, 2, 1, 2, 0, 1 };
+		const int expected[count] = { 1, 3, 2, 5, 0, 4 };
+		CallbackLog log;
+		CallbackData data[count];
+		for (int i = 0; i < count; ++i)
+		{
+			data[i].log = &log;
+			data[i].id = i;
+			const GridRequest req(mesh, i, 0, GRID_POLYS-1, GRID_POLYS-1);
+			REQUIRE(req.send(pathq, &filter, priorities[i], 0, logCallback, &data[i]) != DT_PATHQ_INVALID);
+		}
+
+		pathq.update(maxIters*count);
+		REQUIRE(log.ncalls == count);
+		for (int i = 0; i < count; ++i)
+			REQUIRE(log.calls[i].id == expected[i]);
+	}
+
+	SECTION("Fails the pending requests past their deadline")
+	{
+		CallbackLog log;
+		CallbackData data[2] = { { &log, 0 }, { &log, 1 } };
+		const GridRequest req(mesh, 0, 0, GRID_POLYS-1, GRID_POLYS-1);
+		REQUIRE(req.send(pathq, &filter, 0, 0, logCallback, &data[0]) != DT_PATHQ_INVALID);
+		REQUIRE(req.send(pathq, &filter, 0, 1, logCallback, &data[1]) != DT_PATHQ_INVALID);
+
+		// The first request keeps the worker busy past the deadline of the second.
+		pathq.update(1);
+		REQUIRE(log.ncalls == 1);
+		REQUIRE(log.calls[0].id == 1);
+		REQUIRE(dtStatusFailed(log.calls[0].status));
+		REQUIRE(log.calls[0].npath == 0);
+		REQUIRE(pathq.getStats().expiredRequests == 1);
+		REQUIRE(pathq.getStats().failedRequests == 1);
+		REQUIRE(pathq.getStats().pendingRequests == 0);
+
+		pathq.update(maxIters);
+		REQUIRE(log.ncalls == 2);
+		REQUIRE(log.calls[1].id == 0);
+		REQUIRE(log.calls[1].status == DT_SUCCESS);
+		REQUIRE(log.calls[1].last == req.endRef);
+	}
+
+	SECTION("Returns the partial path of the searches past their deadline")
+	{
+		const GridRequest req(mesh, 0, 0, GRID_POLYS-1, GRID_POLYS-1);
+		const dtPathQueueRef ref = req.send(pathq, &filter, 0, 2);
+		REQUIRE(ref != DT_PATHQ_INVALID);
+
+		pathq.update(1);
+		REQUIRE(dtStatusInProgress(pathq.getRequestStatus(ref)));
+		pathq.update(1);
+		const dtStatus status = pathq.getRequestStatus(ref);
+		REQUIRE(dtStatusSucceed(status));
+		REQUIRE(dtStatusDetail(status, DT_PARTIAL_RESULT));
+		REQUIRE(pathq.getStats().expiredRequests == 1);
+		REQUIRE(pathq.getStats().completedRequests == 1);
+
+		REQUIRE(pathq.getPathResult(ref, path, &npath, 256) == (DT_SUCCESS | DT_PARTIAL_RESULT));
+		REQUIRE(npath > 0);
+		REQUIRE(path[0] == req.startRef);
+		REQUIRE(path[npath-1] != req.endRef);
+	}
+
+	SECTION("Releases the unread results after a few updates")
+	{
+		const GridRequest req(mesh, 0, 0, GRID_POLYS-1, GRID_POLYS-1);
+		const dtPathQueueRef ref = req.send(pathq, &filter);
+		pathq.update(maxIters);
+		REQUIRE(pathq.getRequestStatus(ref) == DT_SUCCESS);
+		pathq.update(maxIters);
+		pathq.update(maxIters);
+		REQUIRE(pathq.getRequestStatus(ref) == DT_SUCCESS);
+		pathq.update(maxIters);
+		REQUIRE(pathq.getRequestStatus(ref) == DT_FAILURE);
+		REQUIRE(dtStatusFailed(pathq.getPathResult(ref, path, &npath, 256)));
+	}
+
+	SECTION("Releases the unread results in the order they were done")
+	{
+		const GridRequest req(mesh, 0, 0, GRID_POLYS-1, GRID_POLYS-1);
+		dtPathQueueRef refs[3];
+		for (int i = 0; i < 3; ++i)
+			refs[i] = req.send(pathq, &filter);
+		pathq.update(maxIters*3);
+
+		// Reading a result in between does not release the others early.
+		REQUIRE(pathq.getPathResult(refs[1], path, &npath, 256) == DT_SUCCESS);
+		const dtPathQueueRef later = req.send(pathq, &filter);
+		pathq.update(maxIters);
+		pathq.update(maxIters);
+		REQUIRE(pathq.getRequestStatus(refs[0]) == DT_SUCCESS);
+		REQUIRE(pathq.getRequestStatus(refs[2]) == DT_SUCCESS);
+		REQUIRE(pathq.getRequestStatus(later) == DT_SUCCESS);
+
+		pathq.update(maxIters);
+		REQUIRE(pathq.getRequestStatus(refs[0]) == DT_FAILURE);
+		REQUIRE(pathq.getRequestStatus(refs[2]) == DT_FAILURE);
+		REQUIRE(pathq.getRequestStatus(later) == DT_SUCCESS);
+		pathq.update(maxIters);
+		REQUIRE(pathq.getRequestStatus(later) == DT_FAILURE);
+
+		// The released requests are reused.
+		for (int i = 0; i < 8; ++i)
+			REQUIRE(req.send(pathq, &filter) != DT_PATHQ_INVALID);
+		pathq.update(maxIters*8);
+		REQUIRE(pathq.getStats().completedRequests == 12);
+	}
+
+	SECTION("Calls the callbacks in the order the requests are done, and releases their requests")
+	{
+		CallbackLog log;
+		CallbackData data[3] = { { &log, 0 }, { &log, 1 }, { &log, 2 } };
+		dtPathQueueRef refs[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			const GridRequest req(mesh, 0, i, GRID_POLYS-1, GRID_POLYS-1-i);
+			refs[i] = req.send(pathq, &filter, 0, 0, logCallback, &data[i]);
+		}
+
+		pathq.update(maxIters*3);
+		REQUIRE(log.ncalls == 3);
+		for (int i = 0; i < 3; ++i)
+		{
+			const GridRequest req(mesh, 0, i, GRID_POLYS-1, GRID_POLYS-1-i);
+			REQUIRE(log.calls[i].id == i);
+			REQUIRE(log.calls[i].ref == refs[i]);
+			REQUIRE(log.calls[i].status == DT_SUCCESS);
+			REQUIRE(log.calls[i].first == req.startRef);
+			REQUIRE(log.calls[i].last == req.endRef);
+			REQUIRE(pathq.getRequestStatus(refs[i]) == DT_FAILURE);
+		}
+	}
+
+	SECTION("Lets the callbacks read the result and make new requests")
+	{
+		const GridRequest first(mesh, 0, 0, GRID_POLYS-1, GRID_POLYS-1);
+		const GridRequest second(mesh, 0, GRID_POLYS-1, GRID_POLYS-1, 0);
+		const GridRequest third(mesh, 1, 1, 2, 2);
+		CallbackLog log;
+		log.pathq = &pathq;
+		log.readResult = true;
+		log.nextRequest = &second;
+		log.filter = &filter;
+		CallbackData data = { &log, 0 };
+		REQUIRE(first.send(pathq, &filter, 0, 0, logCallback, &data) != DT_PATHQ_INVALID);
+
+		pathq.update(maxIters);
+		REQUIRE(log.ncalls == 1);
+		REQUIRE(log.readStatus == DT_SUCCESS);
+		REQUIRE(log.nextRef != DT_PATHQ_INVALID);
+
+		// The new request took the slot released by reading the result, and is still there.
+		REQUIRE(pathq.getRequestStatus(log.nextRef) == 0);
+		const dtPathQueueRef thirdRef = third.send(pathq, &filter);
+		REQUIRE(thirdRef != DT_PATHQ_INVALID);
+		REQUIRE(thirdRef != log.nextRef);
+
+		pathq.update(maxIters);
+		REQUIRE(pathq.getPathResult(log.nextRef, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(path[npath-1] == second.endRef);
+		REQUIRE(pathq.getPathResult(thirdRef, path, &npath, 256) == DT_SUCCESS);
+		REQUIRE(path[npath-1] == third.endRef);
+	}
+
+	SECTION("Counts the requests and their latency")
+	{
+		const int count = 4;
+		CallbackLog log;
+		CallbackData data[count];
+		for (int i = 0; i < count; ++i)
+		{
+			data[i].log = &log;
+			data[i].id = i;
+			const GridRequest req(mesh, 0, i, GRID_POLYS-1, GRID_POLYS-1);
+			REQUIRE(req.send(pathq, &filter, 0, 0, logCallback, &data[i]) != DT_PATHQ_INVALID);
+		}
+		REQUIRE(pathq.getStats().peakPendingRequests == count);
+		REQUIRE(pathq.getLatencyPercentile(0.5f) == 0);
+
+		// Record the update each request is done in.
+		int doneTicks[count];
+		int ticks = 0;
+		while (log.ncalls < count)
+		{
+			const int ncalls = log.ncalls;
+			pathq.update(10);
+			ticks++;
+			for (int i = ncalls; i < log.ncalls; ++i)
+				doneTicks[i] = ticks;
+			REQUIRE(ticks < 100);
+		}
+
+		const dtPathQueueStats& stats = pathq.getStats();
+		REQUIRE(stats.pendingRequests == 0);
+		REQUIRE(stats.peakPendingRequests == count);
+		REQUIRE(stats.completedRequests == count);
+		REQUIRE(stats.failedRequests == 0);
+		REQUIRE(stats.expiredRequests == 0);
+		REQUIRE(stats.totalIterations <= (long long)ticks*10);
+		REQUIRE(stats.totalIterations > (long long)(ticks-1)*10);
+		REQUIRE(stats.maxIterations > 0);
+		REQUIRE(stats.maxIterations <= stats.totalIterations);
+		int latencyCount = 0;
+		for (int i = 0; i < DT_PATHQ_LATENCY_BINS; ++i)
+			latencyCount += stats.latency[i];
+		REQUIRE(latencyCount == count);
+		for (int i = 0; i < count; ++i)
+			REQUIRE(stats.latency[doneTicks[i]] > 0);
+
+		REQUIRE(pathq.getLatencyPercentile(0) == doneTicks[0]);
+		REQUIRE(pathq.getLatencyPercentile(0.5f) == doneTicks[count/2-1]);
+		REQUIRE(pathq.getLatencyPercentile(1) == doneTicks[count-1]);
+
+		pathq.resetStats();
+		REQUIRE(pathq.getStats().completedRequests == 0);
+		REQUIRE(pathq.getStats().totalIterations == 0);
+		REQUIRE(pathq.getLatencyPercentile(1) == 0);
+	}
+
+	SECTION("Several workers find the same paths as one")
+	{
+		const int count = 16;
+		dtPathQueue multi;
+		REQUIRE(multi.init(256, 512, mesh, 4));
+		REQUIRE(multi.getWorkerCount() == 4);
+		ReverseTaskRunner runner;
+
+		StoredPath results[2][count];
+		for (int i = 0; i < count; ++i)
+		{
+			const GridRequest req(mesh, (i*3) % GRID_POLYS, (i*7) % GRID_POLYS, (i*5 + 4) % GRID_POLYS, (i*9 + 2) % GRID_POLYS);
+			REQUIRE(req.send(pathq, &filter, i % 3, 0, storePath, &results[0][i]) != DT_PATHQ_INVALID);
+			REQUIRE(req.send(multi, &filter, i % 3, 0, storePath, &results[1][i]) != DT_PATHQ_INVALID);
+		}
+		for (int i = 0; i < 100 && pathq.getStats().completedRequests < count; ++i)
+			pathq.update(20);
+		for (int i = 0; i < 100 && multi.getStats().completedRequests < count; ++i)
+			multi.update(20, &runner);
+		REQUIRE(runner.calls > 0);
+		REQUIRE(pathq.getStats().completedRequests == count);
+		REQUIRE(multi.getStats().completedRequests == count);
+
+		for (int i = 0; i < count; ++i)
+		{
+			REQUIRE(results[0][i].status == DT_SUCCESS);
+			REQUIRE(results[1][i].status == DT_SUCCESS);
+			REQUIRE(results[1][i].npath == results[0][i].npath);
+			for (int j = 0; j < results[0][i].npath; ++j)
+				REQUIRE(results[1][i].path[j] == results[0][i].path[j]);
+		}
+	}
+
+	SECTION("Several workers are refused on compressed tiles")
+	{
+		dtLZTileCompressor compressor;
+		REQUIRE(dtStatusSucceed(mesh->setTileCompression(&compressor, 0)));
+		dtPathQueue multi;
+		REQUIRE(!multi.init(256, 512, mesh, 2));
+		REQUIRE(multi.init(256, 512, mesh, 1));
+		REQUIRE(dtStatusSucceed(mesh->setTileCompression(0, 0)));
+	}
+
+	dtFreeNavMesh(mesh);
+}
@@ -1,5 +1,7 @@
+#include <float.h>
 #include <stdio.h>
 #include <string.h>
+#include <math.h>
 
 #include "catch.hpp"
 
@@ -837,6 +839,740 @@ TEST_CASE("rcRasterizeTriangles")
 	}
 }
 
+TEST_CASE("rcRasterizeTrianglesToStore")
+{
+	rcContext ctx;
+
+	// A bumpy terrain whose vertices do not line up with the cells.
+	const int gridSize = 8;
+	const float gridStep = 1.3f;
+	float verts[(gridSize+1)*(gridSize+1)*3];
+	for (int z = 0; z <= gridSize; ++z)
+	{
+		for (int x = 0; x <= gridSize; ++x)
+		{
+			float* v = &verts[(x + z*(gridSize+1))*3];
+			v[0] = x*gridStep;
+			v[1] = ((x*7 + z*3) % 5) * 0.35f;
+			v[2] = z*gridStep;
+		}
+	}
+	int tris[gridSize*gridSize*2*3];
+	unsigned char areas[gridSize*gridSize*2];
+	int ntris = 0;
+	for (int z = 0; z < gridSize; ++z)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			const int i = x + z*(gridSize+1);
+			int* t = &tris[ntris*3];
+			t[0] = i; t[1] = i+gridSize+1; t[2] = i+1;
+			t[3] = i+1; t[4] = i+gridSize+1; t[5] = i+gridSize+2;
+			areas[ntris] = (unsigned char)(1 + x % 3);
+			areas[ntris+1] = (unsigned char)(1 + z % 3);
+			ntris += 2;
+		}
+	}
+
+	const float cellSize = 0.5f;
+	const float cellHeight = 0.25f;
+	const int flagMergeThr = 1;
+	float bmin[3], bmax[3];
+	rcCalcBounds(verts, (gridSize+1)*(gridSize+1), bmin, bmax);
+	int width, height;
+	rcCalcGridSize(bmin, bmax, cellSize, &width, &height);
+
+	rcHeightfieldStore store;
+	REQUIRE(rcCreateHeightfieldStore(&ctx, store, width, height, 7, bmin, bmax, cellSize, cellHeight));
+	REQUIRE(rcRasterizeTrianglesToStore(&ctx, verts, (gridSize+1)*(gridSize+1), tris, areas, ntris, store, flagMergeThr));
+
+	SECTION("Copying a view matches a stand-alone rasterization")
+	{
+		const int viewSize = 9;
+		for (int y = 0; y + viewSize <= height; y += 4)
+		{
+			for (int x = 0; x + viewSize <= width; x += 4)
+			{
+				float vmin[3], vmax[3];
+				rcVcopy(vmin, bmin);
+				rcVcopy(vmax, bmax);
+				vmin[0] = bmin[0] + x*cellSize;
+				vmin[2] = bmin[2] + y*cellSize;
+				vmax[0] = vmin[0] + viewSize*cellSize;
+				vmax[2] = vmin[2] + viewSize*cellSize;
+
+				rcHeightfield expected;
+				REQUIRE(rcCreateHeightfield(&ctx, expected, viewSize, viewSize, vmin, vmax, cellSize, cellHeight));
+				REQUIRE(rcRasterizeTriangles(&ctx, verts, (gridSize+1)*(gridSize+1), tris, areas, ntris, expected, flagMergeThr));
+
+				rcHeightfield view;
+				REQUIRE(rcCreateHeightfield(&ctx, view, viewSize, viewSize, vmin, vmax, cellSize, cellHeight));
+				REQUIRE(rcCopyHeightfieldFromStore(&ctx, store, x, y, view));
+				REQUIRE(rcRasterizeHeightfieldEdges(&ctx, verts, (gridSize+1)*(gridSize+1), tris, areas, ntris, view, flagMergeThr));
+
+				for (int i = 0; i < viewSize*viewSize; ++i)
+				{
+					const rcSpan* a = expected.spans[i];
+					const rcSpan* b = view.spans[i];
+					for (; a && b; a = a->next, b = b->next)
+					{
+						REQUIRE(a->smin == b->smin);
+						REQUIRE(a->smax == b->smax);
+						REQUIRE(a->area == b->area);
+					}
+					REQUIRE(a == 0);
+					REQUIRE(b == 0);
+				}
+			}
+		}
+	}
+
+	SECTION("Copying a view at an unaligned tile origin matches the heights of the tile")
+	{
+		// Tile bounds computed the way a tiled build computes them do not fall on exact
+		// multiples of the cell size, so a sliver of a triangle grazing a cell edge by less
+		// than float precision can land in the cell on either side of it. Inside the tile,
+		// such a sliver only changes the area merged into a span here, not its heights.
+		const float offset[3] = { -3.71f, 0.0f, 2.13f };
+		const float tileCellSize = 0.3f;
+		float tileVerts[(gridSize+1)*(gridSize+1)*3];
+		for (int i = 0; i < (gridSize+1)*(gridSize+1); ++i)
+			rcVadd(&tileVerts[i*3], &verts[i*3], offset);
+		float tbmin[3], tbmax[3];
+		rcCalcBounds(tileVerts, (gridSize+1)*(gridSize+1), tbmin, tbmax);
+		int tw, th;
+		rcCalcGridSize(tbmin, tbmax, tileCellSize, &tw, &th);
+
+		rcHeightfieldStore tileStore;
+		REQUIRE(rcCreateHeightfieldStore(&ctx, tileStore, tw, th, 7, tbmin, tbmax, tileCellSize, cellHeight));
+		REQUIRE(rcRasterizeTrianglesToStore(&ctx, tileVerts, (gridSize+1)*(gridSize+1), tris, areas, ntris, tileStore, flagMergeThr));
+
+		const int tileSize = 5;
+		const int borderSize = 2;
+		const int viewSize = tileSize + borderSize*2;
+		const float tcs = tileSize*tileCellSize;
+		int cells = 0, areaMismatches = 0;
+		for (int ty = 0; ty*tileSize < th; ++ty)
+		{
+			for (int tx = 0; tx*tileSize < tw; ++tx)
+			{
+				float vmin[3], vmax[3];
+				rcVcopy(vmin, tbmin);
+				rcVcopy(vmax, tbmax);
+				vmin[0] = tbmin[0] + tx*tcs - borderSize*tileCellSize;
+				vmin[2] = tbmin[2] + ty*tcs - borderSize*tileCellSize;
+				vmax[0] = tbmin[0] + (tx+1)*tcs + borderSize*tileCellSize;
+				vmax[2] = tbmin[2] + (ty+1)*tcs + borderSize*tileCellSize;
+
+				rcHeightfield expected;
+				REQUIRE(rcCreateHeightfield(&ctx, expected, viewSize, viewSize, vmin, vmax, tileCellSize, cellHeight));
+				REQUIRE(rcRasterizeTriangles(&ctx, tileVerts, (gridSize+1)*(gridSize+1), tris, areas, ntris, expected, flagMergeThr));
+
+				rcHeightfield view;
+				REQUIRE(rcCreateHeightfield(&ctx, view, viewSize, viewSize, vmin, vmax, tileCellSize, cellHeight));
+				REQUIRE(rcCopyHeightfieldFromStore(&ctx, tileStore, tx*tileSize - borderSize, ty*tileSize - borderSize, view));
+				REQUIRE(rcRasterizeHeightfieldEdges(&ctx, tileVerts, (gridSize+1)*(gridSize+1), tris, areas, ntris, view, flagMergeThr));
+
+				for (int y = borderSize; y < borderSize + tileSize; ++y)
+				{
+					for (int x = borderSize; x < borderSize + tileSize; ++x)
+					{
+						const rcSpan* a = expected.spans[x + y*viewSize];
+						const rcSpan* b = view.spans[x + y*viewSize];
+						bool sameArea = true;
+						for (; a && b; a = a->next, b = b->next)
+						{
+							REQUIRE(a->smin == b->smin);
+							REQUIRE(a->smax == b->smax);
+							sameArea = sameArea && a->area == b->area;
+						}
+						REQUIRE(a == 0);
+						REQUIRE(b == 0);
+						cells++;
+						if (!sameArea)
+							areaMismatches++;
+					}
+				}
+			}
+		}
+		REQUIRE(areaMismatches*100 < cells);
+	}
+
+	SECTION("Cells outside the store are left empty")
+	{
+		rcHeightfield view;
+		REQUIRE(rcCreateHeightfield(&ctx, view, 4, 4, bmin, bmax, cellSize, cellHeight));
+		REQUIRE(rcCopyHeightfieldFromStore(&ctx, store, -4, -4, view));
+		for (int i = 0; i < 4*4; ++i)
+			REQUIRE(!view.spans[i]);
+	}
+}
+
+// Runs the ranges of a parallel loop one item at a time, last item first, as if
+// every item had been picked up by a different thread.
+class ShuffledParallelContext : public rcContext
+{
+protected:
+	virtual void doParallelFor(const int count, rcParallelForFunc func, void* userData)
+	{
+		for (int i = count-1; i >= 0; --i)
+			func(userData, i, i+1);
+	}
+};
+
+TEST_CASE("rcCreateChunkyTriMesh")
+{
+	rcContext ctx;
+
+	// A field of small triangles scattered over a sloped area.
+	const int ntris = 1000;
+	float verts[ntris*3*3];
+	int tris[ntris*3];
+	unsigned int seed = 12345;
+	for (int i = 0; i < ntris; ++i)
+	{
+		seed = seed*1103515245u + 12345u;
+		const float cx = (float)((seed >> 8) % 1000) * 0.1f;
+		seed = seed*1103515245u + 12345u;
+		const float cz = (float)((seed >> 8) % 1000) * 0.1f;
+		const float cy = cx * 0.25f;
+		for (int j = 0; j < 3; ++j)
+		{
+			float* v = &verts[(i*3+j)*3];
+			v[0] = cx + (j == 1 ? 0.5f : 0.0f);
+			v[1] = cy + (j == 2 ? 0.5f : 0.0f);
+			v[2] = cz + (j == 2 ? 0.5f : 0.0f);
+			tris[i*3+j] = i*3+j;
+		}
+	}
+
+	const int trisPerChunk = 16;
+	rcChunkyTriMesh cm;
+	REQUIRE(rcCreateChunkyTriMesh(&ctx, verts, tris, ntris, trisPerChunk, cm));
+	REQUIRE(cm.ntris == ntris);
+	REQUIRE(cm.maxTrisPerChunk <= trisPerChunk);
+
+	SECTION("Every triangle is in exactly one leaf")
+	{
+		int seen[ntris];
+		memset(seen, 0, sizeof(seen));
+		int total = 0;
+		for (int i = 0; i < cm.nnodes; ++i)
+		{
+			const rcChunkyTriMeshNode& node = cm.nodes[i];
+			if (node.i < 0)
+			{
+				// Escape offsets stay inside the tree.
+				REQUIRE(i - node.i <= cm.nnodes);
+				continue;
+			}
+			REQUIRE(node.n > 0);
+			REQUIRE(node.n <= trisPerChunk);
+			REQUIRE(node.i == total);
+			for (int j = 0; j < node.n; ++j)
+			{
+				const int* t = &cm.tris[(node.i+j)*3];
+				seen[t[0]/3]++;
+				// Leaf bounds contain the triangle.
+				for (int k = 0; k < 3; ++k)
+				{
+					const float* v = &verts[t[k]*3];
+					REQUIRE(v[0] >= node.bmin[0]); REQUIRE(v[0] <= node.bmax[0]);
+					REQUIRE(v[1] >= node.bmin[1]); REQUIRE(v[1] <= node.bmax[1]);
+					REQUIRE(v[2] >= node.bmin[2]); REQUIRE(v[2] <= node.bmax[2]);
+				}
+			}
+			total += node.n;
+		}
+		REQUIRE(total == ntris);
+		for (int i = 0; i < ntris; ++i)
+			REQUIRE(seen[i] == 1);
+	}
+
+	SECTION("Queries find every overlapping triangle")
+	{
+		int ids[1024];
+
+		const float rmin[2] = { 20.0f, 40.0f };
+		const float rmax[2] = { 35.0f, 47.5f };
+		int n = rcGetChunksOverlappingRect(cm, rmin, rmax, ids, 1024);
+		int found = 0;
+		int expected = 0;
+		for (int i = 0; i < ntris; ++i)
+		{
+			const float* v = &verts[i*9];
+			if (v[0] + 0.5f < rmin[0] || v[0] > rmax[0] || v[2] + 0.5f < rmin[1] || v[2] > rmax[1])
+				continue;
+			expected++;
+		}
+		for (int i = 0; i < n; ++i)
+		{
+			const rcChunkyTriMeshNode& node = cm.nodes[ids[i]];
+			REQUIRE(node.i >= 0);
+			for (int j = 0; j < node.n; ++j)
+			{
+				const float* v = &verts[cm.tris[(node.i+j)*3]*3];
+				if (v[0] + 0.5f < rmin[0] || v[0] > rmax[0] || v[2] + 0.5f < rmin[1] || v[2] > rmax[1])
+					continue;
+				found++;
+			}
+		}
+		REQUIRE(expected > 0);
+		REQUIRE(found == expected);
+
+		// A box below the slope only touches the low end of it.
+		const float bmin[3] = { 0.0f, -10.0f, 0.0f };
+		const float bmax[3] = { 100.0f, 2.0f, 100.0f };
+		n = rcGetChunksOverlappingBox(cm, bmin, bmax, ids, 1024);
+		REQUIRE(n > 0);
+		for (int i = 0; i < n; ++i)
+			REQUIRE(cm.nodes[ids[i]].bmin[1] <= bmax[1]);
+
+		// A vertical segment through a triangle.
+		const float* v = &verts[0];
+		const float p[3] = { v[0] + 0.1f, v[1] + 10.0f, v[2] + 0.1f };
+		const float q[3] = { v[0] + 0.1f, v[1] - 10.0f, v[2] + 0.1f };
+		n = rcGetChunksOverlappingSegment(cm, p, q, ids, 1024);
+		bool hit = false;
+		for (int i = 0; i < n; ++i)
+		{
+			const rcChunkyTriMeshNode& node = cm.nodes[ids[i]];
+			for (int j = 0; j < node.n; ++j)
+				hit |= cm.tris[(node.i+j)*3] == 0;
+		}
+		REQUIRE(hit);
+	}
+
+	SECTION("Building the subtrees in parallel gives the same tree")
+	{
+		ShuffledParallelContext shuffledCtx;
+		rcChunkyTriMesh shuffled;
+		REQUIRE(rcCreateChunkyTriMesh(&shuffledCtx, verts, tris, ntris, trisPerChunk, shuffled));
+		REQUIRE(shuffled.nnodes == cm.nnodes);
+		REQUIRE(memcmp(shuffled.nodes, cm.nodes, sizeof(rcChunkyTriMeshNode)*cm.nnodes) == 0);
+		REQUIRE(memcmp(shuffled.tris, cm.tris, sizeof(int)*ntris*3) == 0);
+	}
+
+	SECTION("Rebuilding releases the previous tree")
+	{
+		REQUIRE(rcCreateChunkyTriMesh(&ctx, verts, tris, 10, trisPerChunk, cm));
+		REQUIRE(cm.ntris == 10);
+		REQUIRE(cm.nnodes == 1);
+		REQUIRE(cm.nodes[0].n == 10);
+	}
+}
+
+TEST_CASE("rcBuildContours")
+{
+	// A bumpy terrain with a few flat-topped mounds that split it into regions.
+	const int gridSize = 24;
+	float verts[(gridSize+1)*(gridSize+1)*3];
+	for (int z = 0; z <= gridSize; ++z)
+	{
+		for (int x = 0; x <= gridSize; ++x)
+		{
+			float* v = &verts[(x + z*(gridSize+1))*3];
+			v[0] = (float)x;
+			v[1] = ((x/6 + z/5) % 3 == 0) ? 1.5f : ((x*7 + z*3) % 5) * 0.05f;
+			v[2] = (float)z;
+		}
+	}
+	int tris[gridSize*gridSize*2*3];
+	int ntris = 0;
+	for (int z = 0; z < gridSize; ++z)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			const int i = x + z*(gridSize+1);
+			int* t = &tris[ntris*3];
+			t[0] = i; t[1] = i+gridSize+1; t[2] = i+1;
+			t[3] = i+1; t[4] = i+gridSize+1; t[5] = i+gridSize+2;
+			ntris += 2;
+		}
+	}
+	const int nverts = (gridSize+1)*(gridSize+1);
+
+	rcContext ctx;
+	unsigned char areas[gridSize*gridSize*2];
+	memset(areas, 0, sizeof(areas));
+	rcMarkWalkableTriangles(&ctx, 45.0f, verts, nverts, tris, ntris, areas);
+
+	float bmin[3], bmax[3];
+	rcCalcBounds(verts, nverts, bmin, bmax);
+	const float cs = 0.3f;
+	const float ch = 0.2f;
+	int width = 0, height = 0;
+	rcCalcGridSize(bmin, bmax, cs, &width, &height);
+
+	rcHeightfield solid;
+	REQUIRE(rcCreateHeightfield(&ctx, solid, width, height, bmin, bmax, cs, ch));
+	REQUIRE(rcRasterizeTriangles(&ctx, verts, nverts, tris, areas, ntris, solid, 2));
+	rcCompactHeightfield chf;
+	REQUIRE(rcBuildCompactHeightfield(&ctx, 10, 2, solid, chf));
+	REQUIRE(rcErodeWalkableArea(&ctx, 2, chf));
+	REQUIRE(rcBuildDistanceField(&ctx, chf));
+	REQUIRE(rcBuildRegions(&ctx, chf, 2, 8, 20));
+
+	rcContourSet serial;
+	REQUIRE(rcBuildContours(&ctx, chf, 1.3f, 12, serial));
+	REQUIRE(serial.nconts > 1);
+
+	SECTION("Every contour is a valid outline of a region")
+	{
+		for (int i = 0; i < serial.nconts; ++i)
+		{
+			const rcContour& cont = serial.conts[i];
+			REQUIRE(cont.nverts >= 3);
+			REQUIRE(cont.nrverts >= cont.nverts);
+			REQUIRE(cont.reg != 0);
+			REQUIRE((cont.reg & RC_BORDER_REG) == 0);
+		}
+	}
+
+	SECTION("The result does not depend on how the work is split")
+	{
+		ShuffledParallelContext shuffledCtx;
+		rcContourSet shuffled;
+		REQUIRE(rcBuildContours(&shuffledCtx, chf, 1.3f, 12, shuffled));
+		REQUIRE(shuffled.nconts == serial.nconts);
+		for (int i = 0; i < serial.nconts; ++i)
+		{
+			const rcContour& a = serial.conts[i];
+			const rcContour& b = shuffled.conts[i];
+			REQUIRE(a.reg == b.reg);
+			REQUIRE(a.area == b.area);
+			REQUIRE(a.nverts == b.nverts);
+			REQUIRE(a.nrverts == b.nrverts);
+			REQUIRE(memcmp(a.verts, b.verts, sizeof(int)*a.nverts*4) == 0);
+			REQUIRE(memcmp(a.rverts, b.rverts, sizeof(int)*a.nrverts*4) == 0);
+		}
+	}
+}
+
+// Signed area of triangle abc on the xz-plane, times two.
+static float triArea2D(const float* a, const float* b, const float* c)
+{
+	return (b[0]-a[0])*(c[2]-a[2]) - (c[0]-a[0])*(b[2]-a[2]);
+}
+
+// Returns true if d is clearly inside the circumcircle of triangle abc on the xz-plane.
+static bool isInCircumCircle(const float* a, const float* b, const float* c, const float* d)
+{
+	const double adx = a[0]-d[0], adz = a[2]-d[2];
+	const double bdx = b[0]-d[0], bdz = b[2]-d[2];
+	const double cdx = c[0]-d[0], cdz = c[2]-d[2];
+	const double det = (adx*adx + adz*adz)*(bdx*cdz - cdx*bdz)
+		- (bdx*bdx + bdz*bdz)*(adx*cdz - cdx*adz)
+		+ (cdx*cdx + cdz*cdz)*(adx*bdz - bdx*adz);
+	const double orient = (b[0]-a[0])*(c[2]-a[2]) - (c[0]-a[0])*(b[2]-a[2]);
+	return (orient > 0 ? det : -det) > 1e-3;
+}
+
+// Signed squared distance from p to the polygon on the xz-plane, negative inside.
+// Squared like the distance rcBuildPolyMeshDetail places its samples with.
+static float distToPoly2D(const int nverts, const float* verts, const float* p)
+{
+	float dmin = FLT_MAX;
+	bool inside = false;
+	for (int i = 0, j = nverts-1; i < nverts; j = i++)
+	{
+		const float* vi = &verts[i*3];
+		const float* vj = &verts[j*3];
+		if (((vi[2] > p[2]) != (vj[2] > p[2])) &&
+			(p[0] < (vj[0]-vi[0]) * (p[2]-vi[2]) / (vj[2]-vi[2]) + vi[0]))
+			inside = !inside;
+		const float dx = vi[0]-vj[0];
+		const float dz = vi[2]-vj[2];
+		const float d = dx*dx + dz*dz;
+		float t = d > 0 ? ((p[0]-vj[0])*dx + (p[2]-vj[2])*dz) / d : 0;
+		t = rcClamp(t, 0.0f, 1.0f);
+		const float ex = vj[0] + t*dx - p[0];
+		const float ez = vj[2] + t*dz - p[2];
+		dmin = rcMin(dmin, ex*ex + ez*ez);
+	}
+	return inside ? -dmin : dmin;
+}
+
+// The height error of a detail mesh against the compact heightfield, measured where
+// rcBuildPolyMeshDetail samples it: on the sample grid inside each polygon, away from
+// its edges, with the same jitter. The sample height is the span of the polygon's region.
+struct DetailHeightError
+{
+	float maxError;			// Over the polygons below the detail vertex limit.
+	float maxErrorAll;		// Also over the polygons that ran out of detail vertices.
+	float meanError;
+	int nsamples;
+};
+
+static DetailHeightError measureDetailHeightError(const rcPolyMesh& pmesh, const rcPolyMeshDetail& dmesh,
+												  const rcCompactHeightfield& chf, const float sampleDist)
+{
+	DetailHeightError err;
+	err.maxError = 0;
+	err.maxErrorAll = 0;
+	err.meanError = 0;
+	err.nsamples = 0;
+	double sum = 0;
+
+	static const int MAX_POLY_VERTS = 12;
+	REQUIRE(pmesh.nvp <= MAX_POLY_VERTS);
+	const float cs = chf.cs;
+	const float ch = chf.ch;
+	for (int i = 0; i < pmesh.npolys; ++i)
+	{
+		const unsigned int* m = &dmesh.meshes[i*4];
+		const float* dv = &dmesh.verts[m[0]*3];
+		const unsigned char* dt = &dmesh.tris[m[2]*4];
+		const int ndt = (int)m[3];
+		// rcBuildPolyMeshDetail stops refining a polygon at 127 vertices, whatever the error.
+		const bool atVertexLimit = m[1] >= 127;
+
+		// The polygon, relative to the polygon mesh origin like the detail build sees it.
+		const unsigned short* p = &pmesh.polys[i*pmesh.nvp*2];
+		float poly[MAX_POLY_VERTS*3];
+		int npoly = 0;
+		float bmin[3], bmax[3];
+		for (int j = 0; j < pmesh.nvp && p[j] != RC_MESH_NULL_IDX; ++j)
+		{
+			const unsigned short* v = &pmesh.verts[p[j]*3];
+			poly[j*3+0] = v[0]*cs;
+			poly[j*3+1] = v[1]*ch;
+			poly[j*3+2] = v[2]*cs;
+			if (j == 0)
+			{
+				rcVcopy(bmin, &poly[0]);
+				rcVcopy(bmax, &poly[0]);
+			}
+			rcVmin(bmin, &poly[j*3]);
+			rcVmax(bmax, &poly[j*3]);
+			npoly++;
+		}
+
+		const int x0 = (int)floorf(bmin[0]/sampleDist);
+		const int x1 = (int)ceilf(bmax[0]/sampleDist);
+		const int z0 = (int)floorf(bmin[2]/sampleDist);
+		const int z1 = (int)ceilf(bmax[2]/sampleDist);
+		int isample = 0;
+		for (int z = z0; z < z1; ++z)
+		{
+			for (int x = x0; x < x1; ++x)
+			{
+				float pt[3] = { x*sampleDist, (bmin[1]+bmax[1])*0.5f, z*sampleDist };
+				if (distToPoly2D(npoly, poly, pt) > -sampleDist/2)
+					continue;
+				const int si = isample++;
+
+				// The span of the polygon's region under the sample. The polygons do not include the border.
+				const int cx = (int)floorf(pt[0]/cs + 0.01f) + pmesh.borderSize;
+				const int cz = (int)floorf(pt[2]/cs + 0.01f) + pmesh.borderSize;
+				if (cx < 0 || cz < 0 || cx >= chf.width || cz >= chf.height)
+					continue;
+				const rcCompactCell& c = chf.cells[cx + cz*chf.width];
+				int spanY = -1;
+				for (int k = (int)c.index, nk = (int)(c.index+c.count); k < nk; ++k)
+				{
+					if (chf.spans[k].reg == pmesh.regs[i])
+						spanY = chf.spans[k].y;
+				}
+				if (spanY == -1)
+					continue;
+
+				// The jittered sample location, in world space.
+				const float wx = pmesh.bmin[0] + pt[0] + ((((si * 0x8da6b343) & 0xffff) / 65535.0f * 2.0f) - 1.0f)*cs*0.1f;
+				const float wz = pmesh.bmin[2] + pt[2] + ((((si * 0xd8163841) & 0xffff) / 65535.0f * 2.0f) - 1.0f)*cs*0.1f;
+				const float wy = pmesh.bmin[1] + spanY*ch + ch; // The detail verts are raised by one cell.
+
+				// The height of the detail surface at the sample.
+				for (int j = 0; j < ndt; ++j)
+				{
+					const float* a = &dv[dt[j*4+0]*3];
+					const float* b = &dv[dt[j*4+1]*3];
+					const float* cc = &dv[dt[j*4+2]*3];
+					const float q[3] = { wx, 0, wz };
+					const float area = triArea2D(a, b, cc);
+					if (fabsf(area) < 1e-9f)
+						continue;
+					const float u = triArea2D(q, b, cc) / area;
+					const float v = triArea2D(a, q, cc) / area;
+					const float w = 1.0f - u - v;
+					const float EPS = 1e-4f;
+					if (u < -EPS || v < -EPS || w < -EPS)
+						continue;
+					const float h = a[1]*u + b[1]*v + cc[1]*w;
+					const float e = fabsf(h - wy);
+					if (!atVertexLimit)
+						err.maxError = rcMax(err.maxError, e);
+					err.maxErrorAll = rcMax(err.maxErrorAll, e);
+					sum += e;
+					err.nsamples++;
+					break;
+				}
+			}
+		}
+	}
+	if (err.nsamples > 0)
+		err.meanError = (float)(sum / err.nsamples);
+	return err;
+}
+
+TEST_CASE("rcBuildPolyMeshDetail")
+{
+	// Rolling terrain, so that the detail mesh needs plenty of interior samples.
+	const int gridSize = 24;
+	float verts[(gridSize+1)*(gridSize+1)*3];
+	for (int z = 0; z <= gridSize; ++z)
+	{
+		for (int x = 0; x <= gridSize; ++x)
+		{
+			float* v = &verts[(x + z*(gridSize+1))*3];
+			v[0] = (float)x;
+			v[1] = sinf(x*0.5f) * cosf(z*0.4f) * 0.8f;
+			v[2] = (float)z;
+		}
+	}
+	int tris[gridSize*gridSize*2*3];
+	int ntris = 0;
+	for (int z = 0; z < gridSize; ++z)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			const int i = x + z*(gridSize+1);
+			int* t = &tris[ntris*3];
+			t[0] = i; t[1] = i+gridSize+1; t[2] = i+1;
+			t[3] = i+1; t[4] = i+gridSize+1; t[5] = i+gridSize+2;
+			ntris += 2;
+		}
+	}
+	const int nverts = (gridSize+1)*(gridSize+1);
+
+	rcContext ctx;
+	unsigned char areas[gridSize*gridSize*2];
+	memset(areas, 0, sizeof(areas));
+	rcMarkWalkableTriangles(&ctx, 45.0f, verts, nverts, tris, ntris, areas);
+
+	float bmin[3], bmax[3];
+	rcCalcBounds(verts, nverts, bmin, bmax);
+	const float cs = 0.3f;
+	const float ch = 0.2f;
+	int width = 0, height = 0;
+	rcCalcGridSize(bmin, bmax, cs, &width, &height);
+
+	rcHeightfield solid;
+	REQUIRE(rcCreateHeightfield(&ctx, solid, width, height, bmin, bmax, cs, ch));
+	REQUIRE(rcRasterizeTriangles(&ctx, verts, nverts, tris, areas, ntris, solid, 2));
+	rcCompactHeightfield chf;
+	REQUIRE(rcBuildCompactHeightfield(&ctx, 10, 2, solid, chf));
+	REQUIRE(rcErodeWalkableArea(&ctx, 2, chf));
+	REQUIRE(rcBuildDistanceField(&ctx, chf));
+	REQUIRE(rcBuildRegions(&ctx, chf, 2, 8, 20));
+	rcContourSet cset;
+	REQUIRE(rcBuildContours(&ctx, chf, 1.3f, 12, cset));
+	rcPolyMesh pmesh;
+	REQUIRE(rcBuildPolyMesh(&ctx, cset, 6, pmesh));
+	REQUIRE(pmesh.npolys > 0);
+
+	rcPolyMeshDetail dmesh;
+	REQUIRE(rcBuildPolyMeshDetail(&ctx, pmesh, chf, cs*2, ch*0.5f, dmesh));
+	REQUIRE(dmesh.nmeshes == pmesh.npolys);
+
+	SECTION("The height error is within the sample max error")
+	{
+		const DetailHeightError err = measureDetailHeightError(pmesh, dmesh, chf, cs*2);
+		REQUIRE(err.nsamples > 0);
+		REQUIRE(err.maxError <= ch*0.5f + 1e-4f);
+
+		// No worse than the errors of the previous build, which re-triangulated the polygon
+		// from scratch after every added sample: max 0.096741 (0.161926 at the vertex limit),
+		// mean 0.036908.
+		REQUIRE(err.maxError <= 0.096741f + 1e-4f);
+		REQUIRE(err.maxErrorAll <= 0.161926f + 1e-4f);
+		REQUIRE(err.meanError <= 0.036908f + 1e-5f);
+	}
+
+	SECTION("Interior samples are added")
+	{
+		int npolyVerts = 0;
+		for (int i = 0; i < pmesh.npolys; ++i)
+		{
+			for (int j = 0; j < pmesh.nvp && pmesh.polys[i*pmesh.nvp*2+j] != RC_MESH_NULL_IDX; ++j)
+				npolyVerts++;
+		}
+		REQUIRE(dmesh.nverts > npolyVerts);
+	}
+
+	SECTION("The detail triangles tile each polygon")
+	{
+		for (int i = 0; i < dmesh.nmeshes; ++i)
+		{
+			const unsigned int* m = &dmesh.meshes[i*4];
+			const float* dv = &dmesh.verts[m[0]*3];
+			const int ndv = (int)m[1];
+			const unsigned char* dt = &dmesh.tris[m[2]*4];
+			const int ndt = (int)m[3];
+
+			// The polygon is made of the first vertices of the detail mesh.
+			const unsigned short* p = &pmesh.polys[i*pmesh.nvp*2];
+			int npv = 0;
+			while (npv < pmesh.nvp && p[npv] != RC_MESH_NULL_IDX)
+				npv++;
+			REQUIRE(ndv >= npv);
+
+			float polyArea = 0;
+			for (int j = 2; j < npv; ++j)
+				polyArea += triArea2D(&dv[0], &dv[(j-1)*3], &dv[j*3]);
+
+			float triArea = 0;
+			for (int j = 0; j < ndt; ++j)
+			{
+				const unsigned char* t = &dt[j*4];
+				const float area = triArea2D(&dv[t[0]*3], &dv[t[1]*3], &dv[t[2]*3]);
+				// All triangles wind the same way as the polygon.
+				REQUIRE(area * polyArea >= 0);
+				triArea += area;
+			}
+			REQUIRE(fabsf(triArea - polyArea) <= fabsf(polyArea)*1e-3f + 1e-4f);
+		}
+	}
+
+	SECTION("The interior edges are Delaunay")
+	{
+		for (int i = 0; i < dmesh.nmeshes; ++i)
+		{
+			const unsigned int* m = &dmesh.meshes[i*4];
+			const float* dv = &dmesh.verts[m[0]*3];
+			const unsigned char* dt = &dmesh.tris[m[2]*4];
+			const int ndt = (int)m[3];
+			for (int j = 0; j < ndt; ++j)
+			{
+				for (int k = 0; k < ndt; ++k)
+				{
+					if (j == k)
+						continue;
+					// Find the vertex of k opposite to an edge shared with j.
+					const unsigned char* a = &dt[j*4];
+					const unsigned char* b = &dt[k*4];
+					int shared = 0;
+					int opposite = -1;
+					for (int u = 0; u < 3; ++u)
+					{
+						if (b[u] == a[0] || b[u] == a[1] || b[u] == a[2])
+							shared++;
+						else
+							opposite = b[u];
+					}
+					if (shared != 2)
+						continue;
+					REQUIRE(!isInCircumCircle(&dv[a[0]*3], &dv[a[1]*3], &dv[a[2]*3], &dv[opposite*3]));
+				}
+			}
+		}
+	}
+
+	rcFree(dmesh.meshes);
+	rcFree(dmesh.verts);
+	rcFree(dmesh.tris);
+}
+
 // Used to verify that rcVector constructs/destroys objects correctly.
 struct Incrementor {
 	static int constructions;